@@ -17,6 +17,7 @@
 
 #include <util/threads/thread.h>
 #include <util/threads/sync.h>
+#include <util/threads/epoch.h>
 
 #include <log/logger_support.h>
 #include <log/log_dbglevels.h>
@@ -136,6 +137,40 @@ struct Command {
     FinishedCallback callback;
 };
 
+/// \brief The data source client lists as seen by the query threads.
+///
+/// The manager and the builder publish the current client lists here
+/// whenever they replace them, and \c DataSrcClientsMgrBase::Holder reads
+/// them within a read section of \c epoch without taking any lock.  The
+/// replaced lists must be kept alive until \c epoch.synchronize() returns.
+/// Any modification of the published lists in place must be done in an
+/// exclusive section of \c epoch.
+struct PublishedClientLists : boost::noncopyable {
+    typedef datasrc::ClientListMapPtr::element_type ClientListsMap;
+
+    /// \brief Constructor
+    ///
+    /// \param lists The initial client lists.  Must not be NULL.
+    PublishedClientLists(const datasrc::ClientListMapPtr& lists) :
+        lists(lists.get())
+    {}
+
+    /// \brief Make new client lists visible to the readers.
+    ///
+    /// This doesn't wait for the grace period; the caller should call
+    /// \c epoch.synchronize() before releasing the old lists.
+    void publish(const datasrc::ClientListMapPtr& new_lists) {
+        util::thread::EpochManager::publish<const ClientListsMap>(
+            lists, new_lists.get());
+    }
+
+    /// \brief Protection of the readers of the lists.
+    util::thread::EpochManager epoch;
+
+    /// \brief The current client lists.
+    const ClientListsMap* volatile lists;
+};
+
 } // namespace datasrc_clientmgr_internal
 
 /// \brief Frontend to the manager object for data source clients.
@@ -192,15 +227,25 @@ public:
     /// causing a race condition with other threads that can possibly use
     /// the same manager throughout the lifetime of the holder object.
     ///
+    /// The holder doesn't take a lock: it pins the client lists that are
+    /// current when it's created (in a read section of an
+    /// \c util::thread::EpochManager), and a reconfiguration doesn't release
+    /// them until all holders that can see them are destroyed.  Holders
+    /// can also be nested within the same thread.  Creating a holder only
+    /// blocks while the builder modifies the lists in place (e.g., installs
+    /// a newly loaded zone), which is expected to be short.
+    ///
     /// This also means the holder object is expected to have a short lifetime.
-    /// The application shouldn't try to keep it unnecessarily long.
+    /// The application shouldn't try to keep it unnecessarily long, as it
+    /// delays the release of old client lists and the zone updates.
     /// It's normally expected to create the holder object on the stack
     /// of a small scope and automatically let it be destroyed at the end
     /// of the scope.
     class Holder {
     public:
         Holder(DataSrcClientsMgrBase& mgr) :
-            mgr_(mgr), locker_(mgr_.map_mutex_)
+            reader_(mgr.published_lists_.epoch),
+            lists_(*mgr.published_lists_.lists)
         {}
 
         /// \brief Find a data source client list of a specified RR class.
@@ -221,9 +266,8 @@ public:
         boost::shared_ptr<datasrc::ConfigurableClientList> findClientList(
             const dns::RRClass& rrclass)
         {
-            const ClientListsMap::const_iterator
-                it = mgr_.clients_map_->find(rrclass);
-            if (it == mgr_.clients_map_->end()) {
+            const ClientListsMap::const_iterator it = lists_.find(rrclass);
+            if (it == lists_.end()) {
                 return (boost::shared_ptr<datasrc::ConfigurableClientList>());
             } else {
                 return (it->second);
@@ -240,16 +284,16 @@ public:
         /// \throw std::bad_alloc for problems allocating the result.
         std::vector<dns::RRClass> getClasses() const {
             std::vector<dns::RRClass> result;
-            for (ClientListsMap::const_iterator it =
-                 mgr_.clients_map_->begin(); it != mgr_.clients_map_->end();
-                 ++it) {
+            for (ClientListsMap::const_iterator it = lists_.begin();
+                 it != lists_.end(); ++it) {
                 result.push_back(it->first);
             }
             return (result);
         }
     private:
-        DataSrcClientsMgrBase& mgr_;
-        typename MutexType::Locker locker_;
+        // (the order is important: the lists are read within the section)
+        util::thread::EpochManager::ReadLocker reader_;
+        const ClientListsMap& lists_;
     };
 
     /// \brief Constructor.
@@ -268,8 +312,9 @@ public:
         clients_map_(new ClientListsMap),
         fd_guard_(new FDGuard(this)),
         read_fd_(-1), write_fd_(-1),
+        published_lists_(clients_map_),
         builder_(&command_queue_, &callback_queue_, &cond_, &queue_mutex_,
-                 &clients_map_, &map_mutex_, createFds()),
+                 &clients_map_, &map_mutex_, &published_lists_, createFds()),
         builder_thread_(boost::bind(&BuilderType::run, &builder_)),
         wakeup_socket_(service, read_fd_)
     {
@@ -351,9 +396,17 @@ public:
     /// This is provided only for some existing tests until we support a
     /// cleaner way to use faked data source clients.  Non test code or
     /// newer tests must not use this.
+    ///
+    /// This waits until no holder can see the old lists, so it must not
+    /// be called while the calling thread has a \c Holder.
     void setDataSrcClientLists(datasrc::ClientListMapPtr new_lists) {
-        typename MutexType::Locker locker(map_mutex_);
-        clients_map_ = new_lists;
+        {
+            typename MutexType::Locker locker(map_mutex_);
+            clients_map_.swap(new_lists);
+            published_lists_.publish(clients_map_);
+        }
+        // The old lists are released on return (unless shared elsewhere)
+        published_lists_.epoch.synchronize();
     }
 
     /// \brief Instruct internal thread to (re)load a zone
@@ -568,6 +621,8 @@ private:
     boost::scoped_ptr<FDGuard> fd_guard_; // A guard to close the fds.
     int read_fd_, write_fd_;    // Descriptors for wakeup
     MutexType map_mutex_;       // mutex to protect the clients map
+    // clients map for the readers (holders)
+    datasrc_clientmgr_internal::PublishedClientLists published_lists_;
 
     BuilderType builder_;
     ThreadType builder_thread_; // for safety this should be placed last
@@ -622,11 +677,13 @@ public:
                               CondVarType* cond, MutexType* queue_mutex,
                               datasrc::ClientListMapPtr* clients_map,
                               MutexType* map_mutex,
+                              PublishedClientLists* published_lists,
                               int wake_fd
         ) :
         command_queue_(command_queue), callback_queue_(callback_queue),
         cond_(cond), queue_mutex_(queue_mutex),
-        clients_map_(clients_map), map_mutex_(map_mutex), wake_fd_(wake_fd),
+        clients_map_(clients_map), map_mutex_(map_mutex),
+        published_lists_(published_lists), wake_fd_(wake_fd),
         gen_id_(-1)
     {}
 
@@ -682,14 +739,16 @@ private:
     // Swap pending clients map with the current when all waiting memory
     // segments are ready.
     void installClientsMap() {
-        // Define new_clients_map outside of the block that has the lock scope;
-        // this way, after the swap, the lock is guaranteed to be released
-        // before the old data is destroyed, minimizing the lock duration.
+        // The old data is kept in pending_map_ after the swap, so it's
+        // destroyed after the lock is released, minimizing the lock duration.
+        // Readers don't use the lock; the old data can only be destroyed
+        // once all of them that may still see it are gone.
         {
             typename MutexType::Locker locker(*map_mutex_);
             pending_map_->clients_map_.swap(*clients_map_);
+            published_lists_->publish(*clients_map_);
         } // lock is released by leaving scope
-          // old clients_map_ data is released by leaving scope
+        published_lists_->epoch.synchronize();
 
         if (pending_callback_) {
             callbacks_.push_back(FinishedCallbackPair(pending_callback_,
@@ -808,6 +867,7 @@ private:
         }
 
         typename MutexType::Locker locker(*map_mutex_);
+        util::thread::EpochManager::WriteLocker writer(published_lists_->epoch);
         if (!list->resetMemorySegment(
                 dsrc_name, bundy::datasrc::memory::ZoneTableSegment::READ_ONLY,
                 segment_params)) {
@@ -888,6 +948,7 @@ private:
     MutexType* queue_mutex_;
     datasrc::ClientListMapPtr* clients_map_;
     MutexType* map_mutex_;
+    PublishedClientLists* published_lists_;
     int wake_fd_;
 
     // These are local to the builder thread:
@@ -1084,8 +1145,11 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::doUpdateZone(
         }
 
         zwriter->load(); // this can take time but doesn't cause a race
-        {   // install() can cause a race and must be in a critical section
+        {   // install() can cause a race and must be in a critical section,
+            // excluding the readers, too
             typename MutexType::Locker locker(*map_mutex_);
+            util::thread::EpochManager::WriteLocker
+                writer(published_lists_->epoch);
             zwriter->install();
         }
         LOG_DEBUG(auth_logger, DBG_AUTH_OPS,
@@ -1123,6 +1187,8 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::getZoneWriter(
     datasrc::ConfigurableClientList::ZoneWriterPair writerpair;
     {
         typename MutexType::Locker locker(*map_mutex_);
+        util::thread::EpochManager::WriteLocker
+            writer(published_lists_->epoch);
         writerpair = client_list.getCachedZoneWriter(origin, false,
                                                      datasrc_name);
     }
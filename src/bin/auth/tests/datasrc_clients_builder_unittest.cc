@@ -59,9 +59,11 @@ protected:
     DataSrcClientsBuilderTest() :
         clients_map(new std::map<RRClass,
                     boost::shared_ptr<ConfigurableClientList> >),
+        published_lists(clients_map),
         write_end(-1), read_end(-1),
         builder(&command_queue, &callback_queue, &cond, &queue_mutex,
-                &clients_map, &map_mutex, generateSockets()),
+                &clients_map, &map_mutex, &published_lists,
+                generateSockets()),
         cond(command_queue, delayed_command_queue), rrclass(RRClass::IN()),
         shutdown_cmd(SHUTDOWN, ConstElementPtr(), FinishedCallback()),
         noop_cmd(NOOP, ConstElementPtr(), FinishedCallback())
@@ -80,6 +82,7 @@ protected:
     ConstElementPtr createSegments() const;
 
     ClientListMapPtr clients_map; // configured clients
+    PublishedClientLists published_lists; // clients_map for the readers
     std::list<Command> command_queue; // test command queue
     std::list<Command> delayed_command_queue; // commands available after wait
     std::list<FinishedCallbackPair> callback_queue; // Callbacks from commands
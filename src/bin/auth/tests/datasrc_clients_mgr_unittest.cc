@@ -14,11 +14,17 @@
 
 #include <exceptions/exceptions.h>
 
+#include <dns/name.h>
 #include <dns/rrclass.h>
+#include <dns/rrtype.h>
 
 #include <cc/data.h>
 
 #include <datasrc/client_list.h>
+#include <datasrc/zone_finder.h>
+
+#include <util/threads/thread.h>
+#include <util/unittests/check_valgrind.h>
 
 #include <auth/datasrc_clients_mgr.h>
 #include "test_datasrc_clients_mgr.h"
@@ -27,6 +33,10 @@
 
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <vector>
 
 using namespace bundy::dns;
 using namespace bundy::data;
@@ -159,12 +169,9 @@ TEST(DataSrcClientsMgrTest, holder) {
         EXPECT_FALSE(holder.findClientList(RRClass::IN()));
         EXPECT_FALSE(holder.findClientList(RRClass::CH()));
         EXPECT_TRUE(holder.getClasses().empty());
-        // map should be protected here
-        EXPECT_EQ(1, FakeDataSrcClientsBuilder::map_mutex->lock_count);
-        EXPECT_EQ(0, FakeDataSrcClientsBuilder::map_mutex->unlock_count);
+        // The holder doesn't use the map lock
+        EXPECT_EQ(0, FakeDataSrcClientsBuilder::map_mutex->lock_count);
     }
-    // map lock has been released
-    EXPECT_EQ(1, FakeDataSrcClientsBuilder::map_mutex->unlock_count);
 
     // Put something in, that should become visible.
     ConstElementPtr reconfigure_arg = Element::fromJSON(
@@ -195,10 +202,11 @@ TEST(DataSrcClientsMgrTest, holder) {
         EXPECT_EQ(RRClass::IN(), holder.getClasses()[0]);
     }
 
-    // Duplicate lock acquisition is prohibited (only test mgr can detect
-    // this reliably, so this test may not be that useful)
+    // Holders can be nested
     TestDataSrcClientsMgr::Holder holder1(mgr);
-    EXPECT_THROW(TestDataSrcClientsMgr::Holder holder2(mgr), bundy::Unexpected);
+    TestDataSrcClientsMgr::Holder holder2(mgr);
+    EXPECT_TRUE(holder2.findClientList(RRClass::IN()));
+    EXPECT_EQ(0, FakeDataSrcClientsBuilder::map_mutex->lock_count);
 }
 
 namespace {
@@ -383,4 +391,85 @@ TEST(DataSrcClientsMgrTest, realThread) {
     DataSrcClientsMgr mgr(service);
 }
 
+// Emulates a query thread: looks up the zone data until told to stop.
+void
+queryLoop(DataSrcClientsMgr* mgr, volatile bool* stop, size_t* queries,
+          size_t* failures)
+{
+    const Name qname("ns.example.org");
+    while (!*stop) {
+        DataSrcClientsMgr::Holder holder(*mgr);
+        const boost::shared_ptr<ConfigurableClientList> list =
+            holder.findClientList(RRClass::IN());
+        if (!list) {            // not configured yet
+            continue;
+        }
+        const ClientList::FindResult result(list->find(qname));
+        if (!result.finder_ ||
+            result.finder_->find(qname, RRType::A())->code !=
+            ZoneFinder::SUCCESS) {
+            ++*failures;
+        }
+        ++*queries;
+    }
+}
+
+void
+setFlag(bool* flag, ConstElementPtr) {
+    *flag = true;
+}
+
+// Reconfigure and reload the zone continuously while other threads keep
+// using the client lists.  Old lists must not be released while they are
+// still in use, and the queries must never see an incomplete zone.
+TEST(DataSrcClientsMgrTest, reconfigureUnderLoad) {
+    if (bundy::util::unittests::runningOnValgrind()) {
+        return;
+    }
+
+    bundy::asiolink::IOService service;
+    DataSrcClientsMgr mgr(service);
+
+    const size_t thread_count = 4;
+    volatile bool stop = false;
+    std::vector<size_t> queries(thread_count), failures(thread_count);
+    std::vector<boost::shared_ptr<bundy::util::thread::Thread> > threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.push_back(boost::shared_ptr<bundy::util::thread::Thread>(
+            new bundy::util::thread::Thread(
+                boost::bind(queryLoop, &mgr, &stop, &queries[i],
+                            &failures[i]))));
+    }
+
+    const std::string classes_config =
+        "{\"IN\": [{\"type\": \"MasterFiles\","
+        "           \"params\": {\"example.org\": \""
+        TEST_DATA_DIR "/example.org.zone\"},"
+        "           \"cache-enable\": true}]}";
+    const ConstElementPtr load_arg = Element::fromJSON(
+        "{\"class\": \"IN\", \"origin\": \"example.org\","
+        " \"datasource\": \"MasterFiles\"}");
+    for (int genid = 1; genid <= 100; ++genid) {
+        mgr.reconfigure(Element::fromJSON(
+                            "{\"classes\": " + classes_config + ","
+                            " \"_generation_id\": " +
+                            boost::lexical_cast<std::string>(genid) + "}"));
+        mgr.loadZone(load_arg);
+    }
+
+    // Wait for the builder to handle all the commands
+    bool done = false;
+    mgr.loadZone(load_arg, boost::bind(setFlag, &done, _1));
+    while (!done) {
+        service.run_one();
+    }
+
+    stop = true;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads[i]->wait();
+        EXPECT_LT(0, queries[i]);
+        EXPECT_EQ(0, failures[i]);
+    }
+}
+
 } // unnamed namespace
@@ -95,7 +95,11 @@ TestDataSrcClientsMgrBase::reconfigureHook() {
     // Simply replace the local map, ignoring bogus config value.
     assert(command_queue_.front().id == RECONFIGURE);
     try {
-        clients_map_ = configureDataSource(command_queue_.front().params);
+        bundy::datasrc::ClientListMapPtr new_lists =
+            configureDataSource(command_queue_.front().params);
+        clients_map_.swap(new_lists);
+        published_lists_.publish(clients_map_);
+        published_lists_.epoch.synchronize();
     } catch (...) {}
 }
 
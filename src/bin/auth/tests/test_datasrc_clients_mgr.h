@@ -162,7 +162,7 @@ public:
         TestCondVar* cond,
         TestMutex* queue_mutex,
         bundy::datasrc::ClientListMapPtr* clients_map,
-        TestMutex* map_mutex, int wakeup_fd)
+        TestMutex* map_mutex, PublishedClientLists*, int wakeup_fd)
     {
         FakeDataSrcClientsBuilder::started = false;
         FakeDataSrcClientsBuilder::command_queue = command_queue;
@@ -0,0 +1,95 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+/// @file
+/// @brief Callout library of the DHCPv4 server benchmark
+///
+/// This library is loaded by discover_bench to measure the cost of the hooks
+/// on the processing of a packet.  It installs a callout on each hook called
+/// while a DHCPDISCOVER is answered; each callout only gets the arguments of
+/// its hook, by name as the callouts of real libraries do, so what is
+/// measured is the cost of setting up and calling the callouts rather than
+/// that of their work.
+
+#include <hooks/hooks.h>
+#include <dhcp/pkt4.h>
+#include <dhcpsrv/lease.h>
+#include <dhcpsrv/subnet.h>
+
+using namespace bundy::dhcp;
+using namespace bundy::hooks;
+
+extern "C" {
+
+int
+buffer4_receive(CalloutHandle& handle) {
+    Pkt4Ptr query;
+    handle.getArgument("query4", query);
+    return (0);
+}
+
+int
+pkt4_receive(CalloutHandle& handle) {
+    Pkt4Ptr query;
+    handle.getArgument("query4", query);
+    return (0);
+}
+
+int
+subnet4_select(CalloutHandle& handle) {
+    Pkt4Ptr query;
+    handle.getArgument("query4", query);
+    Subnet4Ptr subnet;
+    handle.getArgument("subnet4", subnet);
+    return (0);
+}
+
+int
+lease4_select(CalloutHandle& handle) {
+    Lease4Ptr lease;
+    handle.getArgument("lease4", lease);
+    return (0);
+}
+
+int
+pkt4_send(CalloutHandle& handle) {
+    Pkt4Ptr response;
+    handle.getArgument("response4", response);
+    return (0);
+}
+
+int
+buffer4_send(CalloutHandle& handle) {
+    Pkt4Ptr response;
+    handle.getArgument("response4", response);
+    return (0);
+}
+
+// Framework functions.
+
+int
+version() {
+    return (BUNDY_HOOKS_VERSION);
+}
+
+// load() initializes the user library if the main image was statically linked.
+int
+load(LibraryHandle&) {
+#ifdef USE_STATIC_LINK
+    hooksStaticLinkInit();
+#endif
+    return (0);
+}
+
+}
@@ -0,0 +1,286 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/dhcp4.h>
+#include <dhcp/docsis3_option_defs.h>
+#include <dhcp/iface_mgr.h>
+#include <dhcp/libdhcp++.h>
+#include <dhcp/pkt4.h>
+#include <dhcp4/dhcp4_srv.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/pool.h>
+#include <dhcpsrv/subnet.h>
+#include <hooks/hooks_manager.h>
+#include <log/logger_support.h>
+#include <util/encode/hex.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+using bundy::hooks::HooksManager;
+
+namespace {
+
+// Number of calls to the global operator new.
+size_t allocations = 0;
+
+}
+
+// Count the memory allocations, so the benchmark can report how many
+// are needed to answer a DHCPDISCOVER.
+#if __cplusplus < 201103L
+void*
+operator new(size_t size) throw(std::bad_alloc) {
+#else
+void*
+operator new(size_t size) {
+#endif
+    ++allocations;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return (p);
+}
+
+void
+operator delete(void* p) throw() {
+    free(p);
+}
+
+namespace {
+
+// DHCPDISCOVER messages of a DOCSIS cable modem and of its eRouter, relayed
+// by the CMTS at 10.254.226.1 (see src/lib/dhcp/benchmarks/pkt_bench.cc).
+const char* const CAPTURES[] = {
+    "010106015d05478d000000000000000000000000000000000afee20120e52ab8151400"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000638253633501013707"
+    "0102030407067d3c0a646f63736973332e303a7d7f0000118b7a010102057501010102"
+    "010303010104010105010106010107010f0801100901030a01010b01180c01010d0200"
+    "400e0200100f010110040000000211010014010015013f160101170101180104190104"
+    "1a01041b01201c01021d01081e01201f01102001102101022201012301002401002501"
+    "01260200ff2701012b59020345434d030b45434d3a45524f55544552040d3242523232"
+    "39553430303434430504312e3034060856312e33332e30330707322e332e3052320806"
+    "30303039354209094347333030304443520a074e657467656172fe01083d0fff2ab815"
+    "140003000120e52ab81514390205dc5219010420000002020620e52ab8151409090000"
+    "118b0401020300ff",
+    "010106015d05478f000500000000000000000000000000000afee20120e52ab8151500"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000063825363350101370e"
+    "480102030406070c0f171a36337a2b63020745524f55544552030b45434d3a45524f55"
+    "544552040d324252323239553430303434430504312e3034060856312e33332e303307"
+    "07322e332e305232080630303039354209094347333030304443520a074e6574676561"
+    "720f0745524f555445523c0a65526f75746572312e300f14687364312e70612e636f6d"
+    "636173742e6e65742e3d0fff2ab815150003000120e52ab81515390205dc5219010420"
+    "000002020620e52ab8151409090000118b0401020300ff"
+};
+
+// A server which does not send its responses, but counts them.
+class BenchDhcpv4Srv : public Dhcpv4Srv {
+public:
+    BenchDhcpv4Srv() :
+        Dhcpv4Srv(0, "type=memfile universe=4 persist=false", false, false),
+        responses_(0)
+    {}
+
+    // Process a received packet, as done by the main loop.
+    void process(Pkt4Ptr& query) {
+        processPacket(query);
+    }
+
+    size_t getResponses() const {
+        return (responses_);
+    }
+
+protected:
+    virtual void sendPacket(const Pkt4Ptr&) {
+        ++responses_;
+    }
+
+private:
+    size_t responses_;
+};
+
+// Let the server answer each of the DHCPDISCOVER messages with an offer.
+class DiscoverBenchMark {
+public:
+    DiscoverBenchMark(BenchDhcpv4Srv& srv,
+                      const vector<vector<uint8_t> >& packets) :
+        srv_(srv), packets_(packets)
+    {}
+    unsigned int run() {
+        vector<vector<uint8_t> >::const_iterator it;
+        for (it = packets_.begin(); it != packets_.end(); ++it) {
+            Pkt4Ptr query(new Pkt4(&(*it)[0], it->size()));
+            query->setIface("bench0");
+            srv_.process(query);
+        }
+        return (packets_.size());
+    }
+private:
+    BenchDhcpv4Srv& srv_;
+    const vector<vector<uint8_t> >& packets_;
+};
+
+// Add the option of the given code to the subnet, the option data being
+// given as text.
+void
+addOption(const Subnet4Ptr& subnet, uint16_t code, const char* value0,
+          const char* value1 = NULL)
+{
+    vector<string> values(1, value0);
+    if (value1 != NULL) {
+        values.push_back(value1);
+    }
+    subnet->addOption(LibDHCP::getOptionDef(Option::V4, code)->
+                      optionFactory(Option::V4, code, values),
+                      false, "dhcp4");
+}
+
+// Configure the interface the packets are received on, and the subnet of
+// the relay with the options requested by the cable modem and the eRouter.
+void
+configure() {
+    // The server looks for the socket of the interface to set the source
+    // address of the response; as nothing is sent, no socket is opened.
+    Iface iface("bench0", 1);
+    iface.addAddress(IOAddress("10.0.0.1"));
+    iface.addSocket(SocketInfo(IOAddress("10.0.0.1"), DHCP4_SERVER_PORT, -1));
+    IfaceMgr::instance().clearIfaces();
+    IfaceMgr::instance().addInterface(iface);
+
+    Subnet4Ptr subnet(new Subnet4(IOAddress("10.254.226.0"), 24,
+                                  1000, 2000, 3000));
+    subnet->addPool(Pool4Ptr(new Pool4(IOAddress("10.254.226.10"),
+                                       IOAddress("10.254.226.250"))));
+    addOption(subnet, DHO_SUBNET_MASK, "255.255.255.0");
+    addOption(subnet, DHO_TIME_OFFSET, "-18000");
+    addOption(subnet, DHO_ROUTERS, "10.254.226.1");
+    addOption(subnet, DHO_TIME_SERVERS, "10.0.0.1", "10.0.0.2");
+    addOption(subnet, DHO_DOMAIN_NAME_SERVERS, "10.0.0.53", "10.0.1.53");
+    addOption(subnet, DHO_LOG_SERVERS, "10.0.0.3");
+    addOption(subnet, DHO_DOMAIN_NAME, "example.com");
+    addOption(subnet, DHO_DEFAULT_IP_TTL, "64");
+    addOption(subnet, DHO_INTERFACE_MTU, "1500");
+
+    const uint16_t code = DOCSIS3_V4_TFTP_SERVERS;
+    OptionDefinitionPtr def =
+        LibDHCP::getVendorOptionDef(Option::V4, VENDOR_ID_CABLE_LABS, code);
+    subnet->addVendorOption(def->optionFactory(Option::V4, code,
+                                               vector<string>(1, "10.0.0.4")),
+                            false, VENDOR_ID_CABLE_LABS);
+
+    CfgMgr::instance().deleteSubnets4();
+    CfgMgr::instance().addSubnet4(subnet);
+}
+
+void
+usage() {
+    std::cerr << "Usage: discover_bench [-n iterations] [-p packets] "
+              << "[-l libraries]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t packet_count = 10000;
+    int library_count = 0;
+    while ((ch = getopt(argc, argv, "n:p:l:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'p':
+            packet_count = atoi(optarg);
+            break;
+        case 'l':
+            library_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || packet_count == 0 || library_count < 0) {
+        usage();
+    }
+
+    bundy::log::initLogger("discover_bench", bundy::log::NONE);
+
+    // The captured packets alternate.
+    const size_t capture_count = sizeof(CAPTURES) / sizeof(CAPTURES[0]);
+    vector<vector<uint8_t> > packets(packet_count);
+    for (size_t i = 0; i < packet_count; ++i) {
+        bundy::util::encode::decodeHex(CAPTURES[i % capture_count],
+                                       packets[i]);
+    }
+
+    BenchDhcpv4Srv srv;
+    configure();
+
+    // Load the callout library as many times as requested: each copy has
+    // its callouts called on each hook of the exchange.
+    if (library_count > 0 &&
+        !HooksManager::loadLibraries(vector<string>(library_count,
+                                                    BENCH_CALLOUT_LIBRARY))) {
+        std::cerr << "Unable to load " << BENCH_CALLOUT_LIBRARY << std::endl;
+        return (1);
+    }
+
+    // Count the allocations of a first round, which also checks that each
+    // discover is answered.
+    DiscoverBenchMark bench(srv, packets);
+    const size_t allocations_before = allocations;
+    bench.run();
+    const size_t exchange_allocations = allocations - allocations_before;
+    if (srv.getResponses() != packet_count) {
+        std::cerr << "Only " << srv.getResponses() << " of the "
+                  << packet_count << " discovers were answered" << std::endl;
+        return (1);
+    }
+    std::cout << "Memory allocations per DISCOVER/OFFER exchange: "
+              << static_cast<double>(exchange_allocations) / packet_count
+              << std::endl;
+
+    std::cout << "Benchmark for answering DOCSIS discovers with "
+              << library_count << " hooks libraries" << std::endl;
+    BenchMark<DiscoverBenchMark>(iteration, bench);
+
+    return (0);
+}
@@ -392,7 +392,11 @@ DhcpConfigParser* createGlobalDhcp4ConfigParser(const std::string& config_id) {
     DhcpConfigParser* parser = NULL;
     if ((config_id.compare("valid-lifetime") == 0)  ||
         (config_id.compare("renew-timer") == 0)  ||
-        (config_id.compare("rebind-timer") == 0))  {
+        (config_id.compare("rebind-timer") == 0) ||
+        (config_id.compare("worker-threads") == 0) ||
+        (config_id.compare("parked-packet-limit") == 0) ||
+        (config_id.compare("reclaim-timer-wait-time") == 0) ||
+        (config_id.compare("max-reclaim-leases") == 0))  {
         parser = new Uint32Parser(config_id,
                                  globalContext()->uint32_values_);
     } else if (config_id.compare("interfaces") == 0) {
@@ -415,6 +419,8 @@ DhcpConfigParser* createGlobalDhcp4ConfigParser(const std::string& config_id) {
         parser = new DbAccessParser(config_id, *globalContext());
     } else if (config_id.compare("hooks-libraries") == 0) {
         parser = new HooksLibrariesParser(config_id);
+    } else if (config_id.compare("client-classes") == 0) {
+        parser = new ClientClassesParser(config_id, globalContext());
     } else if (config_id.compare("echo-client-id") == 0) {
         parser = new BooleanParser(config_id, globalContext()->boolean_values_);
     } else if (config_id.compare("dhcp-ddns") == 0) {
@@ -440,6 +446,49 @@ void commitGlobalOptions() {
     } catch (...) {
         // Ignore errors. This flag is optional
     }
+
+    // Set the number of threads processing packets. The parameter is
+    // optional; without it the packets are processed by the receiving
+    // thread.
+    uint32_t worker_threads = 0;
+    try {
+        worker_threads =
+            globalContext()->uint32_values_->getParam("worker-threads");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setWorkerThreads(worker_threads);
+
+    // Set how many packets the callouts may park at once. The parameter is
+    // optional.
+    uint32_t parked_packet_limit = CfgMgr::DEFAULT_PARKED_PACKET_LIMIT;
+    try {
+        parked_packet_limit =
+            globalContext()->uint32_values_->getParam("parked-packet-limit");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setParkedPacketLimit(parked_packet_limit);
+
+    // Set how often and how many expired leases are reclaimed. The
+    // parameters are optional.
+    uint32_t reclaim_timer_wait_time = CfgMgr::DEFAULT_RECLAIM_TIMER_WAIT_TIME;
+    try {
+        reclaim_timer_wait_time = globalContext()->uint32_values_->
+            getParam("reclaim-timer-wait-time");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setReclaimTimerWaitTime(reclaim_timer_wait_time);
+
+    uint32_t max_reclaim_leases = CfgMgr::DEFAULT_MAX_RECLAIM_LEASES;
+    try {
+        max_reclaim_leases =
+            globalContext()->uint32_values_->getParam("max-reclaim-leases");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setMaxReclaimLeases(max_reclaim_leases);
 }
 
 bundy::data::ConstElementPtr
@@ -471,6 +520,7 @@ configureDhcp4Server(Dhcpv4Srv&, bundy::data::ConstElementPtr config_set) {
     ParserPtr subnet_parser;
     ParserPtr option_parser;
     ParserPtr iface_parser;
+    ParserPtr classes_parser;
 
     // Some of the parsers alter the state of the system in a way that can't
     // easily be undone. (Or alter it in a way such that undoing the change has
@@ -512,6 +562,11 @@ configureDhcp4Server(Dhcpv4Srv&, bundy::data::ConstElementPtr config_set) {
                 // parser and can be run here before any other parsers.
                 iface_parser = parser;
                 parser->build(config_pair.second);
+            } else if (config_pair.first == "client-classes") {
+                // The classes are compiled now, but the classifier is only
+                // replaced once the whole configuration is accepted.
+                classes_parser = parser;
+                parser->build(config_pair.second);
             } else if (config_pair.first == "hooks-libraries") {
                 // Executing commit will alter currently-loaded hooks
                 // libraries.  Check if the supplied libraries are valid,
@@ -578,6 +633,10 @@ configureDhcp4Server(Dhcpv4Srv&, bundy::data::ConstElementPtr config_set) {
                 iface_parser->commit();
             }
 
+            if (classes_parser) {
+                classes_parser->commit();
+            }
+
             // Apply global options
             commitGlobalOptions();
 
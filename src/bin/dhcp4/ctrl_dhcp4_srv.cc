@@ -25,6 +25,7 @@
 #include <dhcp4/spec_config.h>
 #include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/dhcp_config_parser.h>
+#include <dhcpsrv/lease_mgr_factory.h>
 #include <exceptions/exceptions.h>
 #include <hooks/hooks_manager.h>
 #include <util/buffer.h>
@@ -170,6 +171,17 @@ ControlledDhcpv4Srv::dhcp4CommandHandler(const string& command, ConstElementPtr
         ConstElementPtr answer = bundy::config::createAnswer(0,
                                  "Hooks libraries successfully reloaded.");
         return (answer);
+
+    } else if (command == "lease-cache-flush") {
+        // The leases were changed in the database by the administrator.
+        if (!LeaseMgrFactory::flushCache()) {
+            ConstElementPtr answer = bundy::config::createAnswer(1,
+                                     "The leases are not cached.");
+            return (answer);
+        }
+        ConstElementPtr answer = bundy::config::createAnswer(0,
+                                 "Lease cache flushed.");
+        return (answer);
     }
 
     ConstElementPtr answer = bundy::config::createAnswer(1,
@@ -182,6 +194,12 @@ void ControlledDhcpv4Srv::sessionReader(void) {
     // Process one asio event. If there are more events, iface_mgr will call
     // this callback more than once.
     if (server_) {
+        // The event may change the configuration (or stop the server), so
+        // wait until the worker threads have finished the packets they are
+        // processing, and don't let them start new ones until the event is
+        // handled.
+        bundy::util::thread::EpochManager::WriteLocker
+            locker(server_->packet_processing_);
         server_->io_service_.run_one();
     }
 }
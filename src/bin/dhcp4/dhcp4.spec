@@ -60,6 +60,56 @@
         "item_default": true
       },
 
+      { "item_name": "worker-threads",
+        "item_type": "integer",
+        "item_optional": true,
+        "item_default": 0
+      },
+
+      { "item_name": "parked-packet-limit",
+        "item_type": "integer",
+        "item_optional": true,
+        "item_default": 256
+      },
+
+      { "item_name": "reclaim-timer-wait-time",
+        "item_type": "integer",
+        "item_optional": true,
+        "item_default": 10
+      },
+
+      { "item_name": "max-reclaim-leases",
+        "item_type": "integer",
+        "item_optional": true,
+        "item_default": 100
+      },
+
+      { "item_name": "client-classes",
+        "item_type": "list",
+        "item_optional": true,
+        "item_default": [],
+        "list_item_spec":
+        {
+          "item_name": "client-class",
+          "item_type": "map",
+          "item_optional": false,
+          "item_default": {},
+          "map_item_spec": [
+          {
+            "item_name": "name",
+            "item_type": "string",
+            "item_optional": false,
+            "item_default": ""
+          },
+
+          { "item_name": "test",
+            "item_type": "string",
+            "item_optional": false,
+            "item_default": ""
+          } ]
+        }
+      },
+
       { "item_name": "option-def",
         "item_type": "list",
         "item_optional": false,
@@ -197,6 +247,72 @@
                 "item_type": "boolean",
                 "item_optional": true,
                 "item_default": true
+            },
+            {
+                "item_name": "cache-size",
+                "item_type": "integer",
+                "item_optional": true,
+                "item_default": 0
+            },
+            {
+                "item_name": "replication-socket",
+                "item_type": "string",
+                "item_optional": true,
+                "item_default": ""
+            },
+            {
+                "item_name": "replication-peer",
+                "item_type": "string",
+                "item_optional": true,
+                "item_default": ""
+            },
+            {
+                "item_name": "replication-node",
+                "item_type": "integer",
+                "item_optional": true,
+                "item_default": -1
+            },
+            {
+                "item_name": "format",
+                "item_type": "string",
+                "item_optional": true,
+                "item_default": "csv"
+            },
+            {
+                "item_name": "fsync",
+                "item_type": "boolean",
+                "item_optional": true,
+                "item_default": true
+            },
+            {
+                "item_name": "compact-interval",
+                "item_type": "integer",
+                "item_optional": true,
+                "item_default": 3600
+            },
+            {
+                "item_name": "write-behind",
+                "item_type": "boolean",
+                "item_optional": true,
+                "item_default": false
+            },
+            {
+                "item_name": "write-behind-queue",
+                "item_type": "integer",
+                "item_optional": true,
+                "item_default": 10000
+            },
+            {
+                "item_name": "write-behind-batch",
+                "item_type": "integer",
+                "item_optional": true,
+                "item_default": 100
+            },
+            {
+                "item_name": "write-behind-delay",
+                "item_type": "integer",
+                "item_optional": true,
+                "item_default": 10
             }
         ]
       },
@@ -434,6 +550,12 @@
             "command_name": "libreload",
             "command_description": "Reloads the current hooks libraries.",
             "command_args": []
+        },
+
+        {
+            "command_name": "lease-cache-flush",
+            "command_description": "Flushes the cache of the leases of the lease database.",
+            "command_args": []
         }
 
     ]
@@ -31,16 +31,22 @@
 #include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/lease_mgr.h>
 #include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
 #include <dhcpsrv/subnet.h>
 #include <dhcpsrv/utils.h>
 #include <dhcpsrv/utils.h>
 #include <hooks/callout_handle.h>
 #include <hooks/hooks_manager.h>
+#include <hooks/parking_lot.h>
 #include <util/strutil.h>
+#include <util/threads/sync.h>
+#include <util/threads/thread.h>
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <ctime>
 #include <iomanip>
 
 using namespace bundy;
@@ -50,6 +56,10 @@ using namespace bundy::dhcp_ddns;
 using namespace bundy::hooks;
 using namespace bundy::log;
 using namespace std;
+using bundy::util::thread::CondVar;
+using bundy::util::thread::EpochManager;
+using bundy::util::thread::Mutex;
+using bundy::util::thread::Thread;
 
 /// Structure that holds registered hook indexes
 struct Dhcp4Hooks {
@@ -60,7 +70,14 @@ struct Dhcp4Hooks {
     int hook_index_pkt4_send_;      ///< index for "pkt4_send" hook point
     int hook_index_buffer4_send_;   ///< index for "buffer4_send" hook point
 
-    /// Constructor that registers hook points for DHCPv4 engine
+    int arg_query4_;            ///< index of the "query4" argument
+    int arg_response4_;         ///< index of the "response4" argument
+    int arg_lease4_;            ///< index of the "lease4" argument
+    int arg_subnet4_;           ///< index of the "subnet4" argument
+    int arg_subnet4collection_; ///< index of the "subnet4collection" argument
+
+    /// Constructor that registers hook points and callout arguments for
+    /// DHCPv4 engine
     Dhcp4Hooks() {
         hook_index_buffer4_receive_= HooksManager::registerHook("buffer4_receive");
         hook_index_pkt4_receive_   = HooksManager::registerHook("pkt4_receive");
@@ -68,6 +85,13 @@ struct Dhcp4Hooks {
         hook_index_pkt4_send_      = HooksManager::registerHook("pkt4_send");
         hook_index_lease4_release_ = HooksManager::registerHook("lease4_release");
         hook_index_buffer4_send_   = HooksManager::registerHook("buffer4_send");
+
+        arg_query4_            = HooksManager::registerArgument("query4");
+        arg_response4_         = HooksManager::registerArgument("response4");
+        arg_lease4_            = HooksManager::registerArgument("lease4");
+        arg_subnet4_           = HooksManager::registerArgument("subnet4");
+        arg_subnet4collection_ =
+            HooksManager::registerArgument("subnet4collection");
     }
 };
 
@@ -77,15 +101,230 @@ struct Dhcp4Hooks {
 // module is called.
 Dhcp4Hooks Hooks;
 
+namespace {
+
+// The allocation engine of the worker thread (if the calling thread is one).
+pthread_once_t alloc_engine_once = PTHREAD_ONCE_INIT;
+pthread_key_t alloc_engine_key;
+
+void
+createAllocEngineKey() {
+    pthread_key_create(&alloc_engine_key, NULL);
+}
+
+// Maximum number of packets waiting for a worker thread.  More packets are
+// dropped, as a client would retransmit them before they are processed
+// anyway.
+const size_t MAX_WORKER_QUEUE = 1024;
+
+// Offset and maximum length of the client hardware address in the DHCPv4
+// packet header.
+const size_t CHADDR_OFFSET = 28;
+const size_t CHADDR_MAX_LEN = 16;
+
+// Maximum number of packets received at once.
+const size_t RECEIVE_BATCH_SIZE = 64;
+
+}
+
 namespace bundy {
 namespace dhcp {
 
+/// @brief Threads processing packets for the server.
+///
+/// Each worker has a queue of packets to process, its own allocation
+/// engine and (for the database backends) its own lease database
+/// connection.  The received packets are assigned to the workers by the
+/// hardware address of the client, so the packets of a client are
+/// processed in order and never in parallel.
+class Dhcpv4Srv::WorkerPool : public boost::noncopyable {
+public:
+    /// @brief Starts the given number of worker threads.
+    WorkerPool(Dhcpv4Srv& srv, uint32_t count) : srv_(srv), next_(0) {
+        pthread_once(&alloc_engine_once, createAllocEngineKey);
+        try {
+            for (uint32_t i = 0; i < count; ++i) {
+                workers_.push_back(new Worker);
+                workers_.back()->thread.reset(
+                    new Thread(boost::bind(&WorkerPool::run, this,
+                                           workers_.back())));
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+        LOG_INFO(dhcp4_logger, DHCP4_WORKER_THREADS).arg(count);
+    }
+
+    /// @brief Processes the queued packets and stops the threads.
+    ~WorkerPool() {
+        stop();
+    }
+
+    /// @brief Returns the number of worker threads.
+    size_t size() const {
+        return (workers_.size());
+    }
+
+    /// @brief Queues the packet for the worker of the client sending it.
+    ///
+    /// A packet unparked by the callouts is passed with its callout
+    /// handle, and its processing is resumed by the worker.
+    void dispatch(const Pkt4Ptr& query,
+                  const CalloutHandlePtr& callout_handle = CalloutHandlePtr()) {
+        const size_t index = selectWorker(*query);
+        Worker& worker = *workers_[index];
+        {
+            Mutex::Locker locker(worker.mutex);
+            if (worker.queue.size() >= MAX_WORKER_QUEUE) {
+                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL,
+                          DHCP4_WORKER_QUEUE_FULL).arg(index);
+                return;
+            }
+            worker.queue.push(ResumedPacket(query, callout_handle));
+        }
+        worker.cond.signal();
+    }
+
+private:
+    struct Worker {
+        Worker() : engine(AllocEngine::ALLOC_ITERATIVE, 100, false),
+                   stopping(false)
+        {}
+
+        AllocEngine engine;
+        // Protects queue and stopping
+        Mutex mutex;
+        CondVar cond;
+        // The packets, with the callout handles of the unparked ones
+        std::queue<ResumedPacket> queue;
+        bool stopping;
+        boost::scoped_ptr<Thread> thread;
+    };
+
+    // Selects the worker by the hardware address of the client.  This is
+    // done before the packet is parsed, so the address is read from the
+    // raw data.
+    size_t selectWorker(const Pkt4& query) {
+        const std::vector<uint8_t>& data = query.data_;
+        const uint8_t* chaddr = NULL;
+        size_t len = 0;
+        if (data.size() >= CHADDR_OFFSET + CHADDR_MAX_LEN) {
+            chaddr = &data[CHADDR_OFFSET];
+            len = std::min(static_cast<size_t>(data[2]), CHADDR_MAX_LEN);
+        } else if (query.getHWAddr()) {
+            const std::vector<uint8_t>& hwaddr = query.getHWAddr()->hwaddr_;
+            chaddr = hwaddr.empty() ? NULL : &hwaddr[0];
+            len = hwaddr.size();
+        }
+        if (len == 0) {
+            // No address to select by, so spread the packets evenly.
+            return (next_++ % workers_.size());
+        }
+        uint32_t hash = 2166136261U;
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ chaddr[i]) * 16777619U;
+        }
+        return (hash % workers_.size());
+    }
+
+    void run(Worker* worker) {
+        pthread_setspecific(alloc_engine_key, &worker->engine);
+        for (;;) {
+            Pkt4Ptr query;
+            CalloutHandlePtr callout_handle;
+            {
+                Mutex::Locker locker(worker->mutex);
+                while (worker->queue.empty() && !worker->stopping) {
+                    worker->cond.wait(worker->mutex);
+                }
+                if (worker->queue.empty()) {
+                    break;
+                }
+                query.swap(worker->queue.front().first);
+                callout_handle.swap(worker->queue.front().second);
+                worker->queue.pop();
+            }
+
+            // The database backends can't share a connection between
+            // threads.  If the thread has no connection of its own (or
+            // the lease database has been reconfigured), open one.
+            try {
+                LeaseMgrFactory::createSession();
+            } catch (const std::exception& ex) {
+                LOG_ERROR(dhcp4_logger, DHCP4_WORKER_SESSION_FAIL)
+                    .arg(ex.what());
+                continue;
+            }
+
+            try {
+                EpochManager::ReadLocker locker(srv_.packet_processing_);
+                if (callout_handle) {
+                    srv_.resumePacket(query, callout_handle);
+                } else {
+                    srv_.processPacket(query);
+                }
+            } catch (const std::exception& ex) {
+                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC,
+                          DHCP4_PACKET_PROCESS_FAIL)
+                    .arg("unknown").arg(ex.what());
+            }
+
+            // Don't keep the callout handle, which may refer to hooks
+            // libraries being unloaded.
+            callout_handle.reset();
+            getCalloutHandle(Pkt4Ptr());
+
+            // Send the lease changes to the peer server before waiting for
+            // more packets.
+            bool idle;
+            {
+                Mutex::Locker locker(worker->mutex);
+                idle = worker->queue.empty();
+            }
+            if (idle) {
+                const LeaseReplicatorPtr replicator =
+                    LeaseMgrFactory::getReplicator();
+                if (replicator) {
+                    replicator->flush();
+                }
+            }
+        }
+        LeaseMgrFactory::destroySession();
+        pthread_setspecific(alloc_engine_key, NULL);
+    }
+
+    void stop() {
+        BOOST_FOREACH(Worker* worker, workers_) {
+            {
+                Mutex::Locker locker(worker->mutex);
+                worker->stopping = true;
+            }
+            worker->cond.signal();
+        }
+        BOOST_FOREACH(Worker* worker, workers_) {
+            if (worker->thread) {
+                worker->thread->wait();
+            }
+            delete worker;
+        }
+        workers_.clear();
+    }
+
+    Dhcpv4Srv& srv_;
+    std::vector<Worker*> workers_;
+    // For the packets without a hardware address
+    size_t next_;
+};
+
 const std::string Dhcpv4Srv::VENDOR_CLASS_PREFIX("VENDOR_CLASS_");
 
 Dhcpv4Srv::Dhcpv4Srv(uint16_t port, const char* dbconfig, const bool use_bcast,
                      const bool direct_response_desired)
 : shutdown_(true), alloc_engine_(), port_(port),
-    use_bcast_(use_bcast), hook_index_pkt4_receive_(-1),
+    use_bcast_(use_bcast), received_next_(0), next_reclaim_(0),
+    replication_socket_(-1),
+    hook_index_pkt4_receive_(-1),
     hook_index_subnet4_select_(-1), hook_index_pkt4_send_(-1) {
 
     LOG_DEBUG(dhcp4_logger, DBG_DHCP4_START, DHCP4_OPEN_SOCKET).arg(port);
@@ -139,6 +378,13 @@ Dhcpv4Srv::Dhcpv4Srv(uint16_t port, const char* dbconfig, const bool use_bcast,
 }
 
 Dhcpv4Srv::~Dhcpv4Srv() {
+    workers_.reset();
+
+    // The parked packets would be resumed by this server.
+    HooksManager::clearParkingLots();
+    if (replication_socket_ >= 0) {
+        IfaceMgr::instance().deleteExternalSocket(replication_socket_);
+    }
     IfaceMgr::instance().closeSockets();
 }
 
@@ -150,7 +396,40 @@ Dhcpv4Srv::shutdown() {
 
 Pkt4Ptr
 Dhcpv4Srv::receivePacket(int timeout) {
-    return (IfaceMgr::instance().receive4(timeout));
+    if (received_next_ == received_.size()) {
+        received_.clear();
+        received_next_ = 0;
+        IfaceMgr::instance().receiveBatch4(received_, RECEIVE_BATCH_SIZE,
+                                           timeout);
+        if (received_.empty()) {
+            return (Pkt4Ptr());
+        }
+    }
+    Pkt4Ptr pkt;
+    pkt.swap(received_[received_next_++]);
+    return (pkt);
+}
+
+void
+Dhcpv4Srv::updateReplication() {
+    const LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    const int socket = replicator ? replicator->getSocket() : -1;
+    if (socket != replication_socket_) {
+        if (replication_socket_ >= 0) {
+            IfaceMgr::instance().deleteExternalSocket(replication_socket_);
+        }
+        if (socket >= 0) {
+            IfaceMgr::instance().addExternalSocket(
+                socket, LeaseMgrFactory::receiveReplication);
+        }
+        replication_socket_ = socket;
+    }
+
+    // The changes are sent in batches, so not after each packet of a
+    // batch of received packets.
+    if (replicator && (received_next_ == received_.size())) {
+        replicator->flush();
+    }
 }
 
 void
@@ -161,13 +440,38 @@ Dhcpv4Srv::sendPacket(const Pkt4Ptr& packet) {
 bool
 Dhcpv4Srv::run() {
     while (!shutdown_) {
-        /// @todo: calculate actual timeout once we have lease database
-        //cppcheck-suppress variableScope This is temporary anyway
-        const int timeout = 1000;
+        // Start or stop the worker threads if their configured number
+        // changed.
+        const uint32_t worker_count = CfgMgr::instance().getWorkerThreads();
+        if (worker_count != (workers_ ? workers_->size() : 0)) {
+            workers_.reset();
+            if (worker_count > 0) {
+                workers_.reset(new WorkerPool(*this, worker_count));
+            }
+        }
+
+        // The expired leases are reclaimed a batch at a time between the
+        // packets, so the sockets are not waited for beyond the next
+        // reclamation.
+        int timeout = 1000;
+        const uint32_t reclaim_wait =
+            CfgMgr::instance().getReclaimTimerWaitTime();
+        if (reclaim_wait > 0) {
+            const time_t now = time(NULL);
+            if (now >= next_reclaim_) {
+                reclaimExpiredLeases(CfgMgr::instance().getMaxReclaimLeases());
+                next_reclaim_ = now + reclaim_wait;
+            } else if (next_reclaim_ > now + reclaim_wait) {
+                // The interval was shortened by a reconfiguration.
+                next_reclaim_ = now + reclaim_wait;
+            }
+            timeout = std::min<time_t>(timeout, next_reclaim_ - now);
+        }
+
+        updateReplication();
 
-        // client's message and server's response
+        // client's message
         Pkt4Ptr query;
-        Pkt4Ptr rsp;
 
         try {
             query = receivePacket(timeout);
@@ -175,258 +479,397 @@ Dhcpv4Srv::run() {
             LOG_ERROR(dhcp4_logger, DHCP4_PACKET_RECEIVE_FAIL).arg(e.what());
         }
 
+        // The callouts unpark the packets from the callbacks of their
+        // external sockets, called while the packets are received.
+        resumePackets();
+
         // Timeout may be reached or signal received, which breaks select()
         // with no reception ocurred
         if (!query) {
             continue;
         }
 
-        // In order to parse the DHCP options, the server needs to use some
-        // configuration information such as: existing option spaces, option
-        // definitions etc. This is the kind of information which is not
-        // available in the libdhcp, so we need to supply our own implementation
-        // of the option parsing function here, which would rely on the
-        // configuration data.
-        query->setCallback(boost::bind(&Dhcpv4Srv::unpackOptions, this,
-                                       _1, _2, _3));
-
-        bool skip_unpack = false;
-
-        // The packet has just been received so contains the uninterpreted wire
-        // data; execute callouts registered for buffer4_receive.
-        if (HooksManager::calloutsPresent(Hooks.hook_index_buffer4_receive_)) {
-            CalloutHandlePtr callout_handle = getCalloutHandle(query);
+        if (workers_) {
+            workers_->dispatch(query);
+        } else {
+            try {
+                processPacket(query);
+            } catch (const std::exception& ex) {
+                // As options are unpacked lazily, an option which is not
+                // valid may be found outside of the processing of the
+                // message type.
+                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC,
+                          DHCP4_PACKET_PROCESS_FAIL)
+                    .arg("unknown").arg(ex.what());
+            }
+        }
+    }
 
-            // Delete previously set arguments
-            callout_handle->deleteAllArguments();
+    // Let the worker threads finish the packets they have received.
+    workers_.reset();
 
-            // Pass incoming packet as argument
-            callout_handle->setArgument("query4", query);
+    return (true);
+}
 
-            // Call callouts
-            HooksManager::callCallouts(Hooks.hook_index_buffer4_receive_,
-                                       *callout_handle);
+void
+Dhcpv4Srv::processPacket(Pkt4Ptr& query) {
+    // In order to parse the DHCP options, the server needs to use some
+    // configuration information such as: existing option spaces, option
+    // definitions etc. This is the kind of information which is not
+    // available in the libdhcp, so we need to supply our own implementation
+    // of the option parsing function here, which would rely on the
+    // configuration data.
+    query->setCallback(boost::bind(&Dhcpv4Srv::unpackOptions, this,
+                                   _1, _2, _3));
+
+    // Only the options the server (or the callouts) look at are parsed.
+    // The content of an option is checked when it is first requested, so
+    // an option which is not valid may only be found while processing
+    // the packet.
+    query->setLazyUnpack(true);
+
+    bool skip_unpack = false;
+
+    // The packet has just been received so contains the uninterpreted wire
+    // data; execute callouts registered for buffer4_receive.
+    if (HooksManager::calloutsPresent(Hooks.hook_index_buffer4_receive_)) {
+        CalloutHandlePtr callout_handle = getCalloutHandle(query);
+
+        // Delete previously set arguments
+        callout_handle->deleteAllArguments();
 
-            // Callouts decided to skip the next processing step. The next
-            // processing step would to parse the packet, so skip at this
-            // stage means that callouts did the parsing already, so server
-            // should skip parsing.
-            if (callout_handle->getSkip()) {
-                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_BUFFER_RCVD_SKIP);
-                skip_unpack = true;
-            }
+        // Pass incoming packet as argument
+        callout_handle->setArgument(Hooks.arg_query4_, query);
 
-            callout_handle->getArgument("query4", query);
-        }
+        // Call callouts
+        HooksManager::callCallouts(Hooks.hook_index_buffer4_receive_,
+                                   *callout_handle);
 
-        // Unpack the packet information unless the buffer4_receive callouts
-        // indicated they did it
-        if (!skip_unpack) {
-            try {
-                query->unpack();
-            } catch (const std::exception& e) {
-                // Failed to parse the packet.
-                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL,
-                          DHCP4_PACKET_PARSE_FAIL).arg(e.what());
-                continue;
-            }
+        // Callouts decided to skip the next processing step. The next
+        // processing step would to parse the packet, so skip at this
+        // stage means that callouts did the parsing already, so server
+        // should skip parsing.
+        if (callout_handle->getSkip()) {
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_BUFFER_RCVD_SKIP);
+            skip_unpack = true;
         }
 
-        // Assign this packet to one or more classes if needed. We need to do
-        // this before calling accept(), because getSubnet4() may need client
-        // class information.
-        classifyPacket(query);
+        callout_handle->getArgument(Hooks.arg_query4_, query);
+    }
 
-        // Check whether the message should be further processed or discarded.
-        // There is no need to log anything here. This function logs by itself.
-        if (!accept(query)) {
-            continue;
+    // Unpack the packet information unless the buffer4_receive callouts
+    // indicated they did it
+    if (!skip_unpack) {
+        try {
+            query->unpack();
+        } catch (const std::exception& e) {
+            // Failed to parse the packet.
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL,
+                      DHCP4_PACKET_PARSE_FAIL).arg(e.what());
+            return;
         }
+    }
 
-        // We have sanity checked (in accept() that the Message Type option
-        // exists, so we can safely get it here.
-        int type = query->getType();
-        LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL, DHCP4_PACKET_RECEIVED)
-            .arg(serverReceivedPacketName(type))
-            .arg(type)
-            .arg(query->getIface());
-        LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL_DATA, DHCP4_QUERY_DATA)
-            .arg(type)
-            .arg(query->toText());
+    // An option which is not valid is only found when it is read: check
+    // the options read by the server before anything is done for the
+    // packet.
+    if (!acceptOptions(query)) {
+        return;
+    }
 
-        // Let's execute all callouts registered for pkt4_receive
-        if (HooksManager::calloutsPresent(hook_index_pkt4_receive_)) {
-            CalloutHandlePtr callout_handle = getCalloutHandle(query);
+    // Assign this packet to one or more classes if needed. We need to do
+    // this before calling accept(), because getSubnet4() may need client
+    // class information.
+    classifyPacket(query);
 
-            // Delete previously set arguments
-            callout_handle->deleteAllArguments();
+    // Check whether the message should be further processed or discarded.
+    // There is no need to log anything here. This function logs by itself.
+    if (!accept(query)) {
+        return;
+    }
 
-            // Pass incoming packet as argument
-            callout_handle->setArgument("query4", query);
+    // We have sanity checked (in accept() that the Message Type option
+    // exists, so we can safely get it here.
+    int type = query->getType();
+    LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL, DHCP4_PACKET_RECEIVED)
+        .arg(serverReceivedPacketName(type))
+        .arg(type)
+        .arg(query->getIface());
+    LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL_DATA, DHCP4_QUERY_DATA)
+        .arg(type)
+        .arg(query->toText());
 
-            // Call callouts
-            HooksManager::callCallouts(hook_index_pkt4_receive_,
-                                       *callout_handle);
+    // Let's execute all callouts registered for pkt4_receive
+    if (HooksManager::calloutsPresent(hook_index_pkt4_receive_)) {
+        CalloutHandlePtr callout_handle = getCalloutHandle(query);
 
-            // Callouts decided to skip the next processing step. The next
-            // processing step would to process the packet, so skip at this
-            // stage means drop.
-            if (callout_handle->getSkip()) {
-                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_PACKET_RCVD_SKIP);
-                continue;
-            }
+        // Delete previously set arguments
+        callout_handle->deleteAllArguments();
+
+        // Pass incoming packet as argument
+        callout_handle->setArgument(Hooks.arg_query4_, query);
+
+        // The callouts may park the packet to suspend its processing.  It
+        // is parked before they are called, so they can unpark it (from
+        // another thread) before they return.
+        ParkingLotPtr parking_lot =
+            HooksManager::getParkingLot(hook_index_pkt4_receive_);
+        const bool parked =
+            parking_lot->park(query, boost::bind(&Dhcpv4Srv::unparkPacket,
+                                                 this, query, callout_handle),
+                              CfgMgr::instance().getParkedPacketLimit());
+
+        // Call callouts
+        HooksManager::callCallouts(hook_index_pkt4_receive_,
+                                   *callout_handle);
 
-            callout_handle->getArgument("query4", query);
+        // Callouts decided to skip the next processing step. The next
+        // processing step would to process the packet, so skip at this
+        // stage means drop.
+        if (callout_handle->getSkip()) {
+            parking_lot->drop(query);
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_PACKET_RCVD_SKIP);
+            return;
         }
 
-        try {
-            switch (query->getType()) {
-            case DHCPDISCOVER:
-                rsp = processDiscover(query);
-                break;
-
-            case DHCPREQUEST:
-                // Note that REQUEST is used for many things in DHCPv4: for
-                // requesting new leases, renewing existing ones and even
-                // for rebinding.
-                rsp = processRequest(query);
-                break;
-
-            case DHCPRELEASE:
-                processRelease(query);
-                break;
-
-            case DHCPDECLINE:
-                processDecline(query);
-                break;
-
-            case DHCPINFORM:
-                processInform(query);
-                break;
-
-            default:
-                // Only action is to output a message if debug is enabled,
-                // and that is covered by the debug statement before the
-                // "switch" statement.
-                ;
+        // Callouts kept the packet parked: its processing is resumed when
+        // they unpark it.  If there was no room for it in the lot, it is
+        // dropped.
+        if (callout_handle->getPark()) {
+            if (parked) {
+                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS,
+                          DHCP4_HOOK_PACKET_RCVD_PARK);
+            } else {
+                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS,
+                          DHCP4_HOOK_PACKET_PARK_LIMIT)
+                    .arg(CfgMgr::instance().getParkedPacketLimit());
             }
-        } catch (const bundy::Exception& e) {
+            return;
+        }
+        parking_lot->drop(query);
 
-            // Catch-all exception (at least for ones based on the isc
-            // Exception class, which covers more or less all that
-            // are explicitly raised in the BUNDY code).  Just log
-            // the problem and ignore the packet. (The problem is logged
-            // as a debug message because debug is disabled by default -
-            // it prevents a DDOS attack based on the sending of problem
-            // packets.)
-            if (dhcp4_logger.isDebugEnabled(DBG_DHCP4_BASIC)) {
-                std::string source = "unknown";
-                HWAddrPtr hwptr = query->getHWAddr();
-                if (hwptr) {
-                    source = hwptr->toText();
-                }
-                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC,
-                          DHCP4_PACKET_PROCESS_FAIL)
-                    .arg(source).arg(e.what());
+        callout_handle->getArgument(Hooks.arg_query4_, query);
+    }
+
+    processQuery(query);
+}
+
+void
+Dhcpv4Srv::processQuery(Pkt4Ptr& query) {
+    // server's response
+    Pkt4Ptr rsp;
+
+    try {
+        switch (query->getType()) {
+        case DHCPDISCOVER:
+            rsp = processDiscover(query);
+            break;
+
+        case DHCPREQUEST:
+            // Note that REQUEST is used for many things in DHCPv4: for
+            // requesting new leases, renewing existing ones and even
+            // for rebinding.
+            rsp = processRequest(query);
+            break;
+
+        case DHCPRELEASE:
+            processRelease(query);
+            break;
+
+        case DHCPDECLINE:
+            processDecline(query);
+            break;
+
+        case DHCPINFORM:
+            processInform(query);
+            break;
+
+        default:
+            // Only action is to output a message if debug is enabled,
+            // and that is covered by the debug statement before the
+            // "switch" statement.
+            ;
+        }
+    } catch (const bundy::Exception& e) {
+
+        // Catch-all exception (at least for ones based on the isc
+        // Exception class, which covers more or less all that
+        // are explicitly raised in the BUNDY code).  Just log
+        // the problem and ignore the packet. (The problem is logged
+        // as a debug message because debug is disabled by default -
+        // it prevents a DDOS attack based on the sending of problem
+        // packets.)
+        if (dhcp4_logger.isDebugEnabled(DBG_DHCP4_BASIC)) {
+            std::string source = "unknown";
+            HWAddrPtr hwptr = query->getHWAddr();
+            if (hwptr) {
+                source = hwptr->toText();
             }
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC,
+                      DHCP4_PACKET_PROCESS_FAIL)
+                .arg(source).arg(e.what());
         }
+    }
 
-        if (!rsp) {
-            continue;
+    if (!rsp) {
+        return;
+    }
+
+    // A lease must be stored before it is acknowledged to the client.
+    if (rsp->getType() == DHCPACK) {
+        try {
+            LeaseMgrFactory::instance().waitForWrites();
+        } catch (const bundy::Exception& e) {
+            HWAddrPtr hwptr = query->getHWAddr();
+            LOG_ERROR(dhcp4_logger, DHCP4_LEASE_WRITE_FAIL)
+                .arg(hwptr ? hwptr->toText() : std::string("unknown"))
+                .arg(e.what());
+            return;
         }
+    }
 
-        // Let's do class specific processing. This is done before
-        // pkt4_send.
-        //
-        /// @todo: decide whether we want to add a new hook point for
-        /// doing class specific processing.
-        if (!classSpecificProcessing(query, rsp)) {
-            /// @todo add more verbosity here
-            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC, DHCP4_CLASS_PROCESSING_FAILED);
+    // Let's do class specific processing. This is done before
+    // pkt4_send.
+    //
+    /// @todo: decide whether we want to add a new hook point for
+    /// doing class specific processing.
+    if (!classSpecificProcessing(query, rsp)) {
+        /// @todo add more verbosity here
+        LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC, DHCP4_CLASS_PROCESSING_FAILED);
 
-            continue;
+        return;
+    }
+
+    // Specifies if server should do the packing
+    bool skip_pack = false;
+
+    // Execute all callouts registered for pkt4_send
+    if (HooksManager::calloutsPresent(hook_index_pkt4_send_)) {
+        CalloutHandlePtr callout_handle = getCalloutHandle(query);
+
+        // Delete all previous arguments
+        callout_handle->deleteAllArguments();
+
+        // Clear skip flag if it was set in previous callouts
+        callout_handle->setSkip(false);
+
+        // Set our response
+        callout_handle->setArgument(Hooks.arg_response4_, rsp);
+
+        // Call all installed callouts
+        HooksManager::callCallouts(hook_index_pkt4_send_,
+                                   *callout_handle);
+
+        // Callouts decided to skip the next processing step. The next
+        // processing step would to send the packet, so skip at this
+        // stage means "drop response".
+        if (callout_handle->getSkip()) {
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_PACKET_SEND_SKIP);
+            skip_pack = true;
         }
+    }
 
-        // Specifies if server should do the packing
-        bool skip_pack = false;
+    if (!skip_pack) {
+        try {
+            rsp->pack();
+        } catch (const std::exception& e) {
+            LOG_ERROR(dhcp4_logger, DHCP4_PACKET_SEND_FAIL)
+                .arg(e.what());
+        }
+    }
 
-        // Execute all callouts registered for pkt4_send
-        if (HooksManager::calloutsPresent(hook_index_pkt4_send_)) {
+    try {
+        // Now all fields and options are constructed into output wire buffer.
+        // Option objects modification does not make sense anymore. Hooks
+        // can only manipulate wire buffer at this stage.
+        // Let's execute all callouts registered for buffer4_send
+        if (HooksManager::calloutsPresent(Hooks.hook_index_buffer4_send_)) {
             CalloutHandlePtr callout_handle = getCalloutHandle(query);
 
-            // Delete all previous arguments
+            // Delete previously set arguments
             callout_handle->deleteAllArguments();
 
-            // Clear skip flag if it was set in previous callouts
-            callout_handle->setSkip(false);
-
-            // Set our response
-            callout_handle->setArgument("response4", rsp);
+            // Pass incoming packet as argument
+            callout_handle->setArgument(Hooks.arg_response4_, rsp);
 
-            // Call all installed callouts
-            HooksManager::callCallouts(hook_index_pkt4_send_,
+            // Call callouts
+            HooksManager::callCallouts(Hooks.hook_index_buffer4_send_,
                                        *callout_handle);
 
             // Callouts decided to skip the next processing step. The next
-            // processing step would to send the packet, so skip at this
-            // stage means "drop response".
+            // processing step would to parse the packet, so skip at this
+            // stage means drop.
             if (callout_handle->getSkip()) {
-                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_PACKET_SEND_SKIP);
-                skip_pack = true;
+                LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS,
+                          DHCP4_HOOK_BUFFER_SEND_SKIP);
+                return;
             }
-        }
 
-        if (!skip_pack) {
-            try {
-                rsp->pack();
-            } catch (const std::exception& e) {
-                LOG_ERROR(dhcp4_logger, DHCP4_PACKET_SEND_FAIL)
-                    .arg(e.what());
-            }
+            callout_handle->getArgument(Hooks.arg_response4_, rsp);
         }
 
-        try {
-            // Now all fields and options are constructed into output wire buffer.
-            // Option objects modification does not make sense anymore. Hooks
-            // can only manipulate wire buffer at this stage.
-            // Let's execute all callouts registered for buffer4_send
-            if (HooksManager::calloutsPresent(Hooks.hook_index_buffer4_send_)) {
-                CalloutHandlePtr callout_handle = getCalloutHandle(query);
-
-                // Delete previously set arguments
-                callout_handle->deleteAllArguments();
-
-                // Pass incoming packet as argument
-                callout_handle->setArgument("response4", rsp);
-
-                // Call callouts
-                HooksManager::callCallouts(Hooks.hook_index_buffer4_send_,
-                                           *callout_handle);
-
-                // Callouts decided to skip the next processing step. The next
-                // processing step would to parse the packet, so skip at this
-                // stage means drop.
-                if (callout_handle->getSkip()) {
-                    LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS,
-                              DHCP4_HOOK_BUFFER_SEND_SKIP);
-                    continue;
-                }
+        LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL_DATA,
+                  DHCP4_RESPONSE_DATA)
+            .arg(static_cast<int>(rsp->getType())).arg(rsp->toText());
 
-                callout_handle->getArgument("response4", rsp);
-            }
+        sendPacket(rsp);
+    } catch (const std::exception& e) {
+        LOG_ERROR(dhcp4_logger, DHCP4_PACKET_SEND_FAIL)
+            .arg(e.what());
+    }
+}
 
-            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL_DATA,
-                      DHCP4_RESPONSE_DATA)
-                .arg(static_cast<int>(rsp->getType())).arg(rsp->toText());
+void
+Dhcpv4Srv::unparkPacket(const Pkt4Ptr& query,
+                        const CalloutHandlePtr& callout_handle) {
+    Mutex::Locker locker(resumed_mutex_);
+    resumed_.push_back(ResumedPacket(query, callout_handle));
+}
 
-            sendPacket(rsp);
-        } catch (const std::exception& e) {
-            LOG_ERROR(dhcp4_logger, DHCP4_PACKET_SEND_FAIL)
-                .arg(e.what());
+void
+Dhcpv4Srv::resumePackets() {
+    std::vector<ResumedPacket> resumed;
+    {
+        Mutex::Locker locker(resumed_mutex_);
+        if (resumed_.empty()) {
+            return;
         }
+        resumed.swap(resumed_);
     }
 
-    return (true);
+    BOOST_FOREACH(ResumedPacket& packet, resumed) {
+        if (workers_) {
+            workers_->dispatch(packet.first, packet.second);
+            continue;
+        }
+        try {
+            resumePacket(packet.first, packet.second);
+        } catch (const std::exception& ex) {
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC,
+                      DHCP4_PACKET_PROCESS_FAIL)
+                .arg("unknown").arg(ex.what());
+        }
+    }
+}
+
+void
+Dhcpv4Srv::resumePacket(Pkt4Ptr& query,
+                        const CalloutHandlePtr& callout_handle) {
+    LOG_DEBUG(dhcp4_logger, DBG_DHCP4_HOOKS, DHCP4_HOOK_PACKET_RCVD_RESUME);
+
+    // The callouts may have replaced the packet before they unparked it.
+    callout_handle->getArgument(Hooks.arg_query4_, query);
+    setCalloutHandle(query, callout_handle);
+
+    processQuery(query);
+}
+
+AllocEngine&
+Dhcpv4Srv::getAllocEngine() {
+    pthread_once(&alloc_engine_once, createAllocEngineKey);
+    AllocEngine* engine =
+        static_cast<AllocEngine*>(pthread_getspecific(alloc_engine_key));
+    return (engine != NULL ? *engine : *alloc_engine_);
 }
 
 string
@@ -564,8 +1007,7 @@ Dhcpv4Srv::appendServerID(const Pkt4Ptr& response) {
 }
 
 void
-Dhcpv4Srv::appendRequestedOptions(const Pkt4Ptr& question, Pkt4Ptr& msg) {
-
+Dhcpv4Srv::appendConfiguredOptions(const Pkt4Ptr& question, Pkt4Ptr& msg) {
     // Get the subnet relevant for the client. We will need it
     // to get the options associated with it.
     Subnet4Ptr subnet = selectSubnet(question);
@@ -577,10 +1019,66 @@ Dhcpv4Srv::appendRequestedOptions(const Pkt4Ptr& question, Pkt4Ptr& msg) {
         return;
     }
 
-    // try to get the 'Parameter Request List' option which holds the
-    // codes of requested options.
+    // The options sent depend only on the subnet and on the codes of the
+    // options requested by the client, in the PRL and in the vendor ORO.
+    // They are packed once for all the clients requesting the same codes
+    // and kept by the subnet.
     OptionUint8ArrayPtr option_prl = boost::dynamic_pointer_cast<
         OptionUint8Array>(question->getOption(DHO_DHCP_PARAMETER_REQUEST_LIST));
+    boost::shared_ptr<OptionVendor> vendor_req =
+        boost::dynamic_pointer_cast<OptionVendor>(question->getOption(DHO_VIVSO_SUBOPTIONS));
+    // Let's try to get ORO within that vendor-option
+    /// @todo This is very specific to vendor-id=4491 (Cable Labs). Other
+    /// vendors may have different policies.
+    OptionUint8ArrayPtr oro;
+    if (vendor_req) {
+        oro = boost::dynamic_pointer_cast<OptionUint8Array>(vendor_req->getOption(DOCSIS3_V4_ORO));
+    }
+
+    // The key is made of the number of codes in the PRL and the codes,
+    // followed by the vendor-id and the codes of the ORO if any.
+    std::vector<uint8_t> key;
+    if (option_prl) {
+        const std::vector<uint8_t>& requested_opts = option_prl->getValues();
+        key.push_back(requested_opts.size());
+        key.insert(key.end(), requested_opts.begin(), requested_opts.end());
+    } else {
+        key.push_back(0);
+    }
+    if (oro) {
+        const uint32_t vendor_id = vendor_req->getVendorId();
+        key.push_back(vendor_id >> 24);
+        key.push_back(vendor_id >> 16);
+        key.push_back(vendor_id >> 8);
+        key.push_back(vendor_id);
+        const std::vector<uint8_t>& requested_opts = oro->getValues();
+        key.insert(key.end(), requested_opts.begin(), requested_opts.end());
+    }
+
+    ConstPackedOptionsPtr packed = subnet->getPackedOptions(key);
+    if (!packed) {
+        OptionCollection options;
+        appendRequestedOptions(option_prl, subnet, options);
+        if (oro) {
+            appendRequestedVendorOptions(vendor_req->getVendorId(), oro,
+                                         subnet, options);
+        }
+        // There are a few basic options that we always want to
+        // include in the response. If client did not request
+        // them we append them for him.
+        appendBasicOptions(subnet, options);
+        packed.reset(new PackedOptions(options));
+        subnet->setPackedOptions(key, packed);
+    }
+    // The options already in the message (e.g. those added by assignLease)
+    // are not replaced.
+    msg->addOptions(packed);
+}
+
+void
+Dhcpv4Srv::appendRequestedOptions(const OptionUint8ArrayPtr& option_prl,
+                                  const Subnet4Ptr& subnet,
+                                  OptionCollection& options) {
     // If there is no PRL option in the message from the client then
     // there is nothing to do.
     if (!option_prl) {
@@ -593,46 +1091,22 @@ Dhcpv4Srv::appendRequestedOptions(const Pkt4Ptr& question, Pkt4Ptr& msg) {
     // to be returned to the client.
     for (std::vector<uint8_t>::const_iterator opt = requested_opts.begin();
          opt != requested_opts.end(); ++opt) {
-        if (!msg->getOption(*opt)) {
+        if (options.find(*opt) == options.end()) {
             Subnet::OptionDescriptor desc =
                 subnet->getOptionDescriptor("dhcp4", *opt);
-            if (desc.option && !msg->getOption(*opt)) {
-                msg->addOption(desc.option);
+            if (desc.option) {
+                options.insert(std::make_pair(*opt, desc.option));
             }
         }
     }
 }
 
 void
-Dhcpv4Srv::appendRequestedVendorOptions(const Pkt4Ptr& question, Pkt4Ptr& answer) {
-    // Get the configured subnet suitable for the incoming packet.
-    Subnet4Ptr subnet = selectSubnet(question);
-    // Leave if there is no subnet matching the incoming packet.
-    // There is no need to log the error message here because
-    // it will be logged in the assignLease() when it fails to
-    // pick the suitable subnet. We don't want to duplicate
-    // error messages in such case.
-    if (!subnet) {
-        return;
-    }
-
-    // Try to get the vendor option
-    boost::shared_ptr<OptionVendor> vendor_req =
-        boost::dynamic_pointer_cast<OptionVendor>(question->getOption(DHO_VIVSO_SUBOPTIONS));
-    if (!vendor_req) {
-        return;
-    }
-
-    uint32_t vendor_id = vendor_req->getVendorId();
-
-    // Let's try to get ORO within that vendor-option
-    /// @todo This is very specific to vendor-id=4491 (Cable Labs). Other
-    /// vendors may have different policies.
-    OptionUint8ArrayPtr oro =
-        boost::dynamic_pointer_cast<OptionUint8Array>(vendor_req->getOption(DOCSIS3_V4_ORO));
-
-    // Option ORO not found. Don't do anything then.
-    if (!oro) {
+Dhcpv4Srv::appendRequestedVendorOptions(uint32_t vendor_id,
+                                        const OptionUint8ArrayPtr& oro,
+                                        const Subnet4Ptr& subnet,
+                                        OptionCollection& options) {
+    if (options.find(DHO_VIVSO_SUBOPTIONS) != options.end()) {
         return;
     }
 
@@ -652,16 +1126,17 @@ Dhcpv4Srv::appendRequestedVendorOptions(const Pkt4Ptr& question, Pkt4Ptr& answer
                 added = true;
             }
         }
+    }
 
-        if (added) {
-            answer->addOption(vendor_rsp);
-        }
+    if (added) {
+        options.insert(std::make_pair(DHO_VIVSO_SUBOPTIONS, vendor_rsp));
     }
 }
 
 
 void
-Dhcpv4Srv::appendBasicOptions(const Pkt4Ptr& question, Pkt4Ptr& msg) {
+Dhcpv4Srv::appendBasicOptions(const Subnet4Ptr& subnet,
+                              OptionCollection& options) {
     // Identify options that we always want to send to the
     // client (if they are configured).
     static const uint16_t required_options[] = {
@@ -672,22 +1147,16 @@ Dhcpv4Srv::appendBasicOptions(const Pkt4Ptr& question, Pkt4Ptr& msg) {
     static size_t required_options_size =
         sizeof(required_options) / sizeof(required_options[0]);
 
-    // Get the subnet.
-    Subnet4Ptr subnet = selectSubnet(question);
-    if (!subnet) {
-        return;
-    }
-
     // Try to find all 'required' options in the outgoing
-    // message. Those that are not present will be added.
+    // options. Those that are not present will be added.
     for (int i = 0; i < required_options_size; ++i) {
-        OptionPtr opt = msg->getOption(required_options[i]);
-        if (!opt) {
+        if (options.find(required_options[i]) == options.end()) {
             // Check whether option has been configured.
             Subnet::OptionDescriptor desc =
                 subnet->getOptionDescriptor("dhcp4", required_options[i]);
             if (desc.option) {
-                msg->addOption(desc.option);
+                options.insert(std::make_pair(required_options[i],
+                                              desc.option));
             }
         }
     }
@@ -862,6 +1331,29 @@ Dhcpv4Srv::createNameChangeRequests(const Lease4Ptr& lease,
     queueNameChangeRequest(bundy::dhcp_ddns::CHG_ADD, lease);
 }
 
+void
+Dhcpv4Srv::reclaimExpiredLeases(size_t max_leases) {
+    try {
+        const Lease4Collection reclaimed =
+            AllocEngine::reclaimExpiredLeases4(max_leases);
+        if (reclaimed.empty()) {
+            return;
+        }
+        LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC, DHCP4_LEASES_RECLAIMED)
+            .arg(reclaimed.size());
+
+        if (CfgMgr::instance().ddnsEnabled()) {
+            // Remove the DNS entries of the leases, if any.
+            for (Lease4Collection::const_iterator lease = reclaimed.begin();
+                 lease != reclaimed.end(); ++lease) {
+                queueNameChangeRequest(bundy::dhcp_ddns::CHG_REMOVE, *lease);
+            }
+        }
+    } catch (const std::exception& ex) {
+        LOG_ERROR(dhcp4_logger, DHCP4_LEASES_RECLAIM_FAIL).arg(ex.what());
+    }
+}
+
 void
 Dhcpv4Srv::
 queueNameChangeRequest(const bundy::dhcp_ddns::NameChangeType chg_type,
@@ -956,7 +1448,12 @@ Dhcpv4Srv::assignLease(const Pkt4Ptr& question, Pkt4Ptr& answer) {
     // allocation.
     bool fake_allocation = (question->getType() == DHCPDISCOVER);
 
-    CalloutHandlePtr callout_handle = getCalloutHandle(question);
+    // The callout handle is set up only if there are lease callouts to use
+    // it; the allocation engine doesn't call them without it.
+    CalloutHandlePtr callout_handle;
+    if (AllocEngine::leaseCalloutsPresent4()) {
+        callout_handle = getCalloutHandle(question);
+    }
 
     std::string hostname;
     bool fqdn_fwd = false;
@@ -994,7 +1491,7 @@ Dhcpv4Srv::assignLease(const Pkt4Ptr& question, Pkt4Ptr& answer) {
     // be inserted into the LeaseMgr as well.
     /// @todo pass the actual FQDN data.
     Lease4Ptr old_lease;
-    Lease4Ptr lease = alloc_engine_->allocateLease4(subnet, client_id, hwaddr,
+    Lease4Ptr lease = getAllocEngine().allocateLease4(subnet, client_id, hwaddr,
                                                       hint, fqdn_fwd, fqdn_rev,
                                                       hostname,
                                                     fake_allocation,
@@ -1198,12 +1695,7 @@ Dhcpv4Srv::processDiscover(Pkt4Ptr& discover) {
 
     // Adding any other options makes sense only when we got the lease.
     if (offer->getYiaddr() != IOAddress("0.0.0.0")) {
-        appendRequestedOptions(discover, offer);
-        appendRequestedVendorOptions(discover, offer);
-        // There are a few basic options that we always want to
-        // include in the response. If client did not request
-        // them we append them for him.
-        appendBasicOptions(discover, offer);
+        appendConfiguredOptions(discover, offer);
     }
 
     // Set the src/dest IP address, port and interface for the outgoing
@@ -1240,12 +1732,7 @@ Dhcpv4Srv::processRequest(Pkt4Ptr& request) {
 
     // Adding any other options makes sense only when we got the lease.
     if (ack->getYiaddr() != IOAddress("0.0.0.0")) {
-        appendRequestedOptions(request, ack);
-        appendRequestedVendorOptions(request, ack);
-        // There are a few basic options that we always want to
-        // include in the response. If client did not request
-        // them we append them for him.
-        appendBasicOptions(request, ack);
+        appendConfiguredOptions(request, ack);
     }
 
     // Set the src/dest IP address, port and interface for the outgoing
@@ -1316,10 +1803,10 @@ Dhcpv4Srv::processRelease(Pkt4Ptr& release) {
             callout_handle->deleteAllArguments();
 
             // Pass the original packet
-            callout_handle->setArgument("query4", release);
+            callout_handle->setArgument(Hooks.arg_query4_, release);
 
             // Pass the lease to be updated
-            callout_handle->setArgument("lease4", lease);
+            callout_handle->setArgument(Hooks.arg_lease4_, lease);
 
             // Call all installed callouts
             HooksManager::callCallouts(Hooks.hook_index_lease4_release_,
@@ -1340,6 +1827,12 @@ Dhcpv4Srv::processRelease(Pkt4Ptr& release) {
             bool success = LeaseMgrFactory::instance().deleteLease(lease->addr_);
 
             if (success) {
+                // The address can be allocated again.
+                AllocEngine::addressReleased4(
+                    CfgMgr::instance().getSubnet4(lease->addr_,
+                                                  release->classes_),
+                    lease->addr_);
+
                 // Release successful
                 LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL, DHCP4_RELEASE)
                     .arg(lease->addr_.toText())
@@ -1455,9 +1948,9 @@ Dhcpv4Srv::selectSubnet(const Pkt4Ptr& question) const {
         callout_handle->deleteAllArguments();
 
         // Set new arguments
-        callout_handle->setArgument("query4", question);
-        callout_handle->setArgument("subnet4", subnet);
-        callout_handle->setArgument("subnet4collection",
+        callout_handle->setArgument(Hooks.arg_query4_, question);
+        callout_handle->setArgument(Hooks.arg_subnet4_, subnet);
+        callout_handle->setArgument(Hooks.arg_subnet4collection_,
                                     CfgMgr::instance().getSubnets4());
 
         // Call user (and server-side) callouts
@@ -1474,7 +1967,7 @@ Dhcpv4Srv::selectSubnet(const Pkt4Ptr& question) const {
         }
 
         // Use whatever subnet was specified by the callout
-        callout_handle->getArgument("subnet4", subnet);
+        callout_handle->getArgument(Hooks.arg_subnet4_, subnet);
     }
 
     return (subnet);
@@ -1506,6 +1999,34 @@ Dhcpv4Srv::accept(const Pkt4Ptr& query) const {
         return (false);
     }
 
+    // Check that the client is not answered by the peer server.
+    if (!acceptLoadBalancing(query)) {
+        LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL,
+                  DHCP4_PACKET_DROP_LOAD_BALANCING)
+            .arg(query->getTransid())
+            .arg(query->getIface());
+        return (false);
+    }
+
+    return (true);
+}
+
+bool
+Dhcpv4Srv::acceptLoadBalancing(const Pkt4Ptr& query) const {
+    const LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    if (!replicator) {
+        return (true);
+    }
+    OptionPtr client_id = query->getOption(DHO_DHCP_CLIENT_IDENTIFIER);
+    if (client_id && !client_id->getData().empty()) {
+        const OptionBuffer& id = client_id->getData();
+        return (replicator->inScope(&id[0], id.size()));
+    }
+    HWAddrPtr hwaddr = query->getHWAddr();
+    if (hwaddr && !hwaddr->hwaddr_.empty()) {
+        return (replicator->inScope(&hwaddr->hwaddr_[0],
+                                    hwaddr->hwaddr_.size()));
+    }
     return (true);
 }
 
@@ -1522,6 +2043,32 @@ Dhcpv4Srv::acceptDirectRequest(const Pkt4Ptr& pkt) const {
     return ((pkt->getLocalAddr() != bcast || selectSubnet(pkt)));
 }
 
+bool
+Dhcpv4Srv::acceptOptions(const Pkt4Ptr& query) const {
+    static const uint8_t codes[] = {
+        DHO_DHCP_MESSAGE_TYPE, DHO_DHCP_CLIENT_IDENTIFIER,
+        DHO_DHCP_REQUESTED_ADDRESS, DHO_DHCP_SERVER_IDENTIFIER,
+        DHO_DHCP_PARAMETER_REQUEST_LIST, DHO_HOST_NAME, DHO_FQDN,
+        DHO_VENDOR_CLASS_IDENTIFIER, DHO_VIVSO_SUBOPTIONS,
+        DHO_DHCP_AGENT_OPTIONS
+    };
+    for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i) {
+        try {
+            // Creates the option if it wasn't yet.
+            query->getOption(codes[i]);
+
+        } catch (const std::exception& ex) {
+            LOG_DEBUG(dhcp4_logger, DBG_DHCP4_DETAIL,
+                      DHCP4_PACKET_OPTION_INVALID)
+                .arg(static_cast<int>(codes[i]))
+                .arg(query->getIface())
+                .arg(ex.what());
+            return (false);
+        }
+    }
+    return (true);
+}
+
 bool
 Dhcpv4Srv::acceptMessageType(const Pkt4Ptr& query) const {
     // When receiving a packet without message type option, getType() will
@@ -1709,20 +2256,23 @@ Dhcpv4Srv::unpackOptions(const OptionBuffer& buf,
                          bundy::dhcp::OptionCollection& options) {
     size_t offset = 0;
 
-    OptionDefContainer option_defs;
+    // The option definitions are not copied as this is done for each
+    // packet.
+    static const OptionDefContainer empty_option_defs;
+    const OptionDefContainer* option_defs = &empty_option_defs;
+    OptionDefContainerPtr option_defs_ptr;
     if (option_space == "dhcp4") {
         // Get the list of stdandard option definitions.
-        option_defs = LibDHCP::getOptionDefs(Option::V4);
+        option_defs = &LibDHCP::getOptionDefs(Option::V4);
     } else if (!option_space.empty()) {
-        OptionDefContainerPtr option_defs_ptr =
-            CfgMgr::instance().getOptionDefs(option_space);
+        option_defs_ptr = CfgMgr::instance().getOptionDefs(option_space);
         if (option_defs_ptr != NULL) {
-            option_defs = *option_defs_ptr;
+            option_defs = option_defs_ptr.get();
         }
     }
     // Get the search index #1. It allows to search for option definitions
     // using option code.
-    const OptionDefContainerTypeIndex& idx = option_defs.get<1>();
+    const OptionDefContainerTypeIndex& idx = option_defs->get<1>();
 
     // The buffer being read comprises a set of options, each starting with
     // a one-byte type code and a one-byte length field.
@@ -1804,10 +2354,6 @@ void Dhcpv4Srv::classifyPacket(const Pkt4Ptr& pkt) {
 
     string classes = "";
 
-    if (!vendor_class) {
-        return;
-    }
-
     // DOCSIS specific section
 
     // Let's keep this as a series of checks. So far we're supporting only
@@ -1824,11 +2370,14 @@ void Dhcpv4Srv::classifyPacket(const Pkt4Ptr& pkt) {
     // is indeed a modem, John B. suggested to check whether chaddr field
     // quals subscriber-id option that was inserted by the relay (CMTS).
     // This kind of logic will appear here soon.
-    if (vendor_class->getValue().find(DOCSIS3_CLASS_MODEM) != std::string::npos) {
+    if (!vendor_class) {
+        // The configured classes below may still apply.
+    } else if (vendor_class->getValue().find(DOCSIS3_CLASS_MODEM) !=
+               std::string::npos) {
         pkt->addClass(VENDOR_CLASS_PREFIX + DOCSIS3_CLASS_MODEM);
         classes += string(VENDOR_CLASS_PREFIX + DOCSIS3_CLASS_MODEM) + " ";
-    } else
-    if (vendor_class->getValue().find(DOCSIS3_CLASS_EROUTER) != std::string::npos) {
+    } else if (vendor_class->getValue().find(DOCSIS3_CLASS_EROUTER) !=
+               std::string::npos) {
         pkt->addClass(VENDOR_CLASS_PREFIX + DOCSIS3_CLASS_EROUTER);
         classes += string(VENDOR_CLASS_PREFIX + DOCSIS3_CLASS_EROUTER) + " ";
     } else {
@@ -1836,6 +2385,18 @@ void Dhcpv4Srv::classifyPacket(const Pkt4Ptr& pkt) {
         pkt->addClass(VENDOR_CLASS_PREFIX + vendor_class->getValue());
     }
 
+    // Then the classes of the configuration, whose tests may check the
+    // vendor class above.
+    const ClientClassifierPtr classifier =
+        CfgMgr::instance().getClientClassifier();
+    if (classifier && (classifier->classify(*pkt) > 0) &&
+        dhcp4_logger.isDebugEnabled(DBG_DHCP4_BASIC)) {
+        classes.clear();
+        BOOST_FOREACH(const ClientClass& name, pkt->classes_) {
+            classes += name + " ";
+        }
+    }
+
     if (!classes.empty()) {
         LOG_DEBUG(dhcp4_logger, DBG_DHCP4_BASIC, DHCP4_CLASS_ASSIGNED)
             .arg(classes);
@@ -1,4 +1,4 @@
-// Copyright (C) 2011-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2011-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -21,16 +21,22 @@
 #include <dhcp/option_string.h>
 #include <dhcp/option4_client_fqdn.h>
 #include <dhcp/option_custom.h>
+#include <dhcp/option_int_array.h>
 #include <dhcp_ddns/ncr_msg.h>
 #include <dhcpsrv/d2_client_mgr.h>
 #include <dhcpsrv/subnet.h>
 #include <dhcpsrv/alloc_engine.h>
 #include <hooks/callout_handle.h>
+#include <util/threads/epoch.h>
+#include <util/threads/sync.h>
 
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <iostream>
 #include <queue>
+#include <utility>
+#include <vector>
 
 namespace bundy {
 namespace dhcp {
@@ -101,6 +107,22 @@ public:
     /// their correctness, generates appropriate answer (if needed) and
     /// transmits respones.
     ///
+    /// If worker threads are configured (see
+    /// @c CfgMgr::getWorkerThreads), the received packets are passed to
+    /// the worker threads to be processed in parallel by
+    /// @c processPacket.  All packets of a client (identified by its
+    /// hardware address) are processed by the same thread, in the order
+    /// they were received.  The number of threads is adjusted to the
+    /// configuration before each packet is received.
+    ///
+    /// The processing of the packets parked by the pkt4_receive callouts
+    /// is resumed by this loop (see @c resumePackets) once they are
+    /// unparked.
+    ///
+    /// If the leases are replicated to a peer server, the loop receives
+    /// the changes of the peer (see @c updateReplication) and sends the
+    /// changes of this server when it has no more packets to process.
+    ///
     /// @return true, if being shut down gracefully, fail if experienced
     ///         critical error.
     bool run();
@@ -284,6 +306,35 @@ protected:
     /// @return true, if the server identifier is absent or matches one of the
     /// server identifiers that the server is using; false otherwise.
     bool acceptServerId(const Pkt4Ptr& pkt) const;
+
+    /// @brief Checks if the client is answered by this server.
+    ///
+    /// When the leases are replicated to a peer server sharing the
+    /// clients with this one (see @c LeaseReplicator::inScope), the
+    /// messages of the clients of the peer are dropped.  The clients are
+    /// identified by their client identifier, or by their hardware address
+    /// if they don't send one.
+    ///
+    /// @param query Message sent by a client.
+    ///
+    /// @return true if this server answers the client.
+    bool acceptLoadBalancing(const Pkt4Ptr& query) const;
+
+    /// @brief Checks the options the server reads while processing a message.
+    ///
+    /// As the options of the received messages are unpacked lazily (see
+    /// @c Pkt4::setLazyUnpack), an option whose content is not valid is
+    /// only found when it is first read.  This function reads the options
+    /// used by the server (the message type, client identifier, requested
+    /// address, server identifier, parameter request list, host name,
+    /// client FQDN, vendor options and relay agent information), so such a
+    /// message is dropped before it is classified or a lease is allocated
+    /// for it.
+    ///
+    /// @param query Message sent by a client.
+    ///
+    /// @return true if all these options are valid.
+    bool acceptOptions(const Pkt4Ptr& query) const;
     //@}
 
     /// @brief verifies if specified packet meets RFC requirements
@@ -348,14 +399,37 @@ protected:
     /// @param answer any message server is going to send as response
     void copyDefaultFields(const Pkt4Ptr& question, Pkt4Ptr& answer);
 
-    /// @brief Appends options requested by client.
+    /// @brief Appends the options configured for the client's subnet.
     ///
-    /// This method assigns options that were requested by client
-    /// (sent in PRL) or are enforced by server.
+    /// This method appends the options requested by the client (see
+    /// @ref appendRequestedOptions and @ref appendRequestedVendorOptions)
+    /// and the basic options (see @ref appendBasicOptions), unless the
+    /// message already holds options of the same codes.
+    ///
+    /// Those options depend only on the subnet and on the option codes
+    /// requested by the client, so they are packed once for all the
+    /// clients of the subnet requesting the same codes (see
+    /// @c Subnet::getPackedOptions): when the response is packed, the
+    /// wire format of the options is copied instead of being assembled
+    /// again.
     ///
     /// @param question DISCOVER or REQUEST message from a client.
     /// @param msg outgoing message (options will be added here)
-    void appendRequestedOptions(const Pkt4Ptr& question, Pkt4Ptr& msg);
+    void appendConfiguredOptions(const Pkt4Ptr& question, Pkt4Ptr& msg);
+
+    /// @brief Appends options requested by client.
+    ///
+    /// This method collects the options of the subnet that were requested
+    /// by client (sent in PRL).  Options of codes which are already in the
+    /// collection are not added.
+    ///
+    /// @param option_prl Parameter Request List sent by the client (may be
+    ///        null).
+    /// @param subnet the client's subnet.
+    /// @param [out] options collection the options are added to.
+    void appendRequestedOptions(const OptionUint8ArrayPtr& option_prl,
+                                const Subnet4Ptr& subnet,
+                                OptionCollection& options);
 
     /// @brief Appends requested vendor options as requested by client.
     ///
@@ -365,9 +439,14 @@ protected:
     /// options, each with unique vendor-id). Vendor options are requested
     /// using separate options within their respective vendor-option spaces.
     ///
-    /// @param question DISCOVER or REQUEST message from a client.
-    /// @param answer outgoing message (options will be added here)
-    void appendRequestedVendorOptions(const Pkt4Ptr& question, Pkt4Ptr& answer);
+    /// @param vendor_id vendor-id of the vendor option sent by the client.
+    /// @param oro codes of the vendor options requested by the client.
+    /// @param subnet the client's subnet.
+    /// @param [out] options collection the vendor option is added to.
+    void appendRequestedVendorOptions(uint32_t vendor_id,
+                                      const OptionUint8ArrayPtr& oro,
+                                      const Subnet4Ptr& subnet,
+                                      OptionCollection& options);
 
     /// @brief Assigns a lease and appends corresponding options
     ///
@@ -382,15 +461,15 @@ protected:
     /// @brief Append basic options if they are not present.
     ///
     /// This function adds the following basic options if they
-    /// are not yet added to the message:
-    /// - Subnet Mask,
+    /// are not yet in the collection:
     /// - Router,
     /// - Name Server,
     /// - Domain Name.
     ///
-    /// @param question DISCOVER or REQUEST message from a client.
-    /// @param msg the message to add options to.
-    void appendBasicOptions(const Pkt4Ptr& question, Pkt4Ptr& msg);
+    /// @param subnet the client's subnet.
+    /// @param [out] options collection the options are added to.
+    void appendBasicOptions(const Subnet4Ptr& subnet,
+                            OptionCollection& options);
 
     /// @brief Processes Client FQDN and Hostname Options sent by a client.
     ///
@@ -500,6 +579,17 @@ protected:
     void queueNameChangeRequest(const bundy::dhcp_ddns::NameChangeType chg_type,
                                 const Lease4Ptr& lease);
 
+    /// @brief Reclaims a batch of expired leases.
+    ///
+    /// Deletes the leases expired the longest time ago from the lease
+    /// database (see @c AllocEngine::reclaimExpiredLeases4) and, if DNS
+    /// updates are enabled, queues the removal of their DNS entries.
+    /// The main processing loop calls it periodically.  Errors are logged.
+    ///
+    /// @param max_leases maximum number of leases to reclaim (0 for no
+    ///        limit)
+    void reclaimExpiredLeases(size_t max_leases);
+
     /// @brief Attempts to renew received addresses
     ///
     /// Attempts to renew existing lease. This typically includes finding a lease that
@@ -636,7 +726,11 @@ protected:
     /// initiate server shutdown procedure.
     volatile bool shutdown_;
 
-    /// @brief dummy wrapper around IfaceMgr::receive4
+    /// @brief wrapper around IfaceMgr::receiveBatch4
+    ///
+    /// The packets are received in batches and returned one by one, so
+    /// the sockets are only waited for when all the received packets
+    /// have been returned.
     ///
     /// This method is useful for testing purposes, where its replacement
     /// simulates reception of a packet. For that purpose it is protected.
@@ -679,8 +773,94 @@ protected:
     /// @return true if successful, false otherwise (will prevent sending response)
     bool classSpecificProcessing(const Pkt4Ptr& query, const Pkt4Ptr& rsp);
 
+    /// @brief Processes a received packet and sends the response.
+    ///
+    /// Unpacks the packet, checks whether it should be processed, generates
+    /// the response (calling the installed callouts on the way) and sends
+    /// it.  The packet is dropped if any of these steps fail.
+    ///
+    /// The pkt4_receive callouts may suspend the processing of the packet
+    /// (see @c bundy::hooks::ParkingLot): the packet is then held in the
+    /// parking lot of the hook (up to @c CfgMgr::getParkedPacketLimit
+    /// packets) and this returns at once.  Its processing is resumed by
+    /// @c processQuery once the callouts unpark it.
+    ///
+    /// This is called by the main processing loop or by the worker threads,
+    /// so it may be called by several threads at once.
+    ///
+    /// @param query the received packet
+    void processPacket(Pkt4Ptr& query);
+
+    /// @brief Generates and sends the response to an accepted packet.
+    ///
+    /// This is the part of @c processPacket following the pkt4_receive
+    /// callouts.
+    ///
+    /// @param query the received packet
+    void processQuery(Pkt4Ptr& query);
+
+    /// @brief Resumes the processing of the unparked packets.
+    ///
+    /// Called by the main processing loop.  The unparked packets are
+    /// processed at once, or queued for their worker threads.
+    void resumePackets();
+
+    /// @brief Follows the replication of the leases to the peer server.
+    ///
+    /// Called by the main processing loop.  The socket receiving the
+    /// changes of the peer is registered in @c IfaceMgr (again if the
+    /// lease database was reconfigured), and the changes of this server
+    /// are sent if the last received packets were processed.
+    void updateReplication();
+
+    /// @brief Returns the allocation engine of the calling thread.
+    ///
+    /// Each worker thread has an allocation engine of its own; other
+    /// threads use the engine of the server.
+    AllocEngine& getAllocEngine();
+
+    /// @brief Synchronizes the packet processing with reconfiguration.
+    ///
+    /// The worker threads process each packet within a read section of
+    /// this manager.  Anything changing the configuration used by the
+    /// packet processing (server reconfiguration, reloading the hooks
+    /// libraries, etc.) while there may be worker threads must be done
+    /// in an exclusive section (@c EpochManager::WriteLocker).
+    bundy::util::thread::EpochManager packet_processing_;
+
 private:
 
+    /// @brief Pool of threads processing packets (defined in dhcp4_srv.cc).
+    class WorkerPool;
+
+    /// @brief Packet unparked by the callouts and its callout handle.
+    typedef std::pair<Pkt4Ptr, bundy::hooks::CalloutHandlePtr> ResumedPacket;
+
+    /// @brief Queues a packet unparked by the pkt4_receive callouts.
+    ///
+    /// This is the function given to the parking lot with the packet.  It
+    /// may be called by any thread, so it only queues the packet, whose
+    /// processing is resumed by the main processing loop.  The callouts
+    /// are expected to unpark packets from the callback of an external
+    /// socket (see @c IfaceMgr::addExternalSocket), which is called by the
+    /// main loop while it waits for packets; the packets unparked by other
+    /// threads wait for the loop to wake up.
+    ///
+    /// @param query the parked packet
+    /// @param callout_handle the callout handle of the packet
+    void unparkPacket(const Pkt4Ptr& query,
+                      const bundy::hooks::CalloutHandlePtr& callout_handle);
+
+    /// @brief Resumes the processing of an unparked packet.
+    ///
+    /// The callouts called for the rest of the processing get the callout
+    /// handle of the packet, with the context of their libraries.
+    ///
+    /// @param query the unparked packet
+    /// @param callout_handle the callout handle of the packet
+    void resumePacket(Pkt4Ptr& query,
+                      const bundy::hooks::CalloutHandlePtr& callout_handle);
+
     /// @brief Constructs netmask option based on subnet4
     /// @param subnet subnet for which the netmask will be calculated
     ///
@@ -702,9 +882,31 @@ private:
     /// during normal operation (e.g. to use different allocators)
     boost::shared_ptr<AllocEngine> alloc_engine_;
 
+    /// @brief Threads processing the packets, if any.
+    boost::scoped_ptr<WorkerPool> workers_;
+
     uint16_t port_;  ///< UDP port number on which server listens.
     bool use_bcast_; ///< Should broadcast be enabled on sockets (if true).
 
+    /// @brief Packets received in the last batch.
+    std::vector<Pkt4Ptr> received_;
+
+    /// @brief Index of the next packet of @c received_ to return.
+    size_t received_next_;
+
+    /// @brief Time of the next reclamation of expired leases.
+    time_t next_reclaim_;
+
+    /// @brief Socket receiving the lease changes of the peer server, as
+    /// registered in @c IfaceMgr (-1 if none).
+    int replication_socket_;
+
+    /// @brief Packets unparked by the callouts, waiting to be resumed.
+    std::vector<ResumedPacket> resumed_;
+
+    /// @brief Protects @c resumed_.
+    bundy::util::thread::Mutex resumed_mutex_;
+
     /// Indexes for registered hook points
     int hook_index_pkt4_receive_;
     int hook_index_subnet4_select_;
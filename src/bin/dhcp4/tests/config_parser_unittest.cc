@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <config/ccsession.h>
+#include <config/module_spec.h>
 #include <dhcp4/dhcp4_srv.h>
 #include <dhcp4/config_parser.h>
 #include <dhcp/option4_addrlst.h>
@@ -27,6 +28,8 @@
 #include <dhcp/classify.h>
 #include <dhcpsrv/subnet.h>
 #include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/dbaccess_parser.h>
+#include <dhcpsrv/lease_mgr_factory.h>
 #include <hooks/hooks_manager.h>
 
 #include "marker_file.h"
@@ -489,6 +492,79 @@ TEST_F(Dhcp4ParserTest, bogusCommand) {
     checkResult(x, 1);
 }
 
+// Checks that the parameters of the lease file format are accepted by the
+// specification, and passed to the lease manager.
+TEST_F(Dhcp4ParserTest, leaseDatabaseFormat) {
+    const string config = "{ \"lease-database\": {"
+        "    \"type\": \"memfile\","
+        "    \"persist\": false,"
+        "    \"format\": \"binary\","
+        "    \"fsync\": false,"
+        "    \"compact-interval\": 60 } }";
+    ConstElementPtr json = Element::fromJSON(config);
+
+    const ModuleSpec spec = moduleSpecFromFile(specfile("dhcp4.spec"));
+    ElementPtr errors = Element::createList();
+    EXPECT_TRUE(spec.validateConfig(json, false, errors)) << errors->str();
+
+    ConstElementPtr status;
+    EXPECT_NO_THROW(status = configureDhcp4Server(*srv_, json));
+    ASSERT_TRUE(status);
+    comment_ = parseAnswer(rcode_, status);
+    ASSERT_EQ(0, rcode_) << comment_->str();
+
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    EXPECT_EQ("memfile", lease_mgr.getType());
+    EXPECT_EQ("binary", lease_mgr.getParameter("format"));
+    EXPECT_EQ("false", lease_mgr.getParameter("fsync"));
+    EXPECT_EQ("60", lease_mgr.getParameter("compact-interval"));
+}
+
+// Parser of the lease database which gives access to the parameters it
+// builds, without opening the database.
+class TestDbAccessParser : public DbAccessParser {
+public:
+    TestDbAccessParser() :
+        DbAccessParser("lease-database", ParserContext(Option::V4))
+    {}
+    using DbAccessParser::getDbAccessString;
+};
+
+// Checks that the parameters of the write-behind mode of the MySQL backend
+// are accepted by the specification, and converted to the lease manager
+// parameters.  The lease manager itself is not created as it needs a server.
+TEST_F(Dhcp4ParserTest, leaseDatabaseWriteBehind) {
+    const string config = "{ \"lease-database\": {"
+        "    \"type\": \"mysql\","
+        "    \"name\": \"keatest\","
+        "    \"write-behind\": true,"
+        "    \"write-behind-queue\": 5000,"
+        "    \"write-behind-batch\": 50,"
+        "    \"write-behind-delay\": 0 } }";
+    ConstElementPtr json = Element::fromJSON(config);
+
+    const ModuleSpec spec = moduleSpecFromFile(specfile("dhcp4.spec"));
+    ElementPtr errors = Element::createList();
+    EXPECT_TRUE(spec.validateConfig(json, false, errors)) << errors->str();
+
+    TestDbAccessParser parser;
+    ASSERT_NO_THROW(parser.build(json->get("lease-database")));
+    const LeaseMgr::ParameterMap parameters =
+        LeaseMgrFactory::parse(parser.getDbAccessString());
+    EXPECT_EQ("mysql", parameters.find("type")->second);
+    EXPECT_EQ("true", parameters.find("write-behind")->second);
+    EXPECT_EQ("5000", parameters.find("write-behind-queue")->second);
+    EXPECT_EQ("50", parameters.find("write-behind-batch")->second);
+    EXPECT_EQ("0", parameters.find("write-behind-delay")->second);
+
+    // The sizes are integers in the specification.
+    json = Element::fromJSON("{ \"lease-database\": {"
+                             "    \"type\": \"mysql\","
+                             "    \"write-behind-queue\": \"5000\" } }");
+    errors = Element::createList();
+    EXPECT_FALSE(spec.validateConfig(json, false, errors));
+}
+
 /// The goal of this test is to verify if wrongly defined subnet will
 /// be rejected. Properly defined subnet must include at least one
 /// pool definition.
@@ -37,15 +37,20 @@
 #include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/lease_mgr.h>
 #include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
 #include <dhcpsrv/utils.h>
+#include <util/threads/sync.h>
 #include <gtest/gtest.h>
 #include <hooks/server_hooks.h>
 #include <hooks/hooks_manager.h>
 #include <config/ccsession.h>
 
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include <iostream>
+#include <set>
 
 #include <arpa/inet.h>
 
@@ -771,6 +776,57 @@ TEST_F(Dhcpv4SrvTest, ManyDiscovers) {
     cout << "Offered address to client3=" << addr3 << endl;
 }
 
+// This test verifies that the options configured for a subnet are packed
+// once for the clients requesting the same options, and that the new
+// options are sent when the options of the subnet change.
+TEST_F(Dhcpv4SrvTest, packedConfiguredOptions) {
+    IfaceMgrTestConfig test_config(true);
+    IfaceMgr::instance().openSockets4();
+
+    boost::scoped_ptr<NakedDhcpv4Srv> srv;
+    ASSERT_NO_THROW(srv.reset(new NakedDhcpv4Srv(0)));
+    configureRequestedOptions();
+
+    Pkt4Ptr dis1(new Pkt4(DHCPDISCOVER, 1234));
+    Pkt4Ptr dis2(new Pkt4(DHCPDISCOVER, 2345));
+    dis1->setRemoteAddr(IOAddress("192.0.2.1"));
+    dis2->setRemoteAddr(IOAddress("192.0.2.2"));
+    dis1->setIface("eth1");
+    dis2->setIface("eth1");
+    dis1->addOption(generateClientId(4));
+    dis2->addOption(generateClientId(5));
+    addPrlOption(dis1);
+    addPrlOption(dis2);
+
+    Pkt4Ptr offer1 = srv->processDiscover(dis1);
+    Pkt4Ptr offer2 = srv->processDiscover(dis2);
+    checkResponse(offer1, DHCPOFFER, 1234);
+    checkResponse(offer2, DHCPOFFER, 2345);
+    EXPECT_TRUE(basicOptionsPresent(offer1));
+    EXPECT_TRUE(requestedOptionsPresent(offer1));
+    EXPECT_TRUE(requestedOptionsPresent(offer2));
+    ASSERT_NO_THROW(offer1->pack());
+    ASSERT_NO_THROW(offer2->pack());
+
+    // Both clients get the same configured options.
+    OptionPtr dns_servers = offer1->getOption(DHO_DOMAIN_NAME_SERVERS);
+    ASSERT_TRUE(dns_servers);
+    EXPECT_EQ(dns_servers, offer2->getOption(DHO_DOMAIN_NAME_SERVERS));
+
+    // Replace the options of the subnet: the next client gets the new ones.
+    subnet_->delOptions();
+    Option4AddrLstPtr new_dns_servers(
+        new Option4AddrLst(DHO_DOMAIN_NAME_SERVERS));
+    new_dns_servers->addAddress(IOAddress("192.0.2.200"));
+    subnet_->addOption(new_dns_servers, false, "dhcp4");
+
+    Pkt4Ptr offer3 = srv->processDiscover(dis2);
+    checkResponse(offer3, DHCPOFFER, 2345);
+    EXPECT_EQ(new_dns_servers, offer3->getOption(DHO_DOMAIN_NAME_SERVERS));
+    EXPECT_FALSE(offer3->getOption(DHO_LOG_SERVERS));
+    EXPECT_FALSE(offer3->getOption(DHO_ROUTERS));
+}
+
 // Checks whether echoing back client-id is controllable, i.e.
 // whether the server obeys echo-client-id and sends (or not)
 // client-id
@@ -1126,6 +1182,64 @@ TEST_F(Dhcpv4SrvTest, acceptServerId) {
 
 }
 
+// This test verifies that the clients are shared with the peer server when
+// the leases are replicated, and answered by this server while the peer
+// is down.
+TEST_F(Dhcpv4SrvTest, acceptLoadBalancing) {
+    NakedDhcpv4Srv srv(0);
+
+    const std::string prefix = "/tmp/bundy-dhcp4-replication-" +
+        boost::lexical_cast<std::string>(getpid());
+    ASSERT_NO_THROW(LeaseMgrFactory::create(
+        "type=memfile universe=4 persist=false replication-socket=" +
+        prefix + "-a replication-peer=" + prefix + "-b replication-node=0"));
+    const LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    ASSERT_TRUE(replicator);
+
+    // The peer is down until a batch is sent to it.
+    boost::scoped_ptr<LeaseReplicator> peer(
+        new LeaseReplicator(prefix + "-b", prefix + "-a", 1));
+    Pkt4Ptr pkt(new Pkt4(DHCPDISCOVER, 1234));
+    vector<uint8_t> mac(6, 0);
+    size_t accepted = 0;
+    for (mac[5] = 0; mac[5] < 64; ++mac[5]) {
+        pkt->setHWAddr(HTYPE_ETHER, mac.size(), mac);
+        if (srv.acceptLoadBalancing(pkt)) {
+            ++accepted;
+        }
+    }
+    EXPECT_EQ(64, accepted);
+
+    // Each client is answered by one server.
+    replicator->flush();
+    peer->flush();
+    ASSERT_TRUE(replicator->isPeerUp());
+    ASSERT_TRUE(peer->isPeerUp());
+    accepted = 0;
+    for (mac[5] = 0; mac[5] < 64; ++mac[5]) {
+        pkt->setHWAddr(HTYPE_ETHER, mac.size(), mac);
+        const bool accept = srv.acceptLoadBalancing(pkt);
+        EXPECT_NE(accept, peer->inScope(&mac[0], mac.size()));
+        if (accept) {
+            ++accepted;
+        }
+    }
+    EXPECT_LT(0, accepted);
+    EXPECT_GT(64, accepted);
+
+    // The client identifier is used if there is one.
+    vector<uint8_t> id(7, 1);
+    pkt->addOption(OptionPtr(new Option(Option::V4,
+                                        DHO_DHCP_CLIENT_IDENTIFIER, id)));
+    EXPECT_EQ(replicator->inScope(&id[0], id.size()),
+              srv.acceptLoadBalancing(pkt));
+
+    // The server answers all the clients without replication.
+    ASSERT_NO_THROW(LeaseMgrFactory::create(
+        "type=memfile universe=4 persist=false"));
+    EXPECT_TRUE(srv.acceptLoadBalancing(pkt));
+}
+
 // @todo: Implement tests for rejecting renewals
 
 // This test verifies if the sanityCheck() really checks options presence.
@@ -1362,6 +1476,138 @@ TEST_F(Dhcpv4SrvTest, relayAgentInfoEcho) {
     EXPECT_TRUE(rai_response->equal(rai_query));
 }
 
+// A server whose sent packets are stored under a mutex, so that it can
+// be used with worker threads.
+class ThreadedDhcpv4Srv : public NakedDhcpv4Srv {
+public:
+    virtual void sendPacket(const Pkt4Ptr& pkt) {
+        bundy::util::thread::Mutex::Locker locker(mutex_);
+        NakedDhcpv4Srv::sendPacket(pkt);
+    }
+
+private:
+    bundy::util::thread::Mutex mutex_;
+};
+
+// Checks that the REQUESTs are processed by the worker threads when they
+// are configured and that each client gets its own address.
+TEST_F(Dhcpv4SrvTest, workerThreads) {
+    IfaceMgrTestConfig test_config(true);
+    IfaceMgr::instance().openSockets4();
+
+    CfgMgr::instance().setWorkerThreads(4);
+
+    ThreadedDhcpv4Srv srv;
+
+    // The pool has 11 addresses, enough for all the clients.
+    const int client_count = 10;
+    for (int i = 0; i < client_count; ++i) {
+        Pkt4Ptr req(new Pkt4(DHCPREQUEST, 1000 + i));
+        const uint8_t hwaddr[] = { 0, 0xfe, 0xfe, 0xfe, 0xfe,
+                                   static_cast<uint8_t>(i) };
+        req->setHWAddr(HTYPE_ETHER, sizeof(hwaddr),
+                       vector<uint8_t>(hwaddr, hwaddr + sizeof(hwaddr)));
+        ASSERT_NO_THROW(req->pack());
+
+        // The server unpacks the received packets itself
+        const bundy::util::OutputBuffer& buf = req->getBuffer();
+        Pkt4Ptr raw(new Pkt4(static_cast<const uint8_t*>(buf.getData()),
+                             buf.getLength()));
+        raw->setRemoteAddr(IOAddress("192.0.2.1"));
+        raw->setIface("eth1");
+        srv.fakeReceive(raw);
+    }
+
+    // Returns when all the queued packets have been processed
+    srv.run();
+    CfgMgr::instance().setWorkerThreads(0);
+
+    ASSERT_EQ(client_count, srv.fake_sent_.size());
+    set<IOAddress> addresses;
+    for (list<Pkt4Ptr>::const_iterator ack = srv.fake_sent_.begin();
+         ack != srv.fake_sent_.end(); ++ack) {
+        EXPECT_EQ(DHCPACK, (*ack)->getType());
+        EXPECT_TRUE(subnet_->inPool(Lease::TYPE_V4, (*ack)->getYiaddr()));
+        addresses.insert((*ack)->getYiaddr());
+        EXPECT_TRUE(LeaseMgrFactory::instance().getLease4((*ack)->
+                                                          getYiaddr()));
+    }
+    EXPECT_EQ(client_count, addresses.size());
+}
+
+// Checks that a REQUEST with an option the server reads and which is not
+// valid is dropped before a lease is allocated for it.
+TEST_F(Dhcpv4SrvTest, invalidOptionDropped) {
+    IfaceMgrTestConfig test_config(true);
+    IfaceMgr::instance().openSockets4();
+
+    NakedDhcpv4Srv srv(0);
+
+    // A requested address, a server identifier and a relay agent
+    // information option (with a truncated suboption) which are not valid.
+    const uint8_t bad_address[] = { 192, 0, 2 };
+    const uint8_t bad_rai[] = { 1, 5, 0xaa };
+    std::vector<OptionPtr> options;
+    options.push_back(OptionPtr(new Option(Option::V4,
+                                           DHO_DHCP_REQUESTED_ADDRESS,
+                                           OptionBuffer(bad_address,
+                                                        bad_address + 3))));
+    options.push_back(OptionPtr(new Option(Option::V4,
+                                           DHO_DHCP_SERVER_IDENTIFIER,
+                                           OptionBuffer(bad_address,
+                                                        bad_address + 2))));
+    options.push_back(OptionPtr(new Option(Option::V4,
+                                           DHO_DHCP_AGENT_OPTIONS,
+                                           OptionBuffer(bad_rai,
+                                                        bad_rai + 3))));
+    // The last request has valid options only.
+    options.push_back(OptionPtr());
+
+    std::vector<HWAddr> hwaddrs;
+    for (size_t i = 0; i < options.size(); ++i) {
+        SCOPED_TRACE(i);
+        Pkt4Ptr req(new Pkt4(DHCPREQUEST, 1234 + i));
+        const uint8_t hwaddr[] = { 0, 0xfe, 0xfe, 0xfe, 0xfe,
+                                   static_cast<uint8_t>(i) };
+        hwaddrs.push_back(HWAddr(hwaddr, sizeof(hwaddr), HTYPE_ETHER));
+        req->setHWAddr(HTYPE_ETHER, sizeof(hwaddr),
+                       vector<uint8_t>(hwaddr, hwaddr + sizeof(hwaddr)));
+        if (options[i]) {
+            req->addOption(options[i]);
+        }
+        ASSERT_NO_THROW(req->pack());
+
+        // The packet is unpacked: the option is only found when it is read.
+        const bundy::util::OutputBuffer& buf = req->getBuffer();
+        Pkt4Ptr copy(new Pkt4(static_cast<const uint8_t*>(buf.getData()),
+                              buf.getLength()));
+        copy->setCallback(boost::bind(&NakedDhcpv4Srv::unpackOptions, &srv,
+                                      _1, _2, _3));
+        copy->setLazyUnpack(true);
+        ASSERT_NO_THROW(copy->unpack());
+        EXPECT_EQ(!options[i], srv.acceptOptions(copy));
+
+        // The server unpacks the received packets itself
+        Pkt4Ptr raw(new Pkt4(static_cast<const uint8_t*>(buf.getData()),
+                             buf.getLength()));
+        raw->setRemoteAddr(IOAddress("192.0.2.1"));
+        raw->setIface("eth1");
+        srv.fakeReceive(raw);
+    }
+
+    // Returns when all the queued packets have been processed
+    srv.run();
+
+    // Only the last request is answered, and gets a lease.
+    ASSERT_EQ(1, srv.fake_sent_.size());
+    EXPECT_EQ(DHCPACK, srv.fake_sent_.front()->getType());
+    EXPECT_EQ(1234 + options.size() - 1, srv.fake_sent_.front()->getTransid());
+    for (size_t i = 0; i < hwaddrs.size(); ++i) {
+        EXPECT_EQ(i + 1 == hwaddrs.size() ? 1 : 0,
+                  LeaseMgrFactory::instance().getLease4(hwaddrs[i]).size());
+    }
+}
+
 /// @todo move vendor options tests to a separate file.
 /// @todo Add more extensive vendor options tests, including multiple
 ///       vendor options
@@ -1957,6 +2203,49 @@ public:
         return pkt4_receive_callout(callout_handle);
     }
 
+    /// test callback that parks the packet
+    ///
+    /// Unless park_all_ is set, only the first packet is parked.
+    /// @param callout_handle handle passed by the hooks framework
+    /// @return always 0
+    static int
+    pkt4_receive_park(CalloutHandle& callout_handle) {
+
+        Pkt4Ptr pkt;
+        callout_handle.getArgument("query4", pkt);
+
+        if (park_all_ || callback_parked_.empty()) {
+            // If the lot is full, the server drops the packet.
+            callout_handle.getParkingLot()->reference(pkt);
+            callout_handle.setPark(true);
+            callout_handle.setContext("parked", true);
+            callback_parked_.push_back(pkt);
+        }
+
+        // carry on as usual
+        return pkt4_receive_callout(callout_handle);
+    }
+
+    /// test callback that counts the responses to parked packets
+    ///
+    /// It checks the context set by pkt4_receive_park.
+    /// @param callout_handle handle passed by the hooks framework
+    /// @return always 0
+    static int
+    pkt4_send_parked(CalloutHandle& callout_handle) {
+
+        bool parked = false;
+        try {
+            callout_handle.getContext("parked", parked);
+        } catch (const NoSuchCalloutContext&) {
+            // Not parked
+        }
+        if (parked) {
+            ++callback_resumed_;
+        }
+        return (0);
+    }
+
     /// Test callback that stores received callout name and pkt4 value
     /// @param callout_handle handle passed by the hooks framework
     /// @return always 0
@@ -2139,6 +2428,9 @@ public:
         callback_subnet4_.reset();
         callback_subnet4collection_ = NULL;
         callback_argument_names_.clear();
+        callback_parked_.clear();
+        callback_resumed_ = 0;
+        park_all_ = false;
     }
 
     /// pointer to Dhcpv4Srv that is used in tests
@@ -2169,6 +2461,15 @@ public:
 
     /// A list of all received arguments
     static vector<string> callback_argument_names_;
+
+    /// Packets parked by pkt4_receive_park
+    static vector<Pkt4Ptr> callback_parked_;
+
+    /// Number of responses to parked packets seen by pkt4_send_parked
+    static int callback_resumed_;
+
+    /// Should pkt4_receive_park park all the packets?
+    static bool park_all_;
 };
 
 // The following fields are used in testing pkt4_receive_callout.
@@ -2181,6 +2482,9 @@ ClientIdPtr HooksDhcpv4SrvTest::callback_clientid_;
 Lease4Ptr HooksDhcpv4SrvTest::callback_lease4_;
 const Subnet4Collection* HooksDhcpv4SrvTest::callback_subnet4collection_;
 vector<string> HooksDhcpv4SrvTest::callback_argument_names_;
+vector<Pkt4Ptr> HooksDhcpv4SrvTest::callback_parked_;
+int HooksDhcpv4SrvTest::callback_resumed_;
+bool HooksDhcpv4SrvTest::park_all_;
 
 // Checks if callouts installed on pkt4_receive are indeed called and the
 // all necessary parameters are passed.
@@ -2416,6 +2720,78 @@ TEST_F(HooksDhcpv4SrvTest, pkt4ReceiveSkip) {
     ASSERT_EQ(0, srv_->fake_sent_.size());
 }
 
+// Checks that callouts installed on pkt4_receive can suspend the processing
+// of a packet, the server processing the other packets meanwhile, and that
+// the processing is resumed with the same callout context.
+TEST_F(HooksDhcpv4SrvTest, pkt4ReceivePark) {
+    IfaceMgrTestConfig test_config(true);
+    IfaceMgr::instance().openSockets4();
+
+    // Install the callout parking the first packet
+    EXPECT_NO_THROW(HooksManager::preCalloutsLibraryHandle().registerCallout(
+                        "pkt4_receive", pkt4_receive_park));
+    EXPECT_NO_THROW(HooksManager::preCalloutsLibraryHandle().registerCallout(
+                        "pkt4_send", pkt4_send_parked));
+
+    // Let's create two simple DISCOVERs
+    Pkt4Ptr parked = generateSimpleDiscover();
+    srv_->fakeReceive(parked);
+    srv_->fakeReceive(generateSimpleDiscover());
+
+    // The first one is parked, the second one answered.
+    srv_->run();
+    ASSERT_EQ(1, callback_parked_.size());
+    EXPECT_TRUE(callback_parked_[0] == parked);
+    ASSERT_EQ(1, srv_->fake_sent_.size());
+    EXPECT_EQ(0, callback_resumed_);
+
+    ParkingLotPtr lot = HooksManager::getParkingLot(
+        ServerHooks::getServerHooks().getIndex("pkt4_receive"));
+    EXPECT_EQ(1, lot->size());
+
+    // Unpark the first one: it is answered by the processing loop.
+    EXPECT_TRUE(lot->unpark(parked));
+    EXPECT_EQ(0, lot->size());
+    EXPECT_EQ(1, srv_->fake_sent_.size());
+
+    srv_->resumePackets();
+    ASSERT_EQ(2, srv_->fake_sent_.size());
+    EXPECT_EQ(srv_->fake_sent_.front()->getType(),
+              srv_->fake_sent_.back()->getType());
+    EXPECT_EQ(1, callback_resumed_);
+}
+
+// Checks that the packets the callouts can't park are dropped.
+TEST_F(HooksDhcpv4SrvTest, pkt4ReceiveParkLimit) {
+    IfaceMgrTestConfig test_config(true);
+    IfaceMgr::instance().openSockets4();
+
+    CfgMgr::instance().setParkedPacketLimit(1);
+    park_all_ = true;
+    EXPECT_NO_THROW(HooksManager::preCalloutsLibraryHandle().registerCallout(
+                        "pkt4_receive", pkt4_receive_park));
+
+    // Three packets are parked, but only the first one fits in the lot.
+    for (int i = 0; i < 3; ++i) {
+        srv_->fakeReceive(generateSimpleDiscover());
+    }
+    srv_->run();
+    ASSERT_EQ(3, callback_parked_.size());
+    EXPECT_EQ(0, srv_->fake_sent_.size());
+
+    ParkingLotPtr lot = HooksManager::getParkingLot(
+        ServerHooks::getServerHooks().getIndex("pkt4_receive"));
+    EXPECT_EQ(1, lot->size());
+    EXPECT_FALSE(lot->unpark(callback_parked_[1]));
+    EXPECT_TRUE(lot->unpark(callback_parked_[0]));
+
+    srv_->resumePackets();
+    EXPECT_EQ(1, srv_->fake_sent_.size());
+
+    CfgMgr::instance().setParkedPacketLimit(
+        CfgMgr::DEFAULT_PARKED_PACKET_LIMIT);
+}
+
 
 // Checks if callouts installed on pkt4_send are indeed called and the
 // all necessary parameters are passed.
@@ -3360,6 +3736,68 @@ TEST_F(Dhcpv4SrvTest, clientClassify2) {
     EXPECT_TRUE(srv_.selectSubnet(dis));
 }
 
+// Checks that the packets are classified by the classes of the
+// configuration, and that these classes select the subnet.
+TEST_F(Dhcpv4SrvTest, clientClassifyConfigured) {
+    string config = "{ \"interfaces\": [ \"*\" ],"
+        "\"rebind-timer\": 2000, "
+        "\"renew-timer\": 1000, "
+        "\"client-classes\": [ "
+        "{   \"name\": \"cable-modem\", "
+        "    \"test\": \"substring(option[60], 0, 9) == 'docsis3.0' "
+        "and relay[2] == 0x20e52ab81514\" }, "
+        "{   \"name\": \"netgear\", "
+        "    \"test\": \"substring(hwaddr, 0, 3) == 0x20e52a\" }, "
+        "{   \"name\": \"cmts-1-modem\", "
+        "    \"test\": \"member('cable-modem') and "
+        "relay[1] == 0x20000002\" } "
+        "],"
+        "\"subnet4\": [ "
+        "{   \"pool\": [ \"10.254.226.10 - 10.254.226.100\" ],"
+        "    \"client-class\": \"cmts-1-modem\", "
+        "    \"subnet\": \"10.254.226.0/24\" } "
+        "],"
+        "\"valid-lifetime\": 4000 }";
+
+    ASSERT_NO_THROW(configure(config));
+
+    // A relayed DISCOVER from a modem with the remote id of its hardware
+    // address belongs to all the classes.
+    Pkt4Ptr dis1;
+    ASSERT_NO_THROW(dis1 = captureRelayedDiscover());
+    ASSERT_NO_THROW(dis1->unpack());
+    srv_.classifyPacket(dis1);
+    EXPECT_TRUE(dis1->inClass(srv_.VENDOR_CLASS_PREFIX + "docsis3.0"));
+    EXPECT_TRUE(dis1->inClass("cable-modem"));
+    EXPECT_TRUE(dis1->inClass("netgear"));
+    EXPECT_TRUE(dis1->inClass("cmts-1-modem"));
+    EXPECT_TRUE(srv_.selectSubnet(dis1));
+
+    // The eRouter behind it is not a modem, so it is not served.
+    Pkt4Ptr dis2;
+    ASSERT_NO_THROW(dis2 = captureRelayedDiscover2());
+    ASSERT_NO_THROW(dis2->unpack());
+    srv_.classifyPacket(dis2);
+    EXPECT_TRUE(dis2->inClass(srv_.VENDOR_CLASS_PREFIX + "eRouter1.0"));
+    EXPECT_FALSE(dis2->inClass("cable-modem"));
+    EXPECT_FALSE(dis2->inClass("cmts-1-modem"));
+    EXPECT_FALSE(srv_.selectSubnet(dis2));
+
+    // A test which is not valid rejects the configuration.
+    config = "{ \"client-classes\": [ "
+        "{ \"name\": \"bogus\", \"test\": \"option[60] ==\" } ] }";
+    ElementPtr json = Element::fromJSON(config);
+    ConstElementPtr status;
+    EXPECT_NO_THROW(status = configureDhcp4Server(srv_, json));
+    ASSERT_TRUE(status);
+    comment_ = bundy::config::parseAnswer(rcode_, status);
+    EXPECT_EQ(1, rcode_);
+
+    // The classifier of the previous configuration is kept.
+    ASSERT_TRUE(CfgMgr::instance().getClientClassifier());
+    EXPECT_EQ(3, CfgMgr::instance().getClientClassifier()->getClassCount());
+}
+
 // Checks if relay IP address specified in the relay-info structure in
 // subnet4 is being used properly.
 TEST_F(Dhcpv4SrvTest, relayOverride) {
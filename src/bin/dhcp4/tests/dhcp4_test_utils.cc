@@ -56,8 +56,10 @@ Dhcpv4SrvTest::Dhcpv4SrvTest()
 
 Dhcpv4SrvTest::~Dhcpv4SrvTest() {
 
-    // Make sure that we revert to default value
+    // Make sure that we revert to default values
     CfgMgr::instance().echoClientId(true);
+    CfgMgr::instance().setWorkerThreads(0);
+    CfgMgr::instance().setClientClassifier(ClientClassifierPtr());
 }
 
 void Dhcpv4SrvTest::addPrlOption(Pkt4Ptr& pkt) {
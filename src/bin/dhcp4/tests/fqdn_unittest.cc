@@ -20,6 +20,7 @@
 #include <dhcp4/tests/dhcp4_test_utils.h>
 #include <dhcp_ddns/ncr_msg.h>
 #include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/lease_mgr_factory.h>
 
 #include <gtest/gtest.h>
 #include <boost/scoped_ptr.hpp>
@@ -1026,5 +1027,39 @@ TEST_F(NameDhcpv4SrvTest, processRequestReleaseUpdatesDisabled) {
     ASSERT_NO_THROW(srv_->processRelease(rel));
 }
 
+// Test that the server reclaims the expired leases and generates the
+// NameChangeRequests to remove their DNS entries.
+TEST_F(NameDhcpv4SrvTest, reclaimExpiredLeases) {
+    ASSERT_TRUE(CfgMgr::instance().ddnsEnabled());
+
+    // One of the leases has expired.
+    Lease4Ptr expired = createLease(IOAddress("192.0.2.3"),
+                                    "myhost.example.com.", true, true);
+    expired->cltt_ -= 1000;
+    Lease4Ptr valid = createLease(IOAddress("192.0.2.4"),
+                                  "otherhost.example.com.", true, true);
+    // The leases of a client are unique by subnet.
+    valid->hwaddr_[5] = 0x10;
+    valid->client_id_.reset();
+    ASSERT_TRUE(LeaseMgrFactory::instance().addLease(expired));
+    ASSERT_TRUE(LeaseMgrFactory::instance().addLease(valid));
+
+    ASSERT_NO_THROW(srv_->reclaimExpiredLeases(0));
+
+    // The expired lease is deleted and its DNS entries removed.
+    EXPECT_FALSE(LeaseMgrFactory::instance().getLease4(expired->addr_));
+    EXPECT_TRUE(LeaseMgrFactory::instance().getLease4(valid->addr_));
+    ASSERT_EQ(1, d2_mgr_.getQueueSize());
+    verifyNameChangeRequest(bundy::dhcp_ddns::CHG_REMOVE, true, true,
+                            "192.0.2.3", "myhost.example.com.",
+                            "00010132E91AA355CFBB753C0F0497A5A940436965"
+                            "B68B6D438D98E680BF10B09F3BCF",
+                            expired->cltt_, 100);
+
+    // There is nothing left to reclaim.
+    ASSERT_NO_THROW(srv_->reclaimExpiredLeases(0));
+    EXPECT_EQ(0, d2_mgr_.getQueueSize());
+}
+
 
 } // end of anonymous namespace
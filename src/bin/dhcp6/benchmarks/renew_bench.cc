@@ -0,0 +1,277 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/dhcp6.h>
+#include <dhcp/option.h>
+#include <dhcp/option6_ia.h>
+#include <dhcp/pkt6.h>
+#include <dhcp6/dhcp6_srv.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/pool.h>
+#include <dhcpsrv/subnet.h>
+#include <log/logger_support.h>
+#include <util/threads/sync.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+using bundy::util::thread::Mutex;
+
+namespace {
+
+// IAIDs of the address and prefix of each client.
+const uint32_t IAID_NA = 1;
+const uint32_t IAID_PD = 2;
+
+// A server which receives prepared packets instead of reading its sockets,
+// and counts its responses instead of sending them.  Its main loop returns
+// when all the packets have been processed.
+class BenchDhcpv6Srv : public Dhcpv6Srv {
+public:
+    BenchDhcpv6Srv() :
+        Dhcpv6Srv(0), packets_(NULL), next_(0), replies_(0),
+        keep_replies_(false)
+    {}
+
+    // Processes the packets in the main loop, as if they were received.
+    void process(const vector<vector<uint8_t> >& packets) {
+        packets_ = &packets;
+        next_ = 0;
+        shutdown_ = false;
+        run();
+    }
+
+    // Sets whether the responses are kept (to build the renewals from
+    // them).
+    void keepReplies(bool keep) {
+        keep_replies_ = keep;
+    }
+
+    // Returns and clears the kept responses.
+    vector<Pkt6Ptr> takeReplies() {
+        vector<Pkt6Ptr> replies;
+        replies.swap(kept_);
+        return (replies);
+    }
+
+    size_t getReplies() const {
+        Mutex::Locker locker(mutex_);
+        return (replies_);
+    }
+
+protected:
+    virtual Pkt6Ptr receivePacket(int) {
+        if (next_ == packets_->size()) {
+            shutdown();
+            return (Pkt6Ptr());
+        }
+        const vector<uint8_t>& data = (*packets_)[next_++];
+        Pkt6Ptr query(new Pkt6(&data[0], data.size()));
+        query->setRemoteAddr(IOAddress("2001:db8:1::1"));
+        query->setIface("bench0");
+        return (query);
+    }
+
+    virtual void sendPacket(const Pkt6Ptr& reply) {
+        Mutex::Locker locker(mutex_);
+        ++replies_;
+        if (keep_replies_) {
+            kept_.push_back(reply);
+        }
+    }
+
+private:
+    const vector<vector<uint8_t> >* packets_;
+    size_t next_;
+    // Protects replies_ and kept_, as the workers send the responses.
+    mutable Mutex mutex_;
+    size_t replies_;
+    bool keep_replies_;
+    vector<Pkt6Ptr> kept_;
+};
+
+// Let the server renew the address and the prefix of every client, the
+// renewals all arriving at once.
+class RenewBenchMark {
+public:
+    RenewBenchMark(BenchDhcpv6Srv& srv,
+                   const vector<vector<uint8_t> >& packets) :
+        srv_(srv), packets_(packets)
+    {}
+    unsigned int run() {
+        srv_.process(packets_);
+        return (packets_.size());
+    }
+private:
+    BenchDhcpv6Srv& srv_;
+    const vector<vector<uint8_t> >& packets_;
+};
+
+// Creates a message of a client, relayed by a CMTS.
+Pkt6Ptr
+createMessage(uint8_t type, uint32_t client, const OptionPtr& serverid) {
+    Pkt6Ptr msg(new Pkt6(type, client));
+    OptionBuffer duid(14, 0);
+    duid[1] = 1;
+    for (int i = 0; i < 4; ++i) {
+        duid[13 - i] = static_cast<uint8_t>(client >> (8 * i));
+    }
+    msg->addOption(OptionPtr(new Option(Option::V6, D6O_CLIENTID, duid)));
+    msg->addOption(serverid);
+
+    Pkt6::RelayInfo relay;
+    relay.msg_type_ = DHCPV6_RELAY_FORW;
+    relay.linkaddr_ = IOAddress("2001:db8:1::1");
+    relay.peeraddr_ = IOAddress("fe80::1");
+    msg->relay_info_.push_back(relay);
+    return (msg);
+}
+
+// Returns the wire format of a message.
+vector<uint8_t>
+toWire(const Pkt6Ptr& msg) {
+    msg->pack();
+    const bundy::util::OutputBuffer& buf = msg->getBuffer();
+    const uint8_t* data = static_cast<const uint8_t*>(buf.getData());
+    return (vector<uint8_t>(data, data + buf.getLength()));
+}
+
+// Configure the subnet of the relay, with pools large enough for all the
+// clients.
+void
+configure() {
+    LeaseMgrFactory::create("type=memfile universe=6 persist=false");
+
+    Subnet6Ptr subnet(new Subnet6(IOAddress("2001:db8:1::"), 48,
+                                  1000, 2000, 3000, 4000));
+    subnet->addPool(Pool6Ptr(new Pool6(Lease::TYPE_NA,
+                                       IOAddress("2001:db8:1:1::"), 64)));
+    subnet->addPool(Pool6Ptr(new Pool6(Lease::TYPE_PD,
+                                       IOAddress("2001:db8:1:100::"), 56,
+                                       64)));
+    CfgMgr::instance().deleteSubnets6();
+    CfgMgr::instance().addSubnet6(subnet);
+}
+
+// Gives each client an address and a prefix (by processing a REQUEST from
+// it), and returns the RENEWs of the leases.
+vector<vector<uint8_t> >
+allocateLeases(BenchDhcpv6Srv& srv, size_t client_count) {
+    vector<vector<uint8_t> > requests;
+    for (uint32_t client = 0; client < client_count; ++client) {
+        Pkt6Ptr request = createMessage(DHCPV6_REQUEST, client,
+                                        srv.getServerID());
+        request->addOption(OptionPtr(new Option6IA(D6O_IA_NA, IAID_NA)));
+        request->addOption(OptionPtr(new Option6IA(D6O_IA_PD, IAID_PD)));
+        requests.push_back(toWire(request));
+    }
+    srv.keepReplies(true);
+    srv.process(requests);
+    srv.keepReplies(false);
+
+    vector<vector<uint8_t> > renewals;
+    const vector<Pkt6Ptr> replies = srv.takeReplies();
+    for (vector<Pkt6Ptr>::const_iterator reply = replies.begin();
+         reply != replies.end(); ++reply) {
+        OptionPtr ia_na = (*reply)->getOption(D6O_IA_NA);
+        OptionPtr ia_pd = (*reply)->getOption(D6O_IA_PD);
+        if (!ia_na || !ia_pd) {
+            continue;
+        }
+        Pkt6Ptr renew = createMessage(DHCPV6_RENEW, (*reply)->getTransid(),
+                                      srv.getServerID());
+        renew->addOption(ia_na);
+        renew->addOption(ia_pd);
+        renewals.push_back(toWire(renew));
+    }
+    return (renewals);
+}
+
+void
+usage() {
+    std::cerr << "Usage: renew_bench [-n iterations] [-c clients] "
+                 "[-t max_threads]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t client_count = 10000;
+    uint32_t max_threads = 4;
+    while ((ch = getopt(argc, argv, "n:c:t:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'c':
+            client_count = atoi(optarg);
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || client_count == 0) {
+        usage();
+    }
+
+    bundy::log::initLogger("renew_bench", bundy::log::NONE);
+
+    configure();
+    BenchDhcpv6Srv srv;
+    const vector<vector<uint8_t> > renewals = allocateLeases(srv,
+                                                             client_count);
+    if (renewals.size() != client_count) {
+        std::cerr << "Only " << renewals.size() << " of the " << client_count
+                  << " clients got an address and a prefix" << std::endl;
+        return (1);
+    }
+
+    // Without worker threads, then with 1, 2, 4... threads.  The renewals
+    // the worker threads can't keep up with are dropped, as they would be
+    // by a real server.
+    RenewBenchMark bench(srv, renewals);
+    for (uint32_t threads = 0; threads <= max_threads;
+         threads = (threads == 0 ? 1 : threads * 2)) {
+        CfgMgr::instance().setWorkerThreads(threads);
+        const size_t replies_before = srv.getReplies();
+        std::cout << "Benchmark for renewing the address and the prefix of "
+                  << client_count << " clients with " << threads
+                  << " worker thread(s)" << std::endl;
+        BenchMark<RenewBenchMark>(iteration, bench);
+        std::cout << "Answered renewals: "
+                  << srv.getReplies() - replies_before << " of "
+                  << iteration * client_count << std::endl;
+    }
+    CfgMgr::instance().setWorkerThreads(0);
+
+    return (0);
+}
@@ -624,7 +624,11 @@ DhcpConfigParser* createGlobal6DhcpConfigParser(const std::string& config_id) {
     if ((config_id.compare("preferred-lifetime") == 0)  ||
         (config_id.compare("valid-lifetime") == 0)  ||
         (config_id.compare("renew-timer") == 0)  ||
-        (config_id.compare("rebind-timer") == 0))  {
+        (config_id.compare("rebind-timer") == 0) ||
+        (config_id.compare("worker-threads") == 0) ||
+        (config_id.compare("parked-packet-limit") == 0) ||
+        (config_id.compare("reclaim-timer-wait-time") == 0) ||
+        (config_id.compare("max-reclaim-leases") == 0))  {
         parser = new Uint32Parser(config_id,
                                  globalContext()->uint32_values_);
     } else if (config_id.compare("interfaces") == 0) {
@@ -646,6 +650,8 @@ DhcpConfigParser* createGlobal6DhcpConfigParser(const std::string& config_id) {
         parser = new DbAccessParser(config_id, *globalContext());
     } else if (config_id.compare("hooks-libraries") == 0) {
         parser = new HooksLibrariesParser(config_id);
+    } else if (config_id.compare("client-classes") == 0) {
+        parser = new ClientClassesParser(config_id, globalContext());
     } else if (config_id.compare("dhcp-ddns") == 0) {
         parser = new D2ClientConfigParser(config_id);
     } else {
@@ -657,6 +663,55 @@ DhcpConfigParser* createGlobal6DhcpConfigParser(const std::string& config_id) {
     return (parser);
 }
 
+/// @brief Sets global parameters in the configuration manager.
+///
+/// Applies the parsed values of the global parameters that are not
+/// specific to a subnet.
+void commitGlobalOptions() {
+    // Set the number of threads processing packets. The parameter is
+    // optional; without it the packets are processed by the receiving
+    // thread.
+    uint32_t worker_threads = 0;
+    try {
+        worker_threads =
+            globalContext()->uint32_values_->getParam("worker-threads");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setWorkerThreads(worker_threads);
+
+    // Set how many packets the callouts may park at once. The parameter is
+    // optional.
+    uint32_t parked_packet_limit = CfgMgr::DEFAULT_PARKED_PACKET_LIMIT;
+    try {
+        parked_packet_limit =
+            globalContext()->uint32_values_->getParam("parked-packet-limit");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setParkedPacketLimit(parked_packet_limit);
+
+    // Set how often and how many expired leases are reclaimed. The
+    // parameters are optional.
+    uint32_t reclaim_timer_wait_time = CfgMgr::DEFAULT_RECLAIM_TIMER_WAIT_TIME;
+    try {
+        reclaim_timer_wait_time = globalContext()->uint32_values_->
+            getParam("reclaim-timer-wait-time");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setReclaimTimerWaitTime(reclaim_timer_wait_time);
+
+    uint32_t max_reclaim_leases = CfgMgr::DEFAULT_MAX_RECLAIM_LEASES;
+    try {
+        max_reclaim_leases =
+            globalContext()->uint32_values_->getParam("max-reclaim-leases");
+    } catch (...) {
+        // Not specified
+    }
+    CfgMgr::instance().setMaxReclaimLeases(max_reclaim_leases);
+}
+
 bundy::data::ConstElementPtr
 configureDhcp6Server(Dhcpv6Srv&, bundy::data::ConstElementPtr config_set) {
     if (!config_set) {
@@ -686,6 +741,7 @@ configureDhcp6Server(Dhcpv6Srv&, bundy::data::ConstElementPtr config_set) {
     ParserPtr subnet_parser;
     ParserPtr option_parser;
     ParserPtr iface_parser;
+    ParserPtr classes_parser;
 
     // Some of the parsers alter state of the system that can't easily
     // be undone. (Or alter it in a way such that undoing the change
@@ -723,6 +779,11 @@ configureDhcp6Server(Dhcpv6Srv&, bundy::data::ConstElementPtr config_set) {
                 subnet_parser = parser;
             } else if (config_pair.first == "option-data") {
                 option_parser = parser;
+            } else if (config_pair.first == "client-classes") {
+                // The classes are compiled now, but the classifier is only
+                // replaced once the whole configuration is accepted.
+                classes_parser = parser;
+                parser->build(config_pair.second);
             } else if (config_pair.first == "hooks-libraries") {
                 // Executing the commit will alter currently loaded hooks
                 // libraries. Check if the supplied libraries are valid,
@@ -793,6 +854,13 @@ configureDhcp6Server(Dhcpv6Srv&, bundy::data::ConstElementPtr config_set) {
                 iface_parser->commit();
             }
 
+            if (classes_parser) {
+                classes_parser->commit();
+            }
+
+            // Apply global options
+            commitGlobalOptions();
+
             // This occurs last as if it succeeds, there is no easy way to
             // revert it.  As a result, the failure to commit a subsequent
             // change causes problems when trying to roll back.
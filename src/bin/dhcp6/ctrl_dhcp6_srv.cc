@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -21,6 +21,7 @@
 #include <dhcp/iface_mgr.h>
 #include <dhcpsrv/dhcp_config_parser.h>
 #include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/lease_mgr_factory.h>
 #include <dhcp6/config_parser.h>
 #include <dhcp6/ctrl_dhcp6_srv.h>
 #include <dhcp6/dhcp6_log.h>
@@ -170,6 +171,17 @@ ControlledDhcpv6Srv::dhcp6CommandHandler(const string& command, ConstElementPtr
         ConstElementPtr answer = bundy::config::createAnswer(0,
                                  "Hooks libraries successfully reloaded.");
         return (answer);
+
+    } else if (command == "lease-cache-flush") {
+        // The leases were changed in the database by the administrator.
+        if (!LeaseMgrFactory::flushCache()) {
+            ConstElementPtr answer = bundy::config::createAnswer(1,
+                                     "The leases are not cached.");
+            return (answer);
+        }
+        ConstElementPtr answer = bundy::config::createAnswer(0,
+                                 "Lease cache flushed.");
+        return (answer);
     }
 
     ConstElementPtr answer = bundy::config::createAnswer(1,
@@ -182,6 +194,12 @@ void ControlledDhcpv6Srv::sessionReader(void) {
     // Process one asio event. If there are more events, iface_mgr will call
     // this callback more than once.
     if (server_) {
+        // The event may change the configuration (or stop the server), so
+        // wait until the worker threads have finished the packets they are
+        // processing, and don't let them start new ones until the event is
+        // handled.
+        bundy::util::thread::EpochManager::WriteLocker
+            locker(server_->packet_processing_);
         server_->io_service_.run_one();
     }
 }
@@ -37,14 +37,18 @@
 #include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/lease_mgr.h>
 #include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
 #include <dhcpsrv/subnet.h>
 #include <dhcpsrv/utils.h>
 #include <exceptions/exceptions.h>
 #include <hooks/callout_handle.h>
 #include <hooks/hooks_manager.h>
+#include <hooks/parking_lot.h>
 #include <util/encode/hex.h>
 #include <util/io_utilities.h>
 #include <util/range_utilities.h>
+#include <util/threads/sync.h>
+#include <util/threads/thread.h>
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -53,6 +57,7 @@
 
 #include <stdlib.h>
 #include <time.h>
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
@@ -64,6 +69,10 @@ using namespace bundy::dhcp;
 using namespace bundy::hooks;
 using namespace bundy::util;
 using namespace std;
+using bundy::util::thread::CondVar;
+using bundy::util::thread::EpochManager;
+using bundy::util::thread::Mutex;
+using bundy::util::thread::Thread;
 
 namespace {
 
@@ -78,7 +87,16 @@ struct Dhcp6Hooks {
     int hook_index_pkt6_send_;      ///< index for "pkt6_send" hook point
     int hook_index_buffer6_send_;   ///< index for "buffer6_send" hook point
 
-    /// Constructor that registers hook points for DHCPv6 engine
+    int arg_query6_;            ///< index of the "query6" argument
+    int arg_response6_;         ///< index of the "response6" argument
+    int arg_lease6_;            ///< index of the "lease6" argument
+    int arg_ia_na_;             ///< index of the "ia_na" argument
+    int arg_ia_pd_;             ///< index of the "ia_pd" argument
+    int arg_subnet6_;           ///< index of the "subnet6" argument
+    int arg_subnet6collection_; ///< index of the "subnet6collection" argument
+
+    /// Constructor that registers hook points and callout arguments for
+    /// DHCPv6 engine
     Dhcp6Hooks() {
         hook_index_buffer6_receive_= HooksManager::registerHook("buffer6_receive");
         hook_index_pkt6_receive_   = HooksManager::registerHook("pkt6_receive");
@@ -88,6 +106,15 @@ struct Dhcp6Hooks {
         hook_index_lease6_release_ = HooksManager::registerHook("lease6_release");
         hook_index_pkt6_send_      = HooksManager::registerHook("pkt6_send");
         hook_index_buffer6_send_   = HooksManager::registerHook("buffer6_send");
+
+        arg_query6_            = HooksManager::registerArgument("query6");
+        arg_response6_         = HooksManager::registerArgument("response6");
+        arg_lease6_            = HooksManager::registerArgument("lease6");
+        arg_ia_na_             = HooksManager::registerArgument("ia_na");
+        arg_ia_pd_             = HooksManager::registerArgument("ia_pd");
+        arg_subnet6_           = HooksManager::registerArgument("subnet6");
+        arg_subnet6collection_ =
+            HooksManager::registerArgument("subnet6collection");
     }
 };
 
@@ -97,11 +124,258 @@ struct Dhcp6Hooks {
 // module is called.
 Dhcp6Hooks Hooks;
 
+// Maximum number of packets received at once.
+const size_t RECEIVE_BATCH_SIZE = 64;
+
+// The allocation engine of the worker thread (if the calling thread is one).
+pthread_once_t alloc_engine_once = PTHREAD_ONCE_INIT;
+pthread_key_t alloc_engine_key;
+
+void
+createAllocEngineKey() {
+    pthread_key_create(&alloc_engine_key, NULL);
+}
+
+// Maximum number of packets waiting for a worker thread.  More packets are
+// dropped, as a client would retransmit them before they are processed
+// anyway.
+const size_t MAX_WORKER_QUEUE = 1024;
+
+// Maximum number of relay agents a message may have passed through (the
+// HOP_COUNT_LIMIT of RFC 3315).
+const unsigned int MAX_RELAY_DEPTH = 32;
+
+// Finds the client identifier in the raw data of a DHCPv6 message, looking
+// into the relayed message if the message comes from a relay agent.
+// Returns NULL if there is none (or the message is malformed), else sets
+// len to the length of the identifier.
+const uint8_t*
+findClientId(const uint8_t* data, size_t size, size_t& len) {
+    for (unsigned int depth = 0; depth <= MAX_RELAY_DEPTH; ++depth) {
+        if (size == 0) {
+            return (NULL);
+        }
+        const bool relayed = (data[0] == DHCPV6_RELAY_FORW) ||
+            (data[0] == DHCPV6_RELAY_REPL);
+        const size_t header_len = relayed ? Pkt6::DHCPV6_RELAY_HDR_LEN :
+            Pkt6::DHCPV6_PKT_HDR_LEN;
+        if (size < header_len) {
+            return (NULL);
+        }
+        const uint16_t wanted = relayed ? D6O_RELAY_MSG : D6O_CLIENTID;
+        const uint8_t* option = data + header_len;
+        const uint8_t* end = data + size;
+        const uint8_t* found = NULL;
+        size_t found_len = 0;
+        while (end - option >= 4) {
+            const uint16_t type = readUint16(option, 2);
+            const uint16_t option_len = readUint16(option + 2, 2);
+            if (end - option - 4 < option_len) {
+                return (NULL);
+            }
+            if (type == wanted) {
+                found = option + 4;
+                found_len = option_len;
+                break;
+            }
+            option += 4 + option_len;
+        }
+        if (found == NULL || !relayed) {
+            len = found_len;
+            return (found);
+        }
+        data = found;
+        size = found_len;
+    }
+    return (NULL);
+}
+
 }; // anonymous namespace
 
 namespace bundy {
 namespace dhcp {
 
+/// @brief Threads processing packets for the server.
+///
+/// Each worker has a queue of packets to process, its own allocation
+/// engine and (for the database backends) its own lease database
+/// connection.  The received packets are assigned to the workers by the
+/// DUID of the client, so the packets of a client are processed in order
+/// and never in parallel.
+class Dhcpv6Srv::WorkerPool : public boost::noncopyable {
+public:
+    /// @brief Starts the given number of worker threads.
+    WorkerPool(Dhcpv6Srv& srv, uint32_t count) : srv_(srv), next_(0) {
+        pthread_once(&alloc_engine_once, createAllocEngineKey);
+        try {
+            for (uint32_t i = 0; i < count; ++i) {
+                workers_.push_back(new Worker);
+                workers_.back()->thread.reset(
+                    new Thread(boost::bind(&WorkerPool::run, this,
+                                           workers_.back())));
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+        LOG_INFO(dhcp6_logger, DHCP6_WORKER_THREADS).arg(count);
+    }
+
+    /// @brief Processes the queued packets and stops the threads.
+    ~WorkerPool() {
+        stop();
+    }
+
+    /// @brief Returns the number of worker threads.
+    size_t size() const {
+        return (workers_.size());
+    }
+
+    /// @brief Queues the packet for the worker of the client sending it.
+    ///
+    /// A packet unparked by the callouts is passed with its callout
+    /// handle, and its processing is resumed by the worker.
+    void dispatch(const Pkt6Ptr& query,
+                  const CalloutHandlePtr& callout_handle = CalloutHandlePtr()) {
+        const size_t index = selectWorker(*query);
+        Worker& worker = *workers_[index];
+        {
+            Mutex::Locker locker(worker.mutex);
+            if (worker.queue.size() >= MAX_WORKER_QUEUE) {
+                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL,
+                          DHCP6_WORKER_QUEUE_FULL).arg(index);
+                return;
+            }
+            worker.queue.push(ResumedPacket(query, callout_handle));
+        }
+        worker.cond.signal();
+    }
+
+private:
+    struct Worker {
+        Worker() : engine(AllocEngine::ALLOC_ITERATIVE, 100),
+                   stopping(false)
+        {}
+
+        AllocEngine engine;
+        // Protects queue and stopping
+        Mutex mutex;
+        CondVar cond;
+        // The packets, with the callout handles of the unparked ones
+        std::queue<ResumedPacket> queue;
+        bool stopping;
+        boost::scoped_ptr<Thread> thread;
+    };
+
+    // Selects the worker by the DUID of the client.  This is done before
+    // the packet is parsed, so the DUID is read from the raw data.
+    size_t selectWorker(const Pkt6& query) {
+        const OptionBuffer& data = query.data_;
+        size_t len = 0;
+        const uint8_t* duid = data.empty() ? NULL :
+            findClientId(&data[0], data.size(), len);
+        if (duid == NULL || len == 0) {
+            // No DUID to select by, so spread the packets evenly.
+            return (next_++ % workers_.size());
+        }
+        uint32_t hash = 2166136261U;
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ duid[i]) * 16777619U;
+        }
+        return (hash % workers_.size());
+    }
+
+    void run(Worker* worker) {
+        pthread_setspecific(alloc_engine_key, &worker->engine);
+        for (;;) {
+            Pkt6Ptr query;
+            CalloutHandlePtr callout_handle;
+            {
+                Mutex::Locker locker(worker->mutex);
+                while (worker->queue.empty() && !worker->stopping) {
+                    worker->cond.wait(worker->mutex);
+                }
+                if (worker->queue.empty()) {
+                    break;
+                }
+                query.swap(worker->queue.front().first);
+                callout_handle.swap(worker->queue.front().second);
+                worker->queue.pop();
+            }
+
+            // The database backends can't share a connection between
+            // threads.  If the thread has no connection of its own (or
+            // the lease database has been reconfigured), open one.
+            try {
+                LeaseMgrFactory::createSession();
+            } catch (const std::exception& ex) {
+                LOG_ERROR(dhcp6_logger, DHCP6_WORKER_SESSION_FAIL)
+                    .arg(ex.what());
+                continue;
+            }
+
+            try {
+                EpochManager::ReadLocker locker(srv_.packet_processing_);
+                if (callout_handle) {
+                    srv_.resumePacket(query, callout_handle);
+                } else {
+                    srv_.processPacket(query);
+                }
+            } catch (const std::exception& ex) {
+                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC,
+                          DHCP6_PACKET_PROCESS_FAIL)
+                    .arg(query->getName())
+                    .arg(query->getRemoteAddr().toText())
+                    .arg(ex.what());
+            }
+
+            // Don't keep the callout handle, which may refer to hooks
+            // libraries being unloaded.
+            callout_handle.reset();
+            getCalloutHandle(Pkt6Ptr());
+
+            // Send the lease changes to the peer server before waiting for
+            // more packets.
+            bool idle;
+            {
+                Mutex::Locker locker(worker->mutex);
+                idle = worker->queue.empty();
+            }
+            if (idle) {
+                const LeaseReplicatorPtr replicator =
+                    LeaseMgrFactory::getReplicator();
+                if (replicator) {
+                    replicator->flush();
+                }
+            }
+        }
+        LeaseMgrFactory::destroySession();
+        pthread_setspecific(alloc_engine_key, NULL);
+    }
+
+    void stop() {
+        BOOST_FOREACH(Worker* worker, workers_) {
+            {
+                Mutex::Locker locker(worker->mutex);
+                worker->stopping = true;
+            }
+            worker->cond.signal();
+        }
+        BOOST_FOREACH(Worker* worker, workers_) {
+            if (worker->thread) {
+                worker->thread->wait();
+            }
+            delete worker;
+        }
+        workers_.clear();
+    }
+
+    Dhcpv6Srv& srv_;
+    std::vector<Worker*> workers_;
+    // For the packets without a DUID
+    size_t next_;
+};
+
 const std::string Dhcpv6Srv::VENDOR_CLASS_PREFIX("VENDOR_CLASS_");
 
 /// @brief file name of a server-id file
@@ -115,7 +389,8 @@ const std::string Dhcpv6Srv::VENDOR_CLASS_PREFIX("VENDOR_CLASS_");
 static const char* SERVER_DUID_FILE = "bundy-dhcp6-serverid";
 
 Dhcpv6Srv::Dhcpv6Srv(uint16_t port)
-:alloc_engine_(), serverid_(), port_(port), shutdown_(true)
+:alloc_engine_(), serverid_(), port_(port), received_next_(0),
+ next_reclaim_(0), replication_socket_(-1), shutdown_(true)
 {
 
     LOG_DEBUG(dhcp6_logger, DBG_DHCP6_START, DHCP6_OPEN_SOCKET).arg(port);
@@ -171,6 +446,13 @@ Dhcpv6Srv::Dhcpv6Srv(uint16_t port)
 }
 
 Dhcpv6Srv::~Dhcpv6Srv() {
+    workers_.reset();
+
+    // The parked packets would be resumed by this server.
+    HooksManager::clearParkingLots();
+    if (replication_socket_ >= 0) {
+        IfaceMgr::instance().deleteExternalSocket(replication_socket_);
+    }
     IfaceMgr::instance().closeSockets();
 
     LeaseMgrFactory::destroy();
@@ -182,7 +464,39 @@ void Dhcpv6Srv::shutdown() {
 }
 
 Pkt6Ptr Dhcpv6Srv::receivePacket(int timeout) {
-    return (IfaceMgr::instance().receive6(timeout));
+    if (received_next_ == received_.size()) {
+        received_.clear();
+        received_next_ = 0;
+        IfaceMgr::instance().receiveBatch6(received_, RECEIVE_BATCH_SIZE,
+                                           timeout);
+        if (received_.empty()) {
+            return (Pkt6Ptr());
+        }
+    }
+    Pkt6Ptr pkt;
+    pkt.swap(received_[received_next_++]);
+    return (pkt);
+}
+
+void Dhcpv6Srv::updateReplication() {
+    const LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    const int socket = replicator ? replicator->getSocket() : -1;
+    if (socket != replication_socket_) {
+        if (replication_socket_ >= 0) {
+            IfaceMgr::instance().deleteExternalSocket(replication_socket_);
+        }
+        if (socket >= 0) {
+            IfaceMgr::instance().addExternalSocket(
+                socket, LeaseMgrFactory::receiveReplication);
+        }
+        replication_socket_ = socket;
+    }
+
+    // The changes are sent in batches, so not after each packet of a
+    // batch of received packets.
+    if (replicator && (received_next_ == received_.size())) {
+        replicator->flush();
+    }
 }
 
 void Dhcpv6Srv::sendPacket(const Pkt6Ptr& packet) {
@@ -216,6 +530,27 @@ Dhcpv6Srv::testServerID(const Pkt6Ptr& pkt) {
     return (true);
 }
 
+bool
+Dhcpv6Srv::testLoadBalancing(const Pkt6Ptr& pkt) const {
+    const LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    if (!replicator) {
+        return (true);
+    }
+    OptionPtr client_id = pkt->getOption(D6O_CLIENTID);
+    if (client_id && !client_id->getData().empty()) {
+        const OptionBuffer& duid = client_id->getData();
+        if (!replicator->inScope(&duid[0], duid.size())) {
+            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL,
+                      DHCP6_PACKET_DROP_LOAD_BALANCING)
+                .arg(pkt->getName())
+                .arg(pkt->getTransid())
+                .arg(pkt->getIface());
+            return (false);
+        }
+    }
+    return (true);
+}
+
 bool
 Dhcpv6Srv::testUnicast(const Pkt6Ptr& pkt) const {
     switch (pkt->getType()) {
@@ -236,18 +571,40 @@ Dhcpv6Srv::testUnicast(const Pkt6Ptr& pkt) const {
 
 bool Dhcpv6Srv::run() {
     while (!shutdown_) {
-        /// @todo Calculate actual timeout to the next event (e.g. lease
-        /// expiration) once we have lease database. The idea here is that
-        /// it is possible to do everything in a single process/thread.
-        /// For now, we are just calling select for 1000 seconds. There
-        /// were some issues reported on some systems when calling select()
-        /// with too large values. Unfortunately, I don't recall the details.
-        //cppcheck-suppress variableScope This is temporary anyway
-        const int timeout = 1000;
-
-        // client's message and server's response
+        // Start or stop the worker threads if their configured number
+        // changed.
+        const uint32_t worker_count = CfgMgr::instance().getWorkerThreads();
+        if (worker_count != (workers_ ? workers_->size() : 0)) {
+            workers_.reset();
+            if (worker_count > 0) {
+                workers_.reset(new WorkerPool(*this, worker_count));
+            }
+        }
+
+        // The expired leases are reclaimed a batch at a time between the
+        // packets, so the sockets are not waited for beyond the next
+        // reclamation. There were some issues reported on some systems
+        // when calling select() with too large values, so the timeout
+        // never exceeds 1000 seconds.
+        int timeout = 1000;
+        const uint32_t reclaim_wait =
+            CfgMgr::instance().getReclaimTimerWaitTime();
+        if (reclaim_wait > 0) {
+            const time_t now = time(NULL);
+            if (now >= next_reclaim_) {
+                reclaimExpiredLeases(CfgMgr::instance().getMaxReclaimLeases());
+                next_reclaim_ = now + reclaim_wait;
+            } else if (next_reclaim_ > now + reclaim_wait) {
+                // The interval was shortened by a reconfiguration.
+                next_reclaim_ = now + reclaim_wait;
+            }
+            timeout = std::min<time_t>(timeout, next_reclaim_ - now);
+        }
+
+        updateReplication();
+
+        // client's message
         Pkt6Ptr query;
-        Pkt6Ptr rsp;
 
         try {
             query = receivePacket(timeout);
@@ -255,277 +612,409 @@ bool Dhcpv6Srv::run() {
             LOG_ERROR(dhcp6_logger, DHCP6_PACKET_RECEIVE_FAIL).arg(e.what());
         }
 
+        // The callouts unpark the packets from the callbacks of their
+        // external sockets, called while the packets are received.
+        resumePackets();
+
         // Timeout may be reached or signal received, which breaks select()
         // with no packet received
         if (!query) {
             continue;
         }
 
-        // In order to parse the DHCP options, the server needs to use some
-        // configuration information such as: existing option spaces, option
-        // definitions etc. This is the kind of information which is not
-        // available in the libdhcp, so we need to supply our own implementation
-        // of the option parsing function here, which would rely on the
-        // configuration data.
-        query->setCallback(boost::bind(&Dhcpv6Srv::unpackOptions, this, _1, _2,
-                                       _3, _4, _5));
+        if (workers_) {
+            workers_->dispatch(query);
+        } else {
+            try {
+                processPacket(query);
+            } catch (const std::exception& ex) {
+                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC,
+                          DHCP6_PACKET_PROCESS_FAIL)
+                    .arg(query->getName())
+                    .arg(query->getRemoteAddr().toText())
+                    .arg(ex.what());
+            }
+        }
+    }
 
-        bool skip_unpack = false;
+    // Let the worker threads finish the packets they have received.
+    workers_.reset();
 
-        // The packet has just been received so contains the uninterpreted wire
-        // data; execute callouts registered for buffer6_receive.
-        if (HooksManager::calloutsPresent(Hooks.hook_index_buffer6_receive_)) {
-            CalloutHandlePtr callout_handle = getCalloutHandle(query);
+    return (true);
+}
 
-            // Delete previously set arguments
-            callout_handle->deleteAllArguments();
+void
+Dhcpv6Srv::processPacket(Pkt6Ptr& query) {
+    // In order to parse the DHCP options, the server needs to use some
+    // configuration information such as: existing option spaces, option
+    // definitions etc. This is the kind of information which is not
+    // available in the libdhcp, so we need to supply our own implementation
+    // of the option parsing function here, which would rely on the
+    // configuration data.
+    query->setCallback(boost::bind(&Dhcpv6Srv::unpackOptions, this, _1, _2,
+                                   _3, _4, _5));
+
+    bool skip_unpack = false;
+
+    // The packet has just been received so contains the uninterpreted wire
+    // data; execute callouts registered for buffer6_receive.
+    if (HooksManager::calloutsPresent(Hooks.hook_index_buffer6_receive_)) {
+        CalloutHandlePtr callout_handle = getCalloutHandle(query);
 
-            // Pass incoming packet as argument
-            callout_handle->setArgument("query6", query);
+        // Delete previously set arguments
+        callout_handle->deleteAllArguments();
 
-            // Call callouts
-            HooksManager::callCallouts(Hooks.hook_index_buffer6_receive_, *callout_handle);
+        // Pass incoming packet as argument
+        callout_handle->setArgument(Hooks.arg_query6_, query);
 
-            // Callouts decided to skip the next processing step. The next
-            // processing step would to parse the packet, so skip at this
-            // stage means that callouts did the parsing already, so server
-            // should skip parsing.
-            if (callout_handle->getSkip()) {
-                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_BUFFER_RCVD_SKIP);
-                skip_unpack = true;
-            }
+        // Call callouts
+        HooksManager::callCallouts(Hooks.hook_index_buffer6_receive_, *callout_handle);
 
-            callout_handle->getArgument("query6", query);
+        // Callouts decided to skip the next processing step. The next
+        // processing step would to parse the packet, so skip at this
+        // stage means that callouts did the parsing already, so server
+        // should skip parsing.
+        if (callout_handle->getSkip()) {
+            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_BUFFER_RCVD_SKIP);
+            skip_unpack = true;
         }
 
-        // Unpack the packet information unless the buffer6_receive callouts
-        // indicated they did it
-        if (!skip_unpack) {
-            if (!query->unpack()) {
-                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL,
-                          DHCP6_PACKET_PARSE_FAIL);
-                continue;
-            }
-        }
-        // Check if received query carries server identifier matching
-        // server identifier being used by the server.
-        if (!testServerID(query)) {
-            continue;
-        }
+        callout_handle->getArgument(Hooks.arg_query6_, query);
+    }
 
-        // Check if the received query has been sent to unicast or multicast.
-        // The Solicit, Confirm, Rebind and Information Request will be
-        // discarded if sent to unicast address.
-        if (!testUnicast(query)) {
-            continue;
+    // Unpack the packet information unless the buffer6_receive callouts
+    // indicated they did it
+    if (!skip_unpack) {
+        if (!query->unpack()) {
+            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL,
+                      DHCP6_PACKET_PARSE_FAIL);
+            return;
         }
+    }
+    // Check if received query carries server identifier matching
+    // server identifier being used by the server.
+    if (!testServerID(query)) {
+        return;
+    }
 
-        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL, DHCP6_PACKET_RECEIVED)
-            .arg(query->getName());
-        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL_DATA, DHCP6_QUERY_DATA)
-            .arg(static_cast<int>(query->getType()))
-            .arg(query->getBuffer().getLength())
-            .arg(query->toText());
-
-        // At this point the information in the packet has been unpacked into
-        // the various packet fields and option objects has been cretated.
-        // Execute callouts registered for packet6_receive.
-        if (HooksManager::calloutsPresent(Hooks.hook_index_pkt6_receive_)) {
-            CalloutHandlePtr callout_handle = getCalloutHandle(query);
+    // Check if the received query has been sent to unicast or multicast.
+    // The Solicit, Confirm, Rebind and Information Request will be
+    // discarded if sent to unicast address.
+    if (!testUnicast(query)) {
+        return;
+    }
 
-            // Delete previously set arguments
-            callout_handle->deleteAllArguments();
+    // Check that the client is not answered by the peer server.
+    if (!testLoadBalancing(query)) {
+        return;
+    }
 
-            // Pass incoming packet as argument
-            callout_handle->setArgument("query6", query);
+    LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL, DHCP6_PACKET_RECEIVED)
+        .arg(query->getName());
+    LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL_DATA, DHCP6_QUERY_DATA)
+        .arg(static_cast<int>(query->getType()))
+        .arg(query->getBuffer().getLength())
+        .arg(query->toText());
 
-            // Call callouts
-            HooksManager::callCallouts(Hooks.hook_index_pkt6_receive_, *callout_handle);
+    // At this point the information in the packet has been unpacked into
+    // the various packet fields and option objects has been cretated.
+    // Execute callouts registered for packet6_receive.
+    if (HooksManager::calloutsPresent(Hooks.hook_index_pkt6_receive_)) {
+        CalloutHandlePtr callout_handle = getCalloutHandle(query);
 
-            // Callouts decided to skip the next processing step. The next
-            // processing step would to process the packet, so skip at this
-            // stage means drop.
-            if (callout_handle->getSkip()) {
-                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_PACKET_RCVD_SKIP);
-                continue;
-            }
+        // Delete previously set arguments
+        callout_handle->deleteAllArguments();
+
+        // Pass incoming packet as argument
+        callout_handle->setArgument(Hooks.arg_query6_, query);
+
+        // The callouts may park the packet to suspend its processing.  It
+        // is parked before they are called, so they can unpark it (from
+        // another thread) before they return.
+        ParkingLotPtr parking_lot =
+            HooksManager::getParkingLot(Hooks.hook_index_pkt6_receive_);
+        const bool parked =
+            parking_lot->park(query, boost::bind(&Dhcpv6Srv::unparkPacket,
+                                                 this, query, callout_handle),
+                              CfgMgr::instance().getParkedPacketLimit());
+
+        // Call callouts
+        HooksManager::callCallouts(Hooks.hook_index_pkt6_receive_, *callout_handle);
 
-            callout_handle->getArgument("query6", query);
+        // Callouts decided to skip the next processing step. The next
+        // processing step would to process the packet, so skip at this
+        // stage means drop.
+        if (callout_handle->getSkip()) {
+            parking_lot->drop(query);
+            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_PACKET_RCVD_SKIP);
+            return;
         }
 
-        // Assign this packet to a class, if possible
-        classifyPacket(query);
+        // Callouts kept the packet parked: its processing is resumed when
+        // they unpark it.  If there was no room for it in the lot, it is
+        // dropped.
+        if (callout_handle->getPark()) {
+            if (parked) {
+                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS,
+                          DHCP6_HOOK_PACKET_RCVD_PARK);
+            } else {
+                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS,
+                          DHCP6_HOOK_PACKET_PARK_LIMIT)
+                    .arg(CfgMgr::instance().getParkedPacketLimit());
+            }
+            return;
+        }
+        parking_lot->drop(query);
 
-        try {
-                NameChangeRequestPtr ncr;
-            switch (query->getType()) {
-            case DHCPV6_SOLICIT:
-                rsp = processSolicit(query);
-                    break;
+        callout_handle->getArgument(Hooks.arg_query6_, query);
+    }
 
-            case DHCPV6_REQUEST:
-                rsp = processRequest(query);
-                break;
+    processQuery(query);
+}
 
-            case DHCPV6_RENEW:
-                rsp = processRenew(query);
-                break;
+void
+Dhcpv6Srv::processQuery(Pkt6Ptr& query) {
+    // server's response
+    Pkt6Ptr rsp;
 
-            case DHCPV6_REBIND:
-                rsp = processRebind(query);
-                break;
+    // Assign this packet to a class, if possible
+    classifyPacket(query);
 
-            case DHCPV6_CONFIRM:
-                rsp = processConfirm(query);
+    try {
+            NameChangeRequestPtr ncr;
+        switch (query->getType()) {
+        case DHCPV6_SOLICIT:
+            rsp = processSolicit(query);
                 break;
 
-            case DHCPV6_RELEASE:
-                rsp = processRelease(query);
-                break;
+        case DHCPV6_REQUEST:
+            rsp = processRequest(query);
+            break;
 
-            case DHCPV6_DECLINE:
-                rsp = processDecline(query);
-                break;
+        case DHCPV6_RENEW:
+            rsp = processRenew(query);
+            break;
 
-            case DHCPV6_INFORMATION_REQUEST:
-                rsp = processInfRequest(query);
-                break;
+        case DHCPV6_REBIND:
+            rsp = processRebind(query);
+            break;
 
-            default:
-                // We received a packet type that we do not recognize.
-                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_UNKNOWN_MSG_RECEIVED)
-                    .arg(static_cast<int>(query->getType()))
-                    .arg(query->getIface());
-                // Only action is to output a message if debug is enabled,
-                // and that will be covered by the debug statement before
-                // the "switch" statement.
-                ;
-            }
+        case DHCPV6_CONFIRM:
+            rsp = processConfirm(query);
+            break;
 
-        } catch (const RFCViolation& e) {
-            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_REQUIRED_OPTIONS_CHECK_FAIL)
-                .arg(query->getName())
-                .arg(query->getRemoteAddr().toText())
-                .arg(e.what());
+        case DHCPV6_RELEASE:
+            rsp = processRelease(query);
+            break;
 
-        } catch (const bundy::Exception& e) {
+        case DHCPV6_DECLINE:
+            rsp = processDecline(query);
+            break;
 
-            // Catch-all exception (at least for ones based on the isc
-            // Exception class, which covers more or less all that
-            // are explicitly raised in the BUNDY code).  Just log
-            // the problem and ignore the packet. (The problem is logged
-            // as a debug message because debug is disabled by default -
-            // it prevents a DDOS attack based on the sending of problem
-            // packets.)
-            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_PACKET_PROCESS_FAIL)
+        case DHCPV6_INFORMATION_REQUEST:
+            rsp = processInfRequest(query);
+            break;
+
+        default:
+            // We received a packet type that we do not recognize.
+            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_UNKNOWN_MSG_RECEIVED)
+                .arg(static_cast<int>(query->getType()))
+                .arg(query->getIface());
+            // Only action is to output a message if debug is enabled,
+            // and that will be covered by the debug statement before
+            // the "switch" statement.
+            ;
+        }
+
+    } catch (const RFCViolation& e) {
+        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_REQUIRED_OPTIONS_CHECK_FAIL)
+            .arg(query->getName())
+            .arg(query->getRemoteAddr().toText())
+            .arg(e.what());
+
+    } catch (const bundy::Exception& e) {
+
+        // Catch-all exception (at least for ones based on the isc
+        // Exception class, which covers more or less all that
+        // are explicitly raised in the BUNDY code).  Just log
+        // the problem and ignore the packet. (The problem is logged
+        // as a debug message because debug is disabled by default -
+        // it prevents a DDOS attack based on the sending of problem
+        // packets.)
+        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_PACKET_PROCESS_FAIL)
+            .arg(query->getName())
+            .arg(query->getRemoteAddr().toText())
+            .arg(e.what());
+    }
+
+    // A lease must be stored before it is acknowledged to the client.
+    if (rsp && (rsp->getType() == DHCPV6_REPLY)) {
+        try {
+            LeaseMgrFactory::instance().waitForWrites();
+        } catch (const bundy::Exception& e) {
+            LOG_ERROR(dhcp6_logger, DHCP6_LEASE_WRITE_FAIL)
                 .arg(query->getName())
                 .arg(query->getRemoteAddr().toText())
                 .arg(e.what());
+            return;
         }
+    }
 
-        if (rsp) {
-            rsp->setRemoteAddr(query->getRemoteAddr());
-            rsp->setLocalAddr(query->getLocalAddr());
+    if (rsp) {
+        rsp->setRemoteAddr(query->getRemoteAddr());
+        rsp->setLocalAddr(query->getLocalAddr());
 
-            if (rsp->relay_info_.empty()) {
-                // Direct traffic, send back to the client directly
-                rsp->setRemotePort(DHCP6_CLIENT_PORT);
-            } else {
-                // Relayed traffic, send back to the relay agent
-                rsp->setRemotePort(DHCP6_SERVER_PORT);
+        if (rsp->relay_info_.empty()) {
+            // Direct traffic, send back to the client directly
+            rsp->setRemotePort(DHCP6_CLIENT_PORT);
+        } else {
+            // Relayed traffic, send back to the relay agent
+            rsp->setRemotePort(DHCP6_SERVER_PORT);
+        }
+
+        rsp->setLocalPort(DHCP6_SERVER_PORT);
+        rsp->setIndex(query->getIndex());
+        rsp->setIface(query->getIface());
+
+        // Specifies if server should do the packing
+        bool skip_pack = false;
+
+        // Server's reply packet now has all options and fields set.
+        // Options are represented by individual objects, but the
+        // output wire data has not been prepared yet.
+        // Execute all callouts registered for packet6_send
+        if (HooksManager::calloutsPresent(Hooks.hook_index_pkt6_send_)) {
+            CalloutHandlePtr callout_handle = getCalloutHandle(query);
+
+            // Delete all previous arguments
+            callout_handle->deleteAllArguments();
+
+            // Set our response
+            callout_handle->setArgument(Hooks.arg_response6_, rsp);
+
+            // Call all installed callouts
+            HooksManager::callCallouts(Hooks.hook_index_pkt6_send_, *callout_handle);
+
+            // Callouts decided to skip the next processing step. The next
+            // processing step would to pack the packet (create wire data).
+            // That step will be skipped if any callout sets skip flag.
+            // It essentially means that the callout already did packing,
+            // so the server does not have to do it again.
+            if (callout_handle->getSkip()) {
+                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_PACKET_SEND_SKIP);
+                skip_pack = true;
             }
+        }
 
-            rsp->setLocalPort(DHCP6_SERVER_PORT);
-            rsp->setIndex(query->getIndex());
-            rsp->setIface(query->getIface());
+        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL_DATA,
+                  DHCP6_RESPONSE_DATA)
+            .arg(static_cast<int>(rsp->getType())).arg(rsp->toText());
 
-            // Specifies if server should do the packing
-            bool skip_pack = false;
+        if (!skip_pack) {
+            try {
+                rsp->pack();
+            } catch (const std::exception& e) {
+                LOG_ERROR(dhcp6_logger, DHCP6_PACK_FAIL)
+                    .arg(e.what());
+                return;
+            }
+
+        }
+
+        try {
 
-            // Server's reply packet now has all options and fields set.
-            // Options are represented by individual objects, but the
-            // output wire data has not been prepared yet.
-            // Execute all callouts registered for packet6_send
-            if (HooksManager::calloutsPresent(Hooks.hook_index_pkt6_send_)) {
+            // Now all fields and options are constructed into output wire buffer.
+            // Option objects modification does not make sense anymore. Hooks
+            // can only manipulate wire buffer at this stage.
+            // Let's execute all callouts registered for buffer6_send
+            if (HooksManager::calloutsPresent(Hooks.hook_index_buffer6_send_)) {
                 CalloutHandlePtr callout_handle = getCalloutHandle(query);
 
-                // Delete all previous arguments
+                // Delete previously set arguments
                 callout_handle->deleteAllArguments();
 
-                // Set our response
-                callout_handle->setArgument("response6", rsp);
+                // Pass incoming packet as argument
+                callout_handle->setArgument(Hooks.arg_response6_, rsp);
 
-                // Call all installed callouts
-                HooksManager::callCallouts(Hooks.hook_index_pkt6_send_, *callout_handle);
+                // Call callouts
+                HooksManager::callCallouts(Hooks.hook_index_buffer6_send_, *callout_handle);
 
                 // Callouts decided to skip the next processing step. The next
-                // processing step would to pack the packet (create wire data).
-                // That step will be skipped if any callout sets skip flag.
-                // It essentially means that the callout already did packing,
-                // so the server does not have to do it again.
+                // processing step would to parse the packet, so skip at this
+                // stage means drop.
                 if (callout_handle->getSkip()) {
-                    LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_PACKET_SEND_SKIP);
-                    skip_pack = true;
+                    LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_BUFFER_SEND_SKIP);
+                    return;
                 }
+
+                callout_handle->getArgument(Hooks.arg_response6_, rsp);
             }
 
             LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL_DATA,
                       DHCP6_RESPONSE_DATA)
                 .arg(static_cast<int>(rsp->getType())).arg(rsp->toText());
 
-            if (!skip_pack) {
-                try {
-                    rsp->pack();
-                } catch (const std::exception& e) {
-                    LOG_ERROR(dhcp6_logger, DHCP6_PACK_FAIL)
-                        .arg(e.what());
-                    continue;
-                }
-
-            }
-
-            try {
-
-                // Now all fields and options are constructed into output wire buffer.
-                // Option objects modification does not make sense anymore. Hooks
-                // can only manipulate wire buffer at this stage.
-                // Let's execute all callouts registered for buffer6_send
-                if (HooksManager::calloutsPresent(Hooks.hook_index_buffer6_send_)) {
-                    CalloutHandlePtr callout_handle = getCalloutHandle(query);
-
-                    // Delete previously set arguments
-                    callout_handle->deleteAllArguments();
+            sendPacket(rsp);
+        } catch (const std::exception& e) {
+            LOG_ERROR(dhcp6_logger, DHCP6_PACKET_SEND_FAIL)
+                .arg(e.what());
+        }
+    }
+}
 
-                    // Pass incoming packet as argument
-                    callout_handle->setArgument("response6", rsp);
+void
+Dhcpv6Srv::unparkPacket(const Pkt6Ptr& query,
+                        const CalloutHandlePtr& callout_handle) {
+    Mutex::Locker locker(resumed_mutex_);
+    resumed_.push_back(ResumedPacket(query, callout_handle));
+}
 
-                    // Call callouts
-                    HooksManager::callCallouts(Hooks.hook_index_buffer6_send_, *callout_handle);
+void
+Dhcpv6Srv::resumePackets() {
+    std::vector<ResumedPacket> resumed;
+    {
+        Mutex::Locker locker(resumed_mutex_);
+        if (resumed_.empty()) {
+            return;
+        }
+        resumed.swap(resumed_);
+    }
 
-                    // Callouts decided to skip the next processing step. The next
-                    // processing step would to parse the packet, so skip at this
-                    // stage means drop.
-                    if (callout_handle->getSkip()) {
-                        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_BUFFER_SEND_SKIP);
-                        continue;
-                    }
+    BOOST_FOREACH(ResumedPacket& packet, resumed) {
+        if (workers_) {
+            workers_->dispatch(packet.first, packet.second);
+            continue;
+        }
+        try {
+            resumePacket(packet.first, packet.second);
+        } catch (const std::exception& ex) {
+            LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC,
+                      DHCP6_PACKET_PROCESS_FAIL)
+                .arg(packet.first->getName())
+                .arg(packet.first->getRemoteAddr().toText())
+                .arg(ex.what());
+        }
+    }
+}
 
-                    callout_handle->getArgument("response6", rsp);
-                }
+void
+Dhcpv6Srv::resumePacket(Pkt6Ptr& query,
+                        const CalloutHandlePtr& callout_handle) {
+    LOG_DEBUG(dhcp6_logger, DBG_DHCP6_HOOKS, DHCP6_HOOK_PACKET_RCVD_RESUME);
 
-                LOG_DEBUG(dhcp6_logger, DBG_DHCP6_DETAIL_DATA,
-                          DHCP6_RESPONSE_DATA)
-                    .arg(static_cast<int>(rsp->getType())).arg(rsp->toText());
+    // The callouts may have replaced the packet before they unparked it.
+    callout_handle->getArgument(Hooks.arg_query6_, query);
+    setCalloutHandle(query, callout_handle);
 
-                sendPacket(rsp);
-            } catch (const std::exception& e) {
-                LOG_ERROR(dhcp6_logger, DHCP6_PACKET_SEND_FAIL)
-                    .arg(e.what());
-            }
-        }
-    }
+    processQuery(query);
+}
 
-    return (true);
+AllocEngine&
+Dhcpv6Srv::getAllocEngine() {
+    pthread_once(&alloc_engine_once, createAllocEngineKey);
+    AllocEngine* engine =
+        static_cast<AllocEngine*>(pthread_getspecific(alloc_engine_key));
+    return (engine != NULL ? *engine : *alloc_engine_);
 }
 
 bool Dhcpv6Srv::loadServerID(const std::string& file_name) {
@@ -902,13 +1391,14 @@ Dhcpv6Srv::selectSubnet(const Pkt6Ptr& question) {
         callout_handle->deleteAllArguments();
 
         // Set new arguments
-        callout_handle->setArgument("query6", question);
-        callout_handle->setArgument("subnet6", subnet);
+        callout_handle->setArgument(Hooks.arg_query6_, question);
+        callout_handle->setArgument(Hooks.arg_subnet6_, subnet);
 
         // We pass pointer to const collection for performance reasons.
         // Otherwise we would get a non-trivial performance penalty each
         // time subnet6_select is called.
-        callout_handle->setArgument("subnet6collection", CfgMgr::instance().getSubnets6());
+        callout_handle->setArgument(Hooks.arg_subnet6collection_,
+                                    CfgMgr::instance().getSubnets6());
 
         // Call user (and server-side) callouts
         HooksManager::callCallouts(Hooks.hook_index_subnet6_select_, *callout_handle);
@@ -922,7 +1412,7 @@ Dhcpv6Srv::selectSubnet(const Pkt6Ptr& question) {
         }
 
         // Use whatever subnet was specified by the callout
-        callout_handle->getArgument("subnet6", subnet);
+        callout_handle->getArgument(Hooks.arg_subnet6_, subnet);
     }
 
     return (subnet);
@@ -1133,6 +1623,27 @@ Dhcpv6Srv::createNameChangeRequests(const Pkt6Ptr& answer) {
     }
 }
 
+void
+Dhcpv6Srv::reclaimExpiredLeases(size_t max_leases) {
+    try {
+        const Lease6Collection reclaimed =
+            AllocEngine::reclaimExpiredLeases6(max_leases);
+        if (reclaimed.empty()) {
+            return;
+        }
+        LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_LEASES_RECLAIMED)
+            .arg(reclaimed.size());
+
+        // Remove the DNS entries of the leases, if any.
+        for (Lease6Collection::const_iterator lease = reclaimed.begin();
+             lease != reclaimed.end(); ++lease) {
+            createRemovalNameChangeRequest(*lease);
+        }
+    } catch (const std::exception& ex) {
+        LOG_ERROR(dhcp6_logger, DHCP6_LEASES_RECLAIM_FAIL).arg(ex.what());
+    }
+}
+
 void
 Dhcpv6Srv::createRemovalNameChangeRequest(const Lease6Ptr& lease) {
     // Don't create NameChangeRequests if DNS updates are disabled.
@@ -1235,7 +1746,12 @@ Dhcpv6Srv::assignIA_NA(const Subnet6Ptr& subnet, const DuidPtr& duid,
         fake_allocation = true;
     }
 
-    CalloutHandlePtr callout_handle = getCalloutHandle(query);
+    // The callout handle is set up only if there are lease callouts to use
+    // it; the allocation engine doesn't call them without it.
+    CalloutHandlePtr callout_handle;
+    if (AllocEngine::leaseCalloutsPresent6()) {
+        callout_handle = getCalloutHandle(query);
+    }
 
     // At this point, we have to make make some decisions with respect to the
     // FQDN option that we have generated as a result of receiving client's
@@ -1262,14 +1778,14 @@ Dhcpv6Srv::assignIA_NA(const Subnet6Ptr& subnet, const DuidPtr& duid,
     // may be used instead. If fake_allocation is set to false, the lease will
     // be inserted into the LeaseMgr as well.
     Lease6Collection old_leases;
-    Lease6Collection leases = alloc_engine_->allocateLeases6(subnet, duid,
-                                                             ia->getIAID(),
-                                                             hint, Lease::TYPE_NA,
-                                                             do_fwd, do_rev,
-                                                             hostname,
-                                                             fake_allocation,
-                                                             callout_handle,
-                                                             old_leases);
+    Lease6Collection leases = getAllocEngine().allocateLeases6(subnet, duid,
+                                                               ia->getIAID(),
+                                                               hint, Lease::TYPE_NA,
+                                                               do_fwd, do_rev,
+                                                               hostname,
+                                                               fake_allocation,
+                                                               callout_handle,
+                                                               old_leases);
     /// @todo: Handle more than one lease
     Lease6Ptr lease;
     if (!leases.empty()) {
@@ -1384,21 +1900,26 @@ Dhcpv6Srv::assignIA_PD(const Subnet6Ptr& subnet, const DuidPtr& duid,
     // allocation.
     bool fake_allocation = (query->getType() == DHCPV6_SOLICIT);
 
-    CalloutHandlePtr callout_handle = getCalloutHandle(query);
+    // The callout handle is set up only if there are lease callouts to use
+    // it; the allocation engine doesn't call them without it.
+    CalloutHandlePtr callout_handle;
+    if (AllocEngine::leaseCalloutsPresent6()) {
+        callout_handle = getCalloutHandle(query);
+    }
 
     // Use allocation engine to pick a lease for this client. Allocation engine
     // will try to honour the hint, but it is just a hint - some other address
     // may be used instead. If fake_allocation is set to false, the lease will
     // be inserted into the LeaseMgr as well.
     Lease6Collection old_leases;
-    Lease6Collection leases = alloc_engine_->allocateLeases6(subnet, duid,
-                                                             ia->getIAID(),
-                                                             hint, Lease::TYPE_PD,
-                                                             false, false,
-                                                             string(),
-                                                             fake_allocation,
-                                                             callout_handle,
-                                                             old_leases);
+    Lease6Collection leases = getAllocEngine().allocateLeases6(subnet, duid,
+                                                               ia->getIAID(),
+                                                               hint, Lease::TYPE_PD,
+                                                               false, false,
+                                                               string(),
+                                                               fake_allocation,
+                                                               callout_handle,
+                                                               old_leases);
 
     if (!leases.empty()) {
 
@@ -1582,13 +2103,13 @@ Dhcpv6Srv::extendIA_NA(const Subnet6Ptr& subnet, const DuidPtr& duid,
         callout_handle->deleteAllArguments();
 
         // Pass the original packet
-        callout_handle->setArgument("query6", query);
+        callout_handle->setArgument(Hooks.arg_query6_, query);
 
         // Pass the lease to be updated
-        callout_handle->setArgument("lease6", lease);
+        callout_handle->setArgument(Hooks.arg_lease6_, lease);
 
         // Pass the IA option to be sent in response
-        callout_handle->setArgument("ia_na", ia_rsp);
+        callout_handle->setArgument(Hooks.arg_ia_na_, ia_rsp);
 
         // Call all installed callouts
         HooksManager::callCallouts(hook_point, *callout_handle);
@@ -1755,13 +2276,13 @@ Dhcpv6Srv::extendIA_PD(const Subnet6Ptr& subnet, const DuidPtr& duid,
         callout_handle->deleteAllArguments();
 
         // Pass the original packet
-        callout_handle->setArgument("query6", query);
+        callout_handle->setArgument(Hooks.arg_query6_, query);
 
         // Pass the lease to be updated
-        callout_handle->setArgument("lease6", lease);
+        callout_handle->setArgument(Hooks.arg_lease6_, lease);
 
         // Pass the IA option to be sent in response
-        callout_handle->setArgument("ia_pd", ia_rsp);
+        callout_handle->setArgument(Hooks.arg_ia_pd_, ia_rsp);
 
         // Call all installed callouts
         HooksManager::callCallouts(hook_point,
@@ -2032,10 +2553,10 @@ Dhcpv6Srv::releaseIA_NA(const DuidPtr& duid, const Pkt6Ptr& query,
         callout_handle->deleteAllArguments();
 
         // Pass the original packet
-        callout_handle->setArgument("query6", query);
+        callout_handle->setArgument(Hooks.arg_query6_, query);
 
         // Pass the lease to be updated
-        callout_handle->setArgument("lease6", lease);
+        callout_handle->setArgument(Hooks.arg_lease6_, lease);
 
         // Call all installed callouts
         HooksManager::callCallouts(Hooks.hook_index_lease6_release_, *callout_handle);
@@ -2182,10 +2703,10 @@ Dhcpv6Srv::releaseIA_PD(const DuidPtr& duid, const Pkt6Ptr& query,
         callout_handle->deleteAllArguments();
 
         // Pass the original packet
-        callout_handle->setArgument("query6", query);
+        callout_handle->setArgument(Hooks.arg_query6_, query);
 
         // Pass the lease to be updated
-        callout_handle->setArgument("lease6", lease);
+        callout_handle->setArgument(Hooks.arg_lease6_, lease);
 
         // Call all installed callouts
         HooksManager::callCallouts(Hooks.hook_index_lease6_release_, *callout_handle);
@@ -2410,21 +2931,24 @@ Dhcpv6Srv::unpackOptions(const OptionBuffer& buf,
     size_t offset = 0;
     size_t length = buf.size();
 
-    OptionDefContainer option_defs;
+    // The option definitions are not copied as this is done for each
+    // packet.
+    static const OptionDefContainer empty_option_defs;
+    const OptionDefContainer* option_defs = &empty_option_defs;
+    OptionDefContainerPtr option_defs_ptr;
     if (option_space == "dhcp6") {
         // Get the list of stdandard option definitions.
-        option_defs = LibDHCP::getOptionDefs(Option::V6);
+        option_defs = &LibDHCP::getOptionDefs(Option::V6);
     } else if (!option_space.empty()) {
-        OptionDefContainerPtr option_defs_ptr =
-            CfgMgr::instance().getOptionDefs(option_space);
+        option_defs_ptr = CfgMgr::instance().getOptionDefs(option_space);
         if (option_defs_ptr != NULL) {
-            option_defs = *option_defs_ptr;
+            option_defs = option_defs_ptr.get();
         }
     }
 
     // Get the search index #1. It allows to search for option definitions
     // using option code.
-    const OptionDefContainerTypeIndex& idx = option_defs.get<1>();
+    const OptionDefContainerTypeIndex& idx = option_defs->get<1>();
 
     // The buffer being read comprises a set of options, each starting with
     // a two-byte type code and a two-byte length field.
@@ -2507,12 +3031,11 @@ void Dhcpv6Srv::classifyPacket(const Pkt6Ptr& pkt) {
     OptionVendorClassPtr vclass = boost::dynamic_pointer_cast<
         OptionVendorClass>(pkt->getOption(D6O_VENDOR_CLASS));
 
+    std::ostringstream classes;
     if (!vclass || vclass->getTuplesNum() == 0) {
-        return;
-    }
+        // The configured classes below may still apply.
 
-    std::ostringstream classes;
-    if (vclass->hasTuple(DOCSIS3_CLASS_MODEM)) {
+    } else if (vclass->hasTuple(DOCSIS3_CLASS_MODEM)) {
         classes << VENDOR_CLASS_PREFIX << DOCSIS3_CLASS_MODEM;
 
     } else if (vclass->hasTuple(DOCSIS3_CLASS_EROUTER)) {
@@ -2523,9 +3046,24 @@ void Dhcpv6Srv::classifyPacket(const Pkt6Ptr& pkt) {
 
     }
 
-    // If there is no class identified, leave.
     if (!classes.str().empty()) {
         pkt->addClass(classes.str());
+    }
+
+    // Then the classes of the configuration, whose tests may check the
+    // vendor class above.
+    const ClientClassifierPtr classifier =
+        CfgMgr::instance().getClientClassifier();
+    if (classifier && (classifier->classify(*pkt) > 0) &&
+        dhcp6_logger.isDebugEnabled(DBG_DHCP6_BASIC)) {
+        classes.str("");
+        BOOST_FOREACH(const ClientClass& name, pkt->classes_) {
+            classes << name << " ";
+        }
+    }
+
+    // If there is no class identified, leave.
+    if (!classes.str().empty()) {
         LOG_DEBUG(dhcp6_logger, DBG_DHCP6_BASIC, DHCP6_CLASS_ASSIGNED)
             .arg(classes.str());
     }
@@ -27,11 +27,16 @@
 #include <dhcpsrv/d2_client_mgr.h>
 #include <dhcpsrv/subnet.h>
 #include <hooks/callout_handle.h>
+#include <util/threads/epoch.h>
+#include <util/threads/sync.h>
 
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <iostream>
 #include <queue>
+#include <utility>
+#include <vector>
 
 namespace bundy {
 namespace dhcp {
@@ -93,6 +98,22 @@ public:
     /// their correctness, generates appropriate answer (if needed) and
     /// transmits responses.
     ///
+    /// If worker threads are configured (see
+    /// @c CfgMgr::getWorkerThreads), the received packets are passed to
+    /// the worker threads to be processed in parallel by
+    /// @c processPacket.  All packets of a client (identified by its
+    /// DUID) are processed by the same thread, in the order they were
+    /// received.  The number of threads is adjusted to the configuration
+    /// before each packet is received.
+    ///
+    /// The processing of the packets parked by the pkt6_receive callouts
+    /// is resumed by this loop (see @c resumePackets) once they are
+    /// unparked.
+    ///
+    /// If the leases are replicated to a peer server, the loop receives
+    /// the changes of the peer (see @c updateReplication) and sends the
+    /// changes of this server when it has no more packets to process.
+    ///
     /// @return true, if being shut down gracefully, fail if experienced
     ///         critical error.
     bool run();
@@ -175,6 +196,17 @@ protected:
     /// not allowed according to RFC3315, section 15; true otherwise.
     bool testUnicast(const Pkt6Ptr& pkt) const;
 
+    /// @brief Checks if the client is answered by this server.
+    ///
+    /// When the leases are replicated to a peer server sharing the
+    /// clients with this one (see @c LeaseReplicator::inScope), the
+    /// messages of the clients of the peer are dropped.  The clients are
+    /// identified by their DUID.
+    ///
+    /// @param pkt DHCPv6 message to be checked.
+    /// @return true if this server answers the client.
+    bool testLoadBalancing(const Pkt6Ptr& pkt) const;
+
     /// @brief verifies if specified packet meets RFC requirements
     ///
     /// Checks if mandatory option is really there, that forbidden option
@@ -497,6 +529,17 @@ protected:
     /// records will be performed.
     void createRemovalNameChangeRequest(const Lease6Ptr& lease);
 
+    /// @brief Reclaims a batch of expired leases.
+    ///
+    /// Deletes the leases expired the longest time ago from the lease
+    /// database (see @c AllocEngine::reclaimExpiredLeases6) and creates
+    /// the requests for the removal of their DNS entries.  The main
+    /// processing loop calls it periodically.  Errors are logged.
+    ///
+    /// @param max_leases maximum number of leases to reclaim (0 for no
+    ///        limit)
+    void reclaimExpiredLeases(size_t max_leases);
+
     /// @brief Attempts to extend the lifetime of IAs.
     ///
     /// This function is called when a client sends Renew or Rebind message.
@@ -557,7 +600,11 @@ protected:
     static std::string duidToString(const OptionPtr& opt);
 
 
-    /// @brief dummy wrapper around IfaceMgr::receive6
+    /// @brief wrapper around IfaceMgr::receiveBatch6
+    ///
+    /// The packets are received in batches and returned one by one, so
+    /// the sockets are only waited for when all the received packets
+    /// have been returned.
     ///
     /// This method is useful for testing purposes, where its replacement
     /// simulates reception of a packet. For that purpose it is protected.
@@ -606,8 +653,88 @@ protected:
     /// will cause the packet to be assigned to class VENDOR_CLASS_FOO.
     static const std::string VENDOR_CLASS_PREFIX;
 
+    /// @brief Processes a received packet and sends the response.
+    ///
+    /// Unpacks the packet, checks whether it should be processed, generates
+    /// the response (calling the installed callouts on the way) and sends
+    /// it.  The packet is dropped if any of these steps fail.
+    ///
+    /// The pkt6_receive callouts may suspend the processing of the packet
+    /// (see @c bundy::hooks::ParkingLot): the packet is then held in the
+    /// parking lot of the hook (up to @c CfgMgr::getParkedPacketLimit
+    /// packets) and this returns at once.  Its processing is resumed by
+    /// @c processQuery once the callouts unpark it.
+    ///
+    /// This is called by the main processing loop or by the worker threads,
+    /// so it may be called by several threads at once.
+    ///
+    /// @param query the received packet
+    void processPacket(Pkt6Ptr& query);
+
+    /// @brief Generates and sends the response to an accepted packet.
+    ///
+    /// This is the part of @c processPacket following the pkt6_receive
+    /// callouts.
+    ///
+    /// @param query the received packet
+    void processQuery(Pkt6Ptr& query);
+
+    /// @brief Resumes the processing of the unparked packets.
+    ///
+    /// Called by the main processing loop.  The unparked packets are
+    /// processed at once, or queued for their worker threads.
+    void resumePackets();
+
+    /// @brief Follows the replication of the leases to the peer server.
+    ///
+    /// Called by the main processing loop.  The socket receiving the
+    /// changes of the peer is registered in @c IfaceMgr (again if the
+    /// lease database was reconfigured), and the changes of this server
+    /// are sent if the last received packets were processed.
+    void updateReplication();
+
+    /// @brief Returns the allocation engine of the calling thread.
+    ///
+    /// Each worker thread has an allocation engine of its own; other
+    /// threads use the engine of the server.
+    AllocEngine& getAllocEngine();
+
+    /// @brief Synchronizes the packet processing with reconfiguration.
+    ///
+    /// The worker threads process each packet within a read section of
+    /// this manager.  Anything changing the configuration used by the
+    /// packet processing (server reconfiguration, reloading the hooks
+    /// libraries, etc.) while there may be worker threads must be done
+    /// in an exclusive section (@c EpochManager::WriteLocker).
+    bundy::util::thread::EpochManager packet_processing_;
+
 private:
 
+    /// @brief Pool of threads processing packets (defined in dhcp6_srv.cc).
+    class WorkerPool;
+
+    /// @brief Packet unparked by the callouts and its callout handle.
+    typedef std::pair<Pkt6Ptr, bundy::hooks::CalloutHandlePtr> ResumedPacket;
+
+    /// @brief Queues a packet unparked by the pkt6_receive callouts.
+    ///
+    /// This is the function given to the parking lot with the packet.  As
+    /// in the DHCPv4 server, it only queues the packet for the main
+    /// processing loop, which resumes its processing after the callbacks
+    /// of the external sockets are called.
+    ///
+    /// @param query the parked packet
+    /// @param callout_handle the callout handle of the packet
+    void unparkPacket(const Pkt6Ptr& query,
+                      const bundy::hooks::CalloutHandlePtr& callout_handle);
+
+    /// @brief Resumes the processing of an unparked packet.
+    ///
+    /// @param query the unparked packet
+    /// @param callout_handle the callout handle of the packet
+    void resumePacket(Pkt6Ptr& query,
+                      const bundy::hooks::CalloutHandlePtr& callout_handle);
+
     /// @brief Implements the error handler for socket open failure.
     ///
     /// This callback function is installed on the @c bundy::dhcp::IfaceMgr
@@ -665,12 +792,34 @@ private:
     /// during normal operation (e.g. to use different allocators)
     boost::shared_ptr<AllocEngine> alloc_engine_;
 
+    /// Threads processing the packets, if any.
+    boost::scoped_ptr<WorkerPool> workers_;
+
     /// Server DUID (to be sent in server-identifier option)
     OptionPtr serverid_;
 
     /// UDP port number on which server listens.
     uint16_t port_;
 
+    /// Packets received in the last batch.
+    std::vector<Pkt6Ptr> received_;
+
+    /// Index of the next packet of @c received_ to return.
+    size_t received_next_;
+
+    /// Time of the next reclamation of expired leases.
+    time_t next_reclaim_;
+
+    /// Socket receiving the lease changes of the peer server, as
+    /// registered in @c IfaceMgr (-1 if none).
+    int replication_socket_;
+
+    /// Packets unparked by the callouts, waiting to be resumed.
+    std::vector<ResumedPacket> resumed_;
+
+    /// Protects @c resumed_.
+    bundy::util::thread::Mutex resumed_mutex_;
+
 protected:
 
     /// Indicates if shutdown is in progress. Setting it to true will
@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -102,6 +102,13 @@ TEST_F(CtrlDhcpv6SrvTest, commands) {
     result = ControlledDhcpv6Srv::execDhcpv6ServerCommand("shutdown", params);
     comment = parseAnswer(rcode, result);
     EXPECT_EQ(0, rcode); // Expect success
+
+    // Case 4: send lease-cache-flush command, the leases of the memfile
+    // backend are not cached
+    result = ControlledDhcpv6Srv::execDhcpv6ServerCommand("lease-cache-flush",
+                                                          params);
+    comment = parseAnswer(rcode, result);
+    EXPECT_EQ(1, rcode); // Expect failure
 }
 
 // Check that the "libreload" command will reload libraries
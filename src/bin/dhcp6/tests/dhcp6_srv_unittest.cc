@@ -33,18 +33,23 @@
 #include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/lease_mgr.h>
 #include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
 #include <dhcpsrv/utils.h>
 #include <util/buffer.h>
 #include <util/range_utilities.h>
+#include <util/threads/sync.h>
 #include <hooks/server_hooks.h>
 
 #include <dhcp6/tests/dhcp6_test_utils.h>
+#include <boost/lexical_cast.hpp>
 #include <boost/pointer_cast.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 #include <unistd.h>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
 
 using namespace bundy;
@@ -1170,6 +1175,61 @@ TEST_F(Dhcpv6SrvTest, testUnicast) {
 
 }
 
+// Test that the clients are shared with the peer server when the leases are
+// replicated, and answered by this server while the peer is down.
+TEST_F(Dhcpv6SrvTest, testLoadBalancing) {
+    NakedDhcpv6Srv srv(0);
+
+    const std::string prefix = "/tmp/bundy-dhcp6-replication-" +
+        boost::lexical_cast<std::string>(getpid());
+    ASSERT_NO_THROW(LeaseMgrFactory::create(
+        "type=memfile universe=6 persist=false replication-socket=" +
+        prefix + "-a replication-peer=" + prefix + "-b replication-node=0"));
+    const LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    ASSERT_TRUE(replicator);
+
+    // The peer is down until a batch is sent to it.
+    boost::scoped_ptr<LeaseReplicator> peer(
+        new LeaseReplicator(prefix + "-b", prefix + "-a", 1));
+    vector<uint8_t> duid(10, 1);
+    size_t accepted = 0;
+    for (duid[9] = 0; duid[9] < 64; ++duid[9]) {
+        Pkt6Ptr msg(new Pkt6(DHCPV6_SOLICIT, 1234));
+        msg->addOption(OptionPtr(new Option(Option::V6, D6O_CLIENTID,
+                                            duid)));
+        if (srv.testLoadBalancing(msg)) {
+            ++accepted;
+        }
+    }
+    EXPECT_EQ(64, accepted);
+
+    // Each client is answered by one server.
+    replicator->flush();
+    peer->flush();
+    ASSERT_TRUE(replicator->isPeerUp());
+    ASSERT_TRUE(peer->isPeerUp());
+    accepted = 0;
+    for (duid[9] = 0; duid[9] < 64; ++duid[9]) {
+        Pkt6Ptr msg(new Pkt6(DHCPV6_SOLICIT, 1234));
+        msg->addOption(OptionPtr(new Option(Option::V6, D6O_CLIENTID,
+                                            duid)));
+        const bool accept = srv.testLoadBalancing(msg);
+        EXPECT_NE(accept, peer->inScope(&duid[0], duid.size()));
+        if (accept) {
+            ++accepted;
+        }
+    }
+    EXPECT_LT(0, accepted);
+    EXPECT_GT(64, accepted);
+
+    // The server answers all the clients without replication.
+    ASSERT_NO_THROW(LeaseMgrFactory::create(
+        "type=memfile universe=6 persist=false"));
+    Pkt6Ptr msg(new Pkt6(DHCPV6_SOLICIT, 1234));
+    msg->addOption(OptionPtr(new Option(Option::V6, D6O_CLIENTID, duid)));
+    EXPECT_TRUE(srv.testLoadBalancing(msg));
+}
+
 // This test verifies if selectSubnet() selects proper subnet for a given
 // source address.
 TEST_F(Dhcpv6SrvTest, selectSubnetAddr) {
@@ -1847,6 +1907,59 @@ TEST_F(Dhcpv6SrvTest, clientClassify2) {
     EXPECT_TRUE(srv_.selectSubnet(sol));
 }
 
+// Checks that the packets are classified by the classes of the
+// configuration, and that these classes select the subnet.
+TEST_F(Dhcpv6SrvTest, clientClassifyConfigured) {
+    string config = "{ \"interfaces\": [ \"*\" ],"
+        "\"preferred-lifetime\": 3000,"
+        "\"rebind-timer\": 2000, "
+        "\"renew-timer\": 1000, "
+        "\"client-classes\": [ "
+        "{   \"name\": \"cable-modem\", "
+        "    \"test\": \"substring(option[16], 6, all) == 'docsis3.0'\" }, "
+        "{   \"name\": \"cmts-1-modem\", "
+        "    \"test\": \"member('cable-modem') and "
+        "substring(relay[18], 0, 9) == 'Bu1&Ca1/0'\" }, "
+        "{   \"name\": \"no-remote-id\", "
+        "    \"test\": \"not relay[37]\" } "
+        "],"
+        "\"subnet6\": [ "
+        " {  \"pool\": [ \"2a02:88fe:fe:1::/64\" ],"
+        "    \"subnet\": \"2a02:88fe:fe::/48\", "
+        "    \"client-class\": \"cmts-1-modem\" "
+        " }, "
+        " {  \"pool\": [ \"2001:558:ffa8::/64\" ],"
+        "    \"subnet\": \"2001:558:ffa8::/48\", "
+        "    \"client-class\": \"cable-modem\" "
+        " } "
+        "],"
+        "\"valid-lifetime\": 4000 }";
+
+    ASSERT_NO_THROW(configure(config));
+
+    // A SOLICIT from a modem relayed from the subnet belongs to all the
+    // classes.
+    Pkt6Ptr sol1;
+    ASSERT_NO_THROW(sol1 = captureDocsisRelayedSolicit());
+    ASSERT_NO_THROW(sol1->unpack());
+    srv_.classifyPacket(sol1);
+    EXPECT_TRUE(sol1->inClass("VENDOR_CLASS_docsis3.0"));
+    EXPECT_TRUE(sol1->inClass("cable-modem"));
+    EXPECT_TRUE(sol1->inClass("cmts-1-modem"));
+    EXPECT_TRUE(sol1->inClass("no-remote-id"));
+    EXPECT_TRUE(srv_.selectSubnet(sol1));
+
+    // The eRouter is not a modem, so it is not served by the subnet of its
+    // relay.
+    Pkt6Ptr sol2;
+    ASSERT_NO_THROW(sol2 = captureeRouterRelayedSolicit());
+    ASSERT_NO_THROW(sol2->unpack());
+    srv_.classifyPacket(sol2);
+    EXPECT_FALSE(sol2->inClass("cable-modem"));
+    EXPECT_FALSE(sol2->inClass("cmts-1-modem"));
+    EXPECT_FALSE(srv_.selectSubnet(sol2));
+}
+
 // This test checks that the server will handle a Solicit with the Vendor Class
 // having a length of 4 (enterprise-id only).
 TEST_F(Dhcpv6SrvTest, cableLabsShortVendorClass) {
@@ -2014,6 +2127,107 @@ TEST_F(Dhcpv6SrvTest, relayOverrideAndClientClass) {
     EXPECT_TRUE(subnet1 == srv_.selectSubnet(sol));
 }
 
+// A server whose sent packets are stored under a mutex, so that it can
+// be used with worker threads.
+class ThreadedDhcpv6Srv : public NakedDhcpv6Srv {
+public:
+    ThreadedDhcpv6Srv() : NakedDhcpv6Srv(0) {}
+
+    virtual void sendPacket(const Pkt6Ptr& pkt) {
+        bundy::util::thread::Mutex::Locker locker(mutex_);
+        NakedDhcpv6Srv::sendPacket(pkt);
+    }
+
+private:
+    bundy::util::thread::Mutex mutex_;
+};
+
+// Checks that the REQUESTs are processed by the worker threads when they
+// are configured, that each client gets its own address and prefix, and
+// that the packets of a client are processed in order.
+TEST_F(Dhcpv6SrvTest, workerThreads) {
+    CfgMgr::instance().setWorkerThreads(4);
+
+    ThreadedDhcpv6Srv srv;
+
+    // Each client sends two REQUESTs, the second of which must get the
+    // leases allocated for the first.  Half of the clients are behind a
+    // relay agent.
+    const int client_count = 10;
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < client_count; ++i) {
+            Pkt6Ptr req(new Pkt6(DHCPV6_REQUEST, 1000 + round * 100 + i));
+            OptionBuffer clnt_duid(16, 0x42);
+            clnt_duid[15] = static_cast<uint8_t>(i);
+            req->addOption(OptionPtr(new Option(Option::V6, D6O_CLIENTID,
+                                                clnt_duid)));
+            req->addOption(srv.getServerID());
+            req->addOption(generateIA(D6O_IA_NA, 234, 1500, 3000));
+            req->addOption(generateIA(D6O_IA_PD, 345, 1500, 3000));
+            if (i % 2 != 0) {
+                Pkt6::RelayInfo relay;
+                relay.msg_type_ = DHCPV6_RELAY_FORW;
+                relay.linkaddr_ = IOAddress("2001:db8:1::1");
+                relay.peeraddr_ = IOAddress("fe80::1");
+                req->relay_info_.push_back(relay);
+            }
+            ASSERT_NO_THROW(req->pack());
+
+            // The server unpacks the received packets itself
+            const OutputBuffer& buf = req->getBuffer();
+            Pkt6Ptr raw(new Pkt6(static_cast<const uint8_t*>(buf.getData()),
+                                 buf.getLength()));
+            raw->setRemoteAddr(IOAddress("fe80::abcd"));
+            raw->setIface("eth0");
+            srv.fakeReceive(raw);
+        }
+    }
+
+    // Returns when all the queued packets have been processed
+    srv.run();
+    CfgMgr::instance().setWorkerThreads(0);
+
+    ASSERT_EQ(2 * client_count, srv.fake_sent_.size());
+    map<uint32_t, IOAddress> addresses;
+    map<uint32_t, IOAddress> prefixes;
+    for (list<Pkt6Ptr>::const_iterator reply = srv.fake_sent_.begin();
+         reply != srv.fake_sent_.end(); ++reply) {
+        ASSERT_EQ(DHCPV6_REPLY, (*reply)->getType());
+        const uint32_t client = (*reply)->getTransid() % 100;
+        boost::shared_ptr<Option6IAAddr> addr =
+            checkIA_NA(*reply, 234, subnet_->getT1(), subnet_->getT2());
+        ASSERT_TRUE(addr);
+        boost::shared_ptr<Option6IAPrefix> prefix =
+            checkIA_PD(*reply, 345, subnet_->getT1(), subnet_->getT2());
+        ASSERT_TRUE(prefix);
+
+        if ((*reply)->getTransid() < 1100) {
+            addresses.insert(make_pair(client, addr->getAddress()));
+            prefixes.insert(make_pair(client, prefix->getAddress()));
+        }
+    }
+    ASSERT_EQ(client_count, addresses.size());
+    ASSERT_EQ(client_count, prefixes.size());
+
+    // The second REQUEST of each client was processed after the first.
+    set<IOAddress> distinct_addresses;
+    set<IOAddress> distinct_prefixes;
+    for (list<Pkt6Ptr>::const_iterator reply = srv.fake_sent_.begin();
+         reply != srv.fake_sent_.end(); ++reply) {
+        const uint32_t client = (*reply)->getTransid() % 100;
+        boost::shared_ptr<Option6IAAddr> addr =
+            checkIA_NA(*reply, 234, subnet_->getT1(), subnet_->getT2());
+        boost::shared_ptr<Option6IAPrefix> prefix =
+            checkIA_PD(*reply, 345, subnet_->getT1(), subnet_->getT2());
+        EXPECT_EQ(addresses.find(client)->second, addr->getAddress());
+        EXPECT_EQ(prefixes.find(client)->second, prefix->getAddress());
+        distinct_addresses.insert(addr->getAddress());
+        distinct_prefixes.insert(prefix->getAddress());
+    }
+    EXPECT_EQ(client_count, distinct_addresses.size());
+    EXPECT_EQ(client_count, distinct_prefixes.size());
+}
+
 /// @todo: Add more negative tests for processX(), e.g. extend sanityCheck() test
 /// to call processX() methods.
 
@@ -105,12 +105,14 @@ public:
     using Dhcpv6Srv::selectSubnet;
     using Dhcpv6Srv::testServerID;
     using Dhcpv6Srv::testUnicast;
+    using Dhcpv6Srv::testLoadBalancing;
     using Dhcpv6Srv::sanityCheck;
     using Dhcpv6Srv::classifyPacket;
     using Dhcpv6Srv::loadServerID;
     using Dhcpv6Srv::writeServerID;
     using Dhcpv6Srv::unpackOptions;
     using Dhcpv6Srv::shutdown_;
+    using Dhcpv6Srv::resumePackets;
     using Dhcpv6Srv::name_change_reqs_;
     using Dhcpv6Srv::VENDOR_CLASS_PREFIX;
 
@@ -349,6 +351,9 @@ public:
     /// Removes existing configuration.
     ~Dhcpv6SrvTest() {
         bundy::dhcp::CfgMgr::instance().deleteSubnets6();
+        bundy::dhcp::CfgMgr::instance().setWorkerThreads(0);
+        bundy::dhcp::CfgMgr::instance().setClientClassifier(
+            bundy::dhcp::ClientClassifierPtr());
     };
 
     /// @brief Runs DHCPv6 configuration from the JSON string.
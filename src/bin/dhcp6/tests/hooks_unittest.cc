@@ -194,6 +194,46 @@ public:
         return pkt6_receive_callout(callout_handle);
     }
 
+    /// Test callback that parks the first packet
+    /// @param callout_handle handle passed by the hooks framework
+    /// @return always 0
+    static int
+    pkt6_receive_park(CalloutHandle& callout_handle) {
+
+        Pkt6Ptr pkt;
+        callout_handle.getArgument("query6", pkt);
+
+        if (!callback_parked_ &&
+            callout_handle.getParkingLot()->reference(pkt)) {
+            callout_handle.setPark(true);
+            callout_handle.setContext("parked", true);
+            callback_parked_ = pkt;
+        }
+
+        // Carry on as usual
+        return pkt6_receive_callout(callout_handle);
+    }
+
+    /// Test callback that counts the responses to parked packets
+    ///
+    /// It checks the context set by pkt6_receive_park.
+    /// @param callout_handle handle passed by the hooks framework
+    /// @return always 0
+    static int
+    pkt6_send_parked(CalloutHandle& callout_handle) {
+
+        bool parked = false;
+        try {
+            callout_handle.getContext("parked", parked);
+        } catch (const NoSuchCalloutContext&) {
+            // Not parked
+        }
+        if (parked) {
+            ++callback_resumed_;
+        }
+        return (0);
+    }
+
     /// Test callback that stores received callout name and pkt6 value
     /// @param callout_handle handle passed by the hooks framework
     /// @return always 0
@@ -465,6 +505,8 @@ public:
         callback_ia_na_.reset();
         callback_subnet6collection_ = NULL;
         callback_argument_names_.clear();
+        callback_parked_.reset();
+        callback_resumed_ = 0;
     }
 
     /// Pointer to Dhcpv6Srv that is used in tests
@@ -492,6 +534,12 @@ public:
 
     /// A list of all received arguments
     static vector<string> callback_argument_names_;
+
+    /// Packet parked by pkt6_receive_park
+    static Pkt6Ptr callback_parked_;
+
+    /// Number of responses to parked packets seen by pkt6_send_parked
+    static int callback_resumed_;
 };
 
 // The following parameters are used by callouts to override
@@ -509,6 +557,8 @@ Pkt6Ptr HooksDhcpv6SrvTest::callback_pkt6_;
 Subnet6Ptr HooksDhcpv6SrvTest::callback_subnet6_;
 const Subnet6Collection* HooksDhcpv6SrvTest::callback_subnet6collection_;
 vector<string> HooksDhcpv6SrvTest::callback_argument_names_;
+Pkt6Ptr HooksDhcpv6SrvTest::callback_parked_;
+int HooksDhcpv6SrvTest::callback_resumed_;
 Lease6Ptr HooksDhcpv6SrvTest::callback_lease6_;
 boost::shared_ptr<Option6IA> HooksDhcpv6SrvTest::callback_ia_na_;
 
@@ -753,6 +803,44 @@ TEST_F(HooksDhcpv6SrvTest, skip_pkt6_receive) {
     ASSERT_EQ(0, srv_->fake_sent_.size());
 }
 
+// Checks that callouts installed on pkt6_receive can suspend the processing
+// of a packet, the server processing the other packets meanwhile, and that
+// the processing is resumed with the same callout context.
+TEST_F(HooksDhcpv6SrvTest, pkt6ReceivePark) {
+
+    // Install the callout parking the first packet
+    EXPECT_NO_THROW(HooksManager::preCalloutsLibraryHandle().registerCallout(
+                        "pkt6_receive", pkt6_receive_park));
+    EXPECT_NO_THROW(HooksManager::preCalloutsLibraryHandle().registerCallout(
+                        "pkt6_send", pkt6_send_parked));
+
+    // Let's create two simple SOLICITs
+    Pkt6Ptr parked = Pkt6Ptr(captureSimpleSolicit());
+    srv_->fakeReceive(parked);
+    srv_->fakeReceive(Pkt6Ptr(captureSimpleSolicit()));
+
+    // The first one is parked, the second one answered.
+    srv_->run();
+    EXPECT_TRUE(callback_parked_ == parked);
+    ASSERT_EQ(1, srv_->fake_sent_.size());
+    EXPECT_EQ(0, callback_resumed_);
+
+    ParkingLotPtr lot = HooksManager::getParkingLot(
+        ServerHooks::getServerHooks().getIndex("pkt6_receive"));
+    EXPECT_EQ(1, lot->size());
+
+    // Unpark the first one: it is answered by the processing loop.
+    EXPECT_TRUE(lot->unpark(parked));
+    EXPECT_EQ(0, lot->size());
+    EXPECT_EQ(1, srv_->fake_sent_.size());
+
+    srv_->resumePackets();
+    ASSERT_EQ(2, srv_->fake_sent_.size());
+    EXPECT_EQ(srv_->fake_sent_.front()->getType(),
+              srv_->fake_sent_.back()->getType());
+    EXPECT_EQ(1, callback_resumed_);
+}
+
 
 // Checks if callouts installed on pkt6_send are indeed called and the
 // all necessary parameters are passed.
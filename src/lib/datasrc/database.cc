@@ -34,7 +34,12 @@
 #include <datasrc/exceptions.h>
 #include <datasrc/logger.h>
 
+#include <util/threads/sync.h>
+#include <util/threads/thread.h>
+
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 
 using namespace bundy::dns;
@@ -42,6 +47,9 @@ using namespace std;
 using namespace bundy::dns::rdata;
 using boost::lexical_cast;
 using boost::scoped_ptr;
+using bundy::util::thread::CondVar;
+using bundy::util::thread::Mutex;
+using bundy::util::thread::Thread;
 
 namespace bundy {
 namespace datasrc {
@@ -79,8 +87,245 @@ private:
     DatabaseAccessor& accessor_;
     bool committed_;
 };
+
+// Get the serial of the SOA at the origin of the given zone.  Returns false
+// if the zone doesn't have a (valid) SOA, in which case the serial is
+// unchanged.
+bool
+getZoneSerial(const DatabaseAccessor& accessor, int zone_id,
+              const Name& origin, const RRClass& rrclass, uint32_t& serial)
+{
+    DatabaseAccessor::IteratorContextPtr
+        context(accessor.getRecords(origin.toText(), zone_id));
+    if (!context) {
+        bundy_throw(bundy::Unexpected, "Iterator context null at " << origin);
+    }
+    string columns[DatabaseAccessor::COLUMN_COUNT];
+    while (context->getNext(columns)) {
+        try {
+            if (RRType(columns[DatabaseAccessor::TYPE_COLUMN]) ==
+                RRType::SOA()) {
+                const ConstRdataPtr rdata =
+                    createRdata(RRType::SOA(), rrclass,
+                                columns[DatabaseAccessor::RDATA_COLUMN]);
+                serial = dynamic_cast<const generic::SOA&>(*rdata).
+                    getSerial().getValue();
+                return (true);
+            }
+        } catch (const bundy::Exception&) {
+            // Broken data; we'll treat it as if there were no SOA.
+            return (false);
+        }
+    }
+    return (false);
+}
+
+// Build the negative lookup filter of the given zone by iterating over it.
+// The filter is tagged with the SOA serial of the zone so the finders can
+// detect modifications made by others.  Without an SOA we can't do that,
+// so NULL is returned for such zone (which is broken anyway), as well as
+// when the filter can't be built for other reasons.
+ZoneNameFilterPtr
+buildZoneNameFilter(DatabaseAccessor& accessor, int zone_id,
+                    const Name& origin, const RRClass& rrclass)
+{
+    ZoneNameFilterPtr filter;
+    try {
+        // Note that we get the serial before reading the zone content; if
+        // the zone is modified in between, the serial won't match and the
+        // filter will simply be rebuilt later.
+        uint32_t serial;
+        if (!getZoneSerial(accessor, zone_id, origin, rrclass, serial)) {
+            return (filter);
+        }
+
+        // Count the records first to size the filter.  It's an upper bound
+        // of the number of names, and usually not much larger.
+        string columns[DatabaseAccessor::COLUMN_COUNT];
+        size_t record_count = 0;
+        DatabaseAccessor::IteratorContextPtr
+            context(accessor.getAllRecords(zone_id));
+        if (!context) {
+            bundy_throw(bundy::Unexpected, "Iterator context null for zone "
+                        << origin);
+        }
+        while (context->getNext(columns)) {
+            ++record_count;
+        }
+
+        filter.reset(new ZoneNameFilter(origin, record_count));
+        filter->setSerial(serial);
+        context = accessor.getAllRecords(zone_id);
+        string last_name;
+        while (context->getNext(columns)) {
+            // RRs of the same name are normally returned in a row.
+            if (columns[DatabaseAccessor::NAME_COLUMN] != last_name) {
+                last_name = columns[DatabaseAccessor::NAME_COLUMN];
+                filter->add(Name(last_name));
+            }
+        }
+        LOG_DEBUG(logger, DBG_TRACE_BASIC,
+                  DATASRC_DATABASE_NAME_FILTER_BUILT).
+            arg(origin).arg(accessor.getDBName()).arg(record_count);
+    } catch (const std::exception& ex) {
+        // This includes the case where the accessor doesn't support
+        // iteration.  The finders will simply work without the filter.
+        LOG_INFO(logger, DATASRC_DATABASE_NAME_FILTER_FAIL).
+            arg(origin).arg(accessor.getDBName()).arg(ex.what());
+        filter.reset();
+    }
+    return (filter);
+}
 } // end unnamed namespace
 
+// The negative lookup filters of a DatabaseClient, indexed by zone ID.
+//
+// The filters are shared with the finders of all threads, so a published
+// filter is never modified; a change replaces it with another filter.  A
+// NULL entry means the filter can't be built for the zone, and we don't
+// try it again unless the zone is updated by the client.
+//
+// A zone looked up without a filter is queued, and the builder thread
+// builds its filter with a clone of the accessor, so filters are never
+// built on the lookup path.
+class DatabaseNameFilters : boost::noncopyable {
+public:
+    DatabaseNameFilters(const boost::shared_ptr<DatabaseAccessor>& accessor,
+                        const RRClass& rrclass) :
+        accessor_(accessor), rrclass_(rrclass), building_(0),
+        busy_(false), overridden_(false), stopping_(false)
+    {
+        thread_.reset(new Thread(boost::bind(&DatabaseNameFilters::run,
+                                             this)));
+    }
+
+    ~DatabaseNameFilters() {
+        {
+            Mutex::Locker locker(mutex_);
+            stopping_ = true;
+            cond_.signal();
+        }
+        thread_->wait();
+    }
+
+    // Return the current filter of the zone.  If there's none yet, the zone
+    // is queued for the builder thread (if queue is true) and NULL is
+    // returned.
+    ConstZoneNameFilterPtr get(int zone_id, const Name& origin, bool queue) {
+        Mutex::Locker locker(mutex_);
+        const FilterMap::const_iterator found = filters_.find(zone_id);
+        if (found != filters_.end()) {
+            return (found->second);
+        }
+        if (queue) {
+            enqueue(zone_id, origin);
+        }
+        return (ConstZoneNameFilterPtr());
+    }
+
+    // Set the filter of the zone (NULL if it can't be built).  If expected
+    // is given, the filter is replaced only if the current one is still
+    // expected; it returns false otherwise.
+    bool set(int zone_id, const ZoneNameFilterPtr& filter,
+             const ConstZoneNameFilterPtr* expected = NULL)
+    {
+        Mutex::Locker locker(mutex_);
+        if (expected != NULL) {
+            const FilterMap::const_iterator found = filters_.find(zone_id);
+            if (found == filters_.end() || found->second != *expected) {
+                return (false);
+            }
+        }
+        filters_[zone_id] = filter;
+        markOverridden(zone_id);
+        return (true);
+    }
+
+    // Discard the filter of the zone if it's still the stale one, and queue
+    // the zone to build a new filter.
+    void rebuild(int zone_id, const Name& origin,
+                 const ConstZoneNameFilterPtr& stale)
+    {
+        Mutex::Locker locker(mutex_);
+        const FilterMap::iterator found = filters_.find(zone_id);
+        if (found != filters_.end() && found->second == stale) {
+            filters_.erase(found);
+            enqueue(zone_id, origin);
+        }
+    }
+
+    // Forget the zone (which has been deleted).
+    void erase(int zone_id) {
+        Mutex::Locker locker(mutex_);
+        filters_.erase(zone_id);
+        queue_.erase(zone_id);
+        markOverridden(zone_id);
+    }
+
+private:
+    typedef std::map<int, ConstZoneNameFilterPtr> FilterMap;
+
+    // These must be called with the mutex locked.
+    void enqueue(int zone_id, const Name& origin) {
+        if (queue_.insert(std::make_pair(zone_id, origin)).second) {
+            cond_.signal();
+        }
+    }
+    void markOverridden(int zone_id) {
+        // A change made while the zone is being built takes precedence
+        // over the filter being built.
+        if (busy_ && building_ == zone_id) {
+            overridden_ = true;
+        }
+    }
+
+    // The main loop of the builder thread.
+    void run() {
+        while (true) {
+            int zone_id;
+            Name origin(Name::ROOT_NAME());
+            {
+                Mutex::Locker locker(mutex_);
+                while (!stopping_ && queue_.empty()) {
+                    cond_.wait(mutex_);
+                }
+                if (stopping_) {
+                    return;
+                }
+                zone_id = queue_.begin()->first;
+                origin = queue_.begin()->second;
+                queue_.erase(queue_.begin());
+                building_ = zone_id;
+                busy_ = true;
+                overridden_ = false;
+            }
+            const ZoneNameFilterPtr filter(buildZoneNameFilter(*accessor_,
+                                                               zone_id,
+                                                               origin,
+                                                               rrclass_));
+            Mutex::Locker locker(mutex_);
+            if (!overridden_) {
+                filters_[zone_id] = filter;
+            }
+            busy_ = false;
+        }
+    }
+
+    // Only used by the builder thread.
+    const boost::shared_ptr<DatabaseAccessor> accessor_;
+    const RRClass rrclass_;
+
+    Mutex mutex_;
+    CondVar cond_;
+    FilterMap filters_;
+    std::map<int, Name> queue_;
+    int building_;
+    bool busy_;
+    bool overridden_;
+    bool stopping_;
+    boost::scoped_ptr<Thread> thread_;
+};
+
 
 DatabaseClient::DatabaseClient(const std::string& datasrc_name, RRClass rrclass,
                                boost::shared_ptr<DatabaseAccessor>
@@ -93,14 +338,38 @@ DatabaseClient::DatabaseClient(const std::string& datasrc_name, RRClass rrclass,
     }
 }
 
+void
+DatabaseClient::setNameFilterEnabled(bool enabled) {
+    if (!enabled) {
+        name_filters_.reset();
+    } else if (!name_filters_) {
+        name_filters_.reset(new DatabaseNameFilters(accessor_->clone(),
+                                                    rrclass_));
+    }
+}
+
+bool
+DatabaseClient::buildNameFilter(const Name& zone_name) {
+    if (!name_filters_) {
+        return (false);
+    }
+    const std::pair<bool, int> zone(accessor_->getZone(zone_name.toText()));
+    if (!zone.first) {
+        return (false);
+    }
+    const ZoneNameFilterPtr filter(buildZoneNameFilter(*accessor_,
+                                                       zone.second,
+                                                       zone_name, rrclass_));
+    name_filters_->set(zone.second, filter);
+    return (filter.get() != NULL);
+}
+
 DataSourceClient::FindResult
 DatabaseClient::findZone(const Name& name) const {
     std::pair<bool, int> zone(accessor_->getZone(name.toText()));
     // Try exact first
     if (zone.first) {
-        return (FindResult(result::SUCCESS,
-                           ZoneFinderPtr(new Finder(accessor_,
-                                                    zone.second, name)),
+        return (FindResult(result::SUCCESS, getFinder(zone.second, name),
                            name.getLabelCount()));
     }
     // Then super domains
@@ -110,10 +379,7 @@ DatabaseClient::findZone(const Name& name) const {
         zone = accessor_->getZone(superdomain.toText());
         if (zone.first) {
             return (FindResult(result::PARTIALMATCH,
-                               ZoneFinderPtr(new Finder(accessor_,
-                                                        zone.second,
-                                                        superdomain)),
-
+                               getFinder(zone.second, superdomain),
                                superdomain.getLabelCount()));
         }
     }
@@ -121,6 +387,19 @@ DatabaseClient::findZone(const Name& name) const {
     return (FindResult(result::NOTFOUND, ZoneFinderPtr(), 0));
 }
 
+ZoneFinderPtr
+DatabaseClient::getFinder(int zone_id, const Name& origin) const {
+    ZoneFinderPtr finder(finder_cache_.find(accessor_.get(), zone_id));
+    // We only put our own finders there
+    if (finder &&
+        static_cast<Finder&>(*finder).reuse(origin, name_filters_)) {
+        return (finder);
+    }
+    finder.reset(new Finder(accessor_, zone_id, origin, name_filters_));
+    finder_cache_.add(accessor_.get(), zone_id, finder);
+    return (finder);
+}
+
 bool
 DatabaseClient::createZone(const Name& zone_name) {
     TransactionHolder transaction(*accessor_);
@@ -142,15 +421,40 @@ DatabaseClient::deleteZone(const Name& zone_name) {
     }
     accessor_->deleteZone(zinfo.second);
     transaction.commit();
+    if (name_filters_) {
+        name_filters_->erase(zinfo.second);
+    }
     return (true);
 }
 
 DatabaseClient::Finder::Finder(boost::shared_ptr<DatabaseAccessor> accessor,
-                               int zone_id, const bundy::dns::Name& origin) :
+                               int zone_id, const bundy::dns::Name& origin,
+                               DatabaseNameFiltersPtr name_filters) :
     accessor_(accessor),
     zone_id_(zone_id),
-    origin_(origin)
-{ }
+    origin_(origin),
+    name_filters_(name_filters),
+    name_filter_checked_(false)
+{
+    if (name_filters_) {
+        name_filter_ = name_filters_->get(zone_id_, origin_, true);
+    }
+}
+
+bool
+DatabaseClient::Finder::reuse(const Name& origin,
+                              const DatabaseNameFiltersPtr& name_filters)
+{
+    if (name_filters != name_filters_ ||
+        !LabelSequence(origin_).equals(LabelSequence(origin), true)) {
+        return (false);
+    }
+    if (name_filters_) {
+        name_filter_ = name_filters_->get(zone_id_, origin_, true);
+    }
+    name_filter_checked_ = false;
+    return (true);
+}
 
 namespace {
 // Adds the given Rdata to the given RRset
@@ -257,6 +561,13 @@ DatabaseClient::Finder::getRRsets(const string& name, const WantedTypes& types,
     bool records_found = false;
     std::map<RRType, RRsetPtr> result;
 
+    // If we know the name doesn't exist, there's no need to ask the
+    // database.  This doesn't apply to explicitly given contexts, which
+    // may be for the NSEC3 namespace.
+    if (!context && isKnownNonexistent(name)) {
+        return (FoundRRsets(false, result));
+    }
+
     // Request the context in case we didn't get one
     if (!context) {
         context = accessor_->getRecords(name, zone_id_);
@@ -363,6 +674,11 @@ DatabaseClient::Finder::getRRsets(const string& name, const WantedTypes& types,
 
 bool
 DatabaseClient::Finder::hasSubdomains(const std::string& name) {
+    // The negative lookup filter covers empty non-terminals, too.
+    if (isKnownNonexistent(name)) {
+        return (false);
+    }
+
     // Request the context
     DatabaseAccessor::IteratorContextPtr
         context(accessor_->getRecords(name, zone_id_, true));
@@ -375,6 +691,35 @@ DatabaseClient::Finder::hasSubdomains(const std::string& name) {
     return (context->getNext(columns));
 }
 
+bool
+DatabaseClient::Finder::isKnownNonexistent(const std::string& name) {
+    if (!name_filter_) {
+        return (false);
+    }
+    if (name_filter_->mayExist(Name(name))) {
+        return (false);
+    }
+
+    // Before trusting the filter, make sure the zone hasn't been modified
+    // since the filter was built.  As a finder is normally used for a
+    // single query, it's enough to check it the first time.
+    if (!name_filter_checked_) {
+        name_filter_checked_ = true;
+        uint32_t serial;
+        if (!getZoneSerial(*accessor_, zone_id_, origin_, getClass(),
+                           serial) ||
+            serial != name_filter_->getSerial()) {
+            LOG_DEBUG(logger, DBG_TRACE_BASIC,
+                      DATASRC_DATABASE_NAME_FILTER_STALE).
+                arg(origin_).arg(accessor_->getDBName());
+            name_filters_->rebuild(zone_id_, origin_, name_filter_);
+            name_filter_.reset();
+            return (false);
+        }
+    }
+    return (true);
+}
+
 // Some manipulation with RRType sets
 namespace {
 
@@ -1415,6 +1760,17 @@ public:
     }
 };
 
+// The textual forms of an owner name as stored in the database, as is and
+// reversed.  When a zone is loaded, the RRsets usually come grouped by owner
+// names, so remembering the forms for the last name saves most of the
+// conversions.
+struct OwnerNameCache {
+    OwnerNameCache() : name(Name::ROOT_NAME()) {}
+    Name name;
+    string text;        // empty until the first name is stored
+    string revtext;
+};
+
 //
 // Zone updater using some database system as the underlying data source.
 //
@@ -1422,12 +1778,15 @@ class DatabaseUpdater : public ZoneUpdater {
 public:
     DatabaseUpdater(boost::shared_ptr<DatabaseAccessor> accessor, int zone_id,
             const Name& zone_name, const RRClass& zone_class,
-            bool journaling) :
+            bool journaling, DatabaseNameFiltersPtr name_filters,
+            ConstZoneNameFilterPtr name_filter, bool name_filter_current) :
         committed_(false), accessor_(accessor), zone_id_(zone_id),
         db_name_(accessor->getDBName()), zone_name_(zone_name.toText()),
         zone_class_(zone_class), journaling_(journaling),
         diff_phase_(NOT_STARTED), serial_(0),
-        finder_(new DatabaseClient::Finder(accessor_, zone_id_, zone_name))
+        finder_(new DatabaseClient::Finder(accessor_, zone_id_, zone_name)),
+        name_filters_(name_filters), name_filter_(name_filter),
+        name_filter_current_(name_filter_current)
     {
         logger.debug(DBG_TRACE_DATA, DATASRC_DATABASE_UPDATER_CREATED)
             .arg(zone_name_).arg(zone_class_).arg(db_name_);
@@ -1489,6 +1848,19 @@ private:
     boost::scoped_ptr<DatabaseClient::Finder> finder_;
     boost::shared_ptr<bundy::datasrc::RRsetCollection> rrset_collection_;
 
+    // The negative lookup filters of the client (if enabled), the filter of
+    // the zone at the beginning of the update (if any), whether its content
+    // corresponded to the zone at that point, and the names added in this
+    // update.  On commit, the filter of the zone is replaced with an updated
+    // one.
+    DatabaseNameFiltersPtr name_filters_;
+    ConstZoneNameFilterPtr name_filter_;
+    const bool name_filter_current_;
+    std::vector<Name> added_names_;
+
+    // The owner name last added
+    OwnerNameCache owner_name_cache_;
+
     // This is a set of validation checks commonly used for addRRset() and
     // deleteRRset to minimize duplicate code logic and to make the main
     // code concise.
@@ -1550,10 +1922,29 @@ DatabaseUpdater::validateAddOrDelete(const char* const op_str,
 // (this implicitly assumes copying std::string objects is not very expensive;
 // this is often the case in some common implementations that have
 // copy-on-write semantics for the string class).
+//
+// If an OwnerNameCache is given, the owner name and its reversed form are
+// taken from it if it holds the same name, and it's updated otherwise.
 class RRParameterConverter {
 public:
-    RRParameterConverter(const AbstractRRset& rrset) : rrset_(rrset)
-    {}
+    RRParameterConverter(const AbstractRRset& rrset,
+                         OwnerNameCache* name_cache = NULL) :
+        rrset_(rrset)
+    {
+        if (name_cache != NULL) {
+            const Name& name = rrset.getName();
+            // The text is kept as is, so the comparison is case sensitive.
+            if (name_cache->text.empty() ||
+                !LabelSequence(name_cache->name).equals(LabelSequence(name),
+                                                        true)) {
+                name_cache->name = name;
+                name_cache->text = name.toText();
+                name_cache->revtext = name.reverse().toText();
+            }
+            name_ = name_cache->text;
+            revname_ = name_cache->revtext;
+        }
+    }
     const string& getName() {
         if (name_.empty()) {
             name_ = rrset_.getName().toText();
@@ -1638,7 +2029,8 @@ DatabaseUpdater::addRRset(const AbstractRRset& rrset) {
         }
     }
 
-    RRParameterConverter cvtr(rrset);
+    RRParameterConverter cvtr(rrset, &owner_name_cache_);
+    bool name_added = false;
     for (; !it->isLast(); it->next()) {
         const Rdata& rdata = it->getCurrent();
         const bool nsec3_type = isNSEC3KindType(rrset.getType(), rdata);
@@ -1676,6 +2068,10 @@ DatabaseUpdater::addRRset(const AbstractRRset& rrset) {
             accessor_->addRecordToZone(columns);
             LOG_DEBUG(logger, DBG_TRACE_DETAILED, DATASRC_DATABASE_ADDRR).
                 arg(cvtr.getName()).arg(cvtr.getType()).arg(rdata_txt);
+            if (name_filter_ && !name_added) {
+                added_names_.push_back(rrset.getName());
+                name_added = true;
+            }
         }
     }
 }
@@ -1749,9 +2145,39 @@ DatabaseUpdater::commit() {
     if (journaling_ && diff_phase_ == DELETE) {
         bundy_throw(bundy::BadValue, "Update sequence not complete");
     }
+    // Get the new serial for the negative lookup filter while we are still
+    // in the transaction, so it exactly corresponds to our changes.
+    uint32_t new_serial = 0;
+    const bool filter_updatable = name_filter_ && name_filter_current_ &&
+        getZoneSerial(*accessor_, zone_id_, finder_->getOrigin(),
+                      zone_class_, new_serial);
     accessor_->commit();
     committed_ = true; // make sure the destructor won't trigger rollback
 
+    // If nobody has replaced the filter since the update began, adding the
+    // new names to a copy of it makes it current again.  Otherwise we can't
+    // tell what's in the zone, so we build a new filter from the committed
+    // zone here rather than leaving it to the lookups.
+    if (name_filters_) {
+        bool updated = false;
+        if (filter_updatable) {
+            const ZoneNameFilterPtr filter(name_filter_->clone());
+            BOOST_FOREACH(const Name& name, added_names_) {
+                filter->add(name);
+            }
+            filter->setSerial(new_serial);
+            updated = name_filters_->set(zone_id_, filter, &name_filter_);
+        }
+        if (!updated) {
+            name_filters_->set(zone_id_,
+                               buildZoneNameFilter(*accessor_, zone_id_,
+                                                   finder_->getOrigin(),
+                                                   zone_class_));
+        }
+        name_filter_.reset();
+        name_filters_.reset();
+    }
+
     // Disable the RRsetCollection if it exists.
     if (rrset_collection_) {
         rrset_collection_->disableWrapper();
@@ -1780,9 +2206,32 @@ DatabaseClient::getUpdater(const bundy::dns::Name& name, bool replace,
     if (!zone.first) {
         return (ZoneUpdaterPtr());
     }
+    // Replacing the zone means loading the whole zone content; let the
+    // accessor optimize for it.
+    if (replace) {
+        update_accessor->startBulkLoad();
+    }
+
+    // If we have a negative lookup filter for the zone, the updater keeps
+    // it up to date by adding the new names.  That's possible only if the
+    // filter corresponds to the zone content at the beginning of this
+    // update, which we check with the serial in the update transaction.
+    // Otherwise, including when replacing the zone, the updater builds a new
+    // filter on commit.
+    ConstZoneNameFilterPtr name_filter;
+    if (name_filters_) {
+        name_filter = name_filters_->get(zone.second, name, false);
+    }
+    uint32_t base_serial = 0;
+    const bool name_filter_current = name_filter && !replace &&
+        getZoneSerial(*update_accessor, zone.second, name, rrclass_,
+                      base_serial) &&
+        base_serial == name_filter->getSerial();
 
     return (ZoneUpdaterPtr(new DatabaseUpdater(update_accessor, zone.second,
-                                               name, rrclass_, journaling)));
+                                               name, rrclass_, journaling,
+                                               name_filters_, name_filter,
+                                               name_filter_current)));
 }
 
 //
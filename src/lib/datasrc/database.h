@@ -28,6 +28,8 @@
 #include <datasrc/client.h>
 #include <datasrc/zone.h>
 #include <datasrc/logger.h>
+#include <datasrc/zone_name_filter.h>
+#include <datasrc/zone_finder_cache.h>
 
 #include <dns/name.h>
 #include <exceptions/exceptions.h>
@@ -475,6 +477,25 @@ public:
     virtual std::pair<bool, int> startUpdateZone(const std::string& zone_name,
                                                  bool replace) = 0;
 
+    /// \brief Hint that the zone being updated is going to be filled in bulk.
+    ///
+    /// \c DatabaseClient calls this method right after a successful call
+    /// to \c startUpdateZone() with \c replace being true, that is, when the
+    /// whole content of the zone is (re)loaded, normally by a large number
+    /// of \c addRecordToZone() calls.  A derived class may use it to switch
+    /// to a faster way of adding records, e.g., by batching the insertions
+    /// or deferring index maintenance until the end of the update.
+    ///
+    /// Any such optimization must be transparent to the caller: records
+    /// added must be visible to subsequent lookups through this accessor,
+    /// and \c commit() and \c rollback() must work as usual.
+    ///
+    /// The default implementation does nothing.
+    ///
+    /// \exception DataSourceError Called without starting a zone update,
+    /// or some internal database related error.
+    virtual void startBulkLoad() {}
+
     /// \brief Add a single record to the zone to be updated.
     ///
     /// This method provides a simple interface to insert a new record
@@ -853,6 +874,15 @@ public:
         const = 0;
 };
 
+/// \brief The negative lookup filters of the zones of a \c DatabaseClient.
+///
+/// This is an implementation detail of \c DatabaseClient and defined in
+/// the .cc file; see \c DatabaseClient::setNameFilterEnabled().
+class DatabaseNameFilters;
+
+/// \brief A pointer to \c DatabaseNameFilters.
+typedef boost::shared_ptr<DatabaseNameFilters> DatabaseNameFiltersPtr;
+
 /// \brief Concrete data source client oriented at database backends.
 ///
 /// This class (together with corresponding versions of ZoneFinder,
@@ -884,6 +914,49 @@ public:
                    bundy::dns::RRClass rrclass,
                    boost::shared_ptr<DatabaseAccessor> accessor);
 
+    /// \brief Enable or disable the negative lookup filter.
+    ///
+    /// When enabled, the client keeps a \c ZoneNameFilter of the names
+    /// existing in each zone it serves.  Finders then skip the database
+    /// lookups for names the filter says don't exist, so most NXDOMAIN
+    /// results don't involve the database except for a check of the zone's
+    /// SOA serial, which detects changes made by other clients.
+    ///
+    /// The filters are never built on the lookup path.  The filter of a
+    /// zone is built by \c buildNameFilter(), by the updaters of this client
+    /// when they commit, or, for a zone without a usable filter, by a
+    /// separate thread (using a clone of the accessor) that is started
+    /// here; the finders work without the filter until it's ready.  A
+    /// published filter is never modified: a change replaces it with a new
+    /// one, so the finders can keep using their copy without locking.
+    ///
+    /// This requires the accessor to support \c getAllRecords(); if it
+    /// doesn't, the finders simply work without the filter.  It's disabled
+    /// by default, and is normally enabled by the \c name_filter item of
+    /// the data source configuration.  Disabling it releases all the
+    /// filters.
+    ///
+    /// This method itself is not thread safe; it's expected to be called
+    /// at configuration time, before the client is used for lookups.
+    ///
+    /// \throw DataSourceError Failed to clone the accessor.
+    /// \throw bundy::Unexpected Failed to start the builder thread.
+    void setNameFilterEnabled(bool enabled);
+
+    /// \brief Build the negative lookup filter of a zone now.
+    ///
+    /// This builds the filter of the given zone in the calling thread and
+    /// makes it available to the finders, replacing any older one.  It's
+    /// meant for loading the filters of the known zones before the client
+    /// starts to answer queries.
+    ///
+    /// \param zone_name The origin of the zone.
+    /// \return true if the filter has been built; false if the filter is
+    ///     disabled, the zone doesn't exist, or the filter can't be built
+    ///     for it (e.g. because the accessor doesn't support iteration).
+    /// \throw DataSourceError A database error while looking for the zone.
+    bool buildNameFilter(const bundy::dns::Name& zone_name);
+
 
     /// \brief Corresponding ZoneFinder implementation
     ///
@@ -910,8 +983,13 @@ public:
         /// \param origin The name of the origin of this zone. It could query
         ///     it from database, but as the DatabaseClient just searched for
         ///     the zone using the name, it should have it.
+        /// \param name_filters If non NULL, the negative lookup filters of
+        ///     the client, used to skip database lookups for names that
+        ///     don't exist.  See \c DatabaseClient::setNameFilterEnabled().
         Finder(boost::shared_ptr<DatabaseAccessor> database, int zone_id,
-               const bundy::dns::Name& origin);
+               const bundy::dns::Name& origin,
+               DatabaseNameFiltersPtr name_filters =
+               DatabaseNameFiltersPtr());
 
         // The following three methods are just implementations of inherited
         // ZoneFinder's pure virtual methods.
@@ -986,10 +1064,28 @@ public:
             return (*accessor_);
         }
 
+        /// \brief Prepare the finder for another lookup.
+        ///
+        /// \c DatabaseClient uses this to reuse the finders it created
+        /// before (see \c ZoneFinderCache).  It resets the state kept for
+        /// a single lookup and takes the current negative lookup filter.
+        ///
+        /// \param origin The origin the finder is needed for.
+        /// \param name_filters The negative lookup filters of the client.
+        /// \return false if the origin of the finder is not exactly
+        ///     \c origin (with the same case) or the finder was created
+        ///     with other filters, in which case the finder can't be reused
+        ///     and nothing is changed.
+        bool reuse(const bundy::dns::Name& origin,
+                   const DatabaseNameFiltersPtr& name_filters);
+
     private:
         boost::shared_ptr<DatabaseAccessor> accessor_;
         const int zone_id_;
         const bundy::dns::Name origin_;
+        const DatabaseNameFiltersPtr name_filters_;
+        ConstZoneNameFilterPtr name_filter_;
+        bool name_filter_checked_;
 
         /// \brief Shortcut name for the result of getRRsets
         typedef std::pair<bool, std::map<dns::RRType, dns::RRsetPtr> >
@@ -1431,6 +1527,19 @@ public:
         /// \return true if the name has subdomains, false if not.
         bool hasSubdomains(const std::string& name);
 
+        /// \brief Checks if the name is known not to exist in the zone.
+        ///
+        /// This consults the negative lookup filter, if any.  The first
+        /// time the filter reports a non existent name, the SOA serial of
+        /// the zone is compared with the one the filter was built for, and
+        /// if they differ the filter is invalidated and not used any more.
+        ///
+        /// \param name The domain to check.
+        ///
+        /// \return true if neither the name nor any subdomain of it exist,
+        /// false if they may exist.
+        bool isKnownNonexistent(const std::string& name);
+
         /// \brief Convenience type shortcut.
         ///
         /// To find stuff in the result of getRRsets.
@@ -1506,11 +1615,23 @@ public:
                      uint32_t end_serial) const;
 
 private:
+    /// \brief Return a finder for the given zone.
+    ///
+    /// A cached finder is reused if possible, otherwise a new one is created
+    /// (and cached).
+    ZoneFinderPtr getFinder(int zone_id, const bundy::dns::Name& origin) const;
+
     /// \brief The RR class that this client handles.
     const bundy::dns::RRClass rrclass_;
 
     /// \brief The accessor to our database.
     const boost::shared_ptr<DatabaseAccessor> accessor_;
+
+    /// \brief The negative lookup filters; NULL if they are disabled.
+    DatabaseNameFiltersPtr name_filters_;
+
+    /// \brief The finders created by findZone(), keyed by zone ID.
+    mutable ZoneFinderCache finder_cache_;
 };
 
 }
@@ -0,0 +1,1489 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <exceptions/exceptions.h>
+
+#include <dns/name.h>
+
+#include <datasrc/mapped_db_accessor.h>
+#include <datasrc/datasrc_messages.h>
+#include <datasrc/logger.h>
+#include <datasrc/exceptions.h>
+#include <datasrc/database.h>
+#include <util/filename.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace std;
+
+namespace bundy {
+namespace datasrc {
+
+namespace {
+
+// The on-disk format.  All offsets are from the beginning of the file, except
+// those in StrRef, which are from the beginning of the string area.  Every
+// string in the string area is followed by a NUL character, which is not
+// included in its length.  All structures consist of 32-bit fields only, so
+// the tables are naturally aligned.
+
+const char DB_MAGIC[8] = { 'B', 'U', 'N', 'D', 'Y', 'M', 'D', 'B' };
+const uint32_t DB_VERSION = 1;
+
+struct StrRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t zones_offset;      // ZoneEntry[], ordered by name and class
+    uint32_t zone_count;
+    uint32_t zone_ids_offset;   // uint32_t[] indices of zones, ordered by ID
+    uint32_t next_zone_id;
+    uint32_t next_diff_id;
+    uint32_t reserved;
+};
+
+struct ZoneEntry {
+    uint32_t id;
+    StrRef name;
+    StrRef rrclass;
+    uint32_t records_offset;    // RecordEntry[], ordered by rname and type
+    uint32_t record_count;
+    uint32_t names_offset;      // NameEntry[], ordered by name
+    uint32_t name_count;
+    uint32_t nsec_offset;       // uint32_t[] indices of NSEC records
+    uint32_t nsec_count;
+    uint32_t nsec3_offset;      // NSEC3Entry[], ordered by hash and type
+    uint32_t nsec3_count;
+    uint32_t diffs_offset;      // DiffEntry[], ordered by ID
+    uint32_t diff_count;
+};
+
+struct RecordEntry {
+    StrRef name;
+    StrRef rname;
+    StrRef ttl;
+    StrRef type;
+    StrRef sigtype;
+    StrRef rdata;
+};
+
+// All records of a single owner name (they are consecutive in the
+// records table).
+struct NameEntry {
+    StrRef name;
+    uint32_t first;
+    uint32_t count;
+};
+
+struct NSEC3Entry {
+    StrRef hash;
+    StrRef owner;
+    StrRef ttl;
+    StrRef type;
+    StrRef rdata;
+};
+
+struct DiffEntry {
+    uint32_t id;
+    uint32_t version;
+    uint32_t operation;
+    uint32_t reserved;
+    StrRef name;
+    StrRef type;
+    StrRef ttl;
+    StrRef rdata;
+};
+
+// The maximum size of the database file (the offsets are 32-bit)
+const size_t MAX_DB_SIZE = 0xffffffffU;
+
+// Size of the lock file, which holds the generation counter
+const size_t LOCK_FILE_SIZE = sizeof(uint64_t);
+
+inline unsigned char
+lowerChar(char c) {
+    const unsigned char uc = static_cast<unsigned char>(c);
+    return ((uc >= 'A' && uc <= 'Z') ? uc + ('a' - 'A') : uc);
+}
+
+// Case-insensitive (ASCII only, as the NOCASE collation of SQLite3)
+// comparison of two strings
+int
+compareNoCase(const char* a, size_t a_len, const char* b, size_t b_len) {
+    const size_t len = min(a_len, b_len);
+    for (size_t i = 0; i < len; ++i) {
+        const unsigned char ca = lowerChar(a[i]);
+        const unsigned char cb = lowerChar(b[i]);
+        if (ca != cb) {
+            return (ca < cb ? -1 : 1);
+        }
+    }
+    return (a_len == b_len ? 0 : (a_len < b_len ? -1 : 1));
+}
+
+string
+toLower(const string& str) {
+    string result(str);
+    for (string::iterator it = result.begin(); it != result.end(); ++it) {
+        *it = lowerChar(*it);
+    }
+    return (result);
+}
+
+} // end of unnamed namespace
+
+// The staged (in-memory, modifiable) form of the database, used while
+// updating.  Records are keyed by the lowercased reversed name and type,
+// which is the order of the records table in the file; multimap keeps the
+// insertion order of records with the same key.
+struct StagedRecord {
+    string columns[DatabaseAccessor::ADD_COLUMN_COUNT];
+};
+typedef pair<string, string> StagedKey;
+typedef multimap<StagedKey, StagedRecord> StagedRecords;
+
+inline StagedKey
+makeKey(const string& name, const string& type) {
+    return (StagedKey(toLower(name), toLower(type)));
+}
+
+struct StagedNSEC3 {
+    string columns[DatabaseAccessor::ADD_NSEC3_COLUMN_COUNT];
+    string owner;
+};
+typedef multimap<StagedKey, StagedNSEC3> StagedNSEC3s;
+
+struct StagedDiff {
+    uint32_t id;
+    uint32_t version;
+    uint32_t operation;
+    string params[DatabaseAccessor::DIFF_PARAM_COUNT];
+};
+
+struct StagedZone {
+    int id;
+    string name;
+    string rrclass;
+    StagedRecords records;
+    StagedNSEC3s nsec3;
+    vector<StagedDiff> diffs;
+};
+
+struct StagedDB {
+    StagedDB() : next_zone_id(1), next_diff_id(1) {}
+    uint32_t next_zone_id;
+    uint32_t next_diff_id;
+    map<int, StagedZone> zones;
+};
+
+namespace {
+
+// Builds the string area, sharing copies of strings that are likely to
+// repeat (names, TTLs, types).
+class StringPool {
+public:
+    StrRef add(const string& str, bool share) {
+        if (share) {
+            const map<string, uint32_t>::const_iterator found =
+                shared_.find(str);
+            if (found != shared_.end()) {
+                const StrRef ref = { found->second,
+                                     static_cast<uint32_t>(str.size()) };
+                return (ref);
+            }
+        }
+        if (data_.size() + str.size() + 1 > MAX_DB_SIZE) {
+            bundy_throw(DataSourceError, "mapped database too large");
+        }
+        const StrRef ref = { static_cast<uint32_t>(data_.size()),
+                             static_cast<uint32_t>(str.size()) };
+        data_.insert(data_.end(), str.begin(), str.end());
+        data_.push_back('\0');
+        if (share) {
+            shared_.insert(make_pair(str, ref.offset));
+        }
+        return (ref);
+    }
+    const vector<char>& getData() const { return (data_); }
+private:
+    vector<char> data_;
+    map<string, uint32_t> shared_;
+};
+
+template <typename Entry>
+void
+appendEntry(vector<char>& image, const Entry& entry) {
+    const char* const data = reinterpret_cast<const char*>(&entry);
+    image.insert(image.end(), data, data + sizeof(entry));
+}
+
+uint32_t
+currentOffset(const vector<char>& image) {
+    if (image.size() > MAX_DB_SIZE) {
+        bundy_throw(DataSourceError, "mapped database too large");
+    }
+    return (static_cast<uint32_t>(image.size()));
+}
+
+bool
+zoneLess(const StagedZone* a, const StagedZone* b) {
+    const int cmp = compareNoCase(a->name.data(), a->name.size(),
+                                  b->name.data(), b->name.size());
+    if (cmp != 0) {
+        return (cmp < 0);
+    }
+    const int class_cmp = compareNoCase(a->rrclass.data(), a->rrclass.size(),
+                                        b->rrclass.data(), b->rrclass.size());
+    if (class_cmp != 0) {
+        return (class_cmp < 0);
+    }
+    return (a->id < b->id);
+}
+
+typedef pair<string, NameEntry> NameIndexItem;
+
+bool
+nameIndexLess(const NameIndexItem& a, const NameIndexItem& b) {
+    return (a.first < b.first);
+}
+
+class ZoneIdLess {
+public:
+    ZoneIdLess(const vector<ZoneEntry>& zones) : zones_(zones) {}
+    bool operator()(uint32_t a, uint32_t b) const {
+        return (zones_[a].id < zones_[b].id);
+    }
+private:
+    const vector<ZoneEntry>& zones_;
+};
+
+// Write the records, names, NSEC, NSEC3 and diffs tables of the zone.
+void
+serializeZone(const StagedZone& zone, vector<char>& image, StringPool& pool,
+              ZoneEntry& entry)
+{
+    entry.records_offset = currentOffset(image);
+    vector<NameIndexItem> names;
+    vector<uint32_t> nsecs;
+    uint32_t index = 0;
+    const string* prev_rname = NULL;
+    for (StagedRecords::const_iterator it = zone.records.begin();
+         it != zone.records.end(); ++it, ++index) {
+        const string (&columns)[DatabaseAccessor::ADD_COLUMN_COUNT] =
+            it->second.columns;
+        RecordEntry record;
+        record.name = pool.add(columns[DatabaseAccessor::ADD_NAME], true);
+        record.rname = pool.add(columns[DatabaseAccessor::ADD_REV_NAME], true);
+        record.ttl = pool.add(columns[DatabaseAccessor::ADD_TTL], true);
+        record.type = pool.add(columns[DatabaseAccessor::ADD_TYPE], true);
+        record.sigtype = pool.add(columns[DatabaseAccessor::ADD_SIGTYPE],
+                                  true);
+        record.rdata = pool.add(columns[DatabaseAccessor::ADD_RDATA], false);
+        appendEntry(image, record);
+
+        if (prev_rname == NULL || *prev_rname != it->first.first) {
+            const NameEntry name_entry = { record.name, index, 0 };
+            names.push_back(NameIndexItem(
+                toLower(columns[DatabaseAccessor::ADD_NAME]), name_entry));
+            prev_rname = &it->first.first;
+        }
+        ++names.back().second.count;
+        if (it->first.second == "nsec") {
+            nsecs.push_back(index);
+        }
+    }
+    entry.record_count = index;
+
+    sort(names.begin(), names.end(), nameIndexLess);
+    entry.names_offset = currentOffset(image);
+    for (vector<NameIndexItem>::const_iterator it = names.begin();
+         it != names.end(); ++it) {
+        appendEntry(image, it->second);
+    }
+    entry.name_count = names.size();
+
+    entry.nsec_offset = currentOffset(image);
+    for (vector<uint32_t>::const_iterator it = nsecs.begin();
+         it != nsecs.end(); ++it) {
+        appendEntry(image, *it);
+    }
+    entry.nsec_count = nsecs.size();
+
+    entry.nsec3_offset = currentOffset(image);
+    for (StagedNSEC3s::const_iterator it = zone.nsec3.begin();
+         it != zone.nsec3.end(); ++it) {
+        const string (&columns)[DatabaseAccessor::ADD_NSEC3_COLUMN_COUNT] =
+            it->second.columns;
+        NSEC3Entry nsec3;
+        nsec3.hash = pool.add(columns[DatabaseAccessor::ADD_NSEC3_HASH], true);
+        nsec3.owner = pool.add(it->second.owner, true);
+        nsec3.ttl = pool.add(columns[DatabaseAccessor::ADD_NSEC3_TTL], true);
+        nsec3.type = pool.add(columns[DatabaseAccessor::ADD_NSEC3_TYPE], true);
+        nsec3.rdata = pool.add(columns[DatabaseAccessor::ADD_NSEC3_RDATA],
+                               false);
+        appendEntry(image, nsec3);
+    }
+    entry.nsec3_count = zone.nsec3.size();
+
+    entry.diffs_offset = currentOffset(image);
+    for (vector<StagedDiff>::const_iterator it = zone.diffs.begin();
+         it != zone.diffs.end(); ++it) {
+        DiffEntry diff;
+        diff.id = it->id;
+        diff.version = it->version;
+        diff.operation = it->operation;
+        diff.reserved = 0;
+        diff.name = pool.add(it->params[DatabaseAccessor::DIFF_NAME], true);
+        diff.type = pool.add(it->params[DatabaseAccessor::DIFF_TYPE], true);
+        diff.ttl = pool.add(it->params[DatabaseAccessor::DIFF_TTL], true);
+        diff.rdata = pool.add(it->params[DatabaseAccessor::DIFF_RDATA], false);
+        appendEntry(image, diff);
+    }
+    entry.diff_count = zone.diffs.size();
+}
+
+// Convert the staged form of the database to the file image.
+void
+serializeDB(const StagedDB& db, vector<char>& image) {
+    image.assign(sizeof(FileHeader), 0);
+    StringPool pool;
+
+    vector<const StagedZone*> zones;
+    for (map<int, StagedZone>::const_iterator it = db.zones.begin();
+         it != db.zones.end(); ++it) {
+        zones.push_back(&it->second);
+    }
+    sort(zones.begin(), zones.end(), zoneLess);
+
+    vector<ZoneEntry> zone_entries;
+    for (vector<const StagedZone*>::const_iterator it = zones.begin();
+         it != zones.end(); ++it) {
+        ZoneEntry entry;
+        entry.id = (*it)->id;
+        entry.name = pool.add((*it)->name, true);
+        entry.rrclass = pool.add((*it)->rrclass, true);
+        serializeZone(**it, image, pool, entry);
+        zone_entries.push_back(entry);
+    }
+
+    FileHeader header;
+    memcpy(header.magic, DB_MAGIC, sizeof(header.magic));
+    header.version = DB_VERSION;
+    header.zones_offset = currentOffset(image);
+    for (vector<ZoneEntry>::const_iterator it = zone_entries.begin();
+         it != zone_entries.end(); ++it) {
+        appendEntry(image, *it);
+    }
+    header.zone_count = zone_entries.size();
+
+    vector<uint32_t> zone_ids;
+    for (uint32_t i = 0; i < zone_entries.size(); ++i) {
+        zone_ids.push_back(i);
+    }
+    sort(zone_ids.begin(), zone_ids.end(), ZoneIdLess(zone_entries));
+    header.zone_ids_offset = currentOffset(image);
+    for (vector<uint32_t>::const_iterator it = zone_ids.begin();
+         it != zone_ids.end(); ++it) {
+        appendEntry(image, *it);
+    }
+
+    header.strings_offset = currentOffset(image);
+    image.insert(image.end(), pool.getData().begin(), pool.getData().end());
+    // Keep the file size aligned.
+    image.resize((image.size() + 3) & ~static_cast<size_t>(3), '\0');
+    header.strings_size = currentOffset(image) - header.strings_offset;
+    header.file_size = currentOffset(image);
+    header.next_zone_id = db.next_zone_id;
+    header.next_diff_id = db.next_diff_id;
+    header.reserved = 0;
+    memcpy(&image[0], &header, sizeof(header));
+}
+
+// Write a new version of the database file.  It's written to a temporary
+// file first, which is then renamed, so readers always see either the old
+// or the new complete version.
+void
+writeDBFile(const string& filename, const char* data, size_t size) {
+    const string tmpname = filename + ".tmp";
+    const int fd = open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        bundy_throw(DataSourceError, "failed to create " << tmpname << ": "
+                    << strerror(errno));
+    }
+    size_t written = 0;
+    while (written < size) {
+        const ssize_t ret = write(fd, data + written, size - written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            const int error = errno;
+            close(fd);
+            unlink(tmpname.c_str());
+            bundy_throw(DataSourceError, "failed to write " << tmpname <<
+                        ": " << strerror(error));
+        }
+        written += ret;
+    }
+    if (fsync(fd) != 0 || close(fd) != 0) {
+        const int error = errno;
+        unlink(tmpname.c_str());
+        bundy_throw(DataSourceError, "failed to write " << tmpname << ": "
+                    << strerror(error));
+    }
+    if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+        const int error = errno;
+        unlink(tmpname.c_str());
+        bundy_throw(DataSourceError, "failed to rename " << tmpname <<
+                    " to " << filename << ": " << strerror(error));
+    }
+}
+
+} // end of unnamed namespace
+
+/// \brief One immutable version of the database.
+///
+/// The data is either a (read-only) mapping of the database file, or a
+/// buffer with the image of a staged database.  Iterator contexts keep a
+/// shared pointer to it, so the version they iterate stays valid even if the
+/// accessor switches to a newer one.
+class MappedDBSnapshot : boost::noncopyable {
+public:
+    /// \brief Map the file open as fd.
+    MappedDBSnapshot(int fd, const string& filename) :
+        map_(NULL), map_size_(0)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            bundy_throw(DataSourceError, "failed to stat " << filename <<
+                        ": " << strerror(errno));
+        }
+        if (st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+            bundy_throw(DataSourceError, filename <<
+                        " is not a mapped database file");
+        }
+        map_size_ = st.st_size;
+        map_ = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (map_ == MAP_FAILED) {
+            map_ = NULL;
+            bundy_throw(DataSourceError, "failed to map " << filename <<
+                        ": " << strerror(errno));
+        }
+        try {
+            init(static_cast<const char*>(map_), map_size_, filename);
+        } catch (...) {
+            munmap(map_, map_size_);
+            throw;
+        }
+    }
+
+    /// \brief Use the image in the buffer (which is taken over).
+    explicit MappedDBSnapshot(vector<char>& image) :
+        map_(NULL), map_size_(0)
+    {
+        image_.swap(image);
+        init(&image_[0], image_.size(), "staged database");
+    }
+
+    ~MappedDBSnapshot() {
+        if (map_ != NULL) {
+            munmap(map_, map_size_);
+        }
+    }
+
+    const char* getData() const { return (base_); }
+    size_t getSize() const { return (size_); }
+
+    /// \brief Find the zone of the given name and class.
+    const ZoneEntry* findZone(const string& name, const string& rrclass) const
+    {
+        const ZoneEntry* const zones =
+            getTable<ZoneEntry>(header_->zones_offset, header_->zone_count);
+        const ZoneEntry* const zones_end = zones + header_->zone_count;
+        for (const ZoneEntry* zone =
+                 lowerBound(zones, zones_end, &ZoneEntry::name, name);
+             zone != zones_end && compare(zone->name, name) == 0; ++zone) {
+            if (compare(zone->rrclass, rrclass) == 0) {
+                return (zone);
+            }
+        }
+        return (NULL);
+    }
+
+    /// \brief Find the zone of the given ID.
+    const ZoneEntry* getZone(int id) const {
+        const ZoneEntry* const zones =
+            getTable<ZoneEntry>(header_->zones_offset, header_->zone_count);
+        const uint32_t* const ids =
+            getTable<uint32_t>(header_->zone_ids_offset, header_->zone_count);
+        size_t first = 0;
+        size_t count = header_->zone_count;
+        while (count > 0) {
+            const size_t step = count / 2;
+            const ZoneEntry& zone = getZoneAt(zones, ids[first + step]);
+            if (static_cast<int>(zone.id) < id) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        if (first < header_->zone_count) {
+            const ZoneEntry& zone = getZoneAt(zones, ids[first]);
+            if (static_cast<int>(zone.id) == id) {
+                return (&zone);
+            }
+        }
+        return (NULL);
+    }
+
+    /// \brief Get a table of count entries of type T at the given offset.
+    template <typename T>
+    const T* getTable(uint32_t offset, uint32_t count) const {
+        if (offset > header_->strings_offset ||
+            count > (header_->strings_offset - offset) / sizeof(T)) {
+            corrupted();
+        }
+        return (reinterpret_cast<const T*>(base_ + offset));
+    }
+
+    /// \brief Get the address of the string (which is NUL terminated).
+    const char* getString(const StrRef& ref) const {
+        if (ref.offset > header_->strings_size ||
+            ref.length >= header_->strings_size - ref.offset) {
+            corrupted();
+        }
+        return (strings_ + ref.offset);
+    }
+
+    void copyString(const StrRef& ref, string& str) const {
+        str.assign(getString(ref), ref.length);
+    }
+
+    int compare(const StrRef& ref, const string& str) const {
+        return (compareNoCase(getString(ref), ref.length, str.data(),
+                              str.size()));
+    }
+
+    /// \brief Find the first entry in [first, last) whose field is not
+    /// less than (case-insensitively) the given string.
+    template <typename Entry>
+    const Entry* lowerBound(const Entry* first, const Entry* last,
+                            StrRef Entry::* field, const string& str) const
+    {
+        size_t count = last - first;
+        while (count > 0) {
+            const size_t step = count / 2;
+            const Entry* const middle = first + step;
+            if (compare((*middle).*field, str) < 0) {
+                first = middle + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return (first);
+    }
+
+    /// \brief Load the whole database into the staged form.
+    void load(StagedDB& db) const {
+        db.next_zone_id = header_->next_zone_id;
+        db.next_diff_id = header_->next_diff_id;
+        const ZoneEntry* const zones =
+            getTable<ZoneEntry>(header_->zones_offset, header_->zone_count);
+        for (uint32_t i = 0; i < header_->zone_count; ++i) {
+            const ZoneEntry& entry = zones[i];
+            StagedZone& zone = db.zones[entry.id];
+            zone.id = entry.id;
+            copyString(entry.name, zone.name);
+            copyString(entry.rrclass, zone.rrclass);
+
+            const RecordEntry* const records =
+                getTable<RecordEntry>(entry.records_offset,
+                                      entry.record_count);
+            for (uint32_t j = 0; j < entry.record_count; ++j) {
+                StagedRecord record;
+                copyString(records[j].name,
+                           record.columns[DatabaseAccessor::ADD_NAME]);
+                copyString(records[j].rname,
+                           record.columns[DatabaseAccessor::ADD_REV_NAME]);
+                copyString(records[j].ttl,
+                           record.columns[DatabaseAccessor::ADD_TTL]);
+                copyString(records[j].type,
+                           record.columns[DatabaseAccessor::ADD_TYPE]);
+                copyString(records[j].sigtype,
+                           record.columns[DatabaseAccessor::ADD_SIGTYPE]);
+                copyString(records[j].rdata,
+                           record.columns[DatabaseAccessor::ADD_RDATA]);
+                // The records are stored in the key order, so they can be
+                // appended.
+                const string (&columns)[DatabaseAccessor::ADD_COLUMN_COUNT] =
+                    record.columns;
+                zone.records.insert(
+                    zone.records.end(),
+                    make_pair(makeKey(columns[DatabaseAccessor::ADD_REV_NAME],
+                                      columns[DatabaseAccessor::ADD_TYPE]),
+                              record));
+            }
+
+            const NSEC3Entry* const nsec3s =
+                getTable<NSEC3Entry>(entry.nsec3_offset, entry.nsec3_count);
+            for (uint32_t j = 0; j < entry.nsec3_count; ++j) {
+                StagedNSEC3 nsec3;
+                copyString(nsec3s[j].hash,
+                           nsec3.columns[DatabaseAccessor::ADD_NSEC3_HASH]);
+                copyString(nsec3s[j].ttl,
+                           nsec3.columns[DatabaseAccessor::ADD_NSEC3_TTL]);
+                copyString(nsec3s[j].type,
+                           nsec3.columns[DatabaseAccessor::ADD_NSEC3_TYPE]);
+                copyString(nsec3s[j].rdata,
+                           nsec3.columns[DatabaseAccessor::ADD_NSEC3_RDATA]);
+                copyString(nsec3s[j].owner, nsec3.owner);
+                const string (&columns)
+                    [DatabaseAccessor::ADD_NSEC3_COLUMN_COUNT] = nsec3.columns;
+                const StagedKey key(
+                    makeKey(columns[DatabaseAccessor::ADD_NSEC3_HASH],
+                            columns[DatabaseAccessor::ADD_NSEC3_TYPE]));
+                zone.nsec3.insert(zone.nsec3.end(), make_pair(key, nsec3));
+            }
+
+            const DiffEntry* const diffs =
+                getTable<DiffEntry>(entry.diffs_offset, entry.diff_count);
+            zone.diffs.resize(entry.diff_count);
+            for (uint32_t j = 0; j < entry.diff_count; ++j) {
+                StagedDiff& diff = zone.diffs[j];
+                diff.id = diffs[j].id;
+                diff.version = diffs[j].version;
+                diff.operation = diffs[j].operation;
+                copyString(diffs[j].name,
+                           diff.params[DatabaseAccessor::DIFF_NAME]);
+                copyString(diffs[j].type,
+                           diff.params[DatabaseAccessor::DIFF_TYPE]);
+                copyString(diffs[j].ttl,
+                           diff.params[DatabaseAccessor::DIFF_TTL]);
+                copyString(diffs[j].rdata,
+                           diff.params[DatabaseAccessor::DIFF_RDATA]);
+            }
+        }
+    }
+
+    void corrupted() const {
+        bundy_throw(DataSourceError, "corrupted mapped database");
+    }
+
+private:
+    void init(const char* base, size_t size, const string& filename) {
+        base_ = base;
+        size_ = size;
+        header_ = reinterpret_cast<const FileHeader*>(base);
+        if (size < sizeof(FileHeader) ||
+            memcmp(header_->magic, DB_MAGIC, sizeof(DB_MAGIC)) != 0) {
+            bundy_throw(DataSourceError, filename <<
+                        " is not a mapped database file");
+        }
+        if (header_->version != DB_VERSION) {
+            bundy_throw(DataSourceError, filename <<
+                        " has unsupported mapped database version " <<
+                        header_->version);
+        }
+        if (header_->file_size != size ||
+            header_->strings_offset < sizeof(FileHeader) ||
+            header_->strings_offset > size ||
+            header_->strings_size != size - header_->strings_offset) {
+            bundy_throw(DataSourceError, filename <<
+                        " is a corrupted mapped database file");
+        }
+        strings_ = base + header_->strings_offset;
+    }
+
+    const ZoneEntry& getZoneAt(const ZoneEntry* zones, uint32_t index) const {
+        if (index >= header_->zone_count) {
+            corrupted();
+        }
+        return (zones[index]);
+    }
+
+    void* map_;
+    size_t map_size_;
+    vector<char> image_;
+    const char* base_;
+    size_t size_;
+    const FileHeader* header_;
+    const char* strings_;
+};
+
+typedef boost::shared_ptr<const MappedDBSnapshot> MappedDBSnapshotPtr;
+
+/// \brief Private state of MappedDBAccessor
+struct MappedDBState : boost::noncopyable {
+    MappedDBState() :
+        lock_fd(-1), lock_map(NULL), generation(NULL), mapped_generation(0),
+        in_transaction(false), locked(false), transaction_generation(0),
+        updating_zone(false),
+        updated_zone_id(-1)
+    {}
+
+    ~MappedDBState() {
+        if (lock_map != NULL) {
+            munmap(lock_map, LOCK_FILE_SIZE);
+        }
+        if (lock_fd >= 0) {
+            // This also releases the lock, if held.
+            close(lock_fd);
+        }
+    }
+
+    // The lock file and the generation counter mapped from it
+    int lock_fd;
+    void* lock_map;
+    volatile uint32_t* generation;
+
+    // The newest version we know, and its generation
+    MappedDBSnapshotPtr snapshot;
+    uint32_t mapped_generation;
+
+    // The state of the transaction (if any).  The transaction reads from
+    // the version that was newest when it started until it modifies the
+    // database; then the whole database is loaded into the staged form,
+    // and reads are done from an image built from that.
+    bool in_transaction;
+    bool locked;
+    MappedDBSnapshotPtr transaction_snapshot;
+    uint32_t transaction_generation;
+    boost::scoped_ptr<StagedDB> staged;
+    MappedDBSnapshotPtr staged_snapshot;
+
+    bool updating_zone;
+    int updated_zone_id;
+    string updated_zone_origin;
+};
+
+namespace {
+
+// The context for getRecords(), getNSEC3Records() and getAllRecords().
+class MappedDBContext : public DatabaseAccessor::IteratorContext {
+public:
+    /// \brief Iterate over records.
+    ///
+    /// If prefix is not empty, only the records whose reversed name starts
+    /// with it are returned.  If with_names is true, the NAME_COLUMN is
+    /// set, and the NSEC3 records in [nsec3, nsec3_end) follow.
+    MappedDBContext(const MappedDBSnapshotPtr& snapshot,
+                    const RecordEntry* records, const RecordEntry* records_end,
+                    const string& prefix, bool with_names,
+                    const NSEC3Entry* nsec3, const NSEC3Entry* nsec3_end) :
+        snapshot_(snapshot), record_(records), records_end_(records_end),
+        prefix_(prefix), with_names_(with_names),
+        nsec3_(nsec3), nsec3_end_(nsec3_end)
+    {}
+
+    /// \brief Iterate over NSEC3 records of a single hash.
+    MappedDBContext(const MappedDBSnapshotPtr& snapshot,
+                    const NSEC3Entry* nsec3, const NSEC3Entry* nsec3_end) :
+        snapshot_(snapshot), record_(NULL), records_end_(NULL),
+        with_names_(false), nsec3_(nsec3), nsec3_end_(nsec3_end)
+    {}
+
+    virtual bool getNext(string (&data)[DatabaseAccessor::COLUMN_COUNT]) {
+        if (record_ != records_end_) {
+            if (!prefix_.empty() &&
+                (record_->rname.length < prefix_.size() ||
+                 compareNoCase(snapshot_->getString(record_->rname),
+                               prefix_.size(), prefix_.data(),
+                               prefix_.size()) != 0)) {
+                record_ = records_end_ = NULL;
+                return (false);
+            }
+            snapshot_->copyString(record_->type,
+                                  data[DatabaseAccessor::TYPE_COLUMN]);
+            snapshot_->copyString(record_->ttl,
+                                  data[DatabaseAccessor::TTL_COLUMN]);
+            snapshot_->copyString(record_->sigtype,
+                                  data[DatabaseAccessor::SIGTYPE_COLUMN]);
+            snapshot_->copyString(record_->rdata,
+                                  data[DatabaseAccessor::RDATA_COLUMN]);
+            if (with_names_) {
+                snapshot_->copyString(record_->name,
+                                      data[DatabaseAccessor::NAME_COLUMN]);
+            }
+            ++record_;
+            return (true);
+        }
+        if (nsec3_ != nsec3_end_) {
+            snapshot_->copyString(nsec3_->type,
+                                  data[DatabaseAccessor::TYPE_COLUMN]);
+            snapshot_->copyString(nsec3_->ttl,
+                                  data[DatabaseAccessor::TTL_COLUMN]);
+            snapshot_->copyString(nsec3_->rdata,
+                                  data[DatabaseAccessor::RDATA_COLUMN]);
+            if (with_names_) {
+                // As the RRSIGs are for NSEC3s, the sigtype is fixed.
+                data[DatabaseAccessor::SIGTYPE_COLUMN] = "NSEC3";
+                snapshot_->copyString(nsec3_->owner,
+                                      data[DatabaseAccessor::NAME_COLUMN]);
+            }
+            ++nsec3_;
+            return (true);
+        }
+        return (false);
+    }
+
+private:
+    const MappedDBSnapshotPtr snapshot_;
+    const RecordEntry* record_;
+    const RecordEntry* records_end_;
+    const string prefix_;
+    const bool with_names_;
+    const NSEC3Entry* nsec3_;
+    const NSEC3Entry* const nsec3_end_;
+};
+
+// The context for getDiffs()
+class MappedDBDiffContext : public DatabaseAccessor::IteratorContext {
+public:
+    MappedDBDiffContext(const MappedDBSnapshotPtr& snapshot,
+                        const DiffEntry* diff, const DiffEntry* diffs_end) :
+        snapshot_(snapshot), diff_(diff), diffs_end_(diffs_end)
+    {}
+
+    virtual bool getNext(string (&data)[DatabaseAccessor::COLUMN_COUNT]) {
+        if (diff_ == diffs_end_) {
+            return (false);
+        }
+        snapshot_->copyString(diff_->type,
+                              data[DatabaseAccessor::TYPE_COLUMN]);
+        snapshot_->copyString(diff_->ttl, data[DatabaseAccessor::TTL_COLUMN]);
+        snapshot_->copyString(diff_->name,
+                              data[DatabaseAccessor::NAME_COLUMN]);
+        snapshot_->copyString(diff_->rdata,
+                              data[DatabaseAccessor::RDATA_COLUMN]);
+        ++diff_;
+        return (true);
+    }
+
+private:
+    const MappedDBSnapshotPtr snapshot_;
+    const DiffEntry* diff_;
+    const DiffEntry* const diffs_end_;
+};
+
+DatabaseAccessor::IteratorContextPtr
+emptyContext(const MappedDBSnapshotPtr& snapshot) {
+    return (DatabaseAccessor::IteratorContextPtr(
+                new MappedDBContext(snapshot, NULL, NULL)));
+}
+
+} // end of unnamed namespace
+
+MappedDBAccessor::MappedDBAccessor(const string& filename,
+                                   const string& rrclass) :
+    state_(new MappedDBState),
+    filename_(filename),
+    class_(rrclass),
+    database_name_("mapped_db_" +
+                   bundy::util::Filename(filename).nameAndExtension())
+{
+    const string lockname = filename_ + ".lock";
+    state_->lock_fd = open(lockname.c_str(), O_RDWR | O_CREAT, 0644);
+    if (state_->lock_fd < 0) {
+        bundy_throw(DataSourceError, "failed to open " << lockname << ": " <<
+                    strerror(errno));
+    }
+    struct stat st;
+    if (fstat(state_->lock_fd, &st) != 0 ||
+        (st.st_size < static_cast<off_t>(LOCK_FILE_SIZE) &&
+         ftruncate(state_->lock_fd, LOCK_FILE_SIZE) != 0)) {
+        bundy_throw(DataSourceError, "failed to set up " << lockname << ": "
+                    << strerror(errno));
+    }
+    void* const lock_map = mmap(NULL, LOCK_FILE_SIZE, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, state_->lock_fd, 0);
+    if (lock_map == MAP_FAILED) {
+        bundy_throw(DataSourceError, "failed to map " << lockname << ": " <<
+                    strerror(errno));
+    }
+    state_->lock_map = lock_map;
+    state_->generation = static_cast<volatile uint32_t*>(lock_map);
+
+    // Create an empty database if there's none yet.  Lock it so concurrent
+    // accessors don't overwrite each other's (or a committed) database.
+    if (access(filename_.c_str(), F_OK) != 0) {
+        if (flock(state_->lock_fd, LOCK_EX) != 0) {
+            bundy_throw(DataSourceError, "failed to lock " << lockname <<
+                        ": " << strerror(errno));
+        }
+        try {
+            if (access(filename_.c_str(), F_OK) != 0) {
+                vector<char> image;
+                serializeDB(StagedDB(), image);
+                writeDBFile(filename_, &image[0], image.size());
+            }
+        } catch (...) {
+            flock(state_->lock_fd, LOCK_UN);
+            throw;
+        }
+        flock(state_->lock_fd, LOCK_UN);
+    }
+    remap();
+}
+
+MappedDBAccessor::~MappedDBAccessor() {
+}
+
+boost::shared_ptr<DatabaseAccessor>
+MappedDBAccessor::clone() {
+    return (boost::shared_ptr<DatabaseAccessor>(
+                new MappedDBAccessor(filename_, class_)));
+}
+
+void
+MappedDBAccessor::remap() const {
+    // Read the generation before opening the file; if another commit
+    // happens in between, we'll just map again next time.
+    const uint32_t generation = *state_->generation;
+    const int fd = open(filename_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        bundy_throw(DataSourceError, "failed to open " << filename_ << ": "
+                    << strerror(errno));
+    }
+    try {
+        state_->snapshot.reset(new MappedDBSnapshot(fd, filename_));
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    // The mapping stays valid after closing the file.
+    close(fd);
+    state_->mapped_generation = generation;
+    LOG_DEBUG(logger, DBG_TRACE_BASIC, DATASRC_MAPPED_DB_REMAP).
+        arg(filename_).arg(generation);
+}
+
+MappedDBSnapshotPtr
+MappedDBAccessor::getSnapshot() const {
+    if (state_->in_transaction) {
+        if (!state_->staged) {
+            return (state_->transaction_snapshot);
+        }
+        if (!state_->staged_snapshot) {
+            vector<char> image;
+            serializeDB(*state_->staged, image);
+            state_->staged_snapshot.reset(new MappedDBSnapshot(image));
+        }
+        return (state_->staged_snapshot);
+    }
+    if (*state_->generation != state_->mapped_generation) {
+        remap();
+    }
+    return (state_->snapshot);
+}
+
+pair<bool, int>
+MappedDBAccessor::getZone(const string& name) const {
+    const ZoneEntry* const zone = getSnapshot()->findZone(name, class_);
+    if (zone == NULL) {
+        return (pair<bool, int>(false, 0));
+    }
+    return (pair<bool, int>(true, zone->id));
+}
+
+DatabaseAccessor::IteratorContextPtr
+MappedDBAccessor::getRecords(const string& name, int id,
+                             bool subdomains) const
+{
+    const MappedDBSnapshotPtr snapshot(getSnapshot());
+    const ZoneEntry* const zone = snapshot->getZone(id);
+    if (zone == NULL) {
+        return (emptyContext(snapshot));
+    }
+    const RecordEntry* const records =
+        snapshot->getTable<RecordEntry>(zone->records_offset,
+                                        zone->record_count);
+    const RecordEntry* const records_end = records + zone->record_count;
+
+    if (subdomains) {
+        // The records are ordered by the reversed name, so the subdomains
+        // (as in the SQLite3 version, including the name itself) are
+        // consecutive records starting with the reversed name.
+        const string prefix(bundy::dns::Name(name).reverse().toText());
+        const RecordEntry* const first =
+            snapshot->lowerBound(records, records_end, &RecordEntry::rname,
+                                 prefix);
+        return (IteratorContextPtr(
+                    new MappedDBContext(snapshot, first, records_end, prefix,
+                                        false, NULL, NULL)));
+    }
+
+    const NameEntry* const names =
+        snapshot->getTable<NameEntry>(zone->names_offset, zone->name_count);
+    const NameEntry* const names_end = names + zone->name_count;
+    const NameEntry* const found =
+        snapshot->lowerBound(names, names_end, &NameEntry::name, name);
+    if (found == names_end || snapshot->compare(found->name, name) != 0) {
+        return (emptyContext(snapshot));
+    }
+    if (found->first > zone->record_count ||
+        found->count > zone->record_count - found->first) {
+        snapshot->corrupted();
+    }
+    return (IteratorContextPtr(
+                new MappedDBContext(snapshot, records + found->first,
+                                    records + found->first + found->count,
+                                    string(), false, NULL, NULL)));
+}
+
+DatabaseAccessor::IteratorContextPtr
+MappedDBAccessor::getNSEC3Records(const string& hash, int id) const {
+    const MappedDBSnapshotPtr snapshot(getSnapshot());
+    const ZoneEntry* const zone = snapshot->getZone(id);
+    if (zone == NULL) {
+        return (emptyContext(snapshot));
+    }
+    const NSEC3Entry* const nsec3s =
+        snapshot->getTable<NSEC3Entry>(zone->nsec3_offset, zone->nsec3_count);
+    const NSEC3Entry* const nsec3s_end = nsec3s + zone->nsec3_count;
+    const NSEC3Entry* const first =
+        snapshot->lowerBound(nsec3s, nsec3s_end, &NSEC3Entry::hash, hash);
+    const NSEC3Entry* last = first;
+    while (last != nsec3s_end && snapshot->compare(last->hash, hash) == 0) {
+        ++last;
+    }
+    return (IteratorContextPtr(new MappedDBContext(snapshot, first, last)));
+}
+
+DatabaseAccessor::IteratorContextPtr
+MappedDBAccessor::getAllRecords(int id) const {
+    const MappedDBSnapshotPtr snapshot(getSnapshot());
+    const ZoneEntry* const zone = snapshot->getZone(id);
+    if (zone == NULL) {
+        return (emptyContext(snapshot));
+    }
+    const RecordEntry* const records =
+        snapshot->getTable<RecordEntry>(zone->records_offset,
+                                        zone->record_count);
+    const NSEC3Entry* const nsec3s =
+        snapshot->getTable<NSEC3Entry>(zone->nsec3_offset, zone->nsec3_count);
+    return (IteratorContextPtr(
+                new MappedDBContext(snapshot, records,
+                                    records + zone->record_count, string(),
+                                    true, nsec3s,
+                                    nsec3s + zone->nsec3_count)));
+}
+
+DatabaseAccessor::IteratorContextPtr
+MappedDBAccessor::getDiffs(int id, uint32_t start, uint32_t end) const {
+    const MappedDBSnapshotPtr snapshot(getSnapshot());
+    const ZoneEntry* const zone = snapshot->getZone(id);
+    const DiffEntry* diffs = NULL;
+    uint32_t diff_count = 0;
+    if (zone != NULL) {
+        diffs = snapshot->getTable<DiffEntry>(zone->diffs_offset,
+                                              zone->diff_count);
+        diff_count = zone->diff_count;
+    }
+
+    // The sequence starts with the first deletion of the start version and
+    // ends with the last addition of the end version.
+    const DiffEntry* first = NULL;
+    for (uint32_t i = 0; i < diff_count; ++i) {
+        if (diffs[i].version == start && diffs[i].operation == DIFF_DELETE) {
+            first = diffs + i;
+            break;
+        }
+    }
+    if (first == NULL) {
+        bundy_throw(NoSuchSerial, "No entry in differences table for" <<
+                  " zone ID " << id << ", serial number " << start);
+    }
+    const DiffEntry* last = NULL;
+    for (uint32_t i = diff_count; i > 0; --i) {
+        const DiffEntry& diff = diffs[i - 1];
+        if (diff.version == end && diff.operation == DIFF_ADD) {
+            last = diffs + i;
+            break;
+        }
+    }
+    if (last == NULL) {
+        bundy_throw(NoSuchSerial, "No entry in differences table for" <<
+                  " zone ID " << id << ", serial number " << end);
+    }
+    if (last < first) {
+        last = first;
+    }
+    return (IteratorContextPtr(new MappedDBDiffContext(snapshot, first,
+                                                       last)));
+}
+
+void
+MappedDBAccessor::beginUpdate(const char* what) {
+    if (state_->in_transaction) {
+        bundy_throw(DataSourceError, "duplicate " << what <<
+                    " on mapped data source " << getDBName());
+    }
+    if (*state_->generation != state_->mapped_generation) {
+        remap();
+    }
+    state_->transaction_snapshot = state_->snapshot;
+    state_->transaction_generation = state_->mapped_generation;
+    state_->in_transaction = true;
+}
+
+void
+MappedDBAccessor::endUpdate() {
+    if (state_->locked) {
+        flock(state_->lock_fd, LOCK_UN);
+        state_->locked = false;
+    }
+    state_->staged_snapshot.reset();
+    state_->staged.reset();
+    state_->transaction_snapshot.reset();
+    state_->in_transaction = false;
+    state_->updating_zone = false;
+    state_->updated_zone_id = -1;
+    state_->updated_zone_origin.clear();
+}
+
+namespace {
+
+// Take the update lock.  Like a busy SQLite3 database, we fail rather than
+// wait if somebody else holds it.
+void
+lockForUpdate(MappedDBState& state, const string& dbname) {
+    if (!state.locked) {
+        if (flock(state.lock_fd, LOCK_EX | LOCK_NB) != 0) {
+            bundy_throw(DataSourceError, "mapped data source " << dbname <<
+                        " is locked for update by another accessor");
+        }
+        state.locked = true;
+    }
+}
+
+// Take the update lock of a transaction that is going to modify the
+// database, and load the data the transaction started with.
+void
+prepareWrite(MappedDBState& state, const string& dbname) {
+    if (state.staged) {
+        // Anything that was modified needs the image built again.
+        state.staged_snapshot.reset();
+        return;
+    }
+    lockForUpdate(state, dbname);
+    if (*state.generation != state.transaction_generation) {
+        // As the transaction must see the data it started with, we can't
+        // continue.
+        bundy_throw(DataSourceError, "mapped data source " << dbname <<
+                    " was modified during the transaction");
+    }
+    boost::scoped_ptr<StagedDB> staged(new StagedDB);
+    state.transaction_snapshot->load(*staged);
+    state.staged.swap(staged);
+}
+
+StagedZone&
+getStagedZone(MappedDBState& state, const string& dbname) {
+    const map<int, StagedZone>::iterator found =
+        state.staged->zones.find(state.updated_zone_id);
+    if (found == state.staged->zones.end()) {
+        bundy_throw(DataSourceError, "zone updated on mapped data source " <<
+                    dbname << " was deleted");
+    }
+    return (found->second);
+}
+
+}
+
+pair<bool, int>
+MappedDBAccessor::startUpdateZone(const string& zone_name,
+                                  const bool replace)
+{
+    if (state_->updating_zone) {
+        bundy_throw(DataSourceError,
+                  "duplicate zone update on mapped data source");
+    }
+    if (state_->in_transaction) {
+        bundy_throw(DataSourceError,
+                  "zone update attempt in another mapped DB transaction");
+    }
+
+    const pair<bool, int> zone_info(getZone(zone_name));
+    if (!zone_info.first) {
+        return (zone_info);
+    }
+
+    try {
+        // Lock first, so the update starts from the newest version.
+        lockForUpdate(*state_, getDBName());
+        beginUpdate("zone update");
+        prepareWrite(*state_, getDBName());
+        state_->updating_zone = true;
+        state_->updated_zone_id = zone_info.second;
+        state_->updated_zone_origin = zone_name;
+        StagedZone& zone = getStagedZone(*state_, getDBName());
+        if (replace) {
+            zone.records.clear();
+            zone.nsec3.clear();
+        }
+    } catch (...) {
+        endUpdate();
+        throw;
+    }
+
+    return (zone_info);
+}
+
+void
+MappedDBAccessor::startTransaction() {
+    beginUpdate("transaction");
+}
+
+void
+MappedDBAccessor::commit() {
+    if (!state_->in_transaction) {
+        bundy_throw(DataSourceError, "performing commit on mapped "
+                  "data source without transaction");
+    }
+    if (state_->staged) {
+        // Reuse the image if it was built for reading.
+        if (!state_->staged_snapshot) {
+            vector<char> image;
+            serializeDB(*state_->staged, image);
+            state_->staged_snapshot.reset(new MappedDBSnapshot(image));
+        }
+        writeDBFile(filename_, state_->staged_snapshot->getData(),
+                    state_->staged_snapshot->getSize());
+        const uint32_t generation =
+            __sync_add_and_fetch(state_->generation, 1);
+        LOG_DEBUG(logger, DBG_TRACE_BASIC, DATASRC_MAPPED_DB_COMMIT).
+            arg(filename_).arg(generation).
+            arg(state_->staged_snapshot->getSize());
+    }
+    endUpdate();
+}
+
+void
+MappedDBAccessor::rollback() {
+    if (!state_->in_transaction) {
+        bundy_throw(DataSourceError, "performing rollback on mapped "
+                  "data source without transaction");
+    }
+    endUpdate();
+}
+
+int
+MappedDBAccessor::addZone(const string& name) {
+    if (!state_->in_transaction) {
+        bundy_throw(DataSourceError, "performing addZone on mapped "
+                  "data source without transaction");
+    }
+    prepareWrite(*state_, getDBName());
+    const int id = state_->staged->next_zone_id++;
+    StagedZone& zone = state_->staged->zones[id];
+    zone.id = id;
+    zone.name = name;
+    zone.rrclass = class_;
+    return (id);
+}
+
+void
+MappedDBAccessor::deleteZone(int zone_id) {
+    if (!state_->in_transaction) {
+        bundy_throw(InvalidOperation, "performing deleteZone on mapped "
+                  "data source without transaction");
+    }
+    prepareWrite(*state_, getDBName());
+    state_->staged->zones.erase(zone_id);
+}
+
+void
+MappedDBAccessor::checkUpdating(const char* what) const {
+    if (!state_->updating_zone) {
+        bundy_throw(DataSourceError, what << " on mapped data source " <<
+                    getDBName() << " without zone update");
+    }
+}
+
+void
+MappedDBAccessor::addRecordToZone(const string (&columns)[ADD_COLUMN_COUNT]) {
+    checkUpdating("adding record");
+    prepareWrite(*state_, getDBName());
+    StagedRecord record;
+    copy(columns, columns + ADD_COLUMN_COUNT, record.columns);
+    getStagedZone(*state_, getDBName()).records.insert(
+        make_pair(makeKey(columns[ADD_REV_NAME], columns[ADD_TYPE]), record));
+}
+
+void
+MappedDBAccessor::addNSEC3RecordToZone(
+    const string (&columns)[ADD_NSEC3_COLUMN_COUNT])
+{
+    checkUpdating("adding NSEC3-related record");
+    prepareWrite(*state_, getDBName());
+    StagedNSEC3 nsec3;
+    copy(columns, columns + ADD_NSEC3_COLUMN_COUNT, nsec3.columns);
+    // The owner name is needed for getAllRecords().
+    nsec3.owner = columns[ADD_NSEC3_HASH] + "." +
+        state_->updated_zone_origin;
+    getStagedZone(*state_, getDBName()).nsec3.insert(
+        make_pair(makeKey(columns[ADD_NSEC3_HASH], columns[ADD_NSEC3_TYPE]),
+                  nsec3));
+}
+
+void
+MappedDBAccessor::deleteRecordInZone(const string (&params)[DEL_PARAM_COUNT]) {
+    checkUpdating("deleting record");
+    prepareWrite(*state_, getDBName());
+    StagedRecords& records = getStagedZone(*state_, getDBName()).records;
+    const pair<StagedRecords::iterator, StagedRecords::iterator> range =
+        records.equal_range(makeKey(params[DEL_RNAME], params[DEL_TYPE]));
+    for (StagedRecords::iterator it = range.first; it != range.second;) {
+        if (it->second.columns[ADD_RDATA] == params[DEL_RDATA]) {
+            records.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void
+MappedDBAccessor::deleteNSEC3RecordInZone(
+    const string (&params)[DEL_NSEC3_PARAM_COUNT])
+{
+    checkUpdating("deleting NSEC3-related record");
+    prepareWrite(*state_, getDBName());
+    StagedNSEC3s& nsec3s = getStagedZone(*state_, getDBName()).nsec3;
+    const pair<StagedNSEC3s::iterator, StagedNSEC3s::iterator> range =
+        nsec3s.equal_range(makeKey(params[DEL_NSEC3_HASH],
+                                   params[DEL_NSEC3_TYPE]));
+    for (StagedNSEC3s::iterator it = range.first; it != range.second;) {
+        if (it->second.columns[ADD_NSEC3_RDATA] == params[DEL_NSEC3_RDATA]) {
+            nsec3s.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void
+MappedDBAccessor::addRecordDiff(int zone_id, uint32_t serial,
+                                DiffOperation operation,
+                                const string (&params)[DIFF_PARAM_COUNT])
+{
+    if (!state_->updating_zone) {
+        bundy_throw(DataSourceError, "adding record diff without update "
+                  "transaction on " << getDBName());
+    }
+    if (zone_id != state_->updated_zone_id) {
+        bundy_throw(DataSourceError, "bad zone ID for adding record diff on "
+                  << getDBName() << ": " << zone_id << ", must be "
+                  << state_->updated_zone_id);
+    }
+    prepareWrite(*state_, getDBName());
+    StagedZone& zone = getStagedZone(*state_, getDBName());
+    zone.diffs.push_back(StagedDiff());
+    StagedDiff& diff = zone.diffs.back();
+    diff.id = state_->staged->next_diff_id++;
+    diff.version = serial;
+    diff.operation = operation;
+    copy(params, params + DIFF_PARAM_COUNT, diff.params);
+}
+
+string
+MappedDBAccessor::findPreviousName(int zone_id, const string& rname) const {
+    const MappedDBSnapshotPtr snapshot(getSnapshot());
+    const ZoneEntry* const zone = snapshot->getZone(zone_id);
+    if (zone != NULL) {
+        const RecordEntry* const records =
+            snapshot->getTable<RecordEntry>(zone->records_offset,
+                                            zone->record_count);
+        const uint32_t* const nsecs =
+            snapshot->getTable<uint32_t>(zone->nsec_offset, zone->nsec_count);
+        // Find the last NSEC record whose rname is less than the given one.
+        size_t first = 0;
+        size_t count = zone->nsec_count;
+        while (count > 0) {
+            const size_t step = count / 2;
+            const uint32_t index = nsecs[first + step];
+            if (index >= zone->record_count) {
+                snapshot->corrupted();
+            }
+            if (snapshot->compare(records[index].rname, rname) < 0) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        if (first > 0) {
+            string result;
+            snapshot->copyString(records[nsecs[first - 1]].name, result);
+            return (result);
+        }
+    }
+    // No NSEC records here, this DB doesn't support DNSSEC or
+    // we asked before the apex
+    bundy_throw(bundy::NotImplemented, "The zone doesn't support DNSSEC or "
+              "query before apex");
+}
+
+string
+MappedDBAccessor::findPreviousNSEC3Hash(int zone_id, const string& hash) const
+{
+    const MappedDBSnapshotPtr snapshot(getSnapshot());
+    const ZoneEntry* const zone = snapshot->getZone(zone_id);
+    if (zone == NULL || zone->nsec3_count == 0) {
+        // No NSEC3 at all in the zone. Well, bad luck, but you should not
+        // have asked in the first place.
+        bundy_throw(DataSourceError, "No NSEC3 in this zone");
+    }
+    const NSEC3Entry* const nsec3s =
+        snapshot->getTable<NSEC3Entry>(zone->nsec3_offset, zone->nsec3_count);
+    const NSEC3Entry* const nsec3s_end = nsec3s + zone->nsec3_count;
+    const NSEC3Entry* found =
+        snapshot->lowerBound(nsec3s, nsec3s_end, &NSEC3Entry::hash, hash);
+    if (found == nsec3s) {
+        // No NSEC3 records before this hash. This means we should wrap
+        // around and take the last one.
+        found = nsec3s_end;
+    }
+    string result;
+    snapshot->copyString((found - 1)->hash, result);
+    return (result);
+}
+
+} // end of namespace datasrc
+} // end of namespace bundy
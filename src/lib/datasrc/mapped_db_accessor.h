@@ -0,0 +1,225 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef DATASRC_MAPPED_DB_ACCESSOR_H
+#define DATASRC_MAPPED_DB_ACCESSOR_H
+
+#include <datasrc/database.h>
+#include <datasrc/exceptions.h>
+
+#include <cc/data.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <utility>
+
+namespace bundy {
+namespace datasrc {
+
+struct MappedDBState;
+class MappedDBSnapshot;
+
+/// \brief DatabaseAccessor on a memory mapped, read-mostly database file
+///
+/// This accessor serves the data from a single file that is mapped into
+/// memory with \c mmap().  The file holds immutable, sorted tables of the
+/// zones, records, NSEC3 records and differences of all zones, and lookups
+/// are binary searches directly on the mapped tables; unlike the SQLite3
+/// accessor there is no query to compile, no page cache to copy through and
+/// no lock to take on the read path.  The textual columns are copied only
+/// when an iterator context returns them through \c getNext(), as that
+/// interface requires \c std::string.
+///
+/// The database file is never modified in place.  An update (a zone update
+/// or a transaction) takes an exclusive lock on the "<file>.lock" file,
+/// stages the changes in memory, and \c commit() writes a complete new
+/// version of the database to a temporary file and renames it over the old
+/// one.  Readers (in this or in other processes) that still use the old
+/// version keep it mapped until they notice the new one, so readers never
+/// block writers and vice versa.  The lock file also contains a generation
+/// counter the writer increments on each commit, which lets readers detect
+/// a new version with a single memory load.
+///
+/// As \c commit() rewrites the whole file, its cost is proportional to the
+/// size of the database, not to the size of the change.  Likewise, reading
+/// a zone through the accessor while it's being updated rebuilds the
+/// in-memory tables if they were modified since the previous read.  So this
+/// accessor is suitable for data that is read much more often than it is
+/// changed; the SQLite3 accessor is a better choice for zones with frequent
+/// dynamic updates.
+///
+/// The file uses the native byte order and 32-bit offsets, so it's not
+/// portable between architectures and it's limited to 4GB.
+class MappedDBAccessor : public DatabaseAccessor {
+public:
+    /// \brief Constructor
+    ///
+    /// This opens (and maps) the database file.  If the file doesn't exist,
+    /// an empty database is created.
+    ///
+    /// \exception DataSourceError The file or its lock file can't be opened
+    /// or created, or the file is not a valid database.
+    ///
+    /// \param filename The database file to be used.
+    /// \param rrclass Textual representation of RR class ("IN", "CH", etc),
+    ///    specifying which class of data it should serve.
+    MappedDBAccessor(const std::string& filename, const std::string& rrclass);
+
+    /// \brief Destructor
+    ///
+    /// Unmaps the database, and releases the update lock if it's held
+    /// (discarding any uncommitted changes).
+    virtual ~MappedDBAccessor();
+
+    /// This implementation opens the same file with a new accessor.
+    virtual boost::shared_ptr<DatabaseAccessor> clone();
+
+    virtual std::pair<bool, int> getZone(const std::string& name) const;
+
+    /// \brief Add a zone
+    ///
+    /// As the SQLite3 version, this requires a transaction and doesn't
+    /// check whether the zone already exists.
+    ///
+    /// \exception DataSourceError if no transaction is active.
+    virtual int addZone(const std::string& name);
+
+    /// \brief Delete a zone
+    ///
+    /// This removes the zone together with all its records and differences.
+    ///
+    /// \exception InvalidOperation if no transaction is active.
+    virtual void deleteZone(int zone_id);
+
+    virtual IteratorContextPtr getRecords(const std::string& name,
+                                          int id,
+                                          bool subdomains = false) const;
+
+    virtual IteratorContextPtr getNSEC3Records(const std::string& hash,
+                                               int id) const;
+
+    virtual IteratorContextPtr getAllRecords(int id) const;
+
+    /// \exception NoSuchSerial if either of the versions do not exist in
+    ///           the differences of the zone.
+    virtual IteratorContextPtr
+    getDiffs(int id, uint32_t start, uint32_t end) const;
+
+    /// \exception DataSourceError if another update is in progress on this
+    ///           accessor, or the update lock is held by another accessor
+    ///           (in this or another process).
+    virtual std::pair<bool, int> startUpdateZone(const std::string& zone_name,
+                                                 bool replace);
+
+    /// \exception DataSourceError if another update is in progress on this
+    ///           accessor, or the update lock is held by another accessor.
+    virtual void startTransaction();
+
+    /// \brief Commit the changes.
+    ///
+    /// This writes the new version of the database to "<file>.tmp",
+    /// synchronizes it to the disk and renames it to the database file.
+    ///
+    /// \exception DataSourceError if no transaction is active, or writing
+    ///           the new version fails (in which case the transaction is
+    ///           still active and can be rolled back).
+    virtual void commit();
+
+    virtual void rollback();
+
+    virtual void addRecordToZone(
+        const std::string (&columns)[ADD_COLUMN_COUNT]);
+
+    virtual void addNSEC3RecordToZone(
+        const std::string (&columns)[ADD_NSEC3_COLUMN_COUNT]);
+
+    virtual void deleteRecordInZone(
+        const std::string (&params)[DEL_PARAM_COUNT]);
+
+    virtual void deleteNSEC3RecordInZone(
+        const std::string (&params)[DEL_NSEC3_PARAM_COUNT]);
+
+    virtual void addRecordDiff(
+        int zone_id, uint32_t serial, DiffOperation operation,
+        const std::string (&params)[DIFF_PARAM_COUNT]);
+
+    /// This implementation returns a string starting with "mapped_db_"
+    /// followed by the DB file name removing any path name.
+    virtual const std::string& getDBName() const { return (database_name_); }
+
+    virtual std::string findPreviousName(int zone_id, const std::string& rname)
+        const;
+
+    virtual std::string findPreviousNSEC3Hash(int zone_id,
+                                              const std::string& hash) const;
+
+private:
+    /// \brief Returns the version of the database to read from.
+    ///
+    /// This is the staged version while updating, and otherwise the newest
+    /// committed version (which is mapped first if it's changed).
+    boost::shared_ptr<const MappedDBSnapshot> getSnapshot() const;
+
+    /// \brief Throws DataSourceError if no zone update is in progress.
+    void checkUpdating(const char* what) const;
+
+    /// \brief Maps the newest version of the database file.
+    void remap() const;
+
+    /// \brief Locks the database for update and stages its data.
+    void beginUpdate(const char* what);
+
+    /// \brief Releases the update lock and drops the staged data.
+    void endUpdate();
+
+    /// \brief Private state (mapping, lock file, staged changes)
+    boost::scoped_ptr<MappedDBState> state_;
+    /// \brief The filename of the DB (necessary for clone())
+    const std::string filename_;
+    /// \brief The class for which the queries are done
+    const std::string class_;
+    /// \brief Database name
+    const std::string database_name_;
+};
+
+/// \brief Creates an instance of the mapped database datasource client
+///
+/// The configuration passed here must be a MapElement, containing one item
+/// called "database_file", whose value is a string.  It may also contain a
+/// boolean "name_filter" item; if it's true, the negative lookup filter of
+/// the client is enabled (see \c DatabaseClient::setNameFilterEnabled()).
+///
+/// \param datasrc_name A name of the underlying data source.
+/// \param config The configuration for the datasource instance
+/// \param error This string will be set to an error message if an error occurs
+///              during initialization
+/// \return An instance of the mapped database datasource client, or NULL if
+///         there was an error
+extern "C" DataSourceClient* createInstance(const std::string& datasrc_name,
+                                            bundy::data::ConstElementPtr config,
+                                            std::string& error);
+
+/// \brief Destroy the instance created by createInstance()
+extern "C" void destroyInstance(DataSourceClient* instance);
+
+}
+}
+
+#endif  // DATASRC_MAPPED_DB_ACCESSOR_H
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,188 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <dns/name.h>
+#include <dns/rrclass.h>
+
+#include <datasrc/zone_finder_cache.h>
+#include <datasrc/memory/memory_client.h>
+#include <datasrc/memory/zone_data.h>
+#include <datasrc/memory/zone_finder.h>
+#include <datasrc/memory/zone_table.h>
+#include <datasrc/memory/zone_table_segment.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+using std::vector;
+using namespace bundy::bench;
+using namespace bundy::datasrc;
+using namespace bundy::datasrc::memory;
+using namespace bundy::dns;
+
+namespace {
+// Look up the zone for each of the query names through the client, which
+// reuses the finders it cached.
+class FindZoneBenchMark {
+public:
+    FindZoneBenchMark(const InMemoryClient& client,
+                      const vector<Name>& qnames) :
+        client_(client), qnames_(qnames)
+    {}
+    unsigned int run() {
+        vector<Name>::const_iterator it;
+        const vector<Name>::const_iterator it_end = qnames_.end();
+        for (it = qnames_.begin(); it != it_end; ++it) {
+            const DataSourceClient::FindResult result = client_.findZone(*it);
+            assert(result.zone_finder);
+        }
+        return (qnames_.size());
+    }
+private:
+    const InMemoryClient& client_;
+    const vector<Name>& qnames_;
+};
+
+// Acquire a finder for each of the given zones, from the cache if possible
+// (what the client does), or by creating a new one each time (what the
+// client did before the finders were cached).
+class FinderBenchMark {
+public:
+    FinderBenchMark(ZoneFinderCache* cache,
+                    const vector<const ZoneData*>& zones) :
+        cache_(cache), zones_(zones)
+    {}
+    unsigned int run() {
+        vector<const ZoneData*>::const_iterator it;
+        const vector<const ZoneData*>::const_iterator it_end = zones_.end();
+        for (it = zones_.begin(); it != it_end; ++it) {
+            ZoneFinderPtr finder;
+            if (cache_ != NULL) {
+                finder = cache_->find(*it, 0);
+            }
+            if (!finder) {
+                finder = boost::make_shared<InMemoryZoneFinder>(
+                    **it, RRClass::IN());
+                if (cache_ != NULL) {
+                    cache_->add(*it, 0, finder);
+                }
+            }
+            assert(finder);
+        }
+        return (zones_.size());
+    }
+private:
+    ZoneFinderCache* const cache_;
+    const vector<const ZoneData*>& zones_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: finder_bench [-n iterations] [-z zones]"
+              << std::endl;
+    exit (1);
+}
+
+// The names of the zones; they only have the origin node, so they are
+// about as small as a zone can be.
+Name
+zoneName(size_t i) {
+    return (Name("zone" + boost::lexical_cast<std::string>(i) + ".example"));
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1000;
+    size_t zone_count = 10000;
+    while ((ch = getopt(argc, argv, "n:z:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'z':
+            zone_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || zone_count == 0) {
+        usage();
+    }
+
+    boost::shared_ptr<ZoneTableSegment> segment(
+        ZoneTableSegment::create(RRClass::IN(), "local"),
+        ZoneTableSegment::destroy);
+    ZoneTable* table = segment->getHeader().getTable();
+    for (size_t i = 0; i < zone_count; ++i) {
+        const Name origin(zoneName(i));
+        ZoneData* zone_data =
+            ZoneData::create(segment->getMemorySegment(), origin);
+        table->addZone(segment->getMemorySegment(), origin, zone_data);
+    }
+    const InMemoryClient client("bench", segment, RRClass::IN());
+
+    // Queries hitting few zones (all fit in the cache), and queries spread
+    // over all the zones.  Both lists have the same length.
+    const size_t hot_count = ZoneFinderCache::DEFAULT_CAPACITY / 2;
+    vector<Name> hot_qnames, all_qnames;
+    vector<const ZoneData*> hot_zones, all_zones;
+    for (size_t i = 0; i < zone_count; ++i) {
+        hot_qnames.push_back(Name("www").concatenate(zoneName(i % hot_count)));
+        all_qnames.push_back(Name("www").concatenate(zoneName(i)));
+        hot_zones.push_back(table->findZone(hot_qnames.back()).zone_data);
+        all_zones.push_back(table->findZone(all_qnames.back()).zone_data);
+    }
+
+    ZoneFinderCache cache;
+    std::cout << "Benchmark for acquiring cached finders ("
+              << hot_count << " zones)" << std::endl;
+    BenchMark<FinderBenchMark>(iteration, FinderBenchMark(&cache, hot_zones));
+
+    std::cout << "Benchmark for creating finders ("
+              << hot_count << " zones)" << std::endl;
+    BenchMark<FinderBenchMark>(iteration, FinderBenchMark(NULL, hot_zones));
+
+    std::cout << "Benchmark for acquiring cached finders ("
+              << zone_count << " zones)" << std::endl;
+    BenchMark<FinderBenchMark>(iteration, FinderBenchMark(&cache, all_zones));
+
+    std::cout << "Benchmark for creating finders ("
+              << zone_count << " zones)" << std::endl;
+    BenchMark<FinderBenchMark>(iteration, FinderBenchMark(NULL, all_zones));
+
+    std::cout << "Benchmark for findZone() ("
+              << hot_count << " zones)" << std::endl;
+    BenchMark<FindZoneBenchMark>(iteration,
+                                 FindZoneBenchMark(client, hot_qnames));
+
+    std::cout << "Benchmark for findZone() ("
+              << zone_count << " zones)" << std::endl;
+    BenchMark<FindZoneBenchMark>(iteration,
+                                 FindZoneBenchMark(client, all_qnames));
+
+    return (0);
+}
@@ -30,6 +30,8 @@
 #include <dns/rdataclass.h>
 #include <dns/rrclass.h>
 
+#include <boost/make_shared.hpp>
+
 #include <utility>
 
 using namespace bundy::dns;
@@ -72,7 +74,14 @@ InMemoryClient::findZone(const bundy::dns::Name& zone_name) const {
 
     ZoneFinderPtr finder;
     if (result.code != result::NOTFOUND && result.zone_data) {
-        finder.reset(new InMemoryZoneFinder(*result.zone_data, getClass()));
+        // The finder only refers to the zone data, so one created for the
+        // same zone data (at the same address) can always be reused.
+        finder = finder_cache_.find(result.zone_data, rrclass_.getCode());
+        if (!finder) {
+            finder = boost::make_shared<InMemoryZoneFinder>(*result.zone_data,
+                                                            rrclass_);
+            finder_cache_.add(result.zone_data, rrclass_.getCode(), finder);
+        }
     }
 
     return (DataSourceClient::FindResult(result.code, finder,
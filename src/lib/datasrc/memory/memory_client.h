@@ -19,6 +19,7 @@
 
 #include <datasrc/zone_iterator.h>
 #include <datasrc/client.h>
+#include <datasrc/zone_finder_cache.h>
 #include <datasrc/memory/zone_table.h>
 #include <datasrc/memory/zone_data.h>
 
@@ -81,7 +82,12 @@ public:
 
     /// Returns a \c ZoneFinder result that best matches the given name.
     ///
-    /// This derived version of the method never throws an exception.
+    /// The finders are cached per thread (see \c ZoneFinderCache), so
+    /// repeated lookups for the same zone from a thread return the same
+    /// finder object as long as the zone isn't reloaded.
+    ///
+    /// This derived version of the method doesn't throw an exception
+    /// except \c std::bad_alloc.
     /// For other details see \c DataSourceClient::findZone().
     virtual bundy::datasrc::DataSourceClient::FindResult
     findZone(const bundy::dns::Name& name) const;
@@ -118,6 +124,8 @@ public:
 private:
     boost::shared_ptr<ZoneTableSegment> ztable_segment_;
     const bundy::dns::RRClass rrclass_;
+    // The finders created by findZone(), keyed by the zone data
+    mutable ZoneFinderCache finder_cache_;
 };
 
 } // namespace memory
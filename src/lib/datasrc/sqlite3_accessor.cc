@@ -81,7 +81,9 @@ enum StatementID {
     DEL_NSEC3_RECORD = 21,
     ADD_ZONE = 22,
     DELETE_ZONE = 23,
-    NUM_STATEMENTS = 24
+    COUNT_RECORDS = 24,
+    TABLE_INDEXES = 25,
+    NUM_STATEMENTS = 26
 };
 
 const char* const text_statements[NUM_STATEMENTS] = {
@@ -171,13 +173,34 @@ const char* const text_statements[NUM_STATEMENTS] = {
     // ADD_ZONE: add a zone to the zones table
     "INSERT INTO zones (name, rdclass) VALUES (?1, ?2)", // ADD_ZONE
     // DELETE_ZONE: delete a zone from the zones table
-    "DELETE FROM zones WHERE id=?1" // DELETE_ZONE
+    "DELETE FROM zones WHERE id=?1", // DELETE_ZONE
+
+    // COUNT_RECORDS: count the rows of the records and nsec3 tables, up to
+    // the given limit per table (so it won't take long for a large DB)
+    "SELECT (SELECT COUNT(*) FROM (SELECT 1 FROM records LIMIT ?1)) + "
+        "(SELECT COUNT(*) FROM (SELECT 1 FROM nsec3 LIMIT ?1))",
+    // TABLE_INDEXES: explicitly created indexes on the records and nsec3
+    // tables, along with the SQL to recreate them
+    "SELECT name, sql FROM sqlite_master WHERE type = 'index' AND "
+        "tbl_name IN ('records', 'nsec3') AND sql IS NOT NULL"
 };
 
+// The number of rows inserted by a single statement in the bulk load mode.
+// Each row takes 7 parameters, and the total must be kept below the
+// default limit of SQLite3 (999).
+const size_t BULK_INSERT_ROWS = 128;
+
+// In the bulk load mode we drop the indexes of the records and nsec3 tables
+// and recreate them at the end.  As that means indexing the entire tables,
+// not only the loaded zone, we do so only if the tables (after clearing the
+// zone) contain fewer rows than this.
+const int BULK_INDEX_DROP_THRESHOLD = 100000;
+
 struct SQLite3Parameters {
     SQLite3Parameters() :
         db_(NULL), major_version_(-1), minor_version_(-1),
-        in_transaction(false), updating_zone(false), updated_zone_id(-1)
+        in_transaction(false), updating_zone(false), updated_zone_id(-1),
+        bulk_loading(false), bulk_add_statement_(NULL)
     {
         for (int i = 0; i < NUM_STATEMENTS; ++i) {
             statements_[i] = NULL;
@@ -204,6 +227,29 @@ struct SQLite3Parameters {
         return (statements_[id]);
     }
 
+    // This is similar to getStatement(), but returns the statement inserting
+    // BULK_INSERT_ROWS rows to the records table at once.
+    sqlite3_stmt*
+    getBulkAddStatement() {
+        if (bulk_add_statement_ == NULL) {
+            assert(db_ != NULL);
+            string sql("INSERT INTO records "
+                       "(zone_id, name, rname, ttl, rdtype, sigtype, rdata) "
+                       "VALUES (?, ?, ?, ?, ?, ?, ?)");
+            for (size_t i = 1; i < BULK_INSERT_ROWS; ++i) {
+                sql += ", (?, ?, ?, ?, ?, ?, ?)";
+            }
+            sqlite3_stmt* prepared = NULL;
+            if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &prepared, NULL) !=
+                SQLITE_OK) {
+                bundy_throw(SQLite3Error, "Could not prepare SQLite statement "
+                            "for bulk insertion: " << sqlite3_errmsg(db_));
+            }
+            bulk_add_statement_ = prepared;
+        }
+        return (bulk_add_statement_);
+    }
+
     void
     finalizeStatements() {
         for (int i = 0; i < NUM_STATEMENTS; ++i) {
@@ -212,6 +258,18 @@ struct SQLite3Parameters {
                 statements_[i] = NULL;
             }
         }
+        if (bulk_add_statement_ != NULL) {
+            sqlite3_finalize(bulk_add_statement_);
+            bulk_add_statement_ = NULL;
+        }
+    }
+
+    // Forget about the bulk load; used when the transaction is over.
+    void
+    clearBulkLoad() {
+        bulk_loading = false;
+        bulk_records.clear();
+        dropped_indexes.clear();
     }
 
     sqlite3* db_;
@@ -221,10 +279,17 @@ struct SQLite3Parameters {
     bool updating_zone;          // whether or not updating the zone
     int updated_zone_id;        // valid only when in_transaction is true
     string updated_zone_origin_; // ditto, and only needed to handle NSEC3s
+    bool bulk_loading;          // whether in the bulk load mode
+    // Columns of the records to be added in the bulk load mode, flattened
+    // (ADD_COLUMN_COUNT elements per record)
+    vector<string> bulk_records;
+    // SQL to recreate the indexes dropped for the bulk load
+    vector<string> dropped_indexes;
 private:
     // statements_ are private and must be accessed via getStatement() outside
     // of this structure.
     sqlite3_stmt* statements_[NUM_STATEMENTS];
+    sqlite3_stmt* bulk_add_statement_;
 };
 
 // This is a helper class to encapsulate the code logic of executing
@@ -251,6 +316,14 @@ public:
         sqlite3_clear_bindings(stmt_);
     }
 
+    // Same as the above, but for a statement not in the statement table.
+    StatementProcessor(SQLite3Parameters& dbparameters, sqlite3_stmt* stmt,
+                       const char* desc) :
+        dbparameters_(dbparameters), stmt_(stmt), desc_(desc)
+    {
+        sqlite3_clear_bindings(stmt_);
+    }
+
     ~StatementProcessor() {
         sqlite3_reset(stmt_);
     }
@@ -296,6 +369,74 @@ private:
     const char* const desc_;
 };
 
+namespace {
+// Bind the zone ID and the columns of the given buffered record (see
+// SQLite3Parameters::bulk_records) to the statement.  The columns are bound
+// without copying, so they must be kept intact until the statement is
+// executed.
+void
+bindBulkRecord(StatementProcessor& proc, int& param_id,
+               const SQLite3Parameters& dbparams, size_t record)
+{
+    proc.bindInt(++param_id, dbparams.updated_zone_id);
+    for (size_t i = 0; i < DatabaseAccessor::ADD_COLUMN_COUNT; ++i) {
+        const string& column =
+            dbparams.bulk_records[record * DatabaseAccessor::ADD_COLUMN_COUNT +
+                                  i];
+        // See doUpdate() below about empty columns.
+        proc.bindText(++param_id, column.empty() ? NULL : column.c_str(),
+                      SQLITE_STATIC);
+    }
+}
+
+// Insert the records buffered in the bulk load mode.  Full batches are
+// inserted by the multi-row statement, the rest one by one.
+void
+flushBulkRecords(SQLite3Parameters& dbparams) {
+    const size_t count =
+        dbparams.bulk_records.size() / DatabaseAccessor::ADD_COLUMN_COUNT;
+    size_t record = 0;
+    for (; record + BULK_INSERT_ROWS <= count; record += BULK_INSERT_ROWS) {
+        StatementProcessor proc(dbparams, dbparams.getBulkAddStatement(),
+                                "add records to zone");
+        int param_id = 0;
+        for (size_t i = 0; i < BULK_INSERT_ROWS; ++i) {
+            bindBulkRecord(proc, param_id, dbparams, record + i);
+        }
+        proc.exec();
+    }
+    for (; record < count; ++record) {
+        StatementProcessor proc(dbparams, ADD_RECORD, "add record to zone");
+        int param_id = 0;
+        bindBulkRecord(proc, param_id, dbparams, record);
+        proc.exec();
+    }
+    dbparams.bulk_records.clear();
+}
+
+// End the bulk load mode (if it's active): insert the remaining buffered
+// records and recreate the dropped indexes.
+void
+finishBulkLoad(SQLite3Parameters& dbparams, const string& db_name) {
+    if (!dbparams.bulk_loading) {
+        return;
+    }
+    flushBulkRecords(dbparams);
+    const size_t index_count = dbparams.dropped_indexes.size();
+    while (!dbparams.dropped_indexes.empty()) {
+        if (sqlite3_exec(dbparams.db_, dbparams.dropped_indexes.back().c_str(),
+                         NULL, NULL, NULL) != SQLITE_OK) {
+            bundy_throw(DataSourceError, "failed to recreate index after "
+                        "bulk load: " << sqlite3_errmsg(dbparams.db_));
+        }
+        dbparams.dropped_indexes.pop_back();
+    }
+    dbparams.bulk_loading = false;
+    LOG_DEBUG(logger, DBG_TRACE_BASIC, DATASRC_SQLITE_BULK_LOAD_END).
+        arg(db_name).arg(index_count);
+}
+}
+
 SQLite3Accessor::SQLite3Accessor(const std::string& filename,
                                  const string& rrclass) :
     dbparameters_(new SQLite3Parameters),
@@ -870,6 +1011,7 @@ DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getRecords(const std::string& name, int id,
                             bool subdomains) const
 {
+    finishBulkLoad(*dbparameters_, database_name_);
     return (IteratorContextPtr(new Context(shared_from_this(), id, name,
                                            subdomains ?
                                            Context::QT_SUBDOMAINS :
@@ -878,12 +1020,14 @@ SQLite3Accessor::getRecords(const std::string& name, int id,
 
 DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getNSEC3Records(const std::string& hash, int id) const {
+    finishBulkLoad(*dbparameters_, database_name_);
     return (IteratorContextPtr(new Context(shared_from_this(), id, hash,
                                            Context::QT_NSEC3)));
 }
 
 DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getAllRecords(int id) const {
+    finishBulkLoad(*dbparameters_, database_name_);
     return (IteratorContextPtr(new Context(shared_from_this(), id)));
 }
 
@@ -1194,6 +1338,71 @@ SQLite3Accessor::startUpdateZone(const string& zone_name, const bool replace) {
     return (zone_info);
 }
 
+void
+SQLite3Accessor::startBulkLoad() {
+    if (!dbparameters_->updating_zone) {
+        bundy_throw(DataSourceError, "bulk load on SQLite3 data source "
+                    "without zone update");
+    }
+    if (dbparameters_->bulk_loading) {
+        return;
+    }
+
+    // See if the tables are small enough to make it worth dropping the
+    // indexes.
+    int row_count;
+    {
+        sqlite3_stmt* const stmt = dbparameters_->getStatement(COUNT_RECORDS);
+        StatementProcessor proc(*dbparameters_, COUNT_RECORDS,
+                                "count records");
+        proc.bindInt(1, BULK_INDEX_DROP_THRESHOLD);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            bundy_throw(DataSourceError, "failed to count records: " <<
+                        sqlite3_errmsg(dbparameters_->db_));
+        }
+        row_count = sqlite3_column_int(stmt, 0);
+    }
+
+    if (row_count < BULK_INDEX_DROP_THRESHOLD) {
+        vector<pair<string, string> > indexes;
+        {
+            sqlite3_stmt* const stmt =
+                dbparameters_->getStatement(TABLE_INDEXES);
+            StatementProcessor proc(*dbparameters_, TABLE_INDEXES,
+                                    "list indexes");
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                indexes.push_back(
+                    make_pair(convertToPlainChar(sqlite3_column_text(stmt, 0),
+                                                 dbparameters_->db_),
+                              convertToPlainChar(sqlite3_column_text(stmt, 1),
+                                                 dbparameters_->db_)));
+            }
+            if (rc != SQLITE_DONE) {
+                bundy_throw(DataSourceError, "failed to list indexes: " <<
+                            sqlite3_errmsg(dbparameters_->db_));
+            }
+        }
+        for (vector<pair<string, string> >::const_iterator it =
+                 indexes.begin(); it != indexes.end(); ++it) {
+            const string sql("DROP INDEX \"" + it->first + "\"");
+            if (sqlite3_exec(dbparameters_->db_, sql.c_str(), NULL, NULL,
+                             NULL) != SQLITE_OK) {
+                bundy_throw(DataSourceError, "failed to drop index " <<
+                            it->first << ": " <<
+                            sqlite3_errmsg(dbparameters_->db_));
+            }
+            // Remember how to recreate it even if dropping a later one
+            // fails, so we can still continue the update in that case.
+            dbparameters_->dropped_indexes.push_back(it->second);
+        }
+    }
+
+    dbparameters_->bulk_loading = true;
+    LOG_DEBUG(logger, DBG_TRACE_BASIC, DATASRC_SQLITE_BULK_LOAD_START).
+        arg(database_name_).arg(dbparameters_->dropped_indexes.size());
+}
+
 void
 SQLite3Accessor::startTransaction() {
     if (dbparameters_->in_transaction) {
@@ -1212,6 +1421,7 @@ SQLite3Accessor::commit() {
         bundy_throw(DataSourceError, "performing commit on SQLite3 "
                   "data source without transaction");
     }
+    finishBulkLoad(*dbparameters_, database_name_);
 
     StatementProcessor(*dbparameters_, COMMIT,
                        "commit an SQLite3 transaction").exec();
@@ -1230,6 +1440,8 @@ SQLite3Accessor::rollback() {
 
     StatementProcessor(*dbparameters_, ROLLBACK,
                        "rollback an SQLite3 transaction").exec();
+    // The rollback also reverts dropping the indexes (if any).
+    dbparameters_->clearBulkLoad();
     dbparameters_->in_transaction = false;
     dbparameters_->updating_zone = false;
     dbparameters_->updated_zone_id = -1;
@@ -1265,6 +1477,16 @@ SQLite3Accessor::addRecordToZone(const string (&columns)[ADD_COLUMN_COUNT]) {
         bundy_throw(DataSourceError, "adding record to SQLite3 "
                   "data source without transaction");
     }
+    if (dbparameters_->bulk_loading) {
+        dbparameters_->bulk_records.insert(dbparameters_->bulk_records.end(),
+                                           columns,
+                                           columns + ADD_COLUMN_COUNT);
+        if (dbparameters_->bulk_records.size() ==
+            BULK_INSERT_ROWS * ADD_COLUMN_COUNT) {
+            flushBulkRecords(*dbparameters_);
+        }
+        return;
+    }
     doUpdate<const string (&)[ADD_COLUMN_COUNT]>(
         *dbparameters_, ADD_RECORD, columns, "add record to zone");
 }
@@ -1299,6 +1521,7 @@ SQLite3Accessor::deleteRecordInZone(const string (&params)[DEL_PARAM_COUNT]) {
         bundy_throw(DataSourceError, "deleting record in SQLite3 "
                   "data source without transaction");
     }
+    finishBulkLoad(*dbparameters_, database_name_);
     // We don't pass all the parameters to the query, one name (reserve one
     // in this case) is sufficient. Pass only the needed ones.
     const size_t SQLITE3_DEL_PARAM_COUNT = DEL_PARAM_COUNT - 1;
@@ -1319,6 +1542,7 @@ SQLite3Accessor::deleteNSEC3RecordInZone(
         bundy_throw(DataSourceError, "deleting NSEC3-related record in SQLite3 "
                   "data source without transaction");
     }
+    finishBulkLoad(*dbparameters_, database_name_);
     doUpdate<const string (&)[DEL_NSEC3_PARAM_COUNT]>(
         *dbparameters_, DEL_NSEC3_RECORD, params,
         "delete NSEC3 record from zone");
@@ -1355,6 +1579,7 @@ std::string
 SQLite3Accessor::findPreviousName(int zone_id, const std::string& rname)
     const
 {
+    finishBulkLoad(*dbparameters_, database_name_);
     sqlite3_stmt* const stmt = dbparameters_->getStatement(FIND_PREVIOUS);
     sqlite3_reset(stmt);
     sqlite3_clear_bindings(stmt);
@@ -1399,6 +1624,7 @@ std::string
 SQLite3Accessor::findPreviousNSEC3Hash(int zone_id, const std::string& hash)
     const
 {
+    finishBulkLoad(*dbparameters_, database_name_);
     sqlite3_stmt* const stmt = dbparameters_->getStatement(NSEC3_PREVIOUS);
     sqlite3_reset(stmt);
     sqlite3_clear_bindings(stmt);
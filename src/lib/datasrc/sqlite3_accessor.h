@@ -200,6 +200,24 @@ public:
     virtual std::pair<bool, int> startUpdateZone(const std::string& zone_name,
                                                  bool replace);
 
+    /// \brief Start the bulk load mode.
+    ///
+    /// In this mode records added by \c addRecordToZone() are buffered and
+    /// inserted by a single multi-row INSERT statement per batch.  In
+    /// addition, if the records and nsec3 tables don't contain much data
+    /// other than the zone being loaded, their indexes are dropped and
+    /// recreated at the end of the load.  Since all of this happens within
+    /// the update transaction, \c rollback() restores the original state
+    /// including the indexes.
+    ///
+    /// The bulk load mode ends (the buffered records are inserted and the
+    /// indexes recreated) at \c commit(), or when this accessor is used to
+    /// read or delete records in the meantime.
+    ///
+    /// \exception DataSourceError Called without starting a zone update,
+    /// or some internal database related error.
+    virtual void startBulkLoad();
+
     virtual void startTransaction();
 
     /// \note we are quite impatient here: it's quite possible that the COMMIT
@@ -281,7 +299,10 @@ private:
 /// \brief Creates an instance of the SQlite3 datasource client
 ///
 /// Currently the configuration passed here must be a MapElement, containing
-/// one item called "database_file", whose value is a string
+/// one item called "database_file", whose value is a string.  It may also
+/// contain a boolean "name_filter" item; if it's true, the negative lookup
+/// filter of the client is enabled (see
+/// \c DatabaseClient::setNameFilterEnabled()).
 ///
 /// This configuration setup is currently under discussion and will change in
 /// the near future.
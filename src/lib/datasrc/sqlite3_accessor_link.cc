@@ -21,6 +21,7 @@
 
 #include <log/message_initializer.h>
 
+#include <memory>
 #include <string>
 
 using namespace std;
@@ -33,6 +34,7 @@ namespace datasrc {
 namespace {
 
 const char* const CONFIG_ITEM_DATABASE_FILE = "database_file";
+const char* const CONFIG_ITEM_NAME_FILTER = "name_filter";
 
 void
 addError(ElementPtr errors, const std::string& error) {
@@ -70,6 +72,14 @@ checkConfig(ConstElementPtr config, ElementPtr errors) {
                      " in SQLite3 backend is empty");
             result = false;
         }
+        if (config->contains(CONFIG_ITEM_NAME_FILTER) &&
+            (!config->get(CONFIG_ITEM_NAME_FILTER) ||
+             config->get(CONFIG_ITEM_NAME_FILTER)->getType() !=
+             Element::boolean)) {
+            addError(errors, "value of " + string(CONFIG_ITEM_NAME_FILTER) +
+                     " in SQLite3 backend is not a boolean");
+            result = false;
+        }
     }
 
     return (result);
@@ -91,11 +101,16 @@ createInstance(const std::string& datasrc_name,
     }
     const std::string dbfile =
         config->get(CONFIG_ITEM_DATABASE_FILE)->stringValue();
+    const bool name_filter = config->contains(CONFIG_ITEM_NAME_FILTER) &&
+        config->get(CONFIG_ITEM_NAME_FILTER)->boolValue();
     try {
         boost::shared_ptr<DatabaseAccessor> sqlite3_accessor(
             new SQLite3Accessor(dbfile, "IN")); // XXX: avoid hardcode RR class
-        return (new DatabaseClient(datasrc_name, bundy::dns::RRClass::IN(),
-                                   sqlite3_accessor));
+        std::auto_ptr<DatabaseClient> client(
+            new DatabaseClient(datasrc_name, bundy::dns::RRClass::IN(),
+                               sqlite3_accessor));
+        client->setNameFilterEnabled(name_filter);
+        return (client.release());
     } catch (const std::exception& exc) {
         error = std::string("Error creating SQLite3 datasource: ") +
             exc.what();
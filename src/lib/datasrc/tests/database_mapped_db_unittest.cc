@@ -0,0 +1,61 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <datasrc/tests/database_unittest.h>
+
+#include <datasrc/database.h>
+#include <datasrc/mapped_db_accessor.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <unistd.h>
+
+using namespace bundy::datasrc;
+using namespace bundy::datasrc::test;
+
+namespace {
+const char* const MAPPED_DBFILE = TEST_DATA_BUILDDIR "/rwtest.mapped_db";
+
+boost::shared_ptr<DatabaseAccessor>
+createMappedDBAccessor() {
+    // Always start with an empty database (which the accessor creates),
+    // so we have empty diffs at the beginning of each test.
+    unlink(MAPPED_DBFILE);
+
+    boost::shared_ptr<DatabaseAccessor> accessor(
+        new MappedDBAccessor(MAPPED_DBFILE, "IN"));
+    accessor->startTransaction();
+    accessor->addZone("example.org.");
+    accessor->commit();
+
+    // The accessor implements all API, so we can use the generic
+    // loadTestDataGeneric once the zone is created.
+    loadTestDataGeneric(*accessor);
+
+    return (accessor);
+}
+
+// The test parameter for the mapped DB accessor.  We can use
+// enableNSEC3Generic as this accessor fully supports NSEC3 related APIs.
+const DatabaseClientTestParam mapped_db_param = { createMappedDBAccessor,
+                                                  enableNSEC3Generic };
+
+INSTANTIATE_TEST_CASE_P(MappedDB, DatabaseClientTest,
+                        ::testing::Values(&mapped_db_param));
+
+INSTANTIATE_TEST_CASE_P(MappedDB, RRsetCollectionTest,
+                        ::testing::Values(&mapped_db_param));
+}
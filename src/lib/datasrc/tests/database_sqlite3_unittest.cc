@@ -65,4 +65,13 @@ INSTANTIATE_TEST_CASE_P(SQLite3, DatabaseClientTest,
 
 INSTANTIATE_TEST_CASE_P(SQLite3, RRsetCollectionTest,
                         ::testing::Values(&sqlite3_param));
+
+// Run the same tests with the negative lookup filter.  All results must be
+// identical to the ones without the filter.
+const DatabaseClientTestParam sqlite3_filter_param = { createSQLite3Accessor,
+                                                       enableNSEC3Generic,
+                                                       true };
+
+INSTANTIATE_TEST_CASE_P(SQLite3NameFilter, DatabaseClientTest,
+                        ::testing::Values(&sqlite3_filter_param));
 }
@@ -1170,6 +1170,12 @@ DatabaseClientTest::createClient(const DatabaseClientTestParam* test_param) {
     current_accessor_ = test_param->accessor_creator();
     is_mock_ = (dynamic_cast<MockAccessor*>(current_accessor_.get()) != NULL);
     client_.reset(new DatabaseClient("dbtest", qclass_, current_accessor_));
+    client_->setNameFilterEnabled(test_param->enable_name_filter);
+    if (test_param->enable_name_filter) {
+        // Build the filter now rather than in the background so the tests
+        // always run with it.
+        client_->buildNameFilter(zname_);
+    }
 
     // set up the commonly used finder.
     const DataSourceClient::FindResult result(client_->findZone(zname_));
@@ -1409,6 +1415,27 @@ TEST_P(DatabaseClientTest, superZone) {
     checkZoneFinder(result);
 }
 
+// The client reuses the finders it created, as long as they are for the
+// same origin.
+TEST_P(DatabaseClientTest, cachedFinder) {
+    const ZoneFinderPtr finder(client_->findZone(zname_).zone_finder);
+    EXPECT_EQ(finder, client_->findZone(zname_).zone_finder);
+    EXPECT_EQ(finder, client_->findZone(Name("sub.example.org")).zone_finder);
+
+    // A different case of the origin needs a new finder, as the finder
+    // keeps the case of the name it was created for.  (The mock accessor
+    // doesn't know the zone in upper case.)
+    if (is_mock_) {
+        return;
+    }
+    const ZoneFinderPtr upper_finder(
+        client_->findZone(Name("EXAMPLE.ORG")).zone_finder);
+    EXPECT_NE(finder, upper_finder);
+    EXPECT_EQ(Name("EXAMPLE.ORG").toText(),
+              upper_finder->getOrigin().toText());
+    checkZoneFinder(client_->findZone(zname_));
+}
+
 // This test doesn't depend on derived accessor class, so we use TEST().
 TEST(GenericDatabaseClientTest, noAccessorException) {
     // We need a dummy variable here; some compiler would regard it a mere
@@ -3182,6 +3209,90 @@ TEST_P(DatabaseClientTest, updaterFinder) {
                ZoneFinder::NXDOMAIN, empty_rdatas_, empty_rdatas_);
 }
 
+// The negative lookup filter shouldn't change any result of find(), and
+// it should be kept up to date by the updaters of the client.
+TEST_P(DatabaseClientTest, nameFilter) {
+    // The mock accessor iterates over data different from what it returns
+    // for lookups, so the filter built from it would be meaningless.
+    if (is_mock_) {
+        return;
+    }
+
+    // It's not available unless enabled.
+    client_->setNameFilterEnabled(false);
+    EXPECT_FALSE(client_->buildNameFilter(zname_));
+    client_->setNameFilterEnabled(true);
+    EXPECT_TRUE(client_->buildNameFilter(zname_));
+    EXPECT_FALSE(client_->buildNameFilter(Name("example.com.")));
+    boost::shared_ptr<DatabaseClient::Finder> finder(getFinder());
+
+    EXPECT_EQ(ZoneFinder::SUCCESS, finder->find(qname_, qtype_)->code);
+    // Empty non-terminal
+    EXPECT_EQ(ZoneFinder::NXRRSET,
+              finder->find(Name("here.wild.example.org."), qtype_)->code);
+    // Wildcard match
+    EXPECT_EQ(ZoneFinder::SUCCESS,
+              finder->find(Name("a.wild.example.org."), qtype_)->code);
+    // Below a zone cut
+    EXPECT_EQ(ZoneFinder::DELEGATION,
+              finder->find(Name("below.delegation.example.org."),
+                           qtype_)->code);
+    const Name newname("www.newname.example.org.");
+    EXPECT_EQ(ZoneFinder::NXDOMAIN, finder->find(newname, qtype_)->code);
+    EXPECT_EQ(ZoneFinder::NXDOMAIN,
+              finder->find(Name("newname.example.org."), qtype_)->code);
+
+    // Add the name through an updater.  A new finder should find it.
+    RRsetPtr rrset(new RRset(newname, qclass_, qtype_, rrttl_));
+    rrset->addRdata(rdata::createRdata(qtype_, qclass_, "192.0.2.10"));
+    updater_ = client_->getUpdater(zname_, false);
+    updater_->addRRset(*rrset);
+    updater_->commit();
+    EXPECT_EQ(ZoneFinder::SUCCESS, getFinder()->find(newname, qtype_)->code);
+    // Its superdomain is now an empty non-terminal
+    EXPECT_EQ(ZoneFinder::NXRRSET,
+              getFinder()->find(Name("newname.example.org."), qtype_)->code);
+
+    // Replacing the zone builds a new filter, which doesn't have the names
+    // that are gone.
+    updater_ = client_->getUpdater(zname_, true);
+    updater_->addRRset(*soa_);
+    updater_->addRRset(*rrset);
+    updater_->commit();
+    EXPECT_EQ(ZoneFinder::SUCCESS, getFinder()->find(newname, qtype_)->code);
+    EXPECT_EQ(ZoneFinder::NXDOMAIN, getFinder()->find(qname_, qtype_)->code);
+}
+
+// If the zone is modified (with a different serial) behind the client,
+// the filter should be detected outdated and not be used.
+TEST_P(DatabaseClientTest, nameFilterOutdated) {
+    // See nameFilter.
+    if (is_mock_) {
+        return;
+    }
+
+    client_->setNameFilterEnabled(true);
+    EXPECT_TRUE(client_->buildNameFilter(zname_));
+    const Name newname("newname.example.org.");
+    EXPECT_EQ(ZoneFinder::NXDOMAIN, getFinder()->find(newname, qtype_)->code);
+
+    // Update the zone through a separate client, changing the serial.
+    DatabaseClient other_client("dbtest", qclass_, current_accessor_);
+    RRsetPtr rrset(new RRset(newname, qclass_, qtype_, rrttl_));
+    rrset->addRdata(rdata::createRdata(qtype_, qclass_, "192.0.2.10"));
+    RRsetPtr new_soa(new RRset(zname_, qclass_, RRType::SOA(), rrttl_));
+    new_soa->addRdata(rdata::createRdata(new_soa->getType(), qclass_,
+                                         "ns1.example.org. admin.example.org. "
+                                         "1235 3600 1800 2419200 7200"));
+    updater_ = other_client.getUpdater(zname_, false);
+    updater_->deleteRRset(*soa_);
+    updater_->addRRset(*new_soa);
+    updater_->addRRset(*rrset);
+    updater_->commit();
+
+    EXPECT_EQ(ZoneFinder::SUCCESS, getFinder()->find(newname, qtype_)->code);
+}
+
 TEST_P(DatabaseClientTest, flushZone) {
     // A simple update case: flush the entire zone
     boost::shared_ptr<DatabaseClient::Finder> finder(getFinder());
@@ -137,6 +137,13 @@ struct DatabaseClientTestParam {
     /// be the generic \c enableNSEC3Generic function.  See TEST_RECORDS
     /// and TEST_NSEC3_RECORDS for the condition.
     void (*enable_nsec3_fn)(DatabaseAccessor& accessor);
+
+    /// \brief Whether to enable the negative lookup filter of the client.
+    ///
+    /// If true, the tested client is configured with
+    /// \c DatabaseClient::setNameFilterEnabled(true).  This member can be
+    /// omitted in the initializer, in which case it's false.
+    bool enable_name_filter;
 };
 
 // forward declaration, needed in the definition of DatabaseClientTest.
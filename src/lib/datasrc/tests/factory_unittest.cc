@@ -16,6 +16,7 @@
 
 #include <datasrc/datasrc_config.h>
 #include <datasrc/factory.h>
+#include <datasrc/database.h>
 #include <datasrc/exceptions.h>
 #include <datasrc/sqlite3_accessor.h>
 
@@ -161,6 +162,30 @@ TEST(FactoryTest, sqlite3ClientBadConfig) {
         bundy::dns::Name("example.org."), false));
 }
 
+TEST(FactoryTest, sqlite3ClientNameFilterConfig) {
+    ElementPtr config = Element::createMap();
+    config->set("class", Element::create("IN"));
+    config->set("database_file", Element::create(SQLITE_DBFILE_EXAMPLE_ORG));
+
+    // The negative lookup filter switch must be a boolean.
+    config->set("name_filter", Element::create("yes"));
+    EXPECT_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config),
+                 DataSourceError);
+
+    config->set("name_filter", Element::create(true));
+    DataSourceClientContainer dsc("sqlite3", "sqlite3", config);
+    DatabaseClient& client =
+        dynamic_cast<DatabaseClient&>(dsc.getInstance());
+    EXPECT_TRUE(client.buildNameFilter(bundy::dns::Name("example.org.")));
+    EXPECT_EQ(result::SUCCESS,
+              client.findZone(bundy::dns::Name("example.org.")).code);
+
+    config->set("name_filter", Element::create(false));
+    DataSourceClientContainer dsc2("sqlite3", "sqlite3", config);
+    EXPECT_FALSE(dynamic_cast<DatabaseClient&>(dsc2.getInstance()).
+                 buildNameFilter(bundy::dns::Name("example.org.")));
+}
+
 TEST(FactoryTest, badType) {
     ASSERT_THROW(DataSourceClientContainer("foo", "foo", ElementPtr()),
                                            DataSourceError);
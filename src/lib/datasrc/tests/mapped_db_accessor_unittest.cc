@@ -0,0 +1,388 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <datasrc/mapped_db_accessor.h>
+
+#include <datasrc/exceptions.h>
+
+#include <dns/name.h>
+
+#include <exceptions/exceptions.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace bundy::datasrc;
+using bundy::dns::Name;
+
+namespace {
+const char* const MAPPED_DBFILE = TEST_DATA_BUILDDIR "/test.mapped_db";
+
+// A mapped database with a single zone, example.org., and a few records.
+class MappedDBAccessorTest : public ::testing::Test {
+protected:
+    MappedDBAccessorTest() {
+        unlink(MAPPED_DBFILE);
+        accessor.reset(new MappedDBAccessor(MAPPED_DBFILE, "IN"));
+        accessor->startTransaction();
+        zone_id = accessor->addZone("example.org.");
+        accessor->commit();
+
+        accessor->startUpdateZone("example.org.", false);
+        addRecord("example.org.", "SOA", "3600", "",
+                  "ns.example.org. admin.example.org. 1234 3600 1800 "
+                  "2419200 7200");
+        addRecord("example.org.", "NSEC", "3600", "",
+                  "www.example.org. SOA NSEC");
+        addRecord("www.example.org.", "A", "3600", "", "192.0.2.1");
+        addRecord("WWW.example.org.", "A", "3600", "", "192.0.2.2");
+        addRecord("www.example.org.", "RRSIG", "3600", "A",
+                  "A 5 3 3600 20000101000000 20000201000000 12345 "
+                  "example.org. FAKEFAKEFAKE");
+        addRecord("www.example.org.", "NSEC", "3600", "",
+                  "sub.www.example.org. A NSEC");
+        addRecord("sub.www.example.org.", "A", "3600", "", "192.0.2.3");
+        accessor->commit();
+    }
+
+    ~MappedDBAccessorTest() {
+        accessor.reset();
+        another_accessor.reset();
+        unlink(MAPPED_DBFILE);
+    }
+
+    void addRecord(const char* name, const char* type, const char* ttl,
+                   const char* sigtype, const char* rdata)
+    {
+        const string columns[DatabaseAccessor::ADD_COLUMN_COUNT] = {
+            name, Name(name).reverse().toText(), ttl, type, sigtype, rdata
+        };
+        accessor->addRecordToZone(columns);
+    }
+
+    void addNSEC3(const char* hash, const char* type, const char* rdata) {
+        const string columns[DatabaseAccessor::ADD_NSEC3_COLUMN_COUNT] = {
+            hash, "3600", type, rdata
+        };
+        accessor->addNSEC3RecordToZone(columns);
+    }
+
+    // Return the RDATA of all records from the context, space separated.
+    string getRdata(DatabaseAccessor::IteratorContextPtr context) {
+        string result;
+        string columns[DatabaseAccessor::COLUMN_COUNT];
+        while (context->getNext(columns)) {
+            if (!result.empty()) {
+                result += " ";
+            }
+            result += columns[DatabaseAccessor::TYPE_COLUMN] + "/" +
+                columns[DatabaseAccessor::RDATA_COLUMN];
+        }
+        return (result);
+    }
+
+    string getAddresses(DatabaseAccessor& target, const string& name) {
+        string result;
+        string columns[DatabaseAccessor::COLUMN_COUNT];
+        DatabaseAccessor::IteratorContextPtr context =
+            target.getRecords(name, zone_id);
+        while (context->getNext(columns)) {
+            if (columns[DatabaseAccessor::TYPE_COLUMN] == "A") {
+                if (!result.empty()) {
+                    result += " ";
+                }
+                result += columns[DatabaseAccessor::RDATA_COLUMN];
+            }
+        }
+        return (result);
+    }
+
+    boost::scoped_ptr<MappedDBAccessor> accessor;
+    boost::scoped_ptr<MappedDBAccessor> another_accessor;
+    int zone_id;
+};
+
+TEST_F(MappedDBAccessorTest, getZone) {
+    EXPECT_EQ(make_pair(true, zone_id), accessor->getZone("example.org."));
+    EXPECT_EQ(make_pair(true, zone_id), accessor->getZone("EXAMPLE.org."));
+    EXPECT_FALSE(accessor->getZone("www.example.org.").first);
+    EXPECT_FALSE(accessor->getZone("example.com.").first);
+
+    // The zone is of class IN, so it's not visible for CH.
+    EXPECT_FALSE(MappedDBAccessor(MAPPED_DBFILE, "CH").
+                 getZone("example.org.").first);
+}
+
+TEST_F(MappedDBAccessorTest, getDBName) {
+    EXPECT_EQ("mapped_db_test.mapped_db", accessor->getDBName());
+}
+
+TEST_F(MappedDBAccessorTest, getRecords) {
+    // The records are found regardless of the case of the name, and the
+    // RRSIG is returned with its covered type.
+    string columns[DatabaseAccessor::COLUMN_COUNT];
+    DatabaseAccessor::IteratorContextPtr context =
+        accessor->getRecords("Www.Example.Org.", zone_id);
+    ASSERT_TRUE(context->getNext(columns));
+    EXPECT_EQ("A", columns[DatabaseAccessor::TYPE_COLUMN]);
+    EXPECT_EQ("3600", columns[DatabaseAccessor::TTL_COLUMN]);
+    EXPECT_EQ("192.0.2.1", columns[DatabaseAccessor::RDATA_COLUMN]);
+    // The name column isn't set for lookups by name.
+    EXPECT_EQ("", columns[DatabaseAccessor::NAME_COLUMN]);
+    ASSERT_TRUE(context->getNext(columns));
+    EXPECT_EQ("192.0.2.2", columns[DatabaseAccessor::RDATA_COLUMN]);
+    ASSERT_TRUE(context->getNext(columns));
+    EXPECT_EQ("NSEC", columns[DatabaseAccessor::TYPE_COLUMN]);
+    ASSERT_TRUE(context->getNext(columns));
+    EXPECT_EQ("RRSIG", columns[DatabaseAccessor::TYPE_COLUMN]);
+    EXPECT_EQ("A", columns[DatabaseAccessor::SIGTYPE_COLUMN]);
+    EXPECT_FALSE(context->getNext(columns));
+
+    EXPECT_EQ("", getRdata(accessor->getRecords("nx.example.org.",
+                                                zone_id)));
+    EXPECT_EQ("", getRdata(accessor->getRecords("www.example.org.",
+                                                zone_id + 1)));
+}
+
+TEST_F(MappedDBAccessorTest, getSubdomains) {
+    EXPECT_EQ("A/192.0.2.3",
+              getRdata(accessor->getRecords("sub.www.example.org.", zone_id,
+                                            true)));
+    EXPECT_EQ("", getRdata(accessor->getRecords("nx.www.example.org.",
+                                                zone_id, true)));
+    // A name that is a textual prefix of existing names doesn't match.
+    EXPECT_EQ("", getRdata(accessor->getRecords("ww.example.org.", zone_id,
+                                                true)));
+}
+
+TEST_F(MappedDBAccessorTest, getAllRecords) {
+    accessor->startUpdateZone("example.org.", false);
+    addNSEC3("1BB7SO0452U1QHL98UISNDD9218GELR5", "NSEC3",
+             "1 1 12 AABBCCDD 2T7B4G4VSA5SMI47K61MV5BV1A22BOJR A RRSIG");
+    accessor->commit();
+
+    string columns[DatabaseAccessor::COLUMN_COUNT];
+    DatabaseAccessor::IteratorContextPtr context =
+        accessor->getAllRecords(zone_id);
+    // Ordered by the reversed name and type, so the apex comes first.
+    const char* const expected[][2] = {
+        { "example.org.", "NSEC" }, { "example.org.", "SOA" },
+        { "www.example.org.", "A" }, { "WWW.example.org.", "A" },
+        { "www.example.org.", "NSEC" }, { "www.example.org.", "RRSIG" },
+        { "sub.www.example.org.", "A" },
+        { "1BB7SO0452U1QHL98UISNDD9218GELR5.example.org.", "NSEC3" }
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        SCOPED_TRACE(expected[i][0]);
+        ASSERT_TRUE(context->getNext(columns));
+        EXPECT_EQ(expected[i][0], columns[DatabaseAccessor::NAME_COLUMN]);
+        EXPECT_EQ(expected[i][1], columns[DatabaseAccessor::TYPE_COLUMN]);
+    }
+    EXPECT_EQ("NSEC3", columns[DatabaseAccessor::SIGTYPE_COLUMN]);
+    EXPECT_FALSE(context->getNext(columns));
+}
+
+TEST_F(MappedDBAccessorTest, findPrevious) {
+    EXPECT_EQ("example.org.",
+              accessor->findPreviousName(zone_id,
+                                         "org.example.www."));
+    EXPECT_EQ("www.example.org.",
+              accessor->findPreviousName(zone_id,
+                                         "org.example.www.sub."));
+    // Before the apex
+    EXPECT_THROW(accessor->findPreviousName(zone_id, "org."),
+                 bundy::NotImplemented);
+}
+
+TEST_F(MappedDBAccessorTest, nsec3) {
+    EXPECT_THROW(accessor->findPreviousNSEC3Hash(zone_id, "A"),
+                 DataSourceError);
+
+    accessor->startUpdateZone("example.org.", false);
+    addNSEC3("1BB7SO0452U1QHL98UISNDD9218GELR5", "NSEC3", "nsec3-1");
+    addNSEC3("1BB7SO0452U1QHL98UISNDD9218GELR5", "RRSIG", "rrsig-1");
+    addNSEC3("2T7B4G4VSA5SMI47K61MV5BV1A22BOJR", "NSEC3", "nsec3-2");
+    accessor->commit();
+
+    // The hash is case insensitive.
+    EXPECT_EQ("NSEC3/nsec3-1 RRSIG/rrsig-1",
+              getRdata(accessor->getNSEC3Records(
+                           "1bb7so0452u1qhl98uisndd9218gelr5", zone_id)));
+    EXPECT_EQ("", getRdata(accessor->getNSEC3Records("3", zone_id)));
+
+    EXPECT_EQ("1BB7SO0452U1QHL98UISNDD9218GELR5",
+              accessor->findPreviousNSEC3Hash(
+                  zone_id, "2T7B4G4VSA5SMI47K61MV5BV1A22BOJR"));
+    // Wrap around
+    EXPECT_EQ("2T7B4G4VSA5SMI47K61MV5BV1A22BOJR",
+              accessor->findPreviousNSEC3Hash(
+                  zone_id, "1BB7SO0452U1QHL98UISNDD9218GELR5"));
+}
+
+TEST_F(MappedDBAccessorTest, deleteRecords) {
+    accessor->startUpdateZone("example.org.", false);
+    const string params[DatabaseAccessor::DEL_PARAM_COUNT] = {
+        "www.example.org.", "A", "192.0.2.2", "org.example.www."
+    };
+    accessor->deleteRecordInZone(params);
+    // Visible within the update
+    EXPECT_EQ("192.0.2.1", getAddresses(*accessor, "www.example.org."));
+    accessor->commit();
+    EXPECT_EQ("192.0.2.1", getAddresses(*accessor, "www.example.org."));
+}
+
+TEST_F(MappedDBAccessorTest, replaceZone) {
+    accessor->startUpdateZone("example.org.", true);
+    EXPECT_EQ("", getAddresses(*accessor, "www.example.org."));
+    addRecord("www.example.org.", "A", "3600", "", "192.0.2.10");
+    EXPECT_EQ("192.0.2.10", getAddresses(*accessor, "www.example.org."));
+    accessor->rollback();
+    EXPECT_EQ("192.0.2.1 192.0.2.2",
+              getAddresses(*accessor, "www.example.org."));
+}
+
+// Readers see the committed version only, and switch to a new version once
+// it's committed, while contexts keep the version they started with.
+TEST_F(MappedDBAccessorTest, readWhileUpdate) {
+    another_accessor.reset(new MappedDBAccessor(MAPPED_DBFILE, "IN"));
+    DatabaseAccessor::IteratorContextPtr context =
+        another_accessor->getRecords("sub.www.example.org.", zone_id);
+
+    accessor->startUpdateZone("example.org.", false);
+    addRecord("sub.www.example.org.", "A", "3600", "", "192.0.2.4");
+    EXPECT_EQ("192.0.2.3",
+              getAddresses(*another_accessor, "sub.www.example.org."));
+    accessor->commit();
+    EXPECT_EQ("192.0.2.3 192.0.2.4",
+              getAddresses(*another_accessor, "sub.www.example.org."));
+
+    EXPECT_EQ("A/192.0.2.3", getRdata(context));
+}
+
+TEST_F(MappedDBAccessorTest, updateConflict) {
+    another_accessor.reset(new MappedDBAccessor(MAPPED_DBFILE, "IN"));
+    accessor->startUpdateZone("example.org.", false);
+    EXPECT_THROW(another_accessor->startUpdateZone("example.org.", false),
+                 DataSourceError);
+    accessor->rollback();
+    EXPECT_TRUE(another_accessor->startUpdateZone("example.org.",
+                                                  false).first);
+    another_accessor->rollback();
+}
+
+// A transaction that only reads doesn't block updates, but one that tries
+// to write after somebody else committed fails.
+TEST_F(MappedDBAccessorTest, readTransaction) {
+    another_accessor.reset(new MappedDBAccessor(MAPPED_DBFILE, "IN"));
+    another_accessor->startTransaction();
+
+    accessor->startUpdateZone("example.org.", false);
+    addRecord("sub.www.example.org.", "A", "3600", "", "192.0.2.4");
+    accessor->commit();
+
+    // The transaction still sees the version it started with.
+    EXPECT_EQ("192.0.2.3",
+              getAddresses(*another_accessor, "sub.www.example.org."));
+    EXPECT_THROW(another_accessor->addZone("example.com."), DataSourceError);
+    another_accessor->rollback();
+    EXPECT_EQ("192.0.2.3 192.0.2.4",
+              getAddresses(*another_accessor, "sub.www.example.org."));
+}
+
+TEST_F(MappedDBAccessorTest, withoutTransaction) {
+    const string params[DatabaseAccessor::DEL_PARAM_COUNT] = {
+        "www.example.org.", "A", "192.0.2.2", "org.example.www."
+    };
+    EXPECT_THROW(accessor->deleteRecordInZone(params), DataSourceError);
+    EXPECT_THROW(accessor->addZone("example.com."), DataSourceError);
+    EXPECT_THROW(accessor->deleteZone(zone_id), bundy::InvalidOperation);
+    EXPECT_THROW(accessor->commit(), DataSourceError);
+    EXPECT_THROW(accessor->rollback(), DataSourceError);
+
+    accessor->startTransaction();
+    EXPECT_THROW(accessor->startTransaction(), DataSourceError);
+    EXPECT_THROW(accessor->startUpdateZone("example.org.", false),
+                 DataSourceError);
+    // A zone update is needed for adding records.
+    EXPECT_THROW(accessor->deleteRecordInZone(params), DataSourceError);
+    accessor->rollback();
+}
+
+TEST_F(MappedDBAccessorTest, deleteZone) {
+    accessor->startTransaction();
+    const int new_id = accessor->addZone("example.com.");
+    EXPECT_NE(zone_id, new_id);
+    accessor->deleteZone(zone_id);
+    accessor->commit();
+
+    EXPECT_FALSE(accessor->getZone("example.org.").first);
+    EXPECT_EQ(make_pair(true, new_id), accessor->getZone("example.com."));
+    EXPECT_EQ("", getAddresses(*accessor, "www.example.org."));
+}
+
+TEST_F(MappedDBAccessorTest, diffs) {
+    accessor->startUpdateZone("example.org.", false);
+    const string del_params[DatabaseAccessor::DIFF_PARAM_COUNT] = {
+        "example.org.", "SOA", "3600", "soa-1"
+    };
+    const string add_params[DatabaseAccessor::DIFF_PARAM_COUNT] = {
+        "example.org.", "SOA", "3600", "soa-2"
+    };
+    accessor->addRecordDiff(zone_id, 1234, DatabaseAccessor::DIFF_DELETE,
+                            del_params);
+    accessor->addRecordDiff(zone_id, 1235, DatabaseAccessor::DIFF_ADD,
+                            add_params);
+    EXPECT_THROW(accessor->addRecordDiff(zone_id + 1, 1235,
+                                         DatabaseAccessor::DIFF_ADD,
+                                         add_params), DataSourceError);
+    accessor->commit();
+
+    EXPECT_EQ("SOA/soa-1 SOA/soa-2",
+              getRdata(accessor->getDiffs(zone_id, 1234, 1235)));
+    EXPECT_THROW(accessor->getDiffs(zone_id, 1233, 1235), NoSuchSerial);
+    EXPECT_THROW(accessor->getDiffs(zone_id, 1234, 1236), NoSuchSerial);
+}
+
+TEST_F(MappedDBAccessorTest, clone) {
+    const boost::shared_ptr<DatabaseAccessor> cloned = accessor->clone();
+    EXPECT_EQ(accessor->getDBName(), cloned->getDBName());
+    EXPECT_EQ("192.0.2.1 192.0.2.2",
+              getAddresses(*cloned, "www.example.org."));
+}
+
+TEST(MappedDBOpen, brokenFile) {
+    const char* const broken_file = TEST_DATA_BUILDDIR "/broken.mapped_db";
+    {
+        ofstream out(broken_file);
+        out << "This is not a database, but it is long enough for the "
+            "header";
+    }
+    EXPECT_THROW(MappedDBAccessor(broken_file, "IN"), DataSourceError);
+    unlink(broken_file);
+}
+
+TEST(MappedDBOpen, notCreatable) {
+    EXPECT_THROW(MappedDBAccessor(TEST_DATA_BUILDDIR "/nodir/notexist", "IN"),
+                 DataSourceError);
+}
+
+}
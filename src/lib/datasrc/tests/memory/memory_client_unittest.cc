@@ -955,6 +955,28 @@ TEST_F(MemoryClientTest, findZoneData) {
     EXPECT_EQ(static_cast<const RdataSet*>(NULL), set);
 }
 
+TEST_F(MemoryClientTest, cachedFinder) {
+    loadZoneIntoTable(*ztable_segment_, Name("example.org"), zclass_,
+                      TEST_DATA_DIR "/example.org-empty.zone");
+
+    // The same finder is returned for the same zone data
+    const ZoneFinderPtr finder =
+        client_->findZone(Name("example.org")).zone_finder;
+    ASSERT_TRUE(finder);
+    EXPECT_EQ(finder, client_->findZone(Name("example.org")).zone_finder);
+    EXPECT_EQ(finder, client_->findZone(Name("www.example.org")).zone_finder);
+
+    // After a reload, the finder is for the new data
+    loadZoneIntoTable(*ztable_segment_, Name("example.org"), zclass_,
+                      TEST_DATA_DIR "/example.org-rrsigs.zone");
+    const ZoneFinderPtr new_finder =
+        client_->findZone(Name("example.org")).zone_finder;
+    ASSERT_TRUE(new_finder);
+    EXPECT_NE(finder, new_finder);
+    EXPECT_EQ(ZoneFinder::SUCCESS,
+              new_finder->find(Name("ns1.example.org"), RRType::A())->code);
+}
+
 TEST_F(MemoryClientTest, getUpdaterThrowsNotImplemented) {
     // This method is not implemented.
     EXPECT_THROW(client_->getUpdater(Name("."), false, false),
@@ -1332,6 +1332,143 @@ TEST_F(SQLite3Update, concurrentTransactions) {
     another_accessor->commit();
 }
 
+// Count the (explicitly created) indexes of the record tables in the given
+// DB file.
+int
+countIndexes(const char* dbfile) {
+    sqlite3* db = NULL;
+    EXPECT_EQ(SQLITE_OK, sqlite3_open(dbfile, &db));
+    sqlite3_stmt* stmt = NULL;
+    EXPECT_EQ(SQLITE_OK,
+              sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM sqlite_master "
+                                 "WHERE type = 'index' AND tbl_name IN "
+                                 "('records', 'nsec3') AND sql IS NOT NULL",
+                                 -1, &stmt, NULL));
+    EXPECT_EQ(SQLITE_ROW, sqlite3_step(stmt));
+    const int count = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return (count);
+}
+
+// Add the given number of A records named "name<N>.example.com." in the
+// current zone update.
+void
+addBulkRecords(SQLite3Accessor& accessor, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const string label = "name" + lexical_cast<string>(i);
+        const string columns[DatabaseAccessor::ADD_COLUMN_COUNT] = {
+            label + ".example.com.", "com.example." + label + ".", "3600",
+            "A", "", "192.0.2.1"
+        };
+        accessor.addRecordToZone(columns);
+    }
+}
+
+// Check the records added by addBulkRecords() for a few names, including
+// ones inserted by multi-row statements and one by one.
+void
+checkBulkRecords(SQLite3Accessor& accessor, int zone_id, bool exist) {
+    const char* const names[] = { "name0", "name127", "name128", "name299" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        const string name = string(names[i]) + ".example.com.";
+        const string rname = string("com.example.") + names[i] + ".";
+        const char* const data[] = {
+            name.c_str(), rname.c_str(), "3600", "A", "", "192.0.2.1"
+        };
+        vector<const char* const*> expected;
+        if (exist) {
+            expected.push_back(data);
+        }
+        checkRecords(accessor, zone_id, name, expected);
+    }
+}
+
+TEST_F(SQLite3Update, bulkLoad) {
+    const char* const dbfile = TEST_DATA_BUILDDIR "/test.sqlite3.copied";
+    const int index_count = countIndexes(dbfile);
+    EXPECT_LT(0, index_count);
+
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->startBulkLoad();
+    // Calling it twice is harmless.
+    accessor->startBulkLoad();
+    addBulkRecords(*accessor, 300);
+
+    // The records are visible within the update, and once committed, to
+    // others, too.  The indexes must be back.
+    checkBulkRecords(*accessor, zone_id, true);
+    accessor->commit();
+    checkBulkRecords(*another_accessor, zone_id, true);
+    checkRecords(*another_accessor, zone_id, "foo.bar.example.com.",
+                 empty_stored);
+    EXPECT_EQ(index_count, countIndexes(dbfile));
+
+    // All the records are there, and only once.
+    iterator = another_accessor->getAllRecords(zone_id);
+    size_t count = 0;
+    while (iterator->getNext(get_columns)) {
+        ++count;
+    }
+    EXPECT_EQ(300, count);
+}
+
+TEST_F(SQLite3Update, bulkLoadCommitWithoutRead) {
+    // Records still buffered must be stored at commit.
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->startBulkLoad();
+    addBulkRecords(*accessor, 300);
+    accessor->commit();
+    checkBulkRecords(*another_accessor, zone_id, true);
+    EXPECT_LT(0, countIndexes(TEST_DATA_BUILDDIR "/test.sqlite3.copied"));
+}
+
+TEST_F(SQLite3Update, bulkLoadRollback) {
+    const char* const dbfile = TEST_DATA_BUILDDIR "/test.sqlite3.copied";
+    const int index_count = countIndexes(dbfile);
+
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->startBulkLoad();
+    addBulkRecords(*accessor, 300);
+    accessor->rollback();
+
+    // Everything, including the indexes, should be reverted.
+    checkBulkRecords(*accessor, zone_id, false);
+    checkRecords(*accessor, zone_id, "foo.bar.example.com.", expected_stored);
+    EXPECT_EQ(index_count, countIndexes(dbfile));
+
+    // The accessor can be used for another update, which is not in the bulk
+    // load mode.
+    zone_id = accessor->startUpdateZone("example.com.", false).second;
+    copy(new_data, new_data + DatabaseAccessor::ADD_COLUMN_COUNT,
+         add_columns);
+    accessor->addRecordToZone(add_columns);
+    accessor->commit();
+    expected_stored.clear();
+    expected_stored.push_back(new_data);
+    checkRecords(*another_accessor, zone_id, "newdata.example.com.",
+                 expected_stored);
+}
+
+TEST_F(SQLite3Update, bulkLoadThenDelete) {
+    // Deletion in the bulk load mode must see the buffered records.
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->startBulkLoad();
+    addBulkRecords(*accessor, 1);
+    const string params[DatabaseAccessor::DEL_PARAM_COUNT] = {
+        "name0.example.com.", "A", "192.0.2.1", "com.example.name0."
+    };
+    accessor->deleteRecordInZone(params);
+    accessor->commit();
+    checkRecords(*accessor, zone_id, "name0.example.com.", empty_stored);
+}
+
+TEST_F(SQLite3Update, bulkLoadWithoutUpdate) {
+    EXPECT_THROW(accessor->startBulkLoad(), DataSourceError);
+    accessor->startTransaction();
+    EXPECT_THROW(accessor->startBulkLoad(), DataSourceError);
+}
+
 //
 // Commonly used data for diff related tests.  The last two entries are
 // a textual representation of "version" and a textual representation of
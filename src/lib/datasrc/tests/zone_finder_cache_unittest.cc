@@ -0,0 +1,146 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <datasrc/zone_finder_cache.h>
+
+#include <exceptions/exceptions.h>
+#include <util/threads/thread.h>
+
+#include <dns/name.h>
+#include <dns/rrclass.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+
+#include <vector>
+
+using namespace bundy::dns;
+using namespace bundy::datasrc;
+using bundy::util::thread::Thread;
+using boost::shared_ptr;
+using std::vector;
+
+namespace {
+
+// A finder that can't find anything, only to be stored in the cache.
+class TestFinder : public ZoneFinder {
+public:
+    TestFinder() : origin_("example.org") {}
+    Name getOrigin() const { return (origin_); }
+    RRClass getClass() const { return (RRClass::IN()); }
+    shared_ptr<Context> find(const Name&, const RRType&, const FindOptions) {
+        bundy_throw(bundy::NotImplemented, "Not implemented");
+    }
+    shared_ptr<Context> findAll(const Name&, vector<ConstRRsetPtr>&,
+                                const FindOptions)
+    {
+        bundy_throw(bundy::NotImplemented, "Not implemented");
+    }
+    FindNSEC3Result findNSEC3(const Name&, bool) {
+        bundy_throw(bundy::NotImplemented, "Not implemented");
+    }
+private:
+    const Name origin_;
+};
+
+class ZoneFinderCacheTest : public ::testing::Test {
+protected:
+    ZoneFinderCacheTest() : cache_(2), finder1_(new TestFinder),
+                            finder2_(new TestFinder),
+                            finder3_(new TestFinder)
+    {}
+
+    ZoneFinderCache cache_;
+    // Only the addresses are used as keys
+    int zone1_, zone2_, zone3_;
+    const ZoneFinderPtr finder1_, finder2_, finder3_;
+};
+
+TEST_F(ZoneFinderCacheTest, construct) {
+    EXPECT_EQ(2, cache_.getCapacity());
+    EXPECT_EQ(ZoneFinderCache::DEFAULT_CAPACITY,
+              ZoneFinderCache().getCapacity());
+    EXPECT_FALSE(cache_.find(&zone1_, 0));
+}
+
+TEST_F(ZoneFinderCacheTest, addAndFind) {
+    cache_.add(&zone1_, 0, finder1_);
+    cache_.add(&zone2_, 0, finder2_);
+    EXPECT_EQ(finder1_, cache_.find(&zone1_, 0));
+    EXPECT_EQ(finder2_, cache_.find(&zone2_, 0));
+
+    // Both parts of the key have to match
+    EXPECT_FALSE(cache_.find(&zone1_, 1));
+    EXPECT_FALSE(cache_.find(&zone3_, 0));
+
+    // Adding the same key replaces the finder
+    cache_.add(&zone1_, 0, finder3_);
+    EXPECT_EQ(finder3_, cache_.find(&zone1_, 0));
+}
+
+TEST_F(ZoneFinderCacheTest, leastRecentlyUsed) {
+    cache_.add(&zone1_, 0, finder1_);
+    cache_.add(&zone2_, 0, finder2_);
+    // Now zone2 is the least recently used one
+    EXPECT_EQ(finder1_, cache_.find(&zone1_, 0));
+
+    cache_.add(&zone3_, 0, finder3_);
+    EXPECT_EQ(finder1_, cache_.find(&zone1_, 0));
+    EXPECT_FALSE(cache_.find(&zone2_, 0));
+    EXPECT_EQ(finder3_, cache_.find(&zone3_, 0));
+
+    // The removed finder isn't held by the cache any more
+    EXPECT_TRUE(finder2_.unique());
+}
+
+TEST_F(ZoneFinderCacheTest, clear) {
+    cache_.add(&zone1_, 0, finder1_);
+    cache_.clear();
+    EXPECT_FALSE(cache_.find(&zone1_, 0));
+    EXPECT_TRUE(finder1_.unique());
+}
+
+TEST_F(ZoneFinderCacheTest, disabled) {
+    ZoneFinderCache cache(0);
+    cache.add(&zone1_, 0, finder1_);
+    EXPECT_FALSE(cache.find(&zone1_, 0));
+    EXPECT_TRUE(finder1_.unique());
+}
+
+void
+findInThread(ZoneFinderCache* cache, const void* zone, ZoneFinderPtr* result,
+             ZoneFinderPtr finder)
+{
+    *result = cache->find(zone, 0);
+    cache->add(zone, 0, finder);
+}
+
+// Each thread has its own cache, released when the thread exits.
+TEST_F(ZoneFinderCacheTest, perThread) {
+    cache_.add(&zone1_, 0, finder1_);
+
+    ZoneFinderPtr result(finder3_);
+    {
+        Thread thread(boost::bind(findInThread, &cache_, &zone1_, &result,
+                                  finder2_));
+        thread.wait();
+    }
+    EXPECT_FALSE(result);
+    EXPECT_TRUE(finder2_.unique());
+
+    EXPECT_EQ(finder1_, cache_.find(&zone1_, 0));
+}
+
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <datasrc/zone_name_filter.h>
+
+#include <dns/name.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace bundy::dns;
+using namespace bundy::datasrc;
+
+namespace {
+
+class ZoneNameFilterTest : public ::testing::Test {
+protected:
+    ZoneNameFilterTest() : origin_("example.org"), filter_(origin_, 100) {}
+
+    const Name origin_;
+    ZoneNameFilter filter_;
+};
+
+TEST_F(ZoneNameFilterTest, initialState) {
+    EXPECT_TRUE(filter_.isValid());
+    EXPECT_EQ(0, filter_.getSerial());
+    EXPECT_FALSE(filter_.mayExist(origin_));
+    EXPECT_FALSE(filter_.mayExist(Name("www.example.org")));
+}
+
+TEST_F(ZoneNameFilterTest, add) {
+    filter_.add(Name("www.a.b.example.org"));
+
+    // The name and all its superdomains up to the origin exist.
+    EXPECT_TRUE(filter_.mayExist(Name("www.a.b.example.org")));
+    EXPECT_TRUE(filter_.mayExist(Name("a.b.example.org")));
+    EXPECT_TRUE(filter_.mayExist(Name("b.example.org")));
+    EXPECT_TRUE(filter_.mayExist(origin_));
+    // The comparison is case insensitive.
+    EXPECT_TRUE(filter_.mayExist(Name("WWW.A.b.Example.ORG")));
+
+    // Subdomains and siblings don't.
+    EXPECT_FALSE(filter_.mayExist(Name("sub.www.a.b.example.org")));
+    EXPECT_FALSE(filter_.mayExist(Name("www2.a.b.example.org")));
+    EXPECT_FALSE(filter_.mayExist(Name("c.example.org")));
+    // Nor the names above the origin.
+    EXPECT_FALSE(filter_.mayExist(Name("org")));
+}
+
+TEST_F(ZoneNameFilterTest, addOutOfZone) {
+    filter_.add(Name("www.example.com"));
+    EXPECT_FALSE(filter_.mayExist(Name("www.example.com")));
+    EXPECT_FALSE(filter_.mayExist(Name("example.com")));
+    EXPECT_FALSE(filter_.mayExist(origin_));
+}
+
+TEST_F(ZoneNameFilterTest, falsePositiveRate) {
+    for (int i = 0; i < 100; ++i) {
+        std::ostringstream oss;
+        oss << "name" << i << ".example.org";
+        filter_.add(Name(oss.str()));
+    }
+    // All added names must be there, and the number of false positives
+    // should be reasonably small (the filter is sized for about 1%; we
+    // allow some margin).
+    int false_positives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        std::ostringstream oss;
+        oss << "name" << i << ".example.org";
+        if (i < 100) {
+            EXPECT_TRUE(filter_.mayExist(Name(oss.str())));
+        } else if (filter_.mayExist(Name(oss.str()))) {
+            ++false_positives;
+        }
+    }
+    EXPECT_GT(300, false_positives);
+}
+
+TEST_F(ZoneNameFilterTest, size) {
+    // There's a minimum size.
+    EXPECT_EQ(1024, ZoneNameFilter(origin_, 0).getBitCount());
+    EXPECT_EQ(1024, filter_.getBitCount());
+    // Otherwise it's at least 10 bits per name, rounded up to a power of 2.
+    EXPECT_EQ(16384, ZoneNameFilter(origin_, 1000).getBitCount());
+}
+
+TEST_F(ZoneNameFilterTest, serialAndValidity) {
+    filter_.setSerial(1234);
+    EXPECT_EQ(1234, filter_.getSerial());
+    filter_.invalidate();
+    EXPECT_FALSE(filter_.isValid());
+}
+
+TEST_F(ZoneNameFilterTest, clone) {
+    filter_.add(Name("www.example.org"));
+    filter_.setSerial(1234);
+    const ZoneNameFilterPtr copy(filter_.clone());
+    EXPECT_EQ(filter_.getBitCount(), copy->getBitCount());
+    EXPECT_EQ(1234, copy->getSerial());
+    EXPECT_TRUE(copy->isValid());
+    EXPECT_TRUE(copy->mayExist(Name("www.example.org")));
+
+    // The copy is independent from the original.
+    copy->add(Name("mail.example.org"));
+    copy->setSerial(1235);
+    EXPECT_TRUE(copy->mayExist(Name("mail.example.org")));
+    EXPECT_FALSE(filter_.mayExist(Name("mail.example.org")));
+    EXPECT_EQ(1234, filter_.getSerial());
+}
+
+}
@@ -0,0 +1,215 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <datasrc/zone_finder_cache.h>
+
+#include <exceptions/exceptions.h>
+#include <util/threads/sync.h>
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <set>
+#include <vector>
+
+#include <pthread.h>
+
+using bundy::util::thread::Mutex;
+
+namespace bundy {
+namespace datasrc {
+
+namespace {
+// The number of entries a key can be stored in.  Within them, the least
+// recently used one is replaced.
+const size_t WAYS = 4;
+}
+
+class ZoneFinderCache::Impl {
+public:
+    // A cached finder.  Unused entries have a NULL zone.
+    struct Entry {
+        Entry() : zone(NULL), generation(0), last_used(0) {}
+
+        const void* zone;
+        uint64_t generation;
+        ZoneFinderPtr finder;
+        // The value of the use counter of the cache when last used.
+        uint64_t last_used;
+    };
+
+    // The cache of a single thread.  The entries are allocated only once,
+    // so finding and replacing the finders doesn't allocate memory.
+    struct ThreadCache {
+        ThreadCache(Impl* owner) :
+            owner(owner), entries(owner->capacity), use_count(0)
+        {}
+
+        // Return the first of the entries the key can be stored in, and
+        // the number of them.
+        Entry* getSet(const void* zone, uint64_t generation, size_t* ways) {
+            const size_t set_count = (entries.size() + WAYS - 1) / WAYS;
+            size_t hash = reinterpret_cast<size_t>(zone);
+            hash ^= hash >> 7;
+            hash += static_cast<size_t>(generation) * 0x9e3779b9U;
+            const size_t first = (hash % set_count) * WAYS;
+            *ways = std::min(WAYS, entries.size() - first);
+            return (&entries[first]);
+        }
+
+        Entry* find(const void* zone, uint64_t generation) {
+            size_t ways;
+            Entry* const set = getSet(zone, generation, &ways);
+            for (size_t i = 0; i < ways; ++i) {
+                if (set[i].zone == zone && set[i].generation == generation) {
+                    set[i].last_used = ++use_count;
+                    return (&set[i]);
+                }
+            }
+            return (NULL);
+        }
+
+        // Return the entry to store the key to: the one with the same key,
+        // or the least recently used one.
+        Entry& getVictim(const void* zone, uint64_t generation) {
+            size_t ways;
+            Entry* const set = getSet(zone, generation, &ways);
+            Entry* victim = &set[0];
+            for (size_t i = 0; i < ways; ++i) {
+                if (set[i].zone == zone && set[i].generation == generation) {
+                    return (set[i]);
+                }
+                if (set[i].last_used < victim->last_used) {
+                    victim = &set[i];
+                }
+            }
+            return (*victim);
+        }
+
+        Impl* const owner;
+        std::vector<Entry> entries;
+        uint64_t use_count;
+    };
+
+    Impl(size_t capacity) : capacity(capacity) {
+        const int result = pthread_key_create(&key_, &Impl::releaseCache);
+        if (result != 0) {
+            bundy_throw(bundy::InvalidOperation, std::strerror(result));
+        }
+    }
+
+    ~Impl() {
+        // No more releaseCache() calls after this
+        pthread_key_delete(key_);
+        BOOST_FOREACH(ThreadCache* cache, caches_) {
+            delete cache;
+        }
+    }
+
+    // Return the cache of the calling thread, creating it if needed.
+    ThreadCache& getCache() {
+        ThreadCache* cache =
+            static_cast<ThreadCache*>(pthread_getspecific(key_));
+        if (cache == NULL) {
+            cache = new ThreadCache(this);
+            try {
+                Mutex::Locker locker(mutex_);
+                caches_.insert(cache);
+            } catch (...) {
+                delete cache;
+                throw;
+            }
+            if (pthread_setspecific(key_, cache) != 0) {
+                releaseCache(cache);
+                throw std::bad_alloc();
+            }
+        }
+        return (*cache);
+    }
+
+    const size_t capacity;
+
+private:
+    // Called on the exit of a thread that used the cache
+    static void releaseCache(void* cache_ptr) {
+        ThreadCache* cache = static_cast<ThreadCache*>(cache_ptr);
+        {
+            Mutex::Locker locker(cache->owner->mutex_);
+            cache->owner->caches_.erase(cache);
+        }
+        delete cache;
+    }
+
+    pthread_key_t key_;
+    // Protects caches_
+    Mutex mutex_;
+    // The caches of all threads that used this cache
+    std::set<ThreadCache*> caches_;
+};
+
+const size_t ZoneFinderCache::DEFAULT_CAPACITY;
+
+ZoneFinderCache::ZoneFinderCache(size_t capacity) :
+    impl_(new Impl(capacity))
+{}
+
+ZoneFinderCache::~ZoneFinderCache() {}
+
+ZoneFinderPtr
+ZoneFinderCache::find(const void* zone, uint64_t generation) {
+    if (impl_->capacity == 0 || zone == NULL) {
+        return (ZoneFinderPtr());
+    }
+
+    const Impl::Entry* entry = impl_->getCache().find(zone, generation);
+    return (entry != NULL ? entry->finder : ZoneFinderPtr());
+}
+
+void
+ZoneFinderCache::add(const void* zone, uint64_t generation,
+                     const ZoneFinderPtr& finder)
+{
+    if (impl_->capacity == 0 || zone == NULL) {
+        return;
+    }
+
+    Impl::ThreadCache& cache = impl_->getCache();
+    Impl::Entry& entry = cache.getVictim(zone, generation);
+    entry.zone = zone;
+    entry.generation = generation;
+    entry.finder = finder;
+    entry.last_used = ++cache.use_count;
+}
+
+void
+ZoneFinderCache::clear() {
+    if (impl_->capacity == 0) {
+        return;
+    }
+
+    Impl::ThreadCache& cache = impl_->getCache();
+    BOOST_FOREACH(Impl::Entry& entry, cache.entries) {
+        entry = Impl::Entry();
+    }
+}
+
+size_t
+ZoneFinderCache::getCapacity() const {
+    return (impl_->capacity);
+}
+
+} // namespace datasrc
+} // namespace bundy
@@ -0,0 +1,113 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef DATASRC_ZONE_FINDER_CACHE_H
+#define DATASRC_ZONE_FINDER_CACHE_H
+
+#include <datasrc/zone_finder.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace datasrc {
+
+/// \brief A per-thread cache of zone finders.
+///
+/// Data source clients create a new \c ZoneFinder object for each
+/// \c findZone() call, which means one or two memory allocations for each
+/// query.  As most queries are for a small set of zones, a client can keep
+/// the finders it created in this cache and return them again (after
+/// resetting any per-query state) instead of creating new ones.
+///
+/// The finders are identified by a key of a pointer and a generation
+/// number, both defined by the client; the key must change whenever the
+/// finder created for it would be different (e.g., when the zone is
+/// reloaded).
+///
+/// Each thread has its own cache, holding at most the given number of
+/// finders, so a finder is never used by two threads at once and the cache
+/// doesn't need a lock (except when a thread uses the cache for the first
+/// time or exits).  The cache is set associative: a key can be stored in
+/// one of a few entries only, and when they are all used, the least
+/// recently used one of them is replaced.  The cache of a thread is
+/// created on its first use and released when the thread exits; as all
+/// entries are allocated at once, neither finding nor adding finders
+/// allocates memory afterwards.  The cache object itself must not be
+/// destroyed while another thread is using it.
+///
+/// A finder returned from the cache may still be held by the caller of
+/// an earlier \c findZone() in the same thread, so a client may reset its
+/// state only if that doesn't affect the results of the earlier user.
+class ZoneFinderCache : boost::noncopyable {
+public:
+    /// \brief The default number of finders cached for each thread.
+    static const size_t DEFAULT_CAPACITY = 64;
+
+    /// \brief Constructor.
+    ///
+    /// \throw std::bad_alloc memory allocation failed.
+    /// \throw bundy::InvalidOperation thread specific storage can't be
+    ///     created.
+    ///
+    /// \param capacity The maximum number of finders cached for each thread.
+    ///     If it's 0, nothing is cached.
+    explicit ZoneFinderCache(size_t capacity = DEFAULT_CAPACITY);
+
+    /// \brief Destructor.
+    ///
+    /// Releases the caches of all threads.
+    ~ZoneFinderCache();
+
+    /// \brief Return the cached finder for the given key.
+    ///
+    /// If found, the finder becomes the most recently used one of the
+    /// calling thread.  A NULL \c zone is never found.
+    ///
+    /// \throw std::bad_alloc memory allocation failed.
+    ///
+    /// \return The cached finder, or NULL if there's none for the key.
+    ZoneFinderPtr find(const void* zone, uint64_t generation);
+
+    /// \brief Cache a finder for the given key.
+    ///
+    /// Any finder cached for the same key is replaced.  If there's no
+    /// room for the key, the least recently used finder that could be stored
+    /// in the same place is removed.  Nothing is cached for a NULL \c zone.
+    ///
+    /// \throw std::bad_alloc memory allocation failed.
+    void add(const void* zone, uint64_t generation,
+             const ZoneFinderPtr& finder);
+
+    /// \brief Remove all finders cached for the calling thread.
+    void clear();
+
+    /// \brief Return the maximum number of finders cached for each thread.
+    size_t getCapacity() const;
+
+private:
+    class Impl;
+    boost::scoped_ptr<Impl> impl_;
+};
+
+} // namespace datasrc
+} // namespace bundy
+
+#endif // DATASRC_ZONE_FINDER_CACHE_H
+
+// Local Variables:
+// mode: c++
+// End:
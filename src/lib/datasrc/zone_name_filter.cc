@@ -0,0 +1,112 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <datasrc/zone_name_filter.h>
+
+using namespace bundy::dns;
+
+namespace bundy {
+namespace datasrc {
+
+namespace {
+// Number of bits we reserve per expected name, and the number of bits set
+// per name.  10 bits and 7 probes give a false positive rate of roughly 1%.
+const size_t BITS_PER_NAME = 10;
+const unsigned int PROBE_COUNT = 7;
+
+// The minimum size of the filter in bits, so a tiny (or empty) zone still
+// has room for some updates.
+const size_t MIN_BIT_COUNT = 1024;
+
+// Seeds for the two independent hashes of a name.  The probe positions are
+// derived from them using the double hashing technique.
+const unsigned int HASH_SEED1 = 0x5bd1e995;
+const unsigned int HASH_SEED2 = 0x9e3779b9;
+}
+
+ZoneNameFilter::ZoneNameFilter(const Name& origin, size_t expected_names) :
+    origin_(origin), origin_labels_(origin.getLabelCount()),
+    serial_(0), valid_(true)
+{
+    // Use a power of 2 for the bit count so that a probe position can be
+    // calculated with a simple mask.
+    size_t bit_count = MIN_BIT_COUNT;
+    while (bit_count < expected_names * BITS_PER_NAME) {
+        bit_count <<= 1;
+    }
+    bits_.resize(bit_count / 64);
+    mask_ = bit_count - 1;
+}
+
+void
+ZoneNameFilter::getHashes(const LabelSequence& sequence,
+                          size_t& hash1, size_t& hash2) const
+{
+    hash1 = sequence.getFullHash(false, HASH_SEED1);
+    // The step must be odd so the probes cover different bits.
+    hash2 = sequence.getFullHash(false, HASH_SEED2) | 1;
+}
+
+void
+ZoneNameFilter::add(const Name& name) {
+    const NameComparisonResult::NameRelation reln =
+        name.compare(origin_).getRelation();
+    if (reln != NameComparisonResult::SUBDOMAIN &&
+        reln != NameComparisonResult::EQUAL) {
+        return;
+    }
+
+    // Register the name and all its superdomains up to the origin.
+    LabelSequence sequence(name);
+    while (true) {
+        size_t hash1, hash2;
+        getHashes(sequence, hash1, hash2);
+        for (unsigned int i = 0; i < PROBE_COUNT; ++i) {
+            const size_t pos = (hash1 + i * hash2) & mask_;
+            bits_[pos / 64] |= (static_cast<uint64_t>(1) << (pos % 64));
+        }
+        if (sequence.getLabelCount() == origin_labels_) {
+            break;
+        }
+        sequence.stripLeft(1);
+    }
+}
+
+bool
+ZoneNameFilter::mayExist(const Name& name) const {
+    const LabelSequence sequence(name);
+    size_t hash1, hash2;
+    getHashes(sequence, hash1, hash2);
+    for (unsigned int i = 0; i < PROBE_COUNT; ++i) {
+        const size_t pos = (hash1 + i * hash2) & mask_;
+        if ((bits_[pos / 64] & (static_cast<uint64_t>(1) << (pos % 64))) ==
+            0) {
+            return (false);
+        }
+    }
+    return (true);
+}
+
+ZoneNameFilterPtr
+ZoneNameFilter::clone() const {
+    ZoneNameFilterPtr filter(new ZoneNameFilter(origin_, 0));
+    filter->bits_ = bits_;
+    filter->mask_ = mask_;
+    filter->serial_ = serial_;
+    filter->valid_ = valid_;
+    return (filter);
+}
+
+} // namespace datasrc
+} // namespace bundy
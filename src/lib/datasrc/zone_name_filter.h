@@ -0,0 +1,130 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef DATASRC_ZONE_NAME_FILTER_H
+#define DATASRC_ZONE_NAME_FILTER_H
+
+#include <dns/name.h>
+#include <dns/labelsequence.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace datasrc {
+
+class ZoneNameFilter;
+typedef boost::shared_ptr<ZoneNameFilter> ZoneNameFilterPtr;
+typedef boost::shared_ptr<const ZoneNameFilter> ConstZoneNameFilterPtr;
+
+/// \brief Approximate set of the names that exist in a single zone.
+///
+/// This is a Bloom filter over the owner names of a zone.  Every name
+/// between an added name and the zone origin is registered along with the
+/// name itself, so empty non-terminals are considered to exist, too.  As a
+/// result, if \c mayExist() returns false for a name, the zone has no RR
+/// owned by that name or by any name below it.  A true result only means
+/// the name might exist, and the caller has to ask the real data.
+///
+/// Names can only be added.  A name deleted from the zone stays in the
+/// filter as a false positive until the filter is rebuilt, which is
+/// harmless other than for performance.
+///
+/// The filter itself doesn't know whether its content is still in sync
+/// with the zone.  It remembers the SOA serial of the zone at the time the
+/// content was taken (set by the user), and can be marked invalid once the
+/// user finds it outdated.
+///
+/// This class is not thread safe.
+class ZoneNameFilter : boost::noncopyable {
+public:
+    /// \brief Constructor.
+    ///
+    /// The filter is sized so that the false positive rate stays around
+    /// 1% as long as no more than \c expected_names distinct names
+    /// (including the implicitly added superdomains) are added.
+    ///
+    /// \throw std::bad_alloc Memory allocation fails.
+    ///
+    /// \param origin The origin name of the zone.
+    /// \param expected_names The expected number of distinct names.
+    ZoneNameFilter(const bundy::dns::Name& origin, size_t expected_names);
+
+    /// \brief Register a name (and its superdomains) as existent.
+    ///
+    /// Names that are not a subdomain of (or equal to) the origin are
+    /// silently ignored.
+    ///
+    /// \throw None
+    void add(const bundy::dns::Name& name);
+
+    /// \brief Check if the given name may exist in the zone.
+    ///
+    /// \throw None
+    /// \return false if the name definitely doesn't exist (nor does any
+    /// name below it), true otherwise.
+    bool mayExist(const bundy::dns::Name& name) const;
+
+    /// \brief Return the SOA serial the filter content corresponds to.
+    uint32_t getSerial() const { return (serial_); }
+
+    /// \brief Set the SOA serial the filter content corresponds to.
+    void setSerial(uint32_t serial) { serial_ = serial; }
+
+    /// \brief Return if the filter can still be trusted.
+    bool isValid() const { return (valid_); }
+
+    /// \brief Mark the filter as outdated.
+    ///
+    /// Once invalidated, the filter can't be made valid again; a new one
+    /// has to be built instead.
+    void invalidate() { valid_ = false; }
+
+    /// \brief Return a copy of the filter.
+    ///
+    /// A filter shared between threads must not be modified; to update it,
+    /// modify a copy and replace the shared one with it.
+    ///
+    /// \throw std::bad_alloc Memory allocation fails.
+    ZoneNameFilterPtr clone() const;
+
+    /// \brief Return the number of bits of the filter.
+    ///
+    /// This is mainly for testing purposes.
+    size_t getBitCount() const { return (bits_.size() * 64); }
+
+private:
+    void getHashes(const bundy::dns::LabelSequence& sequence,
+                   size_t& hash1, size_t& hash2) const;
+
+    const bundy::dns::Name origin_;
+    const size_t origin_labels_;
+    std::vector<uint64_t> bits_;
+    size_t mask_;
+    uint32_t serial_;
+    bool valid_;
+};
+
+} // namespace datasrc
+} // namespace bundy
+
+#endif  // DATASRC_ZONE_NAME_FILTER_H
+
+// Local Variables:
+// mode: c++
+// End:
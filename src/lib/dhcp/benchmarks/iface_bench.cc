@@ -0,0 +1,290 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/dhcp4.h>
+#include <dhcp/iface_mgr.h>
+#include <dhcp/pkt4.h>
+#include <dhcp/pkt_filter_inet.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+
+// Sends DHCPDISCOVERs to the sockets of the interfaces in turn, as relays
+// on many VLANs would.
+class Sender {
+public:
+    Sender(const vector<uint16_t>& ports) : fd_(-1), next_(0) {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd_ < 0) {
+            std::cerr << "unable to open the sending socket" << std::endl;
+            exit(1);
+        }
+        for (size_t i = 0; i < ports.size(); ++i) {
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(ports[i]);
+            destinations_.push_back(addr);
+        }
+
+        Pkt4 discover(DHCPDISCOVER, 1234);
+        const uint8_t hwaddr[] = { 0, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe };
+        discover.setHWAddr(HTYPE_ETHER, sizeof(hwaddr),
+                           vector<uint8_t>(hwaddr, hwaddr + sizeof(hwaddr)));
+        discover.pack();
+        const uint8_t* data =
+            static_cast<const uint8_t*>(discover.getBuffer().getData());
+        packet_.assign(data, data + discover.getBuffer().getLength());
+    }
+    ~Sender() {
+        close(fd_);
+    }
+    void send(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const struct sockaddr_in& addr = destinations_[next_];
+            next_ = (next_ + 1) % destinations_.size();
+            if (sendto(fd_, &packet_[0], packet_.size(), 0,
+                       reinterpret_cast<const struct sockaddr*>(&addr),
+                       sizeof(addr)) < 0) {
+                std::cerr << "unable to send: " << strerror(errno)
+                          << std::endl;
+                exit(1);
+            }
+        }
+    }
+private:
+    int fd_;
+    vector<struct sockaddr_in> destinations_;
+    size_t next_;
+    vector<uint8_t> packet_;
+};
+
+// How the packets are received.
+enum Method {
+    METHOD_SELECT,              // select() over all the sockets, for each
+                                // packet (what IfaceMgr::receive4 did)
+    METHOD_RECEIVE,             // IfaceMgr::receive4
+    METHOD_RECEIVE_BATCH        // IfaceMgr::receiveBatch4
+};
+
+// Maximum number of packets received at once, as in the servers.
+const size_t BATCH_SIZE = 64;
+
+// Send a burst of packets spread over the interfaces and receive them.
+class ReceiveBenchMark {
+public:
+    ReceiveBenchMark(Sender& sender, Method method, size_t burst) :
+        sender_(sender), method_(method), burst_(burst),
+        filter_(new PktFilterInet())
+    {}
+    unsigned int run() {
+        sender_.send(burst_);
+        size_t received = 0;
+        while (received < burst_) {
+            const size_t count = receive();
+            if (count == 0) {
+                // Timed out: the other packets were dropped.
+                break;
+            }
+            received += count;
+        }
+        return (received);
+    }
+private:
+    size_t receive() {
+        if (method_ == METHOD_RECEIVE) {
+            return (IfaceMgr::instance().receive4(1) ? 1 : 0);
+        } else if (method_ == METHOD_RECEIVE_BATCH) {
+            pkts_.clear();
+            return (IfaceMgr::instance().receiveBatch4(pkts_, BATCH_SIZE, 1));
+        }
+
+        // Build the set of all the sockets and wait, then look for the
+        // first ready socket.
+        const IfaceMgr::IfaceCollection& ifaces =
+            IfaceMgr::instance().getIfaces();
+        fd_set sockets;
+        FD_ZERO(&sockets);
+        int maxfd = 0;
+        for (IfaceMgr::IfaceCollection::const_iterator iface = ifaces.begin();
+             iface != ifaces.end(); ++iface) {
+            const Iface::SocketCollection& socks = iface->getSockets();
+            for (Iface::SocketCollection::const_iterator s = socks.begin();
+                 s != socks.end(); ++s) {
+                FD_SET(s->sockfd_, &sockets);
+                if (maxfd < s->sockfd_) {
+                    maxfd = s->sockfd_;
+                }
+            }
+        }
+        struct timeval timeout;
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+        if (select(maxfd + 1, &sockets, NULL, NULL, &timeout) <= 0) {
+            return (0);
+        }
+        for (IfaceMgr::IfaceCollection::const_iterator iface = ifaces.begin();
+             iface != ifaces.end(); ++iface) {
+            const Iface::SocketCollection& socks = iface->getSockets();
+            for (Iface::SocketCollection::const_iterator s = socks.begin();
+                 s != socks.end(); ++s) {
+                if (FD_ISSET(s->sockfd_, &sockets)) {
+                    return (filter_->receive(*iface, *s) ? 1 : 0);
+                }
+            }
+        }
+        return (0);
+    }
+
+    Sender& sender_;
+    const Method method_;
+    const size_t burst_;
+    vector<Pkt4Ptr> pkts_;
+    boost::shared_ptr<PktFilterInet> filter_;
+};
+
+// Replace the interfaces of the interface manager by the given number of
+// interfaces on the loopback, with a socket each, and return the ports of
+// the sockets.  Also return the highest socket descriptor.
+vector<uint16_t>
+openSockets(size_t count, int& maxfd) {
+    int index = if_nametoindex("lo");
+    if (index == 0) {
+        index = if_nametoindex("lo0");
+    }
+    if (index == 0) {
+        std::cerr << "no loopback interface" << std::endl;
+        exit(1);
+    }
+
+    IfaceMgr& iface_mgr = IfaceMgr::instance();
+    iface_mgr.closeSockets();
+    iface_mgr.clearIfaces();
+    vector<uint16_t> ports;
+    maxfd = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const string name = "vlan" + boost::lexical_cast<string>(i);
+        Iface iface(name, index);
+        iface.addAddress(IOAddress("127.0.0.1"));
+        iface_mgr.addInterface(iface);
+
+        // Let the system choose the port.
+        const int fd = iface_mgr.openSocket(name, IOAddress("127.0.0.1"), 0);
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                        &len) < 0) {
+            std::cerr << "unable to get the port of a socket" << std::endl;
+            exit(1);
+        }
+        ports.push_back(ntohs(addr.sin_port));
+        if (maxfd < fd) {
+            maxfd = fd;
+        }
+    }
+    return (ports);
+}
+
+void
+usage() {
+    std::cerr << "Usage: iface_bench [-n iterations] [-i interfaces] "
+        "[-b burst]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1000;
+    size_t iface_count = 256;
+    size_t burst = 64;
+    while ((ch = getopt(argc, argv, "n:i:b:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'i':
+            iface_count = atoi(optarg);
+            break;
+        case 'b':
+            burst = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || iface_count == 0 || burst == 0) {
+        usage();
+    }
+
+    int maxfd;
+    Sender sender(openSockets(iface_count, maxfd));
+
+    std::cout << "Benchmark for receiving bursts of " << burst
+              << " DHCPv4 packets on " << iface_count << " interfaces"
+              << std::endl;
+    if (maxfd < FD_SETSIZE) {
+        std::cout << "select() over all the sockets for each packet"
+                  << std::endl;
+        BenchMark<ReceiveBenchMark>(iteration,
+                                    ReceiveBenchMark(sender, METHOD_SELECT,
+                                                     burst));
+    } else {
+        std::cout << "select() can't wait for socket " << maxfd
+                  << " (FD_SETSIZE is " << FD_SETSIZE << ")" << std::endl;
+    }
+
+    std::cout << "IfaceMgr::receive4" << std::endl;
+    BenchMark<ReceiveBenchMark>(iteration,
+                                ReceiveBenchMark(sender, METHOD_RECEIVE,
+                                                 burst));
+
+    std::cout << "IfaceMgr::receiveBatch4 (" << BATCH_SIZE << " packets)"
+              << std::endl;
+    BenchMark<ReceiveBenchMark>(iteration,
+                                ReceiveBenchMark(sender,
+                                                 METHOD_RECEIVE_BATCH,
+                                                 burst));
+
+    IfaceMgr::instance().closeSockets();
+    return (0);
+}
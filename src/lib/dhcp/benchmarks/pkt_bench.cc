@@ -0,0 +1,179 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <dhcp/dhcp4.h>
+#include <dhcp/pkt4.h>
+#include <util/encode/hex.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+
+// DHCPDISCOVER messages of a DOCSIS cable modem and of its eRouter, relayed
+// by the CMTS (packets 1 and 5 of the capture
+// docsis-*-CG3000DCR-Registration-Filtered.cap, see the DHCPv4 server
+// tests).  Besides the message type, client identifier and parameter
+// request list, they hold a vendor class, V-I vendor-specific information
+// with the 117 bytes of the modem capabilities, CableLabs vendor-specific
+// information, a maximum message size, a domain name and relay agent
+// information.
+const char* const CAPTURES[] = {
+    "010106015d05478d000000000000000000000000000000000afee20120e52ab8151400"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000638253633501013707"
+    "0102030407067d3c0a646f63736973332e303a7d7f0000118b7a010102057501010102"
+    "010303010104010105010106010107010f0801100901030a01010b01180c01010d0200"
+    "400e0200100f010110040000000211010014010015013f160101170101180104190104"
+    "1a01041b01201c01021d01081e01201f01102001102101022201012301002401002501"
+    "01260200ff2701012b59020345434d030b45434d3a45524f55544552040d3242523232"
+    "39553430303434430504312e3034060856312e33332e30330707322e332e3052320806"
+    "30303039354209094347333030304443520a074e657467656172fe01083d0fff2ab815"
+    "140003000120e52ab81514390205dc5219010420000002020620e52ab8151409090000"
+    "118b0401020300ff",
+    "010106015d05478f000500000000000000000000000000000afee20120e52ab8151500"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000063825363350101370e"
+    "480102030406070c0f171a36337a2b63020745524f55544552030b45434d3a45524f55"
+    "544552040d324252323239553430303434430504312e3034060856312e33332e303307"
+    "07322e332e305232080630303039354209094347333030304443520a074e6574676561"
+    "720f0745524f555445523c0a65526f75746572312e300f14687364312e70612e636f6d"
+    "636173742e6e65742e3d0fff2ab815150003000120e52ab81515390205dc5219010420"
+    "000002020620e52ab8151409090000118b0401020300ff"
+};
+
+// The options the server looks for in a DHCPDISCOVER (the message type is
+// looked for by Pkt4::unpack).
+const uint8_t SERVER_OPTIONS[] = {
+    DHO_DHCP_CLIENT_IDENTIFIER, DHO_DHCP_AGENT_OPTIONS,
+    DHO_VENDOR_CLASS_IDENTIFIER, DHO_DHCP_PARAMETER_REQUEST_LIST,
+    DHO_VIVSO_SUBOPTIONS, DHO_FQDN, DHO_HOST_NAME,
+    DHO_DHCP_REQUESTED_ADDRESS, DHO_DHCP_SERVER_IDENTIFIER
+};
+
+// Which options are requested after unpacking.
+enum Requested {
+    REQUESTED_NONE,             // only the message type
+    REQUESTED_SERVER,           // those the server looks for
+    REQUESTED_ALL               // all of them (e.g. to log the packet)
+};
+
+// Create a packet from each of the received data and unpack it, then
+// request options from it.
+class UnpackBenchMark {
+public:
+    UnpackBenchMark(const vector<vector<uint8_t> >& packets,
+                    bool lazy_unpack, Requested requested) :
+        packets_(packets), lazy_unpack_(lazy_unpack), requested_(requested)
+    {}
+    unsigned int run() {
+        vector<vector<uint8_t> >::const_iterator it;
+        for (it = packets_.begin(); it != packets_.end(); ++it) {
+            Pkt4 pkt(&(*it)[0], it->size());
+            pkt.setLazyUnpack(lazy_unpack_);
+            pkt.unpack();
+            if (requested_ == REQUESTED_SERVER) {
+                for (size_t i = 0; i < sizeof(SERVER_OPTIONS); ++i) {
+                    pkt.getOption(SERVER_OPTIONS[i]);
+                }
+            } else if (requested_ == REQUESTED_ALL) {
+                pkt.len();
+            }
+        }
+        return (packets_.size());
+    }
+private:
+    const vector<vector<uint8_t> >& packets_;
+    const bool lazy_unpack_;
+    const Requested requested_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: pkt_bench [-n iterations] [-p packets]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t packet_count = 10000;
+    while ((ch = getopt(argc, argv, "n:p:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'p':
+            packet_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || packet_count == 0) {
+        usage();
+    }
+
+    // The captured packets alternate.
+    const size_t capture_count = sizeof(CAPTURES) / sizeof(CAPTURES[0]);
+    vector<vector<uint8_t> > packets(packet_count);
+    for (size_t i = 0; i < packet_count; ++i) {
+        bundy::util::encode::decodeHex(CAPTURES[i % capture_count],
+                                       packets[i]);
+    }
+
+    const Requested requested[] = {
+        REQUESTED_NONE, REQUESTED_SERVER, REQUESTED_ALL
+    };
+    const char* const requested_names[] = {
+        "no option", "the options used by the server", "all the options"
+    };
+    for (size_t i = 0; i < sizeof(requested) / sizeof(requested[0]); ++i) {
+        std::cout << "Benchmark for unpacking DOCSIS packets, "
+                  << requested_names[i] << " requested" << std::endl;
+        BenchMark<UnpackBenchMark>(iteration,
+                                   UnpackBenchMark(packets, false,
+                                                   requested[i]));
+
+        std::cout << "Benchmark for lazily unpacking DOCSIS packets, "
+                  << requested_names[i] << " requested" << std::endl;
+        BenchMark<UnpackBenchMark>(iteration,
+                                   UnpackBenchMark(packets, true,
+                                                   requested[i]));
+    }
+
+    return (0);
+}
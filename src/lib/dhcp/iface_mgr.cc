@@ -34,9 +34,9 @@
 #include <sstream>
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <string.h>
-#include <sys/select.h>
 
 using namespace std;
 using namespace bundy::asiolink;
@@ -45,6 +45,16 @@ using namespace bundy::util::io::internal;
 namespace bundy {
 namespace dhcp {
 
+namespace {
+
+/// Incremented whenever a socket is added to or removed from an interface,
+/// an interface is destroyed or an external socket is registered or
+/// removed. The IfaceMgr rebuilds the sets of the sockets it waits for
+/// when it changes.
+unsigned int sockets_generation = 1;
+
+}
+
 IfaceMgr&
 IfaceMgr::instance() {
     static IfaceMgr iface_mgr;
@@ -60,6 +70,16 @@ Iface::Iface(const std::string& name, int ifindex)
     memset(mac_, 0, sizeof(mac_));
 }
 
+Iface::~Iface() {
+    ++sockets_generation;
+}
+
+void
+Iface::addSocket(const SocketInfo& sock) {
+    sockets_.push_back(sock);
+    ++sockets_generation;
+}
+
 void
 Iface::closeSockets() {
     // Close IPv4 sockets.
@@ -96,6 +116,7 @@ Iface::closeSockets(const uint16_t family) {
                 close(sock->fallbackfd_);
             }
             sockets_.erase(sock++);
+            ++sockets_generation;
 
         } else {
             // Different type of socket. Let's move
@@ -160,6 +181,7 @@ bool Iface::delSocket(const uint16_t sockfd) {
                 close(sock->fallbackfd_);
             }
             sockets_.erase(sock);
+            ++sockets_generation;
             return (true); //socket found
         }
         ++sock;
@@ -262,6 +284,7 @@ IfaceMgr::addExternalSocket(int socketfd, SocketCallback callback) {
     x.socket_ = socketfd;
     x.callback_ = callback;
     callbacks_.push_back(x);
+    ++sockets_generation;
 }
 
 void
@@ -270,6 +293,7 @@ IfaceMgr::deleteExternalSocket(int socketfd) {
          s != callbacks_.end(); ++s) {
         if (s->socket_ == socketfd) {
             callbacks_.erase(s);
+            ++sockets_generation;
             return;
         }
     }
@@ -826,69 +850,84 @@ IfaceMgr::send(const Pkt4Ptr& pkt) {
 }
 
 
-boost::shared_ptr<Pkt4>
-IfaceMgr::receive4(uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */) {
-    // Sanity check for microsecond timeout.
-    if (timeout_usec >= 1000000) {
-        bundy_throw(BadValue, "fractional timeout must be shorter than"
-                  " one million microseconds");
+void
+IfaceMgr::updatePollSet(const uint16_t family, PollSet& poll_set) {
+    if (poll_set.generation_ == sockets_generation) {
+        return;
     }
-    const SocketInfo* candidate = 0;
-    IfaceCollection::const_iterator iface;
-    fd_set sockets;
-    int maxfd = 0;
-
-    FD_ZERO(&sockets);
-
-    /// @todo: marginal performance optimization. We could create the set once
-    /// and then use its copy for select(). Please note that select() modifies
-    /// provided set to indicated which sockets have something to read.
-    for (iface = ifaces_.begin(); iface != ifaces_.end(); ++iface) {
 
-        const Iface::SocketCollection& socket_collection = iface->getSockets();
-        for (Iface::SocketCollection::const_iterator s = socket_collection.begin();
-             s != socket_collection.end(); ++s) {
-
-            // Only deal with IPv4 addresses.
-            if (s->addr_.isV4()) {
-
-                // Add this socket to listening set
-                FD_SET(s->sockfd_, &sockets);
-                if (maxfd < s->sockfd_) {
-                    maxfd = s->sockfd_;
+    poll_set.poller_.clear();
+    poll_set.entries_.clear();
+    try {
+        for (IfaceCollection::iterator iface = ifaces_.begin();
+             iface != ifaces_.end(); ++iface) {
+            const Iface::SocketCollection& socket_collection =
+                iface->getSockets();
+            for (Iface::SocketCollection::const_iterator s =
+                     socket_collection.begin();
+                 s != socket_collection.end(); ++s) {
+                // Only deal with the addresses of the family.
+                if ((family == AF_INET && s->addr_.isV4()) ||
+                    (family == AF_INET6 && s->addr_.isV6())) {
+                    const PollEntry entry = { &(*iface), &(*s), NULL };
+                    poll_set.poller_.add(s->sockfd_, poll_set.entries_.size());
+                    poll_set.entries_.push_back(entry);
                 }
             }
         }
-    }
 
-    // if there are any callbacks for external sockets registered...
-    if (!callbacks_.empty()) {
         for (SocketCallbackInfoContainer::const_iterator s = callbacks_.begin();
              s != callbacks_.end(); ++s) {
-            FD_SET(s->socket_, &sockets);
-            if (maxfd < s->socket_) {
-                maxfd = s->socket_;
-            }
+            const PollEntry entry = { NULL, NULL, &(*s) };
+            poll_set.poller_.add(s->socket_, poll_set.entries_.size());
+            poll_set.entries_.push_back(entry);
         }
+    } catch (const std::exception& ex) {
+        // The set is rebuilt on the next attempt.
+        bundy_throw(SocketReadError, ex.what());
     }
 
-    struct timeval select_timeout;
-    select_timeout.tv_sec = timeout_sec;
-    select_timeout.tv_usec = timeout_usec;
+    poll_set.generation_ = sockets_generation;
+}
 
-    int result = select(maxfd + 1, &sockets, NULL, NULL, &select_timeout);
+bool
+IfaceMgr::waitForData(const uint16_t family, uint32_t timeout_sec,
+                      uint32_t timeout_usec) {
+    // Sanity check for microsecond timeout.
+    if (timeout_usec >= 1000000) {
+        bundy_throw(BadValue, "fractional timeout must be shorter than"
+                  " one million microseconds");
+    }
+
+    PollSet& poll_set = (family == AF_INET ? poll4_ : poll6_);
+    updatePollSet(family, poll_set);
 
+    const int result = poll_set.poller_.wait(timeout_sec, timeout_usec,
+                                             ready_);
     if (result == 0) {
-        // nothing received and timeout has been reached
-        return (Pkt4Ptr()); // NULL
+        // Nothing received and timeout has been reached. A descriptor
+        // closed behind our back is silently removed from the set by the
+        // kernel, so check that they are still valid, which select()
+        // did on every call. This is cheap, as there is no traffic.
+        for (std::vector<PollEntry>::const_iterator entry =
+                 poll_set.entries_.begin();
+             entry != poll_set.entries_.end(); ++entry) {
+            const int fd = (entry->socket_ != NULL ? entry->socket_->sockfd_ :
+                            entry->callback_->socket_);
+            if (fcntl(fd, F_GETFD) < 0) {
+                bundy_throw(SocketReadError, strerror(errno));
+            }
+        }
+        return (false);
     } else if (result < 0) {
         bundy_throw(SocketReadError, strerror(errno));
     }
 
-    // Let's find out which socket has the data
-    for (SocketCallbackInfoContainer::iterator s = callbacks_.begin();
-         s != callbacks_.end(); ++s) {
-        if (!FD_ISSET(s->socket_, &sockets)) {
+    // Let's find out if any external socket has the data
+    for (std::vector<size_t>::const_iterator i = ready_.begin();
+         i != ready_.end(); ++i) {
+        const PollEntry& entry = poll_set.entries_[*i];
+        if (entry.callback_ == NULL) {
             continue;
         }
 
@@ -897,136 +936,71 @@ IfaceMgr::receive4(uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */) {
         // Calling the external socket's callback provides its service
         // layer access without integrating any specific features
         // in IfaceMgr
-        if (s->callback_) {
-            s->callback_();
+        if (entry.callback_->callback_) {
+            entry.callback_->callback_();
         }
 
-        return (Pkt4Ptr());
+        return (false);
     }
 
-    // Let's find out which interface/socket has the data
-    for (iface = ifaces_.begin(); iface != ifaces_.end(); ++iface) {
-        const Iface::SocketCollection& socket_collection = iface->getSockets();
-        for (Iface::SocketCollection::const_iterator s = socket_collection.begin();
-             s != socket_collection.end(); ++s) {
-            if (FD_ISSET(s->sockfd_, &sockets)) {
-                candidate = &(*s);
-                break;
-            }
-        }
-        if (candidate) {
-            break;
-        }
-    }
+    return (true);
+}
 
-    if (!candidate) {
-        bundy_throw(SocketReadError, "received data over unknown socket");
+boost::shared_ptr<Pkt4>
+IfaceMgr::receive4(uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */) {
+    if (!waitForData(AF_INET, timeout_sec, timeout_usec)) {
+        return (Pkt4Ptr()); // NULL
     }
 
     // Now we have a socket, let's get some data from it!
     // Assuming that packet filter is not NULL, because its modifier checks it.
-    return (packet_filter_->receive(*iface, *candidate));
+    const PollEntry& entry = poll4_.entries_[ready_.front()];
+    return (packet_filter_->receive(*entry.iface_, *entry.socket_));
 }
 
-Pkt6Ptr IfaceMgr::receive6(uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */ ) {
-    // Sanity check for microsecond timeout.
-    if (timeout_usec >= 1000000) {
-        bundy_throw(BadValue, "fractional timeout must be shorter than"
-                  " one million microseconds");
+size_t
+IfaceMgr::receiveBatch4(std::vector<Pkt4Ptr>& pkts, size_t max_count,
+                        uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */) {
+    if (!waitForData(AF_INET, timeout_sec, timeout_usec)) {
+        return (0);
     }
 
-    const SocketInfo* candidate = 0;
-    fd_set sockets;
-    int maxfd = 0;
-
-    FD_ZERO(&sockets);
-
-    /// @todo: marginal performance optimization. We could create the set once
-    /// and then use its copy for select(). Please note that select() modifies
-    /// provided set to indicated which sockets have something to read.
-    IfaceCollection::const_iterator iface;
-    for (iface = ifaces_.begin(); iface != ifaces_.end(); ++iface) {
-        const Iface::SocketCollection& socket_collection = iface->getSockets();
-        for (Iface::SocketCollection::const_iterator s = socket_collection.begin();
-             s != socket_collection.end(); ++s) {
-
-            // Only deal with IPv6 addresses.
-            if (s->addr_.isV6()) {
-
-                // Add this socket to listening set
-                FD_SET(s->sockfd_, &sockets);
-                if (maxfd < s->sockfd_) {
-                    maxfd = s->sockfd_;
-                }
-            }
-        }
+    size_t received = 0;
+    for (std::vector<size_t>::const_iterator i = ready_.begin();
+         i != ready_.end() && received < max_count; ++i) {
+        const PollEntry& entry = poll4_.entries_[*i];
+        received += packet_filter_->receiveBatch(*entry.iface_,
+                                                 *entry.socket_,
+                                                 max_count - received, pkts);
     }
+    return (received);
+}
 
-    // if there are any callbacks for external sockets registered...
-    if (!callbacks_.empty()) {
-        for (SocketCallbackInfoContainer::const_iterator s = callbacks_.begin();
-             s != callbacks_.end(); ++s) {
-
-            // Add it to the set as well
-            FD_SET(s->socket_, &sockets);
-            if (maxfd < s->socket_) {
-                maxfd = s->socket_;
-            }
-        }
-    }
-
-    struct timeval select_timeout;
-    select_timeout.tv_sec = timeout_sec;
-    select_timeout.tv_usec = timeout_usec;
-
-    int result = select(maxfd + 1, &sockets, NULL, NULL, &select_timeout);
-
-    if (result == 0) {
-        // nothing received and timeout has been reached
+Pkt6Ptr IfaceMgr::receive6(uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */ ) {
+    if (!waitForData(AF_INET6, timeout_sec, timeout_usec)) {
         return (Pkt6Ptr()); // NULL
-    } else if (result < 0) {
-        bundy_throw(SocketReadError, strerror(errno));
     }
 
-    // Let's find out which socket has the data
-    for (SocketCallbackInfoContainer::iterator s = callbacks_.begin();
-         s != callbacks_.end(); ++s) {
-        if (!FD_ISSET(s->socket_, &sockets)) {
-            continue;
-        }
-
-        // something received over external socket
-
-        // Calling the external socket's callback provides its service
-        // layer access without integrating any specific features
-        // in IfaceMgr
-        if (s->callback_) {
-            s->callback_();
-        }
-
-        return (Pkt6Ptr());
-    }
+    // Assuming that packet filter is not NULL, because its modifier checks it.
+    const PollEntry& entry = poll6_.entries_[ready_.front()];
+    return (packet_filter6_->receive(*entry.socket_));
+}
 
-    // Let's find out which interface/socket has the data
-    for (iface = ifaces_.begin(); iface != ifaces_.end(); ++iface) {
-        const Iface::SocketCollection& socket_collection = iface->getSockets();
-        for (Iface::SocketCollection::const_iterator s = socket_collection.begin();
-             s != socket_collection.end(); ++s) {
-            if (FD_ISSET(s->sockfd_, &sockets)) {
-                candidate = &(*s);
-                break;
-            }
-        }
-        if (candidate) {
-            break;
-        }
+size_t
+IfaceMgr::receiveBatch6(std::vector<Pkt6Ptr>& pkts, size_t max_count,
+                        uint32_t timeout_sec, uint32_t timeout_usec /* = 0 */) {
+    if (!waitForData(AF_INET6, timeout_sec, timeout_usec)) {
+        return (0);
     }
 
-    if (!candidate) {
-        bundy_throw(SocketReadError, "received data over unknown socket");
+    size_t received = 0;
+    for (std::vector<size_t>::const_iterator i = ready_.begin();
+         i != ready_.end() && received < max_count; ++i) {
+        const PollEntry& entry = poll6_.entries_[*i];
+        received += packet_filter6_->receiveBatch(*entry.socket_,
+                                                  max_count - received, pkts);
     }
-    // Assuming that packet filter is not NULL, because its modifier checks it.
-    return (packet_filter6_->receive(*candidate));
+    return (received);
 }
 
 uint16_t IfaceMgr::getSocket(const bundy::dhcp::Pkt6& pkt) {
@@ -22,6 +22,7 @@
 #include <dhcp/pkt6.h>
 #include <dhcp/pkt_filter.h>
 #include <dhcp/pkt_filter6.h>
+#include <dhcp/socket_poller.h>
 
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
@@ -29,6 +30,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include <list>
+#include <vector>
 
 namespace bundy {
 
@@ -154,6 +156,12 @@ public:
     /// @param ifindex interface index (unique integer identifier)
     Iface(const std::string& name, int ifindex);
 
+    /// @brief Iface destructor.
+    ///
+    /// It doesn't close the sockets, but it lets the @c IfaceMgr know
+    /// that they can't be used through this object anymore.
+    ~Iface();
+
     /// @brief Closes all open sockets on interface.
     void closeSockets();
 
@@ -281,9 +289,7 @@ public:
     /// @brief Adds socket descriptor to an interface.
     ///
     /// @param sock SocketInfo structure that describes socket.
-    void addSocket(const SocketInfo& sock) {
-        sockets_.push_back(sock);
-    }
+    void addSocket(const SocketInfo& sock);
 
     /// @brief Closes socket.
     ///
@@ -557,9 +563,8 @@ public:
     /// If reception is successful and all information about its sender
     /// are obtained, Pkt6 object is created and returned.
     ///
-    /// TODO Start using select() and add timeout to be able
-    /// to not wait infinitely, but rather do something useful
-    /// (e.g. remove expired leases)
+    /// If data arrives over an external socket first, its callback is
+    /// called and NULL is returned.
     ///
     /// @param timeout_sec specifies integral part of the timeout (in seconds)
     /// @param timeout_usec specifies fractional part of the timeout
@@ -570,6 +575,31 @@ public:
     /// @return Pkt6 object representing received packet (or NULL)
     Pkt6Ptr receive6(uint32_t timeout_sec, uint32_t timeout_usec = 0);
 
+    /// @brief Tries to receive IPv6 packets over open IPv6 sockets.
+    ///
+    /// Waits for the IPv6 sockets to become readable, like @c receive6,
+    /// and then receives the packets already queued on all the readable
+    /// sockets, up to the specified count. Where the packet filter
+    /// supports it, the packets of a socket are received with a single
+    /// system call. This reduces the per-packet overhead when the server
+    /// is busy.
+    ///
+    /// If data arrives over an external socket first, its callback is
+    /// called and no packets are received.
+    ///
+    /// @param [out] pkts the received packets are appended to it.
+    /// @param max_count maximum number of packets to receive.
+    /// @param timeout_sec specifies integral part of the timeout (in seconds)
+    /// @param timeout_usec specifies fractional part of the timeout
+    /// (in microseconds)
+    ///
+    /// @throw bundy::BadValue if timeout_usec is greater than one million
+    /// @throw bundy::dhcp::SocketReadError if error occured when receiving
+    /// packets. The packets received before the error remain in pkts.
+    /// @return number of the packets appended to pkts, 0 on timeout.
+    size_t receiveBatch6(std::vector<Pkt6Ptr>& pkts, size_t max_count,
+                         uint32_t timeout_sec, uint32_t timeout_usec = 0);
+
     /// @brief Tries to receive IPv4 packet over open IPv4 sockets.
     ///
     /// Attempts to receive a single IPv4 packet of any of the open IPv4 sockets.
@@ -585,6 +615,31 @@ public:
     /// @return Pkt4 object representing received packet (or NULL)
     Pkt4Ptr receive4(uint32_t timeout_sec, uint32_t timeout_usec = 0);
 
+    /// @brief Tries to receive IPv4 packets over open IPv4 sockets.
+    ///
+    /// Waits for the IPv4 sockets to become readable, like @c receive4,
+    /// and then receives the packets already queued on all the readable
+    /// sockets, up to the specified count. Where the packet filter
+    /// supports it, the packets of a socket are received with a single
+    /// system call. This reduces the per-packet overhead when the server
+    /// is busy.
+    ///
+    /// If data arrives over an external socket first, its callback is
+    /// called and no packets are received.
+    ///
+    /// @param [out] pkts the received packets are appended to it.
+    /// @param max_count maximum number of packets to receive.
+    /// @param timeout_sec specifies integral part of the timeout (in seconds)
+    /// @param timeout_usec specifies fractional part of the timeout
+    /// (in microseconds)
+    ///
+    /// @throw bundy::BadValue if timeout_usec is greater than one million
+    /// @throw bundy::dhcp::SocketReadError if error occured when receiving
+    /// packets. The packets received before the error remain in pkts.
+    /// @return number of the packets appended to pkts, 0 on timeout.
+    size_t receiveBatch4(std::vector<Pkt4Ptr>& pkts, size_t max_count,
+                         uint32_t timeout_sec, uint32_t timeout_usec = 0);
+
     /// Opens UDP/IP socket and binds it to address, interface and port.
     ///
     /// Specific type of socket (UDP/IPv4 or UDP/IPv6) depends on passed addr
@@ -999,6 +1054,57 @@ protected:
     bool os_receive4(struct msghdr& m, Pkt4Ptr& pkt);
 
 private:
+    /// @brief A descriptor the IfaceMgr waits for data on.
+    struct PollEntry {
+        /// Interface of the socket, NULL for an external socket.
+        Iface* iface_;
+        /// The socket on iface_, NULL for an external socket.
+        const SocketInfo* socket_;
+        /// The external socket, NULL for a socket on an interface.
+        const SocketCallbackInfo* callback_;
+    };
+
+    /// @brief The descriptors the IfaceMgr waits for data on when
+    /// receiving packets of one family.
+    ///
+    /// The set is kept between the receive calls and is rebuilt only
+    /// when sockets are opened or closed.
+    struct PollSet {
+        PollSet() : generation_(0) {}
+
+        /// Waits for data on the descriptors. The tags are the indexes
+        /// to entries_.
+        SocketPoller poller_;
+        /// The descriptors of the set.
+        std::vector<PollEntry> entries_;
+        /// Socket generation the set was built for.
+        unsigned int generation_;
+    };
+
+    /// @brief Waits for data on the sockets of the family.
+    ///
+    /// On return ready_ holds the indexes of the ready entries of the
+    /// poll set of the family. If data arrived over an external socket,
+    /// its callback is called instead.
+    ///
+    /// @param family AF_INET or AF_INET6.
+    /// @param timeout_sec specifies integral part of the timeout (in seconds)
+    /// @param timeout_usec specifies fractional part of the timeout
+    /// (in microseconds)
+    ///
+    /// @throw bundy::BadValue if timeout_usec is greater than one million
+    /// @throw bundy::dhcp::SocketReadError if waiting failed.
+    /// @return true if the sockets in ready_ have data to receive.
+    bool waitForData(const uint16_t family, uint32_t timeout_sec,
+                     uint32_t timeout_usec);
+
+    /// @brief Rebuilds the poll set of the family if sockets have been
+    /// opened or closed since it was built.
+    ///
+    /// @param family AF_INET or AF_INET6.
+    /// @param poll_set the set to update.
+    void updatePollSet(const uint16_t family, PollSet& poll_set);
+
     /// @brief Identifies local network address to be used to
     /// connect to remote address.
     ///
@@ -1059,6 +1165,15 @@ private:
 
     /// @brief Contains list of callbacks for external sockets
     SocketCallbackInfoContainer callbacks_;
+
+    /// Descriptors waited for by receive4() and receiveBatch4().
+    PollSet poll4_;
+
+    /// Descriptors waited for by receive6() and receiveBatch6().
+    PollSet poll6_;
+
+    /// Indexes of the ready entries after waitForData().
+    std::vector<size_t> ready_;
 };
 
 }; // namespace bundy::dhcp
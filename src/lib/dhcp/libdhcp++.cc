@@ -1,4 +1,4 @@
-// Copyright (C) 2011-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2011-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -52,6 +52,13 @@ VendorOptionDefContainers LibDHCP::vendor4_defs_;
 
 VendorOptionDefContainers LibDHCP::vendor6_defs_;
 
+namespace {
+
+// The option definitions of the option spaces without definitions.
+const OptionDefContainer EMPTY_OPTION_DEFS;
+
+}
+
 // Those two vendor classes are used for cable modems:
 
 /// DOCSIS3.0 compatible cable modem
@@ -215,10 +222,11 @@ size_t LibDHCP::unpackOptions6(const OptionBuffer& buf,
     size_t offset = 0;
     size_t length = buf.size();
 
-    // Get the list of standard option definitions.
-    OptionDefContainer option_defs;
+    // Get the list of standard option definitions.  The container is not
+    // copied as this is done for each packet.
+    const OptionDefContainer* option_defs = &EMPTY_OPTION_DEFS;
     if (option_space == "dhcp6") {
-        option_defs = LibDHCP::getOptionDefs(Option::V6);
+        option_defs = &LibDHCP::getOptionDefs(Option::V6);
     }
     // @todo Once we implement other option spaces we should add else clause
     // here and gather option definitions for them. For now leaving option_defs
@@ -226,7 +234,7 @@ size_t LibDHCP::unpackOptions6(const OptionBuffer& buf,
 
     // Get the search index #1. It allows to search for option definitions
     // using option code.
-    const OptionDefContainerTypeIndex& idx = option_defs.get<1>();
+    const OptionDefContainerTypeIndex& idx = option_defs->get<1>();
 
     // The buffer being read comprises a set of options, each starting with
     // a two-byte type code and a two-byte length field.
@@ -313,12 +321,15 @@ size_t LibDHCP::unpackOptions6(const OptionBuffer& buf,
 size_t LibDHCP::unpackOptions4(const OptionBuffer& buf,
                                const std::string& option_space,
                                bundy::dhcp::OptionCollection& options) {
-    size_t offset = 0;
+    // Locate the options first.  This checks the option headers.
+    OptionLocations locations;
+    const size_t offset = scanOptions4(buf, 0, locations);
 
-    // Get the list of stdandard option definitions.
-    OptionDefContainer option_defs;
+    // Get the list of stdandard option definitions.  The container is not
+    // copied as this is done for each packet.
+    const OptionDefContainer* option_defs = &EMPTY_OPTION_DEFS;
     if (option_space == "dhcp4") {
-        option_defs = LibDHCP::getOptionDefs(Option::V4);
+        option_defs = &LibDHCP::getOptionDefs(Option::V4);
     }
     // @todo Once we implement other option spaces we should add else clause
     // here and gather option definitions for them. For now leaving option_defs
@@ -326,11 +337,54 @@ size_t LibDHCP::unpackOptions4(const OptionBuffer& buf,
 
     // Get the search index #1. It allows to search for option definitions
     // using option code.
-    const OptionDefContainerTypeIndex& idx = option_defs.get<1>();
+    const OptionDefContainerTypeIndex& idx = option_defs->get<1>();
+
+    for (OptionLocations::const_iterator loc = locations.begin();
+         loc != locations.end(); ++loc) {
+        const uint8_t opt_type = loc->type_;
+        const OptionBufferConstIter begin =
+            buf.begin() + loc->offset_ + Option::OPTION4_HDR_LEN;
+        const OptionBufferConstIter end = buf.begin() + loc->offset_ +
+            loc->len_;
+
+        // Get all definitions with the particular option code. Note that option code
+        // is non-unique within this container however at this point we expect
+        // to get one option definition with the particular code. If more are
+        // returned we report an error.
+        const OptionDefContainerTypeRange& range = idx.equal_range(opt_type);
+        // Get the number of returned option definitions for the option code.
+        size_t num_defs = distance(range.first, range.second);
+
+        OptionPtr opt;
+        if (num_defs > 1) {
+            // Multiple options of the same code are not supported right now!
+            bundy_throw(bundy::Unexpected, "Internal error: multiple option definitions"
+                      " for option type " << static_cast<int>(opt_type)
+                      << " returned. Currently it is not supported to initialize"
+                      << " multiple option definitions for the same option code."
+                      << " This will be supported once support for option spaces"
+                      << " is implemented");
+        } else if (num_defs == 0) {
+            opt = OptionPtr(new Option(Option::V4, opt_type, begin, end));
+        } else {
+            // The option definition has been found. Use it to create
+            // the option instance from the provided buffer chunk.
+            const OptionDefinitionPtr& def = *(range.first);
+            assert(def);
+            opt = def->optionFactory(Option::V4, opt_type, begin, end);
+        }
+
+        options.insert(std::make_pair(opt_type, opt));
+    }
+    return (offset);
+}
 
+size_t LibDHCP::scanOptions4(const OptionBuffer& buf, size_t offset,
+                             OptionLocations& locations) {
     // The buffer being read comprises a set of options, each starting with
     // a one-byte type code and a one-byte length field.
     while (offset + 1 <= buf.size()) {
+        const size_t opt_offset = offset;
         uint8_t opt_type = buf[offset++];
 
         // DHO_END is a special, one octet long option
@@ -356,38 +410,8 @@ size_t LibDHCP::unpackOptions4(const OptionBuffer& buf,
                       << "-byte long buffer.");
         }
 
-        // Get all definitions with the particular option code. Note that option code
-        // is non-unique within this container however at this point we expect
-        // to get one option definition with the particular code. If more are
-        // returned we report an error.
-        const OptionDefContainerTypeRange& range = idx.equal_range(opt_type);
-        // Get the number of returned option definitions for the option code.
-        size_t num_defs = distance(range.first, range.second);
-
-        OptionPtr opt;
-        if (num_defs > 1) {
-            // Multiple options of the same code are not supported right now!
-            bundy_throw(bundy::Unexpected, "Internal error: multiple option definitions"
-                      " for option type " << static_cast<int>(opt_type)
-                      << " returned. Currently it is not supported to initialize"
-                      << " multiple option definitions for the same option code."
-                      << " This will be supported once support for option spaces"
-                      << " is implemented");
-        } else if (num_defs == 0) {
-            opt = OptionPtr(new Option(Option::V4, opt_type,
-                                       buf.begin() + offset,
-                                       buf.begin() + offset + opt_len));
-        } else {
-            // The option definition has been found. Use it to create
-            // the option instance from the provided buffer chunk.
-            const OptionDefinitionPtr& def = *(range.first);
-            assert(def);
-            opt = def->optionFactory(Option::V4, opt_type,
-                                     buf.begin() + offset,
-                                     buf.begin() + offset + opt_len);
-        }
-
-        options.insert(std::make_pair(opt_type, opt));
+        locations.push_back(OptionLocation(opt_type, opt_offset,
+                                           opt_len + Option::OPTION4_HDR_LEN));
         offset += opt_len;
     }
     return (offset);
@@ -580,10 +604,13 @@ size_t LibDHCP::unpackVendorOptions4(const uint32_t vendor_id, const OptionBuffe
 
 void
 LibDHCP::packOptions(bundy::util::OutputBuffer& buf,
-                     const OptionCollection& options) {
+                     const OptionCollection& options,
+                     const PackedOptions* packed) {
     for (OptionCollection::const_iterator it = options.begin();
          it != options.end(); ++it) {
-        it->second->pack(buf);
+        if (packed == NULL || !packed->pack(it->second, buf)) {
+            it->second->pack(buf);
+        }
     }
 }
 
@@ -1,4 +1,4 @@
-// Copyright (C) 2011-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2011-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -16,6 +16,7 @@
 #define LIBDHCP_H
 
 #include <dhcp/option_definition.h>
+#include <dhcp/packed_options.h>
 #include <dhcp/pkt6.h>
 #include <util/buffer.h>
 
@@ -110,8 +111,12 @@ public:
     ///
     /// @param buf output buffer (assembled options will be stored here)
     /// @param options collection of options to store to
+    /// @param packed if not NULL, options packed beforehand: the wire format
+    ///        of those which are in @c options is copied instead of being
+    ///        assembled again.
     static void packOptions(bundy::util::OutputBuffer& buf,
-                            const bundy::dhcp::OptionCollection& options);
+                            const bundy::dhcp::OptionCollection& options,
+                            const PackedOptions* packed = NULL);
 
     /// @brief Parses provided buffer as DHCPv4 options and creates Option objects.
     ///
@@ -127,6 +132,24 @@ public:
                                  const std::string& option_space,
                                  bundy::dhcp::OptionCollection& options);
 
+    /// @brief Locates DHCPv4 options in a buffer without parsing them.
+    ///
+    /// The option headers are checked as in @c unpackOptions4, but no
+    /// option object is created and no data is copied: the location of
+    /// each option is recorded, so the option can be parsed later (e.g. by
+    /// passing its bytes to @c unpackOptions4).  Pad and end options are
+    /// not recorded.
+    ///
+    /// @param buf Buffer holding the options.
+    /// @param offset Offset of the first option in the buffer.
+    /// @param [out] locations The locations of the options are appended
+    ///        here, in the order of the buffer.
+    /// @return offset to the first byte after last located option
+    ///
+    /// @throw bundy::OutOfRange if an option is truncated.
+    static size_t scanOptions4(const OptionBuffer& buf, size_t offset,
+                               OptionLocations& locations);
+
     /// @brief Parses provided buffer as DHCPv6 options and creates Option objects.
     ///
     /// Parses provided buffer and stores created Option objects in options
@@ -1,4 +1,4 @@
-// Copyright (C) 2011-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2011-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -15,6 +15,7 @@
 #ifndef OPTION_H
 #define OPTION_H
 
+#include <dhcp/option_collection.h>
 #include <util/buffer.h>
 
 #include <boost/function.hpp>
@@ -41,12 +42,32 @@ typedef OptionBuffer::const_iterator OptionBufferConstIter;
 /// pointer to a DHCP buffer
 typedef boost::shared_ptr<OptionBuffer> OptionBufferPtr;
 
-/// shared pointer to Option object
-class Option;
-typedef boost::shared_ptr<Option> OptionPtr;
+/// @brief Location of an option in a buffer.
+///
+/// The options of a received packet can be located first and parsed only
+/// when they are needed.
+struct OptionLocation {
+    /// @brief Constructor.
+    ///
+    /// @param type option code.
+    /// @param offset offset of the option (header included) in the buffer.
+    /// @param len length of the option, header included.
+    OptionLocation(uint16_t type, size_t offset, size_t len) :
+        type_(type), offset_(offset), len_(len)
+    {}
+
+    /// option code
+    uint16_t type_;
+
+    /// offset of the option header in the buffer
+    size_t offset_;
+
+    /// length of the option, header included
+    size_t len_;
+};
 
-/// A collection of DHCP (v4 or v6) options
-typedef std::multimap<unsigned int, OptionPtr> OptionCollection;
+/// A collection of option locations, in the order of the buffer
+typedef std::vector<OptionLocation> OptionLocations;
 
 /// @brief This type describes a callback function to parse options from buffer.
 ///
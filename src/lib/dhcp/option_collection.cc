@@ -0,0 +1,107 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcp/option_collection.h>
+
+namespace {
+
+// Number of elements the storage is allocated for when an element is
+// inserted into an empty collection without inline storage.
+const size_t MIN_CAPACITY = 4;
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+OptionCollection::OptionCollection(const OptionCollection& other) :
+    data_(NULL), size_(0), capacity_(0), inline_data_(NULL)
+{
+    *this = other;
+}
+
+OptionCollection&
+OptionCollection::operator=(const OptionCollection& other) {
+    if (this != &other) {
+        clear();
+        reserve(other.size_);
+        for (; size_ < other.size_; ++size_) {
+            new (data_ + size_) value_type(other.data_[size_]);
+        }
+    }
+    return (*this);
+}
+
+OptionCollection::iterator
+OptionCollection::insertSorted(const value_type& value) {
+    // The value may be an element of the collection, so it is copied
+    // before the storage is reallocated or the elements are moved.
+    value_type copy(value);
+    const size_t index = upper_bound(copy.first) - data_;
+    if (size_ == capacity_) {
+        reserve(capacity_ == 0 ? MIN_CAPACITY : capacity_ * 2);
+    }
+
+    // Move the following elements by one, swapping the options to avoid
+    // updating the reference counts.
+    new (data_ + size_) value_type(copy.first, OptionPtr());
+    ++size_;
+    for (size_t i = size_ - 1; i > index; --i) {
+        data_[i].first = data_[i - 1].first;
+        data_[i].second.swap(data_[i - 1].second);
+    }
+    data_[index].first = copy.first;
+    data_[index].second.swap(copy.second);
+    return (data_ + index);
+}
+
+OptionCollection::iterator
+OptionCollection::erase(iterator first, iterator last) {
+    const size_t count = last - first;
+    if (count == 0) {
+        return (first);
+    }
+    for (iterator it = last; it != end(); ++it) {
+        (it - count)->first = it->first;
+        (it - count)->second.swap(it->second);
+    }
+    for (size_t i = size_ - count; i < size_; ++i) {
+        data_[i].~value_type();
+    }
+    size_ -= count;
+    return (first);
+}
+
+void
+OptionCollection::reserve(size_type capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    value_type* data =
+        static_cast<value_type*>(::operator new(capacity *
+                                                sizeof(value_type)));
+    for (size_t i = 0; i < size_; ++i) {
+        new (data + i) value_type(data_[i].first, OptionPtr());
+        data[i].second.swap(data_[i].second);
+        data_[i].~value_type();
+    }
+    if (data_ != inline_data_) {
+        ::operator delete(data_);
+    }
+    data_ = data;
+    capacity_ = capacity;
+}
+
+} // namespace bundy::dhcp
+} // namespace bundy
@@ -0,0 +1,391 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef OPTION_COLLECTION_H
+#define OPTION_COLLECTION_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace bundy {
+namespace dhcp {
+
+/// shared pointer to Option object
+class Option;
+typedef boost::shared_ptr<Option> OptionPtr;
+
+/// @brief A collection of DHCP (v4 or v6) options.
+///
+/// The options are kept in an array sorted by option code, options of the
+/// same code being kept in the order they were inserted.  The interface is
+/// the subset of the @c std::multimap<unsigned int, OptionPtr> one the
+/// DHCP code uses, and the lookups give the same results.
+///
+/// A message or an option rarely holds more than a few tens of options,
+/// so a sorted array is searched as fast as a tree, is much more cache
+/// friendly and is allocated at once.  The @c InlineOptionCollection
+/// class template also stores the first options in the collection
+/// itself, so it can be filled without allocating memory.
+///
+/// Unlike the iterators of a multimap, the iterators of the collection are
+/// invalidated when an option is inserted into or erased from it.  The
+/// option code of an element must not be modified through an iterator.
+class OptionCollection {
+public:
+    /// Type of the option codes
+    typedef unsigned int key_type;
+
+    /// Type of the options
+    typedef OptionPtr mapped_type;
+
+    /// Type of the elements: the option code and the option
+    typedef std::pair<unsigned int, OptionPtr> value_type;
+
+    /// Iterator over the elements
+    typedef value_type* iterator;
+
+    /// Constant iterator over the elements
+    typedef const value_type* const_iterator;
+
+    /// Reference to an element
+    typedef value_type& reference;
+
+    /// Constant reference to an element
+    typedef const value_type& const_reference;
+
+    /// Type of the sizes
+    typedef size_t size_type;
+
+    /// Type of the iterator differences
+    typedef ptrdiff_t difference_type;
+
+    /// @brief Constructor of an empty collection.
+    OptionCollection() :
+        data_(NULL), size_(0), capacity_(0), inline_data_(NULL)
+    {}
+
+    /// @brief Copy constructor.
+    ///
+    /// @param other the collection to copy.
+    OptionCollection(const OptionCollection& other);
+
+    /// @brief Destructor.
+    ~OptionCollection() {
+        clear();
+        if (data_ != inline_data_) {
+            ::operator delete(data_);
+        }
+    }
+
+    /// @brief Assignment operator.
+    ///
+    /// @param other the collection to copy.
+    /// @return reference to this collection.
+    OptionCollection& operator=(const OptionCollection& other);
+
+    /// @brief Returns an iterator to the first element.
+    iterator begin() {
+        return (data_);
+    }
+
+    /// @brief Returns a constant iterator to the first element.
+    const_iterator begin() const {
+        return (data_);
+    }
+
+    /// @brief Returns an iterator past the last element.
+    iterator end() {
+        return (data_ + size_);
+    }
+
+    /// @brief Returns a constant iterator past the last element.
+    const_iterator end() const {
+        return (data_ + size_);
+    }
+
+    /// @brief Returns the number of elements.
+    size_type size() const {
+        return (size_);
+    }
+
+    /// @brief Checks if the collection is empty.
+    bool empty() const {
+        return (size_ == 0);
+    }
+
+    /// @brief Returns the first element with a code not lower than a code.
+    ///
+    /// @param key option code.
+    iterator lower_bound(key_type key) {
+        return (std::lower_bound(begin(), end(), key, KeyLess()));
+    }
+
+    /// @brief Returns the first element with a code not lower than a code.
+    ///
+    /// @param key option code.
+    const_iterator lower_bound(key_type key) const {
+        return (std::lower_bound(begin(), end(), key, KeyLess()));
+    }
+
+    /// @brief Returns the first element with a code greater than a code.
+    ///
+    /// @param key option code.
+    iterator upper_bound(key_type key) {
+        return (std::upper_bound(begin(), end(), key, KeyLess()));
+    }
+
+    /// @brief Returns the first element with a code greater than a code.
+    ///
+    /// @param key option code.
+    const_iterator upper_bound(key_type key) const {
+        return (std::upper_bound(begin(), end(), key, KeyLess()));
+    }
+
+    /// @brief Returns the range of the elements of a code.
+    ///
+    /// @param key option code.
+    std::pair<iterator, iterator> equal_range(key_type key) {
+        return (std::equal_range(begin(), end(), key, KeyLess()));
+    }
+
+    /// @brief Returns the range of the elements of a code.
+    ///
+    /// @param key option code.
+    std::pair<const_iterator, const_iterator>
+    equal_range(key_type key) const {
+        return (std::equal_range(begin(), end(), key, KeyLess()));
+    }
+
+    /// @brief Returns the first element of a code.
+    ///
+    /// @param key option code.
+    /// @return iterator to the element or @c end() if there is none.
+    iterator find(key_type key) {
+        const iterator it = lower_bound(key);
+        return ((it != end() && it->first == key) ? it : end());
+    }
+
+    /// @brief Returns the first element of a code.
+    ///
+    /// @param key option code.
+    /// @return iterator to the element or @c end() if there is none.
+    const_iterator find(key_type key) const {
+        const const_iterator it = lower_bound(key);
+        return ((it != end() && it->first == key) ? it : end());
+    }
+
+    /// @brief Returns the number of elements of a code.
+    ///
+    /// @param key option code.
+    size_type count(key_type key) const {
+        const std::pair<const_iterator, const_iterator> range =
+            equal_range(key);
+        return (range.second - range.first);
+    }
+
+    /// @brief Inserts an element.
+    ///
+    /// The element is inserted after the elements of the same code.
+    ///
+    /// @param value the option code and the option.
+    /// @return iterator to the inserted element.
+    iterator insert(const value_type& value) {
+        // The options are most often inserted by increasing code.
+        if (size_ < capacity_ &&
+            (size_ == 0 || data_[size_ - 1].first <= value.first)) {
+            new (data_ + size_) value_type(value);
+            return (data_ + size_++);
+        }
+        return (insertSorted(value));
+    }
+
+    /// @brief Inserts elements.
+    ///
+    /// @param first iterator to the first element to insert.
+    /// @param last iterator past the last element to insert.
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        for (; first != last; ++first) {
+            insert(value_type(first->first, first->second));
+        }
+    }
+
+    /// @brief Erases an element.
+    ///
+    /// @param pos iterator to the element to erase.
+    /// @return iterator to the element following the erased one.
+    iterator erase(iterator pos) {
+        return (erase(pos, pos + 1));
+    }
+
+    /// @brief Erases a range of elements.
+    ///
+    /// @param first iterator to the first element to erase.
+    /// @param last iterator past the last element to erase.
+    /// @return iterator to the element following the erased ones.
+    iterator erase(iterator first, iterator last);
+
+    /// @brief Erases the elements of a code.
+    ///
+    /// @param key option code.
+    /// @return the number of erased elements.
+    size_type erase(key_type key) {
+        const std::pair<iterator, iterator> range = equal_range(key);
+        erase(range.first, range.second);
+        return (range.second - range.first);
+    }
+
+    /// @brief Erases all the elements.
+    ///
+    /// The allocated memory, if any, is kept for further insertions.
+    void clear() {
+        for (size_t i = 0; i < size_; ++i) {
+            data_[i].~value_type();
+        }
+        size_ = 0;
+    }
+
+    /// @brief Makes sure elements can be inserted without allocating memory.
+    ///
+    /// @param capacity the number of elements to make room for.
+    void reserve(size_type capacity);
+
+protected:
+    /// @brief Constructor of an empty collection using inline storage.
+    ///
+    /// @param inline_data storage of the first elements, which must not be
+    ///        released before the collection is destroyed.
+    /// @param inline_capacity number of elements the storage can hold.
+    OptionCollection(value_type* inline_data, size_t inline_capacity) :
+        data_(inline_data), size_(0), capacity_(inline_capacity),
+        inline_data_(inline_data)
+    {}
+
+private:
+    /// @brief Inserts an element after the elements of the same code,
+    /// making room for it if needed.
+    ///
+    /// @param value the option code and the option.
+    /// @return iterator to the inserted element.
+    iterator insertSorted(const value_type& value);
+
+    /// @brief Compares the code of an element with an option code.
+    struct KeyLess {
+        bool operator()(const value_type& value, key_type key) const {
+            return (value.first < key);
+        }
+        bool operator()(key_type key, const value_type& value) const {
+            return (key < value.first);
+        }
+    };
+
+    /// Storage of the elements, the inline one or an allocated array
+    value_type* data_;
+
+    /// Number of elements
+    size_t size_;
+
+    /// Number of elements the storage can hold
+    size_t capacity_;
+
+    /// Inline storage if any, the first @c size_ elements being
+    /// constructed when used
+    value_type* const inline_data_;
+};
+
+/// @brief A collection of options able to hold some options without
+/// allocating memory.
+///
+/// Up to @c N options are stored in the collection itself, a larger array
+/// being allocated when more options are inserted.  It can be used
+/// wherever an @c OptionCollection is expected.
+///
+/// @tparam N number of options stored in the collection itself.
+template <size_t N>
+class InlineOptionCollection : public OptionCollection {
+public:
+    /// Number of options stored without allocating memory
+    static const size_t INLINE_CAPACITY = N;
+
+    /// @brief Constructor of an empty collection.
+    InlineOptionCollection() :
+        OptionCollection(getInlineData(), N)
+    {}
+
+    /// @brief Copy constructor.
+    ///
+    /// @param other the collection to copy.
+    InlineOptionCollection(const InlineOptionCollection& other) :
+        OptionCollection(getInlineData(), N)
+    {
+        OptionCollection::operator=(other);
+    }
+
+    /// @brief Constructor from any collection.
+    ///
+    /// @param other the collection to copy.
+    InlineOptionCollection(const OptionCollection& other) :
+        OptionCollection(getInlineData(), N)
+    {
+        OptionCollection::operator=(other);
+    }
+
+    /// @brief Assignment operator.
+    ///
+    /// @param other the collection to copy.
+    /// @return reference to this collection.
+    InlineOptionCollection& operator=(const InlineOptionCollection& other) {
+        OptionCollection::operator=(other);
+        return (*this);
+    }
+
+    /// @brief Assignment operator from any collection.
+    ///
+    /// @param other the collection to copy.
+    /// @return reference to this collection.
+    InlineOptionCollection& operator=(const OptionCollection& other) {
+        OptionCollection::operator=(other);
+        return (*this);
+    }
+
+private:
+    /// @brief Returns the inline storage of the elements.
+    value_type* getInlineData() {
+        return (static_cast<value_type*>(static_cast<void*>(&inline_data_)));
+    }
+
+    /// Inline storage of the elements
+    typename boost::aligned_storage<sizeof(value_type) * N,
+                                    boost::alignment_of<value_type>::value>::
+        type inline_data_;
+};
+
+template <size_t N>
+const size_t InlineOptionCollection<N>::INLINE_CAPACITY;
+
+/// @brief Collection of the options of a message.
+///
+/// A message rarely holds more than 16 options.
+typedef InlineOptionCollection<16> PktOptionCollection;
+
+} // namespace bundy::dhcp
+} // namespace bundy
+
+#endif // OPTION_COLLECTION_H
@@ -0,0 +1,54 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcp/packed_options.h>
+
+namespace bundy {
+namespace dhcp {
+
+PackedOptions::PackedOptions(const OptionCollection& options) :
+    options_(options)
+{
+    bundy::util::OutputBuffer buf(0);
+    offsets_.reserve(options_.size() + 1);
+    for (OptionCollection::const_iterator it = options_.begin();
+         it != options_.end(); ++it) {
+        offsets_.push_back(buf.getLength());
+        it->second->pack(buf);
+    }
+    offsets_.push_back(buf.getLength());
+    const uint8_t* data = static_cast<const uint8_t*>(buf.getData());
+    wire_.assign(data, data + buf.getLength());
+}
+
+bool
+PackedOptions::pack(const OptionPtr& option,
+                    bundy::util::OutputBuffer& buf) const {
+    const std::pair<OptionCollection::const_iterator,
+                    OptionCollection::const_iterator> range =
+        options_.equal_range(option->getType());
+    for (OptionCollection::const_iterator it = range.first;
+         it != range.second; ++it) {
+        if (it->second == option) {
+            const size_t index = it - options_.begin();
+            buf.writeData(&wire_[offsets_[index]],
+                          offsets_[index + 1] - offsets_[index]);
+            return (true);
+        }
+    }
+    return (false);
+}
+
+} // namespace bundy::dhcp
+} // namespace bundy
@@ -0,0 +1,85 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef PACKED_OPTIONS_H
+#define PACKED_OPTIONS_H
+
+#include <dhcp/option.h>
+#include <util/buffer.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Options stored together with their wire format.
+///
+/// A server sends the same configured options in many responses.  They
+/// can be packed once into an object of this class, which is then shared
+/// by the responses: adding its options to a packet (see
+/// @c Pkt4::addOptions) makes the packet copy their wire format instead
+/// of packing them again.
+///
+/// The options must not be modified once packed.  The object itself is
+/// not modified after its construction, so it can be shared by several
+/// threads.
+class PackedOptions : public boost::noncopyable {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param options the options to pack.
+    ///
+    /// @throw any exception thrown when packing an option.
+    explicit PackedOptions(const OptionCollection& options);
+
+    /// @brief Returns the options.
+    const OptionCollection& getOptions() const {
+        return (options_);
+    }
+
+    /// @brief Returns the length of the wire format of all the options.
+    size_t len() const {
+        return (wire_.size());
+    }
+
+    /// @brief Writes the wire format of an option if it is one of these.
+    ///
+    /// @param option the option to write.
+    /// @param [out] buf the buffer to write the option to.
+    /// @return true if the option was written, false if it is not one of
+    ///         the packed options (and must be packed by the caller).
+    bool pack(const OptionPtr& option, bundy::util::OutputBuffer& buf) const;
+
+private:
+    /// The packed options
+    OptionCollection options_;
+
+    /// Offset of the wire format of each option in @c wire_, in the
+    /// order of @c options_, followed by the length of @c wire_
+    std::vector<size_t> offsets_;
+
+    /// The wire format of the options
+    OptionBuffer wire_;
+};
+
+/// Pointer to constant packed options
+typedef boost::shared_ptr<const PackedOptions> ConstPackedOptionsPtr;
+
+} // namespace bundy::dhcp
+} // namespace bundy
+
+#endif // PACKED_OPTIONS_H
@@ -49,7 +49,8 @@ Pkt4::Pkt4(uint8_t msg_type, uint32_t transid)
       ciaddr_(DEFAULT_ADDRESS),
       yiaddr_(DEFAULT_ADDRESS),
       siaddr_(DEFAULT_ADDRESS),
-      giaddr_(DEFAULT_ADDRESS)
+      giaddr_(DEFAULT_ADDRESS),
+      lazy_unpack_(false)
 {
     memset(sname_, 0, MAX_SNAME_LEN);
     memset(file_, 0, MAX_FILE_LEN);
@@ -74,7 +75,8 @@ Pkt4::Pkt4(const uint8_t* data, size_t len)
       ciaddr_(DEFAULT_ADDRESS),
       yiaddr_(DEFAULT_ADDRESS),
       siaddr_(DEFAULT_ADDRESS),
-      giaddr_(DEFAULT_ADDRESS)
+      giaddr_(DEFAULT_ADDRESS),
+      lazy_unpack_(false)
 {
     if (len < DHCPV4_PKT_HDR_LEN) {
         bundy_throw(OutOfRange, "Truncated DHCPv4 packet (len=" << len
@@ -93,6 +95,8 @@ size_t
 Pkt4::len() {
     size_t length = DHCPV4_PKT_HDR_LEN; // DHCPv4 header
 
+    createOptions(true);
+
     // ... and sum of lengths of all options
     for (OptionCollection::const_iterator it = options_.begin();
          it != options_.end();
@@ -152,7 +156,8 @@ Pkt4::pack() {
         // write DHCP magic cookie
         buffer_out_.writeUint32(DHCP_OPTIONS_COOKIE);
 
-        LibDHCP::packOptions(buffer_out_, options_);
+        createOptions(true);
+        LibDHCP::packOptions(buffer_out_, options_, packed_options_.get());
 
         // add END option that indicates end of options
         // (End option is very simple, just a 255 octet)
@@ -213,6 +218,19 @@ Pkt4::unpack() {
       bundy_throw(Unexpected, "Invalid or missing DHCP magic cookie");
     }
 
+    if (lazy_unpack_) {
+        // Only locate the options in the received data, they are created
+        // when they are requested.
+        locations_.clear();
+        LibDHCP::scanOptions4(data_, buffer_in.getPosition(), locations_);
+
+        // @todo check will need to be called separately, so hooks can be
+        // called after the packet is parsed, but before its content is
+        // verified
+        check();
+        return;
+    }
+
     size_t opts_len = buffer_in.getLength() - buffer_in.getPosition();
     vector<uint8_t> opts_buffer;
 
@@ -284,6 +302,7 @@ Pkt4::toText() {
         << ":" << remote_port_ << ", msgtype=" << static_cast<int>(getType())
         << ", transid=0x" << hex << transid_ << dec << endl;
 
+    createOptions(true);
     for (bundy::dhcp::OptionCollection::iterator opt=options_.begin();
          opt != options_.end();
          ++opt) {
@@ -442,8 +461,23 @@ Pkt4::addOption(boost::shared_ptr<Option> opt) {
     options_.insert(pair<int, boost::shared_ptr<Option> >(opt->getType(), opt));
 }
 
+void
+Pkt4::addOptions(const ConstPackedOptionsPtr& options) {
+    const OptionCollection& added = options->getOptions();
+    for (OptionCollection::const_iterator it = added.begin();
+         it != added.end(); ++it) {
+        if (!getOption(it->first)) {
+            options_.insert(*it);
+        }
+    }
+    packed_options_ = options;
+}
+
 boost::shared_ptr<bundy::dhcp::Option>
 Pkt4::getOption(uint8_t type) const {
+    if (!locations_.empty()) {
+        createOptions(false, type);
+    }
     OptionCollection::const_iterator x = options_.find(type);
     if (x != options_.end()) {
         return (*x).second;
@@ -453,6 +487,7 @@ Pkt4::getOption(uint8_t type) const {
 
 bool
 Pkt4::delOption(uint8_t type) {
+    createOptions(false, type);
     bundy::dhcp::OptionCollection::iterator x = options_.find(type);
     if (x != options_.end()) {
         options_.erase(x);
@@ -461,6 +496,42 @@ Pkt4::delOption(uint8_t type) {
     return (false); // can't find option to be deleted
 }
 
+void
+Pkt4::createOptions(bool all, uint8_t type) const {
+    // Gather the options to create (all the instances of the type, as
+    // a long option may be split in several ones) in a buffer.
+    OptionBuffer buf;
+    for (OptionLocations::const_iterator loc = locations_.begin();
+         loc != locations_.end(); ++loc) {
+        if (all || loc->type_ == type) {
+            buf.insert(buf.end(), data_.begin() + loc->offset_,
+                       data_.begin() + loc->offset_ + loc->len_);
+        }
+    }
+    if (buf.empty()) {
+        return;
+    }
+
+    OptionCollection options;
+    if (callback_.empty()) {
+        LibDHCP::unpackOptions4(buf, "dhcp4", options);
+    } else {
+        callback_(buf, "dhcp4", options, NULL, NULL);
+    }
+
+    // The options are forgotten only once they are created, so an option
+    // which is not valid is reported each time it is requested.
+    options_.insert(options.begin(), options.end());
+    OptionLocations::iterator loc = locations_.begin();
+    while (loc != locations_.end()) {
+        if (all || loc->type_ == type) {
+            loc = locations_.erase(loc);
+        } else {
+            ++loc;
+        }
+    }
+}
+
 void
 Pkt4::updateTimestamp() {
     timestamp_ = boost::posix_time::microsec_clock::universal_time();
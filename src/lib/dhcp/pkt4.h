@@ -21,6 +21,7 @@
 #include <dhcp/option.h>
 #include <dhcp/hwaddr.h>
 #include <dhcp/classify.h>
+#include <dhcp/packed_options.h>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/shared_ptr.hpp>
@@ -85,11 +86,34 @@ public:
     /// Parses received packet, stored in on-wire format in bufferIn_.
     ///
     /// Will create a collection of option objects that will
-    /// be stored in options_ container.
+    /// be stored in options_ container.  With lazy unpacking (see
+    /// @ref setLazyUnpack), the options are only located in the packet.
     ///
     /// Method with throw exception if packet parsing fails.
     void unpack();
 
+    /// @brief Enables or disables lazy unpacking of the options.
+    ///
+    /// With lazy unpacking, @c unpack only checks the option headers and
+    /// records where the options are in the received data.  An option
+    /// object is created when the option is first requested by
+    /// @c getOption, so the options nobody asks for are never parsed or
+    /// copied.  The methods using all the options (@c pack, @c len and
+    /// @c toText) create the remaining ones.  As a consequence, an option
+    /// whose content is not valid makes @c getOption throw, not @c unpack.
+    ///
+    /// Lazy unpacking is disabled by default.
+    ///
+    /// @param lazy_unpack true to unpack the options lazily.
+    void setLazyUnpack(bool lazy_unpack) {
+        lazy_unpack_ = lazy_unpack;
+    }
+
+    /// @brief Checks if the options are unpacked lazily.
+    bool getLazyUnpack() const {
+        return (lazy_unpack_);
+    }
+
     /// @brief performs sanity check on a packet.
     ///
     /// This is usually performed after unpack(). It checks if packet is sane:
@@ -326,10 +350,25 @@ public:
     void
     addOption(boost::shared_ptr<Option> opt);
 
+    /// @brief Adds options packed beforehand.
+    ///
+    /// Each of the options is added unless the packet already holds an
+    /// option of its code.  When the packet is packed, the wire format of
+    /// the added options is copied from @c options (the wire format of
+    /// options later replaced or added by other means is not affected).
+    /// Only the options last added by this method are copied.
+    ///
+    /// @param options the options to add.
+    void addOptions(const ConstPackedOptionsPtr& options);
+
     /// @brief Returns an option of specified type.
     ///
+    /// With lazy unpacking, the option is created on the first call.
+    ///
     /// @return returns option of requested type (or NULL)
     ///         if no such option is present
+    /// @throw bundy::Exception if the option is created and its content
+    ///        is not valid.
     boost::shared_ptr<Option>
     getOption(uint8_t opt_type) const;
 
@@ -585,6 +624,16 @@ public:
 
 private:
 
+    /// @brief Creates the options which were located but not created yet.
+    ///
+    /// The options are created with the callback (if set) or
+    /// @c LibDHCP::unpackOptions4 and added to options_.
+    ///
+    /// @param all if true all the options are created, else only the
+    ///        options of the given type.
+    /// @param type the type of the options to create if all is false.
+    void createOptions(bool all, uint8_t type = 0) const;
+
     /// @brief Generic method that validates and sets HW address.
     ///
     /// This is a generic method used by all modifiers of this class
@@ -693,7 +742,21 @@ protected:
     /// behavior must be taken into consideration before making
     /// changes to this member such as access scope restriction or
     /// data format change etc.
-    bundy::dhcp::OptionCollection options_;
+    ///
+    /// With lazy unpacking, it holds the options created so far (it is
+    /// mutable as @c getOption creates them).
+    mutable bundy::dhcp::PktOptionCollection options_;
+
+    /// @brief Options last added by @c addOptions, whose wire format is
+    /// copied by @c pack.
+    ConstPackedOptionsPtr packed_options_;
+
+    /// @brief Are the options unpacked lazily?
+    bool lazy_unpack_;
+
+    /// @brief Locations in data_ of the options not created yet (with lazy
+    /// unpacking).
+    mutable OptionLocations locations_;
 
     /// packet timestamp
     boost::posix_time::ptime timestamp_;
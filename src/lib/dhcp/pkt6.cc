@@ -1,4 +1,4 @@
-// Copyright (C) 2011-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2011-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -478,13 +478,10 @@ Pkt6::getOption(uint16_t opt_type) {
 bundy::dhcp::OptionCollection
 Pkt6::getOptions(uint16_t opt_type) {
     bundy::dhcp::OptionCollection found;
-
-    for (OptionCollection::const_iterator x = options_.begin();
-         x != options_.end(); ++x) {
-        if (x->first == opt_type) {
-            found.insert(make_pair(opt_type, x->second));
-        }
-    }
+    const std::pair<OptionCollection::const_iterator,
+                    OptionCollection::const_iterator> range =
+        options_.equal_range(opt_type);
+    found.insert(range.first, range.second);
     return (found);
 }
 
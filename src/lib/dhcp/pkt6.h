@@ -353,7 +353,7 @@ public:
     /// behavior must be taken into consideration before making
     /// changes to this member such as access scope restriction or
     /// data format change etc.
-    bundy::dhcp::OptionCollection options_;
+    bundy::dhcp::PktOptionCollection options_;
 
     /// @brief Update packet timestamp.
     ///
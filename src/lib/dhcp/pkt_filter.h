@@ -19,6 +19,8 @@
 #include <asiolink/io_address.h>
 #include <boost/shared_ptr.hpp>
 
+#include <vector>
+
 namespace bundy {
 namespace dhcp {
 
@@ -101,6 +103,26 @@ public:
     virtual Pkt4Ptr receive(const Iface& iface,
                             const SocketInfo& socket_info) = 0;
 
+    /// @brief Receive packets already queued on the specified socket.
+    ///
+    /// The call blocks until the first packet is received, like
+    /// @c PktFilter::receive, and then returns the packets that are
+    /// already queued on the socket, so it should be called when the
+    /// socket is known to be readable. The default implementation
+    /// receives a single packet with @c PktFilter::receive; derived
+    /// classes may receive several packets with a single system call.
+    ///
+    /// @param iface interface
+    /// @param socket_info structure holding socket information
+    /// @param max_count maximum number of packets to receive
+    /// @param [out] pkts the received packets are appended to it.
+    ///
+    /// @return number of the packets appended to pkts
+    virtual size_t receiveBatch(const Iface& iface,
+                                const SocketInfo& socket_info,
+                                const size_t max_count,
+                                std::vector<Pkt4Ptr>& pkts);
+
     /// @brief Send packet over specified socket.
     ///
     /// @param iface interface to be used to send packet
@@ -39,6 +39,20 @@ PktFilter6::joinMulticast(int sock, const std::string& ifname,
     return (true);
 }
 
+size_t
+PktFilter6::receiveBatch(const SocketInfo& socket_info, const size_t max_count,
+                         std::vector<Pkt6Ptr>& pkts) {
+    if (max_count == 0) {
+        return (0);
+    }
+    Pkt6Ptr pkt = receive(socket_info);
+    if (!pkt) {
+        return (0);
+    }
+    pkts.push_back(pkt);
+    return (1);
+}
+
 
 } // end of bundy::dhcp namespace
 } // end of bundy namespace
@@ -18,6 +18,8 @@
 #include <asiolink/io_address.h>
 #include <dhcp/pkt6.h>
 
+#include <vector>
+
 namespace bundy {
 namespace dhcp {
 
@@ -109,6 +111,24 @@ public:
     /// @return A pointer to received message.
     virtual Pkt6Ptr receive(const SocketInfo& socket_info) = 0;
 
+    /// @brief Receives DHCPv6 messages already queued on the socket.
+    ///
+    /// The call blocks until the first message is received, like
+    /// @c PktFilter6::receive, and then returns the messages that are
+    /// already queued on the socket, so it should be called when the
+    /// socket is known to be readable. The default implementation
+    /// receives a single message with @c PktFilter6::receive; derived
+    /// classes may receive several messages with a single system call.
+    ///
+    /// @param socket_info A structure holding socket information.
+    /// @param max_count Maximum number of messages to receive.
+    /// @param [out] pkts The received messages are appended to it.
+    ///
+    /// @return Number of the messages appended to pkts.
+    virtual size_t receiveBatch(const SocketInfo& socket_info,
+                                const size_t max_count,
+                                std::vector<Pkt6Ptr>& pkts);
+
     /// @brief Sends DHCPv6 message through a specified interface and socket.
     ///
     /// This function sends a DHCPv6 message through a specified interface and
@@ -17,6 +17,7 @@
 #include <dhcp/pkt4.h>
 #include <dhcp/pkt_filter_inet.h>
 #include <errno.h>
+#include <algorithm>
 #include <cstring>
 
 using namespace bundy::asiolink;
@@ -24,6 +25,79 @@ using namespace bundy::asiolink;
 namespace bundy {
 namespace dhcp {
 
+namespace {
+
+/// Maximum number of packets received with a single recvmmsg() call.
+const size_t MAX_BATCH_SIZE = 32;
+
+/// @brief Creates a packet from the received data.
+///
+/// @param iface interface the packet was received on
+/// @param socket_info the socket the packet was received over
+/// @param m message header filled in by the kernel
+/// @param buf the received data
+/// @param len length of the received data
+Pkt4Ptr
+createPacket(const Iface& iface, const SocketInfo& socket_info,
+             struct msghdr& m, const uint8_t* buf, const size_t len) {
+    const struct sockaddr_in* from_addr =
+        static_cast<const struct sockaddr_in*>(m.msg_name);
+
+    Pkt4Ptr pkt = Pkt4Ptr(new Pkt4(buf, len));
+
+    pkt->updateTimestamp();
+
+    unsigned int ifindex = iface.getIndex();
+
+    IOAddress from(htonl(from_addr->sin_addr.s_addr));
+    uint16_t from_port = htons(from_addr->sin_port);
+
+    // Set receiving interface based on information, which socket was used to
+    // receive data. OS-specific info (see os_receive4()) may be more reliable,
+    // so this value may be overwritten.
+    pkt->setIndex(ifindex);
+    pkt->setIface(iface.getName());
+    pkt->setRemoteAddr(from);
+    pkt->setRemotePort(from_port);
+    pkt->setLocalPort(socket_info.port_);
+
+// In the future the OS-specific code may be abstracted to a different
+// file but for now we keep it here because there is no code yet, which
+// is specific to non-Linux systems.
+#if defined (IP_PKTINFO) && defined (OS_LINUX)
+    struct cmsghdr* cmsg;
+    struct in_pktinfo* pktinfo;
+    struct in_addr to_addr;
+
+    memset(&to_addr, 0, sizeof(to_addr));
+
+    cmsg = CMSG_FIRSTHDR(&m);
+    while (cmsg != NULL) {
+        if ((cmsg->cmsg_level == IPPROTO_IP) &&
+            (cmsg->cmsg_type == IP_PKTINFO)) {
+            pktinfo = (struct in_pktinfo*)CMSG_DATA(cmsg);
+
+            pkt->setIndex(pktinfo->ipi_ifindex);
+            pkt->setLocalAddr(IOAddress(htonl(pktinfo->ipi_addr.s_addr)));
+            break;
+
+            // This field is useful, when we are bound to unicast
+            // address e.g. 192.0.2.1 and the packet was sent to
+            // broadcast. This will return broadcast address, not
+            // the address we are bound to.
+
+            // XXX: Perhaps we should uncomment this:
+            // to_addr = pktinfo->ipi_spec_dst;
+        }
+        cmsg = CMSG_NXTHDR(&m, cmsg);
+    }
+#endif
+
+    return (pkt);
+}
+
+}
+
 PktFilterInet::PktFilterInet()
     : control_buf_len_(CMSG_SPACE(sizeof(struct in6_pktinfo))),
       control_buf_(new char[control_buf_len_])
@@ -135,58 +209,73 @@ PktFilterInet::receive(const Iface& iface, const SocketInfo& socket_info) {
         bundy_throw(SocketReadError, "failed to receive UDP4 data");
     }
 
-    // We have all data let's create Pkt4 object.
-    Pkt4Ptr pkt = Pkt4Ptr(new Pkt4(buf, result));
-
-    pkt->updateTimestamp();
-
-    unsigned int ifindex = iface.getIndex();
-
-    IOAddress from(htonl(from_addr.sin_addr.s_addr));
-    uint16_t from_port = htons(from_addr.sin_port);
-
-    // Set receiving interface based on information, which socket was used to
-    // receive data. OS-specific info (see os_receive4()) may be more reliable,
-    // so this value may be overwritten.
-    pkt->setIndex(ifindex);
-    pkt->setIface(iface.getName());
-    pkt->setRemoteAddr(from);
-    pkt->setRemotePort(from_port);
-    pkt->setLocalPort(socket_info.port_);
-
-// In the future the OS-specific code may be abstracted to a different
-// file but for now we keep it here because there is no code yet, which
-// is specific to non-Linux systems.
-#if defined (IP_PKTINFO) && defined (OS_LINUX)
-    struct cmsghdr* cmsg;
-    struct in_pktinfo* pktinfo;
-    struct in_addr to_addr;
+    return (createPacket(iface, socket_info, m, buf, result));
+}
 
-    memset(&to_addr, 0, sizeof(to_addr));
+size_t
+PktFilterInet::receiveBatch(const Iface& iface, const SocketInfo& socket_info,
+                            const size_t max_count,
+                            std::vector<Pkt4Ptr>& pkts) {
+#if defined (OS_LINUX) && defined (MSG_WAITFORONE)
+    const size_t count = std::min(max_count, MAX_BATCH_SIZE);
+    if (count <= 1) {
+        return (PktFilter::receiveBatch(iface, socket_info, max_count, pkts));
+    }
 
-    cmsg = CMSG_FIRSTHDR(&m);
-    while (cmsg != NULL) {
-        if ((cmsg->cmsg_level == IPPROTO_IP) &&
-            (cmsg->cmsg_type == IP_PKTINFO)) {
-            pktinfo = (struct in_pktinfo*)CMSG_DATA(cmsg);
+    // The buffers are allocated on the first use only, as many users
+    // receive a single packet at a time.
+    if (!batch_buf_) {
+        batch_buf_.reset(new uint8_t[MAX_BATCH_SIZE * IfaceMgr::RCVBUFSIZE]);
+        batch_control_buf_.reset(new char[MAX_BATCH_SIZE * control_buf_len_]);
+    }
 
-            pkt->setIndex(pktinfo->ipi_ifindex);
-            pkt->setLocalAddr(IOAddress(htonl(pktinfo->ipi_addr.s_addr)));
-            break;
+    struct mmsghdr msgs[MAX_BATCH_SIZE];
+    struct iovec iovs[MAX_BATCH_SIZE];
+    struct sockaddr_in from_addrs[MAX_BATCH_SIZE];
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (size_t i = 0; i < count; ++i) {
+        iovs[i].iov_base = &batch_buf_[i * IfaceMgr::RCVBUFSIZE];
+        iovs[i].iov_len = IfaceMgr::RCVBUFSIZE;
+        struct msghdr& m = msgs[i].msg_hdr;
+        m.msg_name = &from_addrs[i];
+        m.msg_namelen = sizeof(from_addrs[i]);
+        m.msg_iov = &iovs[i];
+        m.msg_iovlen = 1;
+        m.msg_control = &batch_control_buf_[i * control_buf_len_];
+        m.msg_controllen = control_buf_len_;
+    }
 
-            // This field is useful, when we are bound to unicast
-            // address e.g. 192.0.2.1 and the packet was sent to
-            // broadcast. This will return broadcast address, not
-            // the address we are bound to.
+    // Wait for the first packet only, then take whatever is queued.
+    const int result = recvmmsg(socket_info.sockfd_, msgs, count,
+                                MSG_WAITFORONE, NULL);
+    if (result < 0) {
+        bundy_throw(SocketReadError, "failed to receive UDP4 data");
+    }
 
-            // XXX: Perhaps we should uncomment this:
-            // to_addr = pktinfo->ipi_spec_dst;
+    // A malformed packet doesn't cause the valid ones to be lost; they
+    // are appended before the error is reported.
+    std::string error;
+    size_t received = 0;
+    for (int i = 0; i < result; ++i) {
+        try {
+            pkts.push_back(createPacket(iface, socket_info, msgs[i].msg_hdr,
+                                        &batch_buf_[i * IfaceMgr::RCVBUFSIZE],
+                                        msgs[i].msg_len));
+            ++received;
+        } catch (const std::exception& ex) {
+            if (error.empty()) {
+                error = ex.what();
+            }
         }
-        cmsg = CMSG_NXTHDR(&m, cmsg);
     }
+    if (!error.empty()) {
+        bundy_throw(SocketReadError, "failed to parse received UDP4 data: "
+                    << error);
+    }
+    return (received);
+#else
+    return (PktFilter::receiveBatch(iface, socket_info, max_count, pkts));
 #endif
-
-    return (pkt);
 }
 
 int
@@ -73,6 +73,24 @@ public:
     /// message parsing fails.
     virtual Pkt4Ptr receive(const Iface& iface, const SocketInfo& socket_info);
 
+    /// @brief Receive packets already queued on the specified socket.
+    ///
+    /// On Linux the packets are received with a single recvmmsg() call.
+    ///
+    /// @param iface interface
+    /// @param socket_info structure holding socket information
+    /// @param max_count maximum number of packets to receive
+    /// @param [out] pkts the received packets are appended to it.
+    ///
+    /// @return number of the packets appended to pkts
+    /// @throw bundy::dhcp::SocketReadError if an error occurs during reception
+    /// of the packets, or if any of the received packets can't be parsed.
+    /// In the latter case the other packets are appended to pkts anyway.
+    virtual size_t receiveBatch(const Iface& iface,
+                                const SocketInfo& socket_info,
+                                const size_t max_count,
+                                std::vector<Pkt4Ptr>& pkts);
+
     /// @brief Send packet over specified socket.
     ///
     /// @param iface interface to be used to send packet
@@ -90,6 +108,10 @@ private:
     size_t control_buf_len_;
     /// Control buffer, used in transmission and reception.
     boost::scoped_array<char> control_buf_;
+    /// Data buffers for the packets received by receiveBatch().
+    boost::scoped_array<uint8_t> batch_buf_;
+    /// Control buffers for the packets received by receiveBatch().
+    boost::scoped_array<char> batch_control_buf_;
 };
 
 } // namespace bundy::dhcp
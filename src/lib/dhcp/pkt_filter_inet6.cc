@@ -12,11 +12,14 @@
 // OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <config.h>
 #include <dhcp/iface_mgr.h>
 #include <dhcp/pkt6.h>
 #include <dhcp/pkt_filter_inet6.h>
 #include <util/io/pktinfo_utilities.h>
 
+#include <algorithm>
+
 #include <netinet/in.h>
 
 using namespace bundy::asiolink;
@@ -24,6 +27,79 @@ using namespace bundy::asiolink;
 namespace bundy {
 namespace dhcp {
 
+namespace {
+
+/// Maximum number of messages received with a single recvmmsg() call.
+const size_t MAX_BATCH_SIZE = 32;
+
+/// @brief Creates a DHCPv6 message from the received data.
+///
+/// @param m Message header filled in by the kernel.
+/// @param buf The received data.
+/// @param len Length of the received data.
+Pkt6Ptr
+createPacket(struct msghdr& m, const uint8_t* buf, const size_t len) {
+    const struct sockaddr_in6* from =
+        static_cast<const struct sockaddr_in6*>(m.msg_name);
+
+    struct in6_addr to_addr;
+    memset(&to_addr, 0, sizeof(to_addr));
+
+    int ifindex = -1;
+    struct in6_pktinfo* pktinfo = NULL;
+
+    // We need to loop through the control messages we received and
+    // find the one with our destination address.
+    //
+    // We also keep a flag to see if we found it. If we
+    // didn't, then we consider this to be an error.
+    bool found_pktinfo = false;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&m);
+    while (cmsg != NULL) {
+        if ((cmsg->cmsg_level == IPPROTO_IPV6) &&
+            (cmsg->cmsg_type == IPV6_PKTINFO)) {
+            pktinfo = util::io::internal::convertPktInfo6(CMSG_DATA(cmsg));
+            to_addr = pktinfo->ipi6_addr;
+            ifindex = pktinfo->ipi6_ifindex;
+            found_pktinfo = true;
+            break;
+        }
+        cmsg = CMSG_NXTHDR(&m, cmsg);
+    }
+    if (!found_pktinfo) {
+        bundy_throw(SocketReadError, "unable to find pktinfo");
+    }
+
+    // Let's create a packet.
+    Pkt6Ptr pkt;
+    try {
+        pkt = Pkt6Ptr(new Pkt6(buf, len));
+    } catch (const std::exception& ex) {
+        bundy_throw(SocketReadError, "failed to create new packet");
+    }
+
+    pkt->updateTimestamp();
+
+    pkt->setLocalAddr(IOAddress::fromBytes(AF_INET6,
+                      reinterpret_cast<const uint8_t*>(&to_addr)));
+    pkt->setRemoteAddr(IOAddress::fromBytes(AF_INET6,
+                       reinterpret_cast<const uint8_t*>(&from->sin6_addr)));
+    pkt->setRemotePort(ntohs(from->sin6_port));
+    pkt->setIndex(ifindex);
+
+    Iface* received = IfaceMgr::instance().getIface(pkt->getIndex());
+    if (received) {
+        pkt->setIface(received->getName());
+    } else {
+        bundy_throw(SocketReadError, "received packet over unknown interface"
+                  << "(ifindex=" << pkt->getIndex() << ")");
+    }
+
+    return (pkt);
+}
+
+}
+
 PktFilterInet6::PktFilterInet6()
 : control_buf_len_(CMSG_SPACE(sizeof(struct in6_pktinfo))),
     control_buf_(new char[control_buf_len_]) {
@@ -134,68 +210,77 @@ PktFilterInet6::receive(const SocketInfo& socket_info) {
     m.msg_controllen = control_buf_len_;
 
     int result = recvmsg(socket_info.sockfd_, &m, 0);
-
-    struct in6_addr to_addr;
-    memset(&to_addr, 0, sizeof(to_addr));
-
-    int ifindex = -1;
-    if (result >= 0) {
-        struct in6_pktinfo* pktinfo = NULL;
-
-
-        // If we did read successfully, then we need to loop
-        // through the control messages we received and
-        // find the one with our destination address.
-        //
-        // We also keep a flag to see if we found it. If we
-        // didn't, then we consider this to be an error.
-        bool found_pktinfo = false;
-        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&m);
-        while (cmsg != NULL) {
-            if ((cmsg->cmsg_level == IPPROTO_IPV6) &&
-                (cmsg->cmsg_type == IPV6_PKTINFO)) {
-                pktinfo = util::io::internal::convertPktInfo6(CMSG_DATA(cmsg));
-                to_addr = pktinfo->ipi6_addr;
-                ifindex = pktinfo->ipi6_ifindex;
-                found_pktinfo = true;
-                break;
-            }
-            cmsg = CMSG_NXTHDR(&m, cmsg);
-        }
-        if (!found_pktinfo) {
-            bundy_throw(SocketReadError, "unable to find pktinfo");
-        }
-    } else {
+    if (result < 0) {
         bundy_throw(SocketReadError, "failed to receive data");
     }
 
-    // Let's create a packet.
-    Pkt6Ptr pkt;
-    try {
-        pkt = Pkt6Ptr(new Pkt6(buf, result));
-    } catch (const std::exception& ex) {
-        bundy_throw(SocketReadError, "failed to create new packet");
-    }
+    return (createPacket(m, buf, result));
+}
 
-    pkt->updateTimestamp();
+size_t
+PktFilterInet6::receiveBatch(const SocketInfo& socket_info,
+                             const size_t max_count,
+                             std::vector<Pkt6Ptr>& pkts) {
+#if defined (OS_LINUX) && defined (MSG_WAITFORONE)
+    const size_t count = std::min(max_count, MAX_BATCH_SIZE);
+    if (count <= 1) {
+        return (PktFilter6::receiveBatch(socket_info, max_count, pkts));
+    }
 
-    pkt->setLocalAddr(IOAddress::fromBytes(AF_INET6,
-                      reinterpret_cast<const uint8_t*>(&to_addr)));
-    pkt->setRemoteAddr(IOAddress::fromBytes(AF_INET6,
-                       reinterpret_cast<const uint8_t*>(&from.sin6_addr)));
-    pkt->setRemotePort(ntohs(from.sin6_port));
-    pkt->setIndex(ifindex);
+    // The buffers are allocated on the first use only, as many users
+    // receive a single message at a time.
+    if (!batch_buf_) {
+        batch_buf_.reset(new uint8_t[MAX_BATCH_SIZE * IfaceMgr::RCVBUFSIZE]);
+        batch_control_buf_.reset(new char[MAX_BATCH_SIZE * control_buf_len_]);
+    }
 
-    Iface* received = IfaceMgr::instance().getIface(pkt->getIndex());
-    if (received) {
-        pkt->setIface(received->getName());
-    } else {
-        bundy_throw(SocketReadError, "received packet over unknown interface"
-                  << "(ifindex=" << pkt->getIndex() << ")");
+    struct mmsghdr msgs[MAX_BATCH_SIZE];
+    struct iovec iovs[MAX_BATCH_SIZE];
+    struct sockaddr_in6 from_addrs[MAX_BATCH_SIZE];
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    memset(from_addrs, 0, sizeof(from_addrs[0]) * count);
+    for (size_t i = 0; i < count; ++i) {
+        iovs[i].iov_base = &batch_buf_[i * IfaceMgr::RCVBUFSIZE];
+        iovs[i].iov_len = IfaceMgr::RCVBUFSIZE;
+        struct msghdr& m = msgs[i].msg_hdr;
+        m.msg_name = &from_addrs[i];
+        m.msg_namelen = sizeof(from_addrs[i]);
+        m.msg_iov = &iovs[i];
+        m.msg_iovlen = 1;
+        m.msg_control = &batch_control_buf_[i * control_buf_len_];
+        m.msg_controllen = control_buf_len_;
     }
 
-    return (pkt);
+    // Wait for the first message only, then take whatever is queued.
+    const int result = recvmmsg(socket_info.sockfd_, msgs, count,
+                                MSG_WAITFORONE, NULL);
+    if (result < 0) {
+        bundy_throw(SocketReadError, "failed to receive data");
+    }
 
+    // A message that can't be handled doesn't cause the other ones to be
+    // lost; they are appended before the error is reported.
+    std::string error;
+    size_t received = 0;
+    for (int i = 0; i < result; ++i) {
+        try {
+            pkts.push_back(createPacket(msgs[i].msg_hdr,
+                                        &batch_buf_[i * IfaceMgr::RCVBUFSIZE],
+                                        msgs[i].msg_len));
+            ++received;
+        } catch (const std::exception& ex) {
+            if (error.empty()) {
+                error = ex.what();
+            }
+        }
+    }
+    if (!error.empty()) {
+        bundy_throw(SocketReadError, error);
+    }
+    return (received);
+#else
+    return (PktFilter6::receiveBatch(socket_info, max_count, pkts));
+#endif
 }
 
 int
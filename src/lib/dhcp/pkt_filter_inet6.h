@@ -69,6 +69,22 @@ public:
     /// reception.
     virtual Pkt6Ptr receive(const SocketInfo& socket_info);
 
+    /// @brief Receives DHCPv6 messages already queued on the socket.
+    ///
+    /// On Linux the messages are received with a single recvmmsg() call.
+    ///
+    /// @param socket_info A structure holding socket information.
+    /// @param max_count Maximum number of messages to receive.
+    /// @param [out] pkts The received messages are appended to it.
+    ///
+    /// @return Number of the messages appended to pkts.
+    /// @throw bundy::dhcp::SocketReadError if error occurred during reception,
+    /// or if any of the received messages can't be handled. In the latter
+    /// case the other messages are appended to pkts anyway.
+    virtual size_t receiveBatch(const SocketInfo& socket_info,
+                                const size_t max_count,
+                                std::vector<Pkt6Ptr>& pkts);
+
     /// @brief Sends DHCPv6 message through a specified interface and socket.
     ///
     /// Thie function sends a DHCPv6 message through a specified interface and
@@ -90,6 +106,10 @@ private:
     size_t control_buf_len_;
     /// Control buffer, used in transmission and reception.
     boost::scoped_array<char> control_buf_;
+    /// Data buffers for the messages received by receiveBatch().
+    boost::scoped_array<uint8_t> batch_buf_;
+    /// Control buffers for the messages received by receiveBatch().
+    boost::scoped_array<char> batch_control_buf_;
 };
 
 } // namespace bundy::dhcp
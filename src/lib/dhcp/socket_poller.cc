@@ -0,0 +1,142 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+#include <dhcp/socket_poller.h>
+#include <exceptions/exceptions.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(OS_LINUX)
+#include <sys/epoll.h>
+#endif
+
+namespace {
+
+/// Maximum number of ready descriptors returned by a single epoll_wait().
+/// The remaining ones are reported by the next call.
+const int MAX_EVENTS = 64;
+
+/// @brief Converts the timeout to milliseconds, rounding up.
+int
+toMilliseconds(uint32_t timeout_sec, uint32_t timeout_usec) {
+    const uint64_t timeout = static_cast<uint64_t>(timeout_sec) * 1000 +
+        (static_cast<uint64_t>(timeout_usec) + 999) / 1000;
+    return (std::min(timeout,
+                     static_cast<uint64_t>(std::numeric_limits<int>::max())));
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+SocketPoller::SocketPoller() : epoll_fd_(-1) {
+#if defined(OS_LINUX)
+    epoll_fd_ = epoll_create(MAX_EVENTS);
+    if (epoll_fd_ < 0) {
+        bundy_throw(Unexpected, "failed to create the epoll set: "
+                    << strerror(errno));
+    }
+#endif
+}
+
+SocketPoller::~SocketPoller() {
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+void
+SocketPoller::add(int fd, size_t tag) {
+#if defined(OS_LINUX)
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = tag;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        if (errno == EEXIST) {
+            return;
+        }
+        bundy_throw(BadValue, "unable to wait for data on the socket "
+                    << fd << ": " << strerror(errno));
+    }
+#else
+    if (fd < 0) {
+        bundy_throw(BadValue, "unable to wait for data on the socket "
+                    << fd << ": invalid descriptor");
+    }
+    for (size_t i = 0; i < pollfds_.size(); ++i) {
+        if (pollfds_[i].fd == fd) {
+            return;
+        }
+    }
+    struct pollfd pfd;
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pollfds_.push_back(pfd);
+#endif
+    tags_.push_back(tag);
+}
+
+void
+SocketPoller::clear() {
+#if defined(OS_LINUX)
+    // The descriptors may have been closed already, so it's simpler to
+    // start with a new set than to delete them one by one.
+    const int epoll_fd = epoll_create(MAX_EVENTS);
+    if (epoll_fd < 0) {
+        bundy_throw(Unexpected, "failed to create the epoll set: "
+                    << strerror(errno));
+    }
+    close(epoll_fd_);
+    epoll_fd_ = epoll_fd;
+#endif
+    pollfds_.clear();
+    tags_.clear();
+}
+
+int
+SocketPoller::wait(uint32_t timeout_sec, uint32_t timeout_usec,
+                   std::vector<size_t>& ready)
+{
+    ready.clear();
+    const int timeout = toMilliseconds(timeout_sec, timeout_usec);
+
+#if defined(OS_LINUX)
+    struct epoll_event events[MAX_EVENTS];
+    const int result = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+    for (int i = 0; i < result; ++i) {
+        ready.push_back(events[i].data.u64);
+    }
+#else
+    const int result = poll(pollfds_.empty() ? NULL : &pollfds_[0],
+                            pollfds_.size(), timeout);
+    for (size_t i = 0; result > 0 && i < pollfds_.size(); ++i) {
+        if (pollfds_[i].revents != 0) {
+            ready.push_back(tags_[i]);
+        }
+    }
+#endif
+
+    return (result);
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
@@ -0,0 +1,101 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SOCKET_POLLER_H
+#define SOCKET_POLLER_H
+
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+#include <poll.h>
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Waits for data on a persistent set of socket descriptors.
+///
+/// Unlike select(), which requires the set of descriptors to be built
+/// for each call, the descriptors are registered once and only the ready
+/// ones are returned by @c SocketPoller::wait, so the cost of waiting
+/// doesn't depend on the number of sockets. Descriptors are not limited
+/// by FD_SETSIZE either.
+///
+/// On Linux the set is kept in the kernel (epoll). On other systems
+/// poll() is used with a descriptor array kept between the calls.
+///
+/// Each descriptor is registered with a tag, which is what @c wait
+/// reports for it; the caller typically uses it as an index to its own
+/// description of the socket.
+class SocketPoller : public boost::noncopyable {
+public:
+    /// @brief Constructor.
+    ///
+    /// @throw bundy::Unexpected if the kernel structures can't be created.
+    SocketPoller();
+
+    /// @brief Destructor.
+    ///
+    /// It doesn't close the registered descriptors.
+    ~SocketPoller();
+
+    /// @brief Adds a descriptor to the set.
+    ///
+    /// If the descriptor is already in the set, the call has no effect.
+    ///
+    /// @param fd descriptor to wait for.
+    /// @param tag value that identifies the descriptor in @c wait results.
+    ///
+    /// @throw bundy::BadValue if the descriptor can't be waited for.
+    void add(int fd, size_t tag);
+
+    /// @brief Removes all descriptors from the set.
+    void clear();
+
+    /// @brief Returns the number of descriptors in the set.
+    size_t size() const {
+        return (tags_.size());
+    }
+
+    /// @brief Waits for data on the descriptors.
+    ///
+    /// The timeout has a millisecond resolution; a non-zero timeout
+    /// shorter than that is rounded up.
+    ///
+    /// @param timeout_sec seconds to wait.
+    /// @param timeout_usec microseconds to wait in addition to seconds.
+    /// @param [out] ready tags of the descriptors that have data to read.
+    /// It is cleared first.
+    ///
+    /// @return number of the ready descriptors, 0 on timeout, or -1 on
+    /// error with errno set.
+    int wait(uint32_t timeout_sec, uint32_t timeout_usec,
+             std::vector<size_t>& ready);
+
+private:
+    /// Descriptor of the epoll set, -1 if poll() is used.
+    int epoll_fd_;
+
+    /// Tags of the registered descriptors, in the order of addition.
+    std::vector<size_t> tags_;
+
+    /// Descriptors of the set, used with poll().
+    std::vector<struct pollfd> pollfds_;
+};
+
+} // namespace bundy::dhcp
+} // namespace bundy
+
+#endif // SOCKET_POLLER_H
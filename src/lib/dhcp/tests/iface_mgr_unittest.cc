@@ -29,6 +29,7 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -1153,13 +1154,102 @@ TEST_F(IfaceMgrTest, sendReceive4) {
 // the quick fix. We need a more elegant (config-based) solution to disable
 // this check on affected systems only. The ticket has been submited for this
 // work: http://bundy.bundy.org/ticket/2971
+// The closed descriptor is detected when the wait times out, so a short
+// timeout is used.
 #ifndef OS_BSD
-    EXPECT_THROW(ifacemgr->receive4(10), SocketReadError);
+    EXPECT_THROW(ifacemgr->receive4(1), SocketReadError);
 #endif
 
     EXPECT_THROW(ifacemgr->send(sendPkt), SocketWriteError);
 }
 
+// Verifies that the packets queued on a socket can be received in batches
+// and that the sockets are watched after being reopened.
+TEST_F(IfaceMgrTest, receiveBatch4) {
+    scoped_ptr<NakedIfaceMgr> ifacemgr(new NakedIfaceMgr());
+
+    IOAddress lo_addr("127.0.0.1");
+    ASSERT_NO_THROW(ifacemgr->openSocket(LOOPBACK, lo_addr,
+                                         DHCP4_SERVER_PORT + 10000));
+
+    // Nothing has been sent yet.
+    vector<Pkt4Ptr> pkts;
+    EXPECT_EQ(0, ifacemgr->receiveBatch4(pkts, 10, 0, 1000));
+    EXPECT_TRUE(pkts.empty());
+
+    // Queue several packets on the socket.
+    for (int i = 0; i < 5; ++i) {
+        Pkt4Ptr pkt(new Pkt4(DHCPDISCOVER, 1000 + i));
+        pkt->setRemoteAddr(lo_addr);
+        pkt->setRemotePort(DHCP4_SERVER_PORT + 10000);
+        pkt->setIndex(1);
+        pkt->setIface(LOOPBACK);
+        ASSERT_NO_THROW(pkt->pack());
+        ASSERT_TRUE(ifacemgr->send(pkt));
+    }
+
+    // No more than the requested number of packets is received, the rest
+    // are left for the next call.
+    ASSERT_EQ(3, ifacemgr->receiveBatch4(pkts, 3, 10));
+    ASSERT_EQ(2, ifacemgr->receiveBatch4(pkts, 10, 10));
+    ASSERT_EQ(5, pkts.size());
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_NO_THROW(pkts[i]->unpack());
+        EXPECT_EQ(1000 + i, pkts[i]->getTransid());
+        EXPECT_EQ(LOOPBACK, pkts[i]->getIface());
+        EXPECT_EQ(DHCP4_SERVER_PORT + 10000, pkts[i]->getLocalPort());
+    }
+
+    // Reopen the socket on another port; the new one has to be used.
+    ifacemgr->closeSockets();
+    ASSERT_NO_THROW(ifacemgr->openSocket(LOOPBACK, lo_addr,
+                                         DHCP4_SERVER_PORT + 10001));
+    Pkt4Ptr pkt(new Pkt4(DHCPDISCOVER, 2000));
+    pkt->setRemoteAddr(lo_addr);
+    pkt->setRemotePort(DHCP4_SERVER_PORT + 10001);
+    pkt->setIndex(1);
+    pkt->setIface(LOOPBACK);
+    ASSERT_NO_THROW(pkt->pack());
+    ASSERT_TRUE(ifacemgr->send(pkt));
+
+    Pkt4Ptr rcv_pkt;
+    ASSERT_NO_THROW(rcv_pkt = ifacemgr->receive4(10));
+    ASSERT_TRUE(rcv_pkt);
+    ASSERT_NO_THROW(rcv_pkt->unpack());
+    EXPECT_EQ(2000, rcv_pkt->getTransid());
+}
+
+// Verifies that the DHCPv6 messages queued on a socket can be received in
+// batches.
+TEST_F(IfaceMgrTest, receiveBatch6) {
+    scoped_ptr<NakedIfaceMgr> ifacemgr(new NakedIfaceMgr());
+
+    IOAddress lo_addr("::1");
+    ASSERT_NO_THROW(ifacemgr->openSocket(LOOPBACK, lo_addr, 10547));
+
+    vector<Pkt6Ptr> pkts;
+    EXPECT_EQ(0, ifacemgr->receiveBatch6(pkts, 10, 0, 1000));
+    EXPECT_TRUE(pkts.empty());
+
+    for (int i = 0; i < 4; ++i) {
+        Pkt6Ptr pkt(new Pkt6(DHCPV6_SOLICIT, 1000 + i));
+        pkt->setRemoteAddr(lo_addr);
+        pkt->setRemotePort(10547);
+        pkt->setIndex(1);
+        pkt->setIface(LOOPBACK);
+        ASSERT_NO_THROW(pkt->pack());
+        ASSERT_TRUE(ifacemgr->send(pkt));
+    }
+
+    ASSERT_EQ(4, ifacemgr->receiveBatch6(pkts, 10, 10));
+    ASSERT_EQ(4, pkts.size());
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_NO_THROW(pkts[i]->unpack());
+        EXPECT_EQ(1000 + i, pkts[i]->getTransid());
+        EXPECT_EQ(lo_addr, pkts[i]->getRemoteAddr());
+    }
+}
+
 // Verifies that it is possible to set custom packet filter object
 // to handle sockets opening and send/receive operation.
 TEST_F(IfaceMgrTest, setPacketFilter) {
@@ -2664,6 +2754,38 @@ TEST_F(IfaceMgrTest, SingleExternalSocket4) {
     close(pipefd[0]);
 }
 
+// Tests that the callback of an external socket is called by
+// receiveBatch4() and that a removed socket isn't watched any more.
+TEST_F(IfaceMgrTest, ExternalSocketBatch4) {
+
+    callback_ok = false;
+
+    scoped_ptr<NakedIfaceMgr> ifacemgr(new NakedIfaceMgr());
+
+    int pipefd[2];
+    ASSERT_EQ(0, pipe(pipefd));
+    EXPECT_NO_THROW(ifacemgr->addExternalSocket(pipefd[0], my_callback));
+
+    vector<Pkt4Ptr> pkts;
+    EXPECT_EQ(0, ifacemgr->receiveBatch4(pkts, 10, 0, 1000));
+    EXPECT_FALSE(callback_ok);
+
+    EXPECT_EQ(38, write(pipefd[1], "Hi, this is a message sent over a pipe", 38));
+    EXPECT_EQ(0, ifacemgr->receiveBatch4(pkts, 10, 1));
+    EXPECT_TRUE(callback_ok);
+    EXPECT_TRUE(pkts.empty());
+
+    // The data is still in the pipe, but the callback isn't called
+    // after the socket has been removed.
+    callback_ok = false;
+    ifacemgr->deleteExternalSocket(pipefd[0]);
+    EXPECT_EQ(0, ifacemgr->receiveBatch4(pkts, 10, 0, 1000));
+    EXPECT_FALSE(callback_ok);
+
+    close(pipefd[1]);
+    close(pipefd[0]);
+}
+
 // Tests if multiple external sockets and their callbacks can be passed and
 // it is supported properly by receive4() method.
 TEST_F(IfaceMgrTest, MiltipleExternalSockets4) {
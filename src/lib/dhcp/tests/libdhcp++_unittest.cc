@@ -639,6 +639,49 @@ TEST_F(LibDhcpTest, unpackOptions4) {
 
 }
 
+// Check that the DHCPv4 options are located without being parsed.
+TEST_F(LibDhcpTest, scanOptions4) {
+    // Put some padding before the options, and the end option and padding
+    // after them.
+    vector<uint8_t> v4packed(3, 0);
+    v4packed.insert(v4packed.end(), v4_opts, v4_opts + sizeof(v4_opts));
+    v4packed.push_back(DHO_END);
+    v4packed.push_back(DHO_PAD);
+
+    OptionLocations locations;
+    size_t offset = 0;
+    ASSERT_NO_THROW(offset = LibDHCP::scanOptions4(v4packed, 2, locations));
+    // The offset after the end option is returned.
+    EXPECT_EQ(v4packed.size() - 1, offset);
+
+    const uint16_t types[] = { 12, 60, 14, 254, 128, DHO_DHCP_AGENT_OPTIONS };
+    const size_t offsets[] = { 3, 8, 13, 18, 23, 28 };
+    const size_t lens[] = { 5, 5, 5, 5, 5, 27 };
+    ASSERT_EQ(sizeof(types) / sizeof(types[0]), locations.size());
+    for (size_t i = 0; i < locations.size(); ++i) {
+        EXPECT_EQ(types[i], locations[i].type_);
+        EXPECT_EQ(offsets[i], locations[i].offset_);
+        EXPECT_EQ(lens[i], locations[i].len_);
+    }
+
+    // The located options are parsed as the whole buffer would be.
+    const OptionBuffer rai_buf(v4packed.begin() + locations[5].offset_,
+                               v4packed.begin() + locations[5].offset_ +
+                               locations[5].len_);
+    bundy::dhcp::OptionCollection options;
+    ASSERT_NO_THROW(LibDHCP::unpackOptions4(rai_buf, "dhcp4", options));
+    ASSERT_EQ(1, options.size());
+    OptionCustomPtr rai =
+        boost::dynamic_pointer_cast<OptionCustom>(options.begin()->second);
+    ASSERT_TRUE(rai);
+    EXPECT_TRUE(rai->getOption(RAI_OPTION_AGENT_CIRCUIT_ID));
+
+    // A truncated option is reported.
+    v4packed.resize(v4packed.size() - 4);
+    locations.clear();
+    EXPECT_THROW(LibDHCP::scanOptions4(v4packed, 3, locations), OutOfRange);
+}
+
 TEST_F(LibDhcpTest, isStandardOption4) {
     // Get all option codes that are not occupied by standard options.
     const uint16_t unassigned_codes[] = { 84, 96, 102, 103, 104, 105, 106, 107, 108,
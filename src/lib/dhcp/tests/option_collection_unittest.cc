@@ -0,0 +1,205 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <dhcp/option.h>
+#include <dhcp/option_collection.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <map>
+
+using namespace bundy::dhcp;
+
+namespace {
+
+typedef std::multimap<unsigned int, OptionPtr> OptionMultimap;
+
+// Creates an option of a given code.
+OptionPtr
+createOption(uint16_t type) {
+    return (OptionPtr(new Option(Option::V4, type)));
+}
+
+// Checks that a collection holds the same elements as a multimap, in
+// the same order.
+void
+checkSame(const OptionMultimap& expected, const OptionCollection& options) {
+    ASSERT_EQ(expected.size(), options.size());
+    OptionMultimap::const_iterator it = expected.begin();
+    OptionCollection::const_iterator opt = options.begin();
+    for (; it != expected.end(); ++it, ++opt) {
+        EXPECT_EQ(it->first, opt->first);
+        EXPECT_TRUE(it->second == opt->second);
+    }
+}
+
+// Checks that an empty collection can be searched.
+TEST(OptionCollectionTest, empty) {
+    OptionCollection options;
+    EXPECT_TRUE(options.empty());
+    EXPECT_EQ(0, options.size());
+    EXPECT_TRUE(options.begin() == options.end());
+    EXPECT_TRUE(options.find(1) == options.end());
+    EXPECT_EQ(0, options.count(1));
+    EXPECT_EQ(0, options.erase(1));
+}
+
+// Checks that the options are sorted by code, the options of the same code
+// being kept in the order of insertion.
+TEST(OptionCollectionTest, insert) {
+    OptionCollection options;
+    OptionPtr opt1 = createOption(1);
+    OptionPtr opt2 = createOption(2);
+    OptionPtr opt2bis = createOption(2);
+    OptionPtr opt3 = createOption(3);
+
+    EXPECT_TRUE(options.insert(std::make_pair(3, opt3))->second == opt3);
+    EXPECT_TRUE(options.insert(std::make_pair(2, opt2))->second == opt2);
+    EXPECT_TRUE(options.insert(std::make_pair(1, opt1))->second == opt1);
+    EXPECT_TRUE(options.insert(std::make_pair(2, opt2bis))->second ==
+                opt2bis);
+    ASSERT_EQ(4, options.size());
+    EXPECT_FALSE(options.empty());
+
+    OptionCollection::const_iterator it = options.begin();
+    EXPECT_TRUE(it->second == opt1);
+    EXPECT_TRUE((++it)->second == opt2);
+    EXPECT_TRUE((++it)->second == opt2bis);
+    EXPECT_TRUE((++it)->second == opt3);
+
+    EXPECT_TRUE(options.find(2)->second == opt2);
+    EXPECT_TRUE(options.find(4) == options.end());
+    EXPECT_EQ(2, options.count(2));
+    EXPECT_TRUE(options.lower_bound(2) == options.begin() + 1);
+    EXPECT_TRUE(options.upper_bound(2) == options.begin() + 3);
+    EXPECT_TRUE(options.equal_range(2).first == options.begin() + 1);
+    EXPECT_TRUE(options.equal_range(2).second == options.begin() + 3);
+}
+
+// Checks the erasure of elements.
+TEST(OptionCollectionTest, erase) {
+    OptionCollection options;
+    for (uint16_t type = 1; type <= 5; ++type) {
+        options.insert(std::make_pair(type, createOption(type)));
+        options.insert(std::make_pair(type, createOption(type)));
+    }
+    OptionPtr opt = options.find(3)->second;
+    EXPECT_EQ(2, opt.use_count());
+
+    // The element following the erased one is returned.
+    OptionCollection::iterator it = options.erase(options.find(1));
+    EXPECT_EQ(1, it->first);
+    EXPECT_EQ(9, options.size());
+
+    // The options are released when erased.
+    EXPECT_EQ(2, options.erase(3));
+    EXPECT_EQ(1, opt.use_count());
+    EXPECT_EQ(7, options.size());
+    EXPECT_TRUE(options.find(3) == options.end());
+    EXPECT_EQ(4, options.find(4)->first);
+
+    options.clear();
+    EXPECT_TRUE(options.empty());
+    EXPECT_TRUE(options.find(4) == options.end());
+}
+
+// Checks that a collection of more options than the inline capacity
+// behaves as a multimap, and that it can be copied.
+TEST(OptionCollectionTest, compareWithMultimap) {
+    const size_t count = 5 * PktOptionCollection::INLINE_CAPACITY;
+    OptionMultimap expected;
+    PktOptionCollection options;
+    srandom(1);
+    for (size_t i = 0; i < count; ++i) {
+        const uint16_t type = random() % 32;
+        OptionPtr opt = createOption(type);
+        expected.insert(std::make_pair(type, opt));
+        options.insert(std::make_pair(type, opt));
+    }
+    checkSame(expected, options);
+
+    for (uint16_t type = 0; type < 32; ++type) {
+        EXPECT_EQ(expected.count(type), options.count(type));
+        if (expected.count(type) != 0) {
+            EXPECT_TRUE(expected.find(type)->second ==
+                        options.find(type)->second);
+        }
+    }
+
+    // Copy the collection, then erase every other code of the original.
+    PktOptionCollection copy(options);
+    OptionCollection heap_copy(options);
+    for (uint16_t type = 0; type < 32; type += 2) {
+        expected.erase(type);
+        options.erase(type);
+    }
+    checkSame(expected, options);
+    EXPECT_EQ(count, copy.size());
+    EXPECT_EQ(count, heap_copy.size());
+
+    // A small collection can be assigned a large one and the reverse.
+    PktOptionCollection small;
+    small.insert(std::make_pair(1, createOption(1)));
+    small = options;
+    checkSame(expected, small);
+    options = PktOptionCollection();
+    EXPECT_TRUE(options.empty());
+}
+
+// Checks that collections with and without inline storage can be
+// assigned to each other.
+TEST(OptionCollectionTest, inlineStorage) {
+    OptionMultimap expected;
+    OptionCollection options;
+    for (uint16_t type = 1; type <= 3; ++type) {
+        OptionPtr opt = createOption(type);
+        expected.insert(std::make_pair(type, opt));
+        options.insert(std::make_pair(type, opt));
+    }
+
+    InlineOptionCollection<2> inline_options(options);
+    checkSame(expected, inline_options);
+    inline_options.erase(3);
+    EXPECT_EQ(2, inline_options.size());
+
+    OptionCollection& base = inline_options;
+    base = options;
+    checkSame(expected, inline_options);
+
+    options = inline_options;
+    checkSame(expected, options);
+    inline_options.clear();
+    EXPECT_TRUE(inline_options.empty());
+    checkSame(expected, options);
+}
+
+// Checks the insertion of ranges.
+TEST(OptionCollectionTest, insertRange) {
+    OptionMultimap expected;
+    for (uint16_t type = 10; type > 0; --type) {
+        expected.insert(std::make_pair(type, createOption(type)));
+    }
+    OptionCollection options;
+    options.insert(expected.begin(), expected.end());
+    checkSame(expected, options);
+
+    OptionCollection copy;
+    copy.insert(options.begin(), options.end());
+    checkSame(expected, copy);
+}
+
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <dhcp/libdhcp++.h>
+#include <dhcp/option.h>
+#include <dhcp/packed_options.h>
+#include <util/buffer.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace bundy::dhcp;
+using namespace bundy::util;
+
+namespace {
+
+// Creates an option of a given code holding a few bytes.
+OptionPtr
+createOption(uint16_t type, uint8_t value) {
+    return (OptionPtr(new Option(Option::V4, type, OptionBuffer(3, value))));
+}
+
+// Returns the content of a buffer.
+std::vector<uint8_t>
+getData(const OutputBuffer& buf) {
+    const uint8_t* data = static_cast<const uint8_t*>(buf.getData());
+    return (std::vector<uint8_t>(data, data + buf.getLength()));
+}
+
+// Checks that the wire format of each packed option is the one the option
+// would be packed to.
+TEST(PackedOptionsTest, pack) {
+    OptionCollection options;
+    options.insert(std::make_pair(3, createOption(3, 1)));
+    options.insert(std::make_pair(6, createOption(6, 2)));
+    options.insert(std::make_pair(6, createOption(6, 3)));
+    options.insert(std::make_pair(15, createOption(15, 4)));
+
+    PackedOptions packed(options);
+    EXPECT_EQ(4 * 5, packed.len());
+    ASSERT_EQ(options.size(), packed.getOptions().size());
+
+    for (OptionCollection::const_iterator it = options.begin();
+         it != options.end(); ++it) {
+        OutputBuffer expected(0);
+        it->second->pack(expected);
+        OutputBuffer buf(0);
+        ASSERT_TRUE(packed.pack(it->second, buf));
+        EXPECT_TRUE(getData(expected) == getData(buf));
+    }
+
+    // An option which was not packed is not written, even if an option
+    // of the same code was.
+    OutputBuffer buf(0);
+    EXPECT_FALSE(packed.pack(createOption(6, 2), buf));
+    EXPECT_FALSE(packed.pack(createOption(7, 2), buf));
+    EXPECT_EQ(0, buf.getLength());
+}
+
+// Checks that packing a collection with packed options gives the same
+// result as packing the options, those not packed beforehand included.
+TEST(PackedOptionsTest, packOptions) {
+    OptionCollection options;
+    options.insert(std::make_pair(3, createOption(3, 1)));
+    options.insert(std::make_pair(15, createOption(15, 4)));
+    PackedOptions packed(options);
+    options.insert(std::make_pair(6, createOption(6, 2)));
+
+    OutputBuffer expected(0);
+    LibDHCP::packOptions(expected, options);
+    OutputBuffer buf(0);
+    LibDHCP::packOptions(buf, options, &packed);
+    EXPECT_TRUE(getData(expected) == getData(buf));
+
+    // Empty collections can be packed too.
+    PackedOptions empty((OptionCollection()));
+    EXPECT_EQ(0, empty.len());
+    OutputBuffer empty_buf(0);
+    LibDHCP::packOptions(empty_buf, OptionCollection(), &empty);
+    EXPECT_EQ(0, empty_buf.getLength());
+}
+
+}
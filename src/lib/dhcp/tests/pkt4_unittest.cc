@@ -1,4 +1,4 @@
-// Copyright (C) 2011-2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2011-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -23,6 +23,7 @@
 #include <exceptions/exceptions.h>
 #include <util/buffer.h>
 
+#include <boost/bind.hpp>
 #include <boost/shared_array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/static_assert.hpp>
@@ -693,6 +694,175 @@ TEST_F(Pkt4Test, unpackOptionsWithCallback) {
 
 }
 
+// This test verifies that the options are created when they are requested
+// with lazy unpacking, and that they are the same as without it.
+TEST_F(Pkt4Test, lazyUnpack) {
+    vector<uint8_t> expectedFormat = generateTestPacket2();
+
+    expectedFormat.push_back(0x63);
+    expectedFormat.push_back(0x82);
+    expectedFormat.push_back(0x53);
+    expectedFormat.push_back(0x63);
+
+    for (int i = 0; i < sizeof(v4_opts); i++) {
+        expectedFormat.push_back(v4_opts[i]);
+    }
+
+    boost::shared_ptr<Pkt4> pkt(new Pkt4(&expectedFormat[0],
+                                         expectedFormat.size()));
+    EXPECT_FALSE(pkt->getLazyUnpack());
+    pkt->setLazyUnpack(true);
+    EXPECT_TRUE(pkt->getLazyUnpack());
+
+    CustomUnpackCallback cb;
+    pkt->setCallback(boost::bind(&CustomUnpackCallback::execute, &cb,
+                                 _1, _2, _3));
+    ASSERT_NO_THROW(pkt->unpack());
+    EXPECT_EQ(DHCPOFFER, pkt->getType());
+
+    // The option is created when it is requested for the first time.
+    cb.executed_ = false;
+    EXPECT_TRUE(pkt->getOption(12));
+    EXPECT_TRUE(cb.executed_);
+    cb.executed_ = false;
+    EXPECT_TRUE(pkt->getOption(12));
+    EXPECT_FALSE(cb.executed_);
+
+    // Nothing is parsed for an option which is not in the packet.
+    EXPECT_FALSE(pkt->getOption(13));
+    EXPECT_FALSE(cb.executed_);
+
+    verifyParsedOptions(pkt);
+
+    // The packet built from the options is the same as without lazy
+    // unpacking.
+    boost::shared_ptr<Pkt4> eager_pkt(new Pkt4(&expectedFormat[0],
+                                               expectedFormat.size()));
+    ASSERT_NO_THROW(eager_pkt->unpack());
+    pkt.reset(new Pkt4(&expectedFormat[0], expectedFormat.size()));
+    pkt->setLazyUnpack(true);
+    ASSERT_NO_THROW(pkt->unpack());
+    EXPECT_EQ(eager_pkt->len(), pkt->len());
+    ASSERT_NO_THROW(eager_pkt->pack());
+    ASSERT_NO_THROW(pkt->pack());
+    ASSERT_EQ(eager_pkt->getBuffer().getLength(),
+              pkt->getBuffer().getLength());
+    EXPECT_EQ(0, memcmp(eager_pkt->getBuffer().getData(),
+                        pkt->getBuffer().getData(),
+                        pkt->getBuffer().getLength()));
+}
+
+// This test verifies that options which were not created yet can be
+// deleted or replaced with lazy unpacking.
+TEST_F(Pkt4Test, lazyUnpackDelOption) {
+    vector<uint8_t> expectedFormat = generateTestPacket2();
+
+    expectedFormat.push_back(0x63);
+    expectedFormat.push_back(0x82);
+    expectedFormat.push_back(0x53);
+    expectedFormat.push_back(0x63);
+
+    for (int i = 0; i < sizeof(v4_opts); i++) {
+        expectedFormat.push_back(v4_opts[i]);
+    }
+
+    boost::shared_ptr<Pkt4> pkt(new Pkt4(&expectedFormat[0],
+                                         expectedFormat.size()));
+    pkt->setLazyUnpack(true);
+    ASSERT_NO_THROW(pkt->unpack());
+
+    EXPECT_TRUE(pkt->delOption(14));
+    EXPECT_FALSE(pkt->getOption(14));
+    EXPECT_FALSE(pkt->delOption(14));
+
+    // The option is in the packet already.
+    OptionPtr option(new Option(Option::V4, 60));
+    EXPECT_THROW(pkt->addOption(option), BadValue);
+    EXPECT_TRUE(pkt->delOption(60));
+    EXPECT_NO_THROW(pkt->addOption(option));
+    EXPECT_EQ(option, pkt->getOption(60));
+}
+
+// This test verifies that with lazy unpacking, an option which is not valid
+// is reported when it is requested.
+TEST_F(Pkt4Test, lazyUnpackInvalidOption) {
+    vector<uint8_t> expectedFormat = generateTestPacket2();
+
+    expectedFormat.push_back(0x63);
+    expectedFormat.push_back(0x82);
+    expectedFormat.push_back(0x53);
+    expectedFormat.push_back(0x63);
+
+    for (int i = 0; i < sizeof(v4_opts); i++) {
+        expectedFormat.push_back(v4_opts[i]);
+    }
+
+    // The lease time option holds a 32-bit value, it is truncated.
+    expectedFormat.push_back(DHO_DHCP_LEASE_TIME);
+    expectedFormat.push_back(2);
+    expectedFormat.push_back(0);
+    expectedFormat.push_back(1);
+
+    boost::shared_ptr<Pkt4> pkt(new Pkt4(&expectedFormat[0],
+                                         expectedFormat.size()));
+    EXPECT_THROW(pkt->unpack(), InvalidOptionValue);
+
+    pkt.reset(new Pkt4(&expectedFormat[0], expectedFormat.size()));
+    pkt->setLazyUnpack(true);
+    ASSERT_NO_THROW(pkt->unpack());
+    verifyParsedOptions(pkt);
+
+    // The error is reported each time the option is requested.
+    EXPECT_THROW(pkt->getOption(DHO_DHCP_LEASE_TIME), InvalidOptionValue);
+    EXPECT_THROW(pkt->getOption(DHO_DHCP_LEASE_TIME), InvalidOptionValue);
+    EXPECT_THROW(pkt->pack(), InvalidOperation);
+
+    // A truncated option header is still reported by unpack.
+    expectedFormat.resize(expectedFormat.size() - 1);
+    pkt.reset(new Pkt4(&expectedFormat[0], expectedFormat.size()));
+    pkt->setLazyUnpack(true);
+    EXPECT_THROW(pkt->unpack(), OutOfRange);
+}
+
+// This test verifies that options packed beforehand are added to a packet
+// unless it holds options of the same codes, and that the packet is packed
+// as if they were added one by one.
+TEST_F(Pkt4Test, addPackedOptions) {
+    OptionCollection options;
+    OptionPtr opt3(new Option(Option::V4, 3, OptionBuffer(4, 1)));
+    OptionPtr opt6(new Option(Option::V4, 6, OptionBuffer(8, 2)));
+    OptionPtr opt15(new Option(Option::V4, 15, OptionBuffer(5, 3)));
+    options.insert(make_pair(3, opt3));
+    options.insert(make_pair(6, opt6));
+    options.insert(make_pair(15, opt15));
+    ConstPackedOptionsPtr packed(new PackedOptions(options));
+
+    // The packet already holds an option 6.
+    OptionPtr other6(new Option(Option::V4, 6, OptionBuffer(4, 4)));
+    Pkt4 pkt(DHCPOFFER, 1234);
+    pkt.addOption(other6);
+    pkt.addOptions(packed);
+    EXPECT_EQ(opt3, pkt.getOption(3));
+    EXPECT_EQ(other6, pkt.getOption(6));
+    EXPECT_EQ(opt15, pkt.getOption(15));
+
+    // An added option can be replaced.
+    OptionPtr other15(new Option(Option::V4, 15, OptionBuffer(2, 5)));
+    EXPECT_TRUE(pkt.delOption(15));
+    pkt.addOption(other15);
+    ASSERT_NO_THROW(pkt.pack());
+
+    Pkt4 expected(DHCPOFFER, 1234);
+    expected.addOption(other6);
+    expected.addOption(opt3);
+    expected.addOption(other15);
+    ASSERT_NO_THROW(expected.pack());
+    ASSERT_EQ(expected.getBuffer().getLength(), pkt.getBuffer().getLength());
+    EXPECT_EQ(0, memcmp(expected.getBuffer().getData(),
+                        pkt.getBuffer().getData(),
+                        pkt.getBuffer().getLength()));
+}
+
 // This test verifies methods that are used for manipulating meta fields
 // i.e. fields that are not part of DHCPv4 (e.g. interface name).
 TEST_F(Pkt4Test, metaFields) {
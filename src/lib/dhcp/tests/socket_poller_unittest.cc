@@ -0,0 +1,113 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+#include <dhcp/socket_poller.h>
+#include <exceptions/exceptions.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <unistd.h>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+
+namespace {
+
+class SocketPollerTest : public ::testing::Test {
+public:
+    SocketPollerTest() {
+        pipe1_[0] = pipe1_[1] = pipe2_[0] = pipe2_[1] = -1;
+        EXPECT_EQ(0, pipe(pipe1_));
+        EXPECT_EQ(0, pipe(pipe2_));
+    }
+
+    ~SocketPollerTest() {
+        close(pipe1_[0]);
+        close(pipe1_[1]);
+        close(pipe2_[0]);
+        close(pipe2_[1]);
+    }
+
+    SocketPoller poller_;
+    std::vector<size_t> ready_;
+    int pipe1_[2];
+    int pipe2_[2];
+};
+
+// Only the descriptors with data are reported, with their tags.
+TEST_F(SocketPollerTest, wait) {
+    poller_.add(pipe1_[0], 1);
+    poller_.add(pipe2_[0], 2);
+    EXPECT_EQ(2, poller_.size());
+
+    // Nothing to read, times out
+    EXPECT_EQ(0, poller_.wait(0, 1000, ready_));
+    EXPECT_TRUE(ready_.empty());
+
+    ASSERT_EQ(1, write(pipe2_[1], "x", 1));
+    ASSERT_EQ(1, poller_.wait(1, 0, ready_));
+    ASSERT_EQ(1, ready_.size());
+    EXPECT_EQ(2, ready_[0]);
+
+    // The descriptor stays ready until the data is read
+    ASSERT_EQ(1, write(pipe1_[1], "x", 1));
+    ASSERT_EQ(2, poller_.wait(1, 0, ready_));
+    ASSERT_EQ(2, ready_.size());
+    EXPECT_EQ(3, ready_[0] + ready_[1]);
+
+    char buf[1];
+    ASSERT_EQ(1, read(pipe2_[0], buf, 1));
+    ASSERT_EQ(1, poller_.wait(1, 0, ready_));
+    ASSERT_EQ(1, ready_.size());
+    EXPECT_EQ(1, ready_[0]);
+}
+
+// Adding a descriptor twice has no effect.
+TEST_F(SocketPollerTest, duplicate) {
+    poller_.add(pipe1_[0], 1);
+    poller_.add(pipe1_[0], 2);
+    EXPECT_EQ(1, poller_.size());
+
+    ASSERT_EQ(1, write(pipe1_[1], "x", 1));
+    ASSERT_EQ(1, poller_.wait(1, 0, ready_));
+    ASSERT_EQ(1, ready_.size());
+    EXPECT_EQ(1, ready_[0]);
+}
+
+// Removed descriptors are no longer reported.
+TEST_F(SocketPollerTest, clear) {
+    poller_.add(pipe1_[0], 1);
+    ASSERT_EQ(1, write(pipe1_[1], "x", 1));
+    poller_.clear();
+    EXPECT_EQ(0, poller_.size());
+    EXPECT_EQ(0, poller_.wait(0, 1000, ready_));
+    EXPECT_TRUE(ready_.empty());
+
+    // It can be reused after clearing
+    poller_.add(pipe1_[0], 3);
+    ASSERT_EQ(1, poller_.wait(1, 0, ready_));
+    ASSERT_EQ(1, ready_.size());
+    EXPECT_EQ(3, ready_[0]);
+}
+
+// Invalid descriptors are rejected.
+TEST_F(SocketPollerTest, badDescriptor) {
+    EXPECT_THROW(poller_.add(-1, 1), BadValue);
+    EXPECT_EQ(0, poller_.size());
+}
+
+}
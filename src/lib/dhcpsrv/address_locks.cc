@@ -0,0 +1,63 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/address_locks.h>
+#include <exceptions/exceptions.h>
+
+#include <stdint.h>
+#include <vector>
+
+using namespace bundy::asiolink;
+using bundy::util::thread::Mutex;
+
+namespace bundy {
+namespace dhcp {
+
+const size_t AddressLocks::DEFAULT_STRIPES;
+
+AddressLocks::AddressLocks(size_t stripes) :
+    stripe_count_(stripes)
+{
+    if (stripes == 0) {
+        bundy_throw(BadValue, "number of address lock stripes must not be 0");
+    }
+    mutexes_.reset(new Mutex[stripes]);
+}
+
+size_t
+AddressLocks::getStripe(const IOAddress& addr) const {
+    uint32_t hash;
+    if (addr.isV4()) {
+        hash = static_cast<uint32_t>(addr);
+    } else {
+        // FNV-1a over the address.
+        const std::vector<uint8_t> bytes = addr.toBytes();
+        hash = 2166136261U;
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            hash = (hash ^ bytes[i]) * 16777619U;
+        }
+    }
+    // Consecutive addresses (the usual result of the iterative allocator)
+    // map to different mutexes.
+    return ((hash ^ (hash >> 16)) % stripe_count_);
+}
+
+AddressLocks&
+AddressLocks::instance() {
+    static AddressLocks locks;
+    return (locks);
+}
+
+} // namespace dhcp
+} // namespace bundy
@@ -0,0 +1,99 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef ADDRESS_LOCKS_H
+#define ADDRESS_LOCKS_H
+
+#include <asiolink/io_address.h>
+#include <util/threads/sync.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+#include <stddef.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Locks protecting the allocation of individual addresses
+///
+/// When the server processes packets in several threads, two threads may
+/// find the same address free (or its lease expired) at the same time and
+/// both try to allocate it.  To prevent that, the allocation engine holds
+/// the lock of the address between checking the lease of the address and
+/// storing the new lease.
+///
+/// Having a mutex for every address would take too much memory, so the
+/// addresses are hashed to a fixed number of mutexes ("stripes").  Two
+/// different addresses may share a mutex, so a thread must never hold more
+/// than one of these locks at a time, or the threads could deadlock.
+class AddressLocks : public boost::noncopyable {
+public:
+    /// @brief Number of mutexes used by default
+    static const size_t DEFAULT_STRIPES = 256;
+
+    /// @brief Holds the lock of an address
+    ///
+    /// The lock is acquired by the constructor and released by the
+    /// destructor.
+    class Locker : public boost::noncopyable {
+    public:
+        /// @brief Constructor
+        ///
+        /// Blocks until the lock of the address is available.
+        ///
+        /// @param locks Locks to take the lock from.
+        /// @param addr The address to be locked.
+        Locker(AddressLocks& locks, const bundy::asiolink::IOAddress& addr) :
+            locker_(locks.getMutex(addr))
+        {}
+
+    private:
+        bundy::util::thread::Mutex::Locker locker_;
+    };
+
+    /// @brief Constructor
+    ///
+    /// @param stripes Number of mutexes the addresses are hashed to.
+    /// @throw bundy::BadValue stripes is 0.
+    explicit AddressLocks(size_t stripes = DEFAULT_STRIPES);
+
+    /// @brief Returns the number of the mutex protecting the address
+    ///
+    /// @param addr An IPv4 or IPv6 address.
+    size_t getStripe(const bundy::asiolink::IOAddress& addr) const;
+
+    /// @brief Returns the number of mutexes
+    size_t getStripeCount() const {
+        return (stripe_count_);
+    }
+
+    /// @brief Returns the locks shared by all allocation engines
+    static AddressLocks& instance();
+
+private:
+    /// @brief Returns the mutex protecting the address
+    bundy::util::thread::Mutex& getMutex(const bundy::asiolink::IOAddress&
+                                         addr) {
+        return (mutexes_[getStripe(addr)]);
+    }
+
+    const size_t stripe_count_;
+    boost::scoped_array<bundy::util::thread::Mutex> mutexes_;
+};
+
+} // namespace dhcp
+} // namespace bundy
+
+#endif // ADDRESS_LOCKS_H
@@ -0,0 +1,267 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/address_permutation.h>
+#include <dhcpsrv/pool.h>
+#include <exceptions/exceptions.h>
+
+#include <vector>
+
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace bundy::asiolink;
+using bundy::util::thread::Mutex;
+
+namespace {
+
+/// @brief Number of rounds of the Feistel network.
+const unsigned int ROUND_COUNT = 4;
+
+/// @brief The finalizer of the splitmix64 generator, it mixes the bits
+/// of a word.
+uint64_t
+mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return (value);
+}
+
+/// @brief A 128-bit unsigned integer, holding IPv6 addresses.
+struct Word128 {
+    uint64_t high;
+    uint64_t low;
+};
+
+/// @brief Converts an address to a 128-bit integer (IPv4 addresses are
+/// in the low word).
+Word128
+toWord(const IOAddress& addr) {
+    Word128 word = { 0, 0 };
+    const std::vector<uint8_t> bytes = addr.toBytes();
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        word.high = (word.high << 8) | (word.low >> 56);
+        word.low = (word.low << 8) | bytes[i];
+    }
+    return (word);
+}
+
+/// @brief Converts a 128-bit integer to an address of the given family.
+IOAddress
+fromWord(short family, const Word128& word) {
+    if (family == AF_INET) {
+        return (IOAddress(static_cast<uint32_t>(word.low)));
+    }
+    uint8_t bytes[16];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<uint8_t>(word.high >> (56 - 8 * i));
+        bytes[8 + i] = static_cast<uint8_t>(word.low >> (56 - 8 * i));
+    }
+    return (IOAddress::fromBytes(AF_INET6, bytes));
+}
+
+/// @brief Returns the number of low bits of the addresses which are not
+/// part of the prefixes of the pool (0 unless the pool is a prefix pool).
+unsigned int
+getShift(const bundy::dhcp::Pool& pool) {
+    if (pool.getType() != bundy::dhcp::Lease::TYPE_PD) {
+        return (0);
+    }
+    const bundy::dhcp::Pool6* pool6 =
+        dynamic_cast<const bundy::dhcp::Pool6*>(&pool);
+    return (pool6 ? 128 - pool6->getLength() : 0);
+}
+
+/// @brief Returns the offset of the address in the pool in units of
+/// prefixes, capped at the maximum size of a permutation.
+///
+/// @return false if the address is before the pool.
+bool
+getOffset(const bundy::dhcp::Pool& pool, const IOAddress& addr,
+          uint64_t& offset) {
+    const Word128 first = toWord(pool.getFirstAddress());
+    const Word128 value = toWord(addr);
+    if (value.high < first.high ||
+        (value.high == first.high && value.low < first.low)) {
+        return (false);
+    }
+    Word128 diff;
+    diff.low = value.low - first.low;
+    diff.high = value.high - first.high - (value.low < first.low ? 1 : 0);
+    const unsigned int shift = getShift(pool);
+    if (shift >= 64) {
+        diff.low = diff.high >> (shift - 64);
+        diff.high = 0;
+    } else if (shift > 0) {
+        diff.low = (diff.low >> shift) | (diff.high << (64 - shift));
+        diff.high >>= shift;
+    }
+    offset = (diff.high != 0 ||
+              diff.low > bundy::dhcp::IndexPermutation::MAX_SIZE) ?
+        bundy::dhcp::IndexPermutation::MAX_SIZE : diff.low;
+    return (true);
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+const uint64_t IndexPermutation::MAX_SIZE;
+
+IndexPermutation::IndexPermutation(uint64_t size, uint64_t key) :
+    size_(size), key_(key), half_bits_(1), half_mask_(1)
+{
+    if (size == 0 || size > MAX_SIZE) {
+        bundy_throw(BadValue, "invalid permutation size " << size);
+    }
+    unsigned int bits = 0;
+    while (bits < 64 && ((size - 1) >> bits) != 0) {
+        ++bits;
+    }
+    if (bits > 2) {
+        half_bits_ = (bits + 1) / 2;
+    }
+    half_mask_ = (static_cast<uint64_t>(1) << half_bits_) - 1;
+}
+
+uint64_t
+IndexPermutation::round(uint64_t half, unsigned int number) const {
+    return (mix(half ^ key_ ^ ((number + 1) * 0x9e3779b97f4a7c15ULL)) &
+            half_mask_);
+}
+
+uint64_t
+IndexPermutation::permute(uint64_t index) const {
+    // Cycle walking: the network permutes a range larger than the size,
+    // so the values out of the size are permuted again until one falls
+    // in it.  As the starting value is in the size, this ends.
+    uint64_t value = index;
+    do {
+        uint64_t left = value >> half_bits_;
+        uint64_t right = value & half_mask_;
+        for (unsigned int r = 0; r < ROUND_COUNT; ++r) {
+            const uint64_t next = left ^ round(right, r);
+            left = right;
+            right = next;
+        }
+        value = (left << half_bits_) | right;
+    } while (value >= size_);
+    return (value);
+}
+
+uint64_t
+IndexPermutation::unpermute(uint64_t value) const {
+    uint64_t index = value;
+    do {
+        uint64_t left = index >> half_bits_;
+        uint64_t right = index & half_mask_;
+        for (unsigned int r = ROUND_COUNT; r > 0; --r) {
+            const uint64_t previous = right ^ round(left, r - 1);
+            right = left;
+            left = previous;
+        }
+        index = (left << half_bits_) | right;
+    } while (index >= size_);
+    return (index);
+}
+
+PoolPermutation::PoolPermutation(const Pool& pool) :
+    pool_(pool), permutation_(getPoolCapacity(pool), getRandomKey()),
+    position_(0)
+{
+}
+
+IOAddress
+PoolPermutation::next() {
+    uint64_t index;
+    {
+        Mutex::Locker locker(mutex_);
+        if (position_ == permutation_.getSize()) {
+            // All the addresses were returned, go on with another order.
+            permutation_ = IndexPermutation(permutation_.getSize(),
+                                            getRandomKey());
+            position_ = 0;
+        }
+        index = permutation_.permute(position_++);
+    }
+    return (getPoolAddress(pool_, index));
+}
+
+uint64_t
+getPoolCapacity(const Pool& pool) {
+    uint64_t offset = 0;
+    getOffset(pool, pool.getLastAddress(), offset);
+    return (offset < IndexPermutation::MAX_SIZE ? offset + 1 :
+            IndexPermutation::MAX_SIZE);
+}
+
+IOAddress
+getPoolAddress(const Pool& pool, uint64_t index) {
+    const unsigned int shift = getShift(pool);
+    Word128 add = { 0, index };
+    if (shift >= 64) {
+        add.high = index << (shift - 64);
+        add.low = 0;
+    } else if (shift > 0) {
+        add.high = index >> (64 - shift);
+        add.low = index << shift;
+    }
+    Word128 word = toWord(pool.getFirstAddress());
+    word.low += add.low;
+    word.high += add.high + (word.low < add.low ? 1 : 0);
+    return (fromWord(pool.getFirstAddress().getFamily(), word));
+}
+
+bool
+getPoolIndex(const Pool& pool, const IOAddress& addr, uint64_t& index) {
+    if (addr.getFamily() != pool.getFirstAddress().getFamily() ||
+        !pool.inRange(addr) || !getOffset(pool, addr, index)) {
+        return (false);
+    }
+    return (index < getPoolCapacity(pool));
+}
+
+uint64_t
+getRandomKey() {
+    static Mutex mutex;
+    static uint64_t counter = 0;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t seed = (static_cast<uint64_t>(now.tv_sec) << 20) ^
+        static_cast<uint64_t>(now.tv_usec) ^
+        (static_cast<uint64_t>(getpid()) << 40);
+    {
+        Mutex::Locker locker(mutex);
+        seed ^= ++counter * 0x9e3779b97f4a7c15ULL;
+    }
+    return (mix(seed));
+}
+
+uint64_t
+hashBuffer(const uint8_t* data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return (hash);
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
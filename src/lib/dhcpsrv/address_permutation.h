@@ -0,0 +1,145 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef ADDRESS_PERMUTATION_H
+#define ADDRESS_PERMUTATION_H
+
+#include <asiolink/io_address.h>
+#include <util/threads/sync.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+class Pool;
+
+/// @brief Pseudo-random permutation of the integers from 0 to size - 1
+///
+/// The permutation is defined by a key, and it is computed rather than
+/// stored, so it takes no memory whatever the size.  It is a small Feistel
+/// network over the smallest range of an even number of bits holding the
+/// size, restricted to the size by cycle walking (values out of range are
+/// permuted again until they fall in range).  It is not meant to be
+/// cryptographically strong, only to spread the values evenly.
+class IndexPermutation {
+public:
+    /// @brief The maximum size of a permutation.
+    static const uint64_t MAX_SIZE = static_cast<uint64_t>(1) << 62;
+
+    /// @brief Constructor.
+    ///
+    /// @param size the number of integers permuted.
+    /// @param key the key selecting the permutation.
+    ///
+    /// @throw BadValue if the size is 0 or larger than @c MAX_SIZE.
+    IndexPermutation(uint64_t size, uint64_t key);
+
+    /// @brief Returns the number of integers permuted.
+    uint64_t getSize() const {
+        return (size_);
+    }
+
+    /// @brief Returns the value an integer is mapped to.
+    ///
+    /// @param index integer lower than the size.
+    uint64_t permute(uint64_t index) const;
+
+    /// @brief Returns the integer mapped to a value (the inverse of
+    /// @c permute).
+    ///
+    /// @param value integer lower than the size.
+    uint64_t unpermute(uint64_t value) const;
+
+private:
+    /// @brief The round function of the Feistel network.
+    uint64_t round(uint64_t half, unsigned int number) const;
+
+    uint64_t size_;
+    uint64_t key_;
+
+    /// @brief Number of bits of each half of the permuted values.
+    unsigned int half_bits_;
+    uint64_t half_mask_;
+};
+
+/// @brief Random order of the addresses of a pool
+///
+/// The addresses (or prefixes) of a pool are returned one after another in
+/// the order of a random permutation, so no address is returned twice
+/// before all of them have been returned.  Then a new permutation is used.
+///
+/// The methods may be called from multiple threads.
+class PoolPermutation : public boost::noncopyable {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param pool the pool, pools larger than
+    /// @c IndexPermutation::MAX_SIZE are restricted to their beginning.
+    explicit PoolPermutation(const Pool& pool);
+
+    /// @brief Returns the next address of the permutation.
+    bundy::asiolink::IOAddress next();
+
+private:
+    /// @brief The pool.
+    const Pool& pool_;
+
+    /// @brief The current permutation.
+    IndexPermutation permutation_;
+
+    /// @brief Number of addresses returned from the current permutation.
+    uint64_t position_;
+
+    /// @brief Protects the position and permutation.
+    bundy::util::thread::Mutex mutex_;
+};
+
+/// @brief A pointer to a @c PoolPermutation.
+typedef boost::shared_ptr<PoolPermutation> PoolPermutationPtr;
+
+/// @brief Returns the number of addresses (or prefixes for prefix pools)
+/// of a pool, but not more than @c IndexPermutation::MAX_SIZE.
+uint64_t getPoolCapacity(const Pool& pool);
+
+/// @brief Returns the address (or prefix) of a pool at the given position.
+///
+/// @param pool the pool.
+/// @param index position of the address, lower than the capacity.
+bundy::asiolink::IOAddress getPoolAddress(const Pool& pool, uint64_t index);
+
+/// @brief Returns the position of an address (or prefix) in a pool.
+///
+/// @param pool the pool.
+/// @param addr the address.
+/// @param [out] index position of the address.
+///
+/// @return false if the address is not at a position lower than the
+/// capacity of the pool.
+bool getPoolIndex(const Pool& pool, const bundy::asiolink::IOAddress& addr,
+                  uint64_t& index);
+
+/// @brief Returns a random key for a permutation.
+uint64_t getRandomKey();
+
+/// @brief 64-bit FNV-1a hash of a buffer.
+uint64_t hashBuffer(const uint8_t* data, size_t length);
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // ADDRESS_PERMUTATION_H
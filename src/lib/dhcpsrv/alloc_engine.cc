@@ -12,19 +12,24 @@
 // OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <dhcpsrv/address_locks.h>
 #include <dhcpsrv/alloc_engine.h>
+#include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/dhcpsrv_log.h>
 #include <dhcpsrv/lease_mgr_factory.h>
 
 #include <hooks/server_hooks.h>
 #include <hooks/hooks_manager.h>
+#include <util/threads/sync.h>
 
 #include <cstring>
+#include <map>
 #include <vector>
 #include <string.h>
 
 using namespace bundy::asiolink;
 using namespace bundy::hooks;
+using bundy::util::thread::Mutex;
 
 namespace {
 
@@ -34,11 +39,29 @@ struct AllocEngineHooks {
     int hook_index_lease4_renew_;  ///< index for "lease4_renew" hook point
     int hook_index_lease6_select_; ///< index for "lease6_receive" hook point
 
-    /// Constructor that registers hook points for AllocationEngine
+    int arg_subnet4_;           ///< index of the "subnet4" argument
+    int arg_subnet6_;           ///< index of the "subnet6" argument
+    int arg_clientid_;          ///< index of the "clientid" argument
+    int arg_hwaddr_;            ///< index of the "hwaddr" argument
+    int arg_fake_allocation_;   ///< index of the "fake_allocation" argument
+    int arg_lease4_;            ///< index of the "lease4" argument
+    int arg_lease6_;            ///< index of the "lease6" argument
+
+    /// Constructor that registers hook points and callout arguments for
+    /// AllocationEngine
     AllocEngineHooks() {
         hook_index_lease4_select_ = HooksManager::registerHook("lease4_select");
         hook_index_lease4_renew_  = HooksManager::registerHook("lease4_renew");
         hook_index_lease6_select_ = HooksManager::registerHook("lease6_select");
+
+        arg_subnet4_         = HooksManager::registerArgument("subnet4");
+        arg_subnet6_         = HooksManager::registerArgument("subnet6");
+        arg_clientid_        = HooksManager::registerArgument("clientid");
+        arg_hwaddr_          = HooksManager::registerArgument("hwaddr");
+        arg_fake_allocation_ =
+            HooksManager::registerArgument("fake_allocation");
+        arg_lease4_          = HooksManager::registerArgument("lease4");
+        arg_lease6_          = HooksManager::registerArgument("lease6");
     }
 };
 
@@ -48,11 +71,187 @@ struct AllocEngineHooks {
 // module is called.
 AllocEngineHooks Hooks;
 
+// Protects the last allocated addresses of the subnets, which are shared by
+// the allocation engines of all threads.
+Mutex last_allocated_mutex;
+
+// Protects the creation of the random orders of the addresses of the pools.
+Mutex permutations_mutex;
+
 }; // anonymous namespace
 
 namespace bundy {
 namespace dhcp {
 
+namespace {
+
+// Returns the map of the free addresses of an IPv4 pool, building it from
+// the lease database if the pool doesn't have one yet.  Returns NULL if the
+// pool is too large to be mapped.  The caller must hold the
+// last_allocated_mutex, so that the map of a pool is built only once.
+//
+// A lease added or deleted by another thread while the map is being built
+// may be missed.  That is harmless: the addresses are checked in the
+// database before being allocated and the map is corrected then, and an
+// address wrongly marked as used is found when the pools are exhausted.
+FreeAddressMapPtr
+getFreeAddresses(Pool& pool) {
+    FreeAddressMapPtr free_addresses = pool.getFreeAddresses();
+    if (free_addresses) {
+        return (free_addresses);
+    }
+
+    const IOAddress& first = pool.getFirstAddress();
+    const IOAddress& last = pool.getLastAddress();
+    if (static_cast<uint32_t>(last) - static_cast<uint32_t>(first) >=
+        FreeAddressMap::MAX_SIZE) {
+        return (FreeAddressMapPtr());
+    }
+    free_addresses.reset(new FreeAddressMap(first, last));
+    const Lease4Collection leases =
+        LeaseMgrFactory::instance().getLeases4(first, last);
+    for (Lease4Collection::const_iterator lease = leases.begin();
+         lease != leases.end(); ++lease) {
+        free_addresses->markUsed((*lease)->addr_);
+    }
+    pool.setFreeAddresses(free_addresses);
+    return (free_addresses);
+}
+
+// Finds a free address in the IPv4 pools, starting after the last allocated
+// address and wrapping around to the first pool.  Returns false if there is
+// none, or if some of the pools can't be mapped.
+bool
+pickFreeAddress(const PoolCollection& pools, const IOAddress& last,
+                IOAddress& next) {
+    std::vector<FreeAddressMapPtr> maps;
+    maps.reserve(pools.size());
+    for (PoolCollection::const_iterator pool = pools.begin();
+         pool != pools.end(); ++pool) {
+        maps.push_back(getFreeAddresses(**pool));
+        if (!maps.back()) {
+            return (false);
+        }
+    }
+
+    size_t start = 0;
+    while (start < pools.size() && !pools[start]->inRange(last)) {
+        ++start;
+    }
+    const bool after_last = start < pools.size();
+    if (!after_last) {
+        start = 0;
+    }
+
+    // The pool of the last allocated address is searched after it first,
+    // and from its beginning once all the other pools have been searched.
+    for (size_t i = 0; i <= pools.size(); ++i) {
+        const size_t index = (start + i) % pools.size();
+        if (i == 0 && after_last) {
+            if (last == pools[index]->getLastAddress()) {
+                continue;
+            }
+            if (maps[index]->findFree(IOAddress(static_cast<uint32_t>(last) +
+                                                1), next)) {
+                return (true);
+            }
+        } else if (i == pools.size() && !after_last) {
+            break;
+        } else if (maps[index]->findFree(pools[index]->getFirstAddress(),
+                                         next)) {
+            return (true);
+        }
+    }
+    return (false);
+}
+
+// Updates the map of the free addresses of the pool the address belongs to,
+// if the pool has one.
+void
+markAddress(const SubnetPtr& subnet, const IOAddress& addr, bool free) {
+    if (!subnet || !addr.isV4()) {
+        return;
+    }
+    const PoolPtr pool = subnet->getPool(Lease::TYPE_V4, addr, false);
+    if (pool) {
+        const FreeAddressMapPtr free_addresses = pool->getFreeAddresses();
+        if (free_addresses) {
+            if (free) {
+                free_addresses->markFree(addr);
+            } else {
+                free_addresses->markUsed(addr);
+            }
+        }
+    }
+}
+
+
+// Returns the number of addresses of the pools, capped at the maximum size
+// of a permutation.  The pools are seen as a single range of addresses in
+// the helpers below.
+uint64_t
+getPoolsCapacity(const PoolCollection& pools) {
+    uint64_t total = 0;
+    for (PoolCollection::const_iterator pool = pools.begin();
+         pool != pools.end(); ++pool) {
+        total += getPoolCapacity(**pool);
+        if (total >= IndexPermutation::MAX_SIZE) {
+            return (IndexPermutation::MAX_SIZE);
+        }
+    }
+    return (total);
+}
+
+// Returns the address at the given position of the pools.
+IOAddress
+getPoolsAddress(const PoolCollection& pools, uint64_t index) {
+    for (PoolCollection::const_iterator pool = pools.begin();
+         pool != pools.end(); ++pool) {
+        const uint64_t capacity = getPoolCapacity(**pool);
+        if (index < capacity) {
+            return (getPoolAddress(**pool, index));
+        }
+        index -= capacity;
+    }
+    bundy_throw(Unexpected, "address index out of the pools");
+}
+
+// Finds the position of an address in the pools, returns false if it is
+// not in them.
+bool
+getPoolsIndex(const PoolCollection& pools, const IOAddress& addr,
+              uint64_t& index) {
+    uint64_t offset = 0;
+    for (PoolCollection::const_iterator pool = pools.begin();
+         pool != pools.end(); ++pool) {
+        const uint64_t capacity = getPoolCapacity(**pool);
+        if (offset + capacity > IndexPermutation::MAX_SIZE) {
+            return (false);
+        }
+        if (getPoolIndex(**pool, addr, index)) {
+            index += offset;
+            return (true);
+        }
+        offset += capacity;
+    }
+    return (false);
+}
+
+// Returns the random order of the addresses of a pool, creating it if the
+// pool doesn't have one yet.
+PoolPermutationPtr
+getPermutation(Pool& pool) {
+    Mutex::Locker locker(permutations_mutex);
+    PoolPermutationPtr permutation = pool.getPermutation();
+    if (!permutation) {
+        permutation.reset(new PoolPermutation(pool));
+        pool.setPermutation(permutation);
+    }
+    return (permutation);
+}
+
+}
+
 AllocEngine::IterativeAllocator::IterativeAllocator(Lease::Type lease_type)
     :Allocator(lease_type) {
 }
@@ -147,6 +346,8 @@ AllocEngine::IterativeAllocator::pickAddress(const SubnetPtr& subnet,
                                              const DuidPtr&,
                                              const IOAddress&) {
 
+    Mutex::Locker locker(last_allocated_mutex);
+
     // Is this prefix allocation?
     bool prefix = pool_type_ == Lease::TYPE_PD;
 
@@ -169,6 +370,15 @@ AllocEngine::IterativeAllocator::pickAddress(const SubnetPtr& subnet,
         }
     }
 
+    // The free IPv4 addresses are known, so take the next one of them.
+    if (pool_type_ == Lease::TYPE_V4) {
+        IOAddress next("0.0.0.0");
+        if (pickFreeAddress(pools, last, next)) {
+            subnet->setLastAllocated(pool_type_, next);
+            return (next);
+        }
+    }
+
     // last one was bogus for one of several reasons:
     // - we just booted up and that's the first address we're allocating
     // - a subnet was removed or other reconfiguration just completed
@@ -217,32 +427,149 @@ AllocEngine::IterativeAllocator::pickAddress(const SubnetPtr& subnet,
     return (next);
 }
 
+void
+AllocEngine::addressReleased4(const SubnetPtr& subnet, const IOAddress& addr) {
+    markAddress(subnet, addr, true);
+}
+
+Lease4Collection
+AllocEngine::reclaimExpiredLeases4(size_t max_leases) {
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    const Lease4Collection expired = lease_mgr.getExpiredLeases4(max_leases);
+    if (expired.empty()) {
+        return (expired);
+    }
+
+    // The subnets are looked up by identifier to free the addresses.
+    std::map<SubnetID, SubnetPtr> subnets;
+    const Subnet4Collection* subnets4 = CfgMgr::instance().getSubnets4();
+    for (Subnet4Collection::const_iterator subnet = subnets4->begin();
+         subnet != subnets4->end(); ++subnet) {
+        subnets[(*subnet)->getID()] = *subnet;
+    }
+
+    Lease4Collection reclaimed;
+    for (Lease4Collection::const_iterator lease = expired.begin();
+         lease != expired.end(); ++lease) {
+        // A client may be renewing the lease or be given its address.
+        AddressLocks::Locker locker(AddressLocks::instance(), (*lease)->addr_);
+        const Lease4Ptr current = lease_mgr.getLease4((*lease)->addr_);
+        if (!current || !current->expired() ||
+            !lease_mgr.deleteLease(current->addr_)) {
+            continue;
+        }
+        LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+                  DHCPSRV_LEASE4_RECLAIMED).arg(current->addr_.toText());
+        std::map<SubnetID, SubnetPtr>::const_iterator subnet =
+            subnets.find(current->subnet_id_);
+        if (subnet != subnets.end()) {
+            markAddress(subnet->second, current->addr_, true);
+        }
+        reclaimed.push_back(current);
+    }
+    return (reclaimed);
+}
+
+Lease6Collection
+AllocEngine::reclaimExpiredLeases6(size_t max_leases) {
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    const Lease6Collection expired = lease_mgr.getExpiredLeases6(max_leases);
+
+    Lease6Collection reclaimed;
+    for (Lease6Collection::const_iterator lease = expired.begin();
+         lease != expired.end(); ++lease) {
+        AddressLocks::Locker locker(AddressLocks::instance(), (*lease)->addr_);
+        const Lease6Ptr current = lease_mgr.getLease6((*lease)->type_,
+                                                      (*lease)->addr_);
+        if (!current || !current->expired() ||
+            !lease_mgr.deleteLease(current->addr_)) {
+            continue;
+        }
+        LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+                  DHCPSRV_LEASE6_RECLAIMED).arg(current->addr_.toText())
+            .arg(current->prefixlen_);
+        reclaimed.push_back(current);
+    }
+    return (reclaimed);
+}
+
+bool
+AllocEngine::leaseCalloutsPresent4() {
+    return (HooksManager::calloutsPresent(Hooks.hook_index_lease4_select_) ||
+            HooksManager::calloutsPresent(Hooks.hook_index_lease4_renew_));
+}
+
+bool
+AllocEngine::leaseCalloutsPresent6() {
+    return (HooksManager::calloutsPresent(Hooks.hook_index_lease6_select_));
+}
+
+const uint64_t AllocEngine::HashedAllocator::MAX_PROBES;
+
 AllocEngine::HashedAllocator::HashedAllocator(Lease::Type lease_type)
     :Allocator(lease_type) {
-    bundy_throw(NotImplemented, "Hashed allocator is not implemented");
 }
 
-
 bundy::asiolink::IOAddress
-AllocEngine::HashedAllocator::pickAddress(const SubnetPtr&,
-                                          const DuidPtr&,
-                                          const IOAddress&) {
-    bundy_throw(NotImplemented, "Hashed allocator is not implemented");
+AllocEngine::HashedAllocator::pickAddress(const SubnetPtr& subnet,
+                                          const DuidPtr& duid,
+                                          const IOAddress& hint) {
+    const PoolCollection& pools = subnet->getPools(pool_type_);
+    if (pools.empty()) {
+        bundy_throw(AllocFailed, "No pools defined in selected subnet");
+    }
+
+    // The probes of a client are the addresses of the pools in the order
+    // of a permutation keyed by its identifier, so the same client gets
+    // the same addresses.  A client without identifier gets random ones.
+    uint64_t key = subnet->getID() * 0x9e3779b97f4a7c15ULL;
+    if (duid && !duid->getDuid().empty()) {
+        const std::vector<uint8_t>& id = duid->getDuid();
+        key ^= hashBuffer(&id[0], id.size());
+    } else {
+        key ^= getRandomKey();
+    }
+    const IndexPermutation probes(getPoolsCapacity(pools), key);
+
+    // Go on with the probe following the hint, unless it is not one of
+    // the first probes of the client, so the probing is bounded.
+    uint64_t probe = 0;
+    uint64_t index;
+    if (getPoolsIndex(pools, hint, index)) {
+        const uint64_t previous = probes.unpermute(index);
+        if (previous + 1 < MAX_PROBES && previous + 1 < probes.getSize()) {
+            probe = previous + 1;
+        }
+    }
+    return (getPoolsAddress(pools, probes.permute(probe)));
 }
 
 AllocEngine::RandomAllocator::RandomAllocator(Lease::Type lease_type)
     :Allocator(lease_type) {
-    bundy_throw(NotImplemented, "Random allocator is not implemented");
 }
 
-
 bundy::asiolink::IOAddress
-AllocEngine::RandomAllocator::pickAddress(const SubnetPtr&,
+AllocEngine::RandomAllocator::pickAddress(const SubnetPtr& subnet,
                                           const DuidPtr&,
                                           const IOAddress&) {
-    bundy_throw(NotImplemented, "Random allocator is not implemented");
-}
+    const PoolCollection& pools = subnet->getPools(pool_type_);
+    if (pools.empty()) {
+        bundy_throw(AllocFailed, "No pools defined in selected subnet");
+    }
 
+    // Pick a pool at random, in proportion to its size, then the next
+    // address in the random order of the pool.
+    uint64_t index = getRandomKey() % getPoolsCapacity(pools);
+    PoolCollection::const_iterator pool = pools.begin();
+    for (; pool + 1 != pools.end(); ++pool) {
+        const uint64_t capacity = getPoolCapacity(**pool);
+        if (index < capacity) {
+            break;
+        }
+        index -= capacity;
+    }
+    return (getPermutation(**pool)->next());
+}
 
 AllocEngine::AllocEngine(AllocType engine_type, unsigned int attempts,
                          bool ipv6)
@@ -338,6 +665,9 @@ AllocEngine::allocateLeases6(const Subnet6Ptr& subnet, const DuidPtr& duid,
             Pool6>(subnet->getPool(type, hint, false));
 
         if (pool) {
+            // Other threads must not allocate the hint until we are done.
+            AddressLocks::Locker locker(AddressLocks::instance(), hint);
+
             /// @todo: We support only one hint for now
             Lease6Ptr lease = LeaseMgrFactory::instance().getLease6(type, hint);
             if (!lease) {
@@ -404,9 +734,13 @@ AllocEngine::allocateLeases6(const Subnet6Ptr& subnet, const DuidPtr& duid,
         // left), but this has one major problem. We exactly control allocation
         // moment, but we currently do not control expiration time at all
 
+        // The hashed allocator goes on from the last candidate.
+        IOAddress last_candidate = hint;
         unsigned int i = attempts_;
         do {
-            IOAddress candidate = allocator->pickAddress(subnet, duid, hint);
+            IOAddress candidate = allocator->pickAddress(subnet, duid,
+                                                         last_candidate);
+            last_candidate = candidate;
 
             /// @todo: check if the address is reserved once we have host support
             /// implemented
@@ -420,6 +754,9 @@ AllocEngine::allocateLeases6(const Subnet6Ptr& subnet, const DuidPtr& duid,
                 prefix_len = pool->getLength();
             }
 
+            // The lease of the candidate must not change between checking
+            // and allocating it.
+            AddressLocks::Locker locker(AddressLocks::instance(), candidate);
             Lease6Ptr existing = LeaseMgrFactory::instance().getLease6(type,
                                  candidate);
             if (!existing) {
@@ -548,6 +885,8 @@ AllocEngine::allocateLease4(const SubnetPtr& subnet, const ClientIdPtr& clientid
 
         // check if the hint is in pool and is available
         if (subnet->inPool(Lease::TYPE_V4, hint)) {
+            // Other threads must not allocate the hint until we are done.
+            AddressLocks::Locker locker(AddressLocks::instance(), hint);
             existing = LeaseMgrFactory::instance().getLease4(hint);
             if (!existing) {
                 /// @todo: Check if the hint is reserved once we have host support
@@ -594,13 +933,26 @@ AllocEngine::allocateLease4(const SubnetPtr& subnet, const ClientIdPtr& clientid
         // left), but this has one major problem. We exactly control allocation
         // moment, but we currently do not control expiration time at all
 
+        // The client identifier is the hardware address when there is no
+        // client-id, for the hashed allocator.  It goes on from the last
+        // candidate.
+        DuidPtr client_duid = clientid;
+        if (!client_duid && hwaddr && !hwaddr->hwaddr_.empty()) {
+            client_duid.reset(new DUID(hwaddr->hwaddr_));
+        }
+        IOAddress last_candidate = hint;
         unsigned int i = attempts_;
         do {
-            IOAddress candidate = allocator->pickAddress(subnet, clientid, hint);
+            IOAddress candidate = allocator->pickAddress(subnet, client_duid,
+                                                         last_candidate);
+            last_candidate = candidate;
 
             /// @todo: check if the address is reserved once we have host support
             /// implemented
 
+            // The lease of the candidate must not change between checking
+            // and allocating it.
+            AddressLocks::Locker locker(AddressLocks::instance(), candidate);
             Lease4Ptr existing = LeaseMgrFactory::instance().getLease4(candidate);
             if (!existing) {
                 // there's no existing lease for selected candidate, so it is
@@ -625,6 +977,10 @@ AllocEngine::allocateLease4(const SubnetPtr& subnet, const ClientIdPtr& clientid
                                               hostname, callout_handle,
                                               fake_allocation));
                 }
+
+                // The address was leased by someone else behind our back,
+                // don't pick it again.
+                markAddress(subnet, candidate, false);
             }
 
             // Continue trying allocation until we run out of attempts
@@ -676,7 +1032,8 @@ Lease4Ptr AllocEngine::renewLease4(const SubnetPtr& subnet,
 
     bool skip = false;
     // Execute all callouts registered for packet6_send
-    if (HooksManager::getHooksManager().calloutsPresent(Hooks.hook_index_lease4_renew_)) {
+    if (callout_handle &&
+        HooksManager::calloutsPresent(Hooks.hook_index_lease4_renew_)) {
 
         // Delete all previous arguments
         callout_handle->deleteAllArguments();
@@ -688,12 +1045,12 @@ Lease4Ptr AllocEngine::renewLease4(const SubnetPtr& subnet,
         Subnet4Ptr subnet4 = boost::dynamic_pointer_cast<Subnet4>(subnet);
 
         // Pass the parameters
-        callout_handle->setArgument("subnet4", subnet4);
-        callout_handle->setArgument("clientid", clientid);
-        callout_handle->setArgument("hwaddr", hwaddr);
+        callout_handle->setArgument(Hooks.arg_subnet4_, subnet4);
+        callout_handle->setArgument(Hooks.arg_clientid_, clientid);
+        callout_handle->setArgument(Hooks.arg_hwaddr_, hwaddr);
 
         // Pass the lease to be updated
-        callout_handle->setArgument("lease4", lease);
+        callout_handle->setArgument(Hooks.arg_lease4_, lease);
 
         // Call all installed callouts
         HooksManager::callCallouts(Hooks.hook_index_lease4_renew_, *callout_handle);
@@ -766,13 +1123,14 @@ Lease6Ptr AllocEngine::reuseExpiredLease(Lease6Ptr& expired,
 
         // Pass necessary arguments
         // Subnet from which we do the allocation
-        callout_handle->setArgument("subnet6", subnet);
+        callout_handle->setArgument(Hooks.arg_subnet6_, subnet);
 
         // Is this solicit (fake = true) or request (fake = false)
-        callout_handle->setArgument("fake_allocation", fake_allocation);
+        callout_handle->setArgument(Hooks.arg_fake_allocation_,
+                                    fake_allocation);
 
         // The lease that will be assigned to a client
-        callout_handle->setArgument("lease6", expired);
+        callout_handle->setArgument(Hooks.arg_lease6_, expired);
 
         // Call the callouts
         HooksManager::callCallouts(hook_index_lease6_select_, *callout_handle);
@@ -787,7 +1145,7 @@ Lease6Ptr AllocEngine::reuseExpiredLease(Lease6Ptr& expired,
 
         // Let's use whatever callout returned. Hopefully it is the same lease
         // we handled to it.
-        callout_handle->getArgument("lease6", expired);
+        callout_handle->getArgument(Hooks.arg_lease6_, expired);
     }
 
     if (!fake_allocation) {
@@ -847,16 +1205,17 @@ Lease4Ptr AllocEngine::reuseExpiredLease(Lease4Ptr& expired,
         // boost smart pointers here, we need to do the cast using the boost
         // version of dynamic_pointer_cast.
         Subnet4Ptr subnet4 = boost::dynamic_pointer_cast<Subnet4>(subnet);
-        callout_handle->setArgument("subnet4", subnet4);
+        callout_handle->setArgument(Hooks.arg_subnet4_, subnet4);
 
         // Is this solicit (fake = true) or request (fake = false)
-        callout_handle->setArgument("fake_allocation", fake_allocation);
+        callout_handle->setArgument(Hooks.arg_fake_allocation_,
+                                    fake_allocation);
 
         // The lease that will be assigned to a client
-        callout_handle->setArgument("lease4", expired);
+        callout_handle->setArgument(Hooks.arg_lease4_, expired);
 
         // Call the callouts
-        HooksManager::callCallouts(hook_index_lease6_select_, *callout_handle);
+        HooksManager::callCallouts(hook_index_lease4_select_, *callout_handle);
 
         // Callouts decided to skip the action. This means that the lease is not
         // assigned, so the client will get NoAddrAvail as a result. The lease
@@ -868,7 +1227,7 @@ Lease4Ptr AllocEngine::reuseExpiredLease(Lease4Ptr& expired,
 
         // Let's use whatever callout returned. Hopefully it is the same lease
         // we handled to it.
-        callout_handle->getArgument("lease4", expired);
+        callout_handle->getArgument(Hooks.arg_lease4_, expired);
     }
 
     if (!fake_allocation) {
@@ -919,11 +1278,12 @@ Lease6Ptr AllocEngine::createLease6(const Subnet6Ptr& subnet,
         // Pass necessary arguments
 
         // Subnet from which we do the allocation
-        callout_handle->setArgument("subnet6", subnet);
+        callout_handle->setArgument(Hooks.arg_subnet6_, subnet);
 
         // Is this solicit (fake = true) or request (fake = false)
-        callout_handle->setArgument("fake_allocation", fake_allocation);
-        callout_handle->setArgument("lease6", lease);
+        callout_handle->setArgument(Hooks.arg_fake_allocation_,
+                                    fake_allocation);
+        callout_handle->setArgument(Hooks.arg_lease6_, lease);
 
         // This is the first callout, so no need to clear any arguments
         HooksManager::callCallouts(hook_index_lease6_select_, *callout_handle);
@@ -938,7 +1298,7 @@ Lease6Ptr AllocEngine::createLease6(const Subnet6Ptr& subnet,
 
         // Let's use whatever callout returned. Hopefully it is the same lease
         // we handled to it.
-        callout_handle->getArgument("lease6", lease);
+        callout_handle->getArgument(Hooks.arg_lease6_, lease);
     }
 
     if (!fake_allocation) {
@@ -1014,13 +1374,14 @@ Lease4Ptr AllocEngine::createLease4(const SubnetPtr& subnet,
         // be confused with dynamic_pointer_casts. They should get a concrete
         // pointer (Subnet4Ptr) pointing to a Subnet4 object.
         Subnet4Ptr subnet4 = boost::dynamic_pointer_cast<Subnet4>(subnet);
-        callout_handle->setArgument("subnet4", subnet4);
+        callout_handle->setArgument(Hooks.arg_subnet4_, subnet4);
 
         // Is this solicit (fake = true) or request (fake = false)
-        callout_handle->setArgument("fake_allocation", fake_allocation);
+        callout_handle->setArgument(Hooks.arg_fake_allocation_,
+                                    fake_allocation);
 
         // Pass the intended lease as well
-        callout_handle->setArgument("lease4", lease);
+        callout_handle->setArgument(Hooks.arg_lease4_, lease);
 
         // This is the first callout, so no need to clear any arguments
         HooksManager::callCallouts(hook_index_lease4_select_, *callout_handle);
@@ -1035,13 +1396,14 @@ Lease4Ptr AllocEngine::createLease4(const SubnetPtr& subnet,
 
         // Let's use whatever callout returned. Hopefully it is the same lease
         // we handled to it.
-        callout_handle->getArgument("lease4", lease);
+        callout_handle->getArgument(Hooks.arg_lease4_, lease);
     }
 
     if (!fake_allocation) {
         // That is a real (REQUEST) allocation
         bool status = LeaseMgrFactory::instance().addLease(lease);
         if (status) {
+            markAddress(subnet, lease->addr_, false);
             return (lease);
         } else {
             // One of many failures with LeaseMgr (e.g. lost connection to the
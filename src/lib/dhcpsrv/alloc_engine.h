@@ -80,7 +80,8 @@ protected:
         ///
         /// @param subnet next address will be returned from pool of that subnet
         /// @param duid Client's DUID
-        /// @param hint client's hint
+        /// @param hint client's hint, or the address picked last when the
+        ///        engine picks again because it was not available
         ///
         /// @return the next address
         virtual bundy::asiolink::IOAddress
@@ -124,6 +125,15 @@ protected:
 
         /// @brief returns the next address from pools in a subnet
         ///
+        /// IPv4 addresses are picked from the maps of the free addresses of
+        /// the pools (see @c Pool::getFreeAddresses), which are built from
+        /// the lease database when first needed.  The next free address
+        /// after the last allocated one is returned, so the leased
+        /// addresses are skipped without looking them up.  When there is
+        /// no free address (or a pool is too large to be mapped), the
+        /// address following the last allocated one is returned, which
+        /// may have an expired lease to be reused.
+        ///
         /// @param subnet next address will be returned from pool of that subnet
         /// @param duid Client's DUID (ignored)
         /// @param hint client's hint (ignored)
@@ -161,17 +171,27 @@ protected:
 
     /// @brief Address/prefix allocator that gets an address based on a hash
     ///
-    /// @todo: This is a skeleton class for now and is missing implementation.
+    /// The addresses of the pools are probed in an order given by a
+    /// permutation keyed by the hash of the client's DUID or client-id, so
+    /// a client is offered the same addresses (the first free one of its
+    /// probes) each time, without any state kept by the allocator.  The
+    /// probing is bounded: after @c MAX_PROBES probes it starts again from
+    /// the first one.
     class HashedAllocator : public Allocator {
     public:
 
+        /// @brief The maximum number of probes for a client.
+        static const uint64_t MAX_PROBES = 256;
+
         /// @brief default constructor (does nothing)
         /// @param type - specifies allocation type
         HashedAllocator(Lease::Type type);
 
         /// @brief returns an address based on hash calculated from client's DUID.
         ///
-        /// @todo: Implement this method
+        /// The probe following the hint is returned when the hint is one of
+        /// the client's probes, otherwise the first probe is returned.
+        /// Clients without DUID get random addresses.
         ///
         /// @param subnet an address will be picked from pool of that subnet
         /// @param duid Client's DUID
@@ -184,7 +204,9 @@ protected:
 
     /// @brief Random allocator that picks address randomly
     ///
-    /// @todo: This is a skeleton class for now and is missing implementation.
+    /// Each pool returns its addresses in the order of a random permutation
+    /// (see @c Pool::getPermutation), so no address of a pool is picked
+    /// twice before all the others have been picked.
     class RandomAllocator : public Allocator {
     public:
 
@@ -194,7 +216,7 @@ protected:
 
         /// @brief returns an random address from pool of specified subnet
         ///
-        /// @todo: Implement this method
+        /// The pool is picked at random in proportion to its size.
         ///
         /// @param subnet an address will be picked from pool of that subnet
         /// @param duid Client's DUID (ignored)
@@ -354,6 +376,59 @@ protected:
                     const bundy::hooks::CalloutHandlePtr& callout_handle,
                     Lease6Collection& old_leases);
 
+    /// @brief Makes a released IPv4 address available for allocation
+    ///
+    /// The iterative allocator picks IPv4 addresses from the maps of the
+    /// free addresses of the pools, which are updated by the engine when
+    /// it allocates leases. The server must call this method when it
+    /// deletes a lease, so that the address is picked again.
+    ///
+    /// @param subnet subnet the address belongs to
+    /// @param addr the released address
+    static void addressReleased4(const SubnetPtr& subnet,
+                                 const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Reclaims a batch of expired IPv4 leases
+    ///
+    /// Deletes the leases expired the longest time ago from the lease
+    /// database and makes their addresses available for allocation (see
+    /// @c addressReleased4).  A lease renewed or reused since it was
+    /// found expired is skipped.  The caller is responsible for removing
+    /// the DNS entries of the returned leases.
+    ///
+    /// @param max_leases maximum number of leases to reclaim (0 for no
+    ///        limit)
+    ///
+    /// @return the reclaimed leases, in order of expiration time
+    static Lease4Collection reclaimExpiredLeases4(size_t max_leases);
+
+    /// @brief Reclaims a batch of expired IPv6 leases
+    ///
+    /// See @c reclaimExpiredLeases4.
+    ///
+    /// @param max_leases maximum number of leases to reclaim (0 for no
+    ///        limit)
+    ///
+    /// @return the reclaimed leases, in order of expiration time
+    static Lease6Collection reclaimExpiredLeases6(size_t max_leases);
+
+    /// @brief Checks if callouts are installed on the DHCPv4 lease hooks
+    ///
+    /// The lease4_select and lease4_renew callouts are called only if a
+    /// callout handle is passed to the allocation functions; as a handle
+    /// is set up for each packet, the server gets one only if this returns
+    /// true.
+    ///
+    /// @return true if callouts are present on any of these hooks.
+    static bool leaseCalloutsPresent4();
+
+    /// @brief Checks if callouts are installed on the DHCPv6 lease hooks
+    ///
+    /// See @c leaseCalloutsPresent4 (the hook being lease6_select).
+    ///
+    /// @return true if callouts are present on the hook.
+    static bool leaseCalloutsPresent6();
+
     /// @brief returns allocator for a given pool type
     /// @param type type of pool (V4, IA, TA or PD)
     /// @throw BadValue if allocator for a given type is missing
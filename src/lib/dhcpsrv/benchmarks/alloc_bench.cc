@@ -0,0 +1,236 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/duid.h>
+#include <dhcpsrv/alloc_engine.h>
+#include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/pool.h>
+#include <dhcpsrv/subnet.h>
+#include <log/logger_support.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+
+// The first address of the /16 pool.
+const uint32_t POOL_START = 10 << 24;
+
+// The number of addresses in the pool.
+const uint32_t POOL_SIZE = 1 << 16;
+
+// Find a free address for each of the clients the way the iterative
+// allocator did before it knew the free addresses: by looking up the
+// addresses following the last allocated one in the lease database until
+// one without a lease is found.
+class LookupBenchMark {
+public:
+    LookupBenchMark(size_t allocation_count) :
+        allocation_count_(allocation_count), last_(POOL_SIZE - 1)
+    {}
+    unsigned int run() {
+        const LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+        for (size_t i = 0; i < allocation_count_; ++i) {
+            do {
+                last_ = (last_ + 1) % POOL_SIZE;
+            } while (lease_mgr.getLease4(IOAddress(POOL_START + last_)));
+        }
+        return (allocation_count_);
+    }
+private:
+    const size_t allocation_count_;
+    uint32_t last_;
+};
+
+// Gives access to the allocators of the engine.
+class BenchAllocEngine : public AllocEngine {
+public:
+    BenchAllocEngine(AllocEngine::AllocType type) :
+        AllocEngine(type, 100, false)
+    {}
+    using AllocEngine::AllocatorPtr;
+};
+
+// Find a free address for each of the clients with an allocator, looking
+// up the candidates in the lease database as the allocation engine does,
+// and counting the lookups.  The leases are not added (as for DISCOVER),
+// so the pool stays filled the same.  Each allocation is for a different
+// client.  The iterative allocator knows the free addresses of the pool,
+// its map is built from the lease database in the first iteration.
+class AllocatorBenchMark {
+public:
+    AllocatorBenchMark(AllocEngine::AllocType type, const Subnet4Ptr& subnet,
+                       size_t allocation_count) :
+        allocator_(BenchAllocEngine(type).getAllocator(Lease::TYPE_V4)),
+        subnet_(subnet), allocation_count_(allocation_count),
+        client_count_(0), lookup_count_(0), failure_count_(0)
+    {}
+    unsigned int run() {
+        const LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+        for (size_t i = 0; i < allocation_count_; ++i) {
+            const uint32_t client = ++client_count_;
+            const uint8_t id[] = { 1, static_cast<uint8_t>(client >> 24),
+                                   static_cast<uint8_t>(client >> 16),
+                                   static_cast<uint8_t>(client >> 8),
+                                   static_cast<uint8_t>(client) };
+            const DuidPtr duid(new DUID(id, sizeof(id)));
+            IOAddress candidate("0.0.0.0");
+            unsigned int attempts = 0;
+            do {
+                // The engine gives up after its number of attempts.
+                if (++attempts > MAX_ATTEMPTS) {
+                    ++failure_count_;
+                    break;
+                }
+                // As in the engine, the hint is the last candidate.
+                candidate = allocator_->pickAddress(subnet_, duid, candidate);
+                ++lookup_count_;
+            } while (lease_mgr.getLease4(candidate));
+        }
+        return (allocation_count_);
+    }
+    // Prints the average number of lease lookups per allocation and the
+    // number of failed allocations.
+    void printLookups() const {
+        std::cout << "Lease lookups per allocation: "
+                  << static_cast<double>(lookup_count_) / client_count_
+                  << ", failed allocations: " << failure_count_
+                  << std::endl;
+    }
+private:
+    static const unsigned int MAX_ATTEMPTS = 1000;
+    const BenchAllocEngine::AllocatorPtr allocator_;
+    const Subnet4Ptr subnet_;
+    const size_t allocation_count_;
+    uint32_t client_count_;
+    uint64_t lookup_count_;
+    size_t failure_count_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: alloc_bench [-n iterations] [-c allocations] "
+                 "[-u used_percent]" << std::endl;
+    exit (1);
+}
+
+// Fills the given percentage of the pool with leases at random addresses.
+void
+fillPool(const Subnet4Ptr& subnet, unsigned int used_percent) {
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    srandom(1);
+    const time_t now = time(NULL);
+    const size_t lease_count = static_cast<size_t>(POOL_SIZE) *
+        used_percent / 100;
+    for (size_t count = 0; count < lease_count; ) {
+        const uint32_t offset = random() % POOL_SIZE;
+        // Each lease needs a different hardware address.
+        const uint8_t mac[] = { 0, 0xfe, 0, 0,
+                                static_cast<uint8_t>(offset >> 8),
+                                static_cast<uint8_t>(offset & 0xff) };
+        const Lease4Ptr lease(new Lease4(IOAddress(POOL_START + offset),
+                                         mac, sizeof(mac), NULL, 0,
+                                         subnet->getValid(), subnet->getT1(),
+                                         subnet->getT2(), now,
+                                         subnet->getID()));
+        if (lease_mgr.addLease(lease)) {
+            ++count;
+        }
+    }
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t allocation_count = 1000;
+    unsigned int max_used_percent = 0;
+    while ((ch = getopt(argc, argv, "n:c:u:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'c':
+            allocation_count = atoi(optarg);
+            break;
+        case 'u':
+            max_used_percent = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || allocation_count == 0 || max_used_percent > 99) {
+        usage();
+    }
+
+    // Disable logging to avoid the messages of each allocation.
+    bundy::log::initLogger("alloc-bench", bundy::log::NONE);
+
+    // The pool is filled to 90%, 95% and 99%, or only to the given
+    // percentage.
+    const unsigned int used_percents[] = { 90, 95, 99 };
+    const size_t round_count = max_used_percent == 0 ?
+        sizeof(used_percents) / sizeof(used_percents[0]) : 1;
+    for (size_t round = 0; round < round_count; ++round) {
+        const unsigned int used_percent = max_used_percent == 0 ?
+            used_percents[round] : max_used_percent;
+
+        // Start with an empty database and a new pool, so the map of the
+        // free addresses is built again.
+        LeaseMgrFactory::create("type=memfile universe=4 persist=false");
+        const Subnet4Ptr subnet(new Subnet4(IOAddress(POOL_START), 16,
+                                            1000, 2000, 3000));
+        subnet->addPool(Pool4Ptr(new Pool4(IOAddress(POOL_START), 16)));
+        fillPool(subnet, used_percent);
+
+        std::cout << "Benchmark for picking addresses by lease lookups ("
+                  << used_percent << "% of /16 pool used)" << std::endl;
+        BenchMark<LookupBenchMark>(iteration,
+                                   LookupBenchMark(allocation_count));
+
+        const AllocEngine::AllocType types[] = {
+            AllocEngine::ALLOC_ITERATIVE, AllocEngine::ALLOC_HASHED,
+            AllocEngine::ALLOC_RANDOM
+        };
+        const char* const type_names[] = { "iterative", "hashed", "random" };
+        for (size_t type = 0; type < sizeof(types) / sizeof(types[0]);
+             ++type) {
+            std::cout << "Benchmark for picking addresses with the "
+                      << type_names[type] << " allocator (" << used_percent
+                      << "% of /16 pool used)" << std::endl;
+            AllocatorBenchMark benchmark(types[type], subnet,
+                                         allocation_count);
+            BenchMark<AllocatorBenchMark>(iteration, benchmark, true);
+            benchmark.printLookups();
+        }
+    }
+    LeaseMgrFactory::destroy();
+
+    return (0);
+}
@@ -0,0 +1,271 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/classify.h>
+#include <dhcp/dhcp4.h>
+#include <dhcp/option_string.h>
+#include <dhcp/pkt4.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/client_classifier.h>
+#include <dhcpsrv/subnet.h>
+#include <log/logger_support.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+// The vendor class of the clients of a class.
+string
+vendorClass(size_t index) {
+    char text[32];
+    snprintf(text, sizeof(text), "vendor-%u",
+             static_cast<unsigned int>(index));
+    return (text);
+}
+
+// The circuit id set by the relays for the clients of a class.
+OptionBuffer
+circuitId(size_t index) {
+    OptionBuffer data;
+    data.push_back(index >> 8);
+    data.push_back(index & 0xff);
+    return (data);
+}
+
+// Classify the packets with the classifier.
+class ClassifierBenchMark {
+public:
+    ClassifierBenchMark(const ClientClassifier& classifier,
+                        const vector<Pkt4Ptr>& packets) :
+        classifier_(classifier), packets_(packets)
+    {}
+    unsigned int run() {
+        vector<Pkt4Ptr>::const_iterator it;
+        const vector<Pkt4Ptr>::const_iterator it_end = packets_.end();
+        for (it = packets_.begin(); it != it_end; ++it) {
+            (*it)->classes_.clear();
+            const size_t count = classifier_.classify(**it);
+            assert(count > 0);
+        }
+        return (packets_.size());
+    }
+private:
+    const ClientClassifier& classifier_;
+    const vector<Pkt4Ptr>& packets_;
+};
+
+// Classify the packets by checking the options for each class, as a hook
+// library would.
+class DirectBenchMark {
+public:
+    DirectBenchMark(size_t class_count, const vector<Pkt4Ptr>& packets) :
+        packets_(packets)
+    {
+        for (size_t i = 0; i < class_count; ++i) {
+            names_.push_back("class-" + vendorClass(i));
+            vendor_classes_.push_back(vendorClass(i));
+            circuit_ids_.push_back(circuitId(i));
+        }
+    }
+    unsigned int run() {
+        vector<Pkt4Ptr>::const_iterator it;
+        const vector<Pkt4Ptr>::const_iterator it_end = packets_.end();
+        for (it = packets_.begin(); it != it_end; ++it) {
+            Pkt4& pkt = **it;
+            pkt.classes_.clear();
+            for (size_t i = 0; i < names_.size(); ++i) {
+                const OptionPtr vendor =
+                    pkt.getOption(DHO_VENDOR_CLASS_IDENTIFIER);
+                const OptionPtr agent = pkt.getOption(DHO_DHCP_AGENT_OPTIONS);
+                const OptionPtr circuit = agent ? agent->getOption(1) :
+                    OptionPtr();
+                if ((vendor && vendor->getData().size() ==
+                     vendor_classes_[i].size() &&
+                     std::equal(vendor_classes_[i].begin(),
+                                vendor_classes_[i].end(),
+                                vendor->getData().begin())) ||
+                    (circuit && circuit->getData() == circuit_ids_[i] &&
+                     pkt.getHWAddr()->hwaddr_[0] == 0x0a)) {
+                    pkt.addClass(names_[i]);
+                }
+            }
+            assert(!pkt.classes_.empty());
+        }
+        return (packets_.size());
+    }
+private:
+    const vector<Pkt4Ptr>& packets_;
+    vector<ClientClass> names_;
+    vector<string> vendor_classes_;
+    vector<OptionBuffer> circuit_ids_;
+};
+
+// Select a subnet for each of the packets through CfgMgr, with the classes
+// found by the benchmarks above.
+class SelectionBenchMark {
+public:
+    SelectionBenchMark(const vector<Pkt4Ptr>& packets,
+                       const vector<IOAddress>& addresses) :
+        packets_(packets), addresses_(addresses)
+    {}
+    unsigned int run() {
+        const CfgMgr& cfg_mgr = CfgMgr::instance();
+        for (size_t i = 0; i < addresses_.size(); ++i) {
+            const Subnet4Ptr subnet =
+                cfg_mgr.getSubnet4(addresses_[i], packets_[i]->classes_);
+            assert(subnet);
+        }
+        return (addresses_.size());
+    }
+private:
+    const vector<Pkt4Ptr>& packets_;
+    const vector<IOAddress>& addresses_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: class_bench [-n iterations] [-q queries] "
+                 "[-c max_classes]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t query_count = 10000;
+    size_t max_class_count = 1000;
+    while ((ch = getopt(argc, argv, "n:q:c:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'q':
+            query_count = atoi(optarg);
+            break;
+        case 'c':
+            max_class_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || query_count == 0 || max_class_count == 0 ||
+        max_class_count > 0x10000) {
+        usage();
+    }
+
+    // Disable logging to avoid the messages of each selection.
+    bundy::log::initLogger("class-bench", bundy::log::NONE);
+
+    // The clients of a class are those with its vendor class, or those
+    // behind a relay setting its circuit id whose hardware address starts
+    // with 0a.  Half of the packets carry the vendor class, the others are
+    // relayed.  Each class has a /24 subnet starting at 10.0.0.0 restricted
+    // to it, and the relays of its clients are in its subnet.  The count of
+    // classes grows ten times in each round up to the maximum.
+    CfgMgr& cfg_mgr = CfgMgr::instance();
+    for (size_t class_count = 10; ; class_count *= 10) {
+        if (class_count > max_class_count) {
+            class_count = max_class_count;
+        }
+
+        ClientClassifier classifier(Option::V4);
+        cfg_mgr.deleteSubnets4();
+        for (size_t i = 0; i < class_count; ++i) {
+            char circuit_id[8];
+            snprintf(circuit_id, sizeof(circuit_id), "%04x",
+                     static_cast<unsigned int>(i));
+            const ClientClass name = "class-" + vendorClass(i);
+            classifier.addClass(name, "option[60] == '" + vendorClass(i) +
+                                "' or (relay[1] == 0x" + circuit_id +
+                                " and substring(hwaddr, 0, 1) == 0x0a)");
+
+            const uint32_t prefix = (10 << 24) + (i << 8);
+            const Subnet4Ptr subnet(new Subnet4(IOAddress(prefix), 24,
+                                                1000, 2000, 3000));
+            subnet->allowClientClass(name);
+            cfg_mgr.addSubnet4(subnet);
+        }
+
+        vector<Pkt4Ptr> packets;
+        vector<IOAddress> addresses;
+        srandom(1);
+        for (size_t i = 0; i < query_count; ++i) {
+            const size_t index = random() % class_count;
+            const Pkt4Ptr pkt(new Pkt4(DHCPDISCOVER, i));
+            const uint8_t hwaddr[] = { 0x0a, 0, 0, 0,
+                                       static_cast<uint8_t>(i >> 8),
+                                       static_cast<uint8_t>(i & 0xff) };
+            pkt->setHWAddr(HTYPE_ETHER, sizeof(hwaddr),
+                           vector<uint8_t>(hwaddr, hwaddr + sizeof(hwaddr)));
+            if (i % 2 == 0) {
+                pkt->addOption(OptionPtr(new OptionString(
+                    Option::V4, DHO_VENDOR_CLASS_IDENTIFIER,
+                    vendorClass(index))));
+            } else {
+                const OptionPtr agent(new Option(Option::V4,
+                                                 DHO_DHCP_AGENT_OPTIONS));
+                agent->addOption(OptionPtr(new Option(Option::V4, 1,
+                                                      circuitId(index))));
+                pkt->addOption(agent);
+            }
+            packets.push_back(pkt);
+            addresses.push_back(IOAddress((10 << 24) + (index << 8) + 1));
+        }
+
+        std::cout << "Benchmark for direct classification ("
+                  << class_count << " classes)" << std::endl;
+        BenchMark<DirectBenchMark>(iteration,
+                                   DirectBenchMark(class_count, packets));
+
+        std::cout << "Benchmark for compiled classification ("
+                  << class_count << " classes, "
+                  << classifier.getFieldCount() << " fields, "
+                  << classifier.getProgramSize() << " instructions)"
+                  << std::endl;
+        BenchMark<ClassifierBenchMark>(iteration,
+                                       ClassifierBenchMark(classifier,
+                                                           packets));
+
+        std::cout << "Benchmark for subnet selection by class ("
+                  << class_count << " subnets)" << std::endl;
+        BenchMark<SelectionBenchMark>(iteration,
+                                      SelectionBenchMark(packets, addresses));
+
+        if (class_count == max_class_count) {
+            break;
+        }
+    }
+
+    return (0);
+}
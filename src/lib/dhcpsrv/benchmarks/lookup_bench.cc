@@ -0,0 +1,270 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/duid.h>
+#include <dhcp/hwaddr.h>
+#include <dhcpsrv/lease_mgr_factory.h>
+#include <exceptions/exceptions.h>
+#include <log/logger_support.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+
+// The first address of the leases.
+const uint32_t POOL_START = 10 << 24;
+
+// The subnet of all the leases.
+const SubnetID SUBNET_ID = 1;
+
+// The IAID of all the DHCPv6 leases.
+const uint32_t IAID = 1234;
+
+// Returns an identifier of the given length, unique to the given lease.
+vector<uint8_t>
+createIdentifier(size_t len, uint8_t type, uint32_t lease) {
+    vector<uint8_t> id(len, 0);
+    id[0] = type;
+    for (int i = 0; i < 4; ++i) {
+        id[len - 1 - i] = static_cast<uint8_t>(lease >> (8 * i));
+    }
+    return (id);
+}
+
+// Returns the hardware address of a lease.
+vector<uint8_t>
+createHWAddr(uint32_t lease) {
+    return (createIdentifier(6, 0, lease));
+}
+
+// Returns the client identifier of a lease (a DUID-based one, as sent by
+// the clients supporting RFC 4361).
+vector<uint8_t>
+createClientId(uint32_t lease) {
+    return (createIdentifier(19, 0xff, lease));
+}
+
+// Returns the DUID of a DHCPv6 lease.
+vector<uint8_t>
+createDuid(uint32_t lease) {
+    return (createIdentifier(14, 0, lease));
+}
+
+// Adds the DHCPv4 and DHCPv6 leases.
+void
+fillDatabase(size_t lease_count) {
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    const time_t now = time(NULL);
+    for (uint32_t i = 0; i < lease_count; ++i) {
+        const vector<uint8_t> hwaddr = createHWAddr(i);
+        const vector<uint8_t> client_id = createClientId(i);
+        lease_mgr.addLease(Lease4Ptr(new Lease4(IOAddress(POOL_START + i),
+                                                &hwaddr[0], hwaddr.size(),
+                                                &client_id[0],
+                                                client_id.size(), 3600,
+                                                1800, 2700, now,
+                                                SUBNET_ID)));
+
+        vector<uint8_t> addr(16, 0);
+        addr[0] = 0x20;
+        addr[1] = 0x01;
+        addr[2] = 0x0d;
+        addr[3] = 0xb8;
+        for (int j = 0; j < 4; ++j) {
+            addr[15 - j] = static_cast<uint8_t>(i >> (8 * j));
+        }
+        const IOAddress addr6 = IOAddress::fromBytes(AF_INET6, &addr[0]);
+        const DuidPtr duid(new DUID(createDuid(i)));
+        lease_mgr.addLease(Lease6Ptr(new Lease6(Lease::TYPE_NA, addr6, duid,
+                                                IAID, 3000, 4000, 1000, 2000,
+                                                SUBNET_ID)));
+    }
+}
+
+// The identifiers to look up, picked at random among the leases.
+struct Queries {
+    Queries(size_t lease_count, size_t query_count) {
+        srandom(1);
+        for (size_t i = 0; i < query_count; ++i) {
+            const uint32_t lease = random() % lease_count;
+            hwaddrs_.push_back(HWAddr(createHWAddr(lease), HTYPE_ETHER));
+            client_ids_.push_back(ClientId(createClientId(lease)));
+            duids_.push_back(DUID(createDuid(lease)));
+        }
+    }
+    vector<HWAddr> hwaddrs_;
+    vector<ClientId> client_ids_;
+    vector<DUID> duids_;
+};
+
+// Look up DHCPv4 leases by hardware address and subnet, as the allocation
+// engine does for the clients without a client identifier.
+class HWAddrBenchMark {
+public:
+    HWAddrBenchMark(const Queries& queries) : queries_(queries) {}
+    unsigned int run() {
+        const LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+        for (size_t i = 0; i < queries_.hwaddrs_.size(); ++i) {
+            if (!lease_mgr.getLease4(queries_.hwaddrs_[i], SUBNET_ID)) {
+                bundy_throw(bundy::Unexpected, "lease not found");
+            }
+        }
+        return (queries_.hwaddrs_.size());
+    }
+private:
+    const Queries& queries_;
+};
+
+// Look up DHCPv4 leases by client identifier and subnet.
+class ClientIdBenchMark {
+public:
+    ClientIdBenchMark(const Queries& queries) : queries_(queries) {}
+    unsigned int run() {
+        const LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+        for (size_t i = 0; i < queries_.client_ids_.size(); ++i) {
+            if (!lease_mgr.getLease4(queries_.client_ids_[i], SUBNET_ID)) {
+                bundy_throw(bundy::Unexpected, "lease not found");
+            }
+        }
+        return (queries_.client_ids_.size());
+    }
+private:
+    const Queries& queries_;
+};
+
+// Look up DHCPv4 leases by client identifier, in all the subnets.
+class AllClientIdBenchMark {
+public:
+    AllClientIdBenchMark(const Queries& queries) : queries_(queries) {}
+    unsigned int run() {
+        const LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+        for (size_t i = 0; i < queries_.client_ids_.size(); ++i) {
+            if (lease_mgr.getLease4(queries_.client_ids_[i]).size() != 1) {
+                bundy_throw(bundy::Unexpected, "lease not found");
+            }
+        }
+        return (queries_.client_ids_.size());
+    }
+private:
+    const Queries& queries_;
+};
+
+// Look up DHCPv6 leases by DUID, IAID and subnet.
+class DuidBenchMark {
+public:
+    DuidBenchMark(const Queries& queries) : queries_(queries) {}
+    unsigned int run() {
+        const LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+        for (size_t i = 0; i < queries_.duids_.size(); ++i) {
+            if (lease_mgr.getLeases6(Lease::TYPE_NA, queries_.duids_[i], IAID,
+                                     SUBNET_ID).size() != 1) {
+                bundy_throw(bundy::Unexpected, "lease not found");
+            }
+        }
+        return (queries_.duids_.size());
+    }
+private:
+    const Queries& queries_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: lookup_bench [-n iterations] [-l leases] "
+                 "[-q queries] [-s scan_queries]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 10;
+    size_t lease_count = 10000000;
+    size_t query_count = 100000;
+    size_t scan_query_count = 10;
+    while ((ch = getopt(argc, argv, "n:l:q:s:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'l':
+            lease_count = atoi(optarg);
+            break;
+        case 'q':
+            query_count = atoi(optarg);
+            break;
+        case 's':
+            scan_query_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || lease_count == 0 || lease_count > (1 << 24) ||
+        query_count == 0) {
+        usage();
+    }
+
+    bundy::log::initLogger("lookup-bench", bundy::log::NONE);
+
+    LeaseMgrFactory::create("type=memfile universe=4 persist=false");
+    std::cout << "Adding " << lease_count << " DHCPv4 and DHCPv6 leases"
+              << std::endl;
+    fillDatabase(lease_count);
+    const Queries queries(lease_count, query_count);
+
+    std::cout << "Benchmark for looking up " << query_count
+              << " DHCPv4 leases by hardware address and subnet" << std::endl;
+    BenchMark<HWAddrBenchMark>(iteration, HWAddrBenchMark(queries));
+
+    std::cout << "Benchmark for looking up " << query_count
+              << " DHCPv4 leases by client identifier and subnet"
+              << std::endl;
+    BenchMark<ClientIdBenchMark>(iteration, ClientIdBenchMark(queries));
+
+    std::cout << "Benchmark for looking up " << query_count
+              << " DHCPv6 leases by DUID, IAID and subnet" << std::endl;
+    BenchMark<DuidBenchMark>(iteration, DuidBenchMark(queries));
+
+    // This lookup used to scan all the leases, so it can be limited to
+    // a few queries to compare with the older versions.
+    if (scan_query_count > 0) {
+        const Queries scan_queries(lease_count,
+                                   std::min(scan_query_count, query_count));
+        std::cout << "Benchmark for looking up "
+                  << scan_queries.client_ids_.size()
+                  << " DHCPv4 leases by client identifier in all subnets"
+                  << std::endl;
+        BenchMark<AllClientIdBenchMark>(iteration,
+                                        AllClientIdBenchMark(scan_queries));
+    }
+
+    LeaseMgrFactory::destroy();
+
+    return (0);
+}
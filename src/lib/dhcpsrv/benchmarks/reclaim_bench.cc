@@ -0,0 +1,206 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/alloc_engine.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/pool.h>
+#include <dhcpsrv/subnet.h>
+#include <log/logger_support.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include <time.h>
+#include <unistd.h>
+
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+
+// The first address of the /8 pool holding the leases.
+const uint32_t POOL_START = 10 << 24;
+
+// The valid lifetime of the leases.
+const uint32_t VALID_LIFETIME = 3600;
+
+// Find the expired leases the way a server without an expiration index
+// would: by fetching all the leases and checking each of them.  Only the
+// first batch of expired leases would be reclaimed.
+class ScanBenchMark {
+public:
+    ScanBenchMark(size_t lease_count, size_t batch_size) :
+        lease_count_(lease_count), batch_size_(batch_size)
+    {}
+    unsigned int run() {
+        const Lease4Collection leases = LeaseMgrFactory::instance().
+            getLeases4(IOAddress(POOL_START),
+                       IOAddress(POOL_START + lease_count_ - 1));
+        Lease4Collection expired;
+        for (Lease4Collection::const_iterator lease = leases.begin();
+             lease != leases.end() && expired.size() < batch_size_; ++lease) {
+            if ((*lease)->expired()) {
+                expired.push_back(*lease);
+            }
+        }
+        return (1);
+    }
+private:
+    const size_t lease_count_;
+    const size_t batch_size_;
+};
+
+// Find a batch of the expired leases with the expiration index.
+class ExpiredBenchMark {
+public:
+    ExpiredBenchMark(size_t batch_size) : batch_size_(batch_size) {}
+    unsigned int run() {
+        LeaseMgrFactory::instance().getExpiredLeases4(batch_size_);
+        return (1);
+    }
+private:
+    const size_t batch_size_;
+};
+
+// Reclaim all the expired leases, a batch at a time, as the server does
+// periodically.  The leases are deleted, so this can run only once.
+class ReclaimBenchMark {
+public:
+    ReclaimBenchMark(size_t batch_size) :
+        batch_size_(batch_size), reclaimed_count_(0)
+    {}
+    unsigned int run() {
+        unsigned int batch_count = 0;
+        for (;;) {
+            const size_t count =
+                AllocEngine::reclaimExpiredLeases4(batch_size_).size();
+            if (count == 0) {
+                break;
+            }
+            reclaimed_count_ += count;
+            ++batch_count;
+        }
+        return (batch_count);
+    }
+    size_t getReclaimedCount() const {
+        return (reclaimed_count_);
+    }
+private:
+    const size_t batch_size_;
+    size_t reclaimed_count_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: reclaim_bench [-n iterations] [-l leases] "
+                 "[-e expired_percent] [-b batch_size]" << std::endl;
+    exit (1);
+}
+
+// Adds leases at consecutive addresses of the pool, the given percentage
+// of them being expired at random times.
+void
+fillDatabase(const Subnet4Ptr& subnet, size_t lease_count,
+             unsigned int expired_percent) {
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    srandom(1);
+    const time_t now = time(NULL);
+    for (size_t i = 0; i < lease_count; ++i) {
+        // Each lease needs a different hardware address.
+        const uint8_t mac[] = { 0, 0xfe, static_cast<uint8_t>(i >> 24),
+                                static_cast<uint8_t>(i >> 16),
+                                static_cast<uint8_t>(i >> 8),
+                                static_cast<uint8_t>(i) };
+        time_t cltt = now - random() % (VALID_LIFETIME / 2);
+        if (random() % 100 < expired_percent) {
+            cltt -= VALID_LIFETIME;
+        }
+        const Lease4Ptr lease(new Lease4(IOAddress(POOL_START + i),
+                                         mac, sizeof(mac), NULL, 0,
+                                         VALID_LIFETIME, subnet->getT1(),
+                                         subnet->getT2(), cltt,
+                                         subnet->getID()));
+        lease_mgr.addLease(lease);
+    }
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 10;
+    size_t lease_count = 1000000;
+    unsigned int expired_percent = 10;
+    size_t batch_size = CfgMgr::DEFAULT_MAX_RECLAIM_LEASES;
+    while ((ch = getopt(argc, argv, "n:l:e:b:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'l':
+            lease_count = atoi(optarg);
+            break;
+        case 'e':
+            expired_percent = atoi(optarg);
+            break;
+        case 'b':
+            batch_size = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || lease_count == 0 || lease_count > (1 << 24) ||
+        expired_percent > 100 || batch_size == 0) {
+        usage();
+    }
+
+    // Disable logging to avoid the messages of each reclaimed lease.
+    bundy::log::initLogger("reclaim-bench", bundy::log::NONE);
+
+    LeaseMgrFactory::create("type=memfile universe=4 persist=false");
+    const Subnet4Ptr subnet(new Subnet4(IOAddress(POOL_START), 8,
+                                        1000, 2000, VALID_LIFETIME));
+    subnet->addPool(Pool4Ptr(new Pool4(IOAddress(POOL_START), 8)));
+    CfgMgr::instance().addSubnet4(subnet);
+    fillDatabase(subnet, lease_count, expired_percent);
+
+    std::cout << "Benchmark for finding " << batch_size
+              << " expired leases by scanning " << lease_count << " leases ("
+              << expired_percent << "% expired)" << std::endl;
+    BenchMark<ScanBenchMark>(iteration,
+                             ScanBenchMark(lease_count, batch_size));
+
+    std::cout << "Benchmark for finding " << batch_size
+              << " expired leases with the expiration index" << std::endl;
+    BenchMark<ExpiredBenchMark>(iteration, ExpiredBenchMark(batch_size));
+
+    std::cout << "Benchmark for reclaiming all expired leases in batches of "
+              << batch_size << std::endl;
+    ReclaimBenchMark reclaim(batch_size);
+    BenchMark<ReclaimBenchMark>(1, reclaim, true);
+    std::cout << "Reclaimed leases: " << reclaim.getReclaimedCount()
+              << std::endl;
+
+    CfgMgr::instance().deleteSubnets4();
+    LeaseMgrFactory::destroy();
+
+    return (0);
+}
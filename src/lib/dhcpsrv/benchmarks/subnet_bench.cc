@@ -0,0 +1,165 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bench/benchmark.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/classify.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/subnet.h>
+#include <log/logger_support.h>
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+using std::vector;
+using namespace bundy::asiolink;
+using namespace bundy::bench;
+using namespace bundy::dhcp;
+
+namespace {
+// Select a subnet for each of the addresses the way CfgMgr did before the
+// subnets were indexed: by checking the subnets one by one.
+class LinearBenchMark {
+public:
+    LinearBenchMark(const Subnet4Collection& subnets,
+                    const vector<IOAddress>& addresses) :
+        subnets_(subnets), addresses_(addresses)
+    {}
+    unsigned int run() {
+        vector<IOAddress>::const_iterator it;
+        const vector<IOAddress>::const_iterator it_end = addresses_.end();
+        for (it = addresses_.begin(); it != it_end; ++it) {
+            Subnet4Ptr selected;
+            for (Subnet4Collection::const_iterator subnet = subnets_.begin();
+                 subnet != subnets_.end(); ++subnet) {
+                if ((*subnet)->clientSupported(classes_) &&
+                    (*subnet)->inRange(*it)) {
+                    selected = *subnet;
+                    break;
+                }
+            }
+            assert(selected);
+        }
+        return (addresses_.size());
+    }
+private:
+    const Subnet4Collection& subnets_;
+    const vector<IOAddress>& addresses_;
+    const ClientClasses classes_;
+};
+
+// Select a subnet for each of the addresses through CfgMgr.
+class CfgMgrBenchMark {
+public:
+    CfgMgrBenchMark(const vector<IOAddress>& addresses) :
+        addresses_(addresses)
+    {}
+    unsigned int run() {
+        const CfgMgr& cfg_mgr = CfgMgr::instance();
+        vector<IOAddress>::const_iterator it;
+        const vector<IOAddress>::const_iterator it_end = addresses_.end();
+        for (it = addresses_.begin(); it != it_end; ++it) {
+            const Subnet4Ptr subnet = cfg_mgr.getSubnet4(*it, classes_);
+            assert(subnet);
+        }
+        return (addresses_.size());
+    }
+private:
+    const vector<IOAddress>& addresses_;
+    const ClientClasses classes_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: subnet_bench [-n iterations] [-q queries] "
+                 "[-s max_subnets]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t query_count = 10000;
+    size_t max_subnet_count = 40000;
+    while ((ch = getopt(argc, argv, "n:q:s:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'q':
+            query_count = atoi(optarg);
+            break;
+        case 's':
+            max_subnet_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || query_count == 0 || max_subnet_count == 0 ||
+        max_subnet_count > 0x10000) {
+        usage();
+    }
+
+    // Disable logging to avoid the messages of each selection.
+    bundy::log::initLogger("subnet-bench", bundy::log::NONE);
+
+    // The subnets are /24 subnets starting at 10.0.0.0, their count grows
+    // ten times in each round up to the maximum.
+    CfgMgr& cfg_mgr = CfgMgr::instance();
+    for (size_t subnet_count = 10; ; subnet_count *= 10) {
+        if (subnet_count > max_subnet_count) {
+            subnet_count = max_subnet_count;
+        }
+
+        cfg_mgr.deleteSubnets4();
+        for (size_t i = 0; i < subnet_count; ++i) {
+            const uint32_t prefix = (10 << 24) + (i << 8);
+            cfg_mgr.addSubnet4(Subnet4Ptr(new Subnet4(IOAddress(prefix), 24,
+                                                      1000, 2000, 3000)));
+        }
+
+        // Addresses spread over all the subnets.
+        vector<IOAddress> addresses;
+        srandom(1);
+        for (size_t i = 0; i < query_count; ++i) {
+            addresses.push_back(IOAddress((10 << 24) +
+                                          (random() % (subnet_count << 8))));
+        }
+
+        std::cout << "Benchmark for linear subnet selection ("
+                  << subnet_count << " subnets)" << std::endl;
+        BenchMark<LinearBenchMark>(iteration,
+                                   LinearBenchMark(*cfg_mgr.getSubnets4(),
+                                                   addresses));
+
+        std::cout << "Benchmark for indexed subnet selection ("
+                  << subnet_count << " subnets)" << std::endl;
+        BenchMark<CfgMgrBenchMark>(iteration, CfgMgrBenchMark(addresses));
+
+        if (subnet_count == max_subnet_count) {
+            break;
+        }
+    }
+
+    return (0);
+}
@@ -0,0 +1,470 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/caching_lease_mgr.h>
+#include <exceptions/exceptions.h>
+
+#include <boost/foreach.hpp>
+#include <boost/tuple/tuple.hpp>
+
+using namespace bundy::asiolink;
+using bundy::util::thread::Mutex;
+
+namespace bundy {
+namespace dhcp {
+
+LeaseCache::LeaseCache(size_t max_leases) :
+    max_leases_(max_leases), version_(0), hits_(0), misses_(0)
+{
+    if (max_leases == 0) {
+        bundy_throw(BadValue, "the size of a lease cache must not be 0");
+    }
+}
+
+uint64_t
+LeaseCache::getVersion() const {
+    Mutex::Locker locker(mutex_);
+    return (version_);
+}
+
+template<typename Range>
+Lease4Ptr
+LeaseCache::getUnique4(const Range& range) {
+    typename Range::first_type lease = range.first;
+    if (lease == range.second || ++lease != range.second) {
+        ++misses_;
+        return (Lease4Ptr());
+    }
+    ++hits_;
+    storage4_.relocate(storage4_.end(),
+                       storage4_.project<0>(range.first));
+    return (range.first->toLease());
+}
+
+Lease4Ptr
+LeaseCache::getLease4(const IOAddress& addr) {
+    Mutex::Locker locker(mutex_);
+    if (!addr.isV4()) {
+        ++misses_;
+        return (Lease4Ptr());
+    }
+    const Lease4Storage::nth_index<1>::type& index = storage4_.get<1>();
+    return (getUnique4(index.equal_range(static_cast<uint32_t>(addr))));
+}
+
+Lease4Ptr
+LeaseCache::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) {
+    Mutex::Locker locker(mutex_);
+    const Lease4Storage::nth_index<2>::type& index = storage4_.get<2>();
+    return (getUnique4(index.equal_range(
+        boost::make_tuple(IdentifierKey(hwaddr.hwaddr_), subnet_id))));
+}
+
+Lease4Ptr
+LeaseCache::getLease4(const ClientId& client_id, SubnetID subnet_id) {
+    Mutex::Locker locker(mutex_);
+    const Lease4Storage::nth_index<3>::type& index = storage4_.get<3>();
+    return (getUnique4(index.equal_range(
+        boost::make_tuple(IdentifierKey(client_id.getClientId()),
+                          subnet_id))));
+}
+
+Lease4Ptr
+LeaseCache::getLease4(const ClientId& client_id, const HWAddr& hwaddr,
+                      SubnetID subnet_id) {
+    Mutex::Locker locker(mutex_);
+    const Lease4Storage::nth_index<4>::type& index = storage4_.get<4>();
+    return (getUnique4(index.equal_range(
+        boost::make_tuple(IdentifierKey(client_id.getClientId()),
+                          IdentifierKey(hwaddr.hwaddr_), subnet_id))));
+}
+
+Lease6Ptr
+LeaseCache::getLease6(Lease::Type type, const IOAddress& addr) {
+    Mutex::Locker locker(mutex_);
+    if (!addr.isV6()) {
+        ++misses_;
+        return (Lease6Ptr());
+    }
+    const Lease6Storage::nth_index<1>::type& index = storage6_.get<1>();
+    const Lease6Storage::nth_index<1>::type::const_iterator lease =
+        index.find(Address6Key(addr));
+    if (lease == index.end() || lease->getType() != type) {
+        ++misses_;
+        return (Lease6Ptr());
+    }
+    ++hits_;
+    storage6_.relocate(storage6_.end(), storage6_.project<0>(lease));
+    return (lease->toLease());
+}
+
+void
+LeaseCache::insertInternal(const Lease4Ptr& lease) {
+    Lease4Storage::nth_index<1>::type& index = storage4_.get<1>();
+    if (!lease->addr_.isV4()) {
+        return;
+    }
+    const Lease4Storage::nth_index<1>::type::iterator old =
+        index.find(static_cast<uint32_t>(lease->addr_));
+    try {
+        const PackedLease4 packed(*lease);
+        if (old != index.end()) {
+            index.replace(old, packed);
+            storage4_.relocate(storage4_.end(), storage4_.project<0>(old));
+            return;
+        }
+        storage4_.push_back(packed);
+    } catch (const BadValue&) {
+        // The lease can't be cached (its hostname is too long for
+        // instance), so the backend will return it.
+        if (old != index.end()) {
+            index.erase(old);
+        }
+        return;
+    }
+    if (storage4_.size() > max_leases_) {
+        storage4_.pop_front();
+    }
+}
+
+void
+LeaseCache::insertInternal(const Lease6Ptr& lease) {
+    Lease6Storage::nth_index<1>::type& index = storage6_.get<1>();
+    if (!lease->addr_.isV6()) {
+        return;
+    }
+    const Lease6Storage::nth_index<1>::type::iterator old =
+        index.find(Address6Key(lease->addr_));
+    try {
+        const PackedLease6 packed(*lease);
+        if (old != index.end()) {
+            index.replace(old, packed);
+            storage6_.relocate(storage6_.end(), storage6_.project<0>(old));
+            return;
+        }
+        storage6_.push_back(packed);
+    } catch (const BadValue&) {
+        if (old != index.end()) {
+            index.erase(old);
+        }
+        return;
+    }
+    if (storage6_.size() > max_leases_) {
+        storage6_.pop_front();
+    }
+}
+
+void
+LeaseCache::insert(const Lease4Ptr& lease, uint64_t version) {
+    Mutex::Locker locker(mutex_);
+    // The lease may have been changed since it was read.
+    if (lease && version == version_) {
+        insertInternal(lease);
+    }
+}
+
+void
+LeaseCache::insert(const Lease6Ptr& lease, uint64_t version) {
+    Mutex::Locker locker(mutex_);
+    if (lease && version == version_) {
+        insertInternal(lease);
+    }
+}
+
+void
+LeaseCache::update(const Lease4Ptr& lease) {
+    Mutex::Locker locker(mutex_);
+    ++version_;
+    insertInternal(lease);
+}
+
+void
+LeaseCache::update(const Lease6Ptr& lease) {
+    Mutex::Locker locker(mutex_);
+    ++version_;
+    insertInternal(lease);
+}
+
+void
+LeaseCache::erase(const IOAddress& addr) {
+    Mutex::Locker locker(mutex_);
+    ++version_;
+    if (addr.isV4()) {
+        storage4_.get<1>().erase(static_cast<uint32_t>(addr));
+    } else {
+        storage6_.get<1>().erase(Address6Key(addr));
+    }
+}
+
+void
+LeaseCache::flush() {
+    Mutex::Locker locker(mutex_);
+    ++version_;
+    storage4_.clear();
+    storage6_.clear();
+}
+
+size_t
+LeaseCache::getLease4Count() const {
+    Mutex::Locker locker(mutex_);
+    return (storage4_.size());
+}
+
+size_t
+LeaseCache::getLease6Count() const {
+    Mutex::Locker locker(mutex_);
+    return (storage6_.size());
+}
+
+uint64_t
+LeaseCache::getHits() const {
+    Mutex::Locker locker(mutex_);
+    return (hits_);
+}
+
+uint64_t
+LeaseCache::getMisses() const {
+    Mutex::Locker locker(mutex_);
+    return (misses_);
+}
+
+CachingLeaseMgr::CachingLeaseMgr(const ParameterMap& parameters,
+                                 LeaseMgr* backend,
+                                 const LeaseCachePtr& cache) :
+    LeaseMgr(parameters), backend_(backend), cache_(cache)
+{
+    if (!backend || !cache) {
+        bundy_throw(InvalidParameter, "a caching lease manager requires "
+                    "a backend and a cache");
+    }
+}
+
+CachingLeaseMgr::~CachingLeaseMgr() {
+}
+
+template<typename LeaseCollection>
+void
+CachingLeaseMgr::insert(const LeaseCollection& leases,
+                        uint64_t version) const {
+    BOOST_FOREACH(const typename LeaseCollection::value_type& lease, leases) {
+        cache_->insert(lease, version);
+    }
+}
+
+bool
+CachingLeaseMgr::addLease(const Lease4Ptr& lease) {
+    if (!backend_->addLease(lease)) {
+        return (false);
+    }
+    cache_->update(lease);
+    return (true);
+}
+
+bool
+CachingLeaseMgr::addLease(const Lease6Ptr& lease) {
+    if (!backend_->addLease(lease)) {
+        return (false);
+    }
+    cache_->update(lease);
+    return (true);
+}
+
+Lease4Ptr
+CachingLeaseMgr::getLease4(const IOAddress& addr) const {
+    Lease4Ptr lease = cache_->getLease4(addr);
+    if (!lease) {
+        const uint64_t version = cache_->getVersion();
+        lease = backend_->getLease4(addr);
+        cache_->insert(lease, version);
+    }
+    return (lease);
+}
+
+Lease4Collection
+CachingLeaseMgr::getLease4(const HWAddr& hwaddr) const {
+    const uint64_t version = cache_->getVersion();
+    const Lease4Collection leases = backend_->getLease4(hwaddr);
+    insert(leases, version);
+    return (leases);
+}
+
+Lease4Ptr
+CachingLeaseMgr::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) const {
+    Lease4Ptr lease = cache_->getLease4(hwaddr, subnet_id);
+    if (!lease) {
+        const uint64_t version = cache_->getVersion();
+        lease = backend_->getLease4(hwaddr, subnet_id);
+        cache_->insert(lease, version);
+    }
+    return (lease);
+}
+
+Lease4Collection
+CachingLeaseMgr::getLease4(const ClientId& client_id) const {
+    const uint64_t version = cache_->getVersion();
+    const Lease4Collection leases = backend_->getLease4(client_id);
+    insert(leases, version);
+    return (leases);
+}
+
+Lease4Ptr
+CachingLeaseMgr::getLease4(const ClientId& client_id, const HWAddr& hwaddr,
+                           SubnetID subnet_id) const {
+    Lease4Ptr lease = cache_->getLease4(client_id, hwaddr, subnet_id);
+    if (!lease) {
+        const uint64_t version = cache_->getVersion();
+        lease = backend_->getLease4(client_id, hwaddr, subnet_id);
+        cache_->insert(lease, version);
+    }
+    return (lease);
+}
+
+Lease4Ptr
+CachingLeaseMgr::getLease4(const ClientId& client_id,
+                           SubnetID subnet_id) const {
+    Lease4Ptr lease = cache_->getLease4(client_id, subnet_id);
+    if (!lease) {
+        const uint64_t version = cache_->getVersion();
+        lease = backend_->getLease4(client_id, subnet_id);
+        cache_->insert(lease, version);
+    }
+    return (lease);
+}
+
+Lease4Collection
+CachingLeaseMgr::getLeases4(const IOAddress& lower,
+                            const IOAddress& upper) const {
+    // The ranges are used to find the free addresses, so their leases are
+    // not worth caching.
+    return (backend_->getLeases4(lower, upper));
+}
+
+Lease6Ptr
+CachingLeaseMgr::getLease6(Lease::Type type, const IOAddress& addr) const {
+    Lease6Ptr lease = cache_->getLease6(type, addr);
+    if (!lease) {
+        const uint64_t version = cache_->getVersion();
+        lease = backend_->getLease6(type, addr);
+        cache_->insert(lease, version);
+    }
+    return (lease);
+}
+
+Lease6Collection
+CachingLeaseMgr::getLeases6(Lease::Type type, const DUID& duid,
+                            uint32_t iaid) const {
+    const uint64_t version = cache_->getVersion();
+    const Lease6Collection leases = backend_->getLeases6(type, duid, iaid);
+    insert(leases, version);
+    return (leases);
+}
+
+Lease6Collection
+CachingLeaseMgr::getLeases6(Lease::Type type, const DUID& duid,
+                            uint32_t iaid, SubnetID subnet_id) const {
+    const uint64_t version = cache_->getVersion();
+    const Lease6Collection leases = backend_->getLeases6(type, duid, iaid,
+                                                         subnet_id);
+    insert(leases, version);
+    return (leases);
+}
+
+Lease4Collection
+CachingLeaseMgr::getExpiredLeases4(size_t max_leases) const {
+    return (backend_->getExpiredLeases4(max_leases));
+}
+
+Lease6Collection
+CachingLeaseMgr::getExpiredLeases6(size_t max_leases) const {
+    return (backend_->getExpiredLeases6(max_leases));
+}
+
+void
+CachingLeaseMgr::updateLease4(const Lease4Ptr& lease4) {
+    try {
+        backend_->updateLease4(lease4);
+    } catch (...) {
+        // The cached lease may not be in the database any more.
+        cache_->erase(lease4->addr_);
+        throw;
+    }
+    cache_->update(lease4);
+}
+
+void
+CachingLeaseMgr::updateLease6(const Lease6Ptr& lease6) {
+    try {
+        backend_->updateLease6(lease6);
+    } catch (...) {
+        cache_->erase(lease6->addr_);
+        throw;
+    }
+    cache_->update(lease6);
+}
+
+bool
+CachingLeaseMgr::deleteLease(const IOAddress& addr) {
+    try {
+        const bool deleted = backend_->deleteLease(addr);
+        cache_->erase(addr);
+        return (deleted);
+    } catch (...) {
+        cache_->erase(addr);
+        throw;
+    }
+}
+
+std::string
+CachingLeaseMgr::getType() const {
+    return (backend_->getType());
+}
+
+std::string
+CachingLeaseMgr::getName() const {
+    return (backend_->getName());
+}
+
+std::string
+CachingLeaseMgr::getDescription() const {
+    return (backend_->getDescription() + " (with a lease cache)");
+}
+
+std::pair<uint32_t, uint32_t>
+CachingLeaseMgr::getVersion() const {
+    return (backend_->getVersion());
+}
+
+void
+CachingLeaseMgr::commit() {
+    backend_->commit();
+}
+
+void
+CachingLeaseMgr::waitForWrites() {
+    backend_->waitForWrites();
+}
+
+void
+CachingLeaseMgr::rollback() {
+    try {
+        backend_->rollback();
+    } catch (...) {
+        cache_->flush();
+        throw;
+    }
+    cache_->flush();
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
@@ -0,0 +1,337 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef CACHING_LEASE_MGR_H
+#define CACHING_LEASE_MGR_H
+
+#include <dhcp/hwaddr.h>
+#include <dhcpsrv/identifier_key.h>
+#include <dhcpsrv/lease_mgr.h>
+#include <dhcpsrv/packed_lease.h>
+#include <util/threads/sync.h>
+
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/indexed_by.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief A bounded cache of the recently used leases.
+///
+/// The cache holds copies of the leases which were read from, or written
+/// to, a lease database, so that @c CachingLeaseMgr can return them
+/// without querying the database again.  It holds at most a given number
+/// of DHCPv4 leases and of DHCPv6 leases: when it is full, the least
+/// recently used lease is dropped.
+///
+/// The leases are held in the compact form of the memfile backend, and
+/// found by address, or by the identifiers used by the allocation engine.
+/// A lease is returned only if it is the only cached lease matching the
+/// lookup, the caller querying the database otherwise.
+///
+/// A cache can be shared by the lease managers of several threads, so all
+/// its methods are thread safe.
+///
+/// A lease read from the database may be older than the lease written by
+/// another thread in the meantime.  To avoid caching such a lease, the
+/// readers get the version of the cache (see @c getVersion()) before
+/// querying the database, and the lease is cached only if no lease was
+/// written or deleted since.
+class LeaseCache : public boost::noncopyable {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param max_leases the maximum number of DHCPv4 leases, and of DHCPv6
+    /// leases, held by the cache.
+    /// @throw BadValue if max_leases is 0.
+    explicit LeaseCache(size_t max_leases);
+
+    /// @brief Returns the version of the cache.
+    ///
+    /// The version changes whenever a lease is written or deleted, and
+    /// when the cache is flushed.
+    uint64_t getVersion() const;
+
+    /// @brief Returns the cached DHCPv4 lease of an address.
+    Lease4Ptr getLease4(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Returns the cached DHCPv4 lease of a hardware address in a
+    /// subnet.
+    Lease4Ptr getLease4(const HWAddr& hwaddr, SubnetID subnet_id);
+
+    /// @brief Returns the cached DHCPv4 lease of a client id in a subnet.
+    Lease4Ptr getLease4(const ClientId& client_id, SubnetID subnet_id);
+
+    /// @brief Returns the cached DHCPv4 lease of a client id and hardware
+    /// address in a subnet.
+    Lease4Ptr getLease4(const ClientId& client_id, const HWAddr& hwaddr,
+                        SubnetID subnet_id);
+
+    /// @brief Returns the cached DHCPv6 lease of an address.
+    Lease6Ptr getLease6(Lease::Type type,
+                        const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Caches a DHCPv4 lease read from the database.
+    ///
+    /// @param lease the lease (it is ignored if null).
+    /// @param version the version of the cache before the lease was read.
+    void insert(const Lease4Ptr& lease, uint64_t version);
+
+    /// @brief Caches a DHCPv6 lease read from the database.
+    ///
+    /// @param lease the lease (it is ignored if null).
+    /// @param version the version of the cache before the lease was read.
+    void insert(const Lease6Ptr& lease, uint64_t version);
+
+    /// @brief Caches a DHCPv4 lease written to the database.
+    void update(const Lease4Ptr& lease);
+
+    /// @brief Caches a DHCPv6 lease written to the database.
+    void update(const Lease6Ptr& lease);
+
+    /// @brief Removes the lease of an address.
+    void erase(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Removes all the leases.
+    void flush();
+
+    /// @brief Returns the number of cached DHCPv4 leases.
+    size_t getLease4Count() const;
+
+    /// @brief Returns the number of cached DHCPv6 leases.
+    size_t getLease6Count() const;
+
+    /// @brief Returns the number of lookups which found a lease.
+    uint64_t getHits() const;
+
+    /// @brief Returns the number of lookups which didn't find a lease.
+    uint64_t getMisses() const;
+
+private:
+    /// @brief Caches a DHCPv4 lease, the mutex being locked.
+    void insertInternal(const Lease4Ptr& lease);
+
+    /// @brief Caches a DHCPv6 lease, the mutex being locked.
+    void insertInternal(const Lease6Ptr& lease);
+
+    /// @brief Returns the lease found by a lookup, and makes it the most
+    /// recently used one.
+    ///
+    /// @param range the leases matching the lookup, as returned by the
+    /// @c equal_range of an index.
+    /// @return the lease, or null if there is not exactly one lease in
+    /// the range.
+    template<typename Range>
+    Lease4Ptr getUnique4(const Range& range);
+
+    // The leases are kept in the order of their last use by the first
+    // index, the least recently used one first.
+    typedef boost::multi_index_container<
+        PackedLease4,
+        boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+
+            boost::multi_index::hashed_unique<
+                boost::multi_index::const_mem_fun<PackedLease4, uint32_t,
+                                                  &PackedLease4::getAddress>
+            >,
+
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::composite_key<
+                    PackedLease4,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getHWAddrKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, SubnetID, &PackedLease4::getSubnetId>
+                >
+            >,
+
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::composite_key<
+                    PackedLease4,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getClientIdKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, SubnetID, &PackedLease4::getSubnetId>
+                >
+            >,
+
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::composite_key<
+                    PackedLease4,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getClientIdKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getHWAddrKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, SubnetID, &PackedLease4::getSubnetId>
+                >
+            >
+        >
+    > Lease4Storage;
+
+    typedef boost::multi_index_container<
+        PackedLease6,
+        boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+
+            boost::multi_index::ordered_unique<
+                boost::multi_index::const_mem_fun<PackedLease6, Address6Key,
+                                                  &PackedLease6::getAddress>
+            >
+        >
+    > Lease6Storage;
+
+    /// @brief Protects the leases and the counters.
+    mutable bundy::util::thread::Mutex mutex_;
+
+    const size_t max_leases_;
+    Lease4Storage storage4_;
+    Lease6Storage storage6_;
+    uint64_t version_;
+    uint64_t hits_;
+    uint64_t misses_;
+};
+
+/// @brief Pointer to a lease cache.
+typedef boost::shared_ptr<LeaseCache> LeaseCachePtr;
+
+/// @brief A lease manager caching the leases of another one.
+///
+/// The DHCP servers look up the leases of a client several times during
+/// an exchange, and with the database backends each lookup is a query to
+/// the database server.  This lease manager forwards the calls to another
+/// lease manager (the backend), and keeps the leases it returns, adds and
+/// updates in a @c LeaseCache.  The lookups of a single lease are done in
+/// the cache first, so the backend is not queried for the leases of the
+/// recent clients.
+///
+/// All the writes are done by the backend first (write-through), and the
+/// cache is updated if they succeed.  The lookups of several leases (such
+/// as all the leases of a client, or the expired leases) are always done
+/// by the backend, since the cache may not hold all of them.
+///
+/// The cache is only consistent with the database if all the changes to
+/// the leases are made through the lease managers sharing it.  If the
+/// leases are changed by other means (such as an administrator editing
+/// the database), the cache must be flushed.  The cache is flushed too if
+/// a transaction is rolled back.
+class CachingLeaseMgr : public LeaseMgr {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param parameters the parameters of the lease database.
+    /// @param backend the lease manager of the database.  It is owned by
+    /// this object.
+    /// @param cache the cache of the leases, which may be shared with
+    /// other lease managers of the same database.
+    CachingLeaseMgr(const ParameterMap& parameters, LeaseMgr* backend,
+                    const LeaseCachePtr& cache);
+
+    /// @brief Destructor.
+    virtual ~CachingLeaseMgr();
+
+    /// @brief Returns the cache of the leases.
+    const LeaseCachePtr& getCache() const {
+        return (cache_);
+    }
+
+    /// @brief Returns the lease manager of the database.
+    LeaseMgr& getBackend() const {
+        return (*backend_);
+    }
+
+    virtual bool addLease(const Lease4Ptr& lease);
+    virtual bool addLease(const Lease6Ptr& lease);
+
+    virtual Lease4Ptr getLease4(const bundy::asiolink::IOAddress& addr) const;
+    virtual Lease4Collection getLease4(const HWAddr& hwaddr) const;
+    virtual Lease4Ptr getLease4(const HWAddr& hwaddr,
+                                SubnetID subnet_id) const;
+    virtual Lease4Collection getLease4(const ClientId& client_id) const;
+    virtual Lease4Ptr getLease4(const ClientId& client_id,
+                                const HWAddr& hwaddr,
+                                SubnetID subnet_id) const;
+    virtual Lease4Ptr getLease4(const ClientId& client_id,
+                                SubnetID subnet_id) const;
+    virtual Lease4Collection getLeases4(
+        const bundy::asiolink::IOAddress& lower,
+        const bundy::asiolink::IOAddress& upper) const;
+
+    virtual Lease6Ptr getLease6(Lease::Type type,
+                                const bundy::asiolink::IOAddress& addr) const;
+    virtual Lease6Collection getLeases6(Lease::Type type, const DUID& duid,
+                                        uint32_t iaid) const;
+    virtual Lease6Collection getLeases6(Lease::Type type, const DUID& duid,
+                                        uint32_t iaid,
+                                        SubnetID subnet_id) const;
+
+    virtual Lease4Collection getExpiredLeases4(size_t max_leases) const;
+    virtual Lease6Collection getExpiredLeases6(size_t max_leases) const;
+
+    virtual void updateLease4(const Lease4Ptr& lease4);
+    virtual void updateLease6(const Lease6Ptr& lease6);
+    virtual bool deleteLease(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Returns the type of the backend.
+    virtual std::string getType() const;
+
+    /// @brief Returns the name of the backend.
+    virtual std::string getName() const;
+
+    /// @brief Returns the description of the backend.
+    virtual std::string getDescription() const;
+
+    /// @brief Returns the version of the backend.
+    virtual std::pair<uint32_t, uint32_t> getVersion() const;
+
+    /// @brief Commits the transaction of the backend.
+    virtual void commit();
+
+    /// @brief Rolls back the transaction of the backend.
+    ///
+    /// As the cache may hold leases which were written in the transaction,
+    /// it is flushed.
+    virtual void rollback();
+
+    /// @brief Waits until the changes of the backend are stored.
+    virtual void waitForWrites();
+
+private:
+    /// @brief Caches the leases read from the database.
+    template<typename LeaseCollection>
+    void insert(const LeaseCollection& leases, uint64_t version) const;
+
+    boost::scoped_ptr<LeaseMgr> backend_;
+    LeaseCachePtr cache_;
+};
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // CACHING_LEASE_MGR_H
@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -18,32 +18,87 @@
 #include <hooks/hooks_manager.h>
 #include <hooks/callout_handle.h>
 
+#include <new>
+
+#include <pthread.h>
+
 namespace bundy {
 namespace dhcp {
 
+/// @brief Per-thread storage of the packet and CalloutHandle
+///
+/// Holds the pointers used by getCalloutHandle() for the calling thread.
+/// The data of each thread is allocated when the thread first uses it and
+/// deleted when the thread exits.
+///
+/// @tparam T Type of the pointer to the packet (Pkt4Ptr or Pkt6Ptr).
+template <typename T>
+class CalloutHandleSlot {
+public:
+    /// @brief Pointer to the last packet seen by the thread
+    T stored_pointer;
+
+    /// @brief Pointer to the CalloutHandle of that packet
+    bundy::hooks::CalloutHandlePtr stored_handle;
+
+    /// @brief Return the data of the calling thread
+    ///
+    /// @throw std::bad_alloc The data could not be allocated.
+    static CalloutHandleSlot& get() {
+        pthread_once(&once_, &CalloutHandleSlot::createKey);
+        CalloutHandleSlot* slot =
+            static_cast<CalloutHandleSlot*>(pthread_getspecific(key_));
+        if (slot == NULL) {
+            slot = new CalloutHandleSlot;
+            if (pthread_setspecific(key_, slot) != 0) {
+                delete slot;
+                throw std::bad_alloc();
+            }
+        }
+        return (*slot);
+    }
+
+private:
+    static void createKey() {
+        pthread_key_create(&key_, &CalloutHandleSlot::destroy);
+    }
+
+    static void destroy(void* slot) {
+        delete static_cast<CalloutHandleSlot*>(slot);
+    }
+
+    static pthread_once_t once_;
+    static pthread_key_t key_;
+};
+
+template <typename T>
+pthread_once_t CalloutHandleSlot<T>::once_ = PTHREAD_ONCE_INIT;
+
+template <typename T>
+pthread_key_t CalloutHandleSlot<T>::key_;
+
 /// @brief CalloutHandle Store
 ///
 /// When using the Hooks Framework, there is a need to associate an
 /// bundy::hooks::CalloutHandle object with each request passing through the
 /// server.  For the DHCP servers, the association is provided by this function.
 ///
-/// The DHCP servers process a single request at a time. At points where the
-/// CalloutHandle is required, the pointer to the current request (packet) is
-/// passed to this function.  If the request is a new one, a pointer to
-/// the request is stored, a new CalloutHandle is allocated (and stored) and
-/// a pointer to the latter object returned to the caller.  If the request
-/// matches the one stored, the pointer to the stored CalloutHandle is
-/// returned.
+/// Each thread of a DHCP server processes a single request at a time. At
+/// points where the CalloutHandle is required, the pointer to the current
+/// request (packet) is passed to this function.  If the request is a new
+/// one for the calling thread, a pointer to the request is stored, a new
+/// CalloutHandle is allocated (and stored) and a pointer to the latter
+/// object returned to the caller.  If the request matches the one stored,
+/// the pointer to the stored CalloutHandle is returned.
 ///
 /// A special case is a null pointer being passed.  This has the effect of
 /// clearing the stored pointers to the packet being processed and
 /// CalloutHandle.  As the stored pointers are shared pointers, clearing them
 /// removes one reference that keeps the pointed-to objects in existence.
 ///
-/// @note If the behaviour of the server changes so that multiple packets can
-///       be active at the same time, this simplistic approach will no longer
-///       be adequate and a more complicated structure (such as a map) will
-///       be needed.
+/// The pointers are stored separately for each thread (see
+/// @c CalloutHandleSlot), so that the threads processing packets in
+/// parallel each have their own CalloutHandle.
 ///
 /// @param pktptr Pointer to the packet being processed.  This is typically a
 ///        Pkt4Ptr or Pkt6Ptr object.  An empty pointer is passed to clear
@@ -57,32 +112,50 @@ namespace dhcp {
 template <typename T>
 bundy::hooks::CalloutHandlePtr getCalloutHandle(const T& pktptr) {
 
-    // Stored data is declared static, so is initialized when first accessed
-    static T stored_pointer;                // Pointer to last packet seen
-    static bundy::hooks::CalloutHandlePtr stored_handle;
-                                            // Pointer to stored handle
+    // Stored data is kept per thread, and is initialized when first accessed
+    CalloutHandleSlot<T>& slot = CalloutHandleSlot<T>::get();
 
     if (pktptr) {
 
         // Pointer given, have we seen it before? (If we have, we don't need to
         // do anything as we will automatically return the stored handle.)
-        if (pktptr != stored_pointer) {
+        if (pktptr != slot.stored_pointer) {
 
             // Not seen before, so store the pointer passed to us and get a new
             // CalloutHandle.  (The latter operation frees and probably deletes
             // (depending on other pointers) the stored one.)
-            stored_pointer = pktptr;
-            stored_handle = bundy::hooks::HooksManager::createCalloutHandle();
+            slot.stored_pointer = pktptr;
+            slot.stored_handle =
+                bundy::hooks::HooksManager::createCalloutHandle();
         }
-        
+
     } else {
 
         // Empty pointer passed, clear stored data
-        stored_pointer.reset();
-        stored_handle.reset();
+        slot.stored_pointer.reset();
+        slot.stored_handle.reset();
     }
 
-    return (stored_handle);
+    return (slot.stored_handle);
+}
+
+/// @brief Associates a CalloutHandle with a packet
+///
+/// Stores the given packet and CalloutHandle for the calling thread, so
+/// that getCalloutHandle() returns that handle for the packet.  This is
+/// used when the processing of a packet suspended by the callouts (see
+/// @c bundy::hooks::ParkingLot) is resumed, possibly by another thread:
+/// the callouts called for the rest of the processing get the handle (and
+/// so the per-library context) used before the packet was parked.
+///
+/// @param pktptr Pointer to the packet being processed.
+/// @param handle Pointer to the CalloutHandle of the packet.
+template <typename T>
+void setCalloutHandle(const T& pktptr,
+                      const bundy::hooks::CalloutHandlePtr& handle) {
+    CalloutHandleSlot<T>& slot = CalloutHandleSlot<T>::get();
+    slot.stored_pointer = pktptr;
+    slot.stored_handle = handle;
 }
 
 } // namespace shcp
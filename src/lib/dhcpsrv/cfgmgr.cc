@@ -17,6 +17,9 @@
 #include <dhcp/libdhcp++.h>
 #include <dhcpsrv/cfgmgr.h>
 #include <dhcpsrv/dhcpsrv_log.h>
+
+#include <boost/bind.hpp>
+
 #include <string>
 
 using namespace bundy::asiolink;
@@ -133,21 +136,14 @@ CfgMgr::getSubnet6(const std::string& iface,
         return (Subnet6Ptr());
     }
 
-    // If there is more than one, we need to choose the proper one
-    for (Subnet6Collection::iterator subnet = subnets6_.begin();
-         subnet != subnets6_.end(); ++subnet) {
-
-        // If client is rejected because of not meeting client class criteria...
-        if (!(*subnet)->clientSupported(classes)) {
-            continue;
-        }
-
-        if (iface == (*subnet)->getIface()) {
-            LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
-                      DHCPSRV_CFGMGR_SUBNET6_IFACE)
-                .arg((*subnet)->toText()).arg(iface);
-            return (*subnet);
-        }
+    // If there is more than one, the first one supporting the client is used
+    const size_t position = subnets6_index_.findByIface(iface, classes);
+    if (position != SubnetIndex::NOT_FOUND) {
+        const Subnet6Ptr& subnet = subnets6_[position];
+        LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
+                  DHCPSRV_CFGMGR_SUBNET6_IFACE)
+            .arg(subnet->toText()).arg(iface);
+        return (subnet);
     }
     return (Subnet6Ptr());
 }
@@ -157,29 +153,24 @@ CfgMgr::getSubnet6(const bundy::asiolink::IOAddress& hint,
                    const bundy::dhcp::ClientClasses& classes,
                    const bool relay) {
 
-    // If there is more than one, we need to choose the proper one
-    for (Subnet6Collection::iterator subnet = subnets6_.begin();
-         subnet != subnets6_.end(); ++subnet) {
-
-        // If client is rejected because of not meeting client class criteria...
-        if (!(*subnet)->clientSupported(classes)) {
-            continue;
-        }
+    // If there is more than one, the first one supporting the client is used
+    const size_t position = subnets6_index_.findByAddress(hint, classes,
+                                                          relay);
+    if (position != SubnetIndex::NOT_FOUND) {
+        const Subnet6Ptr& subnet = subnets6_[position];
 
         // If the hint is a relay address, and there is relay info specified
-        // for this subnet and those two match, then use this subnet.
-        if (relay && ((*subnet)->getRelayInfo().addr_ == hint) ) {
+        // for this subnet and those two match, then this subnet was chosen
+        // because of it.
+        if (relay && (subnet->getRelayInfo().addr_ == hint)) {
             LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
                       DHCPSRV_CFGMGR_SUBNET6_RELAY)
-                .arg((*subnet)->toText()).arg(hint.toText());
-            return (*subnet);
-        }
-
-        if ((*subnet)->inRange(hint)) {
+                .arg(subnet->toText()).arg(hint.toText());
+        } else {
             LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE, DHCPSRV_CFGMGR_SUBNET6)
-                      .arg((*subnet)->toText()).arg(hint.toText());
-            return (*subnet);
+                      .arg(subnet->toText()).arg(hint.toText());
         }
+        return (subnet);
     }
 
     // sorry, we don't support that subnet
@@ -194,23 +185,16 @@ Subnet6Ptr CfgMgr::getSubnet6(OptionPtr iface_id_option,
         return (Subnet6Ptr());
     }
 
-    // Let's iterate over all subnets and for those that have interface-id
-    // defined, check if the interface-id is equal to what we are looking for
-    for (Subnet6Collection::iterator subnet = subnets6_.begin();
-         subnet != subnets6_.end(); ++subnet) {
-
-        // If client is rejected because of not meeting client class criteria...
-        if (!(*subnet)->clientSupported(classes)) {
-            continue;
-        }
-
-        if ( (*subnet)->getInterfaceId() &&
-             ((*subnet)->getInterfaceId()->equal(iface_id_option))) {
-            LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
-                      DHCPSRV_CFGMGR_SUBNET6_IFACE_ID)
-                .arg((*subnet)->toText());
-            return (*subnet);
-        }
+    // Find the first subnet with interface-id equal to what we are looking
+    // for
+    const size_t position =
+        subnets6_index_.findByInterfaceId(*iface_id_option, classes);
+    if (position != SubnetIndex::NOT_FOUND) {
+        const Subnet6Ptr& subnet = subnets6_[position];
+        LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
+                  DHCPSRV_CFGMGR_SUBNET6_IFACE_ID)
+            .arg(subnet->toText());
+        return (subnet);
     }
     return (Subnet6Ptr());
 }
@@ -226,38 +210,34 @@ void CfgMgr::addSubnet6(const Subnet6Ptr& subnet) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE, DHCPSRV_CFGMGR_ADD_SUBNET6)
               .arg(subnet->toText());
     subnets6_.push_back(subnet);
+
+    subnets6_index_.add(*subnet, subnet->getInterfaceId());
+    subnet->setIndexed(boost::bind(&CfgMgr::rebuildSubnetIndex6, this));
 }
 
 Subnet4Ptr
 CfgMgr::getSubnet4(const bundy::asiolink::IOAddress& hint,
                    const bundy::dhcp::ClientClasses& classes,
                    bool relay) const {
-    // Iterate over existing subnets to find a suitable one for the
-    // given address.
-    for (Subnet4Collection::const_iterator subnet = subnets4_.begin();
-         subnet != subnets4_.end(); ++subnet) {
-
-        // If client is rejected because of not meeting client class criteria...
-        if (!(*subnet)->clientSupported(classes)) {
-            continue;
-        }
+    // Find the first subnet supporting the client for the given address.
+    const size_t position = subnets4_index_.findByAddress(hint, classes,
+                                                          relay);
+    if (position != SubnetIndex::NOT_FOUND) {
+        const Subnet4Ptr& subnet = subnets4_[position];
 
         // If the hint is a relay address, and there is relay info specified
-        // for this subnet and those two match, then use this subnet.
-        if (relay && ((*subnet)->getRelayInfo().addr_ == hint) ) {
+        // for this subnet and those two match, then this subnet was chosen
+        // because of it.
+        if (relay && (subnet->getRelayInfo().addr_ == hint)) {
             LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
                       DHCPSRV_CFGMGR_SUBNET4_RELAY)
-                .arg((*subnet)->toText()).arg(hint.toText());
-            return (*subnet);
-        }
-
-        // Let's check if the client belongs to the given subnet
-        if ((*subnet)->inRange(hint)) {
+                .arg(subnet->toText()).arg(hint.toText());
+        } else {
             LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE,
                       DHCPSRV_CFGMGR_SUBNET4)
-                      .arg((*subnet)->toText()).arg(hint.toText());
-            return (*subnet);
+                      .arg(subnet->toText()).arg(hint.toText());
         }
+        return (subnet);
     }
 
     // sorry, we don't support that subnet
@@ -293,6 +273,9 @@ void CfgMgr::addSubnet4(const Subnet4Ptr& subnet) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE, DHCPSRV_CFGMGR_ADD_SUBNET4)
               .arg(subnet->toText());
     subnets4_.push_back(subnet);
+
+    subnets4_index_.add(*subnet);
+    subnet->setIndexed(boost::bind(&CfgMgr::rebuildSubnetIndex4, this));
 }
 
 void CfgMgr::deleteOptionDefs() {
@@ -301,12 +284,42 @@ void CfgMgr::deleteOptionDefs() {
 
 void CfgMgr::deleteSubnets4() {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE, DHCPSRV_CFGMGR_DELETE_SUBNET4);
+    // The subnets may still be referenced elsewhere, and no longer update
+    // the index if they are changed.
+    for (Subnet4Collection::const_iterator subnet = subnets4_.begin();
+         subnet != subnets4_.end(); ++subnet) {
+        (*subnet)->setIndexed(Subnet::IndexCallback());
+    }
     subnets4_.clear();
+    subnets4_index_.clear();
 }
 
 void CfgMgr::deleteSubnets6() {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE, DHCPSRV_CFGMGR_DELETE_SUBNET6);
+    for (Subnet6Collection::const_iterator subnet = subnets6_.begin();
+         subnet != subnets6_.end(); ++subnet) {
+        (*subnet)->setIndexed(Subnet::IndexCallback());
+    }
     subnets6_.clear();
+    subnets6_index_.clear();
+}
+
+void
+CfgMgr::rebuildSubnetIndex4() {
+    subnets4_index_.clear();
+    for (Subnet4Collection::const_iterator subnet = subnets4_.begin();
+         subnet != subnets4_.end(); ++subnet) {
+        subnets4_index_.add(**subnet);
+    }
+}
+
+void
+CfgMgr::rebuildSubnetIndex6() {
+    subnets6_index_.clear();
+    for (Subnet6Collection::const_iterator subnet = subnets6_.begin();
+         subnet != subnets6_.end(); ++subnet) {
+        subnets6_index_.add(**subnet, (*subnet)->getInterfaceId());
+    }
 }
 
 
@@ -437,10 +450,17 @@ CfgMgr::getD2ClientMgr() {
     return (d2_client_mgr_);
 }
 
+const uint32_t CfgMgr::DEFAULT_RECLAIM_TIMER_WAIT_TIME;
+const uint32_t CfgMgr::DEFAULT_MAX_RECLAIM_LEASES;
+const uint32_t CfgMgr::DEFAULT_PARKED_PACKET_LIMIT;
+
 CfgMgr::CfgMgr()
     : datadir_(DHCP_DATA_DIR),
-      all_ifaces_active_(false), echo_v4_client_id_(true),
-      d2_client_mgr_() {
+      all_ifaces_active_(false), echo_v4_client_id_(true), worker_threads_(0),
+      reclaim_timer_wait_time_(DEFAULT_RECLAIM_TIMER_WAIT_TIME),
+      max_reclaim_leases_(DEFAULT_MAX_RECLAIM_LEASES),
+      parked_packet_limit_(DEFAULT_PARKED_PACKET_LIMIT),
+      client_classifier_(), d2_client_mgr_() {
     // DHCP_DATA_DIR must be set set with -DDHCP_DATA_DIR="..." in Makefile.am
     // Note: the definition of DHCP_DATA_DIR needs to include quotation marks
     // See AM_CPPFLAGS definition in Makefile.am
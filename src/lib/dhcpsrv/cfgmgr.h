@@ -20,10 +20,12 @@
 #include <dhcp/option_definition.h>
 #include <dhcp/option_space.h>
 #include <dhcp/classify.h>
+#include <dhcpsrv/client_classifier.h>
 #include <dhcpsrv/d2_client_mgr.h>
 #include <dhcpsrv/option_space_container.h>
 #include <dhcpsrv/pool.h>
 #include <dhcpsrv/subnet.h>
+#include <dhcpsrv/subnet_index.h>
 #include <util/buffer.h>
 
 #include <boost/shared_ptr.hpp>
@@ -93,6 +95,14 @@ public:
 /// @todo: Implement parameter inheritance
 class CfgMgr : public boost::noncopyable {
 public:
+    /// Default interval between the reclamations of expired leases
+    static const uint32_t DEFAULT_RECLAIM_TIMER_WAIT_TIME = 10;
+
+    /// Default maximum number of leases reclaimed at a time
+    static const uint32_t DEFAULT_MAX_RECLAIM_LEASES = 100;
+
+    /// Default maximum number of packets parked by the callouts
+    static const uint32_t DEFAULT_PARKED_PACKET_LIMIT = 256;
 
     /// @brief returns a single instance of Configuration Manager
     ///
@@ -397,6 +407,88 @@ public:
         return (echo_v4_client_id_);
     }
 
+    /// @brief Sets the number of threads processing packets.
+    ///
+    /// With 0 (the default), the packets are processed one at a time by
+    /// the thread receiving them.  Otherwise the receiving thread hands
+    /// them over to the given number of worker threads.
+    ///
+    /// @param threads number of worker threads
+    void setWorkerThreads(const uint32_t threads) {
+        worker_threads_ = threads;
+    }
+
+    /// @brief Returns the number of threads processing packets.
+    /// @return number of worker threads, 0 if packets are processed by the
+    /// receiving thread
+    uint32_t getWorkerThreads() const {
+        return (worker_threads_);
+    }
+
+    /// @brief Sets the interval between the reclamations of expired leases.
+    ///
+    /// The servers periodically delete a batch of expired leases from the
+    /// lease database (see @c setMaxReclaimLeases).
+    ///
+    /// @param seconds interval in seconds, 0 to disable the reclamation
+    void setReclaimTimerWaitTime(const uint32_t seconds) {
+        reclaim_timer_wait_time_ = seconds;
+    }
+
+    /// @brief Returns the interval between the reclamations of expired
+    /// leases.
+    /// @return interval in seconds, 0 if the reclamation is disabled
+    uint32_t getReclaimTimerWaitTime() const {
+        return (reclaim_timer_wait_time_);
+    }
+
+    /// @brief Sets the maximum number of leases reclaimed at a time.
+    ///
+    /// Bounds the time each reclamation takes away from packet processing.
+    ///
+    /// @param max_leases maximum number of leases, 0 for no limit
+    void setMaxReclaimLeases(const uint32_t max_leases) {
+        max_reclaim_leases_ = max_leases;
+    }
+
+    /// @brief Returns the maximum number of leases reclaimed at a time.
+    /// @return maximum number of leases, 0 for no limit
+    uint32_t getMaxReclaimLeases() const {
+        return (max_reclaim_leases_);
+    }
+
+    /// @brief Sets the maximum number of packets parked by the callouts.
+    ///
+    /// The packets whose processing is suspended by the callouts of a hook
+    /// (see @c bundy::hooks::ParkingLot) are held until the callouts let
+    /// them go.  Once the limit is reached, the packets the callouts would
+    /// park are dropped.
+    ///
+    /// @param limit maximum number of parked packets per hook
+    void setParkedPacketLimit(const uint32_t limit) {
+        parked_packet_limit_ = limit;
+    }
+
+    /// @brief Returns the maximum number of packets parked by the callouts.
+    /// @return maximum number of parked packets per hook
+    uint32_t getParkedPacketLimit() const {
+        return (parked_packet_limit_);
+    }
+
+    /// @brief Sets the classifier of the classes of the configuration.
+    ///
+    /// @param classifier the classifier, or null if no class is configured.
+    void setClientClassifier(const ClientClassifierPtr& classifier) {
+        client_classifier_ = classifier;
+    }
+
+    /// @brief Returns the classifier of the classes of the configuration.
+    ///
+    /// @return the classifier, or null if no class is configured.
+    const ClientClassifierPtr& getClientClassifier() const {
+        return (client_classifier_);
+    }
+
     /// @brief Updates the DHCP-DDNS client configuration to the given value.
     ///
     /// @param new_config pointer to the new client configuration.
@@ -435,22 +527,43 @@ protected:
 
     /// @brief a container for IPv6 subnets.
     ///
-    /// That is a simple vector of pointers. It does not make much sense to
-    /// optimize access time (e.g. using a map), because typical search
-    /// pattern will use calling inRange() method on each subnet until
-    /// a match is found.
+    /// That is a simple vector of pointers, the subnets are selected
+    /// using @c subnets6_index_.
     Subnet6Collection subnets6_;
 
     /// @brief a container for IPv4 subnets.
     ///
-    /// That is a simple vector of pointers. It does not make much sense to
-    /// optimize access time (e.g. using a map), because typical search
-    /// pattern will use calling inRange() method on each subnet until
-    /// a match is found.
+    /// That is a simple vector of pointers, the subnets are selected
+    /// using @c subnets4_index_.
     Subnet4Collection subnets4_;
 
 private:
 
+    /// @brief Rebuilds the index of IPv4 subnets.
+    ///
+    /// Called when the selection parameters of an IPv4 subnet are changed
+    /// after adding it (see @c Subnet::setIndexed).
+    void rebuildSubnetIndex4();
+
+    /// @brief Rebuilds the index of IPv6 subnets.
+    ///
+    /// Called when the selection parameters of an IPv6 subnet are changed
+    /// after adding it (see @c Subnet::setIndexed).
+    void rebuildSubnetIndex6();
+
+    /// @brief Index of @c subnets4_, the positions in the index being
+    /// the positions in the collection.
+    ///
+    /// The index is updated when a subnet is added and rebuilt when the
+    /// selection parameters of a subnet are changed, by the thread changing
+    /// the configuration.  The servers change it in the exclusive section
+    /// of their worker threads, so the threads selecting subnets only read
+    /// it.
+    SubnetIndex subnets4_index_;
+
+    /// @brief Index of @c subnets6_ (see @c subnets4_index_).
+    SubnetIndex subnets6_index_;
+
     /// @brief Checks if the specified interface is listed as active.
     ///
     /// This function searches for the specified interface name on the list of
@@ -514,6 +627,21 @@ private:
     /// Indicates whether v4 server should send back client-id
     bool echo_v4_client_id_;
 
+    /// Number of threads processing packets (0 means no worker threads)
+    uint32_t worker_threads_;
+
+    /// Seconds between the reclamations of expired leases (0 disables them)
+    uint32_t reclaim_timer_wait_time_;
+
+    /// Maximum number of leases reclaimed at a time (0 means no limit)
+    uint32_t max_reclaim_leases_;
+
+    /// Maximum number of packets parked by the callouts of a hook
+    uint32_t parked_packet_limit_;
+
+    /// Classifier of the classes of the configuration
+    ClientClassifierPtr client_classifier_;
+
     /// @brief Manages the DHCP-DDNS client and its configuration.
     D2ClientMgr d2_client_mgr_;
 };
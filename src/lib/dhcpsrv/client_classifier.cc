@@ -0,0 +1,605 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcp/dhcp4.h>
+#include <dhcp/hwaddr.h>
+#include <dhcpsrv/client_classifier.h>
+#include <util/buffer.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using bundy::util::OutputBuffer;
+
+namespace {
+
+/// @brief Character classes of the tests, which may hold any byte.
+inline bool
+isSpace(char c) {
+    return (std::isspace(static_cast<unsigned char>(c)));
+}
+
+inline bool
+isDigit(char c) {
+    return (std::isdigit(static_cast<unsigned char>(c)));
+}
+
+inline bool
+isXDigit(char c) {
+    return (std::isxdigit(static_cast<unsigned char>(c)));
+}
+
+inline bool
+isAlpha(char c) {
+    return (std::isalpha(static_cast<unsigned char>(c)));
+}
+
+inline bool
+isAlnum(char c) {
+    return (std::isalnum(static_cast<unsigned char>(c)));
+}
+
+/// @brief A value on the stack of the program.
+///
+/// The data are those of a field or constant, or none for the result of
+/// a comparison, which is true if the value is present.
+struct Value {
+    Value() : data_(NULL), len_(0), present_(false) {}
+
+    explicit Value(bool present) : data_(NULL), len_(0), present_(present) {}
+
+    Value(const uint8_t* data, size_t len) :
+        data_(data), len_(len), present_(true)
+    {}
+
+    const uint8_t* data_;
+    size_t len_;
+    bool present_;
+};
+
+/// @brief A field of the packet, read when an instruction first uses it.
+struct FieldValue {
+    FieldValue() : read_(false), packed_(0) {}
+
+    bool read_;
+    Value value_;
+
+    /// @brief The option holding the data.
+    bundy::dhcp::OptionPtr option_;
+
+    /// @brief The data of an option not held as raw data.
+    OutputBuffer packed_;
+};
+
+/// @brief Sets the value of a field to the data of an option.
+///
+/// Most options hold their data as received, but some of them only hold
+/// the decoded values (or their sub-options), and are packed to get their
+/// data.
+void
+setOptionValue(FieldValue& field, const bundy::dhcp::OptionPtr& option) {
+    if (!option) {
+        return;
+    }
+    field.option_ = option;
+    const bundy::dhcp::OptionBuffer& data = option->getData();
+    if (!data.empty() && option->getOptions().empty()) {
+        field.value_ = Value(&data[0], data.size());
+        return;
+    }
+    option->pack(field.packed_);
+    const size_t header_len = option->getHeaderLen();
+    if (field.packed_.getLength() <= header_len) {
+        field.value_ = Value(NULL, 0);
+    } else {
+        field.value_ =
+            Value(static_cast<const uint8_t*>(field.packed_.getData()) +
+                  header_len, field.packed_.getLength() - header_len);
+    }
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+const size_t ClientClassifier::MAX_STACK_DEPTH;
+
+/// @brief Compiles the test of a class into the program of the classifier.
+///
+/// The test is parsed by recursive descent, the instructions being emitted
+/// as the expressions are parsed.  The operators, from the lowest
+/// precedence: @c or, @c and, @c not, @c ==.
+class ClientClassifier::Compiler {
+public:
+    Compiler(ClientClassifier& classifier, const std::string& test) :
+        classifier_(classifier), test_(test), pos_(0), start_(0),
+        type_(TOKEN_END), depth_(0)
+    {}
+
+    /// @brief Compiles the test of a class.
+    ///
+    /// @param index the index of the class.
+    void compile(uint32_t index) {
+        next();
+        if (type_ == TOKEN_END) {
+            error("empty test");
+        }
+        parseOr();
+        if (type_ != TOKEN_END) {
+            error("unexpected '" + text_ + "'");
+        }
+        emit(OP_CLASS, index);
+        pop();
+    }
+
+private:
+    enum TokenType {
+        TOKEN_END,
+        TOKEN_NAME,
+        TOKEN_NUMBER,
+        TOKEN_STRING,
+        TOKEN_HEX,
+        TOKEN_SYMBOL
+    };
+
+    /// @brief Reads the next token.
+    void next() {
+        while (pos_ < test_.size() && isSpace(test_[pos_])) {
+            ++pos_;
+        }
+        start_ = pos_;
+        text_.clear();
+        if (pos_ == test_.size()) {
+            type_ = TOKEN_END;
+            return;
+        }
+
+        const char c = test_[pos_];
+        if (isAlpha(c) || c == '_') {
+            while (pos_ < test_.size() &&
+                   (isAlnum(test_[pos_]) || test_[pos_] == '_' ||
+                    test_[pos_] == '-')) {
+                ++pos_;
+            }
+            type_ = TOKEN_NAME;
+        } else if (c == '0' && pos_ + 1 < test_.size() &&
+                   (test_[pos_ + 1] == 'x' || test_[pos_ + 1] == 'X')) {
+            pos_ += 2;
+            while (pos_ < test_.size() && isXDigit(test_[pos_])) {
+                ++pos_;
+            }
+            if (pos_ == start_ + 2) {
+                error("missing hexadecimal digits");
+            }
+            type_ = TOKEN_HEX;
+        } else if (isDigit(c)) {
+            while (pos_ < test_.size() && isDigit(test_[pos_])) {
+                ++pos_;
+            }
+            type_ = TOKEN_NUMBER;
+        } else if (c == '\'' || c == '"') {
+            const size_t end = test_.find(c, pos_ + 1);
+            if (end == std::string::npos) {
+                error("unterminated string");
+            }
+            text_ = test_.substr(pos_ + 1, end - pos_ - 1);
+            pos_ = end + 1;
+            type_ = TOKEN_STRING;
+            return;
+        } else if (c == '=' && pos_ + 1 < test_.size() &&
+                   test_[pos_ + 1] == '=') {
+            pos_ += 2;
+            type_ = TOKEN_SYMBOL;
+        } else if (std::strchr("()[],", c) != NULL) {
+            ++pos_;
+            type_ = TOKEN_SYMBOL;
+        } else {
+            error(std::string("unexpected character '") + c + "'");
+        }
+        text_ = test_.substr(start_, pos_ - start_);
+    }
+
+    /// @brief Reads the next token if the current one is the given name or
+    /// symbol.
+    bool accept(const char* text) {
+        if ((type_ == TOKEN_NAME || type_ == TOKEN_SYMBOL) && text_ == text) {
+            next();
+            return (true);
+        }
+        return (false);
+    }
+
+    /// @brief Reads the next token, which must be the given one.
+    void expect(const char* text) {
+        if (!accept(text)) {
+            error(std::string("expected '") + text + "'");
+        }
+    }
+
+    /// @brief Reads a number not greater than the maximum.
+    uint32_t number(uint32_t max) {
+        if (type_ != TOKEN_NUMBER) {
+            error("expected a number");
+        }
+        uint32_t value = 0;
+        for (std::string::const_iterator c = text_.begin(); c != text_.end();
+             ++c) {
+            if (value > (max - (*c - '0')) / 10) {
+                error("number " + text_ + " is too large");
+            }
+            value = value * 10 + (*c - '0');
+        }
+        next();
+        return (value);
+    }
+
+    /// @brief Reads an option code in brackets.
+    uint16_t code() {
+        expect("[");
+        const uint16_t value =
+            number(classifier_.universe_ == Option::V4 ? 255 : 65535);
+        expect("]");
+        return (value);
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (accept("or")) {
+            parseJump(OP_JUMP_TRUE, &Compiler::parseAnd);
+        }
+    }
+
+    void parseAnd() {
+        parseNot();
+        while (accept("and")) {
+            parseJump(OP_JUMP_FALSE, &Compiler::parseNot);
+        }
+    }
+
+    /// @brief Parses the right operand of @c or / @c and, skipped when the
+    /// left one decides the result.
+    void parseJump(OpCode op, void (Compiler::*parse)()) {
+        const size_t jump = classifier_.program_.size();
+        emit(op, 0);
+        pop();
+        (this->*parse)();
+        classifier_.program_[jump].b_ = classifier_.program_.size();
+    }
+
+    void parseNot() {
+        if (accept("not")) {
+            parseNot();
+            emit(OP_NOT, 0);
+            return;
+        }
+        parseValue();
+        if (accept("==")) {
+            parseValue();
+            emit(OP_EQUAL, 0);
+            pop();
+        }
+    }
+
+    void parseValue() {
+        if (type_ == TOKEN_STRING) {
+            addConstant(OptionBuffer(text_.begin(), text_.end()));
+            next();
+        } else if (type_ == TOKEN_HEX) {
+            // An odd number of digits is read as if it had a leading 0.
+            std::string digits = text_.substr(2);
+            if (digits.size() % 2 != 0) {
+                digits.insert(digits.begin(), '0');
+            }
+            OptionBuffer data;
+            for (size_t i = 0; i < digits.size(); i += 2) {
+                data.push_back(static_cast<uint8_t>(
+                    std::strtoul(digits.substr(i, 2).c_str(), NULL, 16)));
+            }
+            addConstant(data);
+            next();
+        } else if (accept("(")) {
+            parseOr();
+            expect(")");
+        } else if (accept("option")) {
+            addField(Field(FIELD_OPTION, code()));
+        } else if (accept("relay")) {
+            addField(Field(FIELD_RELAY, code()));
+        } else if (accept("hwaddr")) {
+            if (classifier_.universe_ != Option::V4) {
+                error("hwaddr is only available in DHCPv4");
+            }
+            addField(Field(FIELD_HWADDR, 0));
+        } else if (accept("substring")) {
+            expect("(");
+            parseOr();
+            expect(",");
+            const uint32_t start = number(0xffffffff);
+            expect(",");
+            uint32_t length = 0xffffffff;
+            if (!accept("all")) {
+                length = number(0xffffffff);
+            }
+            expect(")");
+            emit(OP_SUBSTRING, start, length);
+        } else if (accept("member")) {
+            expect("(");
+            if (type_ != TOKEN_STRING) {
+                error("expected a class name");
+            }
+            const std::map<ClientClass, uint32_t>::const_iterator it =
+                classifier_.indexes_.find(text_);
+            if (it == classifier_.indexes_.end()) {
+                error("unknown class '" + text_ + "'");
+            }
+            next();
+            expect(")");
+            emit(OP_MEMBER, it->second);
+            push();
+        } else if (type_ == TOKEN_END) {
+            error("unexpected end");
+        } else {
+            error("unexpected '" + text_ + "'");
+        }
+    }
+
+    void addConstant(const OptionBuffer& data) {
+        emit(OP_CONSTANT, classifier_.constants_.size());
+        classifier_.constants_.push_back(data);
+        push();
+    }
+
+    void addField(const Field& field) {
+        std::vector<Field>& fields = classifier_.fields_;
+        const size_t index =
+            std::find(fields.begin(), fields.end(), field) - fields.begin();
+        if (index == fields.size()) {
+            fields.push_back(field);
+        }
+        emit(OP_FIELD, index);
+        push();
+    }
+
+    void emit(OpCode op, uint32_t a, uint32_t b = 0) {
+        classifier_.program_.push_back(Instruction(op, a, b));
+    }
+
+    void push() {
+        if (++depth_ > MAX_STACK_DEPTH) {
+            error("expression too complex");
+        }
+    }
+
+    void pop() {
+        --depth_;
+    }
+
+    void error(const std::string& reason) {
+        bundy_throw(ClassExpressionError, "client class test '" << test_ <<
+                    "': " << reason << " at position " << start_);
+    }
+
+    ClientClassifier& classifier_;
+    const std::string& test_;
+
+    /// @brief The position following the current token.
+    size_t pos_;
+
+    /// @brief The position of the current token.
+    size_t start_;
+
+    TokenType type_;
+    std::string text_;
+
+    /// @brief The depth of the stack after the instructions emitted.
+    size_t depth_;
+};
+
+ClientClassifier::ClientClassifier(Option::Universe universe) :
+    universe_(universe)
+{}
+
+void
+ClientClassifier::addClass(const ClientClass& name, const std::string& test) {
+    if (indexes_.count(name) > 0) {
+        bundy_throw(ClassExpressionError, "client class '" << name <<
+                    "' is defined twice");
+    }
+
+    // The program is left as it was if the test is not valid.
+    const size_t fields = fields_.size();
+    const size_t constants = constants_.size();
+    const size_t program = program_.size();
+    try {
+        Compiler(*this, test).compile(names_.size());
+    } catch (...) {
+        fields_.resize(fields);
+        constants_.resize(constants);
+        program_.resize(program, Instruction(OP_NOT, 0));
+        throw;
+    }
+    indexes_[name] = names_.size();
+    names_.push_back(name);
+}
+
+namespace {
+
+// The fields of the packets of each universe.
+
+OptionPtr
+getOption(Pkt4& pkt, uint16_t code) {
+    return (pkt.getOption(code));
+}
+
+OptionPtr
+getOption(Pkt6& pkt, uint16_t code) {
+    return (pkt.getOption(code));
+}
+
+void
+setRelayValue(FieldValue& field, Pkt4& pkt, uint16_t code) {
+    const OptionPtr agent_options = pkt.getOption(DHO_DHCP_AGENT_OPTIONS);
+    if (!agent_options) {
+        return;
+    }
+    if (!agent_options->getOptions().empty()) {
+        setOptionValue(field, agent_options->getOption(code));
+        return;
+    }
+
+    // The sub-options are usually left in the data of the option, as the
+    // option is received: they are looked up there.
+    const OptionBuffer& data = agent_options->getData();
+    size_t offset = 0;
+    while (offset + 2 <= data.size()) {
+        const size_t len = data[offset + 1];
+        if (offset + 2 + len > data.size()) {
+            return;
+        }
+        if (data[offset] == code) {
+            field.option_ = agent_options;
+            field.value_ = (len == 0) ? Value(NULL, 0) :
+                Value(&data[offset + 2], len);
+            return;
+        }
+        offset += 2 + len;
+    }
+}
+
+void
+setRelayValue(FieldValue& field, Pkt6& pkt, uint16_t code) {
+    setOptionValue(field, pkt.getAnyRelayOption(code,
+                                                Pkt6::RELAY_SEARCH_FROM_CLIENT));
+}
+
+void
+setHWAddrValue(FieldValue& field, Pkt4& pkt) {
+    const HWAddrPtr hwaddr = pkt.getHWAddr();
+    if (hwaddr) {
+        field.value_ = hwaddr->hwaddr_.empty() ? Value(NULL, 0) :
+            Value(&hwaddr->hwaddr_[0], hwaddr->hwaddr_.size());
+    }
+}
+
+void
+setHWAddrValue(FieldValue&, Pkt6&) {
+    // Not compiled for DHCPv6.
+}
+
+}
+
+template <typename PacketType>
+size_t
+ClientClassifier::run(PacketType& pkt) const {
+    if (program_.empty()) {
+        return (0);
+    }
+
+    std::vector<FieldValue> fields(fields_.size());
+    std::vector<bool> member(names_.size());
+    Value stack[MAX_STACK_DEPTH];
+    size_t top = 0;
+    size_t count = 0;
+    for (size_t pc = 0; pc < program_.size(); ++pc) {
+        const Instruction& instruction = program_[pc];
+        switch (instruction.op_) {
+        case OP_FIELD: {
+            FieldValue& field = fields[instruction.a_];
+            if (!field.read_) {
+                const Field& kind = fields_[instruction.a_];
+                if (kind.first == FIELD_OPTION) {
+                    setOptionValue(field, getOption(pkt, kind.second));
+                } else if (kind.first == FIELD_RELAY) {
+                    setRelayValue(field, pkt, kind.second);
+                } else {
+                    setHWAddrValue(field, pkt);
+                }
+                field.read_ = true;
+            }
+            stack[top++] = field.value_;
+            break;
+        }
+        case OP_CONSTANT: {
+            const OptionBuffer& data = constants_[instruction.a_];
+            stack[top++] = data.empty() ? Value(NULL, 0) :
+                Value(&data[0], data.size());
+            break;
+        }
+        case OP_MEMBER:
+            stack[top++] = Value(static_cast<bool>(member[instruction.a_]));
+            break;
+        case OP_SUBSTRING: {
+            Value& value = stack[top - 1];
+            if (instruction.a_ >= value.len_) {
+                value.len_ = 0;
+            } else {
+                value.data_ += instruction.a_;
+                value.len_ = std::min<size_t>(value.len_ - instruction.a_,
+                                              instruction.b_);
+            }
+            break;
+        }
+        case OP_EQUAL: {
+            const Value& right = stack[--top];
+            Value& left = stack[top - 1];
+            left = Value(left.present_ && right.present_ &&
+                         (left.len_ == right.len_) &&
+                         ((left.len_ == 0) ||
+                          (std::memcmp(left.data_, right.data_,
+                                       left.len_) == 0)));
+            break;
+        }
+        case OP_NOT:
+            stack[top - 1] = Value(!stack[top - 1].present_);
+            break;
+        case OP_JUMP_FALSE:
+            if (!stack[top - 1].present_) {
+                pc = instruction.b_ - 1;
+            } else {
+                --top;
+            }
+            break;
+        case OP_JUMP_TRUE:
+            if (stack[top - 1].present_) {
+                pc = instruction.b_ - 1;
+            } else {
+                --top;
+            }
+            break;
+        case OP_CLASS:
+            if (stack[--top].present_) {
+                member[instruction.a_] = true;
+                pkt.addClass(names_[instruction.a_]);
+                ++count;
+            }
+            break;
+        }
+    }
+    return (count);
+}
+
+size_t
+ClientClassifier::classify(Pkt4& pkt) const {
+    return (run(pkt));
+}
+
+size_t
+ClientClassifier::classify(Pkt6& pkt) const {
+    return (run(pkt));
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
@@ -0,0 +1,198 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef CLIENT_CLASSIFIER_H
+#define CLIENT_CLASSIFIER_H
+
+#include <dhcp/classify.h>
+#include <dhcp/option.h>
+#include <dhcp/pkt4.h>
+#include <dhcp/pkt6.h>
+#include <exceptions/exceptions.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Exception thrown when the test of a client class is not valid.
+class ClassExpressionError : public Exception {
+public:
+    ClassExpressionError(const char* file, size_t line, const char* what) :
+        bundy::Exception(file, line, what) {}
+};
+
+/// @brief Assigns the packets to the classes of the configuration.
+///
+/// Each class is defined by its name and a test, an expression over the
+/// content of the packet made of:
+/// - @c option[code], the data of an option of the packet,
+/// - @c relay[code], the data of a sub-option of the relay agent
+///   information option (DHCPv4), or of an option inserted by a relay
+///   (DHCPv6, the relays closest to the client being searched first),
+/// - @c hwaddr, the hardware address of the client (DHCPv4 only),
+/// - @c substring(value, start, length), a part of a value, the length
+///   being @c all for the rest of the value,
+/// - 'text' and 0x0123 constants,
+/// - @c member('name'), true if the packet belongs to a class added
+///   before,
+/// - @c value @c == @c value, @c not, @c and, @c or and parentheses.
+///
+/// A value alone is true if it is present in the packet, so
+/// @c option[82] tests that the packet has option 82.  For example, the
+/// class of the DOCSIS 3.0 cable modems relayed with a remote id would be
+/// tested by:
+/// @code
+/// substring(option[60], 0, 9) == 'docsis3.0' and relay[2]
+/// @endcode
+///
+/// The tests are compiled as the classes are added, all of them into a
+/// single program for a stack machine.  The fields of the packet the
+/// tests refer to are numbered when they are compiled, so that a packet
+/// is classified by running the program once, each field being read from
+/// the packet at most once.  The values are not copied: they refer to the
+/// data of the options of the packet.
+///
+/// The classifier is not changed once the configuration is committed, so
+/// it may be used by several threads.
+class ClientClassifier : public boost::noncopyable {
+public:
+    /// @brief The maximum depth of the stack of the program.
+    static const size_t MAX_STACK_DEPTH = 32;
+
+    /// @brief Constructor.
+    ///
+    /// @param universe the universe of the packets classified.
+    explicit ClientClassifier(Option::Universe universe);
+
+    /// @brief Adds a class.
+    ///
+    /// @param name the name of the class.
+    /// @param test the expression tested on the packets.
+    ///
+    /// @throw ClassExpressionError if the test is not valid, or if a class
+    /// with the same name was added.
+    void addClass(const ClientClass& name, const std::string& test);
+
+    /// @brief Returns the number of classes.
+    size_t getClassCount() const {
+        return (names_.size());
+    }
+
+    /// @brief Returns the name of a class.
+    ///
+    /// @param index the index of the class, in the order they were added.
+    const ClientClass& getClassName(size_t index) const {
+        return (names_[index]);
+    }
+
+    /// @brief Returns the number of fields of the packet read by the tests.
+    size_t getFieldCount() const {
+        return (fields_.size());
+    }
+
+    /// @brief Returns the number of instructions of the program.
+    size_t getProgramSize() const {
+        return (program_.size());
+    }
+
+    /// @brief Adds a DHCPv4 packet to the classes whose test it passes.
+    ///
+    /// @param pkt the packet.
+    ///
+    /// @return the number of classes the packet was added to.
+    size_t classify(Pkt4& pkt) const;
+
+    /// @brief Adds a DHCPv6 packet to the classes whose test it passes.
+    ///
+    /// @param pkt the packet.
+    ///
+    /// @return the number of classes the packet was added to.
+    size_t classify(Pkt6& pkt) const;
+
+private:
+    /// @brief The operations of the program.
+    enum OpCode {
+        OP_FIELD,       ///< Pushes field a.
+        OP_CONSTANT,    ///< Pushes constant a.
+        OP_MEMBER,      ///< Pushes whether the packet is in class a.
+        OP_SUBSTRING,   ///< Keeps b bytes from byte a of the top value.
+        OP_EQUAL,       ///< Replaces the two top values by their equality.
+        OP_NOT,         ///< Negates the top value.
+        OP_JUMP_FALSE,  ///< Jumps to b if the top value is false, else pops.
+        OP_JUMP_TRUE,   ///< Jumps to b if the top value is true, else pops.
+        OP_CLASS        ///< Pops, adding the packet to class a if true.
+    };
+
+    /// @brief An instruction of the program.
+    struct Instruction {
+        Instruction(OpCode op, uint32_t a, uint32_t b = 0) :
+            op_(op), a_(a), b_(b)
+        {}
+
+        OpCode op_;
+        uint32_t a_;
+        uint32_t b_;
+    };
+
+    /// @brief The kinds of fields of the packet.
+    enum FieldKind {
+        FIELD_OPTION,
+        FIELD_RELAY,
+        FIELD_HWADDR
+    };
+
+    /// @brief A field of the packet: its kind and option code.
+    typedef std::pair<FieldKind, uint16_t> Field;
+
+    class Compiler;
+
+    /// @brief Runs the program on a packet.
+    template <typename PacketType>
+    size_t run(PacketType& pkt) const;
+
+    const Option::Universe universe_;
+
+    /// @brief The names of the classes.
+    std::vector<ClientClass> names_;
+
+    /// @brief The indexes of the classes by name.
+    std::map<ClientClass, uint32_t> indexes_;
+
+    /// @brief The fields read by the program.
+    std::vector<Field> fields_;
+
+    /// @brief The constants of the program.
+    std::vector<OptionBuffer> constants_;
+
+    /// @brief The instructions, the tests of the classes one after the
+    /// other.
+    std::vector<Instruction> program_;
+};
+
+/// @brief Pointer to a client classifier.
+typedef boost::shared_ptr<ClientClassifier> ClientClassifierPtr;
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // CLIENT_CLASSIFIER_H
@@ -274,6 +274,7 @@ D2ClientMgr::sendRequest(dhcp_ddns::NameChangeRequestPtr& ncr) {
     }
 
     try {
+        bundy::util::thread::Mutex::Locker locker(sender_mutex_);
         name_change_sender_->sendRequest(ncr);
     } catch (const std::exception& ex) {
         LOG_ERROR(dhcpsrv_logger, DHCPSRV_DHCP_DDNS_NCR_REJECTED)
@@ -367,6 +368,7 @@ D2ClientMgr::runReadyIO() {
                   " name_change_sender is null");
     }
 
+    bundy::util::thread::Mutex::Locker locker(sender_mutex_);
     name_change_sender_->runReadyIO();
 }
 
@@ -23,6 +23,7 @@
 #include <dhcp_ddns/ncr_io.h>
 #include <dhcpsrv/d2_client_cfg.h>
 #include <exceptions/exceptions.h>
+#include <util/threads/sync.h>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
@@ -425,6 +426,10 @@ private:
 
     /// @brief Remembers the select-fd registered with IfaceMgr.
     int registered_select_fd_;
+
+    /// @brief Serializes the use of the sender by sendRequest() and
+    /// runReadyIO(), which may be called from different threads.
+    bundy::util::thread::Mutex sender_mutex_;
 };
 
 template <class T>
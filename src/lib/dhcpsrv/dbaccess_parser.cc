@@ -18,6 +18,7 @@
 #include <dhcpsrv/lease_mgr_factory.h>
 
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <map>
 #include <string>
@@ -36,6 +37,21 @@ DbAccessParser::DbAccessParser(const std::string&, const ParserContext& ctx)
 {
 }
 
+// Checks if a parameter has a boolean value
+bool
+DbAccessParser::isBooleanParameter(const std::string& name) {
+    return ((name == "persist") || (name == "fsync") ||
+            (name == "write-behind"));
+}
+
+// Checks if a parameter has an integer value
+bool
+DbAccessParser::isIntegerParameter(const std::string& name) {
+    return ((name == "cache-size") || (name == "replication-node") ||
+            (name == "compact-interval") || (name == "write-behind-queue") ||
+            (name == "write-behind-batch") || (name == "write-behind-delay"));
+}
+
 // Parse the configuration and check that the various keywords are consistent.
 void
 DbAccessParser::build(bundy::data::ConstElementPtr config_value) {
@@ -57,14 +73,23 @@ DbAccessParser::build(bundy::data::ConstElementPtr config_value) {
 
     // 3. Update the copy with the passed keywords.
     BOOST_FOREACH(ConfigPair param, config_value->mapValue()) {
-        // The persist parameter is the only boolean parameter at the
-        // moment. It needs special handling.
-        if (param.first != "persist") {
-            values_copy[param.first] = param.second->stringValue();
-
-        } else {
+        // The boolean and integer parameters need special handling.
+        if (isBooleanParameter(param.first)) {
             values_copy[param.first] = (param.second->boolValue() ?
                                         "true" : "false");
+
+        } else if (isIntegerParameter(param.first)) {
+            const int64_t value = param.second->intValue();
+            // Only the node of the replication may be negative (-1 when
+            // there is no peer).
+            if ((value < 0) && (param.first != "replication-node")) {
+                bundy_throw(BadValue, "invalid value '" << param.first
+                            << "=" << value << "'");
+            }
+            values_copy[param.first] = boost::lexical_cast<string>(value);
+
+        } else {
+            values_copy[param.first] = param.second->stringValue();
         }
     }
 
@@ -78,7 +78,8 @@ public:
     ///        identifier.
     ///
     /// @throw bundy::BadValue The 'type' keyword contains an unknown database
-    ///        type.
+    ///        type, or an integer parameter (other than 'replication-node')
+    ///        is negative.
     /// @throw bundy::dhcp::MissingTypeKeyword The 'type' keyword is missing from
     ///        the list of database access keywords.
     virtual void build(bundy::data::ConstElementPtr config_value);
@@ -128,6 +129,19 @@ protected:
     std::string getDbAccessString() const;
 
 private:
+    /// @brief Checks if a parameter has a boolean value
+    ///
+    /// @param name Name of the parameter.
+    ///
+    /// @return true if the value of the parameter is a boolean.
+    static bool isBooleanParameter(const std::string& name);
+
+    /// @brief Checks if a parameter has an integer value
+    ///
+    /// @param name Name of the parameter.
+    ///
+    /// @return true if the value of the parameter is an integer.
+    static bool isIntegerParameter(const std::string& name);
 
     std::map<std::string, std::string> values_; ///< Stored parameter values
 
@@ -312,6 +312,50 @@ HooksLibrariesParser::getLibraries(std::vector<std::string>& libraries,
     changed = changed_;
 }
 
+// ************************ ClientClassesParser ***************************
+
+ClientClassesParser::ClientClassesParser(const std::string& param_name,
+                                         ParserContextPtr global_context)
+    : classifier_(), global_context_(global_context)
+{
+    // Sanity check on the name.
+    if (param_name != "client-classes") {
+        bundy_throw(BadValue, "Internal error. Client classes "
+            "parser called for the wrong parameter: " << param_name);
+    }
+}
+
+void
+ClientClassesParser::build(ConstElementPtr value) {
+    classifier_.reset(new ClientClassifier(global_context_->universe_));
+
+    BOOST_FOREACH(ConstElementPtr class_def, value->listValue()) {
+        ConstElementPtr name = class_def->get("name");
+        if (!name || name->stringValue().empty()) {
+            bundy_throw(DhcpConfigError, "client class without a name");
+        }
+        ConstElementPtr test = class_def->get("test");
+        if (!test) {
+            bundy_throw(DhcpConfigError, "client class "
+                        << name->stringValue() << " has no test");
+        }
+        try {
+            classifier_->addClass(name->stringValue(), test->stringValue());
+        } catch (const ClassExpressionError& ex) {
+            bundy_throw(DhcpConfigError, "invalid test of the client class "
+                        << name->stringValue() << ": " << ex.what());
+        }
+    }
+}
+
+void
+ClientClassesParser::commit() {
+    if (classifier_ && (classifier_->getClassCount() == 0)) {
+        classifier_.reset();
+    }
+    CfgMgr::instance().setClientClassifier(classifier_);
+}
+
 // **************************** OptionDataParser *************************
 OptionDataParser::OptionDataParser(const std::string&, OptionStoragePtr options,
                                   ParserContextPtr global_context)
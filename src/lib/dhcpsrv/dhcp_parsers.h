@@ -18,6 +18,7 @@
 #include <asiolink/io_address.h>
 #include <cc/data.h>
 #include <dhcp/option_definition.h>
+#include <dhcpsrv/client_classifier.h>
 #include <dhcpsrv/d2_client_cfg.h>
 #include <dhcpsrv/dhcp_config_parser.h>
 #include <dhcpsrv/option_space_container.h>
@@ -445,6 +446,50 @@ private:
     bool changed_;
 };
 
+/// @brief Parser for the list of client classes.
+///
+/// Each class of the list is a map holding its "name" and its "test", an
+/// expression of the packets (see @c ClientClassifier).  The tests are
+/// compiled in the order of the list, into a classifier which is set in
+/// the configuration manager on commit.
+class ClientClassesParser : public DhcpConfigParser {
+public:
+    /// @brief Constructor
+    ///
+    /// @param param_name name of the configuration parameter being parsed.
+    /// @param global_context the context holding the universe of the
+    /// server.
+    ///
+    /// @throw BadValue if supplied parameter name is not "client-classes"
+    ClientClassesParser(const std::string& param_name,
+                        ParserContextPtr global_context);
+
+    /// @brief Compiles the classes of the list.
+    ///
+    /// @param value the list of the classes.
+    ///
+    /// @throw DhcpConfigError if a class has no name or if its test is not
+    /// valid.
+    virtual void build(bundy::data::ConstElementPtr value);
+
+    /// @brief Sets the classifier in the configuration manager.
+    ///
+    /// No classifier is set if the list is empty.
+    virtual void commit();
+
+    /// @brief Returns the classifier built (for testing).
+    const ClientClassifierPtr& getClassifier() const {
+        return (classifier_);
+    }
+
+private:
+    /// The classifier the classes are compiled into.
+    ClientClassifierPtr classifier_;
+
+    /// The global context.
+    ParserContextPtr global_context_;
+};
+
 /// @brief Parser for option data value.
 ///
 /// This parser parses configuration entries that specify value of
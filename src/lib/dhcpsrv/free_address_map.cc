@@ -0,0 +1,157 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/free_address_map.h>
+#include <exceptions/exceptions.h>
+
+using namespace bundy::asiolink;
+using bundy::util::thread::Mutex;
+
+namespace {
+
+/// @brief Returns the position of the lowest set bit of a non-zero word.
+unsigned int
+lowestBit(uint64_t word) {
+    unsigned int bit = 0;
+    while ((word & 0xff) == 0) {
+        word >>= 8;
+        bit += 8;
+    }
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++bit;
+    }
+    return (bit);
+}
+
+/// @brief Returns the number of addresses in the range.
+///
+/// @throw BadValue if the range is not valid for the map.
+uint32_t
+rangeSize(const IOAddress& first, const IOAddress& last) {
+    if (!first.isV4() || !last.isV4()) {
+        bundy_throw(bundy::BadValue, "free address map range " << first
+                    << "-" << last << " is not IPv4");
+    }
+    const uint32_t first4 = static_cast<uint32_t>(first);
+    const uint32_t last4 = static_cast<uint32_t>(last);
+    if (last4 < first4) {
+        bundy_throw(bundy::BadValue, "free address map range " << first
+                    << "-" << last << " is empty");
+    }
+    if (last4 - first4 >= bundy::dhcp::FreeAddressMap::MAX_SIZE) {
+        bundy_throw(bundy::BadValue, "free address map range " << first
+                    << "-" << last << " is too large");
+    }
+    return (last4 - first4 + 1);
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+const uint32_t FreeAddressMap::MAX_SIZE;
+
+FreeAddressMap::FreeAddressMap(const IOAddress& first, const IOAddress& last) :
+    first_(static_cast<uint32_t>(first)), size_(rangeSize(first, last)),
+    words_((size_ + 63) / 64, ~static_cast<uint64_t>(0)), free_count_(size_)
+{
+    if (size_ % 64 != 0) {
+        words_.back() = (static_cast<uint64_t>(1) << (size_ % 64)) - 1;
+    }
+}
+
+void
+FreeAddressMap::markUsed(const IOAddress& addr) {
+    setFree(addr, false);
+}
+
+void
+FreeAddressMap::markFree(const IOAddress& addr) {
+    setFree(addr, true);
+}
+
+bool
+FreeAddressMap::isFree(const IOAddress& addr) const {
+    if (!addr.isV4()) {
+        return (false);
+    }
+    const uint32_t offset = static_cast<uint32_t>(addr) - first_;
+    if (offset >= size_) {
+        return (false);
+    }
+    Mutex::Locker locker(mutex_);
+    return ((words_[offset / 64] >> (offset % 64)) & 1);
+}
+
+uint32_t
+FreeAddressMap::getFreeCount() const {
+    Mutex::Locker locker(mutex_);
+    return (free_count_);
+}
+
+bool
+FreeAddressMap::findFree(const IOAddress& from, IOAddress& addr) const {
+    uint32_t offset = 0;
+    if (from.isV4() && static_cast<uint32_t>(from) > first_) {
+        offset = static_cast<uint32_t>(from) - first_;
+        if (offset >= size_) {
+            return (false);
+        }
+    }
+
+    Mutex::Locker locker(mutex_);
+    if (free_count_ == 0) {
+        return (false);
+    }
+    size_t index = offset / 64;
+    // Ignore the addresses before the start in the first word.
+    uint64_t word = words_[index] & (~static_cast<uint64_t>(0) <<
+                                     (offset % 64));
+    while (word == 0) {
+        if (++index == words_.size()) {
+            return (false);
+        }
+        word = words_[index];
+    }
+    addr = IOAddress(first_ + static_cast<uint32_t>(index * 64) +
+                     lowestBit(word));
+    return (true);
+}
+
+void
+FreeAddressMap::setFree(const IOAddress& addr, bool free) {
+    if (!addr.isV4()) {
+        return;
+    }
+    const uint32_t offset = static_cast<uint32_t>(addr) - first_;
+    if (offset >= size_) {
+        return;
+    }
+    const uint64_t mask = static_cast<uint64_t>(1) << (offset % 64);
+    Mutex::Locker locker(mutex_);
+    uint64_t& word = words_[offset / 64];
+    if (((word & mask) != 0) != free) {
+        word ^= mask;
+        if (free) {
+            ++free_count_;
+        } else {
+            --free_count_;
+        }
+    }
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
@@ -0,0 +1,126 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef FREE_ADDRESS_MAP_H
+#define FREE_ADDRESS_MAP_H
+
+#include <asiolink/io_address.h>
+#include <util/threads/sync.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Map of the free addresses of an IPv4 range
+///
+/// The map holds one bit per address of the range, which is set when the
+/// address is free, i.e. there is no lease for it. It allows the allocation
+/// engine to find a free address without querying the lease database for
+/// each of the leased addresses on the way: the bits are scanned 64 at a
+/// time, and the count of free addresses tells at once that there is none.
+///
+/// The map is only a hint. It may be out of date if the lease database is
+/// modified by someone else, so an address it reports free must still be
+/// checked in the database before allocating it.
+///
+/// All the methods may be called from multiple threads.
+class FreeAddressMap : public boost::noncopyable {
+public:
+    /// @brief The maximum number of addresses in the map (2MB of bits).
+    static const uint32_t MAX_SIZE = 1 << 24;
+
+    /// @brief Constructor.
+    ///
+    /// All the addresses of the range are free initially.
+    ///
+    /// @param first first address of the range.
+    /// @param last last address of the range.
+    ///
+    /// @throw BadValue if the addresses are not IPv4, the last address is
+    /// lower than the first one or the range has more than @c MAX_SIZE
+    /// addresses.
+    FreeAddressMap(const bundy::asiolink::IOAddress& first,
+                   const bundy::asiolink::IOAddress& last);
+
+    /// @brief Marks an address as used.
+    ///
+    /// Addresses outside of the range are ignored.
+    ///
+    /// @param addr the address.
+    void markUsed(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Marks an address as free.
+    ///
+    /// Addresses outside of the range are ignored.
+    ///
+    /// @param addr the address.
+    void markFree(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Checks if an address is free.
+    ///
+    /// @param addr the address.
+    ///
+    /// @return true if the address is in the range and free.
+    bool isFree(const bundy::asiolink::IOAddress& addr) const;
+
+    /// @brief Returns the number of free addresses.
+    uint32_t getFreeCount() const;
+
+    /// @brief Finds a free address.
+    ///
+    /// The range is searched from the given address up to its end, the
+    /// addresses before it are not considered.
+    ///
+    /// @param from the address to start the search from, if it is before
+    /// the range, the whole range is searched.
+    /// @param [out] addr the free address found.
+    ///
+    /// @return true if a free address was found.
+    bool findFree(const bundy::asiolink::IOAddress& from,
+                  bundy::asiolink::IOAddress& addr) const;
+
+private:
+    /// @brief Sets the bit of an address to the given state.
+    void setFree(const bundy::asiolink::IOAddress& addr, bool free);
+
+    /// @brief The first address of the range.
+    const uint32_t first_;
+
+    /// @brief The number of addresses in the range.
+    const uint32_t size_;
+
+    /// @brief The bits, the lowest bit of the first word stands for the
+    /// first address.  The bits beyond the end of the range are not set.
+    std::vector<uint64_t> words_;
+
+    /// @brief The number of set bits.
+    uint32_t free_count_;
+
+    /// @brief Protects the bits.
+    mutable bundy::util::thread::Mutex mutex_;
+};
+
+/// @brief A pointer to a @c FreeAddressMap.
+typedef boost::shared_ptr<FreeAddressMap> FreeAddressMapPtr;
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // FREE_ADDRESS_MAP_H
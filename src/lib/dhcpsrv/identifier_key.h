@@ -0,0 +1,97 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef IDENTIFIER_KEY_H
+#define IDENTIFIER_KEY_H
+
+#include <cstring>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief A client identifier used as a key of a hashed index.
+///
+/// The identifier is a hardware address, a client identifier or a DUID.
+/// The key doesn't own the identifier: it only points to the bytes held by
+/// a lease, or by the identifier searched for, so creating it doesn't
+/// allocate memory.  Its hash is computed once, when it is created.
+///
+/// The key must not outlive the identifier it points to.  This holds for
+/// the keys extracted from the leases by a multi_index_container (they are
+/// used only while the lease is in the container) and for the keys
+/// created to search the container.
+class IdentifierKey {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param data the bytes of the identifier.
+    /// @param len the length of the identifier.
+    IdentifierKey(const uint8_t* data, size_t len) :
+        data_(data), len_(len), hash_(computeHash(data, len))
+    {}
+
+    /// @brief Constructor from an identifier held in a vector.
+    ///
+    /// @param id the identifier.  The vector must not be changed while
+    /// the key is used.
+    explicit IdentifierKey(const std::vector<uint8_t>& id) :
+        data_(id.empty() ? NULL : &id[0]), len_(id.size()),
+        hash_(computeHash(data_, len_))
+    {}
+
+    /// @brief Returns the hash of the identifier.
+    size_t getHash() const {
+        return (hash_);
+    }
+
+    /// @brief Compares two identifiers.
+    bool operator==(const IdentifierKey& other) const {
+        return (hash_ == other.hash_ && len_ == other.len_ &&
+                (len_ == 0 || std::memcmp(data_, other.data_, len_) == 0));
+    }
+
+    /// @brief Compares two identifiers.
+    bool operator!=(const IdentifierKey& other) const {
+        return (!(*this == other));
+    }
+
+private:
+    /// @brief Computes the hash (32-bit FNV-1a) of an identifier.
+    static size_t computeHash(const uint8_t* data, size_t len) {
+        uint32_t hash = 2166136261U;
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ data[i]) * 16777619U;
+        }
+        return (hash);
+    }
+
+    const uint8_t* data_;
+    size_t len_;
+    size_t hash_;
+};
+
+/// @brief Returns the hash of an identifier key (used by boost::hash).
+inline size_t
+hash_value(const IdentifierKey& key) {
+    return (key.getHash());
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // IDENTIFIER_KEY_H
@@ -50,10 +50,7 @@ Lease::typeToText(Lease::Type type) {
 }
 
 bool Lease::expired() const {
-
-    // Let's use int64 to avoid problems with negative/large uint32 values
-    int64_t expire_time = cltt_ + valid_lft_;
-    return (expire_time < time(NULL));
+    return (getExpirationTime() < time(NULL));
 }
 
 bool
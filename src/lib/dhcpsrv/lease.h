@@ -141,6 +141,16 @@ struct Lease {
     /// @return true if the lease is expired
     bool expired() const;
 
+    /// @brief Returns the time the lease expires at
+    ///
+    /// The lease is expired once this time has passed.
+    ///
+    /// @return expiration time in seconds since the epoch
+    int64_t getExpirationTime() const {
+        // Let's use int64 to avoid problems with negative/large uint32 values
+        return (static_cast<int64_t>(cltt_) + valid_lft_);
+    }
+
     /// @brief Returns true if the other lease has equal FQDN data.
     ///
     /// @param other Lease which FQDN data is to be compared with our lease.
@@ -0,0 +1,674 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcp/duid.h>
+#include <dhcpsrv/dhcpsrv_log.h>
+#include <dhcpsrv/lease_journal.h>
+#include <dhcpsrv/lease_mgr.h>
+#include <exceptions/exceptions.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace bundy::asiolink;
+using namespace bundy::util;
+using bundy::util::thread::Mutex;
+
+namespace {
+
+// The files start with a magic string of 4 bytes and a version.
+const char* const JOURNAL_MAGIC = "BDLJ";
+const char* const SNAPSHOT_MAGIC = "BDLS";
+const uint32_t FORMAT_VERSION = 1;
+const size_t HEADER_LEN = 8;
+
+// The kinds of lease records.
+const uint8_t RECORD_LEASE4 = 4;
+const uint8_t RECORD_LEASE6 = 6;
+
+// The bits of the flags of a record.
+const uint8_t FLAG_FQDN_FWD = 1;
+const uint8_t FLAG_FQDN_REV = 2;
+
+// The length and checksum around the lease data.
+const size_t RECORD_OVERHEAD = 8;
+
+// The maximum length of the lease data.
+const uint32_t MAX_RECORD_LEN = 65536;
+
+// 32-bit FNV-1a hash, the checksum of the records.
+uint32_t
+checksum(const uint8_t* data, size_t len) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return (hash);
+}
+
+// Writes the header of a file.
+void
+writeHeader(OutputBuffer& buffer, const char* magic) {
+    buffer.writeData(magic, 4);
+    buffer.writeUint32(FORMAT_VERSION);
+}
+
+// Appends the data of a lease with its length and checksum to the buffer.
+void
+writeRecord(const OutputBuffer& data, OutputBuffer& buffer) {
+    buffer.writeUint32(data.getLength());
+    buffer.writeData(data.getData(), data.getLength());
+    buffer.writeUint32(checksum(static_cast<const uint8_t*>(data.getData()),
+                                data.getLength()));
+}
+
+// Writes the fields common to the IPv4 and IPv6 leases.
+void
+writeCommon(const bundy::dhcp::Lease& lease, OutputBuffer& data) {
+    data.writeUint32(lease.valid_lft_);
+    const uint64_t cltt = static_cast<uint64_t>(lease.cltt_);
+    data.writeUint32(cltt >> 32);
+    data.writeUint32(cltt & 0xffffffff);
+    data.writeUint32(lease.subnet_id_);
+    data.writeUint8((lease.fqdn_fwd_ ? FLAG_FQDN_FWD : 0) |
+                    (lease.fqdn_rev_ ? FLAG_FQDN_REV : 0));
+    if (lease.hostname_.size() > 0xffff) {
+        bundy_throw(bundy::BadValue, "hostname of lease " << lease.addr_
+                    << " is too long");
+    }
+    data.writeUint16(lease.hostname_.size());
+    data.writeData(lease.hostname_.data(), lease.hostname_.size());
+}
+
+// Reads the fields common to the IPv4 and IPv6 leases.
+void
+readCommon(InputBuffer& data, bundy::dhcp::Lease& lease) {
+    lease.valid_lft_ = data.readUint32();
+    uint64_t cltt = data.readUint32();
+    cltt = (cltt << 32) | data.readUint32();
+    lease.cltt_ = static_cast<time_t>(cltt);
+    lease.subnet_id_ = data.readUint32();
+    const uint8_t flags = data.readUint8();
+    lease.fqdn_fwd_ = (flags & FLAG_FQDN_FWD) != 0;
+    lease.fqdn_rev_ = (flags & FLAG_FQDN_REV) != 0;
+    std::vector<uint8_t> hostname;
+    data.readVector(hostname, data.readUint16());
+    lease.hostname_.assign(hostname.begin(), hostname.end());
+}
+
+// Reads a vector preceded by its length (8 bits).
+void
+readShortVector(InputBuffer& data, std::vector<uint8_t>& vec) {
+    data.readVector(vec, data.readUint8());
+}
+
+// Writes a vector preceded by its length (8 bits).
+void
+writeShortVector(const std::vector<uint8_t>& vec, const char* name,
+                 OutputBuffer& data) {
+    if (vec.size() > 0xff) {
+        bundy_throw(bundy::BadValue, name << " of a lease is too long");
+    }
+    data.writeUint8(vec.size());
+    if (!vec.empty()) {
+        data.writeData(&vec[0], vec.size());
+    }
+}
+
+// Decodes the data of an IPv4 lease.
+bundy::dhcp::Lease4Ptr
+readLease4(InputBuffer& data) {
+    bundy::dhcp::Lease4Ptr lease(new bundy::dhcp::Lease4());
+    lease->addr_ = IOAddress(data.readUint32());
+    readShortVector(data, lease->hwaddr_);
+    std::vector<uint8_t> client_id;
+    readShortVector(data, client_id);
+    if (!client_id.empty()) {
+        lease->client_id_.reset(new bundy::dhcp::ClientId(client_id));
+    }
+    readCommon(data, *lease);
+    return (lease);
+}
+
+// Decodes the data of an IPv6 lease.
+bundy::dhcp::Lease6Ptr
+readLease6(InputBuffer& data) {
+    uint8_t addr[16];
+    data.readData(addr, sizeof(addr));
+    const bundy::dhcp::Lease::Type type =
+        static_cast<bundy::dhcp::Lease::Type>(data.readUint8());
+    const uint8_t prefixlen = data.readUint8();
+    const uint32_t iaid = data.readUint32();
+    std::vector<uint8_t> duid;
+    readShortVector(data, duid);
+    const uint32_t preferred = data.readUint32();
+    const bundy::dhcp::DuidPtr client_duid(new bundy::dhcp::DUID(duid));
+    bundy::dhcp::Lease6Ptr lease(
+        new bundy::dhcp::Lease6(type, IOAddress::fromBytes(AF_INET6, addr),
+                                client_duid, iaid, preferred, 0, 0, 0, 0,
+                                prefixlen));
+    readCommon(data, *lease);
+    return (lease);
+}
+
+// Returns the message of the last system error.
+std::string
+systemError() {
+    return (std::strerror(errno));
+}
+
+// Closes a file descriptor when going out of scope.
+class FileCloser {
+public:
+    FileCloser(int fd) : fd_(fd) {}
+    ~FileCloser() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+private:
+    const int fd_;
+};
+
+// Unmaps a file when going out of scope.
+class FileUnmapper {
+public:
+    FileUnmapper(void* addr, size_t len) : addr_(addr), len_(len) {}
+    ~FileUnmapper() {
+        munmap(addr_, len_);
+    }
+private:
+    void* const addr_;
+    const size_t len_;
+};
+
+// Writes all the data to a file descriptor, returns false on error.
+bool
+writeAll(int fd, const void* data, size_t len) {
+    const uint8_t* pos = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        const ssize_t written = ::write(fd, pos, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (false);
+        }
+        pos += written;
+        len -= written;
+    }
+    return (true);
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+LeaseJournal::LeaseJournal(const std::string& filename, bool fsync) :
+    filename_(filename), fsync_(fsync), fd_(-1), appended_(0), synced_(0),
+    failed_from_(0), failed_to_(0), writing_(false), length_(0)
+{
+}
+
+LeaseJournal::~LeaseJournal() {
+    try {
+        close();
+    } catch (...) {
+        // The records which couldn't be written are lost.
+    }
+}
+
+std::string
+LeaseJournal::getSnapshotFilename() const {
+    return (filename_ + ".snapshot");
+}
+
+std::string
+LeaseJournal::getCompactingFilename() const {
+    return (filename_ + ".compacting");
+}
+
+void
+LeaseJournal::load(const Lease4Handler& handler4,
+                   const Lease6Handler& handler6) {
+    replay(getSnapshotFilename(), SNAPSHOT_MAGIC, false, handler4, handler6);
+    replay(getCompactingFilename(), JOURNAL_MAGIC, true, handler4, handler6);
+    replay(filename_, JOURNAL_MAGIC, true, handler4, handler6);
+}
+
+void
+LeaseJournal::replay(const std::string& path, const char* magic,
+                     bool truncate, const Lease4Handler& handler4,
+                     const Lease6Handler& handler6) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        bundy_throw(DbOperationError, "unable to open lease file " << path
+                    << ": " << systemError());
+    }
+    FileCloser closer(fd);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        bundy_throw(DbOperationError, "unable to get the size of lease file "
+                    << path << ": " << systemError());
+    }
+    const size_t size = st.st_size;
+    if (size == 0) {
+        return;
+    }
+    void* const map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        bundy_throw(DbOperationError, "unable to map lease file " << path
+                    << ": " << systemError());
+    }
+    FileUnmapper unmapper(map, size);
+    const uint8_t* const data = static_cast<const uint8_t*>(map);
+
+    if (size < HEADER_LEN || std::memcmp(data, magic, 4) != 0) {
+        bundy_throw(DbOperationError, path << " is not a lease "
+                    << (truncate ? "journal" : "snapshot"));
+    }
+    InputBuffer header(data + 4, 4);
+    if (header.readUint32() != FORMAT_VERSION) {
+        bundy_throw(DbOperationError, "unsupported version of lease file "
+                    << path);
+    }
+
+    size_t offset = HEADER_LEN;
+    while (offset < size) {
+        size_t len = 0;
+        try {
+            len = decode(data + offset, size - offset, handler4, handler6);
+        } catch (const DbOperationError&) {
+            throw;
+        } catch (const std::exception& ex) {
+            bundy_throw(DbOperationError, "failed to load the lease at "
+                        "offset " << offset << " of " << path << ": "
+                        << ex.what());
+        }
+
+        // The record may have been torn by a crash while it was being
+        // written.
+        if (len == 0) {
+            if (!truncate) {
+                bundy_throw(DbOperationError, "invalid lease record at "
+                            "offset " << offset << " of " << path);
+            }
+            LOG_WARN(dhcpsrv_logger, DHCPSRV_MEMFILE_JOURNAL_TRUNCATED)
+                .arg(path).arg(offset);
+            if (::truncate(path.c_str(), offset) != 0) {
+                bundy_throw(DbOperationError, "unable to truncate lease "
+                            "journal " << path << ": " << systemError());
+            }
+            break;
+        }
+        offset += len;
+    }
+}
+
+size_t
+LeaseJournal::decode(const uint8_t* data, size_t len,
+                     const Lease4Handler& handler4,
+                     const Lease6Handler& handler6) {
+    // Check that the record is complete and not corrupted.
+    if (len < RECORD_OVERHEAD) {
+        return (0);
+    }
+    const uint32_t data_len = InputBuffer(data, 4).readUint32();
+    if (data_len > MAX_RECORD_LEN || len - RECORD_OVERHEAD < data_len) {
+        return (0);
+    }
+    const uint8_t* const record = data + 4;
+    if (InputBuffer(record + data_len, 4).readUint32() !=
+        checksum(record, data_len)) {
+        return (0);
+    }
+
+    InputBuffer buffer(record, data_len);
+    const uint8_t kind = buffer.readUint8();
+    if (kind == RECORD_LEASE4 && handler4) {
+        Lease4Ptr lease = readLease4(buffer);
+        handler4(lease);
+    } else if (kind == RECORD_LEASE6 && handler6) {
+        Lease6Ptr lease = readLease6(buffer);
+        handler6(lease);
+    } else {
+        bundy_throw(BadValue, "unexpected lease record kind "
+                    << static_cast<int>(kind));
+    }
+    return (data_len + RECORD_OVERHEAD);
+}
+
+void
+LeaseJournal::open() {
+    Mutex::Locker locker(mutex_);
+    if (fd_ >= 0) {
+        return;
+    }
+    const int fd = ::open(filename_.c_str(), O_WRONLY | O_APPEND | O_CREAT,
+                          0644);
+    if (fd < 0) {
+        bundy_throw(DbOperationError, "unable to open lease journal "
+                    << filename_ << ": " << systemError());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const std::string error = systemError();
+        ::close(fd);
+        bundy_throw(DbOperationError, "unable to get the size of lease "
+                    "journal " << filename_ << ": " << error);
+    }
+    if (st.st_size == 0) {
+        OutputBuffer header(HEADER_LEN);
+        writeHeader(header, JOURNAL_MAGIC);
+        if (!writeAll(fd, header.getData(), header.getLength())) {
+            const std::string error = systemError();
+            ::close(fd);
+            bundy_throw(DbOperationError, "unable to write lease journal "
+                        << filename_ << ": " << error);
+        }
+    }
+    // A journal which is not empty has been checked by load().
+    fd_ = fd;
+    length_ = st.st_size > 0 ? st.st_size - HEADER_LEN : 0;
+}
+
+void
+LeaseJournal::close() {
+    Mutex::Locker locker(mutex_);
+    while (writing_) {
+        written_.wait(mutex_);
+    }
+    if (fd_ < 0) {
+        return;
+    }
+    flush();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+uint64_t
+LeaseJournal::append(const Lease4& lease) {
+    OutputBuffer record(64 + lease.hostname_.size());
+    encode(lease, record);
+    return (queue(record));
+}
+
+uint64_t
+LeaseJournal::append(const Lease6& lease) {
+    OutputBuffer record(96 + lease.hostname_.size());
+    encode(lease, record);
+    return (queue(record));
+}
+
+uint64_t
+LeaseJournal::queue(const OutputBuffer& record) {
+    const uint8_t* data = static_cast<const uint8_t*>(record.getData());
+    Mutex::Locker locker(mutex_);
+    if (fd_ < 0) {
+        bundy_throw(DbOperationError, "lease journal " << filename_
+                    << " is not open");
+    }
+    pending_.insert(pending_.end(), data, data + record.getLength());
+    length_ += record.getLength();
+    return (++appended_);
+}
+
+void
+LeaseJournal::sync(uint64_t sequence) {
+    for (;;) {
+        std::vector<uint8_t> batch;
+        uint64_t last;
+        {
+            Mutex::Locker locker(mutex_);
+            while (writing_ && synced_ < sequence) {
+                written_.wait(mutex_);
+            }
+            if (synced_ >= sequence) {
+                if (sequence > failed_from_ && sequence <= failed_to_) {
+                    bundy_throw(DbOperationError, "unable to write lease "
+                                "journal " << filename_ << ": " << error_);
+                }
+                return;
+            }
+            // Write all the queued records for the threads waiting.
+            writing_ = true;
+            batch.swap(pending_);
+            last = appended_;
+        }
+
+        const std::string error = write(batch);
+
+        Mutex::Locker locker(mutex_);
+        if (!error.empty()) {
+            failed_from_ = synced_;
+            failed_to_ = last;
+            error_ = error;
+        }
+        synced_ = last;
+        writing_ = false;
+        written_.broadcast();
+    }
+}
+
+std::string
+LeaseJournal::write(const std::vector<uint8_t>& data) {
+    if (!data.empty() && !writeAll(fd_, &data[0], data.size())) {
+        return (systemError());
+    }
+    if (fsync_ && fdatasync(fd_) != 0) {
+        return (systemError());
+    }
+    return ("");
+}
+
+void
+LeaseJournal::flush() {
+    std::vector<uint8_t> batch;
+    batch.swap(pending_);
+    const std::string error = write(batch);
+    if (!error.empty()) {
+        failed_from_ = synced_;
+        failed_to_ = appended_;
+        error_ = error;
+    }
+    synced_ = appended_;
+    written_.broadcast();
+    if (!error.empty()) {
+        bundy_throw(DbOperationError, "unable to write lease journal "
+                    << filename_ << ": " << error);
+    }
+}
+
+uint64_t
+LeaseJournal::getLength() const {
+    Mutex::Locker locker(mutex_);
+    return (length_);
+}
+
+bool
+LeaseJournal::compactionPending() const {
+    return (access(getCompactingFilename().c_str(), F_OK) == 0);
+}
+
+void
+LeaseJournal::rotate() {
+    Mutex::Locker locker(mutex_);
+    while (writing_) {
+        written_.wait(mutex_);
+    }
+    if (fd_ < 0) {
+        bundy_throw(DbOperationError, "lease journal " << filename_
+                    << " is not open");
+    }
+    flush();
+
+    const std::string compacting = getCompactingFilename();
+    if (!compactionPending()) {
+        if (rename(filename_.c_str(), compacting.c_str()) != 0) {
+            bundy_throw(DbOperationError, "unable to rename lease journal "
+                        << filename_ << ": " << systemError());
+        }
+        ::close(fd_);
+        fd_ = -1;
+    } else {
+        // The previous compaction didn't finish, so the records of the
+        // journal are appended to the journal it was compacting.
+        const int in = ::open(filename_.c_str(), O_RDONLY);
+        if (in < 0) {
+            bundy_throw(DbOperationError, "unable to open lease journal "
+                        << filename_ << ": " << systemError());
+        }
+        FileCloser in_closer(in);
+        const int out = ::open(compacting.c_str(), O_WRONLY | O_APPEND);
+        if (out < 0) {
+            bundy_throw(DbOperationError, "unable to open lease journal "
+                        << compacting << ": " << systemError());
+        }
+        FileCloser out_closer(out);
+        if (lseek(in, HEADER_LEN, SEEK_SET) < 0) {
+            bundy_throw(DbOperationError, "unable to read lease journal "
+                        << filename_ << ": " << systemError());
+        }
+        std::vector<uint8_t> buffer(65536);
+        for (;;) {
+            const ssize_t len = read(in, &buffer[0], buffer.size());
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            if (len < 0) {
+                bundy_throw(DbOperationError, "unable to read lease journal "
+                            << filename_ << ": " << systemError());
+            }
+            if (len == 0) {
+                break;
+            }
+            if (!writeAll(out, &buffer[0], len)) {
+                bundy_throw(DbOperationError, "unable to write lease "
+                            "journal " << compacting << ": "
+                            << systemError());
+            }
+        }
+        if (fsync(out) != 0) {
+            bundy_throw(DbOperationError, "unable to write lease journal "
+                        << compacting << ": " << systemError());
+        }
+        if (ftruncate(fd_, 0) != 0) {
+            bundy_throw(DbOperationError, "unable to truncate lease journal "
+                        << filename_ << ": " << systemError());
+        }
+        ::close(fd_);
+        fd_ = -1;
+        if (unlink(filename_.c_str()) != 0) {
+            bundy_throw(DbOperationError, "unable to remove lease journal "
+                        << filename_ << ": " << systemError());
+        }
+    }
+
+    // Start a new journal, it's open() without the lock.
+    const int fd = ::open(filename_.c_str(), O_WRONLY | O_APPEND | O_CREAT,
+                          0644);
+    if (fd < 0) {
+        bundy_throw(DbOperationError, "unable to create lease journal "
+                    << filename_ << ": " << systemError());
+    }
+    OutputBuffer header(HEADER_LEN);
+    writeHeader(header, JOURNAL_MAGIC);
+    if (!writeAll(fd, header.getData(), header.getLength())) {
+        const std::string error = systemError();
+        ::close(fd);
+        bundy_throw(DbOperationError, "unable to write lease journal "
+                    << filename_ << ": " << error);
+    }
+    fd_ = fd;
+    length_ = 0;
+}
+
+void
+LeaseJournal::writeSnapshot(const OutputBuffer& records) {
+    const std::string snapshot = getSnapshotFilename();
+    const std::string tmp = snapshot + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        bundy_throw(DbOperationError, "unable to create lease snapshot "
+                    << tmp << ": " << systemError());
+    }
+    {
+        FileCloser closer(fd);
+        OutputBuffer header(HEADER_LEN);
+        writeHeader(header, SNAPSHOT_MAGIC);
+        if (!writeAll(fd, header.getData(), header.getLength()) ||
+            !writeAll(fd, records.getData(), records.getLength()) ||
+            fsync(fd) != 0) {
+            const std::string error = systemError();
+            unlink(tmp.c_str());
+            bundy_throw(DbOperationError, "unable to write lease snapshot "
+                        << tmp << ": " << error);
+        }
+    }
+    if (rename(tmp.c_str(), snapshot.c_str()) != 0) {
+        const std::string error = systemError();
+        unlink(tmp.c_str());
+        bundy_throw(DbOperationError, "unable to rename lease snapshot "
+                    << tmp << ": " << error);
+    }
+    // The snapshot has all the leases of the journal being compacted.
+    if (unlink(getCompactingFilename().c_str()) != 0 && errno != ENOENT) {
+        bundy_throw(DbOperationError, "unable to remove lease journal "
+                    << getCompactingFilename() << ": " << systemError());
+    }
+}
+
+void
+LeaseJournal::encode(const Lease4& lease, OutputBuffer& buffer) {
+    OutputBuffer data(64 + lease.hostname_.size());
+    data.writeUint8(RECORD_LEASE4);
+    data.writeUint32(static_cast<uint32_t>(lease.addr_));
+    writeShortVector(lease.hwaddr_, "hardware address", data);
+    writeShortVector(lease.getClientIdVector(), "client identifier", data);
+    writeCommon(lease, data);
+    writeRecord(data, buffer);
+}
+
+void
+LeaseJournal::encode(const Lease6& lease, OutputBuffer& buffer) {
+    OutputBuffer data(96 + lease.hostname_.size());
+    data.writeUint8(RECORD_LEASE6);
+    const std::vector<uint8_t> addr = lease.addr_.toBytes();
+    if (addr.size() != 16) {
+        bundy_throw(BadValue, "address of IPv6 lease " << lease.addr_
+                    << " is not IPv6");
+    }
+    data.writeData(&addr[0], addr.size());
+    data.writeUint8(lease.type_);
+    data.writeUint8(lease.prefixlen_);
+    data.writeUint32(lease.iaid_);
+    writeShortVector(lease.getDuidVector(), "DUID", data);
+    data.writeUint32(lease.preferred_lft_);
+    writeCommon(lease, data);
+    writeRecord(data, buffer);
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
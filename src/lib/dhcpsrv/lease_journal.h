@@ -0,0 +1,261 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef LEASE_JOURNAL_H
+#define LEASE_JOURNAL_H
+
+#include <dhcpsrv/lease.h>
+#include <util/buffer.h>
+#include <util/threads/sync.h>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Binary lease journal with snapshots
+///
+/// The journal is an append-only file of binary lease records, which are
+/// much cheaper to write and to read than CSV lines.  Each record is the
+/// length of the lease data (32 bits), the lease data and a checksum of the
+/// data (32 bits), so a record torn by a crash is detected at the end of
+/// the file and discarded.  As in the CSV lease files, a deleted lease is
+/// recorded with a valid lifetime of 0.
+///
+/// The records of several threads are written and synchronized to disk
+/// together: @c append only queues a record, and @c sync waits until it has
+/// been written (and optionally fsync'ed).  The first waiting thread writes
+/// all the queued records at once while the others wait for it (group
+/// commit).
+///
+/// To keep the journal short, it is compacted: the journal is renamed
+/// (@c rotate), a new one is started, and a snapshot of all the leases is
+/// written in a separate file (@c writeSnapshot) which replaces the
+/// previous snapshot and the renamed journal.  The leases are loaded from
+/// the snapshot, then from the renamed journal if the compaction was
+/// interrupted, and from the journal.  Loading a record twice is harmless
+/// as the last record of a lease is the one that counts.
+///
+/// The files are:
+/// - [name] the journal,
+/// - [name].snapshot the snapshot,
+/// - [name].compacting the journal being compacted.
+///
+/// The methods may be called from multiple threads.
+class LeaseJournal : public boost::noncopyable {
+public:
+    /// @brief Function called for each IPv4 lease loaded.
+    typedef boost::function<void(Lease4Ptr&)> Lease4Handler;
+
+    /// @brief Function called for each IPv6 lease loaded.
+    typedef boost::function<void(Lease6Ptr&)> Lease6Handler;
+
+    /// @brief Constructor.
+    ///
+    /// The files are not opened.
+    ///
+    /// @param filename path to the journal file.
+    /// @param fsync if true, the records are fsync'ed by @c sync, else they
+    /// are only written.
+    LeaseJournal(const std::string& filename, bool fsync);
+
+    /// @brief Destructor (closes the journal).
+    ~LeaseJournal();
+
+    /// @brief Returns the path to the journal file.
+    const std::string& getFilename() const {
+        return (filename_);
+    }
+
+    /// @brief Returns the path to the snapshot file.
+    std::string getSnapshotFilename() const;
+
+    /// @brief Returns the path to the journal being compacted.
+    std::string getCompactingFilename() const;
+
+    /// @brief Loads the leases from the files.
+    ///
+    /// The snapshot is mapped in memory and read, then the journal being
+    /// compacted (if any) and the journal.  A torn record at the end of a
+    /// journal is discarded, and the journal is truncated before it.
+    ///
+    /// @param handler4 function called with each IPv4 lease.
+    /// @param handler6 function called with each IPv6 lease.
+    ///
+    /// @throw DbOperationError if a file can't be read or is not valid, or
+    /// if there is no handler for a lease.
+    void load(const Lease4Handler& handler4, const Lease6Handler& handler6);
+
+    /// @brief Opens the journal for appending.
+    ///
+    /// The journal is created if it doesn't exist.
+    ///
+    /// @throw DbOperationError if the file can't be opened or is not a
+    /// lease journal.
+    void open();
+
+    /// @brief Writes the queued records and closes the journal.
+    void close();
+
+    /// @brief Queues a record of an IPv4 lease.
+    ///
+    /// @param lease the lease.
+    /// @return the sequence number to pass to @c sync.
+    uint64_t append(const Lease4& lease);
+
+    /// @brief Queues a record of an IPv6 lease.
+    ///
+    /// @param lease the lease.
+    /// @return the sequence number to pass to @c sync.
+    uint64_t append(const Lease6& lease);
+
+    /// @brief Waits until a record is written to the journal.
+    ///
+    /// The queued records are written at once.
+    ///
+    /// @param sequence the sequence number of the record.
+    ///
+    /// @throw DbOperationError if the record couldn't be written.
+    void sync(uint64_t sequence);
+
+    /// @brief Returns the number of bytes of the records in the journal
+    /// (queued or written), not counting the journal being compacted.
+    uint64_t getLength() const;
+
+    /// @brief Checks if there is a journal being compacted.
+    ///
+    /// This is the case after a compaction failed or was interrupted.
+    bool compactionPending() const;
+
+    /// @brief Starts a compaction.
+    ///
+    /// The queued records are written and the journal is renamed to the
+    /// journal being compacted (or appended to it if it exists already),
+    /// then a new journal is started.  The caller must prevent the leases
+    /// from changing while the journal is rotated and it copies the
+    /// leases for the snapshot.
+    ///
+    /// @throw DbOperationError if a file operation fails.
+    void rotate();
+
+    /// @brief Finishes a compaction.
+    ///
+    /// The snapshot is written in a temporary file which replaces the
+    /// snapshot, then the journal being compacted is removed.
+    ///
+    /// @param records the records of all the leases, see @c encode.
+    ///
+    /// @throw DbOperationError if a file operation fails.
+    void writeSnapshot(const bundy::util::OutputBuffer& records);
+
+    /// @brief Encodes the record of an IPv4 lease.
+    ///
+    /// @param lease the lease.
+    /// @param [out] buffer the buffer the record is appended to.
+    static void encode(const Lease4& lease, bundy::util::OutputBuffer& buffer);
+
+    /// @brief Encodes the record of an IPv6 lease.
+    ///
+    /// @param lease the lease.
+    /// @param [out] buffer the buffer the record is appended to.
+    static void encode(const Lease6& lease, bundy::util::OutputBuffer& buffer);
+
+    /// @brief Decodes a record.
+    ///
+    /// @param data the data starting with the record.
+    /// @param len the length of the data.
+    /// @param handler4 function called with the lease of an IPv4 record.
+    /// @param handler6 function called with the lease of an IPv6 record.
+    ///
+    /// @return the length of the record, or 0 if the data doesn't start
+    /// with a complete record (the record is torn or corrupted).
+    /// @throw bundy::Exception if the lease of the record is not valid,
+    /// or if there is no handler for it.
+    static size_t decode(const uint8_t* data, size_t len,
+                         const Lease4Handler& handler4,
+                         const Lease6Handler& handler6);
+
+private:
+    /// @brief Appends an encoded record to the queue.
+    uint64_t queue(const bundy::util::OutputBuffer& record);
+
+    /// @brief Writes data to the journal, returns an error message or an
+    /// empty string.
+    std::string write(const std::vector<uint8_t>& data);
+
+    /// @brief Writes the queued records, the mutex must be locked and no
+    /// other thread must be writing.
+    void flush();
+
+    /// @brief Reads the records of a file.
+    ///
+    /// @param path the file.
+    /// @param magic the magic string the file starts with.
+    /// @param truncate if true, a torn record at the end of the file is
+    /// discarded and the file truncated, else it is an error.
+    void replay(const std::string& path, const char* magic, bool truncate,
+                const Lease4Handler& handler4,
+                const Lease6Handler& handler6);
+
+    /// @brief The path to the journal.
+    const std::string filename_;
+
+    /// @brief Do we fsync the journal?
+    const bool fsync_;
+
+    /// @brief The file descriptor of the journal (-1 when closed).
+    int fd_;
+
+    /// @brief The records queued for writing.
+    std::vector<uint8_t> pending_;
+
+    /// @brief The sequence number of the last record queued.
+    uint64_t appended_;
+
+    /// @brief The sequence number of the last record written.
+    uint64_t synced_;
+
+    /// @brief The range of sequence numbers of the last records which
+    /// couldn't be written, and the error.
+    uint64_t failed_from_;
+    uint64_t failed_to_;
+    std::string error_;
+
+    /// @brief Is a thread writing the queued records?
+    bool writing_;
+
+    /// @brief The number of bytes of the records in the journal.
+    uint64_t length_;
+
+    /// @brief Protects the members above.
+    mutable bundy::util::thread::Mutex mutex_;
+
+    /// @brief Signaled when the queued records have been written.
+    bundy::util::thread::CondVar written_;
+};
+
+/// @brief A pointer to a @c LeaseJournal.
+typedef boost::shared_ptr<LeaseJournal> LeaseJournalPtr;
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // LEASE_JOURNAL_H
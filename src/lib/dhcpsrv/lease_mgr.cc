@@ -40,6 +40,27 @@ std::string LeaseMgr::getParameter(const std::string& name) const {
     return (param->second);
 }
 
+Lease4Collection
+LeaseMgr::getLeases4(const bundy::asiolink::IOAddress& lower,
+                     const bundy::asiolink::IOAddress& upper) const {
+    Lease4Collection collection;
+    if (!lower.isV4() || !upper.isV4()) {
+        return (collection);
+    }
+    const uint32_t last = static_cast<uint32_t>(upper);
+    for (uint32_t addr = static_cast<uint32_t>(lower); addr <= last; ++addr) {
+        const Lease4Ptr lease = getLease4(bundy::asiolink::IOAddress(addr));
+        if (lease) {
+            collection.push_back(lease);
+        }
+        // Don't wrap around at the end of the address space.
+        if (addr == last) {
+            break;
+        }
+    }
+    return (collection);
+}
+
 Lease6Ptr
 LeaseMgr::getLease6(Lease::Type type, const DUID& duid,
                     uint32_t iaid, SubnetID subnet_id) const {
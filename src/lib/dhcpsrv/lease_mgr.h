@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -229,6 +229,20 @@ public:
     virtual Lease4Ptr getLease4(const ClientId& clientid,
                                 SubnetID subnet_id) const = 0;
 
+    /// @brief Returns existing IPv4 leases for a range of addresses
+    ///
+    /// The default implementation looks up the addresses one by one, so
+    /// the backends should provide a more efficient one.
+    ///
+    /// @param lower the first address of the range
+    /// @param upper the last address of the range
+    ///
+    /// @return lease collection ordered by address (may be empty if no
+    /// lease is found)
+    virtual Lease4Collection getLeases4(const bundy::asiolink::IOAddress& lower,
+                                        const bundy::asiolink::IOAddress& upper)
+        const;
+
     /// @brief Returns existing IPv6 lease for a given IPv6 address.
     ///
     /// For a given address, we assume that there will be only one lease.
@@ -298,6 +312,29 @@ public:
     Lease6Ptr getLease6(Lease::Type type, const DUID& duid,
                         uint32_t iaid, SubnetID subnet_id) const;
 
+    /// @brief Returns expired IPv4 leases
+    ///
+    /// The leases whose expiration time (see @c Lease::getExpirationTime)
+    /// has passed are returned, the earliest expired first.  The backends
+    /// index the leases by expiration time, so that the expired leases can
+    /// be reclaimed in batches without scanning all the leases.
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    virtual Lease4Collection getExpiredLeases4(size_t max_leases) const = 0;
+
+    /// @brief Returns expired IPv6 leases
+    ///
+    /// See @c getExpiredLeases4.  The leases of all types are returned.
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    virtual Lease6Collection getExpiredLeases6(size_t max_leases) const = 0;
+
     /// @brief Updates IPv4 lease.
     ///
     /// @param lease4 The lease to be updated.
@@ -368,6 +405,17 @@ public:
     /// support transactions, this is a no-op.
     virtual void rollback() = 0;
 
+    /// @brief Waits until the lease changes are stored
+    ///
+    /// The servers call this before they acknowledge leases to a client,
+    /// so a lease is never acknowledged before it is stored.  It only
+    /// blocks with the backends which store the changes in the background
+    /// (such as MySQL in the write-behind mode); the default implementation
+    /// returns at once.
+    ///
+    /// @throw DbOperationError The changes could not be stored.
+    virtual void waitForWrites() {}
+
     /// @todo: Add host management here
     /// As host reservation is outside of scope for 2012, support for hosts
     /// is currently postponed.
@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -14,6 +14,7 @@
 
 #include "config.h"
 
+#include <dhcpsrv/caching_lease_mgr.h>
 #include <dhcpsrv/dhcpsrv_log.h>
 #include <dhcpsrv/lease_mgr_factory.h>
 #include <dhcpsrv/memfile_lease_mgr.h>
@@ -23,18 +24,23 @@
 #ifdef HAVE_PGSQL
 #include <dhcpsrv/pgsql_lease_mgr.h>
 #endif
+#include <dhcpsrv/replicating_lease_mgr.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include <algorithm>
+#include <new>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <sstream>
 #include <utility>
 
+#include <pthread.h>
+
 using namespace std;
 
 namespace bundy {
@@ -104,6 +110,105 @@ LeaseMgrFactory::redactedAccessString(const LeaseMgr::ParameterMap& parameters)
     return (access);
 }
 
+namespace {
+
+// The lease manager of a thread which has a session.
+struct Session {
+    Session() : generation(0) {}
+
+    boost::scoped_ptr<LeaseMgr> lease_mgr;
+    // The value of the generation counter when lease_mgr was created.
+    unsigned int generation;
+};
+
+pthread_once_t session_once = PTHREAD_ONCE_INIT;
+pthread_key_t session_key;
+
+void
+deleteSession(void* session) {
+    delete static_cast<Session*>(session);
+}
+
+void
+createSessionKey() {
+    pthread_key_create(&session_key, deleteSession);
+}
+
+Session*
+getSession() {
+    pthread_once(&session_once, createSessionKey);
+    return (static_cast<Session*>(pthread_getspecific(session_key)));
+}
+
+}
+
+LeaseMgr::ParameterMap&
+LeaseMgrFactory::getParameters() {
+    static LeaseMgr::ParameterMap parameters;
+    return (parameters);
+}
+
+unsigned int&
+LeaseMgrFactory::getGeneration() {
+    static unsigned int generation = 0;
+    return (generation);
+}
+
+boost::shared_ptr<LeaseCache>&
+LeaseMgrFactory::getCache() {
+    static boost::shared_ptr<LeaseCache> cache;
+    return (cache);
+}
+
+LeaseReplicatorPtr&
+LeaseMgrFactory::getReplicatorPtr() {
+    static LeaseReplicatorPtr replicator;
+    return (replicator);
+}
+
+bool
+LeaseMgrFactory::hasSessions(const LeaseMgr::ParameterMap& parameters) {
+    LeaseMgr::ParameterMap::const_iterator type = parameters.find("type");
+    return (type != parameters.end() &&
+            (type->second == "mysql" || type->second == "postgresql"));
+}
+
+LeaseMgr*
+LeaseMgrFactory::createLeaseMgr(LeaseMgr::ParameterMap& parameters) {
+    const std::string type = "type";
+    LeaseMgr* lease_mgr = NULL;
+
+#ifdef HAVE_MYSQL
+    if (parameters[type] == string("mysql")) {
+        lease_mgr = new MySqlLeaseMgr(parameters);
+    }
+#endif
+#ifdef HAVE_PGSQL
+    if (parameters[type] == string("postgresql")) {
+        lease_mgr = new PgSqlLeaseMgr(parameters);
+    }
+#endif
+    if (lease_mgr != NULL) {
+        if (getCache()) {
+            return (new CachingLeaseMgr(parameters, lease_mgr, getCache()));
+        }
+        return (lease_mgr);
+    }
+    if (parameters[type] == string("memfile")) {
+        if (getReplicatorPtr()) {
+            return (new ReplicatingLeaseMgr(parameters,
+                                            new Memfile_LeaseMgr(parameters),
+                                            getReplicatorPtr()));
+        }
+        return (new Memfile_LeaseMgr(parameters));
+    }
+
+    // Get here on no match
+    LOG_ERROR(dhcpsrv_logger, DHCPSRV_UNKNOWN_DB).arg(parameters[type]);
+    bundy_throw(InvalidType, "Database access parameter 'type' does "
+              "not specify a supported database backend");
+}
+
 void
 LeaseMgrFactory::create(const std::string& dbaccess) {
     const std::string type = "type";
@@ -119,32 +224,163 @@ LeaseMgrFactory::create(const std::string& dbaccess) {
                   "contain the 'type' keyword");
     }
 
-
     // Yes, check what it is.
 #ifdef HAVE_MYSQL
     if (parameters[type] == string("mysql")) {
         LOG_INFO(dhcpsrv_logger, DHCPSRV_MYSQL_DB).arg(redacted);
-        getLeaseMgrPtr().reset(new MySqlLeaseMgr(parameters));
-        return;
     }
 #endif
 #ifdef HAVE_PGSQL
     if (parameters[type] == string("postgresql")) {
         LOG_INFO(dhcpsrv_logger, DHCPSRV_PGSQL_DB).arg(redacted);
-        getLeaseMgrPtr().reset(new PgSqlLeaseMgr(parameters));
-        return;
     }
 #endif
     if (parameters[type] == string("memfile")) {
         LOG_INFO(dhcpsrv_logger, DHCPSRV_MEMFILE_DB).arg(redacted);
-        getLeaseMgrPtr().reset(new Memfile_LeaseMgr(parameters));
-        return;
     }
 
-    // Get here on no match
-    LOG_ERROR(dhcpsrv_logger, DHCPSRV_UNKNOWN_DB).arg(parameters[type]);
-    bundy_throw(InvalidType, "Database access parameter 'type' does "
-              "not specify a supported database backend");
+    // The leases are cached only in front of the database backends, the
+    // memfile backend holding them in memory already.
+    boost::shared_ptr<LeaseCache> cache;
+    LeaseMgr::ParameterMap::const_iterator cache_size =
+        parameters.find("cache-size");
+    if (cache_size != parameters.end()) {
+        int64_t size = -1;
+        try {
+            size = boost::lexical_cast<int64_t>(cache_size->second);
+        } catch (const boost::bad_lexical_cast&) {
+            // Reported below.
+        }
+        if (size < 0) {
+            LOG_ERROR(dhcpsrv_logger, DHCPSRV_INVALID_ACCESS).arg(redacted);
+            bundy_throw(InvalidParameter, "invalid lease cache size "
+                        << cache_size->second);
+        }
+        if (size > 0 && hasSessions(parameters)) {
+            cache.reset(new LeaseCache(size));
+        }
+    }
+
+    // The changes of the memfile leases may be replicated to a peer
+    // server.  The socket is bound at once, so a new server replaces the
+    // socket of the current one.
+    LeaseReplicatorPtr replicator;
+    LeaseMgr::ParameterMap::const_iterator socket_name =
+        parameters.find("replication-socket");
+    LeaseMgr::ParameterMap::const_iterator peer_name =
+        parameters.find("replication-peer");
+    if (socket_name != parameters.end() || peer_name != parameters.end()) {
+        if (socket_name == parameters.end() || peer_name == parameters.end() ||
+            parameters[type] != string("memfile")) {
+            LOG_ERROR(dhcpsrv_logger, DHCPSRV_INVALID_ACCESS).arg(redacted);
+            bundy_throw(InvalidParameter, "lease replication requires the "
+                        "memfile backend, and both replication-socket and "
+                        "replication-peer");
+        }
+        int node = -1;
+        LeaseMgr::ParameterMap::const_iterator node_value =
+            parameters.find("replication-node");
+        if (node_value != parameters.end()) {
+            try {
+                node = boost::lexical_cast<int>(node_value->second);
+            } catch (const boost::bad_lexical_cast&) {
+                LOG_ERROR(dhcpsrv_logger, DHCPSRV_INVALID_ACCESS)
+                    .arg(redacted);
+                bundy_throw(InvalidParameter, "invalid lease replication "
+                            "node " << node_value->second);
+            }
+        }
+        replicator.reset(new LeaseReplicator(socket_name->second,
+                                             peer_name->second, node));
+    }
+
+    // The lease managers created by createLeaseMgr() use the current
+    // cache and replicator.
+    getCache().swap(cache);
+    getReplicatorPtr().swap(replicator);
+    try {
+        getLeaseMgrPtr().reset(createLeaseMgr(parameters));
+    } catch (...) {
+        getCache().swap(cache);
+        getReplicatorPtr().swap(replicator);
+        throw;
+    }
+    if (getCache()) {
+        LOG_INFO(dhcpsrv_logger, DHCPSRV_LEASE_CACHE)
+            .arg(cache_size->second);
+    }
+    if (getReplicatorPtr()) {
+        LOG_INFO(dhcpsrv_logger, DHCPSRV_REPLICATION_STARTED)
+            .arg(getReplicatorPtr()->getSocketName())
+            .arg(getReplicatorPtr()->getPeerName())
+            .arg(getReplicatorPtr()->getNode());
+    }
+
+    // The existing sessions are for the previous lease manager.
+    getParameters() = parameters;
+    ++getGeneration();
+}
+
+bool
+LeaseMgrFactory::createSession() {
+    if (!getLeaseMgrPtr()) {
+        bundy_throw(NoLeaseManager, "no current lease manager is available");
+    }
+    if (!hasSessions(getParameters())) {
+        destroySession();
+        return (false);
+    }
+
+    Session* session = getSession();
+    if (session == NULL) {
+        session = new Session;
+        if (pthread_setspecific(session_key, session) != 0) {
+            delete session;
+            throw std::bad_alloc();
+        }
+    }
+    if (!session->lease_mgr || session->generation != getGeneration()) {
+        session->lease_mgr.reset();
+        session->lease_mgr.reset(createLeaseMgr(getParameters()));
+        session->generation = getGeneration();
+    }
+    return (true);
+}
+
+void
+LeaseMgrFactory::destroySession() {
+    Session* session = getSession();
+    if (session != NULL) {
+        pthread_setspecific(session_key, NULL);
+        delete session;
+    }
+}
+
+bool
+LeaseMgrFactory::flushCache() {
+    if (!getCache()) {
+        return (false);
+    }
+    getCache()->flush();
+    LOG_INFO(dhcpsrv_logger, DHCPSRV_LEASE_CACHE_FLUSHED);
+    return (true);
+}
+
+LeaseReplicatorPtr
+LeaseMgrFactory::getReplicator() {
+    return (getReplicatorPtr());
+}
+
+size_t
+LeaseMgrFactory::receiveReplication() {
+    // The current lease manager replicates the changes if there is a
+    // replicator.
+    ReplicatingLeaseMgr* lease_mgr =
+        dynamic_cast<ReplicatingLeaseMgr*>(getLeaseMgrPtr().get());
+    if (lease_mgr == NULL) {
+        return (0);
+    }
+    return (lease_mgr->receive());
 }
 
 void
@@ -156,10 +392,28 @@ LeaseMgrFactory::destroy() {
             .arg(getLeaseMgrPtr()->getType());
     }
     getLeaseMgrPtr().reset();
+    getCache().reset();
+    getReplicatorPtr().reset();
+    getParameters().clear();
+    ++getGeneration();
 }
 
 LeaseMgr&
 LeaseMgrFactory::instance() {
+    // Use the lease manager of the session of the thread, unless the
+    // session was created for a previous lease manager.
+    Session* session = getSession();
+    if (session != NULL) {
+        if (session->generation != getGeneration()) {
+            createSession();
+        }
+        // createSession() may have destroyed the session
+        session = getSession();
+        if (session != NULL) {
+            return (*session->lease_mgr);
+        }
+    }
+
     LeaseMgr* lmptr = getLeaseMgrPtr().get();
     if (lmptr == NULL) {
         bundy_throw(NoLeaseManager, "no current lease manager is available");
@@ -1,4 +1,4 @@
-// Copyright (C) 2012 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -18,11 +18,16 @@
 #include <dhcpsrv/lease_mgr.h>
 #include <exceptions/exceptions.h>
 
+#include <boost/shared_ptr.hpp>
+
 #include <string>
 
 namespace bundy {
 namespace dhcp {
 
+class LeaseCache;
+class LeaseReplicator;
+
 /// @brief Invalid type exception
 ///
 /// Thrown when the factory doesn't recognise the type of the backend.
@@ -89,10 +94,80 @@ public:
     /// lease manager is available.
     static void destroy();
 
+    /// @brief Create a lease manager session for the calling thread
+    ///
+    /// Lease managers of the database backends (MySQL and PostgreSQL) hold
+    /// a single connection to the database, which can't be used by several
+    /// threads at once.  This method creates another lease manager with the
+    /// parameters of the current one, to be used by the calling thread only:
+    /// once the thread has a session, instance() called by the thread returns
+    /// the lease manager of the session.
+    ///
+    /// The memfile backend keeps the leases in memory and protects them
+    /// internally, so all threads have to share the current lease manager.
+    /// For this backend no session is created.
+    ///
+    /// If the current lease manager is replaced (by create()) or destroyed,
+    /// the session is recreated for the new one by the next call to
+    /// instance() in the thread.  The session is destroyed when the thread
+    /// exits, or by destroySession().
+    ///
+    /// @note create() and destroy() must not be called while other threads
+    ///       use the lease manager.
+    ///
+    /// @return true if the thread has a session, false if it uses the
+    ///         current lease manager.
+    /// @throw bundy::dhcp::NoLeaseManager No lease manager is available.
+    static bool createSession();
+
+    /// @brief Destroy the session of the calling thread
+    ///
+    /// The thread uses the current lease manager afterwards.  The method is
+    /// a no-op if the thread has no session.
+    static void destroySession();
+
+    /// @brief Flush the lease cache
+    ///
+    /// If the "cache-size" parameter of a database backend (MySQL or
+    /// PostgreSQL) is set to a positive number, the lease managers created
+    /// by the factory (the current one and those of the sessions) share a
+    /// cache of this number of DHCPv4 and DHCPv6 leases (see @c
+    /// CachingLeaseMgr).  The cache must be flushed when the leases are
+    /// changed in the database by other means than the lease managers,
+    /// such as an administrator editing the database.
+    ///
+    /// @return true if the cache was flushed, false if there is no cache.
+    static bool flushCache();
+
+    /// @brief Return the replicator of the lease changes
+    ///
+    /// If the "replication-socket" and "replication-peer" parameters of the
+    /// memfile backend are set, the current lease manager sends the
+    /// changes of the leases to the peer server listening on the second
+    /// socket, and receives the changes of the peer on the first one (see
+    /// @c ReplicatingLeaseMgr).  The "replication-node" parameter (0 or 1)
+    /// makes each server answer half of the clients while both run.
+    ///
+    /// The servers wait for the changes of the peer on the socket of the
+    /// replicator, and send their own changes with its flush() method.
+    ///
+    /// @return the replicator, or null if the changes are not replicated.
+    static boost::shared_ptr<LeaseReplicator> getReplicator();
+
+    /// @brief Apply the lease changes received from the peer server
+    ///
+    /// Called when the socket of the replicator is readable.  The changes
+    /// are applied to the leases of the current lease manager.
+    ///
+    /// @return the number of changes received (0 if the changes are not
+    ///         replicated).
+    static size_t receiveReplication();
+
     /// @brief Return current lease manager
     ///
-    /// Returns an instance of the "current" lease manager.  An exception
-    /// will be thrown if none is available.
+    /// Returns an instance of the "current" lease manager, or the lease
+    /// manager of the session of the calling thread if it has one (see
+    /// createSession()).  An exception will be thrown if none is available.
     ///
     /// @throw bundy::dhcp::NoLeaseManager No lease manager is available: use
     ///        create() to create one before calling this method.
@@ -127,6 +202,31 @@ private:
     /// fiasco" if defined in an external static variable.
     static boost::scoped_ptr<LeaseMgr>& getLeaseMgrPtr();
 
+    /// @brief Create a lease manager of the given type
+    ///
+    /// @param parameters Parsed database access parameters.
+    /// @throw bundy::dhcp::InvalidType Unsupported type of backend.
+    static LeaseMgr* createLeaseMgr(LeaseMgr::ParameterMap& parameters);
+
+    /// @brief Whether the backend needs a lease manager per thread
+    static bool hasSessions(const LeaseMgr::ParameterMap& parameters);
+
+    /// @brief Parameters of the current lease manager, used to create
+    ///        the sessions
+    static LeaseMgr::ParameterMap& getParameters();
+
+    /// @brief Counter incremented whenever the current lease manager
+    ///        changes, to detect outdated sessions
+    static unsigned int& getGeneration();
+
+    /// @brief Cache shared by the current lease manager and the sessions,
+    ///        or null if the leases are not cached
+    static boost::shared_ptr<LeaseCache>& getCache();
+
+    /// @brief Replicator used by the current lease manager, or null if the
+    ///        changes are not replicated
+    static boost::shared_ptr<LeaseReplicator>& getReplicatorPtr();
+
 };
 
 }; // end of bundy::dhcp namespace
@@ -16,31 +16,85 @@
 #include <dhcpsrv/dhcpsrv_log.h>
 #include <dhcpsrv/memfile_lease_mgr.h>
 #include <exceptions/exceptions.h>
+#include <util/buffer.h>
 
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <ctime>
 #include <iostream>
+#include <vector>
 
 using namespace bundy::dhcp;
+using bundy::util::OutputBuffer;
+using bundy::util::thread::Mutex;
+using bundy::util::thread::Thread;
 
 Memfile_LeaseMgr::Memfile_LeaseMgr(const ParameterMap& parameters)
-    : LeaseMgr(parameters) {
+    : LeaseMgr(parameters), binary_(false), draining_(false),
+      compact_interval_(3600), stopping_(false) {
+    const std::string format = getOptionalParameter("format", "csv");
+    if (format == "binary") {
+        binary_ = true;
+    } else if (format != "csv") {
+        bundy_throw(bundy::BadValue, "invalid value 'format="
+                    << format << "'");
+    }
+    const std::string fsync_val = getOptionalParameter("fsync", "true");
+    if (fsync_val != "true" && fsync_val != "false") {
+        bundy_throw(bundy::BadValue, "invalid value 'fsync="
+                    << fsync_val << "'");
+    }
+    const std::string interval = getOptionalParameter("compact-interval",
+                                                      "3600");
+    try {
+        compact_interval_ = boost::lexical_cast<size_t>(interval);
+    } catch (const boost::bad_lexical_cast&) {
+        bundy_throw(bundy::BadValue, "invalid value 'compact-interval="
+                    << interval << "'");
+    }
+
     // Check the universe and use v4 file or v6 file.
     std::string universe = getParameter("universe");
     if (universe == "4") {
         std::string file4 = initLeaseFilePath(V4);
-        if (!file4.empty()) {
+        if (binary_ && !file4.empty()) {
+            // The journal is loaded first, so a torn record at its end is
+            // discarded before new records are appended.
+            journal4_.reset(new LeaseJournal(file4, fsync_val == "true"));
+            load4();
+            journal4_->open();
+        } else if (!file4.empty()) {
             lease_file4_.reset(new CSVLeaseFile4(file4));
             lease_file4_->open();
             load4();
         }
     } else {
         std::string file6 = initLeaseFilePath(V6);
-        if (!file6.empty()) {
+        if (binary_ && !file6.empty()) {
+            journal6_.reset(new LeaseJournal(file6, fsync_val == "true"));
+            load6();
+            journal6_->open();
+        } else if (!file6.empty()) {
             lease_file6_.reset(new CSVLeaseFile6(file6));
             lease_file6_->open();
             load6();
         }
     }
 
+    const LeaseJournalPtr& journal = journal4_ ? journal4_ : journal6_;
+    if (journal) {
+        // Finish the compaction interrupted when the server stopped.
+        if (journal->compactionPending()) {
+            compact();
+        }
+        if (compact_interval_ > 0) {
+            compaction_thread_.reset(
+                new Thread(boost::bind(&Memfile_LeaseMgr::compactionLoop,
+                                       this)));
+        }
+    }
+
     // If lease persistence have been disabled for both v4 and v6,
     // issue a warning. It is ok not to write leases to disk when
     // doing testing, but it should not be done in normal server
@@ -51,6 +105,22 @@ Memfile_LeaseMgr::Memfile_LeaseMgr(const ParameterMap& parameters)
 }
 
 Memfile_LeaseMgr::~Memfile_LeaseMgr() {
+    if (compaction_thread_) {
+        {
+            Mutex::Locker locker(stop_mutex_);
+            stopping_ = true;
+            stop_cond_.signal();
+        }
+        compaction_thread_->wait();
+    }
+    if (journal4_) {
+        journal4_->close();
+        journal4_.reset();
+    }
+    if (journal6_) {
+        journal6_->close();
+        journal6_.reset();
+    }
     if (lease_file4_) {
         lease_file4_->close();
         lease_file4_.reset();
@@ -65,20 +135,34 @@ bool
 Memfile_LeaseMgr::addLease(const Lease4Ptr& lease) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_ADD_ADDR4).arg(lease->addr_.toText());
+    const uint32_t addr = static_cast<uint32_t>(lease->addr_);
+    uint64_t sequence = 0;
+    {
+        Mutex::Locker locker(mutex_);
+        waitForChange4(addr);
+
+        if (storage4_.find(addr) != storage4_.end()) {
+            // there is a lease with specified address already
+            return (false);
+        }
 
-    if (getLease4(lease->addr_)) {
-        // there is a lease with specified address already
-        return (false);
-    }
-
-    // Try to write a lease to disk first. If this fails, the lease will
-    // not be inserted to the memory and the disk and in-memory data will
-    // remain consistent.
-    if (persistLeases(V4)) {
-        lease_file4_->append(*lease);
+        // Write the lease to disk (or queue it in the journal) first. If
+        // this fails, the lease will not be inserted to the memory and the
+        // disk and in-memory data will remain consistent.
+        sequence = appendLease(*lease);
+        if (sequence == 0) {
+            // The lease is stored in its compact form.
+            storage4_.insert(PackedLease4(*lease));
+            return (true);
+        }
+        pending4_.insert(addr);
     }
-
-    storage4_.insert(lease);
+    // The lease is written to the journal after the lock is released, and
+    // inserted to the memory only then.
+    syncLease4(addr, sequence);
+    Mutex::Locker locker(mutex_);
+    endChange4(addr);
+    storage4_.insert(PackedLease4(*lease));
     return (true);
 }
 
@@ -86,20 +170,34 @@ bool
 Memfile_LeaseMgr::addLease(const Lease6Ptr& lease) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_ADD_ADDR6).arg(lease->addr_.toText());
+    const Address6Key addr(lease->addr_);
+    uint64_t sequence = 0;
+    {
+        Mutex::Locker locker(mutex_);
+        waitForChange6(addr);
+
+        if (storage6_.find(addr) != storage6_.end()) {
+            // there is a lease with specified address already
+            return (false);
+        }
 
-    if (getLease6(lease->type_, lease->addr_)) {
-        // there is a lease with specified address already
-        return (false);
-    }
-
-    // Try to write a lease to disk first. If this fails, the lease will
-    // not be inserted to the memory and the disk and in-memory data will
-    // remain consistent.
-    if (persistLeases(V6)) {
-        lease_file6_->append(*lease);
+        // Write the lease to disk (or queue it in the journal) first. If
+        // this fails, the lease will not be inserted to the memory and the
+        // disk and in-memory data will remain consistent.
+        sequence = appendLease(*lease);
+        if (sequence == 0) {
+            // The lease is stored in its compact form.
+            storage6_.insert(PackedLease6(*lease));
+            return (true);
+        }
+        pending6_.insert(addr);
     }
-
-    storage6_.insert(lease);
+    // The lease is written to the journal after the lock is released, and
+    // inserted to the memory only then.
+    syncLease6(addr, sequence);
+    Mutex::Locker locker(mutex_);
+    endChange6(addr);
+    storage6_.insert(PackedLease6(*lease));
     return (true);
 }
 
@@ -107,14 +205,18 @@ Lease4Ptr
 Memfile_LeaseMgr::getLease4(const bundy::asiolink::IOAddress& addr) const {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_ADDR4).arg(addr.toText());
+    if (!addr.isV4()) {
+        return (Lease4Ptr());
+    }
+    Mutex::Locker locker(mutex_);
 
     typedef Lease4Storage::nth_index<0>::type SearchIndex;
     const SearchIndex& idx = storage4_.get<0>();
-    Lease4Storage::iterator l = idx.find(addr);
+    Lease4Storage::iterator l = idx.find(static_cast<uint32_t>(addr));
     if (l == storage4_.end()) {
         return (Lease4Ptr());
     } else {
-        return (Lease4Ptr(new Lease4(**l)));
+        return (l->toLease());
     }
 }
 
@@ -122,16 +224,17 @@ Lease4Collection
 Memfile_LeaseMgr::getLease4(const HWAddr& hwaddr) const {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_HWADDR).arg(hwaddr.toText());
-    typedef Lease4Storage::nth_index<0>::type SearchIndex;
-    Lease4Collection collection;
-    const SearchIndex& idx = storage4_.get<0>();
-    for(SearchIndex::const_iterator lease = idx.begin();
-        lease != idx.end(); ++lease) {
+    Mutex::Locker locker(mutex_);
 
-        // Every Lease4 has a hardware address, so we can compare it
-        if ((*lease)->hwaddr_ == hwaddr.hwaddr_) {
-            collection.push_back((*lease));
-        }
+    // We are going to use index #5 of the multi index container.
+    typedef Lease4Storage::nth_index<5>::type SearchIndex;
+    const SearchIndex& idx = storage4_.get<5>();
+    std::pair<SearchIndex::const_iterator, SearchIndex::const_iterator> l =
+        idx.equal_range(IdentifierKey(hwaddr.hwaddr_));
+    Lease4Collection collection;
+    for (SearchIndex::const_iterator lease = l.first; lease != l.second;
+         ++lease) {
+        collection.push_back(lease->toLease());
     }
 
     return (collection);
@@ -142,6 +245,7 @@ Memfile_LeaseMgr::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) const {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_SUBID_HWADDR).arg(subnet_id)
         .arg(hwaddr.toText());
+    Mutex::Locker locker(mutex_);
 
     // We are going to use index #1 of the multi index container.
     // We define SearchIndex locally in this function because
@@ -151,31 +255,33 @@ Memfile_LeaseMgr::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) const {
     const SearchIndex& idx = storage4_.get<1>();
     // Try to find the lease using HWAddr and subnet id.
     SearchIndex::const_iterator lease =
-        idx.find(boost::make_tuple(hwaddr.hwaddr_, subnet_id));
+        idx.find(boost::make_tuple(IdentifierKey(hwaddr.hwaddr_), subnet_id));
     // Lease was not found. Return empty pointer to the caller.
     if (lease == idx.end()) {
         return (Lease4Ptr());
     }
 
     // Lease was found. Return it to the caller.
-    return (Lease4Ptr(new Lease4(**lease)));
+    return (lease->toLease());
 }
 
 Lease4Collection
 Memfile_LeaseMgr::getLease4(const ClientId& client_id) const {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_CLIENTID).arg(client_id.toText());
-    typedef Memfile_LeaseMgr::Lease4Storage::nth_index<0>::type SearchIndex;
+    Mutex::Locker locker(mutex_);
+
+    // We are going to use index #6 of the multi index container.  The
+    // leases without a client id have an empty key, which doesn't match
+    // any client id.
+    typedef Lease4Storage::nth_index<6>::type SearchIndex;
+    const SearchIndex& idx = storage4_.get<6>();
+    std::pair<SearchIndex::const_iterator, SearchIndex::const_iterator> l =
+        idx.equal_range(IdentifierKey(client_id.getClientId()));
     Lease4Collection collection;
-    const SearchIndex& idx = storage4_.get<0>();
-    for(SearchIndex::const_iterator lease = idx.begin();
-        lease != idx.end(); ++ lease) {
-
-        // client-id is not mandatory in DHCPv4. There can be a lease that does
-        // not have a client-id. Dereferencing null pointer would be a bad thing
-        if((*lease)->client_id_ && *(*lease)->client_id_ == client_id) {
-            collection.push_back((*lease));
-        }
+    for (SearchIndex::const_iterator lease = l.first; lease != l.second;
+         ++lease) {
+        collection.push_back(lease->toLease());
     }
 
     return (collection);
@@ -189,6 +295,7 @@ Memfile_LeaseMgr::getLease4(const ClientId& client_id,
               DHCPSRV_MEMFILE_GET_CLIENTID_HWADDR_SUBID).arg(client_id.toText())
                                                         .arg(hwaddr.toText())
                                                         .arg(subnet_id);
+    Mutex::Locker locker(mutex_);
 
     // We are going to use index #3 of the multi index container.
     // We define SearchIndex locally in this function because
@@ -198,8 +305,8 @@ Memfile_LeaseMgr::getLease4(const ClientId& client_id,
     const SearchIndex& idx = storage4_.get<3>();
     // Try to get the lease using client id, hardware address and subnet id.
     SearchIndex::const_iterator lease =
-        idx.find(boost::make_tuple(client_id.getClientId(), hwaddr.hwaddr_,
-                                   subnet_id));
+        idx.find(boost::make_tuple(IdentifierKey(client_id.getClientId()),
+                                   IdentifierKey(hwaddr.hwaddr_), subnet_id));
 
     if (lease == idx.end()) {
         // Lease was not found. Return empty pointer to the caller.
@@ -207,7 +314,7 @@ Memfile_LeaseMgr::getLease4(const ClientId& client_id,
     }
 
     // Lease was found. Return it to the caller.
-    return (*lease);
+    return (lease->toLease());
 }
 
 Lease4Ptr
@@ -216,6 +323,7 @@ Memfile_LeaseMgr::getLease4(const ClientId& client_id,
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_SUBID_CLIENTID).arg(subnet_id)
               .arg(client_id.toText());
+    Mutex::Locker locker(mutex_);
 
     // We are going to use index #2 of the multi index container.
     // We define SearchIndex locally in this function because
@@ -225,13 +333,57 @@ Memfile_LeaseMgr::getLease4(const ClientId& client_id,
     const SearchIndex& idx = storage4_.get<2>();
     // Try to get the lease using client id and subnet id.
     SearchIndex::const_iterator lease =
-        idx.find(boost::make_tuple(client_id.getClientId(), subnet_id));
+        idx.find(boost::make_tuple(IdentifierKey(client_id.getClientId()),
+                                   subnet_id));
     // Lease was not found. Return empty pointer to the caller.
     if (lease == idx.end()) {
         return (Lease4Ptr());
     }
     // Lease was found. Return it to the caller.
-    return (Lease4Ptr(new Lease4(**lease)));
+    return (lease->toLease());
+}
+
+Lease4Collection
+Memfile_LeaseMgr::getLeases4(const bundy::asiolink::IOAddress& lower,
+                             const bundy::asiolink::IOAddress& upper) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_MEMFILE_GET_RANGE4).arg(lower.toText())
+        .arg(upper.toText());
+    const uint32_t upper_addr = static_cast<uint32_t>(upper);
+    Mutex::Locker locker(mutex_);
+
+    // The leases are ordered by address in the index #0.
+    typedef Lease4Storage::nth_index<0>::type SearchIndex;
+    const SearchIndex& idx = storage4_.get<0>();
+    Lease4Collection collection;
+    for (SearchIndex::const_iterator lease =
+             idx.lower_bound(static_cast<uint32_t>(lower));
+         lease != idx.end() && lease->getAddress() <= upper_addr; ++lease) {
+        collection.push_back(lease->toLease());
+    }
+
+    return (collection);
+}
+
+Lease4Collection
+Memfile_LeaseMgr::getExpiredLeases4(size_t max_leases) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_MEMFILE_GET_EXPIRED4).arg(max_leases);
+    Mutex::Locker locker(mutex_);
+
+    // The leases are ordered by expiration time in the index #4, so the
+    // expired leases are at its beginning.
+    typedef Lease4Storage::nth_index<4>::type SearchIndex;
+    const SearchIndex& idx = storage4_.get<4>();
+    const int64_t now = time(NULL);
+    Lease4Collection collection;
+    for (SearchIndex::const_iterator lease = idx.begin();
+         lease != idx.end() && lease->getExpirationTime() < now &&
+             (max_leases == 0 || collection.size() < max_leases); ++lease) {
+        collection.push_back(lease->toLease());
+    }
+
+    return (collection);
 }
 
 Lease6Ptr
@@ -239,12 +391,16 @@ Memfile_LeaseMgr::getLease6(Lease::Type /* not used yet */,
                             const bundy::asiolink::IOAddress& addr) const {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_ADDR6).arg(addr.toText());
+    if (!addr.isV6()) {
+        return (Lease6Ptr());
+    }
+    Mutex::Locker locker(mutex_);
 
-    Lease6Storage::iterator l = storage6_.find(addr);
+    Lease6Storage::iterator l = storage6_.find(Address6Key(addr));
     if (l == storage6_.end()) {
         return (Lease6Ptr());
     } else {
-        return (Lease6Ptr(new Lease6(**l)));
+        return (l->toLease());
     }
 }
 
@@ -266,6 +422,7 @@ Memfile_LeaseMgr::getLeases6(Lease::Type /* not used yet */,
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_GET_IAID_SUBID_DUID)
               .arg(iaid).arg(subnet_id).arg(duid.toText());
+    Mutex::Locker locker(mutex_);
 
     // We are going to use index #1 of the multi index container.
     // We define SearchIndex locally in this function because
@@ -275,7 +432,8 @@ Memfile_LeaseMgr::getLeases6(Lease::Type /* not used yet */,
     const SearchIndex& idx = storage6_.get<1>();
     // Try to get the lease using the DUID, IAID and Subnet ID.
     SearchIndex::const_iterator lease =
-        idx.find(boost::make_tuple(duid.getDuid(), iaid, subnet_id));
+        idx.find(boost::make_tuple(IdentifierKey(duid.getDuid()), iaid,
+                                   subnet_id));
     // Lease was not found. Return empty pointer.
     if (lease == idx.end()) {
         return (Lease6Collection());
@@ -284,7 +442,27 @@ Memfile_LeaseMgr::getLeases6(Lease::Type /* not used yet */,
     // Lease was found, return it to the caller.
     /// @todo: allow multiple leases for a single duid+iaid+subnet_id tuple
     Lease6Collection collection;
-    collection.push_back(Lease6Ptr(new Lease6(**lease)));
+    collection.push_back(lease->toLease());
+    return (collection);
+}
+
+Lease6Collection
+Memfile_LeaseMgr::getExpiredLeases6(size_t max_leases) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_MEMFILE_GET_EXPIRED6).arg(max_leases);
+    Mutex::Locker locker(mutex_);
+
+    // The leases are ordered by expiration time in the index #2.
+    typedef Lease6Storage::nth_index<2>::type SearchIndex;
+    const SearchIndex& idx = storage6_.get<2>();
+    const int64_t now = time(NULL);
+    Lease6Collection collection;
+    for (SearchIndex::const_iterator lease = idx.begin();
+         lease != idx.end() && lease->getExpirationTime() < now &&
+             (max_leases == 0 || collection.size() < max_leases); ++lease) {
+        collection.push_back(lease->toLease());
+    }
+
     return (collection);
 }
 
@@ -292,88 +470,142 @@ void
 Memfile_LeaseMgr::updateLease4(const Lease4Ptr& lease) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_UPDATE_ADDR4).arg(lease->addr_.toText());
+    const uint32_t addr = static_cast<uint32_t>(lease->addr_);
+    uint64_t sequence = 0;
+    {
+        Mutex::Locker locker(mutex_);
+        waitForChange4(addr);
+
+        Lease4Storage::iterator lease_it = storage4_.find(addr);
+        if (lease_it == storage4_.end()) {
+            bundy_throw(NoSuchLease, "failed to update the lease with "
+                        "address " << lease->addr_ << " - no such lease");
+        }
 
-    Lease4Storage::iterator lease_it = storage4_.find(lease->addr_);
-    if (lease_it == storage4_.end()) {
-        bundy_throw(NoSuchLease, "failed to update the lease with address "
-                  << lease->addr_ << " - no such lease");
-    }
-
-    // Try to write a lease to disk first. If this fails, the lease will
-    // not be inserted to the memory and the disk and in-memory data will
-    // remain consistent.
-    if (persistLeases(V4)) {
-        lease_file4_->append(*lease);
+        // Write the lease to disk (or queue it in the journal) first. If
+        // this fails, the lease will not be updated in the memory and the
+        // disk and in-memory data will remain consistent.
+        sequence = appendLease(*lease);
+        if (sequence == 0) {
+            // The lease is replaced so that the indexes, e.g. the
+            // expiration time one, are updated.
+            storage4_.replace(lease_it, PackedLease4(*lease));
+            return;
+        }
+        pending4_.insert(addr);
     }
-
-    **lease_it = *lease;
+    syncLease4(addr, sequence);
+    Mutex::Locker locker(mutex_);
+    endChange4(addr);
+    // The pending change kept the other threads from removing the lease.
+    storage4_.replace(storage4_.find(addr), PackedLease4(*lease));
 }
 
 void
 Memfile_LeaseMgr::updateLease6(const Lease6Ptr& lease) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_UPDATE_ADDR6).arg(lease->addr_.toText());
+    const Address6Key addr(lease->addr_);
+    uint64_t sequence = 0;
+    {
+        Mutex::Locker locker(mutex_);
+        waitForChange6(addr);
+
+        Lease6Storage::iterator lease_it = storage6_.find(addr);
+        if (lease_it == storage6_.end()) {
+            bundy_throw(NoSuchLease, "failed to update the lease with "
+                        "address " << lease->addr_ << " - no such lease");
+        }
 
-    Lease6Storage::iterator lease_it = storage6_.find(lease->addr_);
-    if (lease_it == storage6_.end()) {
-        bundy_throw(NoSuchLease, "failed to update the lease with address "
-                  << lease->addr_ << " - no such lease");
-    }
-
-    // Try to write a lease to disk first. If this fails, the lease will
-    // not be inserted to the memory and the disk and in-memory data will
-    // remain consistent.
-    if (persistLeases(V6)) {
-        lease_file6_->append(*lease);
+        // Write the lease to disk (or queue it in the journal) first. If
+        // this fails, the lease will not be updated in the memory and the
+        // disk and in-memory data will remain consistent.
+        sequence = appendLease(*lease);
+        if (sequence == 0) {
+            // The lease is replaced so that the indexes, e.g. the
+            // expiration time one, are updated.
+            storage6_.replace(lease_it, PackedLease6(*lease));
+            return;
+        }
+        pending6_.insert(addr);
     }
-
-    **lease_it = *lease;
+    syncLease6(addr, sequence);
+    Mutex::Locker locker(mutex_);
+    endChange6(addr);
+    // The pending change kept the other threads from removing the lease.
+    storage6_.replace(storage6_.find(addr), PackedLease6(*lease));
 }
 
 bool
 Memfile_LeaseMgr::deleteLease(const bundy::asiolink::IOAddress& addr) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MEMFILE_DELETE_ADDR).arg(addr.toText());
+    uint64_t sequence = 0;
     if (addr.isV4()) {
         // v4 lease
-        Lease4Storage::iterator l = storage4_.find(addr);
-        if (l == storage4_.end()) {
-            // No such lease
-            return (false);
-        } else {
+        const uint32_t addr4 = static_cast<uint32_t>(addr);
+        {
+            Mutex::Locker locker(mutex_);
+            waitForChange4(addr4);
+            Lease4Storage::iterator l = storage4_.find(addr4);
+            if (l == storage4_.end()) {
+                // No such lease
+                return (false);
+            }
             if (persistLeases(V4)) {
                 // Copy the lease. The valid lifetime needs to be modified and
                 // we don't modify the original lease.
-                Lease4 lease_copy = **l;
+                Lease4 lease_copy = *l->toLease();
                 // Setting valid lifetime to 0 means that lease is being
                 // removed.
                 lease_copy.valid_lft_ = 0;
-                lease_file4_->append(lease_copy);
+                sequence = appendLease(lease_copy);
             }
-            storage4_.erase(l);
-            return (true);
+            if (sequence == 0) {
+                storage4_.erase(l);
+                return (true);
+            }
+            pending4_.insert(addr4);
         }
+        // The lease is removed from the memory once the removal is written
+        // to the journal.
+        syncLease4(addr4, sequence);
+        Mutex::Locker locker(mutex_);
+        endChange4(addr4);
+        storage4_.erase(addr4);
+        return (true);
 
     } else {
         // v6 lease
-        Lease6Storage::iterator l = storage6_.find(addr);
-        if (l == storage6_.end()) {
-            // No such lease
-            return (false);
-        } else {
+        const Address6Key addr6(addr);
+        {
+            Mutex::Locker locker(mutex_);
+            waitForChange6(addr6);
+            Lease6Storage::iterator l = storage6_.find(addr6);
+            if (l == storage6_.end()) {
+                // No such lease
+                return (false);
+            }
             if (persistLeases(V6)) {
                 // Copy the lease. The lifetimes need to be modified and we
                 // don't modify the original lease.
-                Lease6 lease_copy = **l;
+                Lease6 lease_copy = *l->toLease();
                 // Setting lifetimes to 0 means that lease is being removed.
                 lease_copy.valid_lft_ = 0;
                 lease_copy.preferred_lft_ = 0;
-                lease_file6_->append(lease_copy);
+                sequence = appendLease(lease_copy);
             }
-
-            storage6_.erase(l);
-            return (true);
+            if (sequence == 0) {
+                storage6_.erase(l);
+                return (true);
+            }
+            pending6_.insert(addr6);
         }
+        syncLease6(addr6, sequence);
+        Mutex::Locker locker(mutex_);
+        endChange6(addr6);
+        storage6_.erase(addr6);
+        return (true);
     }
 }
 
@@ -400,12 +632,17 @@ Memfile_LeaseMgr::getDefaultLeaseFilePath(Universe u) const {
     std::ostringstream s;
     s << CfgMgr::instance().getDataDir() << "/kea-leases";
     s << (u == V4 ? "4" : "6");
-    s << ".csv";
+    s << (binary_ ? ".journal" : ".csv");
     return (s.str());
 }
 
 std::string
 Memfile_LeaseMgr::getLeaseFilePath(Universe u) const {
+    if (journal4_ || journal6_) {
+        const LeaseJournalPtr& journal = u == V4 ? journal4_ : journal6_;
+        return (journal ? journal->getFilename() : "");
+    }
+
     if (u == V4) {
         return (lease_file4_ ? lease_file4_->getFilename() : "");
     }
@@ -418,11 +655,171 @@ Memfile_LeaseMgr::persistLeases(Universe u) const {
     // Currently, if the lease file IO is not created, it means that writes to
     // disk have been explicitly disabled by the administrator. At some point,
     // there may be a dedicated ON/OFF flag implemented to control this.
-    if (u == V4 && lease_file4_) {
+    if (u == V4 && (lease_file4_ || journal4_)) {
         return (true);
     }
 
-    return (u == V6 && lease_file6_);
+    return (u == V6 && (lease_file6_ || journal6_));
+}
+
+void
+Memfile_LeaseMgr::compact() {
+    const LeaseJournalPtr& journal = journal4_ ? journal4_ : journal6_;
+    if (!journal) {
+        return;
+    }
+
+    // Another compaction would append to the journal being compacted
+    // before the snapshot including its leases is written.
+    Mutex::Locker compaction_locker(compaction_mutex_);
+    std::vector<PackedLease4> leases4;
+    std::vector<PackedLease6> leases6;
+    {
+        Mutex::Locker locker(mutex_);
+        if (journal->getLength() == 0 && !journal->compactionPending()) {
+            return;
+        }
+        // The records of the changes being written would go away with the
+        // rotated journal before the changes are in the copy, so they are
+        // waited for, and the new changes wait until the copy is done.
+        draining_ = true;
+        try {
+            while (!pending4_.empty() || !pending6_.empty()) {
+                changed_.wait(mutex_);
+            }
+            // The leases are only copied with the lock held, they are
+            // encoded after it is released.
+            leases4.assign(storage4_.begin(), storage4_.end());
+            leases6.assign(storage6_.begin(), storage6_.end());
+            // The journal holds the changes made after the copy.
+            journal->rotate();
+        } catch (...) {
+            draining_ = false;
+            changed_.broadcast();
+            throw;
+        }
+        draining_ = false;
+        changed_.broadcast();
+    }
+
+    OutputBuffer records(0);
+    for (std::vector<PackedLease4>::const_iterator lease = leases4.begin();
+         lease != leases4.end(); ++lease) {
+        LeaseJournal::encode(*lease->toLease(), records);
+    }
+    for (std::vector<PackedLease6>::const_iterator lease = leases6.begin();
+         lease != leases6.end(); ++lease) {
+        LeaseJournal::encode(*lease->toLease(), records);
+    }
+    journal->writeSnapshot(records);
+    LOG_INFO(dhcpsrv_logger, DHCPSRV_MEMFILE_COMPACTED)
+        .arg(journal->getFilename()).arg(leases4.size() + leases6.size());
+}
+
+void
+Memfile_LeaseMgr::compactionLoop() {
+    for (;;) {
+        {
+            Mutex::Locker locker(stop_mutex_);
+            if (!stopping_) {
+                stop_cond_.timedWait(stop_mutex_, compact_interval_ * 1000);
+            }
+            if (stopping_) {
+                return;
+            }
+        }
+        try {
+            compact();
+        } catch (const std::exception& ex) {
+            LOG_ERROR(dhcpsrv_logger, DHCPSRV_MEMFILE_COMPACT_FAIL)
+                .arg(journal4_ ? journal4_->getFilename() :
+                     journal6_->getFilename())
+                .arg(ex.what());
+        }
+    }
+}
+
+uint64_t
+Memfile_LeaseMgr::appendLease(const Lease4& lease) {
+    if (journal4_) {
+        return (journal4_->append(lease));
+    }
+    if (lease_file4_) {
+        lease_file4_->append(lease);
+    }
+    return (0);
+}
+
+uint64_t
+Memfile_LeaseMgr::appendLease(const Lease6& lease) {
+    if (journal6_) {
+        return (journal6_->append(lease));
+    }
+    if (lease_file6_) {
+        lease_file6_->append(lease);
+    }
+    return (0);
+}
+
+void
+Memfile_LeaseMgr::waitForChange4(uint32_t addr) {
+    while (draining_ || pending4_.count(addr) > 0) {
+        changed_.wait(mutex_);
+    }
+}
+
+void
+Memfile_LeaseMgr::waitForChange6(const Address6Key& addr) {
+    while (draining_ || pending6_.count(addr) > 0) {
+        changed_.wait(mutex_);
+    }
+}
+
+void
+Memfile_LeaseMgr::endChange4(uint32_t addr) {
+    pending4_.erase(addr);
+    changed_.broadcast();
+}
+
+void
+Memfile_LeaseMgr::endChange6(const Address6Key& addr) {
+    pending6_.erase(addr);
+    changed_.broadcast();
+}
+
+void
+Memfile_LeaseMgr::syncLease4(uint32_t addr, uint64_t sequence) {
+    try {
+        journal4_->sync(sequence);
+    } catch (...) {
+        // The change is dropped: the lease remains as it was in memory.
+        Mutex::Locker locker(mutex_);
+        endChange4(addr);
+        throw;
+    }
+}
+
+void
+Memfile_LeaseMgr::syncLease6(const Address6Key& addr, uint64_t sequence) {
+    try {
+        journal6_->sync(sequence);
+    } catch (...) {
+        // The change is dropped: the lease remains as it was in memory.
+        Mutex::Locker locker(mutex_);
+        endChange6(addr);
+        throw;
+    }
+}
+
+std::string
+Memfile_LeaseMgr::getOptionalParameter(const std::string& name,
+                                       const std::string& default_value)
+    const {
+    try {
+        return (getParameter(name));
+    } catch (const Exception&) {
+        return (default_value);
+    }
 }
 
 std::string
@@ -463,12 +860,19 @@ Memfile_LeaseMgr::load4() {
     }
 
     LOG_INFO(dhcpsrv_logger, DHCPSRV_MEMFILE_LEASES_RELOAD4)
-        .arg(lease_file4_->getFilename());
+        .arg(getLeaseFilePath(V4));
 
     // Remove existing leases (if any). We will recreate them based on the
     // data on disk.
     storage4_.clear();
 
+    if (journal4_) {
+        // A lease of the other universe is an error.
+        journal4_->load(boost::bind(&Memfile_LeaseMgr::loadLease4, this, _1),
+                        LeaseJournal::Lease6Handler());
+        return;
+    }
+
     Lease4Ptr lease;
     do {
         /// @todo Currently we stop parsing on first failure. It is possible
@@ -493,14 +897,14 @@ Memfile_LeaseMgr::load4() {
 void
 Memfile_LeaseMgr::loadLease4(Lease4Ptr& lease) {
     // Check if the lease already exists.
-    Lease4Storage::iterator lease_it = storage4_.find(lease->addr_);
+    Lease4Storage::iterator lease_it = storage4_.find(static_cast<uint32_t>(lease->addr_));
     // Lease doesn't exist.
     if (lease_it == storage4_.end()) {
         // Add the lease only if valid lifetime is greater than 0.
         // We use valid lifetime of 0 to indicate that lease should
         // be removed.
         if (lease->valid_lft_ > 0) {
-           storage4_.insert(lease);
+           storage4_.insert(PackedLease4(*lease));
        }
     } else {
         // We use valid lifetime of 0 to indicate that the lease is
@@ -510,7 +914,7 @@ Memfile_LeaseMgr::loadLease4(Lease4Ptr& lease) {
 
         } else {
             // Update existing lease.
-            **lease_it = *lease;
+            storage4_.replace(lease_it, PackedLease4(*lease));
         }
     }
 }
@@ -524,12 +928,19 @@ Memfile_LeaseMgr::load6() {
     }
 
     LOG_INFO(dhcpsrv_logger, DHCPSRV_MEMFILE_LEASES_RELOAD6)
-        .arg(lease_file6_->getFilename());
+        .arg(getLeaseFilePath(V6));
 
     // Remove existing leases (if any). We will recreate them based on the
     // data on disk.
     storage6_.clear();
 
+    if (journal6_) {
+        // A lease of the other universe is an error.
+        journal6_->load(LeaseJournal::Lease4Handler(),
+                        boost::bind(&Memfile_LeaseMgr::loadLease6, this, _1));
+        return;
+    }
+
     Lease6Ptr lease;
     do {
         /// @todo Currently we stop parsing on first failure. It is possible
@@ -555,14 +966,14 @@ Memfile_LeaseMgr::load6() {
 void
 Memfile_LeaseMgr::loadLease6(Lease6Ptr& lease) {
     // Check if the lease already exists.
-    Lease6Storage::iterator lease_it = storage6_.find(lease->addr_);
+    Lease6Storage::iterator lease_it = storage6_.find(Address6Key(lease->addr_));
     // Lease doesn't exist.
     if (lease_it == storage6_.end()) {
         // Add the lease only if valid lifetime is greater than 0.
         // We use valid lifetime of 0 to indicate that lease should
         // be removed.
         if (lease->valid_lft_ > 0) {
-            storage6_.insert(lease);
+            storage6_.insert(PackedLease6(*lease));
        }
     } else {
         // We use valid lifetime of 0 to indicate that the lease is
@@ -572,7 +983,7 @@ Memfile_LeaseMgr::loadLease6(Lease6Ptr& lease) {
 
         } else {
             // Update existing lease.
-            **lease_it = *lease;
+            storage6_.replace(lease_it, PackedLease6(*lease));
         }
     }
 
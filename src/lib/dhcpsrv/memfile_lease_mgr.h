@@ -18,13 +18,22 @@
 #include <dhcp/hwaddr.h>
 #include <dhcpsrv/csv_lease_file4.h>
 #include <dhcpsrv/csv_lease_file6.h>
+#include <dhcpsrv/identifier_key.h>
+#include <dhcpsrv/packed_lease.h>
+#include <dhcpsrv/lease_journal.h>
 #include <dhcpsrv/lease_mgr.h>
+#include <util/threads/sync.h>
+#include <util/threads/thread.h>
 
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/indexed_by.hpp>
-#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <set>
 
 namespace bundy {
 namespace dhcp {
@@ -68,6 +77,26 @@ namespace dhcp {
 /// is not specified, the default location in the installation
 /// directory is used: var/bundy/kea-leases4.csv and
 /// var/bundy/kea-leases6.csv.
+///
+/// With the "format=binary" parameter, the leases are written to a binary
+/// journal (see @c LeaseJournal) rather than to a CSV file, and the default
+/// file names end with ".journal".  The records of the journal are written
+/// and synchronized to disk by the threads which changed the leases after
+/// they released the lock of the backend, several at once, so the writes
+/// don't serialize the threads.  The "fsync=true|false" parameter (true by
+/// default) specifies if the journal is fsync'ed before a change of a lease
+/// returns.  A change is applied in memory only once its record is written,
+/// and the other changes of the same lease wait until then, so the other
+/// threads never see a lease which could be lost.  If the record can't be
+/// written, the change is dropped and an exception is thrown, which the
+/// server handles as it handles any database error.
+///
+/// A background thread compacts the journal every "compact-interval"
+/// seconds (3600 by default, 0 disables the thread): it writes a snapshot
+/// of all the leases and removes the previous records of the journal.  The
+/// compaction can also be done by calling @c compact.  On startup, the
+/// leases are loaded from the snapshot and the records of the journal
+/// written after it.
 class Memfile_LeaseMgr : public LeaseMgr {
 public:
 
@@ -178,6 +207,20 @@ public:
     virtual Lease4Ptr getLease4(const ClientId& clientid,
                                 SubnetID subnet_id) const;
 
+    /// @brief Returns existing IPv4 leases for a range of addresses
+    ///
+    /// This function returns copies of the leases. The modification in the
+    /// return leases does not affect the instances held in the lease storage.
+    ///
+    /// @param lower the first address of the range
+    /// @param upper the last address of the range
+    ///
+    /// @return lease collection ordered by address (may be empty if no
+    /// lease is found)
+    virtual Lease4Collection getLeases4(const bundy::asiolink::IOAddress& lower,
+                                        const bundy::asiolink::IOAddress& upper)
+        const;
+
     /// @brief Returns existing IPv6 lease for a given IPv6 address.
     ///
     /// This function returns a copy of the lease. The modification in the
@@ -216,6 +259,28 @@ public:
     virtual Lease6Collection getLeases6(Lease::Type type, const DUID& duid,
                                         uint32_t iaid, SubnetID subnet_id) const;
 
+    /// @brief Returns expired IPv4 leases.
+    ///
+    /// This function returns copies of the leases. The modification in the
+    /// return leases does not affect the instances held in the lease storage.
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    virtual Lease4Collection getExpiredLeases4(size_t max_leases) const;
+
+    /// @brief Returns expired IPv6 leases.
+    ///
+    /// This function returns copies of the leases. The modification in the
+    /// return leases does not affect the instances held in the lease storage.
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    virtual Lease6Collection getExpiredLeases6(size_t max_leases) const;
+
     /// @brief Updates IPv4 lease.
     ///
     /// @warning This function does not validate the pointer to the lease.
@@ -315,6 +380,17 @@ public:
     /// server shut down.
     bool persistLeases(Universe u) const;
 
+    /// @brief Compacts the lease journal.
+    ///
+    /// A snapshot of all the leases is written and the previous records
+    /// of the journal are removed.  The leases are locked only while they
+    /// are copied, the snapshot is written without the lock.  This does
+    /// nothing if the leases are not written to a binary journal, or if
+    /// the journal has no record since the last compaction.
+    ///
+    /// @throw bundy::DbOperationError if a file operation fails.
+    void compact();
+
 protected:
 
     /// @brief Load all DHCPv4 leases from the file.
@@ -380,34 +456,111 @@ protected:
     /// argument to this function.
     std::string initLeaseFilePath(Universe u);
 
+    /// @brief Returns the value of a parameter or a default value if the
+    /// parameter is not specified.
+    std::string getOptionalParameter(const std::string& name,
+                                     const std::string& default_value) const;
+
+    /// @brief Writes an IPv4 lease to the lease file or queues it in the
+    /// journal.
+    ///
+    /// The mutex must be locked.
+    ///
+    /// @return the sequence number to pass to @c syncLease4, or 0 if there
+    /// is nothing to synchronize.
+    uint64_t appendLease(const Lease4& lease);
+
+    /// @brief Writes an IPv6 lease to the lease file or queues it in the
+    /// journal.
+    ///
+    /// @return the sequence number to pass to @c syncLease6, or 0 if there
+    /// is nothing to synchronize.
+    uint64_t appendLease(const Lease6& lease);
+
+    /// @brief Waits until an IPv4 lease can be changed.
+    ///
+    /// The mutex must be locked.  It is released while another change of
+    /// the lease is being written to the journal or a compaction copies
+    /// the leases.
+    ///
+    /// @param addr the address of the lease.
+    void waitForChange4(uint32_t addr);
+
+    /// @brief Waits until an IPv6 lease can be changed.
+    ///
+    /// @param addr the address of the lease.
+    void waitForChange6(const Address6Key& addr);
+
+    /// @brief Finishes the change of an IPv4 lease queued in the journal.
+    ///
+    /// The mutex must be locked.  The threads waiting for the lease are
+    /// woken up.
+    ///
+    /// @param addr the address of the lease.
+    void endChange4(uint32_t addr);
+
+    /// @brief Finishes the change of an IPv6 lease queued in the journal.
+    ///
+    /// @param addr the address of the lease.
+    void endChange6(const Address6Key& addr);
+
+    /// @brief Waits until an IPv4 lease queued in the journal is written.
+    ///
+    /// The mutex must not be locked, so the other threads can queue their
+    /// leases meanwhile.  If the record can't be written, the change is
+    /// finished before the exception is rethrown.
+    ///
+    /// @param addr the address of the lease.
+    /// @param sequence the sequence number returned by @c appendLease.
+    /// @throw DbOperationError if the record couldn't be written.
+    void syncLease4(uint32_t addr, uint64_t sequence);
+
+    /// @brief Waits until an IPv6 lease queued in the journal is written.
+    ///
+    /// @param addr the address of the lease.
+    /// @param sequence the sequence number returned by @c appendLease.
+    /// @throw DbOperationError if the record couldn't be written.
+    void syncLease6(const Address6Key& addr, uint64_t sequence);
+
+    /// @brief The main function of the compaction thread.
+    void compactionLoop();
+
     // This is a multi-index container, which holds elements that can
     // be accessed using different search indexes.
     typedef boost::multi_index_container<
-        // It holds pointers to Lease6 objects.
-        Lease6Ptr,
+        // It holds the leases in their compact form.
+        PackedLease6,
         boost::multi_index::indexed_by<
             // Specification of the first index starts here.
-            // This index sorts leases by IPv6 addresses represented as
-            // IOAddress objects.
+            // This index sorts leases by IPv6 addresses.
             boost::multi_index::ordered_unique<
-                boost::multi_index::member<Lease, bundy::asiolink::IOAddress, &Lease::addr_>
+                boost::multi_index::const_mem_fun<PackedLease6, Address6Key,
+                                                  &PackedLease6::getAddress>
             >,
 
             // Specification of the second index starts here.
-            boost::multi_index::ordered_unique<
+            boost::multi_index::hashed_unique<
                 // This is a composite index that will be used to search for
                 // the lease using three attributes: DUID, IAID, Subnet Id.
                 boost::multi_index::composite_key<
-                    Lease6,
-                    // The DUID can be retrieved from the Lease6 object using
-                    // a getDuidVector const function.
-                    boost::multi_index::const_mem_fun<Lease6, const std::vector<uint8_t>&,
-                                                      &Lease6::getDuidVector>,
-                    // The two other ingredients of this index are IAID and
-                    // subnet id.
-                    boost::multi_index::member<Lease6, uint32_t, &Lease6::iaid_>,
-                    boost::multi_index::member<Lease, SubnetID, &Lease::subnet_id_>
+                    PackedLease6,
+                    // The key of the DUID points to the DUID of the lease,
+                    // so it is not copied.
+                    boost::multi_index::const_mem_fun<
+                        PackedLease6, IdentifierKey, &PackedLease6::getDuidKey>,
+                    boost::multi_index::const_mem_fun<PackedLease6, uint32_t,
+                                                      &PackedLease6::getIaid>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease6, SubnetID, &PackedLease6::getSubnetId>
                 >
+            >,
+
+            // Specification of the third index starts here.
+            // This index sorts leases by expiration time, to find the
+            // expired leases.
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::const_mem_fun<
+                    PackedLease6, int64_t, &PackedLease6::getExpirationTime>
             >
         >
      > Lease6Storage; // Specify the type name of this container.
@@ -415,73 +568,99 @@ protected:
     // This is a multi-index container, which holds elements that can
     // be accessed using different search indexes.
     typedef boost::multi_index_container<
-        // It holds pointers to Lease4 objects.
-        Lease4Ptr,
+        // It holds the leases in their compact form.
+        PackedLease4,
         // Specification of search indexes starts here.
         boost::multi_index::indexed_by<
             // Specification of the first index starts here.
-            // This index sorts leases by IPv4 addresses represented as
-            // IOAddress objects.
+            // This index sorts leases by IPv4 addresses.
             boost::multi_index::ordered_unique<
-                // The IPv4 address are held in addr_ members that belong to
-                // Lease class.
-                boost::multi_index::member<Lease, bundy::asiolink::IOAddress, &Lease::addr_>
+                boost::multi_index::const_mem_fun<PackedLease4, uint32_t,
+                                                  &PackedLease4::getAddress>
             >,
 
             // Specification of the second index starts here.
-            boost::multi_index::ordered_unique<
-                // This is a composite index that combines two attributes of the
-                // Lease4 object: hardware address and subnet id.
+            boost::multi_index::hashed_unique<
+                // This is a composite index that combines two attributes of
+                // the lease: hardware address and subnet id.
                 boost::multi_index::composite_key<
-                    Lease4,
-                    // The hardware address is held in the hwaddr_ member of the
-                    // Lease4 object.
-                    boost::multi_index::member<Lease4, std::vector<uint8_t>,
-                                               &Lease4::hwaddr_>,
-                    // The subnet id is held in the subnet_id_ member of Lease4
-                    // class. Note that the subnet_id_ is defined in the base
-                    // class (Lease) so we have to point to this class rather
-                    // than derived class: Lease4.
-                    boost::multi_index::member<Lease, SubnetID, &Lease::subnet_id_>
+                    PackedLease4,
+                    // The key of the hardware address points to the
+                    // hardware address of the lease, so it is not copied.
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getHWAddrKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, SubnetID, &PackedLease4::getSubnetId>
                 >
             >,
 
             // Specification of the third index starts here.
-            boost::multi_index::ordered_non_unique<
+            boost::multi_index::hashed_non_unique<
                 // This is a composite index that uses two values to search for a
                 // lease: client id and subnet id.
                 boost::multi_index::composite_key<
-                    Lease4,
-                    // The client id can be retrieved from the Lease4 object by
-                    // calling getClientIdVector const function.
-                    boost::multi_index::const_mem_fun<Lease4, const std::vector<uint8_t>&,
-                                                      &Lease4::getClientIdVector>,
-                    // The subnet id is accessed through the subnet_id_ member.
-                    boost::multi_index::member<Lease, uint32_t, &Lease::subnet_id_>
+                    PackedLease4,
+                    // The key of the client id is empty if the lease has
+                    // none.
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getClientIdKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, SubnetID, &PackedLease4::getSubnetId>
                 >
             >,
 
             // Specification of the fourth index starts here.
-            boost::multi_index::ordered_non_unique<
-                // This is a composite index that uses two values to search for a
-                // lease: client id and subnet id.
+            boost::multi_index::hashed_non_unique<
+                // This is a composite index that uses three values to search
+                // for a lease: client id, hardware address and subnet id.
                 boost::multi_index::composite_key<
-                    Lease4,
-                    // The client id can be retrieved from the Lease4 object by
-                    // calling getClientIdVector const function.
-                    boost::multi_index::const_mem_fun<Lease4, const std::vector<uint8_t>&,
-                                                      &Lease4::getClientIdVector>,
-                    // The hardware address is held in the hwaddr_ member of the
-                    // Lease4 object.
-                    boost::multi_index::member<Lease4, std::vector<uint8_t>,
-                                               &Lease4::hwaddr_>,
-                    // The subnet id is accessed through the subnet_id_ member.
-                    boost::multi_index::member<Lease, SubnetID, &Lease::subnet_id_>
+                    PackedLease4,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getClientIdKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, IdentifierKey,
+                        &PackedLease4::getHWAddrKey>,
+                    boost::multi_index::const_mem_fun<
+                        PackedLease4, SubnetID, &PackedLease4::getSubnetId>
                 >
+            >,
+
+            // Specification of the fifth index starts here.
+            // This index sorts leases by expiration time, to find the
+            // expired leases.
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::const_mem_fun<
+                    PackedLease4, int64_t, &PackedLease4::getExpirationTime>
+            >,
+
+            // Specification of the sixth index starts here.
+            // This index finds the leases of a hardware address, in all
+            // the subnets.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::const_mem_fun<PackedLease4, IdentifierKey,
+                                                  &PackedLease4::getHWAddrKey>
+            >,
+
+            // Specification of the seventh index starts here.
+            // This index finds the leases of a client id, in all the
+            // subnets.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::const_mem_fun<
+                    PackedLease4, IdentifierKey, &PackedLease4::getClientIdKey>
             >
         >
     > Lease4Storage; // Specify the type name for this container.
 
+    /// @brief Protects the lease containers and the lease files.
+    ///
+    /// The DHCP servers can process packets in several threads which share
+    /// a single instance of this backend, so every operation on the
+    /// leases is done with this mutex locked.
+    mutable bundy::util::thread::Mutex mutex_;
+
     /// @brief stores IPv4 leases
     Lease4Storage storage4_;
 
@@ -494,6 +673,44 @@ protected:
     /// @brief Holds the pointer to the DHCPv6 lease file IO.
     boost::shared_ptr<CSVLeaseFile6> lease_file6_;
 
+    /// @brief The DHCPv4 lease journal (in binary format).
+    LeaseJournalPtr journal4_;
+
+    /// @brief The DHCPv6 lease journal (in binary format).
+    LeaseJournalPtr journal6_;
+
+    /// @brief Do the leases go to a binary journal rather than a CSV file?
+    bool binary_;
+
+    /// @brief The addresses of the leases whose change is being written to
+    /// the journal, protected by @c mutex_.
+    std::set<uint32_t> pending4_;
+    std::set<Address6Key> pending6_;
+
+    /// @brief Set while a compaction waits for the changes being written
+    /// and copies the leases, protected by @c mutex_.
+    bool draining_;
+
+    /// @brief Signaled when a change is finished or a compaction has copied
+    /// the leases.
+    bundy::util::thread::CondVar changed_;
+
+    /// @brief Serializes the compactions.
+    bundy::util::thread::Mutex compaction_mutex_;
+
+    /// @brief The interval between compactions (in seconds).
+    size_t compact_interval_;
+
+    /// @brief The thread compacting the journal periodically.
+    boost::scoped_ptr<bundy::util::thread::Thread> compaction_thread_;
+
+    /// @brief Set when the compaction thread must stop, protected by
+    /// @c stop_mutex_.
+    bool stopping_;
+    bundy::util::thread::Mutex stop_mutex_;
+
+    /// @brief Signaled when the compaction thread must stop.
+    bundy::util::thread::CondVar stop_cond_;
 };
 
 }; // end of bundy::dhcp namespace
@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -19,18 +19,28 @@
 #include <dhcp/hwaddr.h>
 #include <dhcpsrv/dhcpsrv_log.h>
 #include <dhcpsrv/mysql_lease_mgr.h>
+#include <dhcpsrv/pending_leases.h>
+#include <util/threads/sync.h>
+#include <util/threads/thread.h>
 
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/static_assert.hpp>
+#include <boost/weak_ptr.hpp>
 #include <mysqld_error.h>
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <time.h>
 
 using namespace bundy;
+using namespace bundy::asiolink;
 using namespace bundy::dhcp;
+using namespace bundy::util::thread;
 using namespace std;
 
 /// @file
@@ -74,6 +84,12 @@ using namespace std;
 /// - Execute the statement.
 /// - If there is output, copy the data from the bound variables to the output
 ///   lease object.
+///
+/// In the write-behind mode, the leases written are queued in a
+/// bundy::dhcp::MySqlWriteQueue instead, and the queries merge the queued
+/// leases with the leases of the database.  The queue writes the leases with
+/// statements inserting, updating or deleting many leases at once, which are
+/// prepared when first used for a number of leases.
 
 namespace {
 ///@{
@@ -145,6 +161,13 @@ TaggedStatement tagged_statements[] = {
                         "fqdn_fwd, fqdn_rev, hostname "
                             "FROM lease4 "
                             "WHERE client_id = ? AND subnet_id = ?"},
+    {MySqlLeaseMgr::GET_LEASE4_EXPIRE,
+                    "SELECT address, hwaddr, client_id, "
+                        "valid_lifetime, expire, subnet_id, "
+                        "fqdn_fwd, fqdn_rev, hostname "
+                            "FROM lease4 "
+                            "WHERE expire < ? "
+                            "ORDER BY expire LIMIT ?"},
     {MySqlLeaseMgr::GET_LEASE4_HWADDR,
                     "SELECT address, hwaddr, client_id, "
                         "valid_lifetime, expire, subnet_id, "
@@ -157,6 +180,13 @@ TaggedStatement tagged_statements[] = {
                         "fqdn_fwd, fqdn_rev, hostname "
                             "FROM lease4 "
                             "WHERE hwaddr = ? AND subnet_id = ?"},
+    {MySqlLeaseMgr::GET_LEASE4_RANGE,
+                    "SELECT address, hwaddr, client_id, "
+                        "valid_lifetime, expire, subnet_id, "
+                        "fqdn_fwd, fqdn_rev, hostname "
+                            "FROM lease4 "
+                            "WHERE address BETWEEN ? AND ? "
+                            "ORDER BY address"},
     {MySqlLeaseMgr::GET_LEASE6_ADDR,
                     "SELECT address, duid, valid_lifetime, "
                         "expire, subnet_id, pref_lifetime, "
@@ -179,6 +209,14 @@ TaggedStatement tagged_statements[] = {
                             "FROM lease6 "
                             "WHERE duid = ? AND iaid = ? AND subnet_id = ? "
                             "AND lease_type = ?"},
+    {MySqlLeaseMgr::GET_LEASE6_EXPIRE,
+                    "SELECT address, duid, valid_lifetime, "
+                        "expire, subnet_id, pref_lifetime, "
+                        "lease_type, iaid, prefix_len, "
+                        "fqdn_fwd, fqdn_rev, hostname "
+                            "FROM lease6 "
+                            "WHERE expire < ? "
+                            "ORDER BY expire LIMIT ?"},
     {MySqlLeaseMgr::GET_VERSION,
                     "SELECT version, minor FROM schema_version"},
     {MySqlLeaseMgr::INSERT_LEASE4,
@@ -209,6 +247,65 @@ TaggedStatement tagged_statements[] = {
     {MySqlLeaseMgr::NUM_STATEMENTS, NULL}
 };
 
+/// @brief Columns of the lease tables
+///
+/// The columns written by the batch statements, in the order of the
+/// parameters of the exchange objects.  The address (the primary key) is
+/// first.
+const char* const LEASE4_COLUMNS[] = {
+    "address", "hwaddr", "client_id", "valid_lifetime", "expire",
+    "subnet_id", "fqdn_fwd", "fqdn_rev", "hostname", NULL
+};
+const char* const LEASE6_COLUMNS[] = {
+    "address", "duid", "valid_lifetime", "expire", "subnet_id",
+    "pref_lifetime", "lease_type", "iaid", "prefix_len", "fqdn_fwd",
+    "fqdn_rev", "hostname", NULL
+};
+
+/// @brief Write-behind defaults
+///
+/// Maximum number of leases queued, maximum number of leases per batch
+/// statement and time in milliseconds the leases are kept in the queue.
+const size_t WRITE_BEHIND_QUEUE = 10000;
+const size_t WRITE_BEHIND_BATCH = 100;
+const size_t WRITE_BEHIND_DELAY = 10;
+
+/// @brief Maximum number of leases per batch statement
+///
+/// A prepared statement has at most 65535 parameters.
+const size_t WRITE_BEHIND_MAX_BATCH = 1000;
+
+/// @brief Time in milliseconds before writing again after an error
+const size_t WRITE_BEHIND_RETRY_DELAY = 1000;
+
+/// @brief Returns a numeric parameter of the write-behind mode
+///
+/// @param parameters Parameters of the lease manager.
+/// @param name Name of the parameter.
+/// @param default_value Value if the parameter is not given.
+/// @param min_value Minimum value.
+///
+/// @throw BadValue The value is not a number or is lower than the minimum.
+size_t
+getSizeParameter(const LeaseMgr::ParameterMap& parameters,
+                 const std::string& name, size_t default_value,
+                 size_t min_value) {
+    LeaseMgr::ParameterMap::const_iterator param = parameters.find(name);
+    if (param == parameters.end()) {
+        return (default_value);
+    }
+    try {
+        const size_t value = boost::lexical_cast<size_t>(param->second);
+        if (value >= min_value) {
+            return (value);
+        }
+    } catch (const boost::bad_lexical_cast&) {
+        // Reported below.
+    }
+    bundy_throw(BadValue, "invalid value '" << name << "="
+                << param->second << "'");
+}
+
 };  // Anonymous namespace
 
 
@@ -1099,6 +1196,348 @@ private:
     MYSQL_STMT*     statement_;     ///< Statement for which results are freed
 };
 
+namespace {
+
+/// @brief Orders IPv4 leases by address
+struct AddressLess {
+    bool operator()(const Lease4Ptr& first, const Lease4Ptr& second) const {
+        return (first->addr_ < second->addr_);
+    }
+};
+
+/// @brief Orders leases by expiration time
+struct ExpirationLess {
+    template <typename LeasePtr>
+    bool operator()(const LeasePtr& first, const LeasePtr& second) const {
+        return (first->getExpirationTime() < second->getExpirationTime());
+    }
+};
+
+/// @brief The write-behind queues, by parameters of the lease managers
+typedef std::map<std::string, boost::weak_ptr<MySqlWriteQueue> >
+    WriteQueueMap;
+WriteQueueMap write_queues;
+
+/// @brief Protects the map of the write-behind queues
+Mutex write_queues_mutex;
+
+}  // Anonymous namespace
+
+/// @brief Queue of the lease writes of the write-behind mode
+///
+/// The queue holds the last state of each address written, in a
+/// bundy::dhcp::PendingLeases.  Each write is numbered, so the entries
+/// written to the database can be told apart from those changed while they
+/// were written.
+///
+/// A thread takes all the entries, writes them in one transaction with a
+/// lease manager (and database connection) of its own and removes them
+/// from the queue.  It waits @c delay_ milliseconds for the entries to
+/// accumulate, unless a batch is full, the queue is full or a commit is
+/// waiting.  On error, the entries stay queued and are written again after
+/// a second.
+///
+/// The leases returned to the callers are copies, so they may be changed.
+class MySqlWriteQueue : public boost::noncopyable {
+public:
+    /// @brief Constructor
+    ///
+    /// Opens the database and starts the thread.
+    ///
+    /// @param parameters Parameters of the lease managers.
+    ///
+    /// @throw BadValue A parameter of the write-behind mode is invalid.
+    MySqlWriteQueue(const LeaseMgr::ParameterMap& parameters) :
+        max_size_(getSizeParameter(parameters, "write-behind-queue",
+                                   WRITE_BEHIND_QUEUE, 1)),
+        batch_size_(getSizeParameter(parameters, "write-behind-batch",
+                                     WRITE_BEHIND_BATCH, 1)),
+        delay_(getSizeParameter(parameters, "write-behind-delay",
+                                WRITE_BEHIND_DELAY, 0)),
+        queued_(0), written_(0), failed_(0), waiting_(0), stopping_(false)
+    {
+        if (batch_size_ > WRITE_BEHIND_MAX_BATCH) {
+            bundy_throw(BadValue, "invalid value 'write-behind-batch="
+                        << batch_size_ << "', the maximum is "
+                        << WRITE_BEHIND_MAX_BATCH);
+        }
+
+        LeaseMgr::ParameterMap writer_parameters(parameters);
+        writer_parameters["write-behind"] = "false";
+        lease_mgr_.reset(new MySqlLeaseMgr(writer_parameters));
+
+        thread_.reset(new Thread(boost::bind(&MySqlWriteQueue::run, this)));
+    }
+
+    /// @brief Destructor
+    ///
+    /// Writes the queued leases and stops the thread.  If they can't be
+    /// written, they are lost.
+    ~MySqlWriteQueue() {
+        {
+            Mutex::Locker lock(mutex_);
+            stopping_ = true;
+            wake_.signal();
+        }
+        thread_->wait();
+    }
+
+    /// @brief Returns the queue of the lease managers with the parameters
+    ///
+    /// The queue is created if there is none.
+    static boost::shared_ptr<MySqlWriteQueue>
+    get(const LeaseMgr::ParameterMap& parameters) {
+        std::string key;
+        for (LeaseMgr::ParameterMap::const_iterator param = parameters.begin();
+             param != parameters.end(); ++param) {
+            key += param->first + "=" + param->second + " ";
+        }
+
+        Mutex::Locker lock(write_queues_mutex);
+        boost::shared_ptr<MySqlWriteQueue> queue = write_queues[key].lock();
+        if (!queue) {
+            queue.reset(new MySqlWriteQueue(parameters));
+            write_queues[key] = queue;
+            LOG_INFO(dhcpsrv_logger, DHCPSRV_MYSQL_WRITE_BEHIND)
+                .arg(queue->max_size_).arg(queue->batch_size_)
+                .arg(queue->delay_);
+        }
+        return (queue);
+    }
+
+    /// @brief Returns the queued lease of an address
+    ///
+    /// @param addr The address.
+    /// @param [out] lease A copy of the queued lease, null if the lease was
+    ///        deleted.
+    ///
+    /// @return true if the address is queued, else the database has the
+    ///         lease of the address (if any).
+    template <typename LeasePtr>
+    bool find(const IOAddress& addr, LeasePtr& lease) const {
+        Mutex::Locker lock(mutex_);
+        return (entries_.find(addr, lease));
+    }
+
+    /// @brief Merges the queued leases with leases of the database
+    ///
+    /// Only the queued leases matching the query are looked at, through
+    /// the indexes of the queue.
+    ///
+    /// @param [in,out] leases The leases of the database matching a query.
+    /// @param match The query, see bundy::dhcp::PendingLeases::merge.
+    template <typename LeasePtr, typename Match>
+    void merge(std::vector<LeasePtr>& leases, const Match& match) const {
+        Mutex::Locker lock(mutex_);
+        entries_.merge(leases, match);
+    }
+
+    /// @brief Merges the queued leases with a lease of the database
+    ///
+    /// @param [in,out] lease The lease of the database matching a query
+    ///        (null if none), replaced by the first matching queued lease if
+    ///        its address is queued.
+    /// @param match The query, see bundy::dhcp::PendingLeases::merge.
+    template <typename LeasePtr, typename Match>
+    void mergeSingle(LeasePtr& lease, const Match& match) const {
+        Mutex::Locker lock(mutex_);
+        entries_.mergeSingle(lease, match);
+    }
+
+    /// @brief Queues a new lease
+    ///
+    /// @param lease The lease, which must not be in the database.
+    ///
+    /// @return false if a lease of the address is queued already.
+    ///
+    /// @throw DbOperationError The queue is full and can't be written.
+    template <typename LeasePtr>
+    bool add(const LeasePtr& lease) {
+        Mutex::Locker lock(mutex_);
+        LeasePtr queued;
+        if (entries_.find(lease->addr_, queued) && queued) {
+            return (false);
+        }
+        queue(lease->addr_, lease);
+        return (true);
+    }
+
+    /// @brief Queues an updated lease
+    ///
+    /// @throw DbOperationError The queue is full and can't be written.
+    template <typename LeasePtr>
+    void update(const LeasePtr& lease) {
+        Mutex::Locker lock(mutex_);
+        queue(lease->addr_, lease);
+    }
+
+    /// @brief Queues the deletion of the lease of an address
+    ///
+    /// @throw DbOperationError The queue is full and can't be written.
+    void remove(const IOAddress& addr) {
+        Mutex::Locker lock(mutex_);
+        queue(addr, Lease4Ptr());
+    }
+
+    /// @brief Waits until the leases queued so far are written
+    ///
+    /// @throw DbOperationError The leases couldn't be written.
+    void wait() {
+        Mutex::Locker lock(mutex_);
+        const uint64_t sequence = queued_;
+        ++waiting_;
+        wake_.signal();
+        while (written_ < sequence) {
+            if (!error_.empty() && (failed_ >= sequence)) {
+                --waiting_;
+                bundy_throw(DbOperationError, "unable to write the queued "
+                            "leases: " << error_);
+            }
+            written_cond_.wait(mutex_);
+        }
+        --waiting_;
+    }
+
+private:
+    /// @brief Sets the state of an address, the mutex must be locked
+    ///
+    /// Waits for room in the queue if the address is not queued.
+    ///
+    /// @param addr The address.
+    /// @param lease The lease of the address, null if it is deleted.
+    template <typename LeasePtr>
+    void queue(const IOAddress& addr, const LeasePtr& lease) {
+        while (!entries_.contains(addr) && (entries_.size() >= max_size_)) {
+            if (!error_.empty()) {
+                bundy_throw(DbOperationError, "the lease queue is full and "
+                            "can't be written: " << error_);
+            }
+            wake_.signal();
+            room_.wait(mutex_);
+        }
+        if (lease) {
+            entries_.set(lease, ++queued_);
+        } else {
+            entries_.remove(addr, ++queued_);
+        }
+        if (queued_ - written_ >= batch_size_) {
+            wake_.signal();
+        }
+    }
+
+    /// @brief Takes the leases to write
+    ///
+    /// Waits for leases to write, then for more leases to come.
+    ///
+    /// @return false if the thread must stop.
+    bool take(Lease4Collection& leases4, Lease6Collection& leases6,
+              std::vector<IOAddress>& deleted, uint64_t& last) {
+        Mutex::Locker lock(mutex_);
+        while (!stopping_ && (queued_ == written_)) {
+            wake_.wait(mutex_);
+        }
+        if (queued_ == written_) {
+            return (false);
+        }
+        if (!error_.empty()) {
+            if (stopping_) {
+                LOG_ERROR(dhcpsrv_logger, DHCPSRV_MYSQL_WRITE_BEHIND_LOST)
+                    .arg(entries_.size());
+                return (false);
+            }
+            wake_.timedWait(mutex_, WRITE_BEHIND_RETRY_DELAY);
+        } else if (!stopping_ && (delay_ > 0) && (waiting_ == 0) &&
+                   (queued_ - written_ < batch_size_) &&
+                   (entries_.size() < max_size_)) {
+            wake_.timedWait(mutex_, delay_);
+        }
+
+        entries_.getAll(leases4, leases6, deleted);
+        last = queued_;
+        return (true);
+    }
+
+    /// @brief Records the result of a write
+    ///
+    /// The entries not changed since they were taken are removed if they
+    /// were written.
+    ///
+    /// @param last Number of the last write taken.
+    /// @param error Error message, empty if the leases were written.
+    void finish(uint64_t last, const std::string& error) {
+        Mutex::Locker lock(mutex_);
+        if (error.empty()) {
+            entries_.erase(last);
+            written_ = last;
+            error_.clear();
+        } else {
+            failed_ = last;
+            error_ = error;
+        }
+        room_.broadcast();
+        written_cond_.broadcast();
+    }
+
+    /// @brief The thread writing the leases
+    void run() {
+        // The thread uses the connection of the lease manager.
+        mysql_thread_init();
+
+        Lease4Collection leases4;
+        Lease6Collection leases6;
+        std::vector<IOAddress> deleted;
+        uint64_t last;
+        while (take(leases4, leases6, deleted, last)) {
+            const size_t count = leases4.size() + leases6.size() +
+                deleted.size();
+            std::string error;
+            try {
+                lease_mgr_->writeLeases(leases4, leases6, deleted,
+                                        batch_size_);
+                LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+                          DHCPSRV_MYSQL_WRITE_BEHIND_WRITTEN).arg(count);
+            } catch (const std::exception& ex) {
+                error = ex.what();
+                LOG_ERROR(dhcpsrv_logger, DHCPSRV_MYSQL_WRITE_BEHIND_FAIL)
+                    .arg(count).arg(error);
+            }
+            finish(last, error);
+        }
+
+        mysql_thread_end();
+    }
+
+    const size_t max_size_;         ///< Maximum number of entries
+    const size_t batch_size_;       ///< Maximum number of leases per statement
+    const size_t delay_;            ///< Milliseconds before writing
+
+    /// The lease manager writing the leases.
+    boost::scoped_ptr<MySqlLeaseMgr> lease_mgr_;
+
+    PendingLeases entries_;         ///< The queued addresses
+    uint64_t queued_;               ///< Number of the last write queued
+    uint64_t written_;              ///< Number of the last write written
+    uint64_t failed_;               ///< Number of the last write which failed
+    std::string error_;             ///< Error of the last failed write
+    size_t waiting_;                ///< Number of commits waiting
+    bool stopping_;                 ///< Must the thread stop?
+
+    /// Protects the members above.
+    mutable Mutex mutex_;
+
+    /// Signaled to wake up the thread.
+    CondVar wake_;
+
+    /// Signaled when entries are removed.
+    CondVar room_;
+
+    /// Signaled when leases are written (or fail to be).
+    CondVar written_cond_;
+
+    /// The thread writing the leases.
+    boost::scoped_ptr<Thread> thread_;
+};
+
 // MySqlLeaseMgr Constructor and Destructor
 
 MySqlLeaseMgr::MySqlLeaseMgr(const LeaseMgr::ParameterMap& parameters)
@@ -1120,10 +1559,33 @@ MySqlLeaseMgr::MySqlLeaseMgr(const LeaseMgr::ParameterMap& parameters)
     // Prepare all statements likely to be used.
     prepareStatements();
 
+    // An older schema lacks some of the indexes used by the queries: the
+    // server still works with it, but warn that it should be upgraded.
+    const pair<uint32_t, uint32_t> version = getVersion();
+    if ((version.first == CURRENT_VERSION_VERSION) &&
+        (version.second < CURRENT_VERSION_MINOR)) {
+        LOG_WARN(dhcpsrv_logger, DHCPSRV_MYSQL_SCHEMA_OLD)
+            .arg(version.first).arg(version.second)
+            .arg(CURRENT_VERSION_VERSION).arg(CURRENT_VERSION_MINOR);
+    }
+
     // Create the exchange objects for use in exchanging data between the
     // program and the database.
     exchange4_.reset(new MySqlLease4Exchange());
     exchange6_.reset(new MySqlLease6Exchange());
+
+    // Use the write-behind queue of the lease managers with the same
+    // parameters, if enabled.
+    LeaseMgr::ParameterMap::const_iterator write_behind =
+        parameters.find("write-behind");
+    if (write_behind != parameters.end()) {
+        if (write_behind->second == "true") {
+            write_queue_ = MySqlWriteQueue::get(parameters);
+        } else if (write_behind->second != "false") {
+            bundy_throw(BadValue, "invalid value 'write-behind="
+                        << write_behind->second << "'");
+        }
+    }
 }
 
 
@@ -1137,6 +1599,11 @@ MySqlLeaseMgr::~MySqlLeaseMgr() {
             statements_[i] = NULL;
         }
     }
+    for (std::map<std::pair<BatchIndex, size_t>, MYSQL_STMT*>::iterator
+             statement = batch_statements_.begin();
+         statement != batch_statements_.end(); ++statement) {
+        (void) mysql_stmt_close(statement->second);
+    }
 
     // There is no need to close the database in this destructor: it is
     // closed in the destructor of the mysql_ member variable.
@@ -1365,6 +1832,10 @@ MySqlLeaseMgr::addLease(const Lease4Ptr& lease) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MYSQL_ADD_ADDR4).arg(lease->addr_.toText());
 
+    if (write_queue_) {
+        return (!leaseExists(lease->addr_) && write_queue_->add(lease));
+    }
+
     // Create the MYSQL_BIND array for the lease
     std::vector<MYSQL_BIND> bind = exchange4_->createBindForSend(lease);
 
@@ -1378,6 +1849,10 @@ MySqlLeaseMgr::addLease(const Lease6Ptr& lease) {
               DHCPSRV_MYSQL_ADD_ADDR6).arg(lease->addr_.toText())
               .arg(lease->type_);
 
+    if (write_queue_) {
+        return (!leaseExists(lease->addr_) && write_queue_->add(lease));
+    }
+
     // Create the MYSQL_BIND array for the lease
     std::vector<MYSQL_BIND> bind = exchange6_->createBindForSend(lease);
 
@@ -1517,6 +1992,13 @@ MySqlLeaseMgr::getLease4(const bundy::asiolink::IOAddress& addr) const {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MYSQL_GET_ADDR4).arg(addr.toText());
 
+    if (write_queue_) {
+        Lease4Ptr queued;
+        if (write_queue_->find(addr, queued)) {
+            return (queued);
+        }
+    }
+
     // Set up the WHERE clause value
     MYSQL_BIND inbind[1];
     memset(inbind, 0, sizeof(inbind));
@@ -1559,6 +2041,10 @@ MySqlLeaseMgr::getLease4(const HWAddr& hwaddr) const {
     // Get the data
     Lease4Collection result;
     getLeaseCollection(GET_LEASE4_HWADDR, inbind, result);
+    if (write_queue_) {
+        write_queue_->merge(result,
+                            PendingLeases::HWAddrMatch(hwaddr.hwaddr_));
+    }
 
     return (result);
 }
@@ -1594,6 +2080,11 @@ MySqlLeaseMgr::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) const {
     // Get the data
     Lease4Ptr result;
     getLease(GET_LEASE4_HWADDR_SUBID, inbind, result);
+    if (write_queue_) {
+        write_queue_->mergeSingle(result,
+                                  PendingLeases::HWAddrMatch(hwaddr.hwaddr_,
+                                                             subnet_id));
+    }
 
     return (result);
 }
@@ -1618,6 +2109,9 @@ MySqlLeaseMgr::getLease4(const ClientId& clientid) const {
     // Get the data
     Lease4Collection result;
     getLeaseCollection(GET_LEASE4_CLIENTID, inbind, result);
+    if (write_queue_) {
+        write_queue_->merge(result, PendingLeases::ClientIdMatch(clientid));
+    }
 
     return (result);
 }
@@ -1656,11 +2150,95 @@ MySqlLeaseMgr::getLease4(const ClientId& clientid, SubnetID subnet_id) const {
     // Get the data
     Lease4Ptr result;
     getLease(GET_LEASE4_CLIENTID_SUBID, inbind, result);
+    if (write_queue_) {
+        write_queue_->mergeSingle(result,
+                                  PendingLeases::ClientIdMatch(clientid,
+                                                               subnet_id));
+    }
 
     return (result);
 }
 
 
+Lease4Collection
+MySqlLeaseMgr::getLeases4(const bundy::asiolink::IOAddress& lower,
+                          const bundy::asiolink::IOAddress& upper) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_MYSQL_GET_RANGE4).arg(lower.toText())
+              .arg(upper.toText());
+
+    // Set up the WHERE clause values
+    MYSQL_BIND inbind[2];
+    memset(inbind, 0, sizeof(inbind));
+
+    uint32_t lower4 = static_cast<uint32_t>(lower);
+    inbind[0].buffer_type = MYSQL_TYPE_LONG;
+    inbind[0].buffer = reinterpret_cast<char*>(&lower4);
+    inbind[0].is_unsigned = MLM_TRUE;
+
+    uint32_t upper4 = static_cast<uint32_t>(upper);
+    inbind[1].buffer_type = MYSQL_TYPE_LONG;
+    inbind[1].buffer = reinterpret_cast<char*>(&upper4);
+    inbind[1].is_unsigned = MLM_TRUE;
+
+    // Get the data
+    Lease4Collection result;
+    getLeaseCollection(GET_LEASE4_RANGE, inbind, result);
+    if (write_queue_) {
+        // The queued leases are added at the end.
+        write_queue_->merge(result, PendingLeases::RangeMatch(lower, upper));
+        std::sort(result.begin(), result.end(), AddressLess());
+    }
+
+    return (result);
+}
+template <typename LeaseCollection>
+void
+MySqlLeaseMgr::getExpiredLeases(StatementIndex stindex, time_t now,
+                                size_t max_leases,
+                                LeaseCollection& result) const {
+    // Set up the WHERE and LIMIT clause values
+    MYSQL_BIND inbind[2];
+    memset(inbind, 0, sizeof(inbind));
+
+    MYSQL_TIME expire;
+    convertToDatabaseTime(now, 0, expire);
+    inbind[0].buffer_type = MYSQL_TYPE_TIMESTAMP;
+    inbind[0].buffer = reinterpret_cast<char*>(&expire);
+    inbind[0].buffer_length = sizeof(expire);
+
+    // There is no way to bind "no limit", so use the largest one.
+    uint32_t limit = (max_leases == 0) ?
+        std::numeric_limits<uint32_t>::max() :
+        static_cast<uint32_t>(std::min<size_t>(
+            max_leases, std::numeric_limits<uint32_t>::max()));
+    inbind[1].buffer_type = MYSQL_TYPE_LONG;
+    inbind[1].buffer = reinterpret_cast<char*>(&limit);
+    inbind[1].is_unsigned = MLM_TRUE;
+
+    getLeaseCollection(stindex, inbind, result);
+}
+
+Lease4Collection
+MySqlLeaseMgr::getExpiredLeases4(size_t max_leases) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_MYSQL_GET_EXPIRED4).arg(max_leases);
+
+    Lease4Collection result;
+    const time_t now = time(NULL);
+    getExpiredLeases(GET_LEASE4_EXPIRE, now, max_leases, result);
+    if (write_queue_) {
+        // The queued leases are added at the end.
+        write_queue_->merge(result, PendingLeases::ExpiredMatch(now));
+        std::stable_sort(result.begin(), result.end(), ExpirationLess());
+        if ((max_leases != 0) && (result.size() > max_leases)) {
+            result.resize(max_leases);
+        }
+    }
+
+    return (result);
+}
+
 Lease6Ptr
 MySqlLeaseMgr::getLease6(Lease::Type lease_type,
                          const bundy::asiolink::IOAddress& addr) const {
@@ -1668,6 +2246,14 @@ MySqlLeaseMgr::getLease6(Lease::Type lease_type,
               DHCPSRV_MYSQL_GET_ADDR6).arg(addr.toText())
               .arg(lease_type);
 
+    if (write_queue_) {
+        Lease6Ptr queued;
+        if (write_queue_->find(addr, queued)) {
+            return ((queued && (queued->type_ == lease_type)) ? queued :
+                    Lease6Ptr());
+        }
+    }
+
     // Set up the WHERE clause value
     MYSQL_BIND inbind[2];
     memset(inbind, 0, sizeof(inbind));
@@ -1738,6 +2324,11 @@ MySqlLeaseMgr::getLeases6(Lease::Type lease_type,
     // ... and get the data
     Lease6Collection result;
     getLeaseCollection(GET_LEASE6_DUID_IAID, inbind, result);
+    if (write_queue_) {
+        write_queue_->merge(result,
+                            PendingLeases::DuidIaidMatch(lease_type, duid,
+                                                         iaid));
+    }
 
     return (result);
 }
@@ -1783,6 +2374,31 @@ MySqlLeaseMgr::getLeases6(Lease::Type lease_type,
     // ... and get the data
     Lease6Collection result;
     getLeaseCollection(GET_LEASE6_DUID_IAID_SUBID, inbind, result);
+    if (write_queue_) {
+        write_queue_->merge(result,
+                            PendingLeases::DuidIaidMatch(lease_type, duid,
+                                                         iaid, subnet_id));
+    }
+
+    return (result);
+}
+
+Lease6Collection
+MySqlLeaseMgr::getExpiredLeases6(size_t max_leases) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_MYSQL_GET_EXPIRED6).arg(max_leases);
+
+    Lease6Collection result;
+    const time_t now = time(NULL);
+    getExpiredLeases(GET_LEASE6_EXPIRE, now, max_leases, result);
+    if (write_queue_) {
+        // The queued leases are added at the end.
+        write_queue_->merge(result, PendingLeases::ExpiredMatch(now));
+        std::stable_sort(result.begin(), result.end(), ExpirationLess());
+        if ((max_leases != 0) && (result.size() > max_leases)) {
+            result.resize(max_leases);
+        }
+    }
 
     return (result);
 }
@@ -1826,6 +2442,15 @@ MySqlLeaseMgr::updateLease4(const Lease4Ptr& lease) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MYSQL_UPDATE_ADDR4).arg(lease->addr_.toText());
 
+    if (write_queue_) {
+        if (!leaseExists(lease->addr_)) {
+            bundy_throw(NoSuchLease, "unable to update lease for address " <<
+                        lease->addr_ << " as it does not exist");
+        }
+        write_queue_->update(lease);
+        return;
+    }
+
     // Create the MYSQL_BIND array for the data being updated
     std::vector<MYSQL_BIND> bind = exchange4_->createBindForSend(lease);
 
@@ -1852,6 +2477,15 @@ MySqlLeaseMgr::updateLease6(const Lease6Ptr& lease) {
               DHCPSRV_MYSQL_UPDATE_ADDR6).arg(lease->addr_.toText())
               .arg(lease->type_);
 
+    if (write_queue_) {
+        if (!leaseExists(lease->addr_)) {
+            bundy_throw(NoSuchLease, "unable to update lease for address " <<
+                        lease->addr_ << " as it does not exist");
+        }
+        write_queue_->update(lease);
+        return;
+    }
+
     // Create the MYSQL_BIND array for the data being updated
     std::vector<MYSQL_BIND> bind = exchange6_->createBindForSend(lease);
 
@@ -1901,6 +2535,14 @@ MySqlLeaseMgr::deleteLease(const bundy::asiolink::IOAddress& addr) {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
               DHCPSRV_MYSQL_DELETE_ADDR).arg(addr.toText());
 
+    if (write_queue_) {
+        if (!leaseExists(addr)) {
+            return (false);
+        }
+        write_queue_->remove(addr);
+        return (true);
+    }
+
     // Set up the WHERE clause value
     MYSQL_BIND inbind[1];
     memset(inbind, 0, sizeof(inbind));
@@ -2003,12 +2645,25 @@ MySqlLeaseMgr::getVersion() const {
 void
 MySqlLeaseMgr::commit() {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL, DHCPSRV_MYSQL_COMMIT);
+    if (write_queue_) {
+        // The leases are written by the queue: wait for them.
+        write_queue_->wait();
+        return;
+    }
     if (mysql_commit(mysql_) != 0) {
         bundy_throw(DbOperationError, "commit failed: " << mysql_error(mysql_));
     }
 }
 
 
+void
+MySqlLeaseMgr::waitForWrites() {
+    if (write_queue_) {
+        write_queue_->wait();
+    }
+}
+
+
 void
 MySqlLeaseMgr::rollback() {
     LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL, DHCPSRV_MYSQL_ROLLBACK);
@@ -2017,5 +2672,196 @@ MySqlLeaseMgr::rollback() {
     }
 }
 
+// Write-behind methods.
+
+bool
+MySqlLeaseMgr::leaseExists(const IOAddress& addr) const {
+    if (addr.isV4()) {
+        return (static_cast<bool>(getLease4(addr)));
+    }
+
+    Lease6Ptr queued;
+    if (write_queue_ && write_queue_->find(addr, queued)) {
+        return (static_cast<bool>(queued));
+    }
+
+    // The address is the key of the lease6 table, whatever the lease type.
+    const Lease::Type types[] = {
+        Lease::TYPE_NA, Lease::TYPE_TA, Lease::TYPE_PD
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (getLease6(types[i], addr)) {
+            return (true);
+        }
+    }
+    return (false);
+}
+
+MYSQL_STMT*
+MySqlLeaseMgr::getBatchStatement(BatchIndex index, size_t count) {
+    const std::pair<BatchIndex, size_t> key(index, count);
+    std::map<std::pair<BatchIndex, size_t>, MYSQL_STMT*>::const_iterator
+        prepared = batch_statements_.find(key);
+    if (prepared != batch_statements_.end()) {
+        return (prepared->second);
+    }
+
+    const bool v4 = (index == UPSERT_LEASES4) || (index == DELETE_LEASES4);
+    const char* const* columns = v4 ? LEASE4_COLUMNS : LEASE6_COLUMNS;
+    std::ostringstream text;
+    if ((index == UPSERT_LEASES4) || (index == UPSERT_LEASES6)) {
+        // INSERT INTO lease4(address, ...) VALUES (?, ...), (?, ...)
+        //     ON DUPLICATE KEY UPDATE hwaddr = VALUES(hwaddr), ...
+        text << "INSERT INTO " << (v4 ? "lease4" : "lease6") << "(";
+        size_t column_count = 0;
+        for (; columns[column_count] != NULL; ++column_count) {
+            text << (column_count > 0 ? ", " : "") << columns[column_count];
+        }
+        text << ") VALUES ";
+        for (size_t row = 0; row < count; ++row) {
+            text << (row > 0 ? ", (?" : "(?");
+            for (size_t column = 1; column < column_count; ++column) {
+                text << ", ?";
+            }
+            text << ")";
+        }
+        text << " ON DUPLICATE KEY UPDATE ";
+        for (size_t column = 1; column < column_count; ++column) {
+            text << (column > 1 ? ", " : "") << columns[column]
+                 << " = VALUES(" << columns[column] << ")";
+        }
+    } else {
+        // DELETE FROM lease4 WHERE address IN (?, ...)
+        text << "DELETE FROM " << (v4 ? "lease4" : "lease6")
+             << " WHERE address IN (?";
+        for (size_t row = 1; row < count; ++row) {
+            text << ", ?";
+        }
+        text << ")";
+    }
+
+    MYSQL_STMT* statement = mysql_stmt_init(mysql_);
+    if (statement == NULL) {
+        bundy_throw(DbOperationError, "unable to allocate MySQL prepared "
+                  "statement structure, reason: " << mysql_error(mysql_));
+    }
+    const std::string statement_text = text.str();
+    if (mysql_stmt_prepare(statement, statement_text.c_str(),
+                           statement_text.size()) != 0) {
+        const std::string error = mysql_error(mysql_);
+        (void) mysql_stmt_close(statement);
+        bundy_throw(DbOperationError, "unable to prepare MySQL statement <" <<
+                  statement_text << ">, reason: " << error);
+    }
+    batch_statements_[key] = statement;
+    return (statement);
+}
+
+void
+MySqlLeaseMgr::executeBatch(BatchIndex index, size_t count,
+                            std::vector<MYSQL_BIND>& bind) {
+    MYSQL_STMT* statement = getBatchStatement(index, count);
+    int status = mysql_stmt_bind_param(statement, &bind[0]);
+    if (status == 0) {
+        status = mysql_stmt_execute(statement);
+    }
+    if (status != 0) {
+        bundy_throw(DbOperationError, "unable to write " << count <<
+                    " leases, reason: " << mysql_error(mysql_) <<
+                    " (error code " << mysql_errno(mysql_) << ")");
+    }
+}
+
+void
+MySqlLeaseMgr::writeLeases(const Lease4Collection& leases4,
+                           const Lease6Collection& leases6,
+                           const std::vector<IOAddress>& deleted,
+                           size_t batch_size) {
+    if (mysql_query(mysql_, "START TRANSACTION") != 0) {
+        bundy_throw(DbOperationError, "unable to start a transaction: " <<
+                    mysql_error(mysql_));
+    }
+
+    try {
+        // Each lease of a statement has its own exchange object, which
+        // holds the data bound to the parameters.
+        std::vector<MYSQL_BIND> bind;
+        for (size_t first = 0; first < leases4.size(); first += batch_size) {
+            const size_t count = std::min(batch_size,
+                                          leases4.size() - first);
+            while (batch_exchange4_.size() < count) {
+                batch_exchange4_.push_back(boost::shared_ptr<
+                    MySqlLease4Exchange>(new MySqlLease4Exchange()));
+            }
+            bind.clear();
+            for (size_t i = 0; i < count; ++i) {
+                const std::vector<MYSQL_BIND> lease_bind =
+                    batch_exchange4_[i]->createBindForSend(leases4[first + i]);
+                bind.insert(bind.end(), lease_bind.begin(), lease_bind.end());
+            }
+            executeBatch(UPSERT_LEASES4, count, bind);
+        }
+        for (size_t first = 0; first < leases6.size(); first += batch_size) {
+            const size_t count = std::min(batch_size,
+                                          leases6.size() - first);
+            while (batch_exchange6_.size() < count) {
+                batch_exchange6_.push_back(boost::shared_ptr<
+                    MySqlLease6Exchange>(new MySqlLease6Exchange()));
+            }
+            bind.clear();
+            for (size_t i = 0; i < count; ++i) {
+                const std::vector<MYSQL_BIND> lease_bind =
+                    batch_exchange6_[i]->createBindForSend(leases6[first + i]);
+                bind.insert(bind.end(), lease_bind.begin(), lease_bind.end());
+            }
+            executeBatch(UPSERT_LEASES6, count, bind);
+        }
+
+        // The addresses are bound as in deleteLease().
+        std::vector<uint32_t> addrs4;
+        std::vector<std::string> addrs6;
+        for (std::vector<IOAddress>::const_iterator addr = deleted.begin();
+             addr != deleted.end(); ++addr) {
+            if (addr->isV4()) {
+                addrs4.push_back(static_cast<uint32_t>(*addr));
+            } else {
+                addrs6.push_back(addr->toText());
+            }
+        }
+        std::vector<unsigned long> addrs6_length(addrs6.size());
+        for (size_t first = 0; first < addrs4.size(); first += batch_size) {
+            const size_t count = std::min(batch_size, addrs4.size() - first);
+            bind.assign(count, MYSQL_BIND());
+            for (size_t i = 0; i < count; ++i) {
+                bind[i].buffer_type = MYSQL_TYPE_LONG;
+                bind[i].buffer = reinterpret_cast<char*>(&addrs4[first + i]);
+                bind[i].is_unsigned = MLM_TRUE;
+            }
+            executeBatch(DELETE_LEASES4, count, bind);
+        }
+        for (size_t first = 0; first < addrs6.size(); first += batch_size) {
+            const size_t count = std::min(batch_size, addrs6.size() - first);
+            bind.assign(count, MYSQL_BIND());
+            for (size_t i = 0; i < count; ++i) {
+                const std::string& addr6 = addrs6[first + i];
+                addrs6_length[first + i] = addr6.size();
+                bind[i].buffer_type = MYSQL_TYPE_STRING;
+                bind[i].buffer = const_cast<char*>(addr6.c_str());
+                bind[i].buffer_length = addr6.size();
+                bind[i].length = &addrs6_length[first + i];
+            }
+            executeBatch(DELETE_LEASES6, count, bind);
+        }
+
+        if (mysql_commit(mysql_) != 0) {
+            bundy_throw(DbOperationError, "commit failed: " <<
+                        mysql_error(mysql_));
+        }
+    } catch (...) {
+        (void) mysql_rollback(mysql_);
+        throw;
+    }
+}
+
 }; // end of bundy::dhcp namespace
 }; // end of bundy namespace
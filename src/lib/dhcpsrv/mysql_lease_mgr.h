@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -19,9 +19,14 @@
 #include <dhcpsrv/lease_mgr.h>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 #include <mysql.h>
 
+#include <map>
+#include <utility>
+#include <vector>
+
 #include <time.h>
 
 namespace bundy {
@@ -78,7 +83,7 @@ private:
 // Define the current database schema values
 
 const uint32_t CURRENT_VERSION_VERSION = 1;
-const uint32_t CURRENT_VERSION_MINOR = 0;
+const uint32_t CURRENT_VERSION_MINOR = 1;
 
 
 // Forward declaration of the Lease exchange objects.  These classes are defined
@@ -86,6 +91,10 @@ const uint32_t CURRENT_VERSION_MINOR = 0;
 class MySqlLease4Exchange;
 class MySqlLease6Exchange;
 
+// Forward declaration of the queue of the write-behind mode, defined in the
+// .cc file.
+class MySqlWriteQueue;
+
 
 /// @brief MySQL Lease Manager
 ///
@@ -103,6 +112,28 @@ public:
     /// - host - Host to which to connect (optional, defaults to "localhost")
     /// - user - Username under which to connect (optional)
     /// - password - Password for "user" on the database (optional)
+    /// - write-behind - "true" to queue the lease writes and write them to
+    ///   the database in the background (optional, defaults to "false")
+    /// - write-behind-queue - maximum number of leases queued, the writers
+    ///   wait when it is reached (optional, defaults to 10000)
+    /// - write-behind-batch - maximum number of leases written by a single
+    ///   statement (optional, defaults to 100)
+    /// - write-behind-delay - time in milliseconds the leases are kept in
+    ///   the queue before they are written, unless a batch is full or a
+    ///   commit is waiting (optional, defaults to 10)
+    ///
+    /// In the write-behind mode, the added, updated and deleted leases are
+    /// queued, and the queue is shared by all the lease managers with the
+    /// same parameters (i.e. by the sessions of all the threads).  The
+    /// queued leases are visible to the queries of all the sessions at once.
+    /// A thread writes them to the database on a connection of its own, in
+    /// batches of multi-row statements and in one transaction.  @c commit
+    /// and @c waitForWrites wait until the leases queued before the call
+    /// have been written.  The servers call @c waitForWrites before they
+    /// respond, so a lease is acknowledged to the client only once it is
+    /// stored.  The write-behind mode thus trades some latency of the
+    /// responses, which wait for the write of their batch, for fewer
+    /// database round trips.
     ///
     /// If the database is successfully opened, the version number in the
     /// schema_version table will be checked against hard-coded value in
@@ -251,6 +282,42 @@ public:
     virtual Lease4Ptr getLease4(const ClientId& clientid,
                                 SubnetID subnet_id) const;
 
+    /// @brief Returns existing IPv4 leases for a range of addresses
+    ///
+    /// @param lower the first address of the range
+    /// @param upper the last address of the range
+    ///
+    /// @return lease collection ordered by address (may be empty if no
+    /// lease is found)
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    virtual Lease4Collection getLeases4(const bundy::asiolink::IOAddress& lower,
+                                        const bundy::asiolink::IOAddress& upper)
+        const;
+
+    /// @brief Returns expired IPv4 leases
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    virtual Lease4Collection getExpiredLeases4(size_t max_leases) const;
+
+    /// @brief Returns expired IPv6 leases
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    virtual Lease6Collection getExpiredLeases6(size_t max_leases) const;
+
     /// @brief Returns existing IPv6 lease for a given IPv6 address.
     ///
     /// For a given address, we assume that there will be only one lease.
@@ -386,7 +453,8 @@ public:
     /// @brief Commit Transactions
     ///
     /// Commits all pending database operations.  On databases that don't
-    /// support transactions, this is a no-op.
+    /// support transactions, this is a no-op.  In the write-behind mode,
+    /// waits until all the queued leases have been written.
     ///
     /// @throw DbOperationError Iif the commit failed.
     virtual void commit();
@@ -394,11 +462,20 @@ public:
     /// @brief Rollback Transactions
     ///
     /// Rolls back all pending database operations.  On databases that don't
-    /// support transactions, this is a no-op.
+    /// support transactions, this is a no-op.  In the write-behind mode, the
+    /// queued leases are not rolled back.
     ///
     /// @throw DbOperationError If the rollback failed.
     virtual void rollback();
 
+    /// @brief Waits until the lease changes are stored
+    ///
+    /// In the write-behind mode, waits until all the queued leases have
+    /// been written; otherwise the changes are stored already.
+    ///
+    /// @throw DbOperationError The queued leases couldn't be written.
+    virtual void waitForWrites();
+
     ///@{
     /// The following methods are used to convert between times and time
     /// intervals stored in the Lease object, and the times stored in the
@@ -458,11 +535,14 @@ public:
         GET_LEASE4_ADDR,            // Get lease4 by address
         GET_LEASE4_CLIENTID,        // Get lease4 by client ID
         GET_LEASE4_CLIENTID_SUBID,  // Get lease4 by client ID & subnet ID
+        GET_LEASE4_EXPIRE,          // Get expired lease4
         GET_LEASE4_HWADDR,          // Get lease4 by HW address
         GET_LEASE4_HWADDR_SUBID,    // Get lease4 by HW address & subnet ID
+        GET_LEASE4_RANGE,           // Get lease4 by address range
         GET_LEASE6_ADDR,            // Get lease6 by address
         GET_LEASE6_DUID_IAID,       // Get lease6 by DUID and IAID
         GET_LEASE6_DUID_IAID_SUBID, // Get lease6 by DUID, IAID and subnet ID
+        GET_LEASE6_EXPIRE,          // Get expired lease6
         GET_VERSION,                // Obtain version number
         INSERT_LEASE4,              // Add entry to lease4 table
         INSERT_LEASE6,              // Add entry to lease6 table
@@ -590,6 +670,24 @@ private:
         getLeaseCollection(stindex, bind, exchange6_, result);
     }
 
+    /// @brief Get Expired Leases Common Code
+    ///
+    /// This method performs the common actions for the getExpiredLeases4()
+    /// and getExpiredLeases6() methods: it binds the expiration time and
+    /// the limit before getting the collection.
+    ///
+    /// @param stindex Index of statement being executed
+    /// @param now Leases expired before this time are retrieved
+    /// @param max_leases Maximum number of leases (0 for no limit)
+    /// @param lease LeaseCollection object returned.
+    ///
+    /// @throw bundy::dhcp::BadValue Data retrieved from the database was invalid.
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    template <typename LeaseCollection>
+    void getExpiredLeases(StatementIndex stindex, time_t now,
+                          size_t max_leases, LeaseCollection& result) const;
+
     /// @brief Get Lease4 Common Code
     ///
     /// This method performs the common actions for the various getLease4()
@@ -674,6 +772,70 @@ private:
         }
     }
 
+    /// @brief Batch Statement Tags
+    ///
+    /// The statements writing several leases at once.  They are prepared
+    /// when first used for a number of leases.
+    enum BatchIndex {
+        UPSERT_LEASES4,             // Insert or update lease4 entries
+        UPSERT_LEASES6,             // Insert or update lease6 entries
+        DELETE_LEASES4,             // Delete from lease4 by addresses
+        DELETE_LEASES6              // Delete from lease6 by addresses
+    };
+
+    /// @brief Checks if there is a lease for an address
+    ///
+    /// In the write-behind mode, the queued leases are searched first.
+    ///
+    /// @param addr Address of the lease.
+    ///
+    /// @return true if the address is leased.
+    bool leaseExists(const bundy::asiolink::IOAddress& addr) const;
+
+    /// @brief Returns a batch statement
+    ///
+    /// Prepares the statement the first time it is used for the number of
+    /// leases.
+    ///
+    /// @param index Index of the batch statement.
+    /// @param count Number of leases of the statement.
+    ///
+    /// @throw bundy::dhcp::DbOperationError The statement could not be
+    ///        prepared.
+    MYSQL_STMT* getBatchStatement(BatchIndex index, size_t count);
+
+    /// @brief Writes leases in one transaction
+    ///
+    /// Used by the write-behind queue, on its own lease manager.  The leases
+    /// are inserted or updated and the deleted addresses removed by batch
+    /// statements of at most @c batch_size leases, then the transaction is
+    /// committed.  It is rolled back on error.
+    ///
+    /// @param leases4 IPv4 leases to insert or update.
+    /// @param leases6 IPv6 leases to insert or update.
+    /// @param deleted Addresses of the leases to delete.
+    /// @param batch_size Maximum number of leases per statement.
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database
+    ///        has failed.
+    void writeLeases(const Lease4Collection& leases4,
+                     const Lease6Collection& leases6,
+                     const std::vector<bundy::asiolink::IOAddress>& deleted,
+                     size_t batch_size);
+
+    /// @brief Executes a batch statement
+    ///
+    /// @param index Index of the batch statement.
+    /// @param count Number of leases of the statement.
+    /// @param bind Array of MYSQL_BIND objects of the parameters.
+    ///
+    /// @throw bundy::dhcp::DbOperationError The statement failed.
+    void executeBatch(BatchIndex index, size_t count,
+                      std::vector<MYSQL_BIND>& bind);
+
+    /// The write-behind queue accesses the batch methods.
+    friend class MySqlWriteQueue;
+
     // Members
 
     /// The exchange objects are used for transfer of data to/from the database.
@@ -685,6 +847,16 @@ private:
     MySqlHolder mysql_;
     std::vector<MYSQL_STMT*> statements_;       ///< Prepared statements
     std::vector<std::string> text_statements_;  ///< Raw text of statements
+
+    /// Batch statements prepared, by index and number of leases.
+    std::map<std::pair<BatchIndex, size_t>, MYSQL_STMT*> batch_statements_;
+
+    /// Exchange objects of the leases of the batch statements.
+    std::vector<boost::shared_ptr<MySqlLease4Exchange> > batch_exchange4_;
+    std::vector<boost::shared_ptr<MySqlLease6Exchange> > batch_exchange6_;
+
+    /// The write-behind queue (null if the mode is not enabled).
+    boost::shared_ptr<MySqlWriteQueue> write_queue_;
 };
 
 }; // end of bundy::dhcp namespace
@@ -0,0 +1,230 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/packed_lease.h>
+#include <exceptions/exceptions.h>
+
+#include <limits>
+#include <vector>
+
+using namespace bundy::asiolink;
+
+namespace {
+
+// Checks the length of a variable-length field against the maximum of its
+// length field.
+template<typename LengthType>
+LengthType
+checkLength(size_t len, const char* name) {
+    if (len > std::numeric_limits<LengthType>::max()) {
+        bundy_throw(bundy::BadValue, "the " << name << " of a lease is too "
+                    "long (" << len << " bytes)");
+    }
+    return (static_cast<LengthType>(len));
+}
+
+// Returns a copy of a block of the given length (NULL if empty).
+uint8_t*
+copyData(const uint8_t* data, size_t len) {
+    if (len == 0) {
+        return (NULL);
+    }
+    uint8_t* copy = new uint8_t[len];
+    std::memcpy(copy, data, len);
+    return (copy);
+}
+
+// Appends a field to a block.
+uint8_t*
+appendField(uint8_t* dest, const void* data, size_t len) {
+    if (len > 0) {
+        std::memcpy(dest, data, len);
+    }
+    return (dest + len);
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+Address6Key::Address6Key(const IOAddress& addr) {
+    if (!addr.isV6()) {
+        bundy_throw(BadValue, "address " << addr << " is not IPv6");
+    }
+    const std::vector<uint8_t> bytes = addr.toBytes();
+    std::memcpy(bytes_, &bytes[0], sizeof(bytes_));
+}
+
+PackedLease4::PackedLease4(const Lease4& lease) :
+    data_(NULL), cltt_(lease.cltt_), addr_(0), t1_(lease.t1_),
+    t2_(lease.t2_), valid_lft_(lease.valid_lft_),
+    subnet_id_(lease.subnet_id_),
+    hostname_len_(checkLength<uint16_t>(lease.hostname_.size(), "hostname")),
+    hwaddr_len_(checkLength<uint8_t>(lease.hwaddr_.size(),
+                                     "hardware address")),
+    client_id_len_(checkLength<uint8_t>(lease.getClientIdVector().size(),
+                                        "client identifier")),
+    fqdn_fwd_(lease.fqdn_fwd_), fqdn_rev_(lease.fqdn_rev_)
+{
+    if (!lease.addr_.isV4()) {
+        bundy_throw(BadValue, "address " << lease.addr_ << " of a DHCPv4 "
+                    "lease is not IPv4");
+    }
+    addr_ = static_cast<uint32_t>(lease.addr_);
+
+    const size_t len = hwaddr_len_ + client_id_len_ + hostname_len_;
+    if (len > 0) {
+        data_ = new uint8_t[len];
+        uint8_t* dest = appendField(data_, &lease.hwaddr_[0], hwaddr_len_);
+        dest = appendField(dest, &lease.getClientIdVector()[0],
+                           client_id_len_);
+        appendField(dest, lease.hostname_.data(), hostname_len_);
+    }
+}
+
+PackedLease4::PackedLease4(const PackedLease4& other) :
+    data_(copyData(other.data_, other.hwaddr_len_ + other.client_id_len_ +
+                   other.hostname_len_)),
+    cltt_(other.cltt_), addr_(other.addr_), t1_(other.t1_), t2_(other.t2_),
+    valid_lft_(other.valid_lft_), subnet_id_(other.subnet_id_),
+    hostname_len_(other.hostname_len_), hwaddr_len_(other.hwaddr_len_),
+    client_id_len_(other.client_id_len_), fqdn_fwd_(other.fqdn_fwd_),
+    fqdn_rev_(other.fqdn_rev_)
+{}
+
+PackedLease4&
+PackedLease4::operator=(const PackedLease4& other) {
+    if (this != &other) {
+        PackedLease4 copy(other);
+        std::swap(data_, copy.data_);
+        cltt_ = other.cltt_;
+        addr_ = other.addr_;
+        t1_ = other.t1_;
+        t2_ = other.t2_;
+        valid_lft_ = other.valid_lft_;
+        subnet_id_ = other.subnet_id_;
+        hostname_len_ = other.hostname_len_;
+        hwaddr_len_ = other.hwaddr_len_;
+        client_id_len_ = other.client_id_len_;
+        fqdn_fwd_ = other.fqdn_fwd_;
+        fqdn_rev_ = other.fqdn_rev_;
+    }
+    return (*this);
+}
+
+Lease4Ptr
+PackedLease4::toLease() const {
+    const uint8_t* hostname = data_ + hwaddr_len_ + client_id_len_;
+    return (Lease4Ptr(new Lease4(IOAddress(addr_), data_, hwaddr_len_,
+                                 data_ + hwaddr_len_, client_id_len_,
+                                 valid_lft_, t1_, t2_, cltt_, subnet_id_,
+                                 fqdn_fwd_, fqdn_rev_,
+                                 std::string(hostname,
+                                             hostname + hostname_len_))));
+}
+
+PackedLease6::PackedLease6(const Lease6& lease) :
+    data_(NULL), cltt_(lease.cltt_), iaid_(lease.iaid_), t1_(lease.t1_),
+    t2_(lease.t2_), preferred_lft_(lease.preferred_lft_),
+    valid_lft_(lease.valid_lft_), subnet_id_(lease.subnet_id_),
+    hostname_len_(checkLength<uint16_t>(lease.hostname_.size(), "hostname")),
+    duid_len_(checkLength<uint8_t>(lease.getDuidVector().size(), "DUID")),
+    type_(lease.type_), prefixlen_(lease.prefixlen_),
+    fqdn_fwd_(lease.fqdn_fwd_), fqdn_rev_(lease.fqdn_rev_)
+{
+    std::memcpy(addr_, Address6Key(lease.addr_).bytes_, sizeof(addr_));
+
+    const size_t len = duid_len_ + hostname_len_;
+    if (len > 0) {
+        data_ = new uint8_t[len];
+        uint8_t* dest = appendField(data_, &lease.getDuidVector()[0],
+                                    duid_len_);
+        appendField(dest, lease.hostname_.data(), hostname_len_);
+    }
+}
+
+PackedLease6::PackedLease6(const PackedLease6& other) :
+    data_(copyData(other.data_, other.duid_len_ + other.hostname_len_)),
+    cltt_(other.cltt_), iaid_(other.iaid_), t1_(other.t1_), t2_(other.t2_),
+    preferred_lft_(other.preferred_lft_), valid_lft_(other.valid_lft_),
+    subnet_id_(other.subnet_id_), hostname_len_(other.hostname_len_),
+    duid_len_(other.duid_len_), type_(other.type_),
+    prefixlen_(other.prefixlen_), fqdn_fwd_(other.fqdn_fwd_),
+    fqdn_rev_(other.fqdn_rev_)
+{
+    std::memcpy(addr_, other.addr_, sizeof(addr_));
+}
+
+PackedLease6&
+PackedLease6::operator=(const PackedLease6& other) {
+    if (this != &other) {
+        PackedLease6 copy(other);
+        std::swap(data_, copy.data_);
+        cltt_ = other.cltt_;
+        std::memcpy(addr_, other.addr_, sizeof(addr_));
+        iaid_ = other.iaid_;
+        t1_ = other.t1_;
+        t2_ = other.t2_;
+        preferred_lft_ = other.preferred_lft_;
+        valid_lft_ = other.valid_lft_;
+        subnet_id_ = other.subnet_id_;
+        hostname_len_ = other.hostname_len_;
+        duid_len_ = other.duid_len_;
+        type_ = other.type_;
+        prefixlen_ = other.prefixlen_;
+        fqdn_fwd_ = other.fqdn_fwd_;
+        fqdn_rev_ = other.fqdn_rev_;
+    }
+    return (*this);
+}
+
+Lease6Ptr
+PackedLease6::toLease() const {
+    asio::ip::address_v6::bytes_type bytes;
+    std::memcpy(&bytes[0], addr_, sizeof(addr_));
+    const asio::ip::address_v6 addr6(bytes);
+    const IOAddress addr = IOAddress(asio::ip::address(addr6));
+    const uint8_t* hostname = data_ + duid_len_;
+    Lease6Ptr lease;
+    if (duid_len_ > 0) {
+        lease.reset(new Lease6(static_cast<Lease::Type>(type_), addr,
+                               DuidPtr(new DUID(data_, duid_len_)), iaid_,
+                               preferred_lft_, valid_lft_, t1_, t2_,
+                               subnet_id_, fqdn_fwd_, fqdn_rev_,
+                               std::string(hostname,
+                                           hostname + hostname_len_),
+                               prefixlen_));
+    } else {
+        // The constructors require a DUID.
+        lease.reset(new Lease6());
+        lease->addr_ = addr;
+        lease->type_ = static_cast<Lease::Type>(type_);
+        lease->prefixlen_ = prefixlen_;
+        lease->iaid_ = iaid_;
+        lease->preferred_lft_ = preferred_lft_;
+        lease->valid_lft_ = valid_lft_;
+        lease->t1_ = t1_;
+        lease->t2_ = t2_;
+        lease->subnet_id_ = subnet_id_;
+        lease->fqdn_fwd_ = fqdn_fwd_;
+        lease->fqdn_rev_ = fqdn_rev_;
+        lease->hostname_.assign(hostname, hostname + hostname_len_);
+    }
+    lease->cltt_ = cltt_;
+    return (lease);
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
@@ -0,0 +1,210 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef PACKED_LEASE_H
+#define PACKED_LEASE_H
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/identifier_key.h>
+#include <dhcpsrv/lease.h>
+
+#include <cstring>
+
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief The address of a DHCPv6 lease, as an index key.
+///
+/// The address is held in network byte order, so comparing the bytes
+/// orders the addresses as @c IOAddress does.
+struct Address6Key {
+    /// @brief Constructor.
+    ///
+    /// @param addr the address.
+    /// @throw BadValue if the address is not an IPv6 address.
+    explicit Address6Key(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Constructor from the bytes of the address.
+    explicit Address6Key(const uint8_t* bytes) {
+        std::memcpy(bytes_, bytes, sizeof(bytes_));
+    }
+
+    bool operator<(const Address6Key& other) const {
+        return (std::memcmp(bytes_, other.bytes_, sizeof(bytes_)) < 0);
+    }
+
+    uint8_t bytes_[16];
+};
+
+/// @brief A DHCPv4 lease in the compact form used by the memfile backend.
+///
+/// A @c Lease4 object holds its identifiers in vectors, the client id in
+/// an object of its own, and the hostname in a string, each of them being
+/// allocated separately.  This class holds the fixed-size fields of the
+/// lease in a record of a few dozen bytes, and the variable-length fields
+/// (hardware address, client id and hostname) in a single block.  A
+/// @c Lease4 is created from the record when the lease is returned to the
+/// caller.
+///
+/// The fields which the memfile backend doesn't store in its files (@c
+/// fixed_, @c comments_ and @c ext_) are not held either.
+class PackedLease4 {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param lease the lease to pack.
+    /// @throw BadValue if the address of the lease is not an IPv4 address,
+    /// or if an identifier or the hostname is too long.
+    explicit PackedLease4(const Lease4& lease);
+
+    /// @brief Copy constructor.
+    PackedLease4(const PackedLease4& other);
+
+    /// @brief Destructor.
+    ~PackedLease4() {
+        delete[] data_;
+    }
+
+    /// @brief Assignment operator.
+    PackedLease4& operator=(const PackedLease4& other);
+
+    /// @brief Returns the lease.
+    Lease4Ptr toLease() const;
+
+    /// @brief Returns the address of the lease.
+    uint32_t getAddress() const {
+        return (addr_);
+    }
+
+    /// @brief Returns the subnet id of the lease.
+    SubnetID getSubnetId() const {
+        return (subnet_id_);
+    }
+
+    /// @brief Returns the expiration time of the lease.
+    int64_t getExpirationTime() const {
+        return (static_cast<int64_t>(cltt_) + valid_lft_);
+    }
+
+    /// @brief Returns the key of the hardware address.
+    IdentifierKey getHWAddrKey() const {
+        return (IdentifierKey(data_, hwaddr_len_));
+    }
+
+    /// @brief Returns the key of the client id (empty if the lease has
+    /// none).
+    IdentifierKey getClientIdKey() const {
+        return (IdentifierKey(data_ + hwaddr_len_, client_id_len_));
+    }
+
+private:
+    /// @brief The hardware address, client id and hostname (in this
+    /// order), or NULL if they are all empty.
+    uint8_t* data_;
+    int64_t cltt_;
+    uint32_t addr_;
+    uint32_t t1_;
+    uint32_t t2_;
+    uint32_t valid_lft_;
+    SubnetID subnet_id_;
+    uint16_t hostname_len_;
+    uint8_t hwaddr_len_;
+    uint8_t client_id_len_;
+    bool fqdn_fwd_;
+    bool fqdn_rev_;
+};
+
+/// @brief A DHCPv6 lease in the compact form used by the memfile backend.
+///
+/// As with @c PackedLease4, the fixed-size fields are held in the record
+/// and the DUID and the hostname in a single block.
+class PackedLease6 {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param lease the lease to pack.
+    /// @throw BadValue if the address of the lease is not an IPv6 address,
+    /// or if the DUID or the hostname is too long.
+    explicit PackedLease6(const Lease6& lease);
+
+    /// @brief Copy constructor.
+    PackedLease6(const PackedLease6& other);
+
+    /// @brief Destructor.
+    ~PackedLease6() {
+        delete[] data_;
+    }
+
+    /// @brief Assignment operator.
+    PackedLease6& operator=(const PackedLease6& other);
+
+    /// @brief Returns the lease.
+    Lease6Ptr toLease() const;
+
+    /// @brief Returns the address of the lease.
+    Address6Key getAddress() const {
+        return (Address6Key(addr_));
+    }
+
+    /// @brief Returns the type of the lease.
+    Lease::Type getType() const {
+        return (static_cast<Lease::Type>(type_));
+    }
+
+    /// @brief Returns the IAID of the lease.
+    uint32_t getIaid() const {
+        return (iaid_);
+    }
+
+    /// @brief Returns the subnet id of the lease.
+    SubnetID getSubnetId() const {
+        return (subnet_id_);
+    }
+
+    /// @brief Returns the expiration time of the lease.
+    int64_t getExpirationTime() const {
+        return (static_cast<int64_t>(cltt_) + valid_lft_);
+    }
+
+    /// @brief Returns the key of the DUID.
+    IdentifierKey getDuidKey() const {
+        return (IdentifierKey(data_, duid_len_));
+    }
+
+private:
+    /// @brief The DUID and hostname (in this order), or NULL if they are
+    /// both empty.
+    uint8_t* data_;
+    int64_t cltt_;
+    uint8_t addr_[16];
+    uint32_t iaid_;
+    uint32_t t1_;
+    uint32_t t2_;
+    uint32_t preferred_lft_;
+    uint32_t valid_lft_;
+    SubnetID subnet_id_;
+    uint16_t hostname_len_;
+    uint8_t duid_len_;
+    uint8_t type_;
+    uint8_t prefixlen_;
+    bool fqdn_fwd_;
+    bool fqdn_rev_;
+};
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // PACKED_LEASE_H
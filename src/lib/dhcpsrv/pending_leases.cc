@@ -0,0 +1,183 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/pending_leases.h>
+
+#include <limits>
+
+using namespace bundy::asiolink;
+
+namespace bundy {
+namespace dhcp {
+
+IdentifierKey
+PendingLeases::Entry::getHWAddrKey() const {
+    if (!lease4_) {
+        return (IdentifierKey(NULL, 0));
+    }
+    return (IdentifierKey(lease4_->hwaddr_));
+}
+
+IdentifierKey
+PendingLeases::Entry::getClientIdKey() const {
+    if (!lease4_ || !lease4_->client_id_) {
+        return (IdentifierKey(NULL, 0));
+    }
+    return (IdentifierKey(lease4_->client_id_->getClientId()));
+}
+
+IdentifierKey
+PendingLeases::Entry::getDuidKey() const {
+    if (!lease6_ || !lease6_->duid_) {
+        return (IdentifierKey(NULL, 0));
+    }
+    return (IdentifierKey(lease6_->duid_->getDuid()));
+}
+
+SubnetID
+PendingLeases::Entry::getSubnetId() const {
+    if (lease4_) {
+        return (lease4_->subnet_id_);
+    } else if (lease6_) {
+        return (lease6_->subnet_id_);
+    }
+    return (0);
+}
+
+int64_t
+PendingLeases::Entry::getExpirationTime() const {
+    if (lease4_) {
+        return (lease4_->getExpirationTime());
+    } else if (lease6_) {
+        return (lease6_->getExpirationTime());
+    }
+    // The deletions are never expired.
+    return (std::numeric_limits<int64_t>::max());
+}
+
+void
+PendingLeases::set(const Lease4Ptr& lease, uint64_t sequence) {
+    Entry entry(lease->addr_, sequence);
+    entry.lease4_ = copy(lease);
+    store(entry);
+}
+
+void
+PendingLeases::set(const Lease6Ptr& lease, uint64_t sequence) {
+    Entry entry(lease->addr_, sequence);
+    entry.lease6_ = copy(lease);
+    store(entry);
+}
+
+void
+PendingLeases::remove(const IOAddress& addr, uint64_t sequence) {
+    store(Entry(addr, sequence));
+}
+
+void
+PendingLeases::store(const Entry& entry) {
+    EntryStorage::iterator existing = entries_.find(entry.addr_);
+    if (existing == entries_.end()) {
+        entries_.insert(entry);
+    } else {
+        entries_.replace(existing, entry);
+    }
+}
+
+void
+PendingLeases::getAll(Lease4Collection& leases4, Lease6Collection& leases6,
+                      std::vector<IOAddress>& deleted) const {
+    leases4.clear();
+    leases6.clear();
+    deleted.clear();
+    for (EntryStorage::const_iterator entry = entries_.begin();
+         entry != entries_.end(); ++entry) {
+        if (entry->lease4_) {
+            leases4.push_back(entry->lease4_);
+        } else if (entry->lease6_) {
+            leases6.push_back(entry->lease6_);
+        } else {
+            deleted.push_back(entry->addr_);
+        }
+    }
+}
+
+void
+PendingLeases::erase(uint64_t last) {
+    EntryStorage::nth_index<1>::type& index = entries_.get<1>();
+    index.erase(index.begin(), index.upper_bound(last));
+}
+
+void
+PendingLeases::select(const HWAddrMatch& match,
+                      Lease4Collection& leases) const {
+    selectRange(entries_.get<2>().equal_range(IdentifierKey(match.hwaddr_)),
+                match, leases);
+}
+
+void
+PendingLeases::select(const ClientIdMatch& match,
+                      Lease4Collection& leases) const {
+    const IdentifierKey key(match.client_id_.getClientId());
+    if (match.any_subnet_) {
+        selectRange(entries_.get<3>().equal_range(key), match, leases);
+    } else {
+        selectRange(entries_.get<4>().equal_range(
+                        boost::make_tuple(key, match.subnet_id_)),
+                    match, leases);
+    }
+}
+
+void
+PendingLeases::select(const RangeMatch& match,
+                      Lease4Collection& leases) const {
+    if (match.upper_ < match.lower_) {
+        return;
+    }
+    selectRange(entries_.lower_bound(match.lower_),
+                entries_.upper_bound(match.upper_), match, leases);
+}
+
+void
+PendingLeases::select(const ExpiredMatch& match,
+                      Lease4Collection& leases) const {
+    const EntryStorage::nth_index<7>::type& index = entries_.get<7>();
+    selectRange(index.begin(), index.lower_bound(match.now_), match, leases);
+}
+
+void
+PendingLeases::select(const DuidIaidMatch& match,
+                      Lease6Collection& leases) const {
+    const IdentifierKey key(match.duid_.getDuid());
+    if (match.any_subnet_) {
+        selectRange(entries_.get<5>().equal_range(
+                        boost::make_tuple(key, match.iaid_)),
+                    match, leases);
+    } else {
+        selectRange(entries_.get<6>().equal_range(
+                        boost::make_tuple(key, match.iaid_,
+                                          match.subnet_id_)),
+                    match, leases);
+    }
+}
+
+void
+PendingLeases::select(const ExpiredMatch& match,
+                      Lease6Collection& leases) const {
+    const EntryStorage::nth_index<7>::type& index = entries_.get<7>();
+    selectRange(index.begin(), index.lower_bound(match.now_), match, leases);
+}
+
+} // namespace dhcp
+} // namespace bundy
@@ -0,0 +1,462 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef PENDING_LEASES_H
+#define PENDING_LEASES_H
+
+#include <asiolink/io_address.h>
+#include <dhcp/duid.h>
+#include <dhcpsrv/identifier_key.h>
+#include <dhcpsrv/lease.h>
+
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/indexed_by.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/tuple/tuple.hpp>
+
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Leases written but not in the database yet
+///
+/// Holds the last state of each address written: the lease added or
+/// updated, or nothing if the lease was deleted.  Each write is numbered
+/// by the caller, so the entries written to the database can be told apart
+/// from those changed while they were written.
+///
+/// The queries of a lease manager merge these leases with the leases of the
+/// database.  The entries are indexed by the keys of the queries (hardware
+/// address, client identifier, DUID and IAID, with or without the subnet,
+/// address and expiration time), so a query only looks at the matching
+/// entries, however many are pending.
+///
+/// The leases are copied when stored and when returned, so the callers may
+/// change them.  The class is not thread safe.
+class PendingLeases {
+public:
+    /// @brief Matches the IPv4 leases of a hardware address
+    class HWAddrMatch {
+    public:
+        /// @brief Constructor for the leases of all the subnets
+        HWAddrMatch(const std::vector<uint8_t>& hwaddr) :
+            hwaddr_(hwaddr), subnet_id_(0), any_subnet_(true)
+        {}
+
+        /// @brief Constructor for the leases of a subnet
+        HWAddrMatch(const std::vector<uint8_t>& hwaddr, SubnetID subnet_id) :
+            hwaddr_(hwaddr), subnet_id_(subnet_id), any_subnet_(false)
+        {}
+
+        bool operator()(const Lease4& lease) const {
+            return ((lease.hwaddr_ == hwaddr_) &&
+                    (any_subnet_ || (lease.subnet_id_ == subnet_id_)));
+        }
+
+    private:
+        friend class PendingLeases;
+
+        const std::vector<uint8_t>& hwaddr_;
+        const SubnetID subnet_id_;
+        const bool any_subnet_;
+    };
+
+    /// @brief Matches the IPv4 leases of a client identifier
+    class ClientIdMatch {
+    public:
+        /// @brief Constructor for the leases of all the subnets
+        ClientIdMatch(const ClientId& client_id) :
+            client_id_(client_id), subnet_id_(0), any_subnet_(true)
+        {}
+
+        /// @brief Constructor for the leases of a subnet
+        ClientIdMatch(const ClientId& client_id, SubnetID subnet_id) :
+            client_id_(client_id), subnet_id_(subnet_id), any_subnet_(false)
+        {}
+
+        bool operator()(const Lease4& lease) const {
+            return (lease.client_id_ && (*lease.client_id_ == client_id_) &&
+                    (any_subnet_ || (lease.subnet_id_ == subnet_id_)));
+        }
+
+    private:
+        friend class PendingLeases;
+
+        const ClientId& client_id_;
+        const SubnetID subnet_id_;
+        const bool any_subnet_;
+    };
+
+    /// @brief Matches the IPv4 leases of a range of addresses
+    class RangeMatch {
+    public:
+        RangeMatch(const bundy::asiolink::IOAddress& lower,
+                   const bundy::asiolink::IOAddress& upper) :
+            lower_(lower), upper_(upper)
+        {}
+
+        bool operator()(const Lease4& lease) const {
+            return ((lower_ <= lease.addr_) && (lease.addr_ <= upper_));
+        }
+
+    private:
+        friend class PendingLeases;
+
+        const bundy::asiolink::IOAddress& lower_;
+        const bundy::asiolink::IOAddress& upper_;
+    };
+
+    /// @brief Matches the IPv6 leases of a DUID and IAID
+    class DuidIaidMatch {
+    public:
+        /// @brief Constructor for the leases of all the subnets
+        DuidIaidMatch(Lease::Type type, const DUID& duid, uint32_t iaid) :
+            type_(type), duid_(duid), iaid_(iaid), subnet_id_(0),
+            any_subnet_(true)
+        {}
+
+        /// @brief Constructor for the leases of a subnet
+        DuidIaidMatch(Lease::Type type, const DUID& duid, uint32_t iaid,
+                      SubnetID subnet_id) :
+            type_(type), duid_(duid), iaid_(iaid), subnet_id_(subnet_id),
+            any_subnet_(false)
+        {}
+
+        bool operator()(const Lease6& lease) const {
+            return ((lease.type_ == type_) && (lease.iaid_ == iaid_) &&
+                    lease.duid_ && (*lease.duid_ == duid_) &&
+                    (any_subnet_ || (lease.subnet_id_ == subnet_id_)));
+        }
+
+    private:
+        friend class PendingLeases;
+
+        const Lease::Type type_;
+        const DUID& duid_;
+        const uint32_t iaid_;
+        const SubnetID subnet_id_;
+        const bool any_subnet_;
+    };
+
+    /// @brief Matches the leases expired at a time
+    class ExpiredMatch {
+    public:
+        ExpiredMatch(int64_t now) :
+            now_(now)
+        {}
+
+        bool operator()(const Lease& lease) const {
+            return (lease.getExpirationTime() < now_);
+        }
+
+    private:
+        friend class PendingLeases;
+
+        const int64_t now_;
+    };
+
+    /// @brief Returns the number of pending addresses
+    size_t size() const {
+        return (entries_.size());
+    }
+
+    /// @brief Checks if there is no pending address
+    bool empty() const {
+        return (entries_.empty());
+    }
+
+    /// @brief Checks if an address is pending
+    bool contains(const bundy::asiolink::IOAddress& addr) const {
+        return (entries_.find(addr) != entries_.end());
+    }
+
+    /// @brief Returns the pending lease of an address
+    ///
+    /// @param addr The address.
+    /// @param [out] lease A copy of the pending lease, null if the lease
+    ///        was deleted.
+    ///
+    /// @return true if the address is pending, else the database has the
+    ///         lease of the address (if any).
+    template <typename LeasePtr>
+    bool find(const bundy::asiolink::IOAddress& addr, LeasePtr& lease) const {
+        EntryStorage::const_iterator entry = entries_.find(addr);
+        if (entry == entries_.end()) {
+            return (false);
+        }
+        LeasePtr pending;
+        entry->get(pending);
+        lease = copy(pending);
+        return (true);
+    }
+
+    /// @brief Stores a lease added or updated
+    ///
+    /// @param lease The lease, which is copied.
+    /// @param sequence Number of the write, greater than the numbers of the
+    ///        writes stored before.
+    void set(const Lease4Ptr& lease, uint64_t sequence);
+
+    /// @brief Stores a lease added or updated
+    ///
+    /// @param lease The lease, which is copied.
+    /// @param sequence Number of the write, greater than the numbers of the
+    ///        writes stored before.
+    void set(const Lease6Ptr& lease, uint64_t sequence);
+
+    /// @brief Stores the deletion of the lease of an address
+    ///
+    /// @param addr The address.
+    /// @param sequence Number of the write, greater than the numbers of the
+    ///        writes stored before.
+    void remove(const bundy::asiolink::IOAddress& addr, uint64_t sequence);
+
+    /// @brief Returns all the pending writes
+    ///
+    /// @param [out] leases4 The IPv4 leases added or updated.
+    /// @param [out] leases6 The IPv6 leases added or updated.
+    /// @param [out] deleted The addresses of the leases deleted.
+    void getAll(Lease4Collection& leases4, Lease6Collection& leases6,
+                std::vector<bundy::asiolink::IOAddress>& deleted) const;
+
+    /// @brief Removes the writes written to the database
+    ///
+    /// @param last Number of the last write written.  The addresses written
+    ///        again since stay pending.
+    void erase(uint64_t last);
+
+    /// @brief Merges the pending leases with leases of the database
+    ///
+    /// The leases of the pending addresses are removed, then copies of the
+    /// pending leases matching the query are added.
+    ///
+    /// @param [in,out] leases The leases of the database matching a query.
+    /// @param match The query, one of the match classes above.
+    template <typename LeasePtr, typename Match>
+    void merge(std::vector<LeasePtr>& leases, const Match& match) const {
+        if (entries_.empty()) {
+            return;
+        }
+        std::vector<LeasePtr> merged;
+        for (typename std::vector<LeasePtr>::const_iterator lease =
+                 leases.begin(); lease != leases.end(); ++lease) {
+            if (!contains((*lease)->addr_)) {
+                merged.push_back(*lease);
+            }
+        }
+        select(match, merged);
+        leases.swap(merged);
+    }
+
+    /// @brief Merges the pending leases with a lease of the database
+    ///
+    /// @param [in,out] lease The lease of the database matching a query
+    ///        (null if none), replaced by the first matching pending lease
+    ///        if its address is pending.
+    /// @param match The query, one of the match classes above.
+    template <typename LeasePtr, typename Match>
+    void mergeSingle(LeasePtr& lease, const Match& match) const {
+        std::vector<LeasePtr> leases;
+        if (lease) {
+            leases.push_back(lease);
+        }
+        merge(leases, match);
+        lease = leases.empty() ? LeasePtr() : leases.front();
+    }
+
+private:
+    /// @brief State of an address
+    ///
+    /// Either lease is set, or none if the lease was deleted.  The keys of
+    /// the identifiers point to the bytes of the lease, which is not
+    /// changed while it is stored.
+    struct Entry {
+        Entry(const bundy::asiolink::IOAddress& addr, uint64_t sequence) :
+            addr_(addr), sequence_(sequence)
+        {}
+
+        void get(Lease4Ptr& lease) const {
+            lease = lease4_;
+        }
+
+        void get(Lease6Ptr& lease) const {
+            lease = lease6_;
+        }
+
+        /// @brief Returns the hardware address of an IPv4 lease
+        IdentifierKey getHWAddrKey() const;
+
+        /// @brief Returns the client identifier of an IPv4 lease
+        IdentifierKey getClientIdKey() const;
+
+        /// @brief Returns the DUID of an IPv6 lease
+        IdentifierKey getDuidKey() const;
+
+        /// @brief Returns the IAID of an IPv6 lease
+        uint32_t getIaid() const {
+            return (lease6_ ? lease6_->iaid_ : 0);
+        }
+
+        /// @brief Returns the subnet of the lease
+        SubnetID getSubnetId() const;
+
+        /// @brief Returns the expiration time of the lease
+        int64_t getExpirationTime() const;
+
+        bundy::asiolink::IOAddress addr_;
+        uint64_t sequence_;     ///< Number of the last write
+        Lease4Ptr lease4_;
+        Lease6Ptr lease6_;
+    };
+
+    /// @brief The entries, indexed by the keys of the queries
+    typedef boost::multi_index_container<
+        Entry,
+        boost::multi_index::indexed_by<
+            // The first index sorts the entries by address, to find an
+            // address and the ranges of addresses.
+            boost::multi_index::ordered_unique<
+                boost::multi_index::member<Entry, bundy::asiolink::IOAddress,
+                                           &Entry::addr_>
+            >,
+
+            // The second index sorts the entries by number of the write, to
+            // remove those written.
+            boost::multi_index::ordered_unique<
+                boost::multi_index::member<Entry, uint64_t,
+                                           &Entry::sequence_>
+            >,
+
+            // The third index finds the IPv4 leases of a hardware address.
+            // The leases of a subnet are selected among them, a client
+            // having few leases.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::const_mem_fun<Entry, IdentifierKey,
+                                                  &Entry::getHWAddrKey>
+            >,
+
+            // The fourth index finds the IPv4 leases of a client
+            // identifier.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::const_mem_fun<Entry, IdentifierKey,
+                                                  &Entry::getClientIdKey>
+            >,
+
+            // The fifth index finds the IPv4 leases of a client identifier
+            // in a subnet.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::composite_key<
+                    Entry,
+                    boost::multi_index::const_mem_fun<
+                        Entry, IdentifierKey, &Entry::getClientIdKey>,
+                    boost::multi_index::const_mem_fun<
+                        Entry, SubnetID, &Entry::getSubnetId>
+                >
+            >,
+
+            // The sixth index finds the IPv6 leases of a DUID and IAID.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::composite_key<
+                    Entry,
+                    boost::multi_index::const_mem_fun<
+                        Entry, IdentifierKey, &Entry::getDuidKey>,
+                    boost::multi_index::const_mem_fun<
+                        Entry, uint32_t, &Entry::getIaid>
+                >
+            >,
+
+            // The seventh index finds the IPv6 leases of a DUID and IAID
+            // in a subnet.
+            boost::multi_index::hashed_non_unique<
+                boost::multi_index::composite_key<
+                    Entry,
+                    boost::multi_index::const_mem_fun<
+                        Entry, IdentifierKey, &Entry::getDuidKey>,
+                    boost::multi_index::const_mem_fun<
+                        Entry, uint32_t, &Entry::getIaid>,
+                    boost::multi_index::const_mem_fun<
+                        Entry, SubnetID, &Entry::getSubnetId>
+                >
+            >,
+
+            // The eighth index sorts the entries by expiration time, to
+            // find the expired leases.
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::const_mem_fun<
+                    Entry, int64_t, &Entry::getExpirationTime>
+            >
+        >
+    > EntryStorage;
+
+    /// @brief Returns a copy of a lease (or null)
+    template <typename LeasePtr>
+    static LeasePtr copy(const LeasePtr& lease) {
+        if (!lease) {
+            return (LeasePtr());
+        }
+        return (LeasePtr(new typename LeasePtr::element_type(*lease)));
+    }
+
+    /// @brief Stores an entry, replacing the entry of its address
+    void store(const Entry& entry);
+
+    /// @brief Adds copies of the leases of a range of entries which match
+    template <typename Iterator, typename LeasePtr, typename Match>
+    static void selectRange(Iterator begin, Iterator end,
+                            const Match& match,
+                            std::vector<LeasePtr>& leases) {
+        for (; begin != end; ++begin) {
+            LeasePtr lease;
+            begin->get(lease);
+            if (lease && match(*lease)) {
+                leases.push_back(copy(lease));
+            }
+        }
+    }
+
+    /// @brief Adds copies of the leases of a range of entries which match
+    template <typename Iterator, typename LeasePtr, typename Match>
+    static void selectRange(const std::pair<Iterator, Iterator>& range,
+                            const Match& match,
+                            std::vector<LeasePtr>& leases) {
+        selectRange(range.first, range.second, match, leases);
+    }
+
+    /// @brief Adds copies of the pending leases matching a query
+    ///
+    /// There is a function for each query, which looks up the matching
+    /// entries in the index of the query.
+    void select(const HWAddrMatch& match, Lease4Collection& leases) const;
+    void select(const ClientIdMatch& match, Lease4Collection& leases) const;
+    void select(const RangeMatch& match, Lease4Collection& leases) const;
+    void select(const ExpiredMatch& match, Lease4Collection& leases) const;
+    void select(const DuidIaidMatch& match, Lease6Collection& leases) const;
+    void select(const ExpiredMatch& match, Lease6Collection& leases) const;
+
+    EntryStorage entries_;
+};
+
+} // namespace dhcp
+} // namespace bundy
+
+#endif // PENDING_LEASES_H
@@ -24,6 +24,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <time.h>
@@ -75,14 +76,14 @@ TaggedStatement tagged_statements[] = {
         { 20 },
         "get_lease4_addr",
      "SELECT address, hwaddr, client_id, "
-     "valid_lifetime, extract(epoch from expire), subnet_id, fqdn_fwd, fqdn_rev, hostname "
+     "valid_lifetime, extract(epoch from expire)::bigint, subnet_id, fqdn_fwd, fqdn_rev, hostname "
      "FROM lease4 "
      "WHERE address = $1"},
     {PgSqlLeaseMgr::GET_LEASE4_CLIENTID, 1,
         { 17 },
         "get_lease4_clientid",
      "SELECT address, hwaddr, client_id, "
-     "valid_lifetime, extract(epoch from expire), subnet_id, fqdn_fwd, fqdn_rev, hostname "
+     "valid_lifetime, extract(epoch from expire)::bigint, subnet_id, fqdn_fwd, fqdn_rev, hostname "
      "FROM lease4 "
      "WHERE client_id = $1"},
     {PgSqlLeaseMgr::GET_LEASE4_CLIENTID_SUBID, 2,
@@ -92,6 +93,14 @@ TaggedStatement tagged_statements[] = {
      "valid_lifetime, extract(epoch from expire)::bigint, subnet_id, fqdn_fwd, fqdn_rev, hostname "
      "FROM lease4 "
      "WHERE client_id = $1 AND subnet_id = $2"},
+    {PgSqlLeaseMgr::GET_LEASE4_EXPIRE, 2,
+        { 20, 20 },
+        "get_lease4_expire",
+     "SELECT address, hwaddr, client_id, "
+     "valid_lifetime, extract(epoch from expire)::bigint, subnet_id, fqdn_fwd, fqdn_rev, hostname "
+     "FROM lease4 "
+     "WHERE expire < to_timestamp($1) "
+     "ORDER BY expire LIMIT $2"},
     {PgSqlLeaseMgr::GET_LEASE4_HWADDR, 1,
          { 17 },
          "get_lease4_hwaddr",
@@ -106,6 +115,14 @@ TaggedStatement tagged_statements[] = {
      "valid_lifetime, extract(epoch from expire)::bigint, subnet_id, fqdn_fwd, fqdn_rev, hostname "
      "FROM lease4 "
      "WHERE hwaddr = $1 AND subnet_id = $2"},
+    {PgSqlLeaseMgr::GET_LEASE4_RANGE, 2,
+         { 20, 20 },
+         "get_lease4_range",
+     "SELECT address, hwaddr, client_id, "
+     "valid_lifetime, extract(epoch from expire)::bigint, subnet_id, fqdn_fwd, fqdn_rev, hostname "
+     "FROM lease4 "
+     "WHERE address BETWEEN $1 AND $2 "
+     "ORDER BY address"},
     {PgSqlLeaseMgr::GET_LEASE6_ADDR, 2,
         { 1043, 21 },
         "get_lease6_addr",
@@ -130,35 +147,45 @@ TaggedStatement tagged_statements[] = {
      "lease_type, iaid, prefix_len, fqdn_fwd, fqdn_rev, hostname "
      "FROM lease6 "
      "WHERE lease_type = $1 AND duid = $2 AND iaid = $3 AND subnet_id = $4"},
+    {PgSqlLeaseMgr::GET_LEASE6_EXPIRE, 2,
+        { 20, 20 },
+        "get_lease6_expire",
+     "SELECT address, duid, valid_lifetime, "
+     "extract(epoch from expire)::bigint, subnet_id, pref_lifetime, "
+     "lease_type, iaid, prefix_len, fqdn_fwd, fqdn_rev, hostname "
+     "FROM lease6 "
+     "WHERE expire < to_timestamp($1) "
+     "ORDER BY expire LIMIT $2"},
     {PgSqlLeaseMgr::GET_VERSION, 0,
         { 0 },
      "get_version",
      "SELECT version, minor FROM schema_version"},
     {PgSqlLeaseMgr::INSERT_LEASE4, 9,
-         { 20, 17, 17, 20, 1114, 20, 16, 16, 1043 },
+         { 20, 17, 17, 20, 20, 20, 16, 16, 1043 },
          "insert_lease4",
      "INSERT INTO lease4(address, hwaddr, client_id, "
      "valid_lifetime, expire, subnet_id, fqdn_fwd, fqdn_rev, hostname) "
-     "VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9)"},
+     "VALUES ($1, $2, $3, $4, to_timestamp($5), $6, $7, $8, $9)"},
     {PgSqlLeaseMgr::INSERT_LEASE6, 12,
-        { 1043, 17, 20, 1114, 20, 20, 21, 20, 21, 16, 16, 1043 },
+        { 1043, 17, 20, 20, 20, 20, 21, 20, 21, 16, 16, 1043 },
         "insert_lease6",
      "INSERT INTO lease6(address, duid, valid_lifetime, "
      "expire, subnet_id, pref_lifetime, "
      "lease_type, iaid, prefix_len, fqdn_fwd, fqdn_rev, hostname) "
-     "VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12)"},
+     "VALUES ($1, $2, $3, to_timestamp($4), $5, $6, $7, $8, $9, $10, $11, "
+     "$12)"},
     {PgSqlLeaseMgr::UPDATE_LEASE4, 10,
-        { 20, 17, 17, 20, 1114, 20, 16, 16, 1043, 20 },
+        { 20, 17, 17, 20, 20, 20, 16, 16, 1043, 20 },
         "update_lease4",
      "UPDATE lease4 SET address = $1, hwaddr = $2, "
-     "client_id = $3, valid_lifetime = $4, expire = $5, "
+     "client_id = $3, valid_lifetime = $4, expire = to_timestamp($5), "
      "subnet_id = $6, fqdn_fwd = $7, fqdn_rev = $8, hostname = $9 "
      "WHERE address = $10"},
     {PgSqlLeaseMgr::UPDATE_LEASE6, 13,
-        { 1043, 17, 20, 1114, 20, 20, 21, 20, 21, 16, 16, 1043, 1043 },
+        { 1043, 17, 20, 20, 20, 20, 21, 20, 21, 16, 16, 1043, 1043 },
         "update_lease6",
      "UPDATE lease6 SET address = $1, duid = $2, "
-     "valid_lifetime = $3, expire = $4, subnet_id = $5, "
+     "valid_lifetime = $3, expire = to_timestamp($4), subnet_id = $5, "
      "pref_lifetime = $6, lease_type = $7, iaid = $8, "
      "prefix_len = $9, fqdn_fwd = $10, fqdn_rev = $11, hostname = $12 "
      "WHERE address = $13"},
@@ -167,72 +194,153 @@ TaggedStatement tagged_statements[] = {
     {PgSqlLeaseMgr::NUM_STATEMENTS, 0,  { 0 }, NULL, NULL}
 };
 
+/// @brief Maximum number of statements sent before reading their results
+///
+/// The batches of statements are split in pipelines of this size, which
+/// bounds the memory used for the results waiting to be read.
+const size_t MAX_PIPELINE_DEPTH = 256;
+
+/// @brief SQLSTATE of the unique constraint violations
+const char* const UNIQUE_VIOLATION = "23505";
+
+/// @brief Creates a parameter in the binary format of an integer type
+///
+/// The PostgreSQL binary format of the integers is big endian.  The type
+/// must have the size of the type of the parameter in the statement
+/// (int16_t for 21, int32_t for 23 and int64_t for 20).
+///
+/// @param value value of the parameter.
+template<typename IntType>
+PgSqlParam
+integerParam(IntType value) {
+    uint8_t data[sizeof(IntType)];
+    uint64_t bits = static_cast<uint64_t>(value);
+    for (int i = sizeof(IntType) - 1; i >= 0; --i) {
+        data[i] = static_cast<uint8_t>(bits & 0xff);
+        bits >>= 8;
+    }
+    return (PgSqlParam(data, sizeof(data)));
+}
+
+/// @brief Creates a parameter in the binary format of a boolean
+///
+/// @param value value of the parameter.
+PgSqlParam
+boolParam(bool value) {
+    const uint8_t data = value ? 1 : 0;
+    return (PgSqlParam(&data, sizeof(data)));
+}
+
+/// @brief Checks if a statement failed because of a duplicate key
+///
+/// @param r result of the statement.
+bool
+isDuplicateKey(const PGresult* r) {
+    const char* sqlstate = PQresultErrorField(r, PG_DIAG_SQLSTATE);
+    return (sqlstate && (strcmp(sqlstate, UNIQUE_VIOLATION) == 0));
+}
+
+/// @brief Binds the parameters of the expired leases queries
+///
+/// The leases expired now are selected, up to a maximum number.
+///
+/// @param max_leases Maximum number of leases (0 for no limit)
+/// @param [out] params The parameters to bind.
+void
+bindExpiredParams(size_t max_leases, BindParams& params) {
+    params.push_back(integerParam<int64_t>(time(NULL)));
+
+    // There is no way to bind "no limit", so use the largest one.
+    if (max_leases == 0) {
+        params.push_back(integerParam(numeric_limits<int64_t>::max()));
+    } else {
+        params.push_back(integerParam<int64_t>(max_leases));
+    }
+}
+
 };
 
 namespace bundy {
 namespace dhcp {
 
 /// @brief Auxiliary PostgreSQL exchange class
+///
+/// The leases are exchanged in the binary format: the integers and the
+/// booleans are sent and received in network byte order rather than
+/// formatted as text, and the binary data is not escaped.
 class PgSqlLeaseExchange {
 protected:
 
-    /// @brief Converts time_t structure to a text representation in local time.
+    /// @brief Returns an integer column of a result row
     ///
-    /// The format of the output string is "%Y-%m-%d %H:%M:%S".  Database
-    /// table columns using this value should be typed as TIMESTAMP WITH
-    /// TIME ZONE. For such columns Postgres assumes input strings without
-    /// timezones should be treated as in local time and are converted to UTC
-    /// when stored.  Likewise, these columns are automatically adjusted
-    /// upon retrieval unless fetched via "extract(epoch from <column>))".
+    /// The column must have the size of the type (e.g. int64_t for a
+    /// BIGINT column).  A NULL value is returned as 0.
     ///
-    /// @param time_val timestamp to be converted
-    /// @return std::string containing the stringified time
-    std::string
-    convertToDatabaseTime(const time_t& time_val) {
-        struct tm tinfo;
-        char buffer[20];
-        localtime_r(&time_val, &tinfo);
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tinfo);
-        return (std::string(buffer));
+    /// @param r result of the query
+    /// @param line row of the result
+    /// @param col column of the row
+    ///
+    /// @return Value of the column.
+    /// @throw BadValue if the column does not have the size of the type.
+    template<typename IntType>
+    IntType getInteger(const PGresult* r, int line, int col) const {
+        if (PQgetisnull(r, line, col)) {
+            return (0);
+        }
+        const int len = PQgetlength(r, line, col);
+        if (len != sizeof(IntType)) {
+            bundy_throw(BadValue, "column " << columns_[col] << " has "
+                        << len << " bytes, " << sizeof(IntType)
+                        << " were expected");
+        }
+        const uint8_t* data =
+            reinterpret_cast<const uint8_t*>(PQgetvalue(r, line, col));
+        uint64_t bits = 0;
+        for (int i = 0; i < len; ++i) {
+            bits = (bits << 8) | data[i];
+        }
+        return (static_cast<IntType>(bits));
     }
 
-    /// @brief Converts time stamp from the database to a time_t
+    /// @brief Returns a boolean column of a result row
     ///
-    /// @param db_time_val timestamp to be converted.  This value
-    /// is expected to be the number of seconds since the epoch
-    /// expressed as base-10 integer string.
-    /// @return Converted timestamp as time_t value.
-    time_t convertFromDatabaseTime(const std::string& db_time_val) {
-        // Convert string time value to time_t
-        try  {
-            return (boost::lexical_cast<time_t>(db_time_val));
-        } catch (const std::exception& ex) {
-            bundy_throw(BadValue, "Database time value is invalid: "
-                                << db_time_val);
-        }
+    /// A NULL value is returned as false.
+    ///
+    /// @param r result of the query
+    /// @param line row of the result
+    /// @param col column of the row
+    bool getBool(const PGresult* r, int line, int col) const {
+        return (getInteger<uint8_t>(r, line, col) != 0);
     }
 
-    /// @brief Converts Postgres text boolean representations to bool
+    /// @brief Returns a binary or text column of a result row
     ///
-    /// Allowed values are "t" or "f", or "" which is false.
-    //  Any other will throw.
-    /// @param value text value to be converted
-    /// @throw BadValue if passed any value other than "t" or "f"
-    bool stringToBool(char* value) {
-        if (!value || !strlen(value)) {
-            return (false);
-        }
-        switch (value[0]) {
-        case 't':
-            return (true);
-        case 'f':
-            return (false);
-        default:
-            bundy_throw(BadValue, "Received " << value[0] << " as boolean. The "
-                      " only accepted values are 't', 'f' or ''");
-        }
+    /// @param r result of the query
+    /// @param line row of the result
+    /// @param col column of the row
+    /// @param [out] len length of the column (0 for NULL).
+    ///
+    /// @return Pointer to the data of the column, which belongs to the
+    /// result.
+    const uint8_t* getData(const PGresult* r, int line, int col,
+                           size_t& len) const {
+        len = PQgetlength(r, line, col);
+        return (reinterpret_cast<const uint8_t*>(PQgetvalue(r, line, col)));
+    }
+
+    /// @brief Returns a text column of a result row
+    ///
+    /// @param r result of the query
+    /// @param line row of the result
+    /// @param col column of the row
+    std::string getString(const PGresult* r, int line, int col) const {
+        return (std::string(PQgetvalue(r, line, col),
+                            PQgetlength(r, line, col)));
     }
 
+    /// Names of the columns (for error messages)
+    std::vector<std::string> columns_;
+
     /// Compiled statement bind parameters
     BindParams params;
 };
@@ -246,11 +354,9 @@ private:
 public:
 
     /// @brief Default constructor
-    PgSqlLease4Exchange() : addr4_(0), hwaddr_length_(0), client_id_length_(0) {
-        memset(hwaddr_buffer_, 0, sizeof(hwaddr_buffer_));
-        memset(client_id_buffer_, 0, sizeof(client_id_buffer_));
-
+    PgSqlLease4Exchange() {
         // Set the column names (for error messages)
+        columns_.resize(LEASE_COLUMNS);
         columns_[0] = "address";
         columns_[1] = "hwaddr";
         columns_[2] = "client_id";
@@ -261,24 +367,19 @@ public:
         columns_[7] = "fqdn_rev";
         columns_[8] = "hostname";
 
-        BOOST_STATIC_ASSERT(8 < LEASE_COLUMNS);
-
         params.reserve(LEASE_COLUMNS);
     }
 
     BindParams
     createBindForSend(const Lease4Ptr& lease) {
-        lease_ = lease;
         params.clear();
-        ostringstream tmp;
 
-        tmp << static_cast<uint32_t>(lease_->addr_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
+        params.push_back(integerParam<int64_t>(
+                             static_cast<uint32_t>(lease->addr_)));
 
         // Although HWADDR object will always be there, it may be just an
         // empty vector
-        if (!lease_->hwaddr_.empty()) {
+        if (!lease->hwaddr_.empty()) {
             if (lease->hwaddr_.size() > HWAddr::MAX_HWADDR_LEN) {
                 bundy_throw(DbOperationError,
                           "Hardware address length : "
@@ -287,100 +388,57 @@ public:
                           << HWAddr::MAX_HWADDR_LEN);
             }
 
-            params.push_back(PgSqlParam(lease_->hwaddr_));
+            params.push_back(PgSqlParam(lease->hwaddr_));
         } else {
             params.push_back(PgSqlParam());
         }
 
-        if (lease_->client_id_) {
-            params.push_back(PgSqlParam(lease_->client_id_->getClientId()));
+        if (lease->client_id_) {
+            params.push_back(PgSqlParam(lease->client_id_->getClientId()));
         } else {
             params.push_back(PgSqlParam());
         }
 
-        tmp << static_cast<unsigned long>(lease_->valid_lft_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
-
-        time_t expire = lease_->valid_lft_ + lease_->cltt_;
-        params.push_back(PgSqlParam(convertToDatabaseTime(expire)));
+        params.push_back(integerParam<int64_t>(lease->valid_lft_));
 
-        tmp << static_cast<unsigned long>(lease_->subnet_id_);
-        params.push_back(PgSqlParam(tmp.str()));
+        // The expiration time is sent as seconds since the epoch, which
+        // the statements convert with to_timestamp().
+        params.push_back(integerParam<int64_t>(lease->cltt_ +
+                                               lease->valid_lft_));
 
-        params.push_back(PgSqlParam(lease_->fqdn_fwd_ ? "TRUE" : "FALSE"));
-        params.push_back(PgSqlParam(lease_->fqdn_rev_ ? "TRUE" : "FALSE"));
-        params.push_back(PgSqlParam(lease_->hostname_));
+        params.push_back(integerParam<int64_t>(lease->subnet_id_));
+        params.push_back(boolParam(lease->fqdn_fwd_));
+        params.push_back(boolParam(lease->fqdn_rev_));
+        params.push_back(PgSqlParam(lease->hostname_));
 
         return (params);
     }
 
     Lease4Ptr
-    convertFromDatabase(PGresult *& r, int line) {
-        const char* addr4_str = PQgetvalue(r, line, 0);
-        unsigned char* hwaddr_str = PQunescapeBytea((const unsigned char *)
-                                                    PQgetvalue(r, line, 1),
-                                                    & hwaddr_length_);
-        unsigned char* client_id_str = PQunescapeBytea((const unsigned char *)
-                                                       PQgetvalue(r, line, 2),
-                                                       & client_id_length_);
-        const char* valid_lifetime_str = PQgetvalue(r, line, 3);
-        const char* expire_str = PQgetvalue(r, line, 4);
-        const char* subnet_id_str = PQgetvalue(r, line, 5);
-        unsigned long valid_lifetime;
-        unsigned long subnet_id;
-
-        istringstream tmp;
-        tmp.str(addr4_str);
-        tmp >> addr4_;
-        tmp.clear();
-
-        memcpy(hwaddr_buffer_, hwaddr_str, hwaddr_length_);
-        memcpy(client_id_buffer_, client_id_str, client_id_length_);
-
-        PQfreemem(client_id_str);
-        PQfreemem(hwaddr_str);
-
-        tmp.str(valid_lifetime_str);
-        tmp >> valid_lifetime;
-        valid_lifetime_ = static_cast<uint32_t>(valid_lifetime);
-        tmp.clear();
-
-        expire_ = convertFromDatabaseTime(expire_str);
-
-        tmp.str(subnet_id_str);
-        tmp >> subnet_id;
-        subnet_id_ = static_cast<uint32_t>(subnet_id);
-        tmp.clear();
-
-        time_t cltt = expire_ - valid_lifetime_;
-
-        // Extract fqdn_fwd, fqdn_rev
-        bool fwd = stringToBool(PQgetvalue(r, line, 6));
-        bool rev = stringToBool(PQgetvalue(r, line, 7));
-
-        // Extract hostname field
-        string hostname(PQgetvalue(r, line, 8));
-
-        return (Lease4Ptr(new Lease4(addr4_, hwaddr_buffer_, hwaddr_length_,
-                                     client_id_buffer_, client_id_length_,
-                                     valid_lifetime_, 0, 0, cltt, subnet_id_,
+    convertFromDatabase(const PGresult* r, int line) {
+        const uint32_t addr4 = getInteger<int64_t>(r, line, 0);
+        size_t hwaddr_length;
+        const uint8_t* hwaddr = getData(r, line, 1, hwaddr_length);
+        if (hwaddr_length > HWAddr::MAX_HWADDR_LEN) {
+            bundy_throw(BadValue, "hardware address of the lease for "
+                        "address " << bundy::asiolink::IOAddress(addr4)
+                        << " is too long (" << hwaddr_length << " bytes)");
+        }
+        size_t client_id_length;
+        const uint8_t* client_id = getData(r, line, 2, client_id_length);
+        const uint32_t valid_lifetime = getInteger<int64_t>(r, line, 3);
+        const time_t expire = getInteger<int64_t>(r, line, 4);
+        const uint32_t subnet_id = getInteger<int64_t>(r, line, 5);
+        const bool fwd = getBool(r, line, 6);
+        const bool rev = getBool(r, line, 7);
+        const std::string hostname = getString(r, line, 8);
+
+        return (Lease4Ptr(new Lease4(addr4, hwaddr, hwaddr_length,
+                                     client_id, client_id_length,
+                                     valid_lifetime, 0, 0,
+                                     expire - valid_lifetime, subnet_id,
                                      fwd, rev, hostname)));
     }
-
-private:
-    uint32_t        addr4_;
-    string     columns_[LEASE_COLUMNS];
-    vector<uint8_t> hwaddr_;
-    uint8_t         hwaddr_buffer_[HWAddr::MAX_HWADDR_LEN];
-    uint8_t         client_id_buffer_[ClientId::MAX_CLIENT_ID_LEN];
-    Lease4Ptr       lease_;
-    time_t          expire_;
-    uint32_t        subnet_id_;
-    uint32_t        valid_lifetime_;
-    unsigned long   hwaddr_length_;
-    unsigned long   client_id_length_;
-    string hostname_;
 };
 
 class PgSqlLease6Exchange : public PgSqlLeaseExchange {
@@ -388,9 +446,9 @@ private:
     static const size_t LEASE_COLUMNS = 12;
 
 public:
-    PgSqlLease6Exchange() : duid_length_(0) {
-        memset(duid_buffer_, 0, sizeof(duid_buffer_));
+    PgSqlLease6Exchange() {
         // Set the column names (for error messages)
+        columns_.resize(LEASE_COLUMNS);
         columns_[0] = "address";
         columns_[1] = "duid";
         columns_[2] = "valid_lifetime";
@@ -403,114 +461,48 @@ public:
         columns_[9] = "fqdn_fwd";
         columns_[10]= "fqdn_rev";
         columns_[11]= "hostname";
-        BOOST_STATIC_ASSERT(11 < LEASE_COLUMNS);
 
         params.reserve(LEASE_COLUMNS);
     }
 
     BindParams
     createBindForSend(const Lease6Ptr& lease) {
-        lease_ = lease;
         params.clear();
-        ostringstream tmp;
-
-        params.push_back(PgSqlParam(lease_->addr_.toText()));
-
-        params.push_back(PgSqlParam(lease_->duid_->getDuid()));
-
-        tmp << static_cast<unsigned long>(lease_->valid_lft_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
-        tmp.clear();
-
-        time_t expire = lease_->valid_lft_ + lease_->cltt_;
-        params.push_back(PgSqlParam(convertToDatabaseTime(expire)));
-
-        tmp << static_cast<unsigned long>(lease_->subnet_id_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
-        tmp.clear();
-
-        tmp << static_cast<unsigned long>(lease_->preferred_lft_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
-        tmp.clear();
-
-        tmp << static_cast<unsigned int>(lease_->type_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
-        tmp.clear();
 
-        tmp << static_cast<unsigned long>(lease_->iaid_);
-        params.push_back(PgSqlParam(tmp.str()));
-        tmp.str("");
-        tmp.clear();
-
-        tmp << static_cast<unsigned int>(lease_->prefixlen_);
-        params.push_back(PgSqlParam(tmp.str()));
-
-        params.push_back(PgSqlParam(lease_->fqdn_fwd_ ? "TRUE" : "FALSE"));
-        params.push_back(PgSqlParam(lease_->fqdn_rev_ ? "TRUE" : "FALSE"));
-        params.push_back(PgSqlParam(lease_->hostname_));
+        // The address column is text.
+        params.push_back(PgSqlParam(lease->addr_.toText()));
+        params.push_back(PgSqlParam(lease->duid_->getDuid()));
+        params.push_back(integerParam<int64_t>(lease->valid_lft_));
+
+        // The expiration time is sent as seconds since the epoch, which
+        // the statements convert with to_timestamp().
+        params.push_back(integerParam<int64_t>(lease->cltt_ +
+                                               lease->valid_lft_));
+
+        params.push_back(integerParam<int64_t>(lease->subnet_id_));
+        params.push_back(integerParam<int64_t>(lease->preferred_lft_));
+        params.push_back(integerParam<int16_t>(lease->type_));
+        params.push_back(integerParam<int64_t>(lease->iaid_));
+        params.push_back(integerParam<int16_t>(lease->prefixlen_));
+        params.push_back(boolParam(lease->fqdn_fwd_));
+        params.push_back(boolParam(lease->fqdn_rev_));
+        params.push_back(PgSqlParam(lease->hostname_));
 
         return (params);
     }
 
     Lease6Ptr
-    convertFromDatabase(PGresult * r, int line) {
-        const char* addr6_str = PQgetvalue(r, line, 0);
-        unsigned char* duid_str =  PQunescapeBytea((const unsigned char *)
-                                                   PQgetvalue(r, line, 1),
-                                                   & duid_length_);
-        const char* valid_lifetime_str =  PQgetvalue(r, line, 2);
-        const char* expire_str = PQgetvalue(r, line, 3);
-        const char* subnet_id_str = PQgetvalue(r, line, 4);
-        const char* pref_lifetime_str = PQgetvalue(r, line, 5);
-        const char* lease_type_str = PQgetvalue(r, line, 6);
-        const char* iaid_str = PQgetvalue(r, line, 7);
-        const char* prefixlen_str = PQgetvalue(r, line, 8);
-        unsigned int lease_type, prefixlen;
-        unsigned long valid_lifetime, subnet_id, pref_lifetime, iaid;
-
-        istringstream tmp;
-
-        addr6_ = addr6_str;
-        bundy::asiolink::IOAddress addr(addr6_);
-
-        memcpy(duid_buffer_, duid_str, duid_length_);
-
-        PQfreemem(duid_str);
-
-        tmp.str(valid_lifetime_str);
-        tmp >> valid_lifetime;
-        valid_lifetime_ = static_cast<uint32_t>(valid_lifetime);
-        tmp.clear();
-
-        expire_ = convertFromDatabaseTime(expire_str);
-
-        tmp.str(subnet_id_str);
-        tmp >> subnet_id;
-        subnet_id_ = static_cast<uint32_t>(subnet_id);
-        tmp.clear();
-
-        tmp.str(pref_lifetime_str);
-        tmp >> pref_lifetime;
-        pref_lifetime_ = static_cast<uint32_t>(pref_lifetime);
-        tmp.clear();
-
-        tmp.str(lease_type_str);
-        tmp >> lease_type;
-        tmp.clear();
-
-        tmp.str(iaid_str);
-        tmp >> iaid;
-        iaid_ = static_cast<uint32_t>(iaid);
-        tmp.clear();
-
-        tmp.str(prefixlen_str);
-        tmp >> prefixlen;
-        prefixlen_ = static_cast<uint8_t>(prefixlen);
-        tmp.clear();
+    convertFromDatabase(const PGresult* r, int line) {
+        const bundy::asiolink::IOAddress addr(getString(r, line, 0));
+        size_t duid_length;
+        const uint8_t* duid = getData(r, line, 1, duid_length);
+        const uint32_t valid_lifetime = getInteger<int64_t>(r, line, 2);
+        const time_t expire = getInteger<int64_t>(r, line, 3);
+        const uint32_t subnet_id = getInteger<int64_t>(r, line, 4);
+        const uint32_t pref_lifetime = getInteger<int64_t>(r, line, 5);
+        const int16_t lease_type = getInteger<int16_t>(r, line, 6);
+        const uint32_t iaid = getInteger<int32_t>(r, line, 7);
+        const uint8_t prefixlen = getInteger<int16_t>(r, line, 8);
 
         Lease6::Type type = Lease6::TYPE_NA;
         switch (lease_type) {
@@ -528,45 +520,28 @@ public:
 
         default:
             bundy_throw(BadValue, "invalid lease type returned (" <<
-                      lease_type_ << ") for lease with address " <<
-                      addr6_ << ". Only 0, 1, or 2 are allowed.");
+                      lease_type << ") for lease with address " <<
+                      addr << ". Only 0, 1, or 2 are allowed.");
         }
 
         // Extract fqdn_fwd, fqdn_rev
-        bool fwd = stringToBool(PQgetvalue(r, line, 9));
-        bool rev = stringToBool(PQgetvalue(r, line, 10));
+        const bool fwd = getBool(r, line, 9);
+        const bool rev = getBool(r, line, 10);
 
         // Extract hostname field
-        string hostname(PQgetvalue(r, line, 11));
+        const std::string hostname = getString(r, line, 11);
 
         // Set up DUID,
-        DuidPtr duid_ptr(new DUID(duid_buffer_, duid_length_));
-
-        Lease6Ptr result(new Lease6(type, addr, duid_ptr, iaid_,
-                                    pref_lifetime_, valid_lifetime_, 0, 0,
-                                    subnet_id_, fwd, rev, hostname,
-                                    prefixlen_));
+        DuidPtr duid_ptr(new DUID(duid, duid_length));
 
-        time_t cltt = expire_ - valid_lifetime_;
-        result->cltt_ = cltt;
+        Lease6Ptr result(new Lease6(type, addr, duid_ptr, iaid,
+                                    pref_lifetime, valid_lifetime, 0, 0,
+                                    subnet_id, fwd, rev, hostname,
+                                    prefixlen));
+        result->cltt_ = expire - valid_lifetime;
 
         return (result);
     }
-
-private:
-    string     addr6_;
-    string     columns_[LEASE_COLUMNS];
-    time_t          expire_;
-    vector<uint8_t> duid_;
-    uint8_t         duid_buffer_[DUID::MAX_DUID_LEN];
-    uint32_t        iaid_;
-    Lease6Ptr       lease_;
-    uint8_t         lease_type_;
-    uint8_t         prefixlen_;
-    uint32_t        pref_lifetime_;
-    uint32_t        subnet_id_;
-    uint32_t        valid_lifetime_;
-    unsigned long   duid_length_;
 };
 
 PgSqlLeaseMgr::PgSqlLeaseMgr(const LeaseMgr::ParameterMap& parameters)
@@ -574,6 +549,16 @@ PgSqlLeaseMgr::PgSqlLeaseMgr(const LeaseMgr::ParameterMap& parameters)
     exchange6_(new PgSqlLease6Exchange()), conn_(NULL) {
     openDatabase();
     prepareStatements();
+
+    // An older schema lacks some of the indexes used by the queries: the
+    // server still works with it, but warn that it should be upgraded.
+    const pair<uint32_t, uint32_t> version = getVersion();
+    if ((version.first == PG_CURRENT_VERSION) &&
+        (version.second < PG_CURRENT_MINOR)) {
+        LOG_WARN(dhcpsrv_logger, DHCPSRV_PGSQL_SCHEMA_OLD)
+            .arg(version.first).arg(version.second)
+            .arg(PG_CURRENT_VERSION).arg(PG_CURRENT_MINOR);
+    }
 }
 
 PgSqlLeaseMgr::~PgSqlLeaseMgr() {
@@ -680,21 +665,19 @@ PgSqlLeaseMgr::addLeaseCommon(StatementIndex stindex,
     PGresult * r = PQexecPrepared(conn_, statements_[stindex].stmt_name,
                                   statements_[stindex].stmt_nbparams,
                                   &out_values[0], &out_lengths[0],
-                                  &out_formats[0], 0);
+                                  &out_formats[0], 1);
 
     int s = PQresultStatus(r);
     if (s != PGRES_COMMAND_OK) {
-        const char * errorMsg = PQerrorMessage(conn_);
-        PQclear(r);
-
-        /// @todo - ok, do we have to rely on error message text??
-        /// and why is failing on duplicate key NOT an error?
-        /// should be looking at global sqlca struct
-        if(!strncmp(errorMsg, "ERROR:  duplicate key",
-           sizeof("ERROR:  duplicate key") - 1)) {
+        // A lease with the same address already exists.
+        if (isDuplicateKey(r)) {
+            PQclear(r);
             return (false);
         }
 
+        const char * errorMsg = PQerrorMessage(conn_);
+        PQclear(r);
+
         bundy_throw(DbOperationError, "unable to INSERT for " <<
                   statements_[stindex].stmt_name << ", reason: " <<
                   errorMsg);
@@ -739,7 +722,7 @@ void PgSqlLeaseMgr::getLeaseCollection(StatementIndex stindex,
 
     PGresult* r = PQexecPrepared(conn_, statements_[stindex].stmt_name,
                        statements_[stindex].stmt_nbparams, &out_values[0],
-                       &out_lengths[0], &out_formats[0], 0);
+                       &out_lengths[0], &out_formats[0], 1);
 
     checkStatementError(r, stindex);
 
@@ -803,10 +786,7 @@ PgSqlLeaseMgr::getLease4(const bundy::asiolink::IOAddress& addr) const {
 
     // Set up the WHERE clause value
     BindParams inparams;
-    ostringstream tmp;
-
-    tmp << static_cast<uint32_t>(addr);
-    inparams.push_back(PgSqlParam(tmp.str()));
+    inparams.push_back(integerParam<int64_t>(static_cast<uint32_t>(addr)));
 
     // Get the data
     Lease4Ptr result;
@@ -844,7 +824,6 @@ PgSqlLeaseMgr::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) const {
 
     // Set up the WHERE clause value
     BindParams inparams;
-    ostringstream tmp;
 
     if (!hwaddr.hwaddr_.empty()) {
         inparams.push_back(PgSqlParam(hwaddr.hwaddr_));
@@ -852,8 +831,7 @@ PgSqlLeaseMgr::getLease4(const HWAddr& hwaddr, SubnetID subnet_id) const {
         inparams.push_back(PgSqlParam());
     }
 
-    tmp << static_cast<unsigned long>(subnet_id);
-    inparams.push_back(PgSqlParam(tmp.str()));
+    inparams.push_back(integerParam<int64_t>(subnet_id));
 
     // Get the data
     Lease4Ptr result;
@@ -888,13 +866,11 @@ PgSqlLeaseMgr::getLease4(const ClientId& clientid, SubnetID subnet_id) const {
 
     // Set up the WHERE clause value
     BindParams inparams;
-    ostringstream tmp;
 
     // CLIENT_ID
     inparams.push_back(PgSqlParam(clientid.getClientId()));
 
-    tmp << static_cast<unsigned long>(subnet_id);
-    inparams.push_back(PgSqlParam(tmp.str()));
+    inparams.push_back(integerParam<int64_t>(subnet_id));
 
     // Get the data
     Lease4Ptr result;
@@ -913,6 +889,41 @@ PgSqlLeaseMgr::getLease4(const ClientId&, const HWAddr&, SubnetID) const {
               " called, but it is not implemented");
 }
 
+Lease4Collection
+PgSqlLeaseMgr::getLeases4(const bundy::asiolink::IOAddress& lower,
+                          const bundy::asiolink::IOAddress& upper) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_PGSQL_GET_RANGE4).arg(lower.toText())
+              .arg(upper.toText());
+
+    // Set up the WHERE clause values
+    BindParams inparams;
+    inparams.push_back(integerParam<int64_t>(static_cast<uint32_t>(lower)));
+    inparams.push_back(integerParam<int64_t>(static_cast<uint32_t>(upper)));
+
+    // Get the data
+    Lease4Collection result;
+    getLeaseCollection(GET_LEASE4_RANGE, inparams, result);
+
+    return (result);
+}
+
+Lease4Collection
+PgSqlLeaseMgr::getExpiredLeases4(size_t max_leases) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_PGSQL_GET_EXPIRED4).arg(max_leases);
+
+    // Set up the WHERE and LIMIT clause values
+    BindParams inparams;
+    bindExpiredParams(max_leases, inparams);
+
+    // Get the data
+    Lease4Collection result;
+    getLeaseCollection(GET_LEASE4_EXPIRE, inparams, result);
+
+    return (result);
+}
+
 Lease6Ptr
 PgSqlLeaseMgr::getLease6(Lease::Type lease_type,
                          const bundy::asiolink::IOAddress& addr) const {
@@ -921,14 +932,12 @@ PgSqlLeaseMgr::getLease6(Lease::Type lease_type,
 
     // Set up the WHERE clause value
     BindParams inparams;
-    ostringstream tmp;
 
     // ADDRESS
     inparams.push_back(PgSqlParam(addr.toText()));
 
     // LEASE_TYPE
-    tmp << static_cast<uint16_t>(lease_type);
-    inparams.push_back(PgSqlParam(tmp.str()));
+    inparams.push_back(integerParam<int16_t>(lease_type));
 
     // ... and get the data
     Lease6Ptr result;
@@ -946,20 +955,15 @@ PgSqlLeaseMgr::getLeases6(Lease::Type type, const DUID& duid,
 
     // Set up the WHERE clause value
     BindParams inparams;
-    ostringstream tmp;
 
     // DUID
     inparams.push_back(PgSqlParam(duid.getDuid()));
 
     // IAID
-    tmp << static_cast<unsigned long>(iaid);
-    inparams.push_back(PgSqlParam(tmp.str()));
-    tmp.str("");
-    tmp.clear();
+    inparams.push_back(integerParam<int64_t>(iaid));
 
     // LEASE_TYPE
-    tmp << static_cast<uint16_t>(type);
-    inparams.push_back(PgSqlParam(tmp.str()));
+    inparams.push_back(integerParam<int16_t>(type));
 
     // ... and get the data
     Lease6Collection result;
@@ -977,28 +981,18 @@ PgSqlLeaseMgr::getLeases6(Lease::Type lease_type, const DUID& duid,
 
     // Set up the WHERE clause value
     BindParams inparams;
-    ostringstream tmp;
 
     // LEASE_TYPE
-    tmp << static_cast<uint16_t>(lease_type);
-    inparams.push_back(PgSqlParam(tmp.str()));
-    tmp.str("");
-    tmp.clear();
+    inparams.push_back(integerParam<int16_t>(lease_type));
 
     // DUID
     inparams.push_back(PgSqlParam(duid.getDuid()));
 
     // IAID
-    tmp << static_cast<unsigned long>(iaid);
-    inparams.push_back(PgSqlParam(tmp.str()));
-    tmp.str("");
-    tmp.clear();
+    inparams.push_back(integerParam<int64_t>(iaid));
 
     // Subnet ID
-    tmp << static_cast<unsigned long>(subnet_id);
-    inparams.push_back(PgSqlParam(tmp.str()));
-    tmp.str("");
-    tmp.clear();
+    inparams.push_back(integerParam<int64_t>(subnet_id));
 
     // ... and get the data
     Lease6Collection result;
@@ -1007,6 +1001,22 @@ PgSqlLeaseMgr::getLeases6(Lease::Type lease_type, const DUID& duid,
     return (result);
 }
 
+Lease6Collection
+PgSqlLeaseMgr::getExpiredLeases6(size_t max_leases) const {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_PGSQL_GET_EXPIRED6).arg(max_leases);
+
+    // Set up the WHERE and LIMIT clause values
+    BindParams inparams;
+    bindExpiredParams(max_leases, inparams);
+
+    // ... and get the data
+    Lease6Collection result;
+    getLeaseCollection(GET_LEASE6_EXPIRE, inparams, result);
+
+    return (result);
+}
+
 template <typename LeasePtr>
 void
 PgSqlLeaseMgr::updateLeaseCommon(StatementIndex stindex, BindParams & params,
@@ -1021,7 +1031,7 @@ PgSqlLeaseMgr::updateLeaseCommon(StatementIndex stindex, BindParams & params,
 
     PGresult * r = PQexecPrepared(conn_, statements_[stindex].stmt_name,
                                   statements_[stindex].stmt_nbparams,
-                                  &params_[0], &lengths_[0], &formats_[0], 0);
+                                  &params_[0], &lengths_[0], &formats_[0], 1);
     checkStatementError(r, stindex);
 
     int affected_rows = boost::lexical_cast<int>(PQcmdTuples(r));
@@ -1052,12 +1062,11 @@ PgSqlLeaseMgr::updateLease4(const Lease4Ptr& lease) {
               DHCPSRV_PGSQL_UPDATE_ADDR4).arg(lease->addr_.toText());
 
     // Create the BIND array for the data being updated
-    ostringstream tmp;
     BindParams params = exchange4_->createBindForSend(lease);
 
     // Set up the WHERE clause and append it to the SQL_BIND array
-    tmp << static_cast<uint32_t>(lease->addr_);
-    params.push_back(PgSqlParam(tmp.str()));
+    params.push_back(integerParam<int64_t>(
+                         static_cast<uint32_t>(lease->addr_)));
 
     // Drop to common update code
     updateLeaseCommon(stindex, params, lease);
@@ -1089,7 +1098,7 @@ PgSqlLeaseMgr::deleteLeaseCommon(StatementIndex stindex, BindParams & params) {
 
     PGresult * r = PQexecPrepared(conn_, statements_[stindex].stmt_name,
                                   statements_[stindex].stmt_nbparams,
-                                  &params_[0], &lengths_[0], &formats_[0], 0);
+                                  &params_[0], &lengths_[0], &formats_[0], 1);
     checkStatementError(r, stindex);
     int affected_rows = boost::lexical_cast<int>(PQcmdTuples(r));
     PQclear(r);
@@ -1106,9 +1115,7 @@ PgSqlLeaseMgr::deleteLease(const bundy::asiolink::IOAddress& addr) {
     BindParams inparams;
 
     if (addr.isV4()) {
-        ostringstream tmp;
-        tmp << static_cast<uint32_t>(addr);
-        inparams.push_back(PgSqlParam(tmp.str()));
+        inparams.push_back(integerParam<int64_t>(static_cast<uint32_t>(addr)));
         return (deleteLeaseCommon(DELETE_LEASE4, inparams));
     }
 
@@ -1116,6 +1123,185 @@ PgSqlLeaseMgr::deleteLease(const bundy::asiolink::IOAddress& addr) {
     return (deleteLeaseCommon(DELETE_LEASE6, inparams));
 }
 
+size_t
+PgSqlLeaseMgr::addLeases(const Lease4Collection& leases) {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_PGSQL_ADD_LEASES).arg(leases.size());
+
+    StatementBatch batch;
+    batch.reserve(leases.size());
+    for (Lease4Collection::const_iterator lease = leases.begin();
+         lease != leases.end(); ++lease) {
+        batch.push_back(make_pair(INSERT_LEASE4,
+                                  exchange4_->createBindForSend(*lease)));
+    }
+    return (executeBatch(batch));
+}
+
+size_t
+PgSqlLeaseMgr::addLeases(const Lease6Collection& leases) {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_PGSQL_ADD_LEASES).arg(leases.size());
+
+    StatementBatch batch;
+    batch.reserve(leases.size());
+    for (Lease6Collection::const_iterator lease = leases.begin();
+         lease != leases.end(); ++lease) {
+        batch.push_back(make_pair(INSERT_LEASE6,
+                                  exchange6_->createBindForSend(*lease)));
+    }
+    return (executeBatch(batch));
+}
+
+size_t
+PgSqlLeaseMgr::deleteLeases(const vector<bundy::asiolink::IOAddress>& addrs) {
+    LOG_DEBUG(dhcpsrv_logger, DHCPSRV_DBG_TRACE_DETAIL,
+              DHCPSRV_PGSQL_DELETE_LEASES).arg(addrs.size());
+
+    StatementBatch batch;
+    batch.reserve(addrs.size());
+    for (vector<bundy::asiolink::IOAddress>::const_iterator addr =
+             addrs.begin(); addr != addrs.end(); ++addr) {
+        BindParams params;
+        if (addr->isV4()) {
+            params.push_back(integerParam<int64_t>(
+                                 static_cast<uint32_t>(*addr)));
+            batch.push_back(make_pair(DELETE_LEASE4, params));
+        } else {
+            params.push_back(PgSqlParam(addr->toText()));
+            batch.push_back(make_pair(DELETE_LEASE6, params));
+        }
+    }
+    return (executeBatch(batch));
+}
+
+bool
+PgSqlLeaseMgr::checkBatchResult(PGresult* r, StatementIndex index,
+                                string& error) const {
+    const ExecStatusType s = PQresultStatus(r);
+    if (s == PGRES_COMMAND_OK) {
+        return (boost::lexical_cast<int>(PQcmdTuples(r)) > 0);
+    }
+
+    // A lease with the same address already exists.
+    if ((s == PGRES_FATAL_ERROR) && isDuplicateKey(r)) {
+        return (false);
+    }
+
+    // Only the first error is reported.
+    if (error.empty()) {
+        ostringstream tmp;
+        tmp << "Statement exec failed for: " << statements_[index].stmt_name
+            << ", reason: " << PQresultErrorMessage(r);
+        error = tmp.str();
+    }
+    return (false);
+}
+
+size_t
+PgSqlLeaseMgr::executeBatch(const StatementBatch& batch) {
+    size_t changed = 0;
+    string error;
+
+#ifdef LIBPQ_HAS_PIPELINING
+    // Each statement is followed by a synchronization point, so it is a
+    // transaction of its own as when executed alone: a failure does not
+    // abort the following statements.  The results are read once all the
+    // statements of a pipeline are sent.
+    for (size_t first = 0; first < batch.size();
+         first += MAX_PIPELINE_DEPTH) {
+        const size_t last = min(batch.size(), first + MAX_PIPELINE_DEPTH);
+        if (!PQenterPipelineMode(conn_)) {
+            bundy_throw(DbOperationError, "unable to enter the pipeline "
+                        "mode, reason: " << PQerrorMessage(conn_));
+        }
+
+        size_t sent = first;
+        for (; sent < last; ++sent) {
+            const StatementIndex stindex = batch[sent].first;
+            vector<const char *> out_values;
+            vector<int> out_lengths;
+            vector<int> out_formats;
+            convertToQuery(batch[sent].second, out_values, out_lengths,
+                           out_formats);
+            if (!PQsendQueryPrepared(conn_, statements_[stindex].stmt_name,
+                                     statements_[stindex].stmt_nbparams,
+                                     &out_values[0], &out_lengths[0],
+                                     &out_formats[0], 1) ||
+                !PQpipelineSync(conn_)) {
+                if (error.empty()) {
+                    error = string("unable to send statement ") +
+                        statements_[stindex].stmt_name + ", reason: " +
+                        PQerrorMessage(conn_);
+                }
+                break;
+            }
+        }
+
+        // A statement has its results, followed by NULL, then the result
+        // of its synchronization point.  Two NULLs in a row mean that
+        // nothing more will come (e.g. the connection was lost).
+        size_t pending = sent - first;
+        size_t current = first;
+        bool ended = false;
+        while (pending > 0) {
+            PGresult* r = PQgetResult(conn_);
+            if (!r) {
+                if (ended) {
+                    if (error.empty()) {
+                        error = string("lost the results of a pipeline, "
+                                       "reason: ") + PQerrorMessage(conn_);
+                    }
+                    break;
+                }
+                ended = true;
+                continue;
+            }
+            ended = false;
+            if (PQresultStatus(r) == PGRES_PIPELINE_SYNC) {
+                --pending;
+                ++current;
+            } else if (checkBatchResult(r, batch[current].first, error)) {
+                ++changed;
+            }
+            PQclear(r);
+        }
+
+        if (!PQexitPipelineMode(conn_) && error.empty()) {
+            error = string("unable to exit the pipeline mode, reason: ") +
+                PQerrorMessage(conn_);
+        }
+        if (!error.empty()) {
+            break;
+        }
+    }
+#else
+    // Without the pipeline mode of libpq 14, the statements are executed
+    // one by one.
+    for (StatementBatch::const_iterator stmt = batch.begin();
+         stmt != batch.end(); ++stmt) {
+        vector<const char *> out_values;
+        vector<int> out_lengths;
+        vector<int> out_formats;
+        convertToQuery(stmt->second, out_values, out_lengths, out_formats);
+        PGresult* r = PQexecPrepared(conn_,
+                                     statements_[stmt->first].stmt_name,
+                                     statements_[stmt->first].stmt_nbparams,
+                                     &out_values[0], &out_lengths[0],
+                                     &out_formats[0], 1);
+        if (checkBatchResult(r, stmt->first, error)) {
+            ++changed;
+        }
+        PQclear(r);
+    }
+#endif
+
+    if (!error.empty()) {
+        bundy_throw(DbOperationError, error);
+    }
+    return (changed);
+}
+
 string
 PgSqlLeaseMgr::getName() const {
     string name = "";
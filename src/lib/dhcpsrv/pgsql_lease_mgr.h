@@ -55,6 +55,16 @@ struct PgSqlParam {
       : value(data.begin(), data.end()), isbinary(true),
           binarylen(data.size()) {
     }
+
+    /// @brief Constructor for binary parameters
+    ///
+    /// Constructs a binary instance given a value already in the binary
+    /// format of its type (e.g. an integer in network byte order).
+    /// @param data pointer to the value of the parameter.
+    /// @param len length of the value of the parameter.
+    PgSqlParam (const uint8_t* data, size_t len)
+      : value(data, data + len), isbinary(true), binarylen(len) {
+    }
 };
 
 /// @brief Defines all parameters for binding a compiled statement
@@ -71,15 +81,22 @@ struct PgSqlStatementBind {
 class PgSqlLease4Exchange;
 class PgSqlLease6Exchange;
 
-/// Defines PostgreSQL backend version: 1.0
+/// Defines PostgreSQL backend version: 1.1
 const uint32_t PG_CURRENT_VERSION = 1;
-const uint32_t PG_CURRENT_MINOR = 0;
+const uint32_t PG_CURRENT_MINOR = 1;
 
 /// @brief PostgreSQL Lease Manager
 ///
 /// This class provides the \ref bundy::dhcp::LeaseMgr interface to the PostgreSQL
 /// database.  Use of this backend presupposes that a PostgreSQL database is
 /// available and that the Kea schema has been created within it.
+///
+/// The parameters of the statements and their results are exchanged in the
+/// binary format, so the integers and booleans are neither formatted nor
+/// parsed as text.  The batches of leases added or deleted by addLeases()
+/// and deleteLeases() are sent in the pipeline mode of libpq (when libpq
+/// supports it), so a single round trip to the server is needed for up to
+/// 256 leases.
 class PgSqlLeaseMgr : public LeaseMgr {
 public:
 
@@ -236,6 +253,42 @@ public:
     virtual Lease4Ptr getLease4(const ClientId& clientid,
                                 SubnetID subnet_id) const;
 
+    /// @brief Returns existing IPv4 leases for a range of addresses
+    ///
+    /// @param lower the first address of the range
+    /// @param upper the last address of the range
+    ///
+    /// @return lease collection ordered by address (may be empty if no
+    /// lease is found)
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    virtual Lease4Collection getLeases4(const bundy::asiolink::IOAddress& lower,
+                                        const bundy::asiolink::IOAddress& upper)
+        const;
+
+    /// @brief Returns expired IPv4 leases
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    virtual Lease4Collection getExpiredLeases4(size_t max_leases) const;
+
+    /// @brief Returns expired IPv6 leases
+    ///
+    /// @param max_leases maximum number of leases to return (0 for no limit)
+    ///
+    /// @return lease collection ordered by expiration time (may be empty if
+    /// no lease has expired)
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    virtual Lease6Collection getExpiredLeases6(size_t max_leases) const;
+
     /// @brief Returns existing IPv6 lease for a given IPv6 address.
     ///
     /// For a given address, we assume that there will be only one lease.
@@ -327,6 +380,48 @@ public:
     ///        failed.
     virtual bool deleteLease(const bundy::asiolink::IOAddress& addr);
 
+    /// @brief Adds a batch of IPv4 leases
+    ///
+    /// The leases are added as by addLease(), each in a transaction of its
+    /// own, but the statements are sent without waiting for the results
+    /// of the previous ones.
+    ///
+    /// @param leases leases to be added
+    ///
+    /// @return number of leases added (the leases with the address of an
+    ///         existing lease are not added).
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.  The leases of the statements already sent may have
+    ///        been added.
+    size_t addLeases(const Lease4Collection& leases);
+
+    /// @brief Adds a batch of IPv6 leases
+    ///
+    /// See addLeases(const Lease4Collection&).
+    ///
+    /// @param leases leases to be added
+    ///
+    /// @return number of leases added
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.
+    size_t addLeases(const Lease6Collection& leases);
+
+    /// @brief Deletes a batch of leases
+    ///
+    /// The leases are deleted as by deleteLease(), but the statements are
+    /// sent without waiting for the results of the previous ones.
+    ///
+    /// @param addrs addresses of the leases to be deleted (IPv4 or IPv6)
+    ///
+    /// @return number of leases deleted
+    ///
+    /// @throw bundy::dhcp::DbOperationError An operation on the open database has
+    ///        failed.  The leases of the statements already sent may have
+    ///        been deleted.
+    size_t deleteLeases(const std::vector<bundy::asiolink::IOAddress>& addrs);
+
     /// @brief Return backend type
     ///
     /// Returns the type of the backend (e.g. "mysql", "memfile" etc.)
@@ -382,11 +477,14 @@ public:
         GET_LEASE4_ADDR,            // Get lease4 by address
         GET_LEASE4_CLIENTID,        // Get lease4 by client ID
         GET_LEASE4_CLIENTID_SUBID,  // Get lease4 by client ID & subnet ID
+        GET_LEASE4_EXPIRE,          // Get expired lease4
         GET_LEASE4_HWADDR,          // Get lease4 by HW address
         GET_LEASE4_HWADDR_SUBID,    // Get lease4 by HW address & subnet ID
+        GET_LEASE4_RANGE,           // Get lease4 by address range
         GET_LEASE6_ADDR,            // Get lease6 by address
         GET_LEASE6_DUID_IAID,       // Get lease6 by DUID and IAID
         GET_LEASE6_DUID_IAID_SUBID, // Get lease6 by DUID, IAID and subnet ID
+        GET_LEASE6_EXPIRE,          // Get expired lease6
         GET_VERSION,                // Obtain version number
         INSERT_LEASE4,              // Add entry to lease4 table
         INSERT_LEASE6,              // Add entry to lease6 table
@@ -397,6 +495,10 @@ public:
 
 private:
 
+    /// @brief Statements executed by a batch, with their parameters
+    typedef std::vector<std::pair<StatementIndex, BindParams> >
+        StatementBatch;
+
     /// @brief Prepare statements
     ///
     /// Creates the prepared statements for all of the SQL statements used
@@ -587,6 +689,33 @@ private:
     ///        failed.
     bool deleteLeaseCommon(StatementIndex stindex, BindParams& params);
 
+    /// @brief Executes a batch of statements
+    ///
+    /// The statements are sent in the pipeline mode by groups of 256, each
+    /// followed by a synchronization point so a failed statement does not
+    /// abort the others.  If libpq does not support the pipeline mode, the
+    /// statements are executed one by one.
+    ///
+    /// @param batch statements to be executed with their parameters.
+    ///
+    /// @return number of statements which changed a row (the insertions
+    ///         failing on a duplicate key are not counted).
+    ///
+    /// @throw bundy::dhcp::DbOperationError A statement failed (for another
+    ///        reason than a duplicate key) or the connection was lost.
+    size_t executeBatch(const StatementBatch& batch);
+
+    /// @brief Checks the result of a statement of a batch
+    ///
+    /// @param r result of the statement
+    /// @param index index of the statement
+    /// @param [out] error set to the description of the failure if the
+    ///        statement failed and it is empty.
+    ///
+    /// @return true if the statement changed a row.
+    bool checkBatchResult(PGresult* r, StatementIndex index,
+                          std::string& error) const;
+
     /// The exchange objects are used for transfer of data to/from the database.
     /// They are pointed-to objects as the contents may change in "const" calls,
     /// while the rest of this object does not.  (At alternative would be to
@@ -15,9 +15,19 @@
 #include <asiolink/io_address.h>
 #include <dhcpsrv/addr_utilities.h>
 #include <dhcpsrv/pool.h>
+#include <util/threads/sync.h>
 #include <sstream>
 
 using namespace bundy::asiolink;
+using bundy::util::thread::Mutex;
+
+namespace {
+
+// Protects the pointers to the free address maps and permutations of the
+// pools.
+Mutex free_addresses_mutex;
+
+}
 
 namespace bundy {
 namespace dhcp {
@@ -31,6 +41,30 @@ bool Pool::inRange(const bundy::asiolink::IOAddress& addr) const {
     return (first_.smallerEqual(addr) && addr.smallerEqual(last_));
 }
 
+FreeAddressMapPtr
+Pool::getFreeAddresses() const {
+    Mutex::Locker locker(free_addresses_mutex);
+    return (free_addresses_);
+}
+
+void
+Pool::setFreeAddresses(const FreeAddressMapPtr& free_addresses) {
+    Mutex::Locker locker(free_addresses_mutex);
+    free_addresses_ = free_addresses;
+}
+
+PoolPermutationPtr
+Pool::getPermutation() const {
+    Mutex::Locker locker(free_addresses_mutex);
+    return (permutation_);
+}
+
+void
+Pool::setPermutation(const PoolPermutationPtr& permutation) {
+    Mutex::Locker locker(free_addresses_mutex);
+    permutation_ = permutation;
+}
+
 std::string
 Pool::toText() const {
     std::stringstream tmp;
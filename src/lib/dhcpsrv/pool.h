@@ -17,6 +17,8 @@
 
 #include <asiolink/io_address.h>
 #include <boost/shared_ptr.hpp>
+#include <dhcpsrv/address_permutation.h>
+#include <dhcpsrv/free_address_map.h>
 #include <dhcpsrv/lease.h>
 
 #include <vector>
@@ -71,6 +73,32 @@ public:
     /// @return textual representation
     virtual std::string toText() const;
 
+    /// @brief Returns the map of the free addresses of the pool.
+    ///
+    /// The map is created by the allocation engine when it first needs it,
+    /// so it may be NULL.
+    ///
+    /// @return pointer to the map (may be NULL)
+    FreeAddressMapPtr getFreeAddresses() const;
+
+    /// @brief Sets the map of the free addresses of the pool.
+    ///
+    /// @param free_addresses pointer to the map
+    void setFreeAddresses(const FreeAddressMapPtr& free_addresses);
+
+    /// @brief Returns the random order of the addresses of the pool.
+    ///
+    /// The permutation is created by the random allocator when it first
+    /// needs it, so it may be NULL.
+    ///
+    /// @return pointer to the permutation (may be NULL)
+    PoolPermutationPtr getPermutation() const;
+
+    /// @brief Sets the random order of the addresses of the pool.
+    ///
+    /// @param permutation pointer to the permutation
+    void setPermutation(const PoolPermutationPtr& permutation);
+
     /// @brief virtual destructor
     ///
     /// We need Pool to be a polymorphic class, so we could dynamic cast
@@ -120,6 +148,16 @@ protected:
 
     /// @brief defines a lease type that will be served from this pool
     Lease::Type type_;
+
+    /// @brief Map of the free addresses (NULL until it is built)
+    ///
+    /// The pointer is shared by the threads, see @c getFreeAddresses.
+    FreeAddressMapPtr free_addresses_;
+
+    /// @brief Random order of the addresses (NULL until it is created)
+    ///
+    /// The pointer is shared by the threads, see @c getPermutation.
+    PoolPermutationPtr permutation_;
 };
 
 /// @brief Pool information for IPv4 addresses
@@ -205,7 +243,7 @@ public:
     /// This may be useful for "prefix/len" style definition for
     /// addresses, but is mostly useful for prefix pools.
     /// @return prefix length (1-128)
-    uint8_t getLength() {
+    uint8_t getLength() const {
         return (prefix_len_);
     }
 
@@ -0,0 +1,665 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/address_locks.h>
+#include <dhcpsrv/alloc_engine.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/dhcpsrv_log.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
+#include <exceptions/exceptions.h>
+#include <util/buffer.h>
+#include <util/encode/hex.h>
+
+#include <boost/bind.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace bundy::asiolink;
+using namespace bundy::util;
+using bundy::util::thread::Mutex;
+
+namespace {
+
+// The batches start with a magic string of 4 bytes and a version.
+const char* const BATCH_MAGIC = "BDLR";
+const uint32_t FORMAT_VERSION = 1;
+const size_t HEADER_LEN = 8;
+
+// The records are added to a batch until it holds this many bytes.
+const size_t MAX_BATCH_LEN = 32768;
+
+// The maximum number of batches waiting to be sent.
+const size_t MAX_BATCHES = 64;
+
+// The maximum length of a datagram received, which holds at least a
+// record of the maximum length.
+const size_t MAX_DATAGRAM_LEN = 131072;
+
+// The maximum number of datagrams read by a call to receive(), so the
+// server is not kept from its packets.
+const size_t MAX_RECEIVED_DATAGRAMS = 64;
+
+// The number of seconds after which an empty batch is sent.
+const time_t HEARTBEAT_INTERVAL = 1;
+
+// Fills the address of a Unix socket.
+void
+setAddress(const std::string& path, struct sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        bundy_throw(bundy::BadValue, "invalid path of the lease replication "
+                    "socket: '" << path << "'");
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+}
+
+// Returns a new batch holding the header only.
+std::vector<uint8_t>
+newBatch() {
+    OutputBuffer header(HEADER_LEN);
+    header.writeData(BATCH_MAGIC, 4);
+    header.writeUint32(FORMAT_VERSION);
+    const uint8_t* data = static_cast<const uint8_t*>(header.getData());
+    std::vector<uint8_t> batch;
+    batch.reserve(MAX_BATCH_LEN);
+    batch.assign(data, data + header.getLength());
+    return (batch);
+}
+
+// Returns the identifier of the client of an IPv4 lease: its client
+// identifier (if any) followed by its hardware address.
+std::vector<uint8_t>
+getClientKey(const bundy::dhcp::Lease4& lease) {
+    std::vector<uint8_t> key;
+    if (lease.client_id_) {
+        key = lease.client_id_->getClientId();
+    }
+    key.insert(key.end(), lease.hwaddr_.begin(), lease.hwaddr_.end());
+    return (key);
+}
+
+// Returns the identifier of the client of an IPv6 lease: its DUID followed
+// by its IAID.
+std::vector<uint8_t>
+getClientKey(const bundy::dhcp::Lease6& lease) {
+    std::vector<uint8_t> key;
+    if (lease.duid_) {
+        key = lease.duid_->getDuid();
+    }
+    OutputBuffer iaid(4);
+    iaid.writeUint32(lease.iaid_);
+    const uint8_t* data = static_cast<const uint8_t*>(iaid.getData());
+    key.insert(key.end(), data, data + iaid.getLength());
+    return (key);
+}
+
+// Decides which of two leases of an address to different clients both
+// servers keep.  The decision depends on the clients only, not on the
+// order in which the servers see the leases or on their times, which
+// change as the clients renew them, so the servers keep the same lease.
+// Returns true if the local lease is kept.
+bool
+keepLocalLease(const bundy::dhcp::Lease& local,
+               const std::vector<uint8_t>& local_key,
+               const std::vector<uint8_t>& received_key) {
+    if (local.expired()) {
+        // The peer reused the address.
+        return (false);
+    }
+    return (local_key < received_key);
+}
+
+// Makes an address deleted by the peer available for allocation, as the
+// server does for the leases it deletes.
+void
+releaseAddress(const bundy::dhcp::Lease4& lease) {
+    const bundy::dhcp::Subnet4Collection* subnets =
+        bundy::dhcp::CfgMgr::instance().getSubnets4();
+    for (bundy::dhcp::Subnet4Collection::const_iterator subnet =
+             subnets->begin(); subnet != subnets->end(); ++subnet) {
+        if ((*subnet)->getID() == lease.subnet_id_) {
+            bundy::dhcp::AllocEngine::addressReleased4(*subnet, lease.addr_);
+            return;
+        }
+    }
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+LeaseReplicator::LeaseReplicator(const std::string& socket_name,
+                                 const std::string& peer_name, int node) :
+    socket_name_(socket_name), peer_name_(peer_name), node_(node), fd_(-1),
+    socket_dev_(0), socket_ino_(0), last_send_(0), peer_up_(false)
+{
+    if (node < -1 || node > 1) {
+        bundy_throw(BadValue, "invalid load balancing node " << node
+                    << ", expected 0, 1 or -1");
+    }
+    struct sockaddr_un addr;
+    setAddress(peer_name, addr);
+    setAddress(socket_name, addr);
+    if (socket_name == peer_name) {
+        bundy_throw(BadValue, "the lease replication socket and the "
+                    "socket of the peer must differ");
+    }
+
+    fd_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd_ < 0) {
+        bundy_throw(DbOperationError, "unable to create the lease "
+                    "replication socket: " << std::strerror(errno));
+    }
+    if (fcntl(fd_, F_SETFD, FD_CLOEXEC) != 0 ||
+        fcntl(fd_, F_SETFL, O_NONBLOCK) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(fd_);
+        bundy_throw(DbOperationError, "unable to set up the lease "
+                    "replication socket: " << error);
+    }
+
+    // The file of the socket of a previous server is replaced.
+    unlink(socket_name.c_str());
+    struct stat st;
+    if (bind(fd_, reinterpret_cast<const struct sockaddr*>(&addr),
+             sizeof(addr)) != 0 || stat(socket_name.c_str(), &st) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(fd_);
+        bundy_throw(DbOperationError, "unable to bind the lease replication "
+                    "socket to " << socket_name << ": " << error);
+    }
+    socket_dev_ = st.st_dev;
+    socket_ino_ = st.st_ino;
+}
+
+LeaseReplicator::~LeaseReplicator() {
+    // A new server (or lease manager) may have bound a socket to the path
+    // already.
+    struct stat st;
+    if (stat(socket_name_.c_str(), &st) == 0 && st.st_dev == socket_dev_ &&
+        st.st_ino == socket_ino_) {
+        unlink(socket_name_.c_str());
+    }
+    ::close(fd_);
+}
+
+void
+LeaseReplicator::append(const Lease4& lease) {
+    OutputBuffer record(64 + lease.hostname_.size());
+    LeaseJournal::encode(lease, record);
+    Mutex::Locker locker(mutex_);
+    queue(record);
+}
+
+void
+LeaseReplicator::append(const Lease6& lease) {
+    OutputBuffer record(96 + lease.hostname_.size());
+    LeaseJournal::encode(lease, record);
+    Mutex::Locker locker(mutex_);
+    queue(record);
+}
+
+void
+LeaseReplicator::queue(const OutputBuffer& record) {
+    // The changes are lost while the peer is not running, the empty
+    // batches sent by flush() tell when it is running again.
+    if (last_send_ != 0 && !peer_up_) {
+        return;
+    }
+
+    if (batches_.empty() ||
+        batches_.back().size() + record.getLength() > MAX_BATCH_LEN) {
+        if (batches_.size() >= MAX_BATCHES) {
+            LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_BATCH_DROPPED)
+                .arg(peer_name_);
+            batches_.pop_front();
+        }
+        batches_.push_back(newBatch());
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(record.getData());
+    batches_.back().insert(batches_.back().end(), data,
+                           data + record.getLength());
+
+    // Send the full batches.
+    if (batches_.size() > 1) {
+        send();
+    }
+}
+
+void
+LeaseReplicator::flush() {
+    Mutex::Locker locker(mutex_);
+    if (batches_.empty()) {
+        if (time(NULL) - last_send_ < HEARTBEAT_INTERVAL) {
+            return;
+        }
+        batches_.push_back(newBatch());
+    }
+    send();
+}
+
+void
+LeaseReplicator::send() {
+    while (!batches_.empty()) {
+        const int error = sendDatagram(batches_.front());
+        const bool first = (last_send_ == 0);
+        last_send_ = time(NULL);
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            // The peer runs, but has not read the previous batches yet.
+            setPeerState(0, first);
+            return;
+        }
+        setPeerState(error, first);
+        if (error != 0) {
+            batches_.clear();
+            return;
+        }
+        batches_.pop_front();
+    }
+}
+
+int
+LeaseReplicator::sendDatagram(const std::vector<uint8_t>& datagram) {
+    struct sockaddr_un addr;
+    setAddress(peer_name_, addr);
+    for (;;) {
+        if (sendto(fd_, &datagram[0], datagram.size(), MSG_DONTWAIT,
+                   reinterpret_cast<const struct sockaddr*>(&addr),
+                   sizeof(addr)) >= 0) {
+            return (0);
+        }
+        if (errno != EINTR) {
+            return (errno);
+        }
+    }
+}
+
+void
+LeaseReplicator::setPeerState(int error, bool first) {
+    if (error == 0 && !peer_up_) {
+        LOG_INFO(dhcpsrv_logger, DHCPSRV_REPLICATION_PEER_UP)
+            .arg(peer_name_);
+        peer_up_ = true;
+    } else if (error != 0 && (peer_up_ || first)) {
+        LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_PEER_DOWN)
+            .arg(peer_name_).arg(std::strerror(error));
+        peer_up_ = false;
+    }
+}
+
+size_t
+LeaseReplicator::getQueuedBatches() const {
+    Mutex::Locker locker(mutex_);
+    return (batches_.size());
+}
+
+bool
+LeaseReplicator::isPeerUp() const {
+    Mutex::Locker locker(mutex_);
+    return (peer_up_);
+}
+
+bool
+LeaseReplicator::inScope(const uint8_t* id, size_t len) const {
+    if (node_ < 0 || len == 0 || !isPeerUp()) {
+        return (true);
+    }
+    // The servers must select the same clients whatever their platform,
+    // so the hash is 32-bit FNV-1a.  The worker threads are selected by
+    // the lowest bits of a similar hash, so the highest one is used.
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ id[i]) * 16777619U;
+    }
+    return (static_cast<int>(hash >> 31) == node_);
+}
+
+size_t
+LeaseReplicator::receive(const LeaseJournal::Lease4Handler& handler4,
+                         const LeaseJournal::Lease6Handler& handler6) {
+    std::vector<uint8_t> buffer(MAX_DATAGRAM_LEN);
+    size_t count = 0;
+    for (size_t datagrams = 0; datagrams < MAX_RECEIVED_DATAGRAMS;
+         ++datagrams) {
+        const ssize_t len = recv(fd_, &buffer[0], buffer.size(),
+                                 MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR(dhcpsrv_logger, DHCPSRV_REPLICATION_RECEIVE_FAIL)
+                    .arg(socket_name_).arg(std::strerror(errno));
+            }
+            break;
+        }
+
+        const uint8_t* const data = &buffer[0];
+        if (static_cast<size_t>(len) < HEADER_LEN || std::memcmp(data, BATCH_MAGIC, 4) != 0 ||
+            InputBuffer(data + 4, 4).readUint32() != FORMAT_VERSION) {
+            LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_INVALID)
+                .arg(socket_name_).arg("unexpected header");
+            continue;
+        }
+        size_t offset = HEADER_LEN;
+        while (offset < static_cast<size_t>(len)) {
+            size_t record_len = 0;
+            try {
+                record_len = LeaseJournal::decode(data + offset, len - offset,
+                                                  handler4, handler6);
+            } catch (const std::exception& ex) {
+                LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_INVALID)
+                    .arg(socket_name_).arg(ex.what());
+                break;
+            }
+            if (record_len == 0) {
+                LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_INVALID)
+                    .arg(socket_name_).arg("truncated or corrupted record");
+                break;
+            }
+            offset += record_len;
+            ++count;
+        }
+    }
+    return (count);
+}
+
+ReplicatingLeaseMgr::ReplicatingLeaseMgr(const ParameterMap& parameters,
+                                         LeaseMgr* backend,
+                                         const LeaseReplicatorPtr& replicator) :
+    LeaseMgr(parameters), backend_(backend), replicator_(replicator)
+{
+    if (!backend || !replicator) {
+        bundy_throw(InvalidParameter, "a replicating lease manager requires "
+                    "a backend and a replicator");
+    }
+}
+
+ReplicatingLeaseMgr::~ReplicatingLeaseMgr() {
+}
+
+size_t
+ReplicatingLeaseMgr::receive() {
+    return (replicator_->receive(
+                boost::bind(&ReplicatingLeaseMgr::apply4, this, _1),
+                boost::bind(&ReplicatingLeaseMgr::apply6, this, _1)));
+}
+
+void
+ReplicatingLeaseMgr::apply4(Lease4Ptr& lease) {
+    try {
+        // The server may be allocating the address meanwhile.
+        AddressLocks::Locker locker(AddressLocks::instance(), lease->addr_);
+        const Lease4Ptr local = backend_->getLease4(lease->addr_);
+        const std::vector<uint8_t> key = getClientKey(*lease);
+        if (lease->valid_lft_ == 0) {
+            if (!local) {
+                return;
+            }
+            const std::vector<uint8_t> local_key = getClientKey(*local);
+            if (local_key != key) {
+                // The lease of the peer lost a conflict.
+                LOG_WARN(dhcpsrv_logger,
+                         DHCPSRV_REPLICATION_DELETE_CONFLICT)
+                    .arg(lease->addr_.toText()).arg(encode::encodeHex(key))
+                    .arg(encode::encodeHex(local_key));
+                return;
+            }
+            if (backend_->deleteLease(lease->addr_)) {
+                releaseAddress(*lease);
+            }
+            return;
+        }
+        if (!local) {
+            backend_->addLease(lease);
+            return;
+        }
+        const std::vector<uint8_t> local_key = getClientKey(*local);
+        if (local_key != key) {
+            const bool keep_local = keepLocalLease(*local, local_key, key);
+            if (!local->expired()) {
+                LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_CONFLICT)
+                    .arg(lease->addr_.toText()).arg(encode::encodeHex(key))
+                    .arg(encode::encodeHex(local_key))
+                    .arg(encode::encodeHex(keep_local ? local_key : key));
+            }
+            if (keep_local) {
+                return;
+            }
+        }
+        backend_->updateLease4(lease);
+    } catch (const std::exception& ex) {
+        LOG_ERROR(dhcpsrv_logger, DHCPSRV_REPLICATION_APPLY_FAIL)
+            .arg(lease->addr_.toText()).arg(ex.what());
+    }
+}
+
+void
+ReplicatingLeaseMgr::apply6(Lease6Ptr& lease) {
+    try {
+        AddressLocks::Locker locker(AddressLocks::instance(), lease->addr_);
+        const Lease6Ptr local = backend_->getLease6(lease->type_,
+                                                    lease->addr_);
+        const std::vector<uint8_t> key = getClientKey(*lease);
+        if (lease->valid_lft_ == 0) {
+            if (!local) {
+                return;
+            }
+            const std::vector<uint8_t> local_key = getClientKey(*local);
+            if (local_key != key) {
+                LOG_WARN(dhcpsrv_logger,
+                         DHCPSRV_REPLICATION_DELETE_CONFLICT)
+                    .arg(lease->addr_.toText()).arg(encode::encodeHex(key))
+                    .arg(encode::encodeHex(local_key));
+                return;
+            }
+            backend_->deleteLease(lease->addr_);
+            return;
+        }
+        if (!local) {
+            backend_->addLease(lease);
+            return;
+        }
+        const std::vector<uint8_t> local_key = getClientKey(*local);
+        if (local_key != key) {
+            const bool keep_local = keepLocalLease(*local, local_key, key);
+            if (!local->expired()) {
+                LOG_WARN(dhcpsrv_logger, DHCPSRV_REPLICATION_CONFLICT)
+                    .arg(lease->addr_.toText()).arg(encode::encodeHex(key))
+                    .arg(encode::encodeHex(local_key))
+                    .arg(encode::encodeHex(keep_local ? local_key : key));
+            }
+            if (keep_local) {
+                return;
+            }
+        }
+        backend_->updateLease6(lease);
+    } catch (const std::exception& ex) {
+        LOG_ERROR(dhcpsrv_logger, DHCPSRV_REPLICATION_APPLY_FAIL)
+            .arg(lease->addr_.toText()).arg(ex.what());
+    }
+}
+
+bool
+ReplicatingLeaseMgr::addLease(const Lease4Ptr& lease) {
+    if (!backend_->addLease(lease)) {
+        return (false);
+    }
+    replicator_->append(*lease);
+    return (true);
+}
+
+bool
+ReplicatingLeaseMgr::addLease(const Lease6Ptr& lease) {
+    if (!backend_->addLease(lease)) {
+        return (false);
+    }
+    replicator_->append(*lease);
+    return (true);
+}
+
+Lease4Ptr
+ReplicatingLeaseMgr::getLease4(const IOAddress& addr) const {
+    return (backend_->getLease4(addr));
+}
+
+Lease4Collection
+ReplicatingLeaseMgr::getLease4(const HWAddr& hwaddr) const {
+    return (backend_->getLease4(hwaddr));
+}
+
+Lease4Ptr
+ReplicatingLeaseMgr::getLease4(const HWAddr& hwaddr,
+                               SubnetID subnet_id) const {
+    return (backend_->getLease4(hwaddr, subnet_id));
+}
+
+Lease4Collection
+ReplicatingLeaseMgr::getLease4(const ClientId& client_id) const {
+    return (backend_->getLease4(client_id));
+}
+
+Lease4Ptr
+ReplicatingLeaseMgr::getLease4(const ClientId& client_id,
+                               const HWAddr& hwaddr,
+                               SubnetID subnet_id) const {
+    return (backend_->getLease4(client_id, hwaddr, subnet_id));
+}
+
+Lease4Ptr
+ReplicatingLeaseMgr::getLease4(const ClientId& client_id,
+                               SubnetID subnet_id) const {
+    return (backend_->getLease4(client_id, subnet_id));
+}
+
+Lease4Collection
+ReplicatingLeaseMgr::getLeases4(const IOAddress& lower,
+                                const IOAddress& upper) const {
+    return (backend_->getLeases4(lower, upper));
+}
+
+Lease6Ptr
+ReplicatingLeaseMgr::getLease6(Lease::Type type, const IOAddress& addr) const {
+    return (backend_->getLease6(type, addr));
+}
+
+Lease6Collection
+ReplicatingLeaseMgr::getLeases6(Lease::Type type, const DUID& duid,
+                                uint32_t iaid) const {
+    return (backend_->getLeases6(type, duid, iaid));
+}
+
+Lease6Collection
+ReplicatingLeaseMgr::getLeases6(Lease::Type type, const DUID& duid,
+                                uint32_t iaid, SubnetID subnet_id) const {
+    return (backend_->getLeases6(type, duid, iaid, subnet_id));
+}
+
+Lease4Collection
+ReplicatingLeaseMgr::getExpiredLeases4(size_t max_leases) const {
+    return (backend_->getExpiredLeases4(max_leases));
+}
+
+Lease6Collection
+ReplicatingLeaseMgr::getExpiredLeases6(size_t max_leases) const {
+    return (backend_->getExpiredLeases6(max_leases));
+}
+
+void
+ReplicatingLeaseMgr::updateLease4(const Lease4Ptr& lease4) {
+    backend_->updateLease4(lease4);
+    replicator_->append(*lease4);
+}
+
+void
+ReplicatingLeaseMgr::updateLease6(const Lease6Ptr& lease6) {
+    backend_->updateLease6(lease6);
+    replicator_->append(*lease6);
+}
+
+bool
+ReplicatingLeaseMgr::deleteLease(const IOAddress& addr) {
+    if (addr.isV4()) {
+        Lease4Ptr lease = backend_->getLease4(addr);
+        if (!lease || !backend_->deleteLease(addr)) {
+            return (false);
+        }
+        // A deleted lease is sent with a valid lifetime of 0.
+        lease->valid_lft_ = 0;
+        replicator_->append(*lease);
+        return (true);
+    }
+
+    Lease6Ptr lease;
+    const Lease::Type types[] = {
+        Lease::TYPE_NA, Lease::TYPE_TA, Lease::TYPE_PD
+    };
+    for (size_t i = 0; !lease && i < sizeof(types) / sizeof(types[0]); ++i) {
+        lease = backend_->getLease6(types[i], addr);
+    }
+    if (!lease || !backend_->deleteLease(addr)) {
+        return (false);
+    }
+    lease->valid_lft_ = 0;
+    lease->preferred_lft_ = 0;
+    replicator_->append(*lease);
+    return (true);
+}
+
+std::string
+ReplicatingLeaseMgr::getType() const {
+    return (backend_->getType());
+}
+
+std::string
+ReplicatingLeaseMgr::getName() const {
+    return (backend_->getName());
+}
+
+std::string
+ReplicatingLeaseMgr::getDescription() const {
+    return (backend_->getDescription() + " (replicated)");
+}
+
+std::pair<uint32_t, uint32_t>
+ReplicatingLeaseMgr::getVersion() const {
+    return (backend_->getVersion());
+}
+
+void
+ReplicatingLeaseMgr::commit() {
+    backend_->commit();
+}
+
+void
+ReplicatingLeaseMgr::rollback() {
+    backend_->rollback();
+}
+
+void
+ReplicatingLeaseMgr::waitForWrites() {
+    backend_->waitForWrites();
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
@@ -0,0 +1,332 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef REPLICATING_LEASE_MGR_H
+#define REPLICATING_LEASE_MGR_H
+
+#include <dhcpsrv/lease_journal.h>
+#include <dhcpsrv/lease_mgr.h>
+#include <util/threads/sync.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Exchange of the lease updates with the peer server.
+///
+/// Two DHCP servers with the memfile backend can keep the same leases by
+/// sending each other the changes of their leases.  The changes are sent
+/// over a Unix datagram socket bound to a path given in the configuration,
+/// the peer sending them to this path and receiving them on a path of its
+/// own, so both servers run on the same host.
+///
+/// The changes are queued as the records of the lease journal (see @c
+/// LeaseJournal::encode), a deleted lease being sent with a valid lifetime
+/// of 0.  The queued records are sent in batches, a datagram each, when
+/// the batch is full or when @c flush is called.  Sending doesn't block: if
+/// the peer doesn't read its socket, the batches wait for the next flush
+/// and the oldest ones are dropped when too many are waiting.  If the
+/// peer's socket can't be reached, the peer is not running, and the
+/// changes are dropped.
+///
+/// When nothing was sent for a second, @c flush sends an empty batch so
+/// that the state of the peer is known.  The servers share their clients
+/// by a hash of the client identifier (see @c inScope), each answering
+/// its half of the clients while the peer is running and all of them
+/// otherwise.
+///
+/// The methods may be called from multiple threads.
+class LeaseReplicator : public boost::noncopyable {
+public:
+    /// @brief Constructor.
+    ///
+    /// The socket is created and bound.  A file left at its path (by a
+    /// previous server) is removed.
+    ///
+    /// @param socket_name path of the socket receiving the changes of the
+    /// peer.
+    /// @param peer_name path of the socket of the peer.
+    /// @param node the index of this server (0 or 1) in the load
+    /// balancing, or -1 if the server answers all the clients.
+    ///
+    /// @throw BadValue if a path is empty or too long, or if the node is
+    /// not valid.
+    /// @throw DbOperationError if the socket can't be created.
+    LeaseReplicator(const std::string& socket_name,
+                    const std::string& peer_name, int node);
+
+    /// @brief Destructor.
+    ///
+    /// The socket is closed and its path removed, unless another socket
+    /// was bound to the path since.
+    ~LeaseReplicator();
+
+    /// @brief Returns the descriptor of the socket.
+    ///
+    /// The servers wait for the changes of the peer on it, and call @c
+    /// receive when it is readable.
+    int getSocket() const {
+        return (fd_);
+    }
+
+    /// @brief Returns the path of the socket.
+    const std::string& getSocketName() const {
+        return (socket_name_);
+    }
+
+    /// @brief Returns the path of the socket of the peer.
+    const std::string& getPeerName() const {
+        return (peer_name_);
+    }
+
+    /// @brief Returns the index of this server in the load balancing.
+    int getNode() const {
+        return (node_);
+    }
+
+    /// @brief Queues a changed IPv4 lease.
+    ///
+    /// The batch is sent if it is full.
+    void append(const Lease4& lease);
+
+    /// @brief Queues a changed IPv6 lease.
+    ///
+    /// The batch is sent if it is full.
+    void append(const Lease6& lease);
+
+    /// @brief Sends the queued changes.
+    ///
+    /// An empty batch is sent if nothing was sent for a second.
+    void flush();
+
+    /// @brief Returns the number of queued batches.
+    size_t getQueuedBatches() const;
+
+    /// @brief Checks if the peer received the last batch sent.
+    ///
+    /// The peer is considered down until a batch is sent.
+    bool isPeerUp() const;
+
+    /// @brief Checks if this server answers a client.
+    ///
+    /// @param id the identifier of the client (the client identifier or
+    /// hardware address of a DHCPv4 client, the DUID of a DHCPv6 client).
+    /// @param len the length of the identifier.
+    ///
+    /// @return true if the client is in the half of this server, if there
+    /// is no load balancing or if the peer is down.
+    bool inScope(const uint8_t* id, size_t len) const;
+
+    /// @brief Receives the changes sent by the peer.
+    ///
+    /// The datagrams waiting on the socket are read, and the handlers are
+    /// called with each lease they hold.  A datagram which is not valid is
+    /// logged and discarded.
+    ///
+    /// @param handler4 function called with each IPv4 lease.
+    /// @param handler6 function called with each IPv6 lease.
+    ///
+    /// @return the number of leases received.
+    size_t receive(const LeaseJournal::Lease4Handler& handler4,
+                   const LeaseJournal::Lease6Handler& handler6);
+
+private:
+    /// @brief Queues an encoded record, the mutex being locked.
+    void queue(const bundy::util::OutputBuffer& record);
+
+    /// @brief Sends the queued batches, the mutex being locked.
+    void send();
+
+    /// @brief Sends a datagram to the peer.
+    ///
+    /// @return 0, or the error number.
+    int sendDatagram(const std::vector<uint8_t>& datagram);
+
+    /// @brief Updates the state of the peer after a datagram was sent, the
+    /// mutex being locked.
+    ///
+    /// @param error 0 if the datagram was sent, or the error number.
+    /// @param first true if it is the first datagram sent.
+    void setPeerState(int error, bool first);
+
+    const std::string socket_name_;
+    const std::string peer_name_;
+    const int node_;
+
+    /// @brief The socket (-1 if closed).
+    int fd_;
+
+    /// @brief The device and inode of the path of the socket, to check
+    /// that the path is still the socket's when it is closed.
+    dev_t socket_dev_;
+    ino_t socket_ino_;
+
+    /// @brief The queued batches, each starting with the header.
+    std::deque<std::vector<uint8_t> > batches_;
+
+    /// @brief The time of the last batch sent.
+    time_t last_send_;
+
+    /// @brief Is the peer running?
+    bool peer_up_;
+
+    /// @brief Protects the members above.
+    mutable bundy::util::thread::Mutex mutex_;
+};
+
+/// @brief Pointer to a lease replicator.
+typedef boost::shared_ptr<LeaseReplicator> LeaseReplicatorPtr;
+
+/// @brief A lease manager replicating the changes of the leases.
+///
+/// This lease manager forwards the calls to another lease manager (the
+/// backend), and queues the changes of the leases it makes in a @c
+/// LeaseReplicator, which sends them to the peer server.  It applies the
+/// changes received from the peer to the backend, without sending them
+/// back.  The backend is a memfile lease manager, so both servers answer
+/// from the leases they hold in memory.
+///
+/// A change received from the peer replaces the lease of the address if
+/// the lease is of the same client, or if there is no lease or it has
+/// expired.  The servers don't answer the same clients while both are
+/// running, but a server may lease an address to a client before it
+/// receives the lease of the address the peer gave to another client.  In
+/// such a conflict both servers keep the lease of the client with the
+/// lowest identifier, whatever the order and the times of the changes, and
+/// log it; the other client is refused the address when it renews it.  The
+/// deletion of a lease of another client is ignored, and an IPv4 address
+/// deleted by the peer is made available for allocation (see @c
+/// AllocEngine::addressReleased4).
+///
+/// @note The peer is not sent the leases it missed while it was not
+///       running: the leases of a restarted server are only those it
+///       loaded from its lease file and the changes since it started.
+class ReplicatingLeaseMgr : public LeaseMgr {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param parameters the parameters of the lease database.
+    /// @param backend the lease manager holding the leases.  It is owned
+    /// by this object.
+    /// @param replicator the replicator sending the changes.
+    ReplicatingLeaseMgr(const ParameterMap& parameters, LeaseMgr* backend,
+                        const LeaseReplicatorPtr& replicator);
+
+    /// @brief Destructor.
+    virtual ~ReplicatingLeaseMgr();
+
+    /// @brief Returns the replicator.
+    const LeaseReplicatorPtr& getReplicator() const {
+        return (replicator_);
+    }
+
+    /// @brief Returns the lease manager holding the leases.
+    LeaseMgr& getBackend() const {
+        return (*backend_);
+    }
+
+    /// @brief Applies the changes received from the peer.
+    ///
+    /// A change which can't be applied is logged.
+    ///
+    /// @return the number of changes received.
+    size_t receive();
+
+    virtual bool addLease(const Lease4Ptr& lease);
+    virtual bool addLease(const Lease6Ptr& lease);
+
+    virtual Lease4Ptr getLease4(const bundy::asiolink::IOAddress& addr) const;
+    virtual Lease4Collection getLease4(const HWAddr& hwaddr) const;
+    virtual Lease4Ptr getLease4(const HWAddr& hwaddr,
+                                SubnetID subnet_id) const;
+    virtual Lease4Collection getLease4(const ClientId& client_id) const;
+    virtual Lease4Ptr getLease4(const ClientId& client_id,
+                                const HWAddr& hwaddr,
+                                SubnetID subnet_id) const;
+    virtual Lease4Ptr getLease4(const ClientId& client_id,
+                                SubnetID subnet_id) const;
+    virtual Lease4Collection getLeases4(
+        const bundy::asiolink::IOAddress& lower,
+        const bundy::asiolink::IOAddress& upper) const;
+
+    virtual Lease6Ptr getLease6(Lease::Type type,
+                                const bundy::asiolink::IOAddress& addr) const;
+    virtual Lease6Collection getLeases6(Lease::Type type, const DUID& duid,
+                                        uint32_t iaid) const;
+    virtual Lease6Collection getLeases6(Lease::Type type, const DUID& duid,
+                                        uint32_t iaid,
+                                        SubnetID subnet_id) const;
+
+    virtual Lease4Collection getExpiredLeases4(size_t max_leases) const;
+    virtual Lease6Collection getExpiredLeases6(size_t max_leases) const;
+
+    virtual void updateLease4(const Lease4Ptr& lease4);
+    virtual void updateLease6(const Lease6Ptr& lease6);
+
+    /// @brief Deletes a lease.
+    ///
+    /// The lease is read before it is deleted, to be sent to the peer.
+    virtual bool deleteLease(const bundy::asiolink::IOAddress& addr);
+
+    /// @brief Returns the type of the backend.
+    virtual std::string getType() const;
+
+    /// @brief Returns the name of the backend.
+    virtual std::string getName() const;
+
+    /// @brief Returns the description of the backend.
+    virtual std::string getDescription() const;
+
+    /// @brief Returns the version of the backend.
+    virtual std::pair<uint32_t, uint32_t> getVersion() const;
+
+    /// @brief Commits the transaction of the backend.
+    virtual void commit();
+
+    /// @brief Rolls back the transaction of the backend.
+    virtual void rollback();
+
+    /// @brief Waits until the changes of the backend are stored.
+    virtual void waitForWrites();
+
+private:
+    /// @brief Applies a change of an IPv4 lease received from the peer.
+    ///
+    /// The lock of the address is held, so the server doesn't allocate it
+    /// meanwhile.  A conflict with the lease of another client is resolved
+    /// as described in the class description.
+    void apply4(Lease4Ptr& lease);
+
+    /// @brief Applies a change of an IPv6 lease received from the peer.
+    void apply6(Lease6Ptr& lease);
+
+    boost::scoped_ptr<LeaseMgr> backend_;
+    LeaseReplicatorPtr replicator_;
+};
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // REPLICATING_LEASE_MGR_H
@@ -20,10 +20,13 @@
 #include <sstream>
 
 using namespace bundy::asiolink;
+using bundy::util::thread::Mutex;
 
 namespace bundy {
 namespace dhcp {
 
+const size_t Subnet::MAX_PACKED_OPTIONS;
+
 // This is an initial value of subnet-id. See comments in subnet.h for details.
 SubnetID Subnet::static_id_ = 1;
 
@@ -70,11 +73,13 @@ Subnet::addOption(const OptionPtr& option, bool persistent,
 
     // Actually add new option descriptor.
     option_spaces_.addItem(OptionDescriptor(option, persistent), option_space);
+    clearPackedOptions();
 }
 
 void
 Subnet::setRelayInfo(const bundy::dhcp::Subnet::RelayInfo& relay) {
     relay_ = relay;
+    selectionChanged();
 }
 
 bool
@@ -97,11 +102,13 @@ Subnet::clientSupported(const bundy::dhcp::ClientClasses& classes) const {
 void
 Subnet::allowClientClass(const bundy::dhcp::ClientClass& class_name) {
     white_list_.insert(class_name);
+    selectionChanged();
 }
 
 void
 Subnet::delOptions() {
     option_spaces_.clearItems();
+    clearPackedOptions();
 }
 
 Subnet::OptionContainerPtr
@@ -131,6 +138,7 @@ void Subnet::addVendorOption(const OptionPtr& option, bool persistent,
     validateOption(option);
 
     vendor_option_spaces_.addItem(OptionDescriptor(option, persistent), vendor_id);
+    clearPackedOptions();
 }
 
 Subnet::OptionContainerPtr
@@ -155,6 +163,31 @@ Subnet::getVendorOptionDescriptor(uint32_t vendor_id, uint16_t option_code) {
 
 void Subnet::delVendorOptions() {
     vendor_option_spaces_.clearItems();
+    clearPackedOptions();
+}
+
+ConstPackedOptionsPtr
+Subnet::getPackedOptions(const std::vector<uint8_t>& key) const {
+    Mutex::Locker locker(packed_options_mutex_);
+    const PackedOptionsMap::const_iterator it = packed_options_.find(key);
+    return (it != packed_options_.end() ? it->second :
+            ConstPackedOptionsPtr());
+}
+
+void
+Subnet::setPackedOptions(const std::vector<uint8_t>& key,
+                         const ConstPackedOptionsPtr& options) const {
+    Mutex::Locker locker(packed_options_mutex_);
+    if (packed_options_.size() >= MAX_PACKED_OPTIONS) {
+        packed_options_.clear();
+    }
+    packed_options_[key] = options;
+}
+
+void
+Subnet::clearPackedOptions() {
+    Mutex::Locker locker(packed_options_mutex_);
+    packed_options_.clear();
 }
 
 bundy::asiolink::IOAddress Subnet::getLastAllocated(Lease::Type type) const {
@@ -323,6 +356,7 @@ Subnet::delPools(Lease::Type type) {
 void
 Subnet::setIface(const std::string& iface_name) {
     iface_ = iface_name;
+    selectionChanged();
 }
 
 std::string
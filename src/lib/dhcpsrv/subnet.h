@@ -15,6 +15,7 @@
 #ifndef SUBNET_H
 #define SUBNET_H
 
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -25,11 +26,16 @@
 #include <asiolink/io_address.h>
 #include <dhcp/option.h>
 #include <dhcp/classify.h>
+#include <dhcp/packed_options.h>
 #include <dhcpsrv/key_from_key.h>
 #include <dhcpsrv/option_space_container.h>
 #include <dhcpsrv/pool.h>
 #include <dhcpsrv/triplet.h>
 #include <dhcpsrv/lease.h>
+#include <util/threads/sync.h>
+
+#include <map>
+#include <vector>
 
 namespace bundy {
 namespace dhcp {
@@ -284,6 +290,30 @@ public:
     OptionDescriptor
     getVendorOptionDescriptor(uint32_t vendor_id, uint16_t option_code);
 
+    /// @brief Returns options packed beforehand for a kind of response.
+    ///
+    /// A server answering many clients with the same configured options
+    /// can pack them once per subnet (see @c PackedOptions).  The packed
+    /// options are stored by the server using @c setPackedOptions, under a
+    /// key describing the options it selected (e.g. the option codes the
+    /// client requested).  They are dropped whenever options are added to
+    /// or deleted from the subnet.  This may be called by several threads.
+    ///
+    /// @param key the key the options were stored under.
+    /// @return the packed options or a null pointer if there is none.
+    ConstPackedOptionsPtr
+    getPackedOptions(const std::vector<uint8_t>& key) const;
+
+    /// @brief Stores options packed beforehand for a kind of response.
+    ///
+    /// See @c getPackedOptions.  The number of stored sets of options is
+    /// bounded: all of them are dropped when the bound is reached.
+    ///
+    /// @param key the key to store the options under.
+    /// @param options the packed options.
+    void setPackedOptions(const std::vector<uint8_t>& key,
+                          const ConstPackedOptionsPtr& options) const;
+
     /// @brief returns the last address that was tried from this pool
     ///
     /// This method returns the last address that was attempted to be allocated
@@ -396,6 +426,22 @@ public:
         static_id_ = 1;
     }
 
+    /// @brief Callback updating an index for subnet selection
+    typedef boost::function<void ()> IndexCallback;
+
+    /// @brief Marks the subnet as used by an index for subnet selection
+    ///
+    /// The callback is called whenever the parameters the subnet is
+    /// selected by (relay information, interface name, interface-id and
+    /// client classes) are changed, so the index is updated with the
+    /// change, by the thread making it.
+    ///
+    /// @param callback the callback, or an empty function if the subnet
+    /// is no longer indexed.
+    void setIndexed(const IndexCallback& callback) {
+        index_callback_ = callback;
+    }
+
     /// @brief Sets information about relay
     ///
     /// In some situations where there are shared subnets (i.e. two different
@@ -424,7 +470,7 @@ public:
     /// returned it is valid.
     ///
     /// @return const reference to the relay information
-    const bundy::dhcp::Subnet::RelayInfo& getRelayInfo() {
+    const bundy::dhcp::Subnet::RelayInfo& getRelayInfo() const {
         return (relay_);
     }
 
@@ -455,6 +501,13 @@ public:
     void
     allowClientClass(const bundy::dhcp::ClientClass& class_name);
 
+    /// @brief Returns the classes supported by this subnet.
+    ///
+    /// @return the classes, none meaning that all clients are supported.
+    const bundy::dhcp::ClientClasses& getClientClasses() const {
+        return (white_list_);
+    }
+
 protected:
     /// @brief Returns all pools (non-const variant)
     ///
@@ -516,6 +569,17 @@ protected:
         return (static_id_++);
     }
 
+    /// @brief Records a change of the selection parameters
+    ///
+    /// It should be called by any method modifying the parameters the
+    /// subnet is selected by.  It updates the index of the subnet (see
+    /// @ref setIndexed).
+    void selectionChanged() {
+        if (index_callback_) {
+            index_callback_();
+        }
+    }
+
     /// @brief Checks if used pool type is valid
     ///
     /// Allowed type for Subnet4 is Pool::TYPE_V4.
@@ -585,6 +649,9 @@ protected:
     /// @brief Name of the network interface (if connected directly)
     std::string iface_;
 
+    /// @brief Updates the index for subnet selection using the subnet
+    IndexCallback index_callback_;
+
     /// @brief Relay information
     ///
     /// See @ref RelayInfo for detailed description. This structure is public,
@@ -607,6 +674,11 @@ protected:
 
 private:
 
+    /// @brief Drops the options packed beforehand.
+    ///
+    /// Called whenever the options of the subnet change.
+    void clearPackedOptions();
+
     /// A collection of option spaces grouping option descriptors.
     typedef OptionSpaceContainer<OptionContainer,
         OptionDescriptor, std::string> OptionSpaceCollection;
@@ -620,6 +692,19 @@ private:
 
     /// Vendor options are kept here
     VendorOptionSpaceCollection vendor_option_spaces_;
+
+    /// Options packed beforehand, by key
+    typedef std::map<std::vector<uint8_t>, ConstPackedOptionsPtr>
+        PackedOptionsMap;
+
+    /// Maximum number of sets of packed options kept
+    static const size_t MAX_PACKED_OPTIONS = 256;
+
+    /// Packed options (see @c getPackedOptions)
+    mutable PackedOptionsMap packed_options_;
+
+    /// Mutex protecting @c packed_options_
+    mutable bundy::util::thread::Mutex packed_options_mutex_;
 };
 
 /// @brief A generic pointer to either Subnet4 or Subnet6 object
@@ -731,6 +816,7 @@ public:
     /// @param ifaceid pointer to interface-id option
     void setInterfaceId(const OptionPtr& ifaceid) {
         interface_id_ = ifaceid;
+        selectionChanged();
     }
 
     /// @brief returns interface-id value (if specified)
@@ -0,0 +1,280 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <dhcpsrv/subnet_index.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace bundy::asiolink;
+
+namespace {
+
+/// @brief Returns the bit of the key at the given position, 0 being the
+/// most significant bit of the first byte.
+inline int
+getBit(const uint8_t* key, unsigned int pos) {
+    return ((key[pos / 8] >> (7 - pos % 8)) & 1);
+}
+
+/// @brief Returns the length of the common prefix of two keys, but not
+/// more than the specified number of bits.
+unsigned int
+commonLength(const uint8_t* key1, const uint8_t* key2, unsigned int max_len) {
+    unsigned int len = 0;
+    for (size_t i = 0; len < max_len; ++i, len += 8) {
+        const uint8_t diff = key1[i] ^ key2[i];
+        if (diff != 0) {
+            for (uint8_t mask = 0x80; (diff & mask) == 0; mask >>= 1) {
+                ++len;
+            }
+            break;
+        }
+    }
+    return (std::min(len, max_len));
+}
+
+/// @brief Checks if a subnet supports a client.
+///
+/// @param allowed the bits of the classes supported by the subnet, none
+/// if it supports all clients.
+/// @param classes the bits of the classes of the client.
+inline bool
+supports(const std::vector<uint64_t>& allowed,
+         const std::vector<uint64_t>& classes) {
+    if (allowed.empty()) {
+        return (true);
+    }
+    const size_t size = std::min(allowed.size(), classes.size());
+    for (size_t i = 0; i < size; ++i) {
+        if ((allowed[i] & classes[i]) != 0) {
+            return (true);
+        }
+    }
+    return (false);
+}
+
+}
+
+namespace bundy {
+namespace dhcp {
+
+const size_t SubnetIndex::NOT_FOUND;
+
+SubnetIndex::Node::Node(const uint8_t* key, uint8_t len) : len_(len) {
+    std::memset(key_, 0, sizeof(key_));
+    std::memcpy(key_, key, (len + 7) / 8);
+    if (len % 8 != 0) {
+        key_[len / 8] &= static_cast<uint8_t>(0xff << (8 - len % 8));
+    }
+    children_[0] = children_[1] = 0;
+}
+
+SubnetIndex::SubnetIndex() : count_(0) {
+    clear();
+}
+
+void
+SubnetIndex::add(const Subnet& subnet, const OptionPtr& interface_id) {
+    ClassMask classes;
+    const ClientClasses& white_list = subnet.getClientClasses();
+    for (ClientClasses::const_iterator it = white_list.begin();
+         it != white_list.end(); ++it) {
+        const size_t bit = class_bits_.insert(
+            std::make_pair(*it, class_bits_.size())).first->second;
+        if (classes.size() <= bit / 64) {
+            classes.resize(bit / 64 + 1);
+        }
+        classes[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+    }
+    const Entry entry(count_, &subnet, classes);
+    const std::pair<IOAddress, uint8_t> prefix = subnet.get();
+    const std::vector<uint8_t> key = prefix.first.toBytes();
+    insert(prefix.first.isV4() ? trie4_ : trie6_, &key[0], prefix.second,
+           entry);
+
+    relays_[subnet.getRelayInfo().addr_].push_back(entry);
+
+    const std::string iface = subnet.getIface();
+    if (!iface.empty()) {
+        ifaces_[iface].push_back(entry);
+    }
+    if (interface_id) {
+        interface_ids_[InterfaceIdKey(interface_id->getType(),
+                                      interface_id->getData())].
+            push_back(entry);
+    }
+    ++count_;
+}
+
+void
+SubnetIndex::clear() {
+    const uint8_t root[V6ADDRESS_LEN] = { 0 };
+    trie4_.assign(1, Node(root, 0));
+    trie6_.assign(1, Node(root, 0));
+    relays_.clear();
+    ifaces_.clear();
+    interface_ids_.clear();
+    class_bits_.clear();
+    count_ = 0;
+}
+
+size_t
+SubnetIndex::findByAddress(const IOAddress& hint, const ClientClasses& classes,
+                           bool relay) const
+{
+    const ClassMask mask = getMask(classes);
+    size_t position = NOT_FOUND;
+    if (relay) {
+        const std::map<IOAddress, EntryList>::const_iterator it =
+            relays_.find(hint);
+        if (it != relays_.end()) {
+            position = findFirst(it->second, mask, position);
+        }
+    }
+
+    const std::vector<uint8_t> key = hint.toBytes();
+    if (hint.isV4()) {
+        return (find(trie4_, &key[0], V4ADDRESS_LEN * 8, mask, position));
+    }
+    return (find(trie6_, &key[0], V6ADDRESS_LEN * 8, mask, position));
+}
+
+size_t
+SubnetIndex::findByIface(const std::string& iface,
+                         const ClientClasses& classes) const
+{
+    const std::map<std::string, EntryList>::const_iterator it =
+        ifaces_.find(iface);
+    if (it == ifaces_.end()) {
+        return (NOT_FOUND);
+    }
+    return (findFirst(it->second, getMask(classes), NOT_FOUND));
+}
+
+size_t
+SubnetIndex::findByInterfaceId(const Option& interface_id,
+                               const ClientClasses& classes) const
+{
+    const std::map<InterfaceIdKey, EntryList>::const_iterator it =
+        interface_ids_.find(InterfaceIdKey(interface_id.getType(),
+                                           interface_id.getData()));
+    if (it == interface_ids_.end()) {
+        return (NOT_FOUND);
+    }
+    return (findFirst(it->second, getMask(classes), NOT_FOUND));
+}
+
+void
+SubnetIndex::insert(Trie& trie, const uint8_t* key, uint8_t len,
+                    const Entry& entry)
+{
+    // The prefix of the parent is always a prefix of the key.  Note that
+    // the nodes are referred to by their index, as adding a node may
+    // reallocate the array.
+    uint32_t parent = 0;
+    for (;;) {
+        if (trie[parent].len_ == len) {
+            trie[parent].subnets_.push_back(entry);
+            return;
+        }
+
+        const int bit = getBit(key, trie[parent].len_);
+        const uint32_t child = trie[parent].children_[bit];
+        if (child == 0) {
+            trie[parent].children_[bit] = trie.size();
+            trie.push_back(Node(key, len));
+            trie.back().subnets_.push_back(entry);
+            return;
+        }
+
+        const uint8_t child_len = trie[child].len_;
+        const uint8_t common = commonLength(key, trie[child].key_,
+                                            std::min(len, child_len));
+        if (common == child_len) {
+            parent = child;
+            continue;
+        }
+
+        // The key diverges from the child (or ends) before the end of its
+        // prefix, so a node with the common part is put between them.  If
+        // it is not the prefix of the key, the next iteration adds the key
+        // as its other child.
+        const uint32_t node = trie.size();
+        trie.push_back(Node(key, common));
+        trie[node].children_[getBit(trie[child].key_, common)] = child;
+        trie[parent].children_[bit] = node;
+        parent = node;
+    }
+}
+
+size_t
+SubnetIndex::find(const Trie& trie, const uint8_t* key, uint8_t bits,
+                  const ClassMask& classes, size_t limit)
+{
+    // The prefixes covering the key are on the path from the root to the
+    // longest of them.  As a subnet with a shorter prefix may have been
+    // added first, all of them are examined.
+    uint32_t node = 0;
+    for (;;) {
+        limit = findFirst(trie[node].subnets_, classes, limit);
+        if (trie[node].len_ >= bits) {
+            break;
+        }
+        const uint32_t child =
+            trie[node].children_[getBit(key, trie[node].len_)];
+        if (child == 0 ||
+            commonLength(key, trie[child].key_, trie[child].len_) <
+            trie[child].len_) {
+            break;
+        }
+        node = child;
+    }
+    return (limit);
+}
+
+size_t
+SubnetIndex::findFirst(const EntryList& subnets, const ClassMask& classes,
+                       size_t limit)
+{
+    for (EntryList::const_iterator it = subnets.begin();
+         it != subnets.end() && it->position_ < limit; ++it) {
+        if (supports(it->classes_, classes)) {
+            return (it->position_);
+        }
+    }
+    return (limit);
+}
+
+SubnetIndex::ClassMask
+SubnetIndex::getMask(const ClientClasses& classes) const {
+    ClassMask mask;
+    if (class_bits_.empty()) {
+        return (mask);
+    }
+    mask.resize((class_bits_.size() + 63) / 64);
+    for (ClientClasses::const_iterator it = classes.begin();
+         it != classes.end(); ++it) {
+        const std::map<ClientClass, size_t>::const_iterator bit =
+            class_bits_.find(*it);
+        if (bit != class_bits_.end()) {
+            mask[bit->second / 64] |=
+                static_cast<uint64_t>(1) << (bit->second % 64);
+        }
+    }
+    return (mask);
+}
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
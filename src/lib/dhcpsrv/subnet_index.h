@@ -0,0 +1,210 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef SUBNET_INDEX_H
+#define SUBNET_INDEX_H
+
+#include <asiolink/io_address.h>
+#include <dhcp/classify.h>
+#include <dhcp/option.h>
+#include <dhcpsrv/subnet.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bundy {
+namespace dhcp {
+
+/// @brief Index used to select a subnet for a client
+///
+/// The subnets are identified by their position, which is the order in
+/// which they were added to the index (and to the collection of subnets
+/// kept by @c CfgMgr).  For each selection criterion, the index returns
+/// the first subnet matching it and supporting the classes of the client,
+/// i.e. the same subnet a linear search of the collection would find,
+/// without examining all the subnets:
+///
+/// - the subnets containing an address are found in a compressed binary
+///   trie of the subnet prefixes, so only the prefixes covering the
+///   address are examined;
+/// - the subnets with a given relay address, interface name or
+///   interface-id are kept in maps;
+/// - the classes supported by a subnet are kept as a bitmask, each class
+///   supported by a subnet having a bit, so the classes of the client
+///   are looked up once for each selection rather than for each subnet
+///   examined.
+///
+/// The index keeps raw pointers to the subnets, so they must be kept
+/// alive by the caller.  The index is not updated when the relay address,
+/// interface name, interface-id or classes of an indexed subnet are
+/// changed; it must be rebuilt then (see @c Subnet::setIndexed).
+class SubnetIndex : public boost::noncopyable {
+public:
+    /// @brief The position returned when no subnet matches.
+    static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    /// @brief Constructor.
+    ///
+    /// Creates an empty index.
+    SubnetIndex();
+
+    /// @brief Adds a subnet to the index.
+    ///
+    /// The subnet gets the position following the one of the previously
+    /// added subnet.
+    ///
+    /// @param subnet subnet to be added.
+    /// @param interface_id interface-id of the subnet (if any).
+    void add(const Subnet& subnet,
+             const OptionPtr& interface_id = OptionPtr());
+
+    /// @brief Removes all subnets from the index.
+    void clear();
+
+    /// @brief Returns the number of subnets in the index.
+    size_t size() const {
+        return (count_);
+    }
+
+    /// @brief Finds a subnet by address.
+    ///
+    /// @param hint address belonging to the subnet.
+    /// @param classes classes the client belongs to.
+    /// @param relay if true, the subnets which have the hint set as
+    /// their relay address match as well.
+    ///
+    /// @return position of the subnet or @c NOT_FOUND.
+    size_t findByAddress(const bundy::asiolink::IOAddress& hint,
+                         const ClientClasses& classes, bool relay) const;
+
+    /// @brief Finds a subnet by the name of the interface it is reachable
+    /// over.
+    ///
+    /// @param iface interface name.
+    /// @param classes classes the client belongs to.
+    ///
+    /// @return position of the subnet or @c NOT_FOUND.
+    size_t findByIface(const std::string& iface,
+                       const ClientClasses& classes) const;
+
+    /// @brief Finds a subnet by interface-id.
+    ///
+    /// @param interface_id interface-id option sent by a relay.
+    /// @param classes classes the client belongs to.
+    ///
+    /// @return position of the subnet or @c NOT_FOUND.
+    size_t findByInterfaceId(const Option& interface_id,
+                             const ClientClasses& classes) const;
+
+private:
+    /// @brief A set of classes, as bits of the classes of the subnets.
+    typedef std::vector<uint64_t> ClassMask;
+
+    /// @brief A subnet in the index.
+    struct Entry {
+        Entry(size_t position, const Subnet* subnet,
+              const ClassMask& classes) :
+            position_(position), subnet_(subnet), classes_(classes)
+        {}
+
+        size_t position_;
+        const Subnet* subnet_;
+
+        /// The classes supported by the subnet, none for all clients.
+        ClassMask classes_;
+    };
+
+    /// @brief Subnets with the same key, ordered by position.
+    typedef std::vector<Entry> EntryList;
+
+    /// @brief A node of the prefix trie.
+    ///
+    /// Nodes are either prefixes of subnets, or branching points without
+    /// subnets.  The children of a node have longer prefixes starting with
+    /// the prefix of the node, followed by a 0 and 1 bit respectively.
+    struct Node {
+        Node(const uint8_t* key, uint8_t len);
+
+        /// The prefix, bits beyond the length are zero.
+        uint8_t key_[bundy::asiolink::V6ADDRESS_LEN];
+
+        /// Length of the prefix in bits.
+        uint8_t len_;
+
+        /// Index of the children in the node array, 0 if there is none
+        /// (the root is never a child).
+        uint32_t children_[2];
+
+        /// Subnets with this prefix.
+        EntryList subnets_;
+    };
+
+    /// @brief A trie of prefixes, the root (/0) node being the first one.
+    typedef std::vector<Node> Trie;
+
+    /// @brief Inserts a subnet to the trie.
+    static void insert(Trie& trie, const uint8_t* key, uint8_t len,
+                       const Entry& entry);
+
+    /// @brief Finds the first supported subnet in the trie containing
+    /// the address.
+    ///
+    /// @param limit only subnets with a lower position are considered.
+    static size_t find(const Trie& trie, const uint8_t* key, uint8_t bits,
+                       const ClassMask& classes, size_t limit);
+
+    /// @brief Returns position of the first subnet in the list supporting
+    /// the classes, if lower than the limit.
+    static size_t findFirst(const EntryList& subnets,
+                            const ClassMask& classes, size_t limit);
+
+    /// @brief Returns the bits of the classes of a client.
+    ///
+    /// The classes no subnet is restricted to are ignored.
+    ClassMask getMask(const ClientClasses& classes) const;
+
+    /// @brief Key identifying an interface-id: option type and data.
+    typedef std::pair<uint16_t, OptionBuffer> InterfaceIdKey;
+
+    /// @brief Number of subnets added.
+    size_t count_;
+
+    /// @brief Prefix tries of IPv4 and IPv6 subnets.
+    Trie trie4_;
+    Trie trie6_;
+
+    /// @brief Subnets by relay address.
+    std::map<bundy::asiolink::IOAddress, EntryList> relays_;
+
+    /// @brief Subnets by interface name.
+    std::map<std::string, EntryList> ifaces_;
+
+    /// @brief Subnets by interface-id.
+    std::map<InterfaceIdKey, EntryList> interface_ids_;
+
+    /// @brief Bits of the classes supported by the subnets.
+    std::map<ClientClass, size_t> class_bits_;
+};
+
+} // end of bundy::dhcp namespace
+} // end of bundy namespace
+
+#endif // SUBNET_INDEX_H
@@ -0,0 +1,94 @@
+
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/address_locks.h>
+#include <exceptions/exceptions.h>
+#include <util/threads/thread.h>
+
+#include <boost/bind.hpp>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::asiolink;
+using namespace bundy::dhcp;
+using bundy::util::thread::Thread;
+
+namespace {
+
+// Checks that the addresses are spread over the stripes.
+TEST(AddressLocksTest, getStripe) {
+    AddressLocks locks(16);
+    EXPECT_EQ(16, locks.getStripeCount());
+    EXPECT_EQ(AddressLocks::DEFAULT_STRIPES,
+              AddressLocks().getStripeCount());
+
+    // The same address always uses the same lock.
+    EXPECT_EQ(locks.getStripe(IOAddress("192.0.2.1")),
+              locks.getStripe(IOAddress("192.0.2.1")));
+    EXPECT_EQ(locks.getStripe(IOAddress("2001:db8::1")),
+              locks.getStripe(IOAddress("2001:db8::1")));
+
+    // Consecutive addresses use different locks.
+    std::vector<bool> used(locks.getStripeCount());
+    for (uint32_t i = 0; i < locks.getStripeCount(); ++i) {
+        const size_t stripe = locks.getStripe(IOAddress(0xc0000200 + i));
+        ASSERT_LT(stripe, locks.getStripeCount());
+        EXPECT_FALSE(used[stripe]);
+        used[stripe] = true;
+    }
+}
+
+TEST(AddressLocksTest, noStripes) {
+    EXPECT_THROW(AddressLocks(0), BadValue);
+}
+
+// Increments the counter many times with the address locked.
+void
+increment(AddressLocks* locks, const IOAddress* addr, unsigned int* counter) {
+    for (unsigned int i = 0; i < 100000; ++i) {
+        AddressLocks::Locker locker(*locks, *addr);
+        // Not atomic, so increments get lost unless the lock works.
+        const unsigned int value = *counter;
+        *counter = value + 1;
+    }
+}
+
+// Checks that the threads locking the same address are serialized.
+TEST(AddressLocksTest, lock) {
+    AddressLocks locks;
+    const IOAddress addr("192.0.2.1");
+    unsigned int counter = 0;
+    {
+        Thread thread1(boost::bind(increment, &locks, &addr, &counter));
+        Thread thread2(boost::bind(increment, &locks, &addr, &counter));
+        thread1.wait();
+        thread2.wait();
+    }
+    EXPECT_EQ(200000, counter);
+
+    // The lock is released by the locker.
+    AddressLocks::Locker locker(locks, addr);
+}
+
+TEST(AddressLocksTest, instance) {
+    EXPECT_EQ(&AddressLocks::instance(), &AddressLocks::instance());
+}
+
+} // end of anonymous namespace
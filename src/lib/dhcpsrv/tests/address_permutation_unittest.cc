@@ -0,0 +1,124 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/address_permutation.h>
+#include <dhcpsrv/pool.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+using namespace bundy::asiolink;
+
+namespace {
+
+// Checks that only valid sizes are accepted.
+TEST(IndexPermutationTest, constructor) {
+    EXPECT_NO_THROW(IndexPermutation(1, 0));
+    EXPECT_NO_THROW(IndexPermutation(IndexPermutation::MAX_SIZE, 0));
+    EXPECT_THROW(IndexPermutation(0, 0), BadValue);
+    EXPECT_THROW(IndexPermutation(IndexPermutation::MAX_SIZE + 1, 0),
+                 BadValue);
+}
+
+// Checks that the integers are permuted, and unpermuted back.
+TEST(IndexPermutationTest, permute) {
+    for (uint64_t size = 1; size < 300; ++size) {
+        const IndexPermutation permutation(size, size * 1234567);
+        std::vector<bool> seen(size, false);
+        for (uint64_t index = 0; index < size; ++index) {
+            const uint64_t value = permutation.permute(index);
+            ASSERT_GT(size, value);
+            EXPECT_FALSE(seen[value]) << size << " " << index;
+            seen[value] = true;
+            EXPECT_EQ(index, permutation.unpermute(value));
+        }
+    }
+
+    // Large sizes.
+    const IndexPermutation permutation(IndexPermutation::MAX_SIZE, 42);
+    for (uint64_t index = 0; index < 1000; ++index) {
+        const uint64_t value = permutation.permute(index);
+        ASSERT_GT(IndexPermutation::MAX_SIZE, value);
+        EXPECT_EQ(index, permutation.unpermute(value));
+    }
+}
+
+// Checks that different keys give different permutations.
+TEST(IndexPermutationTest, key) {
+    const IndexPermutation permutation1(1000, 1);
+    const IndexPermutation permutation2(1000, 2);
+    int same = 0;
+    for (uint64_t index = 0; index < 1000; ++index) {
+        if (permutation1.permute(index) == permutation2.permute(index)) {
+            ++same;
+        }
+    }
+    EXPECT_GT(100, same);
+}
+
+// Checks the positions of the addresses and prefixes of pools.
+TEST(PoolIndexTest, addresses) {
+    const Pool4 pool4(IOAddress("192.0.2.10"), IOAddress("192.0.2.19"));
+    EXPECT_EQ(10, getPoolCapacity(pool4));
+    EXPECT_EQ("192.0.2.15", getPoolAddress(pool4, 5).toText());
+    uint64_t index;
+    ASSERT_TRUE(getPoolIndex(pool4, IOAddress("192.0.2.19"), index));
+    EXPECT_EQ(9, index);
+    EXPECT_FALSE(getPoolIndex(pool4, IOAddress("192.0.2.20"), index));
+    EXPECT_FALSE(getPoolIndex(pool4, IOAddress("192.0.2.9"), index));
+
+    const Pool6 pool6(Lease::TYPE_NA, IOAddress("2001:db8::ff00"),
+                      IOAddress("2001:db8::1:ff"));
+    EXPECT_EQ(512, getPoolCapacity(pool6));
+    EXPECT_EQ("2001:db8::1:0", getPoolAddress(pool6, 256).toText());
+    ASSERT_TRUE(getPoolIndex(pool6, IOAddress("2001:db8::1:1"), index));
+    EXPECT_EQ(257, index);
+
+    // Prefixes are counted in units of the delegated length.
+    const Pool6 pd(Lease::TYPE_PD, IOAddress("2001:db8:1::"), 48, 64);
+    EXPECT_EQ(65536, getPoolCapacity(pd));
+    EXPECT_EQ("2001:db8:1:102::", getPoolAddress(pd, 258).toText());
+    ASSERT_TRUE(getPoolIndex(pd, IOAddress("2001:db8:1:ffff::"), index));
+    EXPECT_EQ(65535, index);
+
+    // Very large pools are restricted to their beginning.
+    const Pool6 large(Lease::TYPE_NA, IOAddress("2001:db8::"), 64);
+    EXPECT_EQ(IndexPermutation::MAX_SIZE, getPoolCapacity(large));
+    EXPECT_FALSE(getPoolIndex(large, IOAddress("2001:db8::ffff:ffff:ffff:ffff"),
+                              index));
+}
+
+// Checks that all the addresses of a pool are returned once before any is
+// returned again.
+TEST(PoolPermutationTest, next) {
+    const Pool4 pool(IOAddress("10.0.0.0"), 22);
+    PoolPermutation permutation(pool);
+    for (int round = 0; round < 2; ++round) {
+        std::set<IOAddress> addresses;
+        for (int i = 0; i < 1024; ++i) {
+            const IOAddress addr = permutation.next();
+            EXPECT_TRUE(pool.inRange(addr));
+            EXPECT_TRUE(addresses.insert(addr).second);
+        }
+    }
+}
+
+}
@@ -64,6 +64,8 @@ public:
     // Expose internal classes for testing purposes
     using AllocEngine::Allocator;
     using AllocEngine::IterativeAllocator;
+    using AllocEngine::HashedAllocator;
+    using AllocEngine::RandomAllocator;
     using AllocEngine::getAllocator;
 
     /// @brief IterativeAllocator with internal methods exposed
@@ -470,9 +472,10 @@ public:
 TEST_F(AllocEngine6Test, constructor) {
     boost::scoped_ptr<AllocEngine> x;
 
-    // Hashed and random allocators are not supported yet
-    ASSERT_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_HASHED, 5)), NotImplemented);
-    ASSERT_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_RANDOM, 5)), NotImplemented);
+    ASSERT_NO_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_HASHED, 5)));
+    EXPECT_TRUE(x->getAllocator(Lease::TYPE_PD));
+    ASSERT_NO_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_RANDOM, 5)));
+    EXPECT_TRUE(x->getAllocator(Lease::TYPE_PD));
 
     ASSERT_NO_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_ITERATIVE, 100, true)));
 
@@ -586,6 +589,27 @@ TEST_F(AllocEngine6Test, IterativeAllocator) {
     }
 }
 
+// This test verifies that the random allocator picks all the prefixes of
+// a prefix pool once before picking any of them again.
+TEST_F(AllocEngine6Test, RandomAllocatorPrefix6) {
+    NakedAllocEngine::RandomAllocator alloc(Lease::TYPE_PD);
+
+    // The /56 pool has 256 /64 prefixes.
+    std::set<IOAddress> picked;
+    for (int i = 0; i < 256; ++i) {
+        IOAddress candidate = alloc.pickAddress(subnet_, duid_,
+                                                IOAddress("::"));
+        EXPECT_TRUE(subnet_->inPool(Lease::TYPE_PD, candidate));
+        EXPECT_TRUE(picked.insert(candidate).second) << candidate;
+    }
+    EXPECT_EQ(256, picked.size());
+
+    // Then it starts over.
+    EXPECT_TRUE(subnet_->inPool(Lease::TYPE_PD,
+                                alloc.pickAddress(subnet_, duid_,
+                                                  IOAddress("::"))));
+}
+
 TEST_F(AllocEngine6Test, IterativeAllocatorAddrStep) {
     NakedAllocEngine::NakedIterativeAllocator alloc(Lease::TYPE_NA);
 
@@ -985,6 +1009,42 @@ TEST_F(AllocEngine6Test, requestReuseExpiredLease6) {
     detailCompareLease(lease, from_mgr);
 }
 
+// This test checks that the expired leases are reclaimed in batches, the
+// earliest expired first, and that valid leases are kept.
+TEST_F(AllocEngine6Test, reclaimExpiredLeases6) {
+    DuidPtr other_duid = DuidPtr(new DUID(vector<uint8_t>(12, 0xff)));
+    const char* addrs[] = { "2001:db8:1::11", "2001:db8:1::12",
+                            "2001:db8:1::13" };
+    // The leases have expired 100 and 500 seconds ago, or are valid.
+    const time_t cltts[] = { time(NULL) - 600, time(NULL) - 1000,
+                             time(NULL) };
+    for (int i = 0; i < 3; ++i) {
+        Lease6Ptr lease(new Lease6(Lease::TYPE_NA, IOAddress(addrs[i]),
+                                   other_duid, i, 501, 502, 503, 504,
+                                   subnet_->getID(), 0));
+        lease->cltt_ = cltts[i];
+        lease->valid_lft_ = 500;
+        ASSERT_TRUE(LeaseMgrFactory::instance().addLease(lease));
+    }
+
+    Lease6Collection reclaimed = AllocEngine::reclaimExpiredLeases6(1);
+    ASSERT_EQ(1, reclaimed.size());
+    EXPECT_EQ(addrs[1], reclaimed[0]->addr_.toText());
+    EXPECT_FALSE(LeaseMgrFactory::instance().getLease6(Lease::TYPE_NA,
+                                                       IOAddress(addrs[1])));
+    EXPECT_TRUE(LeaseMgrFactory::instance().getLease6(Lease::TYPE_NA,
+                                                      IOAddress(addrs[0])));
+
+    reclaimed = AllocEngine::reclaimExpiredLeases6(0);
+    ASSERT_EQ(1, reclaimed.size());
+    EXPECT_EQ(addrs[0], reclaimed[0]->addr_.toText());
+
+    // The valid lease is kept.
+    EXPECT_TRUE(AllocEngine::reclaimExpiredLeases6(0).empty());
+    EXPECT_TRUE(LeaseMgrFactory::instance().getLease6(Lease::TYPE_NA,
+                                                      IOAddress(addrs[2])));
+}
+
 // --- IPv4 ---
 
 // This test checks if the v4 Allocation Engine can be instantiated, parses
@@ -992,11 +1052,12 @@ TEST_F(AllocEngine6Test, requestReuseExpiredLease6) {
 TEST_F(AllocEngine4Test, constructor) {
     boost::scoped_ptr<AllocEngine> x;
 
-    // Hashed and random allocators are not supported yet
-    ASSERT_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_HASHED, 5, false)),
-                 NotImplemented);
-    ASSERT_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_RANDOM, 5, false)),
-                 NotImplemented);
+    ASSERT_NO_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_HASHED, 5,
+                                            false)));
+    EXPECT_TRUE(x->getAllocator(Lease::TYPE_V4));
+    ASSERT_NO_THROW(x.reset(new AllocEngine(AllocEngine::ALLOC_RANDOM, 5,
+                                            false)));
+    EXPECT_TRUE(x->getAllocator(Lease::TYPE_V4));
 
     // Create V4 (ipv6=false) Allocation Engine that will try at most
     // 100 attempts to pick up a lease
@@ -1309,6 +1370,162 @@ TEST_F(AllocEngine4Test, IterativeAllocator_manyPools4) {
     }
 }
 
+// This test verifies that the iterative allocator skips the leased addresses
+// of IPv4 pools, and picks released addresses again.
+TEST_F(AllocEngine4Test, IterativeAllocator_freeAddresses4) {
+    NakedAllocEngine::IterativeAllocator alloc(Lease::TYPE_V4);
+
+    // Lease all the addresses of the pool but two.
+    uint8_t hwaddr[] = { 0, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe};
+    for (int i = 100; i < 109; ++i) {
+        if (i == 105) {
+            continue;
+        }
+        stringstream addr;
+        addr << "192.0.2." << i;
+        hwaddr[5] = i;
+        Lease4Ptr lease(new Lease4(IOAddress(addr.str()), hwaddr,
+                                   sizeof(hwaddr), NULL, 0, 501, 502, 503,
+                                   time(NULL), subnet_->getID()));
+        ASSERT_TRUE(LeaseMgrFactory::instance().addLease(lease));
+    }
+
+    EXPECT_EQ("192.0.2.105", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+    EXPECT_EQ("192.0.2.109", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+    // The search wraps around.
+    EXPECT_EQ("192.0.2.105", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+
+    // Allocated addresses are not picked any more.
+    AllocEngine engine(AllocEngine::ALLOC_ITERATIVE, 100, false);
+    Lease4Ptr lease = engine.allocateLease4(subnet_, clientid_, hwaddr_,
+                                            IOAddress("192.0.2.109"),
+                                            false, false, "", false,
+                                            CalloutHandlePtr(), old_lease_);
+    ASSERT_TRUE(lease);
+    EXPECT_EQ("192.0.2.109", lease->addr_.toText());
+    EXPECT_EQ("192.0.2.105", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+    EXPECT_EQ("192.0.2.105", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+
+    // Released addresses are picked again.
+    ASSERT_TRUE(LeaseMgrFactory::instance().
+                deleteLease(IOAddress("192.0.2.102")));
+    AllocEngine::addressReleased4(subnet_, IOAddress("192.0.2.102"));
+    EXPECT_EQ("192.0.2.102", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+    EXPECT_EQ("192.0.2.105", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+}
+
+// This test verifies that the hashed allocator gives the same addresses
+// to a client, probing the pool from the last picked address.
+TEST_F(AllocEngine4Test, HashedAllocator4) {
+    NakedAllocEngine::HashedAllocator alloc(Lease::TYPE_V4);
+
+    // The first probe of a client doesn't change.
+    const IOAddress first = alloc.pickAddress(subnet_, clientid_,
+                                              IOAddress("0.0.0.0"));
+    EXPECT_TRUE(subnet_->inPool(Lease::TYPE_V4, first));
+    EXPECT_EQ(first, alloc.pickAddress(subnet_, clientid_,
+                                       IOAddress("0.0.0.0")));
+    // An address of the pool which is not one of the client's first probes
+    // is as good as no hint.
+    EXPECT_EQ(first, alloc.pickAddress(subnet_, clientid_,
+                                       IOAddress("10.0.0.1")));
+
+    // The probes of the client cover the pool without repeating.
+    std::set<IOAddress> picked;
+    IOAddress candidate = first;
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(subnet_->inPool(Lease::TYPE_V4, candidate));
+        EXPECT_TRUE(picked.insert(candidate).second) << candidate;
+        candidate = alloc.pickAddress(subnet_, clientid_, candidate);
+    }
+    EXPECT_EQ(10, picked.size());
+    // After the last probe it starts over.
+    EXPECT_EQ(first, candidate);
+
+    // Other clients don't all get the same address.
+    picked.clear();
+    for (uint8_t i = 0; i < 20; ++i) {
+        ClientIdPtr clientid(new ClientId(vector<uint8_t>(8, i)));
+        picked.insert(alloc.pickAddress(subnet_, clientid,
+                                        IOAddress("0.0.0.0")));
+    }
+    EXPECT_LT(1, picked.size());
+}
+
+// This test verifies that the hashed allocation engine gives the same
+// address to the same client.
+TEST_F(AllocEngine4Test, hashedAlloc4) {
+    AllocEngine engine(AllocEngine::ALLOC_HASHED, 100, false);
+
+    Lease4Ptr lease = engine.allocateLease4(subnet_, clientid_, hwaddr_,
+                                            IOAddress("0.0.0.0"),
+                                            false, false, "", true,
+                                            CalloutHandlePtr(), old_lease_);
+    ASSERT_TRUE(lease);
+    const IOAddress first = lease->addr_;
+    lease = engine.allocateLease4(subnet_, clientid_, hwaddr_,
+                                  IOAddress("0.0.0.0"), false, false, "",
+                                  true, CalloutHandlePtr(), old_lease_);
+    ASSERT_TRUE(lease);
+    EXPECT_EQ(first, lease->addr_);
+
+    // Without client-id the hardware address is used.
+    clientid_.reset();
+    lease = engine.allocateLease4(subnet_, clientid_, hwaddr_,
+                                  IOAddress("0.0.0.0"), false, false, "",
+                                  true, CalloutHandlePtr(), old_lease_);
+    ASSERT_TRUE(lease);
+    const IOAddress second = lease->addr_;
+    lease = engine.allocateLease4(subnet_, clientid_, hwaddr_,
+                                  IOAddress("0.0.0.0"), false, false, "",
+                                  true, CalloutHandlePtr(), old_lease_);
+    ASSERT_TRUE(lease);
+    EXPECT_EQ(second, lease->addr_);
+}
+
+// This test verifies that the random allocator picks all the addresses of
+// all the pools once before picking any of them again.
+TEST_F(AllocEngine4Test, RandomAllocator_manyPools4) {
+    NakedAllocEngine::RandomAllocator alloc(Lease::TYPE_V4);
+
+    for (int i = 2; i < 10; ++i) {
+        stringstream min, max;
+        min << "192.0.2." << i * 10 + 1;
+        max << "192.0.2." << i * 10 + 9;
+        subnet_->addPool(Pool4Ptr(new Pool4(IOAddress(min.str()),
+                                            IOAddress(max.str()))));
+    }
+    const size_t total = 10 + 8 * 9;
+
+    // The pools are picked at random, so an address may be picked again
+    // before all the others, but not before all the others of its pool.
+    std::set<IOAddress> picked;
+    for (int i = 0; i < 1000 && picked.size() < total; ++i) {
+        IOAddress candidate = alloc.pickAddress(subnet_, clientid_,
+                                                IOAddress("0.0.0.0"));
+        EXPECT_TRUE(subnet_->inPool(Lease::TYPE_V4, candidate));
+        picked.insert(candidate);
+    }
+    EXPECT_EQ(total, picked.size());
+
+    // All the addresses of a single pool are picked once.
+    NakedAllocEngine::RandomAllocator single(Lease::TYPE_V4);
+    Subnet4Ptr subnet(new Subnet4(IOAddress("10.0.0.0"), 24, 1, 2, 3));
+    subnet->addPool(Pool4Ptr(new Pool4(IOAddress("10.0.0.0"), 24)));
+    picked.clear();
+    for (int i = 0; i < 256; ++i) {
+        EXPECT_TRUE(picked.insert(single.pickAddress(subnet, clientid_,
+                                                     IOAddress("0.0.0.0")))
+                    .second);
+    }
+}
 
 // This test checks if really small pools are working
 TEST_F(AllocEngine4Test, smallPool4) {
@@ -1556,6 +1773,52 @@ TEST_F(AllocEngine4Test, renewLease4) {
     detailCompareLease(lease, from_mgr);
 }
 
+// This test checks that the expired leases are reclaimed in batches, the
+// earliest expired first, that valid leases are kept and that the addresses
+// of the reclaimed leases are allocated again.
+TEST_F(AllocEngine4Test, reclaimExpiredLeases4) {
+    NakedAllocEngine::IterativeAllocator alloc(Lease::TYPE_V4);
+
+    // Lease all the addresses of the pool, those of 192.0.2.103 and
+    // 192.0.2.107 having expired 100 and 500 seconds ago.
+    uint8_t hwaddr[] = { 0, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe};
+    for (int i = 100; i <= 109; ++i) {
+        stringstream addr;
+        addr << "192.0.2." << i;
+        hwaddr[5] = i;
+        time_t cltt = time(NULL);
+        if (i == 103) {
+            cltt -= 600;
+        } else if (i == 107) {
+            cltt -= 1000;
+        }
+        Lease4Ptr lease(new Lease4(IOAddress(addr.str()), hwaddr,
+                                   sizeof(hwaddr), NULL, 0, 500, 250, 400,
+                                   cltt, subnet_->getID()));
+        ASSERT_TRUE(LeaseMgrFactory::instance().addLease(lease));
+    }
+
+    Lease4Collection reclaimed = AllocEngine::reclaimExpiredLeases4(1);
+    ASSERT_EQ(1, reclaimed.size());
+    EXPECT_EQ("192.0.2.107", reclaimed[0]->addr_.toText());
+    EXPECT_FALSE(LeaseMgrFactory::instance().
+                 getLease4(IOAddress("192.0.2.107")));
+    EXPECT_TRUE(LeaseMgrFactory::instance().
+                getLease4(IOAddress("192.0.2.103")));
+    EXPECT_EQ("192.0.2.107", alloc.pickAddress(subnet_, clientid_,
+                                               IOAddress("0.0.0.0")).toText());
+
+    reclaimed = AllocEngine::reclaimExpiredLeases4(0);
+    ASSERT_EQ(1, reclaimed.size());
+    EXPECT_EQ("192.0.2.103", reclaimed[0]->addr_.toText());
+
+    // The valid leases are kept.
+    EXPECT_TRUE(AllocEngine::reclaimExpiredLeases4(0).empty());
+    EXPECT_EQ(8, LeaseMgrFactory::instance().
+              getLeases4(IOAddress("192.0.2.100"),
+                         IOAddress("192.0.2.109")).size());
+}
+
 /// @brief helper class used in Hooks testing in AllocEngine6
 ///
 /// It features a couple of callout functions and buffers to store
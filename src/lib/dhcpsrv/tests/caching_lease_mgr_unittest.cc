@@ -0,0 +1,297 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/duid.h>
+#include <dhcpsrv/caching_lease_mgr.h>
+#include <dhcpsrv/memfile_lease_mgr.h>
+#include <dhcpsrv/tests/test_utils.h>
+#include <dhcpsrv/tests/generic_lease_mgr_unittest.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace bundy;
+using namespace bundy::asiolink;
+using namespace bundy::dhcp;
+using namespace bundy::dhcp::test;
+
+namespace {
+
+// The memfile backend stands for the database in these tests, so the
+// leases are changed "in the database" by changing them in the backend
+// directly.
+class CachingLeaseMgrTest : public GenericLeaseMgrTest {
+public:
+    CachingLeaseMgrTest() {
+        createLeaseMgr(100);
+    }
+
+    /// @brief Creates the lease manager and its cache.
+    ///
+    /// @param cache_size the number of leases of the cache.
+    void createLeaseMgr(size_t cache_size) {
+        LeaseMgr::ParameterMap parameters;
+        parameters["type"] = "memfile";
+        parameters["universe"] = "4";
+        parameters["persist"] = "false";
+        cache_.reset(new LeaseCache(cache_size));
+        backend_ = new Memfile_LeaseMgr(parameters);
+        lease_mgr_.reset(new CachingLeaseMgr(parameters, backend_, cache_));
+        lmptr_ = lease_mgr_.get();
+    }
+
+    virtual ~CachingLeaseMgrTest() {
+        lmptr_ = NULL;
+    }
+
+    /// @brief Flushes the cache.
+    ///
+    /// The leases are in memory, so they can't be read from the database
+    /// again, but they are read from the backend after the cache is
+    /// flushed.
+    virtual void reopen(Universe) {
+        cache_->flush();
+    }
+
+    LeaseCachePtr cache_;
+    Memfile_LeaseMgr* backend_;
+    boost::scoped_ptr<CachingLeaseMgr> lease_mgr_;
+};
+
+// The same tests as for the memfile backend.
+
+TEST_F(CachingLeaseMgrTest, getType) {
+    EXPECT_EQ("memfile", lmptr_->getType());
+    EXPECT_EQ("memory", lmptr_->getName());
+    EXPECT_EQ(backend_, &lease_mgr_->getBackend());
+}
+
+TEST_F(CachingLeaseMgrTest, addGetDelete6) {
+    testAddGetDelete6(true);
+}
+
+TEST_F(CachingLeaseMgrTest, basicLease4) {
+    testBasicLease4();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4ClientId) {
+    testGetLease4ClientId();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4NullClientId) {
+    testGetLease4NullClientId();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4HWAddr1) {
+    testGetLease4HWAddr1();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4HWAddr2) {
+    testGetLease4HWAddr2();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4ClientIdHWAddrSubnetId) {
+    testGetLease4ClientIdHWAddrSubnetId();
+}
+
+TEST_F(CachingLeaseMgrTest, lease4NullClientId) {
+    testLease4NullClientId();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4ClientId2) {
+    testGetLease4ClientId2();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease4ClientIdSubnetId) {
+    testGetLease4ClientIdSubnetId();
+}
+
+TEST_F(CachingLeaseMgrTest, getLeases4Range) {
+    testGetLeases4Range();
+}
+
+TEST_F(CachingLeaseMgrTest, getExpiredLeases4) {
+    testGetExpiredLeases4();
+}
+
+TEST_F(CachingLeaseMgrTest, basicLease6) {
+    testBasicLease6();
+}
+
+TEST_F(CachingLeaseMgrTest, getExpiredLeases6) {
+    testGetExpiredLeases6();
+}
+
+TEST_F(CachingLeaseMgrTest, getLease6DuidIaidSubnetId) {
+    testGetLease6DuidIaidSubnetId();
+}
+
+TEST_F(CachingLeaseMgrTest, recreateLease4) {
+    testRecreateLease4();
+}
+
+TEST_F(CachingLeaseMgrTest, recreateLease6) {
+    testRecreateLease6();
+}
+
+// Checks that the leases are returned by the cache.
+TEST_F(CachingLeaseMgrTest, cachedLease4) {
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_EQ(1, cache_->getLease4Count());
+
+    const HWAddr hwaddr(lease->hwaddr_, HTYPE_ETHER);
+
+    // Remove the lease from the database: it is still found in the cache,
+    // with all the lookups of a single lease.
+    ASSERT_TRUE(backend_->deleteLease(lease->addr_));
+    const uint64_t hits = cache_->getHits();
+    Lease4Ptr cached = lmptr_->getLease4(lease->addr_);
+    ASSERT_TRUE(cached);
+    detailCompareLease(lease, cached);
+    cached = lmptr_->getLease4(hwaddr, lease->subnet_id_);
+    ASSERT_TRUE(cached);
+    detailCompareLease(lease, cached);
+    cached = lmptr_->getLease4(*lease->client_id_, lease->subnet_id_);
+    ASSERT_TRUE(cached);
+    detailCompareLease(lease, cached);
+    cached = lmptr_->getLease4(*lease->client_id_, hwaddr,
+                               lease->subnet_id_);
+    ASSERT_TRUE(cached);
+    detailCompareLease(lease, cached);
+    EXPECT_EQ(hits + 4, cache_->getHits());
+
+    // The returned leases are copies.
+    cached->valid_lft_ = 1;
+    detailCompareLease(lease, lmptr_->getLease4(lease->addr_));
+
+    // The lookups of several leases are done in the database.
+    EXPECT_TRUE(lmptr_->getLease4(*lease->client_id_).empty());
+
+    // Once the cache is flushed, the lease is looked up in the database.
+    cache_->flush();
+    EXPECT_EQ(0, cache_->getLease4Count());
+    const uint64_t misses = cache_->getMisses();
+    EXPECT_FALSE(lmptr_->getLease4(lease->addr_));
+    EXPECT_EQ(misses + 1, cache_->getMisses());
+
+    // A lease read from the database is cached.
+    ASSERT_TRUE(backend_->addLease(lease));
+    ASSERT_TRUE(lmptr_->getLease4(hwaddr, lease->subnet_id_));
+    ASSERT_TRUE(backend_->deleteLease(lease->addr_));
+    EXPECT_TRUE(lmptr_->getLease4(lease->addr_));
+}
+
+// Checks that the writes go through to the database.
+TEST_F(CachingLeaseMgrTest, writeThrough4) {
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    detailCompareLease(lease, backend_->getLease4(lease->addr_));
+    EXPECT_FALSE(lmptr_->addLease(lease));
+
+    lease->valid_lft_ += 100;
+    lmptr_->updateLease4(lease);
+    detailCompareLease(lease, backend_->getLease4(lease->addr_));
+    detailCompareLease(lease, lmptr_->getLease4(lease->addr_));
+
+    EXPECT_TRUE(lmptr_->deleteLease(lease->addr_));
+    EXPECT_FALSE(backend_->getLease4(lease->addr_));
+    EXPECT_FALSE(lmptr_->getLease4(lease->addr_));
+    EXPECT_EQ(0, cache_->getLease4Count());
+
+    // An update failing in the database removes the lease from the cache.
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    ASSERT_TRUE(backend_->deleteLease(lease->addr_));
+    EXPECT_THROW(lmptr_->updateLease4(lease), NoSuchLease);
+    EXPECT_FALSE(lmptr_->getLease4(lease->addr_));
+}
+
+// Checks that the DHCPv6 leases are returned by the cache.
+TEST_F(CachingLeaseMgrTest, cachedLease6) {
+    const Lease6Ptr lease = initializeLease6(straddress6_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_EQ(1, cache_->getLease6Count());
+    ASSERT_TRUE(backend_->deleteLease(lease->addr_));
+
+    const Lease6Ptr cached = lmptr_->getLease6(lease->type_, lease->addr_);
+    ASSERT_TRUE(cached);
+    detailCompareLease(lease, cached);
+
+    // The type of the lease is checked.
+    const Lease::Type other_type = lease->type_ == Lease::TYPE_NA ?
+        Lease::TYPE_TA : Lease::TYPE_NA;
+    EXPECT_FALSE(lmptr_->getLease6(other_type, lease->addr_));
+
+    // The leases of a client are read from the database, and cached.
+    ASSERT_TRUE(backend_->addLease(lease));
+    cache_->flush();
+    EXPECT_EQ(1, lmptr_->getLeases6(lease->type_, *lease->duid_,
+                                    lease->iaid_, lease->subnet_id_).size());
+    EXPECT_EQ(1, cache_->getLease6Count());
+
+    EXPECT_TRUE(lmptr_->deleteLease(lease->addr_));
+    EXPECT_FALSE(lmptr_->getLease6(lease->type_, lease->addr_));
+    EXPECT_EQ(0, cache_->getLease6Count());
+}
+
+// Checks that the least recently used leases are dropped.
+TEST_F(CachingLeaseMgrTest, leastRecentlyUsed) {
+    const Lease4Ptr first = initializeLease4(straddress4_[1]);
+    const Lease4Ptr second = initializeLease4(straddress4_[2]);
+    createLeaseMgr(2);
+    ASSERT_TRUE(lmptr_->addLease(first));
+    ASSERT_TRUE(lmptr_->addLease(second));
+
+    // The first lease is used, so the second is dropped.
+    ASSERT_TRUE(lmptr_->getLease4(first->addr_));
+    ASSERT_TRUE(lmptr_->addLease(initializeLease4(straddress4_[3])));
+    EXPECT_EQ(2, cache_->getLease4Count());
+    ASSERT_TRUE(backend_->deleteLease(first->addr_));
+    ASSERT_TRUE(backend_->deleteLease(second->addr_));
+    EXPECT_TRUE(lmptr_->getLease4(first->addr_));
+    EXPECT_FALSE(lmptr_->getLease4(second->addr_));
+}
+
+// Checks that a lease read before a write is not cached.
+TEST_F(CachingLeaseMgrTest, version) {
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    const uint64_t version = cache_->getVersion();
+    cache_->update(initializeLease4(straddress4_[2]));
+    EXPECT_NE(version, cache_->getVersion());
+    cache_->insert(lease, version);
+    EXPECT_FALSE(cache_->getLease4(lease->addr_));
+
+    cache_->insert(lease, cache_->getVersion());
+    EXPECT_TRUE(cache_->getLease4(lease->addr_));
+
+    // Nothing can be cached in a cache of no lease.
+    EXPECT_THROW(LeaseCache(0), BadValue);
+}
+
+// Checks that a rolled back transaction flushes the cache.
+TEST_F(CachingLeaseMgrTest, rollback) {
+    ASSERT_TRUE(lmptr_->addLease(initializeLease4(straddress4_[1])));
+    ASSERT_TRUE(lmptr_->addLease(initializeLease6(straddress6_[1])));
+    lmptr_->commit();
+    EXPECT_EQ(1, cache_->getLease4Count());
+    lmptr_->rollback();
+    EXPECT_EQ(0, cache_->getLease4Count());
+    EXPECT_EQ(0, cache_->getLease6Count());
+}
+
+}; // end of anonymous namespace
@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -20,6 +20,9 @@
 #include <dhcpsrv/callout_handle_store.h>
 #include "test_get_callout_handle.h"
 
+#include <util/threads/thread.h>
+
+#include <boost/bind.hpp>
 #include <gtest/gtest.h>
 
 using namespace bundy;
@@ -119,4 +122,78 @@ TEST(CalloutHandleStoreTest, SeparateCompilationUnit) {
     EXPECT_TRUE(chptr_1 == chptr_2);
 }
 
+// Gets the CalloutHandle of the packet twice.
+void
+getHandleInThread(const Pkt4Ptr& pktptr, CalloutHandlePtr* chptr_1,
+                  CalloutHandlePtr* chptr_2)
+{
+    *chptr_1 = getCalloutHandle(pktptr);
+    *chptr_2 = getCalloutHandle(pktptr);
+}
+
+// Checks that each thread has its own stored packet and CalloutHandle, so
+// that threads processing packets in parallel don't share a handle.
+
+TEST(CalloutHandleStoreTest, PerThread) {
+    Pkt4Ptr pktptr(new Pkt4(DHCPOFFER, 1234));
+    CalloutHandlePtr chptr = getCalloutHandle(pktptr);
+    ASSERT_TRUE(chptr);
+
+    // Another thread gets a handle of its own, even for the same packet,
+    // and gets it again for that packet.
+    CalloutHandlePtr chptr_1, chptr_2;
+    bundy::util::thread::Thread thread(boost::bind(getHandleInThread, pktptr,
+                                                   &chptr_1, &chptr_2));
+    thread.wait();
+    ASSERT_TRUE(chptr_1);
+    EXPECT_TRUE(chptr_1 != chptr);
+    EXPECT_TRUE(chptr_1 == chptr_2);
+
+    // The data of the thread was released when it exited.
+    EXPECT_EQ(2, chptr_1.use_count());
+
+    // The handle of this thread hasn't been changed.
+    EXPECT_TRUE(chptr == getCalloutHandle(pktptr));
+
+    // Clear the stored pointers.
+    getCalloutHandle(Pkt4Ptr());
+}
+
+// Gets the CalloutHandle of a packet after setting it.
+void
+setHandleInThread(const Pkt4Ptr& pktptr, const CalloutHandlePtr& chptr,
+                  CalloutHandlePtr* chptr_1)
+{
+    setCalloutHandle(pktptr, chptr);
+    *chptr_1 = getCalloutHandle(pktptr);
+}
+
+// Checks that the CalloutHandle of a packet can be passed to another
+// thread, as done when the processing of a parked packet is resumed.
+
+TEST(CalloutHandleStoreTest, SetHandle) {
+    Pkt4Ptr pktptr(new Pkt4(DHCPDISCOVER, 1234));
+    CalloutHandlePtr chptr = getCalloutHandle(pktptr);
+    ASSERT_TRUE(chptr);
+
+    CalloutHandlePtr chptr_1;
+    bundy::util::thread::Thread thread(boost::bind(setHandleInThread, pktptr,
+                                                   chptr, &chptr_1));
+    thread.wait();
+    EXPECT_TRUE(chptr_1 == chptr);
+
+    // Another packet gets another handle.
+    Pkt4Ptr pktptr_2(new Pkt4(DHCPDISCOVER, 5678));
+    CalloutHandlePtr chptr_2 = getCalloutHandle(pktptr_2);
+    EXPECT_TRUE(chptr_2 != chptr);
+
+    // Setting the handle replaces the stored one.
+    setCalloutHandle(pktptr, chptr);
+    EXPECT_TRUE(chptr == getCalloutHandle(pktptr));
+    EXPECT_EQ(1, chptr_2.use_count());
+
+    // Clear the stored pointers.
+    getCalloutHandle(Pkt4Ptr());
+}
+
 } // Anonymous namespace
@@ -971,6 +971,19 @@ TEST_F(CfgMgrTest, echoClientId) {
     EXPECT_TRUE(cfg_mgr.echoClientId());
 }
 
+// This test verifies that the limit of parked packets may be configured.
+TEST_F(CfgMgrTest, parkedPacketLimit) {
+    CfgMgr& cfg_mgr = CfgMgr::instance();
+
+    EXPECT_EQ(CfgMgr::DEFAULT_PARKED_PACKET_LIMIT,
+              cfg_mgr.getParkedPacketLimit());
+
+    cfg_mgr.setParkedPacketLimit(16);
+    EXPECT_EQ(16, cfg_mgr.getParkedPacketLimit());
+
+    cfg_mgr.setParkedPacketLimit(CfgMgr::DEFAULT_PARKED_PACKET_LIMIT);
+}
+
 // This test checks the D2ClientMgr wrapper methods.
 TEST_F(CfgMgrTest, d2ClientConfig) {
     // After CfgMgr construction, D2ClientMgr member should be initialized
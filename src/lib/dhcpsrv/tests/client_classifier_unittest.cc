@@ -0,0 +1,329 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <dhcp/dhcp4.h>
+#include <dhcp/dhcp6.h>
+#include <dhcp/option_string.h>
+#include <dhcp/pkt4.h>
+#include <dhcp/pkt6.h>
+#include <dhcpsrv/client_classifier.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+
+namespace {
+
+class ClientClassifierTest : public ::testing::Test {
+public:
+    ClientClassifierTest() : classifier4_(Option::V4),
+                             classifier6_(Option::V6),
+                             pkt4_(new Pkt4(DHCPDISCOVER, 1234)),
+                             pkt6_(new Pkt6(DHCPV6_SOLICIT, 1234))
+    {
+        const uint8_t hwaddr[] = { 0x0a, 0x0b, 0x0c, 0x01, 0x02, 0x03 };
+        pkt4_->setHWAddr(HTYPE_ETHER, sizeof(hwaddr),
+                         std::vector<uint8_t>(hwaddr,
+                                              hwaddr + sizeof(hwaddr)));
+    }
+
+    // Adds a string option to the DHCPv4 packet
+    void addOption4(uint16_t code, const std::string& value) {
+        pkt4_->addOption(OptionPtr(new OptionString(Option::V4, code,
+                                                    value)));
+    }
+
+    // Adds the relay agent information option with a sub-option to the
+    // DHCPv4 packet
+    void addAgentOption4(uint16_t code, const std::string& value) {
+        OptionPtr agent(new Option(Option::V4, DHO_DHCP_AGENT_OPTIONS));
+        agent->addOption(OptionPtr(new Option(Option::V4, code,
+                                              OptionBuffer(value.begin(),
+                                                           value.end()))));
+        pkt4_->addOption(agent);
+    }
+
+    // Classifies the DHCPv4 packet and returns its classes separated by
+    // spaces
+    std::string classify4() {
+        pkt4_->classes_.clear();
+        const size_t count = classifier4_.classify(*pkt4_);
+        EXPECT_EQ(pkt4_->classes_.size(), count);
+        return (classesText(pkt4_->classes_));
+    }
+
+    // Classifies the DHCPv6 packet and returns its classes
+    std::string classify6() {
+        pkt6_->classes_.clear();
+        const size_t count = classifier6_.classify(*pkt6_);
+        EXPECT_EQ(pkt6_->classes_.size(), count);
+        return (classesText(pkt6_->classes_));
+    }
+
+    static std::string classesText(const ClientClasses& classes) {
+        std::string text;
+        for (ClientClasses::const_iterator it = classes.begin();
+             it != classes.end(); ++it) {
+            text += (text.empty() ? "" : " ") + *it;
+        }
+        return (text);
+    }
+
+    ClientClassifier classifier4_;
+    ClientClassifier classifier6_;
+    Pkt4Ptr pkt4_;
+    Pkt6Ptr pkt6_;
+};
+
+// Checks that the tests which are not valid are rejected.
+TEST_F(ClientClassifierTest, invalidTests) {
+    const char* tests[] = {
+        "",
+        "   ",
+        "option",
+        "option[]",
+        "option[256]",
+        "option[99999999999]",
+        "option[60",
+        "option[60] ==",
+        "option[60] = 'a'",
+        "option[60] and",
+        "(option[60]",
+        "option[60])",
+        "option[60] option[61]",
+        "'unterminated",
+        "0x",
+        "0xzz",
+        "substring(option[60], 0)",
+        "substring(option[60], 0, some)",
+        "member('unknown')",
+        "member(unknown)",
+        "unknown",
+        "option[60] == 'a' ; option[61]",
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+        EXPECT_THROW(classifier4_.addClass("foo", tests[i]),
+                     ClassExpressionError) << tests[i];
+    }
+
+    // Options codes are 16 bits and there is no hardware address in
+    // DHCPv6.
+    EXPECT_NO_THROW(classifier6_.addClass("foo", "option[1000]"));
+    EXPECT_THROW(classifier6_.addClass("bar", "option[65536]"),
+                 ClassExpressionError);
+    EXPECT_THROW(classifier6_.addClass("bar", "hwaddr"),
+                 ClassExpressionError);
+
+    // The names of the classes are unique.
+    EXPECT_THROW(classifier6_.addClass("foo", "option[1]"),
+                 ClassExpressionError);
+}
+
+// Checks that a test which needs a too deep stack is rejected.
+TEST_F(ClientClassifierTest, stackDepth) {
+    std::string test = "'a'";
+    for (size_t i = 0; i < ClientClassifier::MAX_STACK_DEPTH; ++i) {
+        test = "'a' == (" + test + ")";
+    }
+    EXPECT_THROW(classifier4_.addClass("foo", test), ClassExpressionError);
+
+    // The operands of "or" and "and" don't stay on the stack.
+    test = "option[1]";
+    for (size_t i = 0; i < ClientClassifier::MAX_STACK_DEPTH * 2; ++i) {
+        test += " or option[1] and option[2]";
+    }
+    EXPECT_NO_THROW(classifier4_.addClass("foo", test));
+}
+
+// Checks that a test which is not valid doesn't change the classifier.
+TEST_F(ClientClassifierTest, rollback) {
+    classifier4_.addClass("foo", "option[60] == 'foo'");
+    const size_t fields = classifier4_.getFieldCount();
+    const size_t size = classifier4_.getProgramSize();
+
+    EXPECT_THROW(classifier4_.addClass("bar", "option[61] == 'bar' and"),
+                 ClassExpressionError);
+    EXPECT_EQ(1, classifier4_.getClassCount());
+    EXPECT_EQ(fields, classifier4_.getFieldCount());
+    EXPECT_EQ(size, classifier4_.getProgramSize());
+
+    // The failed class may be added again.
+    classifier4_.addClass("bar", "option[61] == 'bar'");
+    EXPECT_EQ(2, classifier4_.getClassCount());
+    EXPECT_EQ("foo", classifier4_.getClassName(0));
+    EXPECT_EQ("bar", classifier4_.getClassName(1));
+
+    addOption4(60, "foo");
+    addOption4(61, "bar");
+    EXPECT_EQ("bar foo", classify4());
+}
+
+// Checks that a field used by several tests is read once.
+TEST_F(ClientClassifierTest, fields) {
+    classifier4_.addClass("a", "option[60] == 'a'");
+    classifier4_.addClass("b", "option[60] == 'b' or option[61]");
+    classifier4_.addClass("c", "substring(option[60], 0, 1) == 'c'");
+    EXPECT_EQ(2, classifier4_.getFieldCount());
+
+    EXPECT_EQ("", classify4());
+    addOption4(60, "b");
+    EXPECT_EQ("b", classify4());
+}
+
+// Checks the tests of the presence of an option.
+TEST_F(ClientClassifierTest, optionPresent) {
+    classifier4_.addClass("with", "option[60]");
+    classifier4_.addClass("without", "not option[60]");
+
+    EXPECT_EQ("without", classify4());
+    addOption4(60, "docsis3.0");
+    EXPECT_EQ("with", classify4());
+}
+
+// Checks the comparisons of the options with the constants.
+TEST_F(ClientClassifierTest, equal) {
+    classifier4_.addClass("text", "option[60] == 'docsis3.0'");
+    classifier4_.addClass("quoted", "option[60] == \"docsis3.0\"");
+    classifier4_.addClass("hex", "option[60] == 0x646f63736973332e30");
+    classifier4_.addClass("other", "option[60] == 'docsis3'");
+    classifier4_.addClass("swapped", "'docsis3.0' == option[60]");
+    classifier4_.addClass("absent", "option[61] == option[62]");
+
+    addOption4(60, "docsis3.0");
+    EXPECT_EQ("hex quoted swapped text", classify4());
+}
+
+// Checks the substrings of the options.
+TEST_F(ClientClassifierTest, substring) {
+    classifier4_.addClass("prefix", "substring(option[60], 0, 6) == 'docsis'");
+    classifier4_.addClass("suffix", "substring(option[60], 6, all) == '3.0'");
+    classifier4_.addClass("middle", "substring(option[60], 6, 1) == 0x33");
+    classifier4_.addClass("long", "substring(option[60], 0, 100) == "
+                          "'docsis3.0'");
+    classifier4_.addClass("beyond", "substring(option[60], 100, 1) == ''");
+    classifier4_.addClass("absent", "substring(option[61], 0, all) == ''");
+
+    addOption4(60, "docsis3.0");
+    EXPECT_EQ("beyond long middle prefix suffix", classify4());
+}
+
+// Checks the sub-options of the relay agent information option.
+TEST_F(ClientClassifierTest, relay4) {
+    classifier4_.addClass("circuit", "relay[1] == 'eth0'");
+    classifier4_.addClass("remote", "relay[2]");
+    // The option holding sub-options compares with their encoding.
+    classifier4_.addClass("agent", "option[82] == 0x010465746830");
+
+    EXPECT_EQ("", classify4());
+    addAgentOption4(1, "eth0");
+    EXPECT_EQ("agent circuit", classify4());
+
+    // The option as received holds its sub-options as data.
+    const uint8_t data[] = { 1, 4, 'e', 't', 'h', '0', 2, 2, 0xaa, 0xbb };
+    pkt4_->delOption(DHO_DHCP_AGENT_OPTIONS);
+    pkt4_->addOption(OptionPtr(new Option(Option::V4, DHO_DHCP_AGENT_OPTIONS,
+                                          OptionBuffer(data, data +
+                                                       sizeof(data)))));
+    EXPECT_EQ("circuit remote", classify4());
+
+    // A truncated sub-option is ignored.
+    pkt4_->delOption(DHO_DHCP_AGENT_OPTIONS);
+    pkt4_->addOption(OptionPtr(new Option(Option::V4, DHO_DHCP_AGENT_OPTIONS,
+                                          OptionBuffer(data, data +
+                                                       sizeof(data) - 1))));
+    EXPECT_EQ("circuit", classify4());
+}
+
+// Checks the options inserted by the relays of a DHCPv6 packet.
+TEST_F(ClientClassifierTest, relay6) {
+    classifier6_.addClass("interface", "relay[18] == 'eth0'");
+    classifier6_.addClass("remote", "relay[37]");
+
+    EXPECT_EQ("", classify6());
+
+    Pkt6::RelayInfo relay;
+    relay.options_.insert(std::make_pair(D6O_INTERFACE_ID,
+        OptionPtr(new Option(Option::V6, D6O_INTERFACE_ID,
+                             OptionBuffer(4, 'x')))));
+    pkt6_->addRelayInfo(relay);
+    relay.options_.clear();
+    relay.options_.insert(std::make_pair(D6O_INTERFACE_ID,
+        OptionPtr(new OptionString(Option::V6, D6O_INTERFACE_ID, "eth0"))));
+    pkt6_->addRelayInfo(relay);
+
+    // The relay closest to the client is searched first.
+    EXPECT_EQ("interface", classify6());
+}
+
+// Checks the tests of the hardware address.
+TEST_F(ClientClassifierTest, hwaddr) {
+    classifier4_.addClass("vendor", "substring(hwaddr, 0, 3) == 0x0a0b0c");
+    classifier4_.addClass("other", "substring(hwaddr, 0, 3) == 0x0a0b0d");
+    classifier4_.addClass("full", "hwaddr == 0x0a0b0c010203");
+
+    EXPECT_EQ("full vendor", classify4());
+}
+
+// Checks the tests of the classes added before.
+TEST_F(ClientClassifierTest, member) {
+    classifier4_.addClass("modem", "option[60] == 'docsis3.0'");
+    classifier4_.addClass("relayed", "relay[1]");
+    classifier4_.addClass("relayed-modem",
+                          "member('modem') and member(\"relayed\")");
+    classifier4_.addClass("other", "not member('modem')");
+
+    EXPECT_EQ("other", classify4());
+    addOption4(60, "docsis3.0");
+    EXPECT_EQ("modem", classify4());
+    addAgentOption4(1, "eth0");
+    EXPECT_EQ("modem relayed relayed-modem", classify4());
+}
+
+// Checks the precedence of the operators.
+TEST_F(ClientClassifierTest, precedence) {
+    // "and" before "or", "not" before "and", "==" before "not".
+    classifier4_.addClass("a", "option[1] or option[2] and option[3]");
+    classifier4_.addClass("b", "(option[1] or option[2]) and option[3]");
+    classifier4_.addClass("c", "not option[1] and option[2]");
+    classifier4_.addClass("d", "not option[2] == 'x'");
+    classifier4_.addClass("e", "not not option[2]");
+
+    addOption4(2, "x");
+    EXPECT_EQ("c e", classify4());
+    addOption4(1, "y");
+    EXPECT_EQ("a e", classify4());
+    addOption4(3, "z");
+    EXPECT_EQ("a b e", classify4());
+}
+
+// Checks that the classes are added to those already assigned.
+TEST_F(ClientClassifierTest, existingClasses) {
+    classifier4_.addClass("foo", "not option[60]");
+    pkt4_->addClass("VENDOR_CLASS_bar");
+    EXPECT_EQ(1, classifier4_.classify(*pkt4_));
+    EXPECT_TRUE(pkt4_->inClass("VENDOR_CLASS_bar"));
+    EXPECT_TRUE(pkt4_->inClass("foo"));
+
+    // An empty classifier assigns no class.
+    EXPECT_EQ(0, classifier6_.classify(*pkt6_));
+    EXPECT_TRUE(pkt6_->classes_.empty());
+}
+
+}
@@ -1,4 +1,4 @@
-// Copyright (C) 2012-2013 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -49,6 +49,25 @@ public:
         LeaseMgrFactory::destroy();
     }
 
+    /// @brief Checks if a parameter has a boolean or integer value
+    ///
+    /// @param name Name of the parameter.
+    ///
+    /// @return true if the value of the parameter is not quoted in JSON.
+    static bool isUnquoted(const std::string& name) {
+        static const char* names[] = {
+            "persist", "cache-size", "replication-node", "fsync",
+            "compact-interval", "write-behind", "write-behind-queue",
+            "write-behind-batch", "write-behind-delay", NULL
+        };
+        for (size_t i = 0; names[i] != NULL; ++i) {
+            if (name == names[i]) {
+                return (true);
+            }
+        }
+        return (false);
+    }
+
     /// @brief Build JSON String
     ///
     /// Given a array of "const char*" strings representing in order, keyword,
@@ -87,10 +106,10 @@ public:
             }
 
             // Add the keyword and value - make sure that they are quoted.
-            // The only parameter which is not quoted is persist as it
-            // is a boolean value.
+            // The only parameters which are not quoted are the boolean
+            // and integer ones.
             result += quote + keyval[i] + quote + colon + space;
-            if (std::string(keyval[i]) != "persist") {
+            if (!isUnquoted(keyval[i])) {
                 result += quote + keyval[i + 1] + quote;
             } else {
                 result += keyval[i + 1];
@@ -281,6 +300,89 @@ TEST_F(DbAccessParserTest, persistV6Memfile) {
                       config, Option::V6);
 }
 
+// Check that the parser accepts the parameters of the lease file format.
+TEST_F(DbAccessParserTest, formatMemfile) {
+    const char* config[] = {"type",             "memfile",
+                            "format",           "binary",
+                            "fsync",            "false",
+                            "compact-interval", "60",
+                            NULL};
+
+    string json_config = toJson(config);
+    ConstElementPtr json_elements = Element::fromJSON(json_config);
+    EXPECT_TRUE(json_elements);
+
+    TestDbAccessParser parser("lease-database", ParserContext(Option::V4));
+    EXPECT_NO_THROW(parser.build(json_elements));
+    checkAccessString("Valid memfile", parser.getDbAccessParameters(),
+                      config);
+
+    // A negative interval is rejected, not converted to a huge one.
+    json_elements = Element::fromJSON("{ \"type\": \"memfile\", "
+                                      "\"compact-interval\": -1 }");
+    TestDbAccessParser parser2("lease-database", ParserContext(Option::V4));
+    EXPECT_THROW(parser2.build(json_elements), BadValue);
+}
+
+// Check that the parser accepts the lease replication parameters.
+TEST_F(DbAccessParserTest, replicationMemfile) {
+    const char* config[] = {"type",               "memfile",
+                            "replication-socket", "/tmp/dhcp4-a.sock",
+                            "replication-peer",   "/tmp/dhcp4-b.sock",
+                            "replication-node",   "1",
+                            NULL};
+
+    string json_config = toJson(config);
+    ConstElementPtr json_elements = Element::fromJSON(json_config);
+    EXPECT_TRUE(json_elements);
+
+    TestDbAccessParser parser("lease-database", ParserContext(Option::V4));
+    EXPECT_NO_THROW(parser.build(json_elements));
+    checkAccessString("Valid memfile", parser.getDbAccessParameters(),
+                      config, Option::V4);
+}
+
+// Check that the parser accepts the size of the lease cache.
+TEST_F(DbAccessParserTest, cacheSizeMysql) {
+    const char* config[] = {"type",       "mysql",
+                            "name",       "keatest",
+                            "cache-size", "10000",
+                            NULL};
+
+    string json_config = toJson(config);
+    ConstElementPtr json_elements = Element::fromJSON(json_config);
+    EXPECT_TRUE(json_elements);
+
+    TestDbAccessParser parser("lease-database", ParserContext(Option::V4));
+    EXPECT_NO_THROW(parser.build(json_elements));
+    checkAccessString("Valid mysql", parser.getDbAccessParameters(), config);
+}
+
+// Check that the parser accepts the parameters of the write-behind mode.
+TEST_F(DbAccessParserTest, writeBehindMysql) {
+    const char* config[] = {"type",               "mysql",
+                            "name",               "keatest",
+                            "write-behind",       "true",
+                            "write-behind-queue", "5000",
+                            "write-behind-batch", "50",
+                            "write-behind-delay", "0",
+                            NULL};
+
+    string json_config = toJson(config);
+    ConstElementPtr json_elements = Element::fromJSON(json_config);
+    EXPECT_TRUE(json_elements);
+
+    TestDbAccessParser parser("lease-database", ParserContext(Option::V4));
+    EXPECT_NO_THROW(parser.build(json_elements));
+    checkAccessString("Valid mysql", parser.getDbAccessParameters(), config);
+
+    // A negative size is rejected.
+    json_elements = Element::fromJSON("{ \"type\": \"mysql\", "
+                                      "\"write-behind-queue\": -10 }");
+    TestDbAccessParser parser2("lease-database", ParserContext(Option::V4));
+    EXPECT_THROW(parser2.build(json_elements), BadValue);
+}
+
 // Check that the parser works with a valid MySQL configuration
 TEST_F(DbAccessParserTest, validTypeMysql) {
     const char* config[] = {"type",     "mysql",
@@ -250,6 +250,50 @@ TEST_F(DhcpParserTest, interfaceListParserTest) {
     EXPECT_TRUE(cfg_mgr.isActiveIface("eth2"));
 }
 
+/// @brief Check ClientClassesParser basic functionality.
+///
+/// Verifies that the parser:
+/// 1. Does not allow name other than "client-classes"
+/// 2. Rejects classes without a name or with an invalid test
+/// 3. Compiles the classes and sets the classifier in CfgMgr on commit
+/// 4. Removes the classifier when the list is empty
+TEST_F(DhcpParserTest, clientClassesParserTest) {
+    const std::string name = "client-classes";
+    ParserContextPtr context(new ParserContext(Option::V4));
+
+    EXPECT_THROW(ClientClassesParser("bogus_name", context), bundy::BadValue);
+
+    ClientClassesParser parser(name, context);
+    EXPECT_THROW(parser.build(Element::fromJSON("[ { \"test\": \"option[60]\""
+                                                " } ]")),
+                 DhcpConfigError);
+    EXPECT_THROW(parser.build(Element::fromJSON("[ { \"name\": \"foo\" } ]")),
+                 DhcpConfigError);
+    EXPECT_THROW(parser.build(Element::fromJSON("[ { \"name\": \"foo\","
+                                                " \"test\": \"option[60\""
+                                                " } ]")),
+                 DhcpConfigError);
+
+    ElementPtr classes = Element::fromJSON(
+        "[ { \"name\": \"modem\", \"test\": \"option[60] == 'docsis3.0'\" },"
+        "  { \"name\": \"relayed-modem\","
+        "    \"test\": \"member('modem') and relay[1]\" } ]");
+    ASSERT_NO_THROW(parser.build(classes));
+    parser.commit();
+    const ClientClassifierPtr& classifier =
+        CfgMgr::instance().getClientClassifier();
+    ASSERT_TRUE(classifier);
+    EXPECT_EQ(parser.getClassifier(), classifier);
+    ASSERT_EQ(2, classifier->getClassCount());
+    EXPECT_EQ("modem", classifier->getClassName(0));
+    EXPECT_EQ("relayed-modem", classifier->getClassName(1));
+
+    ClientClassesParser empty_parser(name, context);
+    empty_parser.build(Element::createList());
+    empty_parser.commit();
+    EXPECT_FALSE(CfgMgr::instance().getClientClassifier());
+}
+
 // Checks whether option space can be detected as vendor-id
 TEST_F(DhcpParserTest, vendorOptionSpace) {
     EXPECT_EQ(0, SubnetConfigParser::optionSpaceToVendorId(""));
@@ -0,0 +1,108 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/free_address_map.h>
+
+#include <gtest/gtest.h>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+using namespace bundy::asiolink;
+
+namespace {
+
+// Checks that only valid ranges are accepted.
+TEST(FreeAddressMapTest, constructor) {
+    EXPECT_NO_THROW(FreeAddressMap(IOAddress("192.0.2.1"),
+                                   IOAddress("192.0.2.1")));
+    EXPECT_NO_THROW(FreeAddressMap(IOAddress("10.0.0.0"),
+                                   IOAddress("10.255.255.255")));
+    EXPECT_THROW(FreeAddressMap(IOAddress("10.0.0.0"),
+                                IOAddress("11.0.0.0")), BadValue);
+    EXPECT_THROW(FreeAddressMap(IOAddress("192.0.2.2"),
+                                IOAddress("192.0.2.1")), BadValue);
+    EXPECT_THROW(FreeAddressMap(IOAddress("2001:db8::1"),
+                                IOAddress("2001:db8::2")), BadValue);
+}
+
+// Checks marking the addresses as used and free.
+TEST(FreeAddressMapTest, mark) {
+    FreeAddressMap map(IOAddress("192.0.2.10"), IOAddress("192.0.2.209"));
+    EXPECT_EQ(200, map.getFreeCount());
+    EXPECT_TRUE(map.isFree(IOAddress("192.0.2.10")));
+    EXPECT_TRUE(map.isFree(IOAddress("192.0.2.209")));
+    EXPECT_FALSE(map.isFree(IOAddress("192.0.2.9")));
+    EXPECT_FALSE(map.isFree(IOAddress("192.0.2.210")));
+
+    map.markUsed(IOAddress("192.0.2.100"));
+    EXPECT_FALSE(map.isFree(IOAddress("192.0.2.100")));
+    EXPECT_EQ(199, map.getFreeCount());
+
+    // Marking twice doesn't change the count.
+    map.markUsed(IOAddress("192.0.2.100"));
+    EXPECT_EQ(199, map.getFreeCount());
+
+    // Addresses out of range are ignored.
+    map.markUsed(IOAddress("192.0.2.1"));
+    map.markFree(IOAddress("192.0.2.250"));
+    map.markUsed(IOAddress("2001:db8::1"));
+    EXPECT_EQ(199, map.getFreeCount());
+
+    map.markFree(IOAddress("192.0.2.100"));
+    map.markFree(IOAddress("192.0.2.100"));
+    EXPECT_TRUE(map.isFree(IOAddress("192.0.2.100")));
+    EXPECT_EQ(200, map.getFreeCount());
+}
+
+// Checks finding the free addresses.
+TEST(FreeAddressMapTest, findFree) {
+    FreeAddressMap map(IOAddress("10.0.0.0"), IOAddress("10.0.1.9"));
+    IOAddress addr("0.0.0.0");
+
+    // The search starts at the given address, or at the beginning of the
+    // range for addresses before it.
+    ASSERT_TRUE(map.findFree(IOAddress("10.0.0.5"), addr));
+    EXPECT_EQ("10.0.0.5", addr.toText());
+    ASSERT_TRUE(map.findFree(IOAddress("9.0.0.0"), addr));
+    EXPECT_EQ("10.0.0.0", addr.toText());
+    EXPECT_FALSE(map.findFree(IOAddress("10.0.1.10"), addr));
+
+    // Use all but the last address, the search crosses all the words.
+    for (uint32_t i = 0; i < 265; ++i) {
+        map.markUsed(IOAddress(static_cast<uint32_t>(IOAddress("10.0.0.0")) +
+                               i));
+    }
+    EXPECT_EQ(1, map.getFreeCount());
+    ASSERT_TRUE(map.findFree(IOAddress("10.0.0.0"), addr));
+    EXPECT_EQ("10.0.1.9", addr.toText());
+
+    // The addresses before the start are not found.
+    map.markFree(IOAddress("10.0.0.64"));
+    ASSERT_TRUE(map.findFree(IOAddress("10.0.0.65"), addr));
+    EXPECT_EQ("10.0.1.9", addr.toText());
+    ASSERT_TRUE(map.findFree(IOAddress("10.0.0.64"), addr));
+    EXPECT_EQ("10.0.0.64", addr.toText());
+
+    map.markUsed(IOAddress("10.0.1.9"));
+    EXPECT_FALSE(map.findFree(IOAddress("10.0.0.65"), addr));
+
+    map.markUsed(IOAddress("10.0.0.64"));
+    EXPECT_EQ(0, map.getFreeCount());
+    EXPECT_FALSE(map.findFree(IOAddress("10.0.0.0"), addr));
+}
+
+}
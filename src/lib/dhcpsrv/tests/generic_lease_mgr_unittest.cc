@@ -16,6 +16,7 @@
 #include <dhcpsrv/tests/test_utils.h>
 #include <asiolink/io_address.h>
 #include <gtest/gtest.h>
+#include <ctime>
 #include <sstream>
 
 using namespace std;
@@ -1088,6 +1089,128 @@ GenericLeaseMgrTest::testGetLease4ClientIdSubnetId() {
     EXPECT_FALSE(returned);
 }
 
+void
+GenericLeaseMgrTest::testGetExpiredLeases4() {
+    // Make the leases expire in the reverse order of their addresses, the
+    // last four having expired already.
+    vector<Lease4Ptr> leases = createLeases4();
+    const time_t now = time(NULL);
+    for (int i = 0; i < leases.size(); ++i) {
+        leases[i]->valid_lft_ = 1000;
+        leases[i]->cltt_ = now - 2000 + (leases.size() - 1 - i) * 300;
+        EXPECT_TRUE(lmptr_->addLease(leases[i]));
+    }
+
+    // The expired leases are returned, the earliest expired first.
+    Lease4Collection returned = lmptr_->getExpiredLeases4(0);
+    ASSERT_EQ(4, returned.size());
+    for (int i = 0; i < returned.size(); ++i) {
+        detailCompareLease(leases[7 - i], returned[i]);
+    }
+
+    // The number of leases can be limited.
+    returned = lmptr_->getExpiredLeases4(2);
+    ASSERT_EQ(2, returned.size());
+    detailCompareLease(leases[7], returned[0]);
+    detailCompareLease(leases[6], returned[1]);
+
+    // A renewed lease is no longer returned, nor is a deleted one.
+    leases[7]->cltt_ = now;
+    lmptr_->updateLease4(leases[7]);
+    EXPECT_TRUE(lmptr_->deleteLease(ioaddress4_[5]));
+    returned = lmptr_->getExpiredLeases4(10);
+    ASSERT_EQ(2, returned.size());
+    detailCompareLease(leases[6], returned[0]);
+    detailCompareLease(leases[4], returned[1]);
+
+    // A lease which expires again is returned in order.
+    leases[3]->cltt_ = now - 1500;
+    lmptr_->updateLease4(leases[3]);
+    returned = lmptr_->getExpiredLeases4(0);
+    ASSERT_EQ(3, returned.size());
+    detailCompareLease(leases[6], returned[0]);
+    detailCompareLease(leases[3], returned[1]);
+    detailCompareLease(leases[4], returned[2]);
+}
+
+void
+GenericLeaseMgrTest::testGetLeases4Range() {
+    // Get the leases to be used for the test and add all but one of them
+    // to the database, in the reverse order.
+    vector<Lease4Ptr> leases = createLeases4();
+    for (int i = leases.size() - 1; i >= 0; --i) {
+        if (i != 3) {
+            EXPECT_TRUE(lmptr_->addLease(leases[i]));
+        }
+    }
+
+    // The leases of addresses 1 to 5 are returned ordered by address,
+    // without the missing one.
+    Lease4Collection returned = lmptr_->getLeases4(ioaddress4_[1],
+                                                   ioaddress4_[5]);
+    ASSERT_EQ(4, returned.size());
+    detailCompareLease(leases[1], returned[0]);
+    detailCompareLease(leases[2], returned[1]);
+    detailCompareLease(leases[4], returned[2]);
+    detailCompareLease(leases[5], returned[3]);
+
+    // A range of a single address.
+    returned = lmptr_->getLeases4(ioaddress4_[0], ioaddress4_[0]);
+    ASSERT_EQ(1, returned.size());
+    detailCompareLease(leases[0], returned[0]);
+
+    // No leases in the range.
+    returned = lmptr_->getLeases4(ioaddress4_[3], ioaddress4_[3]);
+    EXPECT_TRUE(returned.empty());
+    returned = lmptr_->getLeases4(IOAddress("10.0.0.0"),
+                                  IOAddress("10.0.0.255"));
+    EXPECT_TRUE(returned.empty());
+}
+
+void
+GenericLeaseMgrTest::testGetExpiredLeases6() {
+    // Make the leases expire in the reverse order of their addresses, the
+    // last four having expired already.
+    vector<Lease6Ptr> leases = createLeases6();
+    const time_t now = time(NULL);
+    for (int i = 0; i < leases.size(); ++i) {
+        leases[i]->valid_lft_ = 1000;
+        leases[i]->cltt_ = now - 2000 + (leases.size() - 1 - i) * 300;
+        EXPECT_TRUE(lmptr_->addLease(leases[i]));
+    }
+
+    // The expired leases are returned, the earliest expired first.
+    Lease6Collection returned = lmptr_->getExpiredLeases6(0);
+    ASSERT_EQ(4, returned.size());
+    for (int i = 0; i < returned.size(); ++i) {
+        detailCompareLease(leases[7 - i], returned[i]);
+    }
+
+    // The number of leases can be limited.
+    returned = lmptr_->getExpiredLeases6(2);
+    ASSERT_EQ(2, returned.size());
+    detailCompareLease(leases[7], returned[0]);
+    detailCompareLease(leases[6], returned[1]);
+
+    // A renewed lease is no longer returned, nor is a deleted one.
+    leases[7]->cltt_ = now;
+    lmptr_->updateLease6(leases[7]);
+    EXPECT_TRUE(lmptr_->deleteLease(ioaddress6_[5]));
+    returned = lmptr_->getExpiredLeases6(10);
+    ASSERT_EQ(2, returned.size());
+    detailCompareLease(leases[6], returned[0]);
+    detailCompareLease(leases[4], returned[1]);
+
+    // A lease which expires again is returned in order.
+    leases[3]->cltt_ = now - 1500;
+    lmptr_->updateLease6(leases[3]);
+    returned = lmptr_->getExpiredLeases6(0);
+    ASSERT_EQ(3, returned.size());
+    detailCompareLease(leases[6], returned[0]);
+    detailCompareLease(leases[3], returned[1]);
+    detailCompareLease(leases[4], returned[2]);
+}
+
 void
 GenericLeaseMgrTest::testGetLeases6DuidIaid() {
     // Get the leases to be used for the test.
@@ -158,6 +158,19 @@ public:
     /// a combination of client and subnet IDs.
     void testGetLease4ClientIdSubnetId();
 
+    /// @brief Check GetLeases4 method - access by address range
+    ///
+    /// Adds leases to the database and checks that the leases of the
+    /// addresses of a range are returned in the order of the addresses.
+    void testGetLeases4Range();
+
+    /// @brief Check GetExpiredLeases4 method
+    ///
+    /// Adds leases to the database and checks that the expired ones are
+    /// returned in the order of their expiration times, also after some
+    /// of them are renewed or deleted.
+    void testGetExpiredLeases4();
+
     /// @brief Basic Lease4 Checks
     ///
     /// Checks that the addLease, getLease4(by address), getLease4(hwaddr,subnet_id),
@@ -196,6 +209,13 @@ public:
     /// a combination of DUID and IAID.
     void testGetLeases6DuidIaid();
 
+    /// @brief Check GetExpiredLeases6 method
+    ///
+    /// Adds leases to the database and checks that the expired ones are
+    /// returned in the order of their expiration times, also after some
+    /// of them are renewed or deleted.
+    void testGetExpiredLeases6();
+
     /// @brief Check that the system can cope with a DUID of allowed size.
     void testGetLeases6DuidSize();
 
@@ -0,0 +1,62 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <dhcpsrv/identifier_key.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+
+namespace {
+
+// Checks that the keys of equal identifiers are equal, whatever holds
+// the identifiers.
+TEST(IdentifierKeyTest, equal) {
+    const uint8_t data[] = { 1, 2, 3, 4, 5, 6 };
+    const std::vector<uint8_t> id1(data, data + sizeof(data));
+    const std::vector<uint8_t> id2(id1);
+
+    EXPECT_TRUE(IdentifierKey(id1) == IdentifierKey(id2));
+    EXPECT_TRUE(IdentifierKey(id1) == IdentifierKey(data, sizeof(data)));
+    EXPECT_FALSE(IdentifierKey(id1) != IdentifierKey(id2));
+    EXPECT_EQ(IdentifierKey(id1).getHash(), IdentifierKey(id2).getHash());
+    EXPECT_EQ(IdentifierKey(id1).getHash(), hash_value(IdentifierKey(id2)));
+
+    // Empty identifiers are equal too.
+    EXPECT_TRUE(IdentifierKey(std::vector<uint8_t>()) ==
+                IdentifierKey(NULL, 0));
+}
+
+// Checks that the keys of different identifiers are different.
+TEST(IdentifierKeyTest, different) {
+    const uint8_t data[] = { 1, 2, 3, 4, 5, 6 };
+    const std::vector<uint8_t> id(data, data + sizeof(data));
+    std::vector<uint8_t> other(id);
+    other[5] = 7;
+
+    EXPECT_FALSE(IdentifierKey(id) == IdentifierKey(other));
+    EXPECT_TRUE(IdentifierKey(id) != IdentifierKey(other));
+    EXPECT_NE(IdentifierKey(id).getHash(), IdentifierKey(other).getHash());
+
+    // A prefix of an identifier is a different identifier.
+    EXPECT_FALSE(IdentifierKey(id) == IdentifierKey(data, sizeof(data) - 1));
+    EXPECT_FALSE(IdentifierKey(id) == IdentifierKey(NULL, 0));
+}
+
+}; // end of anonymous namespace
@@ -0,0 +1,301 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+#include <asiolink/io_address.h>
+#include <dhcp/duid.h>
+#include <dhcpsrv/lease_journal.h>
+#include <dhcpsrv/lease_mgr.h>
+#include <dhcpsrv/tests/lease_file_io.h>
+#include <dhcpsrv/tests/test_utils.h>
+#include <util/threads/thread.h>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace bundy;
+using namespace bundy::asiolink;
+using namespace bundy::dhcp;
+using namespace bundy::dhcp::test;
+using namespace bundy::util;
+using bundy::util::thread::Thread;
+
+namespace {
+
+const uint8_t HWADDR0[] = { 0, 1, 2, 3, 4, 5 };
+const uint8_t CLIENTID0[] = { 1, 2, 3, 4 };
+const uint8_t DUID0[] = { 0, 1, 0, 1, 0xa, 0xb, 0xc, 0xd };
+
+/// @brief Test fixture class for @c LeaseJournal.
+class LeaseJournalTest : public ::testing::Test {
+public:
+    /// @brief Constructor, removes the files of previous tests.
+    LeaseJournalTest() : filename_(absolutePath("leases.journal")) {
+        removeFiles();
+    }
+
+    /// @brief Destructor, removes the files.
+    ~LeaseJournalTest() {
+        removeFiles();
+    }
+
+    /// @brief Prepends the absolute path to a file name.
+    static std::string absolutePath(const std::string& filename) {
+        std::ostringstream s;
+        s << TEST_DATA_BUILDDIR << "/" << filename;
+        return (s.str());
+    }
+
+    /// @brief Removes the journal, snapshot and compacting files.
+    void removeFiles() const {
+        LeaseFileIO(filename_).removeFile();
+        LeaseFileIO(filename_ + ".snapshot").removeFile();
+        LeaseFileIO(filename_ + ".compacting").removeFile();
+    }
+
+    /// @brief Returns the size of a file (or -1 if it doesn't exist).
+    static off_t fileSize(const std::string& filename) {
+        struct stat st;
+        return (stat(filename.c_str(), &st) == 0 ? st.st_size : -1);
+    }
+
+    /// @brief Creates an IPv4 lease.
+    static Lease4Ptr createLease4(const std::string& addr, uint32_t valid) {
+        Lease4Ptr lease(new Lease4(IOAddress(addr), HWADDR0, sizeof(HWADDR0),
+                                   CLIENTID0, sizeof(CLIENTID0), valid, 0, 0,
+                                   1400000000, 7, true, false,
+                                   "host.example.org"));
+        return (lease);
+    }
+
+    /// @brief Creates an IPv6 lease.
+    static Lease6Ptr createLease6(Lease::Type type, const std::string& addr,
+                                  uint8_t prefixlen) {
+        DuidPtr duid(new DUID(DUID0, sizeof(DUID0)));
+        Lease6Ptr lease(new Lease6(type, IOAddress(addr), duid, 42, 1800,
+                                   3600, 0, 0, 8, prefixlen));
+        lease->cltt_ = 1400000000;
+        lease->fqdn_rev_ = true;
+        lease->hostname_ = "host6.example.org";
+        return (lease);
+    }
+
+    /// @brief Handler storing the IPv4 leases loaded.
+    void storeLease4(Lease4Ptr& lease) {
+        leases4_.push_back(lease);
+    }
+
+    /// @brief Handler storing the IPv6 leases loaded.
+    void storeLease6(Lease6Ptr& lease) {
+        leases6_.push_back(lease);
+    }
+
+    /// @brief Loads the leases of the journal.
+    void load() {
+        leases4_.clear();
+        leases6_.clear();
+        LeaseJournal journal(filename_, false);
+        journal.load(boost::bind(&LeaseJournalTest::storeLease4, this, _1),
+                     boost::bind(&LeaseJournalTest::storeLease6, this, _1));
+    }
+
+    /// @brief Appends a lease to a journal and waits until it is written.
+    static void appendLease(LeaseJournal* journal, const Lease4Ptr& lease) {
+        journal->sync(journal->append(*lease));
+    }
+
+    /// @brief Name of the journal.
+    std::string filename_;
+
+    /// @brief IPv4 leases loaded.
+    std::vector<Lease4Ptr> leases4_;
+
+    /// @brief IPv6 leases loaded.
+    std::vector<Lease6Ptr> leases6_;
+};
+
+// This test checks that the leases written to the journal are loaded.
+TEST_F(LeaseJournalTest, appendLoad) {
+    Lease4Ptr lease4 = createLease4("192.0.2.1", 3600);
+    Lease6Ptr lease6 = createLease6(Lease::TYPE_NA, "2001:db8:1::1", 128);
+    Lease6Ptr prefix6 = createLease6(Lease::TYPE_PD, "3000:1::", 64);
+    // A lease without client identifier.
+    Lease4Ptr lease4_noid = createLease4("192.0.2.2", 0);
+    lease4_noid->client_id_.reset();
+    lease4_noid->hostname_.clear();
+    {
+        LeaseJournal journal(filename_, true);
+        ASSERT_NO_THROW(journal.open());
+        EXPECT_EQ(0, journal.getLength());
+        uint64_t sequence = journal.append(*lease4);
+        EXPECT_EQ(1, sequence);
+        EXPECT_LT(0, journal.getLength());
+        EXPECT_NO_THROW(journal.sync(sequence));
+        journal.append(*lease6);
+        journal.append(*prefix6);
+        sequence = journal.append(*lease4_noid);
+        EXPECT_NO_THROW(journal.sync(sequence));
+    }
+
+    ASSERT_NO_THROW(load());
+    ASSERT_EQ(2, leases4_.size());
+    ASSERT_EQ(2, leases6_.size());
+    detailCompareLease(lease4, leases4_[0]);
+    detailCompareLease(lease4_noid, leases4_[1]);
+    detailCompareLease(lease6, leases6_[0]);
+    detailCompareLease(prefix6, leases6_[1]);
+
+    // The length of a journal reopened includes its records.
+    LeaseJournal journal(filename_, false);
+    ASSERT_NO_THROW(journal.open());
+    EXPECT_EQ(fileSize(filename_) - 8, journal.getLength());
+}
+
+// This test checks that the records of several threads are written.
+TEST_F(LeaseJournalTest, concurrentAppend) {
+    const size_t thread_count = 8;
+    {
+        LeaseJournal journal(filename_, false);
+        ASSERT_NO_THROW(journal.open());
+        std::vector<boost::shared_ptr<Thread> > threads;
+        for (size_t i = 0; i < thread_count; ++i) {
+            std::ostringstream addr;
+            addr << "192.0.2." << (i + 1);
+            threads.push_back(boost::shared_ptr<Thread>(
+                new Thread(boost::bind(&LeaseJournalTest::appendLease,
+                                       &journal,
+                                       createLease4(addr.str(), 3600)))));
+        }
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads[i]->wait();
+        }
+    }
+    ASSERT_NO_THROW(load());
+    EXPECT_EQ(thread_count, leases4_.size());
+}
+
+// This test checks that a torn record at the end of the journal is
+// discarded and the journal truncated.
+TEST_F(LeaseJournalTest, tornRecord) {
+    {
+        LeaseJournal journal(filename_, false);
+        ASSERT_NO_THROW(journal.open());
+        journal.sync(journal.append(*createLease4("192.0.2.1", 3600)));
+    }
+    const off_t size = fileSize(filename_);
+    {
+        // The record is cut in the middle.
+        LeaseJournal journal(filename_, false);
+        ASSERT_NO_THROW(journal.open());
+        journal.sync(journal.append(*createLease4("192.0.2.2", 3600)));
+    }
+    ASSERT_EQ(0, truncate(filename_.c_str(), fileSize(filename_) - 10));
+
+    ASSERT_NO_THROW(load());
+    ASSERT_EQ(1, leases4_.size());
+    EXPECT_EQ("192.0.2.1", leases4_[0]->addr_.toText());
+    EXPECT_EQ(size, fileSize(filename_));
+
+    // New records follow the complete ones.
+    {
+        LeaseJournal journal(filename_, false);
+        ASSERT_NO_THROW(journal.open());
+        journal.sync(journal.append(*createLease4("192.0.2.3", 3600)));
+    }
+    ASSERT_NO_THROW(load());
+    ASSERT_EQ(2, leases4_.size());
+    EXPECT_EQ("192.0.2.3", leases4_[1]->addr_.toText());
+}
+
+// This test checks that a file which isn't a journal is not loaded and
+// not modified.
+TEST_F(LeaseJournalTest, notJournal) {
+    LeaseFileIO io(filename_);
+    io.writeFile("address,hwaddr,client_id,valid_lifetime,expire,subnet_id,"
+                 "fqdn_fwd,fqdn_rev,hostname\n");
+    const off_t size = fileSize(filename_);
+    EXPECT_THROW(load(), DbOperationError);
+    EXPECT_EQ(size, fileSize(filename_));
+}
+
+// This test checks that a corrupted snapshot is an error.
+TEST_F(LeaseJournalTest, corruptedSnapshot) {
+    OutputBuffer records(0);
+    LeaseJournal::encode(*createLease4("192.0.2.1", 3600), records);
+    {
+        LeaseJournal journal(filename_, false);
+        ASSERT_NO_THROW(journal.writeSnapshot(records));
+    }
+    ASSERT_NO_THROW(load());
+    EXPECT_EQ(1, leases4_.size());
+
+    const std::string snapshot = filename_ + ".snapshot";
+    ASSERT_EQ(0, truncate(snapshot.c_str(), fileSize(snapshot) - 1));
+    EXPECT_THROW(load(), DbOperationError);
+}
+
+// This test checks that the leases are loaded from the snapshot and the
+// journal after a compaction.
+TEST_F(LeaseJournalTest, compaction) {
+    Lease4Ptr lease1 = createLease4("192.0.2.1", 3600);
+    Lease4Ptr lease2 = createLease4("192.0.2.2", 3600);
+    Lease4Ptr lease3 = createLease4("192.0.2.3", 3600);
+    LeaseJournal journal(filename_, false);
+    ASSERT_NO_THROW(journal.open());
+    journal.sync(journal.append(*lease1));
+    journal.sync(journal.append(*lease2));
+    EXPECT_FALSE(journal.compactionPending());
+
+    // Rotate the journal and append a lease meanwhile.
+    ASSERT_NO_THROW(journal.rotate());
+    EXPECT_TRUE(journal.compactionPending());
+    EXPECT_EQ(0, journal.getLength());
+    journal.sync(journal.append(*lease3));
+
+    // The leases are loaded from the journal being compacted.
+    ASSERT_NO_THROW(load());
+    ASSERT_EQ(3, leases4_.size());
+
+    // A failed compaction is continued by the next one.
+    ASSERT_NO_THROW(journal.rotate());
+    EXPECT_EQ(0, journal.getLength());
+    ASSERT_NO_THROW(load());
+    ASSERT_EQ(3, leases4_.size());
+    EXPECT_EQ("192.0.2.3", leases4_[2]->addr_.toText());
+
+    // Write the snapshot.
+    OutputBuffer records(0);
+    LeaseJournal::encode(*lease1, records);
+    LeaseJournal::encode(*lease2, records);
+    LeaseJournal::encode(*lease3, records);
+    ASSERT_NO_THROW(journal.writeSnapshot(records));
+    EXPECT_FALSE(journal.compactionPending());
+    EXPECT_EQ(-1, fileSize(filename_ + ".compacting"));
+
+    // Delete a lease after the snapshot.
+    lease2->valid_lft_ = 0;
+    journal.sync(journal.append(*lease2));
+    ASSERT_NO_THROW(load());
+    ASSERT_EQ(4, leases4_.size());
+    detailCompareLease(lease1, leases4_[0]);
+    detailCompareLease(lease2, leases4_[3]);
+}
+
+}
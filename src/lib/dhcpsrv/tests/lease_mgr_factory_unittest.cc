@@ -1,4 +1,4 @@
-// Copyright (C) 2012 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012-2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -16,8 +16,11 @@
 
 #include <asiolink/io_address.h>
 #include <dhcpsrv/lease_mgr_factory.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
 #include <exceptions/exceptions.h>
+#include <util/threads/thread.h>
 
+#include <boost/bind.hpp>
 #include <gtest/gtest.h>
 
 #include <iostream>
@@ -170,4 +173,107 @@ TEST_F(LeaseMgrFactoryTest, redactAccessStringNoPassword) {
     EXPECT_EQ("mysql", parameters["type"]);
 }
 
+// Creates a session and gets the lease manager the thread uses.
+void
+useSession(bool* created, LeaseMgr** lease_mgr) {
+    *created = LeaseMgrFactory::createSession();
+    *lease_mgr = &LeaseMgrFactory::instance();
+}
+
+/// @brief Sessions of the memfile backend
+///
+/// Checks that the threads share the lease manager when the memfile
+/// backend is used.
+TEST_F(LeaseMgrFactoryTest, memfileSession) {
+    LeaseMgrFactory::destroy();
+    EXPECT_THROW(LeaseMgrFactory::createSession(), NoLeaseManager);
+
+    LeaseMgrFactory::create("type=memfile persist=false universe=4");
+    bool created = true;
+    LeaseMgr* lease_mgr = NULL;
+    bundy::util::thread::Thread thread(boost::bind(useSession, &created,
+                                                   &lease_mgr));
+    thread.wait();
+    EXPECT_FALSE(created);
+    EXPECT_EQ(&LeaseMgrFactory::instance(), lease_mgr);
+
+    // Destroying a session which doesn't exist is a no-op.
+    LeaseMgrFactory::destroySession();
+    EXPECT_EQ(lease_mgr, &LeaseMgrFactory::instance());
+
+    LeaseMgrFactory::destroy();
+    EXPECT_THROW(LeaseMgrFactory::instance(), NoLeaseManager);
+}
+
+/// @brief Lease cache parameter
+///
+/// Checks that the size of the lease cache is checked, and that the
+/// leases of the memfile backend are not cached.
+TEST_F(LeaseMgrFactoryTest, cacheSize) {
+    LeaseMgrFactory::destroy();
+    EXPECT_FALSE(LeaseMgrFactory::flushCache());
+
+    EXPECT_THROW(LeaseMgrFactory::create("type=memfile persist=false "
+                                         "universe=4 cache-size=-1"),
+                 bundy::InvalidParameter);
+    EXPECT_THROW(LeaseMgrFactory::create("type=memfile persist=false "
+                                         "universe=4 cache-size=many"),
+                 bundy::InvalidParameter);
+
+    LeaseMgrFactory::create("type=memfile persist=false universe=4 "
+                            "cache-size=1000");
+    EXPECT_EQ("memfile", LeaseMgrFactory::instance().getType());
+    EXPECT_FALSE(LeaseMgrFactory::flushCache());
+
+    LeaseMgrFactory::destroy();
+}
+
+/// @brief Lease replication parameters
+///
+/// Checks that the changes of the memfile leases are replicated when the
+/// sockets are given, and that the parameters are checked.
+TEST_F(LeaseMgrFactoryTest, replication) {
+    LeaseMgrFactory::destroy();
+    EXPECT_FALSE(LeaseMgrFactory::getReplicator());
+    EXPECT_EQ(0, LeaseMgrFactory::receiveReplication());
+
+    const string socket_a = "/tmp/bundy-lease-factory-a";
+    const string socket_b = "/tmp/bundy-lease-factory-b";
+    const string sockets = " replication-socket=" + socket_a +
+        " replication-peer=" + socket_b;
+    EXPECT_THROW(LeaseMgrFactory::create("type=postgresql name=keatest" +
+                                         sockets),
+                 bundy::InvalidParameter);
+    EXPECT_THROW(LeaseMgrFactory::create("type=memfile persist=false "
+                                         "universe=4 replication-socket=" +
+                                         socket_a),
+                 bundy::InvalidParameter);
+    EXPECT_THROW(LeaseMgrFactory::create("type=memfile persist=false "
+                                         "universe=4 replication-node=x" +
+                                         sockets),
+                 bundy::InvalidParameter);
+    EXPECT_FALSE(LeaseMgrFactory::getReplicator());
+
+    LeaseMgrFactory::create("type=memfile persist=false universe=4 "
+                            "replication-node=1" + sockets);
+    LeaseReplicatorPtr replicator = LeaseMgrFactory::getReplicator();
+    ASSERT_TRUE(replicator);
+    EXPECT_EQ(socket_a, replicator->getSocketName());
+    EXPECT_EQ(socket_b, replicator->getPeerName());
+    EXPECT_EQ(1, replicator->getNode());
+    EXPECT_EQ("memfile", LeaseMgrFactory::instance().getType());
+    EXPECT_TRUE(dynamic_cast<ReplicatingLeaseMgr*>(
+                    &LeaseMgrFactory::instance()));
+    EXPECT_EQ(0, LeaseMgrFactory::receiveReplication());
+    replicator.reset();
+
+    // Without replication, the leases are those of the memfile backend.
+    LeaseMgrFactory::create("type=memfile persist=false universe=4");
+    EXPECT_FALSE(LeaseMgrFactory::getReplicator());
+    EXPECT_FALSE(dynamic_cast<ReplicatingLeaseMgr*>(
+                     &LeaseMgrFactory::instance()));
+
+    LeaseMgrFactory::destroy();
+}
+
 }; // end of anonymous namespace
@@ -173,6 +173,24 @@ public:
         return (leases6_);
     }
 
+    /// @brief Returns expired IPv4 leases
+    ///
+    /// @param max_leases ignored
+    ///
+    /// @return empty collection
+    virtual Lease4Collection getExpiredLeases4(size_t) const {
+        return (Lease4Collection());
+    }
+
+    /// @brief Returns expired IPv6 leases
+    ///
+    /// @param max_leases ignored
+    ///
+    /// @return empty collection
+    virtual Lease6Collection getExpiredLeases6(size_t) const {
+        return (Lease6Collection());
+    }
+
     /// @brief Updates IPv4 lease.
     ///
     /// @param lease4 The lease to be updated.
@@ -28,6 +28,9 @@
 #include <iostream>
 #include <sstream>
 
+#include <signal.h>
+#include <sys/resource.h>
+
 using namespace std;
 using namespace bundy;
 using namespace bundy::asiolink;
@@ -36,6 +39,32 @@ using namespace bundy::dhcp::test;
 
 namespace {
 
+/// @brief Makes the writes of the process past a file size fail while it
+/// exists.
+class FileSizeLimit {
+public:
+    /// @brief Constructor.
+    ///
+    /// @param size the size of the files past which the writes fail.
+    explicit FileSizeLimit(size_t size) {
+        // The writes fail with EFBIG rather than raising the signal.
+        signal(SIGXFSZ, SIG_IGN);
+        getrlimit(RLIMIT_FSIZE, &saved_);
+        struct rlimit limit = saved_;
+        limit.rlim_cur = size;
+        setrlimit(RLIMIT_FSIZE, &limit);
+    }
+
+    /// @brief Destructor (restores the limit).
+    ~FileSizeLimit() {
+        setrlimit(RLIMIT_FSIZE, &saved_);
+        signal(SIGXFSZ, SIG_DFL);
+    }
+
+private:
+    struct rlimit saved_;
+};
+
 // empty class for now, but may be extended once Addr6 becomes bigger
 class MemfileLeaseMgrTest : public GenericLeaseMgrTest {
 public:
@@ -303,6 +332,24 @@ TEST_F(MemfileLeaseMgrTest, getLease4ClientIdSubnetId) {
     testGetLease4ClientIdSubnetId();
 }
 
+/// @brief Check GetLeases4 method - access by address range
+///
+/// Adds leases to the database and checks that the leases of a range of
+/// addresses can be retrieved.
+TEST_F(MemfileLeaseMgrTest, getLeases4Range) {
+    startBackend(V4);
+    testGetLeases4Range();
+}
+
+/// @brief Check GetExpiredLeases4 method
+///
+/// Checks that the expired leases are returned in order of expiration
+/// time, also after leases were updated.
+TEST_F(MemfileLeaseMgrTest, getExpiredLeases4) {
+    startBackend(V4);
+    testGetExpiredLeases4();
+}
+
 /// @brief Basic Lease6 Checks
 ///
 /// Checks that the addLease, getLease6 (by address) and deleteLease (with an
@@ -324,6 +371,15 @@ TEST_F(MemfileLeaseMgrTest, DISABLED_getLeases6DuidIaid) {
     testGetLeases6DuidIaid();
 }
 
+/// @brief Check GetExpiredLeases6 method
+///
+/// Checks that the expired leases are returned in order of expiration
+/// time, also after leases were updated.
+TEST_F(MemfileLeaseMgrTest, getExpiredLeases6) {
+    startBackend(V6);
+    testGetExpiredLeases6();
+}
+
 // Check that the system can cope with a DUID of allowed size.
 
 /// @todo: test disabled, because Memfile_LeaseMgr::getLeases6(Lease::Type,
@@ -404,6 +460,159 @@ TEST_F(MemfileLeaseMgrTest, testRecreateLease6) {
     testRecreateLease6();
 }
 
+// Checks that the parameters of the binary lease journal are validated.
+TEST_F(MemfileLeaseMgrTest, binaryParameters) {
+    LeaseFileIO io(getLeaseFilePath("leasefile4_1.journal"));
+    LeaseFileIO io_snapshot(getLeaseFilePath("leasefile4_1.journal.snapshot"));
+    LeaseMgr::ParameterMap pmap;
+    pmap["universe"] = "4";
+    pmap["name"] = getLeaseFilePath("leasefile4_1.journal");
+    pmap["format"] = "binary";
+    pmap["fsync"] = "false";
+    pmap["compact-interval"] = "60";
+    boost::scoped_ptr<Memfile_LeaseMgr> lease_mgr;
+    EXPECT_NO_THROW(lease_mgr.reset(new Memfile_LeaseMgr(pmap)));
+    ASSERT_TRUE(lease_mgr);
+    EXPECT_TRUE(lease_mgr->persistLeases(Memfile_LeaseMgr::V4));
+    EXPECT_EQ(pmap["name"],
+              lease_mgr->getLeaseFilePath(Memfile_LeaseMgr::V4));
+    const std::string path =
+        lease_mgr->getDefaultLeaseFilePath(Memfile_LeaseMgr::V4);
+    EXPECT_EQ(".journal", path.substr(path.size() - 8));
+
+    pmap["format"] = "bogus";
+    EXPECT_THROW(lease_mgr.reset(new Memfile_LeaseMgr(pmap)), bundy::BadValue);
+    pmap["format"] = "binary";
+    pmap["fsync"] = "bogus";
+    EXPECT_THROW(lease_mgr.reset(new Memfile_LeaseMgr(pmap)), bundy::BadValue);
+    pmap["fsync"] = "true";
+    pmap["compact-interval"] = "bogus";
+    EXPECT_THROW(lease_mgr.reset(new Memfile_LeaseMgr(pmap)), bundy::BadValue);
+}
+
+// Checks that the leases written to the binary journal are loaded, before
+// and after the journal is compacted.
+TEST_F(MemfileLeaseMgrTest, binaryJournal4) {
+    const std::string name = getLeaseFilePath("leasefile4_1.journal");
+    LeaseFileIO io(name);
+    LeaseFileIO io_snapshot(name + ".snapshot");
+    LeaseMgr::ParameterMap pmap;
+    pmap["universe"] = "4";
+    pmap["name"] = name;
+    pmap["format"] = "binary";
+    pmap["compact-interval"] = "0";
+    boost::scoped_ptr<Memfile_LeaseMgr> lease_mgr(new Memfile_LeaseMgr(pmap));
+
+    vector<Lease4Ptr> leases = createLeases4();
+    ASSERT_TRUE(lease_mgr->addLease(leases[1]));
+    ASSERT_TRUE(lease_mgr->addLease(leases[2]));
+    ASSERT_TRUE(lease_mgr->addLease(leases[3]));
+    leases[2]->valid_lft_ = 7200;
+    ASSERT_NO_THROW(lease_mgr->updateLease4(leases[2]));
+    ASSERT_TRUE(lease_mgr->deleteLease(leases[3]->addr_));
+
+    for (int compacted = 0; compacted < 2; ++compacted) {
+        lease_mgr.reset(new Memfile_LeaseMgr(pmap));
+        Lease4Ptr lease = lease_mgr->getLease4(leases[1]->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(leases[1], lease);
+        lease = lease_mgr->getLease4(leases[2]->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(leases[2], lease);
+        EXPECT_FALSE(lease_mgr->getLease4(leases[3]->addr_));
+
+        // Compact the journal, the records are moved to the snapshot.
+        ASSERT_NO_THROW(lease_mgr->compact());
+        EXPECT_FALSE(io_snapshot.readFile().empty());
+        EXPECT_EQ(8, io.readFile().size());
+    }
+}
+
+// Checks that the IPv6 leases written to the binary journal are loaded.
+TEST_F(MemfileLeaseMgrTest, binaryJournal6) {
+    const std::string name = getLeaseFilePath("leasefile6_1.journal");
+    LeaseFileIO io(name);
+    LeaseFileIO io_snapshot(name + ".snapshot");
+    LeaseMgr::ParameterMap pmap;
+    pmap["universe"] = "6";
+    pmap["name"] = name;
+    pmap["format"] = "binary";
+    pmap["fsync"] = "false";
+    boost::scoped_ptr<Memfile_LeaseMgr> lease_mgr(new Memfile_LeaseMgr(pmap));
+
+    vector<Lease6Ptr> leases = createLeases6();
+    ASSERT_TRUE(lease_mgr->addLease(leases[1]));
+    ASSERT_TRUE(lease_mgr->addLease(leases[2]));
+    ASSERT_TRUE(lease_mgr->deleteLease(leases[2]->addr_));
+    ASSERT_NO_THROW(lease_mgr->compact());
+    ASSERT_TRUE(lease_mgr->addLease(leases[3]));
+
+    lease_mgr.reset(new Memfile_LeaseMgr(pmap));
+    Lease6Ptr lease = lease_mgr->getLease6(leases[1]->type_,
+                                           leases[1]->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(leases[1], lease);
+    EXPECT_FALSE(lease_mgr->getLease6(leases[2]->type_, leases[2]->addr_));
+    lease = lease_mgr->getLease6(leases[3]->type_, leases[3]->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(leases[3], lease);
+
+    // A DHCPv4 server can't use the journal of a DHCPv6 server.
+    pmap["universe"] = "4";
+    EXPECT_THROW(lease_mgr.reset(new Memfile_LeaseMgr(pmap)),
+                 DbOperationError);
+}
+
+// Checks that a change is not applied in memory when its record can't be
+// written to the binary journal.
+TEST_F(MemfileLeaseMgrTest, binaryJournalWriteFailure) {
+    const std::string name = getLeaseFilePath("leasefile4_1.journal");
+    LeaseFileIO io(name);
+    LeaseFileIO io_snapshot(name + ".snapshot");
+    io.removeFile();
+    io_snapshot.removeFile();
+    LeaseMgr::ParameterMap pmap;
+    pmap["universe"] = "4";
+    pmap["name"] = name;
+    pmap["format"] = "binary";
+    pmap["fsync"] = "false";
+    pmap["compact-interval"] = "0";
+    boost::scoped_ptr<Memfile_LeaseMgr> lease_mgr(new Memfile_LeaseMgr(pmap));
+
+    vector<Lease4Ptr> leases = createLeases4();
+    ASSERT_TRUE(lease_mgr->addLease(leases[1]));
+    ASSERT_TRUE(lease_mgr->addLease(leases[2]));
+    Lease4Ptr updated(new Lease4(*leases[1]));
+    updated->valid_lft_ = 7200;
+
+    {
+        FileSizeLimit limit(io.readFile().size());
+        EXPECT_THROW(lease_mgr->addLease(leases[3]), DbOperationError);
+        EXPECT_THROW(lease_mgr->updateLease4(updated), DbOperationError);
+        EXPECT_THROW(lease_mgr->deleteLease(leases[2]->addr_),
+                     DbOperationError);
+    }
+
+    // The leases are as they were before the failed changes.
+    EXPECT_FALSE(lease_mgr->getLease4(leases[3]->addr_));
+    Lease4Ptr lease = lease_mgr->getLease4(leases[1]->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(leases[1], lease);
+    EXPECT_TRUE(lease_mgr->getLease4(leases[2]->addr_));
+
+    // The changes succeed once the journal can be written again.
+    EXPECT_TRUE(lease_mgr->addLease(leases[3]));
+    EXPECT_NO_THROW(lease_mgr->updateLease4(updated));
+    EXPECT_TRUE(lease_mgr->deleteLease(leases[2]->addr_));
+
+    lease_mgr.reset(new Memfile_LeaseMgr(pmap));
+    EXPECT_TRUE(lease_mgr->getLease4(leases[3]->addr_));
+    lease = lease_mgr->getLease4(leases[1]->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(updated, lease);
+    EXPECT_FALSE(lease_mgr->getLease4(leases[2]->addr_));
+}
+
 // The following tests are not applicable for memfile. When adding
 // new tests to the list here, make sure to provide brief explanation
 // why they are not applicable:
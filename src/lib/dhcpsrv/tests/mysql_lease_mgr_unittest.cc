@@ -24,10 +24,18 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace bundy;
 using namespace bundy::asiolink;
@@ -402,6 +410,22 @@ TEST_F(MySqlLeaseMgrTest, getLease4ClientIdSubnetId) {
     testGetLease4ClientIdSubnetId();
 }
 
+/// @brief Check GetLeases4 method - access by address range
+///
+/// Adds leases to the database and checks that the leases of a range of
+/// addresses can be retrieved.
+TEST_F(MySqlLeaseMgrTest, getLeases4Range) {
+    testGetLeases4Range();
+}
+
+/// @brief Check GetExpiredLeases4 method
+///
+/// Checks that the expired leases are returned in order of expiration
+/// time.
+TEST_F(MySqlLeaseMgrTest, getExpiredLeases4) {
+    testGetExpiredLeases4();
+}
+
 /// @brief Basic Lease4 Checks
 ///
 /// Checks that the addLease, getLease4(by address), getLease4(hwaddr,subnet_id),
@@ -453,6 +477,14 @@ TEST_F(MySqlLeaseMgrTest, getLeases6DuidIaid) {
     testGetLeases6DuidIaid();
 }
 
+/// @brief Check GetExpiredLeases6 method
+///
+/// Checks that the expired leases are returned in order of expiration
+/// time.
+TEST_F(MySqlLeaseMgrTest, getExpiredLeases6) {
+    testGetExpiredLeases6();
+}
+
 // Check that the system can cope with a DUID of allowed size.
 TEST_F(MySqlLeaseMgrTest, getLeases6DuidSize) {
     testGetLeases6DuidSize();
@@ -506,4 +538,557 @@ TEST_F(MySqlLeaseMgrTest, testRecreateLease6) {
     testRecreateLease6();
 }
 
+/// @brief Test fixture class for the write-behind mode
+///
+/// The lease manager queues the lease writes.  Reopening the database
+/// writes the queued leases.
+class MySqlWriteBehindTest : public MySqlLeaseMgrTest {
+public:
+    /// @brief Constructor
+    ///
+    /// Reopens the database in the write-behind mode.
+    MySqlWriteBehindTest() {
+        reopen(V4);
+    }
+
+    /// @brief Reopen the database in the write-behind mode
+    void reopen(Universe) {
+        LeaseMgrFactory::destroy();
+        LeaseMgrFactory::create(writeBehindConnectionString());
+        lmptr_ = &(LeaseMgrFactory::instance());
+    }
+
+    /// @brief Returns the connection string of the write-behind mode
+    ///
+    /// The batches are small so several statements are used.
+    static string writeBehindConnectionString() {
+        return (validConnectionString() +
+                " write-behind=true write-behind-batch=3");
+    }
+};
+
+/// @brief Check the parameters of the write-behind mode
+TEST(MySqlOpenTest, writeBehindParameters) {
+    destroySchema();
+    createSchema();
+
+    const string valid = validConnectionString();
+    EXPECT_THROW(LeaseMgrFactory::create(valid + " write-behind=yes"),
+                 BadValue);
+    EXPECT_THROW(LeaseMgrFactory::create(valid + " write-behind=true "
+                                         "write-behind-queue=0"),
+                 BadValue);
+    EXPECT_THROW(LeaseMgrFactory::create(valid + " write-behind=true "
+                                         "write-behind-batch=1001"),
+                 BadValue);
+    EXPECT_THROW(LeaseMgrFactory::create(valid + " write-behind=true "
+                                         "write-behind-delay=soon"),
+                 BadValue);
+    EXPECT_NO_THROW(LeaseMgrFactory::create(valid + " write-behind=true "
+                                            "write-behind-queue=100 "
+                                            "write-behind-batch=10 "
+                                            "write-behind-delay=0"));
+    LeaseMgrFactory::destroy();
+
+    destroySchema();
+}
+
+/// @brief Basic Lease4 checks in the write-behind mode
+TEST_F(MySqlWriteBehindTest, basicLease4) {
+    testBasicLease4();
+}
+
+/// @brief Lease4 update in the write-behind mode
+TEST_F(MySqlWriteBehindTest, updateLease4) {
+    testUpdateLease4();
+}
+
+/// @brief Lease4 queries merging the queued leases
+TEST_F(MySqlWriteBehindTest, getLease4HWAddr1) {
+    testGetLease4HWAddr1();
+}
+
+TEST_F(MySqlWriteBehindTest, getLease4HwaddrSubnetId) {
+    testGetLease4HWAddrSubnetId();
+}
+
+TEST_F(MySqlWriteBehindTest, getLease4ClientId) {
+    testGetLease4ClientId();
+}
+
+TEST_F(MySqlWriteBehindTest, getLease4ClientIdSubnetId) {
+    testGetLease4ClientIdSubnetId();
+}
+
+TEST_F(MySqlWriteBehindTest, getLeases4Range) {
+    testGetLeases4Range();
+}
+
+TEST_F(MySqlWriteBehindTest, getExpiredLeases4) {
+    testGetExpiredLeases4();
+}
+
+/// @brief Basic Lease6 checks in the write-behind mode
+TEST_F(MySqlWriteBehindTest, basicLease6) {
+    testBasicLease6();
+}
+
+/// @brief Lease6 update in the write-behind mode
+TEST_F(MySqlWriteBehindTest, updateLease6) {
+    testUpdateLease6();
+}
+
+/// @brief Lease6 queries merging the queued leases
+TEST_F(MySqlWriteBehindTest, getLeases6DuidIaid) {
+    testGetLeases6DuidIaid();
+}
+
+TEST_F(MySqlWriteBehindTest, getExpiredLeases6) {
+    testGetExpiredLeases6();
+}
+
+TEST_F(MySqlWriteBehindTest, getLease6DuidIaidSubnetId) {
+    testGetLease6DuidIaidSubnetId();
+}
+
+TEST_F(MySqlWriteBehindTest, lease6LeaseTypeCheck) {
+    testLease6LeaseTypeCheck();
+}
+
+/// @brief Check that the committed leases are in the database
+///
+/// The leases written by a lease manager in the write-behind mode are read
+/// by a lease manager without it after a commit, which waits for the queue
+/// to be written.
+TEST_F(MySqlWriteBehindTest, commit) {
+    // A lease manager reading the database directly.
+    LeaseMgr::ParameterMap parameters =
+        LeaseMgrFactory::parse(validConnectionString());
+    MySqlLeaseMgr direct(parameters);
+
+    // Add more leases than a batch, and than the statements of a batch
+    // size, with the last one deleted.
+    const IOAddress first("192.0.2.1");
+    Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    const size_t count = 10;
+    for (size_t i = 0; i < count; ++i) {
+        lease->addr_ = IOAddress(static_cast<uint32_t>(first) + i);
+        ASSERT_TRUE(lmptr_->addLease(lease));
+        EXPECT_FALSE(lmptr_->addLease(lease));
+    }
+    const IOAddress last(static_cast<uint32_t>(first) + count - 1);
+    EXPECT_TRUE(lmptr_->deleteLease(last));
+    EXPECT_FALSE(lmptr_->deleteLease(last));
+
+    // The leases are visible through the queue.
+    Lease4Collection leases = lmptr_->getLeases4(first, last);
+    EXPECT_EQ(count - 1, leases.size());
+
+    lmptr_->commit();
+    leases = direct.getLeases4(first, last);
+    ASSERT_EQ(count - 1, leases.size());
+    for (size_t i = 0; i < leases.size(); ++i) {
+        EXPECT_EQ(IOAddress(static_cast<uint32_t>(first) + i),
+                  leases[i]->addr_);
+    }
+
+    // Update and delete some of them.
+    lease->addr_ = first;
+    lease->valid_lft_ = 1234;
+    lmptr_->updateLease4(lease);
+    EXPECT_TRUE(lmptr_->deleteLease(IOAddress("192.0.2.2")));
+    EXPECT_THROW(lmptr_->updateLease4(initializeLease4(straddress4_[2])),
+                 NoSuchLease);
+    lmptr_->commit();
+
+    Lease4Ptr updated = direct.getLease4(first);
+    ASSERT_TRUE(updated);
+    EXPECT_EQ(1234U, updated->valid_lft_);
+    EXPECT_FALSE(direct.getLease4(IOAddress("192.0.2.2")));
+
+    // IPv6 leases are written too.
+    vector<Lease6Ptr> leases6 = createLeases6();
+    EXPECT_TRUE(lmptr_->addLease(leases6[1]));
+    EXPECT_TRUE(lmptr_->addLease(leases6[2]));
+    EXPECT_TRUE(lmptr_->deleteLease(ioaddress6_[2]));
+    lmptr_->commit();
+    Lease6Ptr lease6 = direct.getLease6(leasetype6_[1], ioaddress6_[1]);
+    ASSERT_TRUE(lease6);
+    detailCompareLease(leases6[1], lease6);
+    EXPECT_FALSE(direct.getLease6(leasetype6_[2], ioaddress6_[2]));
+}
+
+/// @brief Check that the sessions share the queue
+///
+/// A lease queued by a lease manager is visible to the other lease managers
+/// with the same parameters before it is written.
+TEST_F(MySqlWriteBehindTest, sharedQueue) {
+    LeaseMgr::ParameterMap parameters =
+        LeaseMgrFactory::parse(writeBehindConnectionString());
+    MySqlLeaseMgr session(parameters);
+
+    Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    Lease4Ptr queued = session.getLease4(ioaddress4_[1]);
+    ASSERT_TRUE(queued);
+    detailCompareLease(lease, queued);
+    EXPECT_FALSE(session.addLease(lease));
+
+    // The leases returned are copies.
+    queued->valid_lft_ = lease->valid_lft_ + 1;
+    EXPECT_EQ(lease->valid_lft_,
+              lmptr_->getLease4(ioaddress4_[1])->valid_lft_);
+}
+
+/// @brief A MySQL server run by the tests
+///
+/// Runs a mysqld of its own, with the data in a temporary directory and
+/// accepting connections on a socket in it only, and creates the keatest
+/// database and user in it.  While it exists, MYSQL_UNIX_PORT is set to
+/// the socket, so the lease managers (and the schema functions above)
+/// connect to it.
+///
+/// The server program is taken from the BUNDY_TEST_MYSQLD environment
+/// variable, or looked for at the usual places.  If there is none, or it
+/// can't be started, isRunning() returns false.
+class LocalMySqlServer : public boost::noncopyable {
+public:
+    /// @brief Constructor
+    ///
+    /// Initializes the data directory and starts the server.
+    LocalMySqlServer() : pid_(0), saved_port_(NULL) {
+        const char* mysqld = getenv("BUNDY_TEST_MYSQLD");
+        const char* candidates[] = {
+            "/usr/sbin/mysqld", "/usr/libexec/mysqld", "/usr/sbin/mariadbd",
+            "/usr/local/mysql/bin/mysqld", NULL
+        };
+        for (int i = 0; (mysqld == NULL) && (candidates[i] != NULL); ++i) {
+            if (access(candidates[i], X_OK) == 0) {
+                mysqld = candidates[i];
+            }
+        }
+        if (mysqld == NULL) {
+            return;
+        }
+        mysqld_ = mysqld;
+
+        char dir[] = "/tmp/bundy-mysqld-XXXXXX";
+        if (mkdtemp(dir) == NULL) {
+            return;
+        }
+        dir_ = dir;
+        socket_ = dir_ + "/mysql.sock";
+
+        const char* port = getenv("MYSQL_UNIX_PORT");
+        if (port != NULL) {
+            saved_port_ = strdup(port);
+        }
+        setenv("MYSQL_UNIX_PORT", socket_.c_str(), 1);
+
+        if (!initialize() || !start() || !createDatabase()) {
+            std::cerr << "*** unable to run " << mysqld_ << ", see "
+                      << dir_ << "/error.log\n";
+            stop(SIGKILL);
+        }
+    }
+
+    /// @brief Destructor
+    ///
+    /// Stops the server and removes its data.
+    ~LocalMySqlServer() {
+        stop(SIGTERM);
+        if (!dir_.empty()) {
+            std::vector<std::string> args;
+            args.push_back("rm");
+            args.push_back("-rf");
+            args.push_back(dir_);
+            run(args);
+        }
+        if (saved_port_ != NULL) {
+            setenv("MYSQL_UNIX_PORT", saved_port_, 1);
+            free(saved_port_);
+        } else {
+            unsetenv("MYSQL_UNIX_PORT");
+        }
+    }
+
+    /// @brief Is the server running?
+    bool isRunning() const {
+        return (pid_ > 0);
+    }
+
+    /// @brief Starts the server on the existing data
+    ///
+    /// @return true if the server accepts connections.
+    bool start() {
+        std::vector<std::string> args = commonArgs();
+        args.push_back("--socket=" + socket_);
+        args.push_back("--skip-networking");
+        args.push_back("--pid-file=" + dir_ + "/mysqld.pid");
+        args.push_back("--log-error=" + dir_ + "/error.log");
+        pid_ = spawn(args);
+        if (pid_ <= 0) {
+            pid_ = 0;
+            return (false);
+        }
+
+        // Wait (up to a minute) for the server to accept connections.
+        for (int i = 0; i < 600; ++i) {
+            MySqlHolder mysql;
+            if (mysql_real_connect(mysql, "localhost", "root", "", NULL, 0,
+                                   socket_.c_str(), 0) != NULL) {
+                return (true);
+            }
+            if (waitpid(pid_, NULL, WNOHANG) == pid_) {
+                pid_ = 0;
+                return (false);
+            }
+            usleep(100000);
+        }
+        return (false);
+    }
+
+    /// @brief Stops the server
+    ///
+    /// @param signo The signal sent to the server: SIGKILL simulates a
+    ///        crash.
+    void stop(int signo) {
+        if (pid_ > 0) {
+            ::kill(pid_, signo);
+            waitpid(pid_, NULL, 0);
+            pid_ = 0;
+        }
+    }
+
+private:
+    /// @brief Returns the arguments used to run the server
+    std::vector<std::string> commonArgs() const {
+        std::vector<std::string> args;
+        args.push_back(mysqld_);
+        args.push_back("--no-defaults");
+        args.push_back("--datadir=" + dir_ + "/data");
+        if (geteuid() == 0) {
+            args.push_back("--user=root");
+        }
+        return (args);
+    }
+
+    /// @brief Creates the system tables
+    ///
+    /// Uses the --initialize-insecure option of MySQL, or mysql_install_db
+    /// (installed next to the server or in the path) for MariaDB.
+    bool initialize() {
+        std::vector<std::string> args = commonArgs();
+        args.push_back("--initialize-insecure");
+        args.push_back("--log-error=" + dir_ + "/error.log");
+        if (run(args)) {
+            return (true);
+        }
+
+        const std::string bin = mysqld_.substr(0, mysqld_.rfind('/'));
+        const std::string install_db = bin + "/../bin/mysql_install_db";
+        args.clear();
+        args.push_back(access(install_db.c_str(), X_OK) == 0 ?
+                       install_db : std::string("mysql_install_db"));
+        args.push_back("--no-defaults");
+        args.push_back("--datadir=" + dir_ + "/data");
+        args.push_back("--auth-root-authentication-method=normal");
+        if (geteuid() == 0) {
+            args.push_back("--user=root");
+        }
+        return (run(args));
+    }
+
+    /// @brief Creates the keatest database and user
+    bool createDatabase() {
+        MySqlHolder mysql;
+        if (mysql_real_connect(mysql, "localhost", "root", "", NULL, 0,
+                               socket_.c_str(), 0) == NULL) {
+            return (false);
+        }
+        const char* statements[] = {
+            "CREATE DATABASE keatest",
+            "CREATE USER 'keatest'@'localhost' IDENTIFIED BY 'keatest'",
+            "GRANT ALL ON keatest.* TO 'keatest'@'localhost'",
+            NULL
+        };
+        for (int i = 0; statements[i] != NULL; ++i) {
+            if (mysql_query(mysql, statements[i]) != 0) {
+                std::cerr << "*** " << statements[i] << ": "
+                          << mysql_error(mysql) << "\n";
+                return (false);
+            }
+        }
+        return (true);
+    }
+
+    /// @brief Runs a program in the background
+    ///
+    /// @return The process ID, or -1 on error.
+    static pid_t spawn(const std::vector<std::string>& args) {
+        std::vector<char*> argv;
+        for (size_t i = 0; i < args.size(); ++i) {
+            argv.push_back(const_cast<char*>(args[i].c_str()));
+        }
+        argv.push_back(NULL);
+
+        const pid_t pid = fork();
+        if (pid == 0) {
+            // Keep the output of the tests readable.
+            if (freopen("/dev/null", "w", stdout) == NULL ||
+                freopen("/dev/null", "w", stderr) == NULL) {
+                _exit(127);
+            }
+            execvp(argv[0], &argv[0]);
+            _exit(127);
+        }
+        return (pid);
+    }
+
+    /// @brief Runs a program and waits for it
+    ///
+    /// @return true if the program succeeded.
+    static bool run(const std::vector<std::string>& args) {
+        const pid_t pid = spawn(args);
+        int status;
+        return ((pid > 0) && (waitpid(pid, &status, 0) == pid) &&
+                WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    }
+
+    std::string mysqld_;        ///< The server program
+    std::string dir_;           ///< Temporary directory
+    std::string socket_;        ///< Socket of the server
+    pid_t pid_;                 ///< Process of the server, 0 if not running
+    char* saved_port_;          ///< Previous value of MYSQL_UNIX_PORT
+};
+
+/// @brief Test fixture class for the tests running their own MySQL server
+///
+/// The server is started once for all the tests.  The tests return at
+/// once if it isn't running (e.g. if no MySQL server is installed).
+class LocalMySqlTest : public ::testing::Test {
+public:
+    /// @brief Starts the server
+    static void SetUpTestCase() {
+        server_ = new LocalMySqlServer();
+    }
+
+    /// @brief Stops the server
+    static void TearDownTestCase() {
+        delete server_;
+        server_ = NULL;
+    }
+
+    /// @brief Constructor
+    ///
+    /// Creates the schema if the server is running.
+    LocalMySqlTest() {
+        if (server_->isRunning()) {
+            destroySchema();
+            createSchema();
+        } else {
+            std::cout << "Skipped: no MySQL server could be started\n";
+        }
+    }
+
+    /// @brief Destructor
+    ///
+    /// Destroys the lease manager, and restarts the server if a test
+    /// stopped it.
+    virtual ~LocalMySqlTest() {
+        LeaseMgrFactory::destroy();
+        if (!server_->isRunning()) {
+            server_->start();
+        }
+    }
+
+    /// @brief Returns the connection string of the write-behind mode
+    ///
+    /// @param delay Time in milliseconds the leases are kept in the queue.
+    static string writeBehindConnectionString(int delay) {
+        ostringstream s;
+        s << validConnectionString() << " write-behind=true "
+          << "write-behind-delay=" << delay;
+        return (s.str());
+    }
+
+    /// @brief Returns a lease for an address
+    static Lease4Ptr createLease(const IOAddress& addr) {
+        const uint8_t hwaddr[] = { 0x08, 0x00, 0x2b, 0x02, 0x3f, 0x4e };
+        return (Lease4Ptr(new Lease4(addr, hwaddr, sizeof(hwaddr), NULL, 0,
+                                     3600, 900, 1800, time(NULL), 1)));
+    }
+
+    static LocalMySqlServer* server_;
+};
+
+LocalMySqlServer* LocalMySqlTest::server_ = NULL;
+
+/// @brief Check that the acknowledged leases survive a crash
+///
+/// Once waitForWrites() has returned, the leases are in the database, even
+/// if the server crashes right after.
+TEST_F(LocalMySqlTest, writeBehindDurable) {
+    if (!server_->isRunning()) {
+        return;
+    }
+    // The delay is long, so the leases are only written because of the
+    // wait.
+    LeaseMgrFactory::create(writeBehindConnectionString(60000));
+    const IOAddress first("192.0.2.1");
+    const size_t count = 10;
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_TRUE(LeaseMgrFactory::instance().addLease(
+                        createLease(IOAddress(static_cast<uint32_t>(first) +
+                                              i))));
+    }
+    ASSERT_NO_THROW(LeaseMgrFactory::instance().waitForWrites());
+
+    server_->stop(SIGKILL);
+    LeaseMgrFactory::destroy();
+    ASSERT_TRUE(server_->start());
+
+    LeaseMgr::ParameterMap parameters =
+        LeaseMgrFactory::parse(validConnectionString());
+    MySqlLeaseMgr direct(parameters);
+    const IOAddress last(static_cast<uint32_t>(first) + count - 1);
+    EXPECT_EQ(count, direct.getLeases4(first, last).size());
+}
+
+/// @brief Check that the leases which can't be written aren't acknowledged
+///
+/// If the database is gone before the queued leases are written,
+/// waitForWrites() (and commit()) throw, so the servers don't respond.
+TEST_F(LocalMySqlTest, writeBehindFailure) {
+    if (!server_->isRunning()) {
+        return;
+    }
+    LeaseMgrFactory::create(writeBehindConnectionString(60000));
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    ASSERT_TRUE(lease_mgr.addLease(createLease(IOAddress("192.0.2.1"))));
+
+    server_->stop(SIGKILL);
+    EXPECT_THROW(lease_mgr.waitForWrites(), DbOperationError);
+    EXPECT_THROW(lease_mgr.commit(), DbOperationError);
+
+    // The lease is still queued, so it is still in use.
+    EXPECT_TRUE(lease_mgr.getLease4(IOAddress("192.0.2.1")));
+}
+
+/// @brief Check that nothing waits without the write-behind mode
+TEST_F(LocalMySqlTest, waitForWritesDirect) {
+    if (!server_->isRunning()) {
+        return;
+    }
+    LeaseMgrFactory::create(validConnectionString());
+    LeaseMgr& lease_mgr = LeaseMgrFactory::instance();
+    ASSERT_TRUE(lease_mgr.addLease(createLease(IOAddress("192.0.2.1"))));
+    EXPECT_NO_THROW(lease_mgr.waitForWrites());
+
+    // The lease is written already, so the wait doesn't fail even if the
+    // database is gone.
+    server_->stop(SIGKILL);
+    EXPECT_NO_THROW(lease_mgr.waitForWrites());
+}
+
 }; // Of anonymous namespace
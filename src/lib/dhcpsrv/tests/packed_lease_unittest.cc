@@ -0,0 +1,143 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/packed_lease.h>
+#include <dhcpsrv/tests/test_utils.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+using namespace bundy::dhcp::test;
+using namespace bundy::asiolink;
+
+namespace {
+
+const uint8_t HWADDR[] = { 0, 1, 2, 3, 4, 5 };
+const uint8_t CLIENTID[] = { 1, 0, 1, 2, 3, 4, 5 };
+
+// Returns a DHCPv4 lease with all the fields the memfile backend stores.
+Lease4Ptr
+createLease4() {
+    return (Lease4Ptr(new Lease4(IOAddress("192.0.2.1"), HWADDR,
+                                 sizeof(HWADDR), CLIENTID, sizeof(CLIENTID),
+                                 3600, 1800, 2700, 1400000000, 7, true,
+                                 false, "host.example.org.")));
+}
+
+// Returns a DHCPv6 lease with all the fields the memfile backend stores.
+Lease6Ptr
+createLease6() {
+    DuidPtr duid(new DUID(CLIENTID, sizeof(CLIENTID)));
+    Lease6Ptr lease(new Lease6(Lease::TYPE_PD, IOAddress("2001:db8:1::"),
+                               duid, 1234, 3000, 4000, 1000, 2000, 7, false,
+                               true, "host.example.org.", 48));
+    lease->cltt_ = 1400000000;
+    return (lease);
+}
+
+// Checks that a DHCPv4 lease is the same once packed and unpacked.
+TEST(PackedLeaseTest, lease4) {
+    const Lease4Ptr lease = createLease4();
+    const PackedLease4 packed(*lease);
+    const Lease4Ptr unpacked = packed.toLease();
+    detailCompareLease(lease, unpacked);
+    EXPECT_EQ(lease->t1_, unpacked->t1_);
+    EXPECT_EQ(lease->t2_, unpacked->t2_);
+
+    EXPECT_EQ(static_cast<uint32_t>(lease->addr_), packed.getAddress());
+    EXPECT_EQ(7, packed.getSubnetId());
+    EXPECT_EQ(1400003600, packed.getExpirationTime());
+    EXPECT_TRUE(packed.getHWAddrKey() ==
+                IdentifierKey(HWADDR, sizeof(HWADDR)));
+    EXPECT_TRUE(packed.getClientIdKey() ==
+                IdentifierKey(CLIENTID, sizeof(CLIENTID)));
+
+    // The copies hold their own identifiers.
+    PackedLease4 copy(packed);
+    detailCompareLease(lease, copy.toLease());
+    PackedLease4 assigned(*createLease4());
+    assigned = copy;
+    detailCompareLease(lease, assigned.toLease());
+}
+
+// Checks the DHCPv4 leases without variable-length fields.
+TEST(PackedLeaseTest, lease4Empty) {
+    const Lease4Ptr lease(new Lease4(IOAddress("192.0.2.1"), NULL, 0, NULL,
+                                     0, 3600, 1800, 2700, 1400000000, 7));
+    const PackedLease4 packed(*lease);
+    const Lease4Ptr unpacked = packed.toLease();
+    detailCompareLease(lease, unpacked);
+    EXPECT_FALSE(unpacked->client_id_);
+    EXPECT_TRUE(packed.getClientIdKey() == IdentifierKey(NULL, 0));
+
+    PackedLease4 copy(packed);
+    detailCompareLease(lease, copy.toLease());
+}
+
+// Checks that invalid DHCPv4 leases are rejected.
+TEST(PackedLeaseTest, lease4Invalid) {
+    Lease4Ptr lease = createLease4();
+    lease->addr_ = IOAddress("2001:db8::1");
+    EXPECT_THROW(PackedLease4 packed(*lease), BadValue);
+
+    lease = createLease4();
+    lease->hostname_ = std::string(70000, 'a');
+    EXPECT_THROW(PackedLease4 packed(*lease), BadValue);
+}
+
+// Checks that a DHCPv6 lease is the same once packed and unpacked.
+TEST(PackedLeaseTest, lease6) {
+    const Lease6Ptr lease = createLease6();
+    const PackedLease6 packed(*lease);
+    const Lease6Ptr unpacked = packed.toLease();
+    detailCompareLease(lease, unpacked);
+    EXPECT_EQ(lease->t1_, unpacked->t1_);
+    EXPECT_EQ(lease->t2_, unpacked->t2_);
+
+    EXPECT_EQ(1234, packed.getIaid());
+    EXPECT_EQ(7, packed.getSubnetId());
+    EXPECT_EQ(1400004000, packed.getExpirationTime());
+    EXPECT_TRUE(packed.getDuidKey() ==
+                IdentifierKey(CLIENTID, sizeof(CLIENTID)));
+
+    PackedLease6 copy(packed);
+    detailCompareLease(lease, copy.toLease());
+    PackedLease6 assigned(*createLease6());
+    assigned = copy;
+    detailCompareLease(lease, assigned.toLease());
+
+    // An IPv4 address is rejected.
+    lease->addr_ = IOAddress("192.0.2.1");
+    EXPECT_THROW(PackedLease6 packed(*lease), BadValue);
+}
+
+// Checks that the address keys are ordered as the addresses.
+TEST(PackedLeaseTest, address6Key) {
+    EXPECT_TRUE(Address6Key(IOAddress("2001:db8::1")) <
+                Address6Key(IOAddress("2001:db8::2")));
+    EXPECT_TRUE(Address6Key(IOAddress("2001:db8::ffff")) <
+                Address6Key(IOAddress("2001:db8:1::")));
+    EXPECT_FALSE(Address6Key(IOAddress("2001:db8::1")) <
+                 Address6Key(IOAddress("2001:db8::1")));
+    EXPECT_THROW(Address6Key(IOAddress("192.0.2.1")), BadValue);
+}
+
+}; // end of anonymous namespace
@@ -0,0 +1,353 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcpsrv/pending_leases.h>
+#include <dhcpsrv/tests/test_utils.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+using namespace bundy::dhcp::test;
+using namespace bundy::asiolink;
+
+namespace {
+
+const uint8_t HWADDR1[] = { 0, 1, 2, 3, 4, 5 };
+const uint8_t HWADDR2[] = { 0, 1, 2, 3, 4, 6 };
+const uint8_t CLIENTID1[] = { 1, 0, 1, 2, 3, 4, 5 };
+const uint8_t CLIENTID2[] = { 1, 0, 1, 2, 3, 4, 6 };
+
+const std::vector<uint8_t> HWADDR1_VECTOR(HWADDR1,
+                                          HWADDR1 + sizeof(HWADDR1));
+const std::vector<uint8_t> HWADDR2_VECTOR(HWADDR2,
+                                          HWADDR2 + sizeof(HWADDR2));
+
+// Returns a DHCPv4 lease, which expires at 1400000000 + valid.
+Lease4Ptr
+createLease4(const std::string& addr, const uint8_t* hwaddr,
+             const uint8_t* clientid, SubnetID subnet_id,
+             uint32_t valid = 3600) {
+    return (Lease4Ptr(new Lease4(IOAddress(addr), hwaddr, sizeof(HWADDR1),
+                                 clientid, clientid ? sizeof(CLIENTID1) : 0,
+                                 valid, 1800, 2700, 1400000000, subnet_id)));
+}
+
+// Returns a DHCPv6 lease, which expires at 1400000000 + valid.
+Lease6Ptr
+createLease6(const std::string& addr, Lease::Type type,
+             const uint8_t* duid, uint32_t iaid, SubnetID subnet_id,
+             uint32_t valid = 4000) {
+    Lease6Ptr lease(new Lease6(type, IOAddress(addr),
+                               DuidPtr(new DUID(duid, sizeof(CLIENTID1))),
+                               iaid, 3000, valid, 1000, 2000, subnet_id));
+    lease->cltt_ = 1400000000;
+    return (lease);
+}
+
+// Returns the addresses of leases, sorted.
+template <typename LeasePtr>
+std::vector<std::string>
+getAddresses(const std::vector<LeasePtr>& leases) {
+    std::vector<std::string> addresses;
+    for (size_t i = 0; i < leases.size(); ++i) {
+        addresses.push_back(leases[i]->addr_.toText());
+    }
+    std::sort(addresses.begin(), addresses.end());
+    return (addresses);
+}
+
+// Returns a vector of strings.
+std::vector<std::string>
+strings(const char* first = NULL, const char* second = NULL,
+        const char* third = NULL) {
+    std::vector<std::string> result;
+    if (first) {
+        result.push_back(first);
+    }
+    if (second) {
+        result.push_back(second);
+    }
+    if (third) {
+        result.push_back(third);
+    }
+    return (result);
+}
+
+// Checks that the last state of an address is stored, and that the leases
+// are copied.
+TEST(PendingLeasesTest, setFindRemove) {
+    PendingLeases pending;
+    EXPECT_TRUE(pending.empty());
+
+    const Lease4Ptr lease = createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1);
+    pending.set(lease, 1);
+    EXPECT_EQ(1, pending.size());
+    EXPECT_TRUE(pending.contains(IOAddress("192.0.2.1")));
+    EXPECT_FALSE(pending.contains(IOAddress("192.0.2.2")));
+
+    // The stored lease is a copy.
+    lease->hostname_ = "changed.example.org.";
+    Lease4Ptr found;
+    ASSERT_TRUE(pending.find(IOAddress("192.0.2.1"), found));
+    ASSERT_TRUE(found);
+    EXPECT_EQ("", found->hostname_);
+
+    // So is the lease returned.
+    found->hostname_ = "changed.example.org.";
+    ASSERT_TRUE(pending.find(IOAddress("192.0.2.1"), found));
+    EXPECT_EQ("", found->hostname_);
+
+    // An address not pending is not found.
+    EXPECT_FALSE(pending.find(IOAddress("192.0.2.2"), found));
+
+    // A deleted lease is pending, without a lease.
+    pending.remove(IOAddress("192.0.2.1"), 2);
+    EXPECT_EQ(1, pending.size());
+    ASSERT_TRUE(pending.find(IOAddress("192.0.2.1"), found));
+    EXPECT_FALSE(found);
+
+    const Lease6Ptr lease6 = createLease6("2001:db8::1", Lease::TYPE_NA,
+                                          CLIENTID1, 1, 1);
+    pending.set(lease6, 3);
+    EXPECT_EQ(2, pending.size());
+    Lease6Ptr found6;
+    ASSERT_TRUE(pending.find(IOAddress("2001:db8::1"), found6));
+    ASSERT_TRUE(found6);
+    detailCompareLease(lease6, found6);
+}
+
+// Checks that the writes written are removed, but not the addresses written
+// again since.
+TEST(PendingLeasesTest, erase) {
+    PendingLeases pending;
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1), 1);
+    pending.set(createLease4("192.0.2.2", HWADDR2, CLIENTID2, 1), 2);
+    pending.set(createLease6("2001:db8::1", Lease::TYPE_NA, CLIENTID1, 1, 1),
+                3);
+    pending.remove(IOAddress("192.0.2.3"), 4);
+
+    Lease4Collection leases4;
+    Lease6Collection leases6;
+    std::vector<IOAddress> deleted;
+    pending.getAll(leases4, leases6, deleted);
+    EXPECT_EQ(strings("192.0.2.1", "192.0.2.2"), getAddresses(leases4));
+    EXPECT_EQ(strings("2001:db8::1"), getAddresses(leases6));
+    ASSERT_EQ(1, deleted.size());
+    EXPECT_EQ("192.0.2.3", deleted[0].toText());
+
+    // 192.0.2.1 is written again after the first 4 writes are taken.
+    pending.remove(IOAddress("192.0.2.1"), 5);
+    pending.erase(4);
+    EXPECT_EQ(1, pending.size());
+    Lease4Ptr found;
+    ASSERT_TRUE(pending.find(IOAddress("192.0.2.1"), found));
+    EXPECT_FALSE(found);
+
+    pending.erase(5);
+    EXPECT_TRUE(pending.empty());
+}
+
+// Checks the merge of the leases of a hardware address.
+TEST(PendingLeasesTest, mergeHWAddr) {
+    PendingLeases pending;
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1), 1);
+    pending.set(createLease4("192.0.2.2", HWADDR1, CLIENTID1, 2), 2);
+    pending.set(createLease4("192.0.2.3", HWADDR2, CLIENTID2, 1), 3);
+    // The lease of 192.0.2.4 is deleted, the one of 192.0.2.5 changed to
+    // another hardware address.
+    pending.remove(IOAddress("192.0.2.4"), 4);
+    pending.set(createLease4("192.0.2.5", HWADDR2, CLIENTID2, 1), 5);
+    pending.set(createLease6("2001:db8::1", Lease::TYPE_NA, HWADDR1, 1, 1),
+                6);
+
+    // The leases of the database.
+    Lease4Collection leases;
+    leases.push_back(createLease4("192.0.2.4", HWADDR1, CLIENTID1, 1));
+    leases.push_back(createLease4("192.0.2.5", HWADDR1, CLIENTID1, 1));
+    leases.push_back(createLease4("192.0.2.6", HWADDR1, CLIENTID1, 1));
+    Lease4Collection merged(leases);
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR1_VECTOR));
+    EXPECT_EQ(strings("192.0.2.1", "192.0.2.2", "192.0.2.6"),
+              getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR1_VECTOR, 2));
+    EXPECT_EQ(strings("192.0.2.2"), getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR2_VECTOR));
+    EXPECT_EQ(strings("192.0.2.3", "192.0.2.5"), getAddresses(merged));
+
+    // The lease of the database is replaced by the pending one.
+    Lease4Ptr lease = leases[1];
+    pending.mergeSingle(lease, PendingLeases::HWAddrMatch(HWADDR1_VECTOR,
+                                                          1));
+    ASSERT_TRUE(lease);
+    EXPECT_EQ("192.0.2.1", lease->addr_.toText());
+
+    // The pending leases are copies.
+    merged.clear();
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR1_VECTOR, 2));
+    ASSERT_EQ(1, merged.size());
+    merged[0]->hostname_ = "changed.example.org.";
+    Lease4Ptr found;
+    ASSERT_TRUE(pending.find(IOAddress("192.0.2.2"), found));
+    EXPECT_EQ("", found->hostname_);
+}
+
+// Checks that the indexes follow the changes of the leases of an address.
+TEST(PendingLeasesTest, mergeUpdated) {
+    PendingLeases pending;
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1), 1);
+    pending.set(createLease4("192.0.2.1", HWADDR2, CLIENTID2, 2), 2);
+
+    Lease4Collection merged;
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR1_VECTOR));
+    EXPECT_TRUE(merged.empty());
+    pending.merge(merged, PendingLeases::ClientIdMatch(
+                      ClientId(CLIENTID1, sizeof(CLIENTID1))));
+    EXPECT_TRUE(merged.empty());
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR2_VECTOR, 2));
+    EXPECT_EQ(strings("192.0.2.1"), getAddresses(merged));
+
+    pending.remove(IOAddress("192.0.2.1"), 3);
+    merged.clear();
+    pending.merge(merged, PendingLeases::HWAddrMatch(HWADDR2_VECTOR));
+    EXPECT_TRUE(merged.empty());
+}
+
+// Checks the merge of the leases of a client identifier.
+TEST(PendingLeasesTest, mergeClientId) {
+    PendingLeases pending;
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1), 1);
+    pending.set(createLease4("192.0.2.2", HWADDR1, CLIENTID1, 2), 2);
+    pending.set(createLease4("192.0.2.3", HWADDR2, CLIENTID2, 1), 3);
+    pending.set(createLease4("192.0.2.4", HWADDR1, NULL, 1), 4);
+
+    const ClientId client_id(CLIENTID1, sizeof(CLIENTID1));
+    Lease4Collection merged;
+    merged.push_back(createLease4("192.0.2.10", HWADDR1, CLIENTID1, 3));
+    pending.merge(merged, PendingLeases::ClientIdMatch(client_id));
+    EXPECT_EQ(strings("192.0.2.1", "192.0.2.10", "192.0.2.2"),
+              getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::ClientIdMatch(client_id, 2));
+    EXPECT_EQ(strings("192.0.2.2"), getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::ClientIdMatch(client_id, 3));
+    EXPECT_TRUE(merged.empty());
+}
+
+// Checks the merge of the leases of a DUID and IAID.
+TEST(PendingLeasesTest, mergeDuidIaid) {
+    PendingLeases pending;
+    pending.set(createLease6("2001:db8::1", Lease::TYPE_NA, CLIENTID1, 1, 1),
+                1);
+    pending.set(createLease6("2001:db8::2", Lease::TYPE_NA, CLIENTID1, 1, 2),
+                2);
+    pending.set(createLease6("2001:db8::3", Lease::TYPE_NA, CLIENTID1, 2, 1),
+                3);
+    pending.set(createLease6("2001:db8::4", Lease::TYPE_TA, CLIENTID1, 1, 1),
+                4);
+    pending.set(createLease6("2001:db8::5", Lease::TYPE_NA, CLIENTID2, 1, 1),
+                5);
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1), 6);
+
+    const DUID duid(CLIENTID1, sizeof(CLIENTID1));
+    Lease6Collection merged;
+    pending.merge(merged, PendingLeases::DuidIaidMatch(Lease::TYPE_NA, duid,
+                                                       1));
+    EXPECT_EQ(strings("2001:db8::1", "2001:db8::2"), getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::DuidIaidMatch(Lease::TYPE_NA, duid,
+                                                       1, 2));
+    EXPECT_EQ(strings("2001:db8::2"), getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::DuidIaidMatch(Lease::TYPE_TA, duid,
+                                                       1, 1));
+    EXPECT_EQ(strings("2001:db8::4"), getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::DuidIaidMatch(Lease::TYPE_NA, duid,
+                                                       3));
+    EXPECT_TRUE(merged.empty());
+}
+
+// Checks the merge of the leases of a range of addresses.
+TEST(PendingLeasesTest, mergeRange) {
+    PendingLeases pending;
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1), 1);
+    pending.set(createLease4("192.0.2.5", HWADDR1, CLIENTID1, 1), 2);
+    pending.set(createLease4("192.0.2.10", HWADDR1, CLIENTID1, 1), 3);
+    pending.remove(IOAddress("192.0.2.6"), 4);
+    pending.set(createLease6("2001:db8::1", Lease::TYPE_NA, CLIENTID1, 1, 1),
+                5);
+
+    Lease4Collection merged;
+    merged.push_back(createLease4("192.0.2.6", HWADDR1, CLIENTID1, 1));
+    merged.push_back(createLease4("192.0.2.7", HWADDR1, CLIENTID1, 1));
+    pending.merge(merged, PendingLeases::RangeMatch(IOAddress("192.0.2.5"),
+                                                    IOAddress("192.0.2.10")));
+    EXPECT_EQ(strings("192.0.2.10", "192.0.2.5", "192.0.2.7"),
+              getAddresses(merged));
+
+    merged.clear();
+    pending.merge(merged, PendingLeases::RangeMatch(IOAddress("192.0.2.2"),
+                                                    IOAddress("192.0.2.4")));
+    EXPECT_TRUE(merged.empty());
+
+    // An empty range.
+    pending.merge(merged, PendingLeases::RangeMatch(IOAddress("192.0.2.10"),
+                                                    IOAddress("192.0.2.1")));
+    EXPECT_TRUE(merged.empty());
+}
+
+// Checks the merge of the expired leases.
+TEST(PendingLeasesTest, mergeExpired) {
+    PendingLeases pending;
+    pending.set(createLease4("192.0.2.1", HWADDR1, CLIENTID1, 1, 100), 1);
+    pending.set(createLease4("192.0.2.2", HWADDR1, CLIENTID1, 1, 200), 2);
+    pending.set(createLease4("192.0.2.3", HWADDR1, CLIENTID1, 1, 300), 3);
+    pending.remove(IOAddress("192.0.2.4"), 4);
+    pending.set(createLease6("2001:db8::1", Lease::TYPE_NA, CLIENTID1, 1, 1,
+                             100), 5);
+    pending.set(createLease6("2001:db8::2", Lease::TYPE_NA, CLIENTID1, 1, 1,
+                             300), 6);
+
+    Lease4Collection merged4;
+    pending.merge(merged4, PendingLeases::ExpiredMatch(1400000201));
+    EXPECT_EQ(strings("192.0.2.1", "192.0.2.2"), getAddresses(merged4));
+
+    merged4.clear();
+    pending.merge(merged4, PendingLeases::ExpiredMatch(1400000100));
+    EXPECT_TRUE(merged4.empty());
+
+    Lease6Collection merged6;
+    pending.merge(merged6, PendingLeases::ExpiredMatch(1400000201));
+    EXPECT_EQ(strings("2001:db8::1"), getAddresses(merged6));
+}
+
+}; // end of anonymous namespace
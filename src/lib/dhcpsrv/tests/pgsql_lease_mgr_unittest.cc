@@ -20,8 +20,9 @@
 #include <dhcpsrv/tests/test_utils.h>
 #include <dhcpsrv/tests/generic_lease_mgr_unittest.h>
 #include <exceptions/exceptions.h>
+#include <util/threads/thread.h>
 
-
+#include <boost/bind.hpp>
 #include <gtest/gtest.h>
 
 #include <algorithm>
@@ -289,6 +290,35 @@ TEST_F(PgSqlLeaseMgrTest, checkVersion) {
     EXPECT_EQ(PG_CURRENT_MINOR, version.second);
 }
 
+// Creates a session and checks the lease manager the thread uses.
+void
+useSession(const LeaseMgr* shared_mgr, bool* created, bool* own_mgr,
+           std::string* type)
+{
+    *created = LeaseMgrFactory::createSession();
+    *own_mgr = (&LeaseMgrFactory::instance() != shared_mgr);
+    *type = LeaseMgrFactory::instance().getType();
+}
+
+/// @brief Check the lease manager sessions
+///
+/// Each thread with a session has its own connection to the database.
+TEST_F(PgSqlLeaseMgrTest, session) {
+    bool created = false;
+    bool own_mgr = false;
+    std::string type;
+    bundy::util::thread::Thread thread(boost::bind(useSession, lmptr_,
+                                                   &created, &own_mgr,
+                                                   &type));
+    thread.wait();
+    EXPECT_TRUE(created);
+    EXPECT_TRUE(own_mgr);
+    EXPECT_EQ("postgresql", type);
+
+    // Threads without a session use the shared lease manager.
+    EXPECT_EQ(lmptr_, &LeaseMgrFactory::instance());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// LEASE4 /////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -370,6 +400,22 @@ TEST_F(PgSqlLeaseMgrTest, getLease4ClientIdSubnetId) {
     testGetLease4ClientIdSubnetId();
 }
 
+/// @brief Check GetLeases4 method - access by address range
+///
+/// Adds leases to the database and checks that the leases of a range of
+/// addresses can be retrieved.
+TEST_F(PgSqlLeaseMgrTest, getLeases4Range) {
+    testGetLeases4Range();
+}
+
+/// @brief Check GetExpiredLeases4 method
+///
+/// Checks that the expired leases are returned in order of expiration
+/// time.
+TEST_F(PgSqlLeaseMgrTest, getExpiredLeases4) {
+    testGetExpiredLeases4();
+}
+
 /// @brief Basic Lease4 Checks
 ///
 /// Checks that the addLease, getLease4(by address), getLease4(hwaddr,subnet_id),
@@ -421,6 +467,14 @@ TEST_F(PgSqlLeaseMgrTest, getLeases6DuidIaid) {
     testGetLeases6DuidIaid();
 }
 
+/// @brief Check GetExpiredLeases6 method
+///
+/// Checks that the expired leases are returned in order of expiration
+/// time.
+TEST_F(PgSqlLeaseMgrTest, getExpiredLeases6) {
+    testGetExpiredLeases6();
+}
+
 // Check that the system can cope with a DUID of allowed size.
 TEST_F(PgSqlLeaseMgrTest, getLeases6DuidSize) {
     testGetLeases6DuidSize();
@@ -456,4 +510,72 @@ TEST_F(PgSqlLeaseMgrTest, updateLease6) {
     testUpdateLease6();
 }
 
+
+/// @brief Batches of IPv4 leases
+///
+/// Checks that the leases added and deleted by batches are the same as
+/// added and deleted one by one.
+TEST_F(PgSqlLeaseMgrTest, batchLease4) {
+    PgSqlLeaseMgr* pgsql = dynamic_cast<PgSqlLeaseMgr*>(lmptr_);
+    ASSERT_TRUE(pgsql);
+
+    const std::vector<Lease4Ptr> leases = createLeases4();
+    const Lease4Collection batch(leases.begin(), leases.end());
+    EXPECT_EQ(leases.size(), pgsql->addLeases(batch));
+    for (size_t i = 0; i < leases.size(); ++i) {
+        Lease4Ptr lease = lmptr_->getLease4(leases[i]->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(leases[i], lease);
+    }
+
+    // The leases already there are not added again.
+    EXPECT_EQ(0, pgsql->addLeases(batch));
+
+    // Only the leases which exist are counted.
+    std::vector<IOAddress> addrs;
+    addrs.push_back(leases[0]->addr_);
+    addrs.push_back(leases[1]->addr_);
+    addrs.push_back(leases[1]->addr_);
+    EXPECT_EQ(2, pgsql->deleteLeases(addrs));
+    EXPECT_FALSE(lmptr_->getLease4(leases[0]->addr_));
+    EXPECT_FALSE(lmptr_->getLease4(leases[1]->addr_));
+    EXPECT_TRUE(lmptr_->getLease4(leases[2]->addr_));
+
+    // An empty batch does nothing.
+    EXPECT_EQ(0, pgsql->addLeases(Lease4Collection()));
+    EXPECT_EQ(0, pgsql->deleteLeases(std::vector<IOAddress>()));
+}
+
+/// @brief Batches of IPv6 leases
+///
+/// Checks that the leases added and deleted by batches are the same as
+/// added and deleted one by one.
+TEST_F(PgSqlLeaseMgrTest, batchLease6) {
+    PgSqlLeaseMgr* pgsql = dynamic_cast<PgSqlLeaseMgr*>(lmptr_);
+    ASSERT_TRUE(pgsql);
+
+    const std::vector<Lease6Ptr> leases = createLeases6();
+    const Lease6Collection batch(leases.begin(), leases.end());
+    EXPECT_EQ(leases.size(), pgsql->addLeases(batch));
+    for (size_t i = 0; i < leases.size(); ++i) {
+        Lease6Ptr lease = lmptr_->getLease6(leases[i]->type_,
+                                            leases[i]->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(leases[i], lease);
+    }
+    EXPECT_EQ(0, pgsql->addLeases(batch));
+
+    // IPv4 and IPv6 leases can be deleted by the same batch.
+    Lease4Collection leases4;
+    leases4.push_back(createLeases4()[0]);
+    EXPECT_EQ(1, pgsql->addLeases(leases4));
+    std::vector<IOAddress> addrs;
+    addrs.push_back(leases[0]->addr_);
+    addrs.push_back(leases4[0]->addr_);
+    EXPECT_EQ(2, pgsql->deleteLeases(addrs));
+    EXPECT_FALSE(lmptr_->getLease6(leases[0]->type_, leases[0]->addr_));
+    EXPECT_FALSE(lmptr_->getLease4(leases4[0]->addr_));
+    EXPECT_TRUE(lmptr_->getLease6(leases[1]->type_, leases[1]->addr_));
+}
+
 };
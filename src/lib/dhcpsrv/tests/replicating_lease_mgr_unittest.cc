@@ -0,0 +1,428 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/duid.h>
+#include <dhcpsrv/cfgmgr.h>
+#include <dhcpsrv/free_address_map.h>
+#include <dhcpsrv/memfile_lease_mgr.h>
+#include <dhcpsrv/replicating_lease_mgr.h>
+#include <dhcpsrv/tests/test_utils.h>
+#include <dhcpsrv/tests/generic_lease_mgr_unittest.h>
+
+#include <boost/lexical_cast.hpp>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace bundy;
+using namespace bundy::asiolink;
+using namespace bundy::dhcp;
+using namespace bundy::dhcp::test;
+
+namespace {
+
+// The paths of the sockets of two servers.
+std::string
+socketName(const char* server) {
+    return ("/tmp/bundy-lease-replication-" +
+            boost::lexical_cast<std::string>(getpid()) + "-" + server);
+}
+
+// The lease manager under test is the one of server "a", server "b"
+// being its peer.
+class ReplicatingLeaseMgrTest : public GenericLeaseMgrTest {
+public:
+    ReplicatingLeaseMgrTest() {
+        createLeaseMgrs(-1);
+    }
+
+    virtual ~ReplicatingLeaseMgrTest() {
+        lmptr_ = NULL;
+        CfgMgr::instance().deleteSubnets4();
+    }
+
+    /// @brief Creates the lease managers of the two servers.
+    ///
+    /// @param node the load balancing node of server "a", server "b"
+    /// being the other one.
+    void createLeaseMgrs(int node) {
+        lease_mgr_b_.reset();
+        lease_mgr_a_.reset();
+        LeaseMgr::ParameterMap parameters;
+        parameters["type"] = "memfile";
+        parameters["universe"] = "4";
+        parameters["persist"] = "false";
+        backend_a_ = new Memfile_LeaseMgr(parameters);
+        backend_b_ = new Memfile_LeaseMgr(parameters);
+        replicator_a_.reset(new LeaseReplicator(socketName("a"),
+                                                socketName("b"), node));
+        replicator_b_.reset(new LeaseReplicator(socketName("b"),
+                                                socketName("a"),
+                                                node < 0 ? -1 : 1 - node));
+        lease_mgr_a_.reset(new ReplicatingLeaseMgr(parameters, backend_a_,
+                                                   replicator_a_));
+        lease_mgr_b_.reset(new ReplicatingLeaseMgr(parameters, backend_b_,
+                                                   replicator_b_));
+        lmptr_ = lease_mgr_a_.get();
+    }
+
+    /// @brief The leases are in memory, so they can't be read again.
+    virtual void reopen(Universe) {
+    }
+
+    /// @brief Sends the changes of server "a" to server "b".
+    ///
+    /// @return the number of changes received.
+    size_t exchange() {
+        replicator_a_->flush();
+        return (lease_mgr_b_->receive());
+    }
+
+    /// @brief Sends the changes of server "b" to server "a".
+    ///
+    /// @return the number of changes received.
+    size_t exchangeBack() {
+        replicator_b_->flush();
+        return (lease_mgr_a_->receive());
+    }
+
+    Memfile_LeaseMgr* backend_a_;
+    Memfile_LeaseMgr* backend_b_;
+    LeaseReplicatorPtr replicator_a_;
+    LeaseReplicatorPtr replicator_b_;
+    boost::scoped_ptr<ReplicatingLeaseMgr> lease_mgr_a_;
+    boost::scoped_ptr<ReplicatingLeaseMgr> lease_mgr_b_;
+};
+
+// The same tests as for the memfile backend.
+
+TEST_F(ReplicatingLeaseMgrTest, getType) {
+    EXPECT_EQ("memfile", lmptr_->getType());
+    EXPECT_EQ("memory", lmptr_->getName());
+    EXPECT_EQ(backend_a_, &lease_mgr_a_->getBackend());
+    EXPECT_EQ(replicator_a_, lease_mgr_a_->getReplicator());
+}
+
+TEST_F(ReplicatingLeaseMgrTest, basicLease4) {
+    testBasicLease4();
+}
+
+TEST_F(ReplicatingLeaseMgrTest, basicLease6) {
+    testBasicLease6();
+}
+
+TEST_F(ReplicatingLeaseMgrTest, addGetDelete6) {
+    testAddGetDelete6(true);
+}
+
+TEST_F(ReplicatingLeaseMgrTest, getLeases4Range) {
+    testGetLeases4Range();
+}
+
+TEST_F(ReplicatingLeaseMgrTest, recreateLease4) {
+    testRecreateLease4();
+}
+
+TEST_F(ReplicatingLeaseMgrTest, recreateLease6) {
+    testRecreateLease6();
+}
+
+// Checks that the changes of the IPv4 leases are made by the peer.
+TEST_F(ReplicatingLeaseMgrTest, replicate4) {
+    // The peer is not known before the first batch is sent.
+    EXPECT_FALSE(replicator_a_->isPeerUp());
+    EXPECT_EQ(0, exchange());
+    EXPECT_TRUE(replicator_a_->isPeerUp());
+
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_EQ(1, replicator_a_->getQueuedBatches());
+    EXPECT_EQ(1, exchange());
+    EXPECT_EQ(0, replicator_a_->getQueuedBatches());
+    Lease4Ptr replicated = backend_b_->getLease4(lease->addr_);
+    ASSERT_TRUE(replicated);
+    detailCompareLease(lease, replicated);
+
+    // The changes received are not sent back.
+    EXPECT_EQ(0, replicator_b_->getQueuedBatches());
+
+    lease->valid_lft_ += 100;
+    lease->hostname_ = "myhost.example.com.";
+    lmptr_->updateLease4(lease);
+    EXPECT_EQ(1, exchange());
+    replicated = backend_b_->getLease4(lease->addr_);
+    ASSERT_TRUE(replicated);
+    detailCompareLease(lease, replicated);
+
+    // An update of a lease the peer doesn't have adds it.
+    ASSERT_TRUE(backend_b_->deleteLease(lease->addr_));
+    lmptr_->updateLease4(lease);
+    EXPECT_EQ(1, exchange());
+    EXPECT_TRUE(backend_b_->getLease4(lease->addr_));
+
+    EXPECT_TRUE(lmptr_->deleteLease(lease->addr_));
+    EXPECT_FALSE(lmptr_->deleteLease(lease->addr_));
+    EXPECT_EQ(1, exchange());
+    EXPECT_FALSE(backend_b_->getLease4(lease->addr_));
+
+    // Nothing is sent if the lease is not changed.
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_FALSE(lmptr_->addLease(lease));
+    EXPECT_EQ(1, exchange());
+}
+
+// Checks that the changes of the IPv6 leases are made by the peer.
+TEST_F(ReplicatingLeaseMgrTest, replicate6) {
+    const Lease6Ptr lease = initializeLease6(straddress6_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_EQ(1, exchange());
+    Lease6Ptr replicated = backend_b_->getLease6(lease->type_, lease->addr_);
+    ASSERT_TRUE(replicated);
+    EXPECT_EQ(lease->type_, replicated->type_);
+    EXPECT_EQ(lease->iaid_, replicated->iaid_);
+    EXPECT_TRUE(*lease->duid_ == *replicated->duid_);
+    EXPECT_EQ(lease->valid_lft_, replicated->valid_lft_);
+
+    lease->valid_lft_ += 100;
+    lmptr_->updateLease6(lease);
+    EXPECT_EQ(1, exchange());
+    replicated = backend_b_->getLease6(lease->type_, lease->addr_);
+    ASSERT_TRUE(replicated);
+    EXPECT_EQ(lease->valid_lft_, replicated->valid_lft_);
+
+    EXPECT_TRUE(lmptr_->deleteLease(lease->addr_));
+    EXPECT_EQ(1, exchange());
+    EXPECT_FALSE(backend_b_->getLease6(lease->type_, lease->addr_));
+}
+
+// Checks that both servers keep the same lease when they leased an address
+// to different clients, whatever the server which leased it first.
+TEST_F(ReplicatingLeaseMgrTest, conflict4) {
+    // The client identifier of the lease of "low" is the lowest.
+    const Lease4Ptr low = initializeLease4(straddress4_[1]);
+    low->cltt_ = time(NULL);
+    const Lease4Ptr high(new Lease4(*low));
+    high->client_id_.reset(new ClientId(std::vector<uint8_t>(8, 0x64)));
+    high->hwaddr_ = std::vector<uint8_t>(6, 0x2a);
+
+    for (int low_first = 0; low_first < 2; ++low_first) {
+        const Lease4Ptr lease_a = low_first ? low : high;
+        const Lease4Ptr lease_b = low_first ? high : low;
+        ASSERT_TRUE(lmptr_->addLease(lease_a));
+        ASSERT_TRUE(lease_mgr_b_->addLease(lease_b));
+        EXPECT_EQ(1, exchange());
+        EXPECT_EQ(1, exchangeBack());
+
+        Lease4Ptr lease = backend_a_->getLease4(low->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(low, lease);
+        lease = backend_b_->getLease4(low->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(low, lease);
+
+        // The later changes of the lease kept are made by both servers.
+        low->valid_lft_ += 100;
+        lmptr_->updateLease4(low);
+        EXPECT_EQ(1, exchange());
+        lease = backend_b_->getLease4(low->addr_);
+        ASSERT_TRUE(lease);
+        detailCompareLease(low, lease);
+        EXPECT_TRUE(lmptr_->deleteLease(low->addr_));
+        EXPECT_EQ(1, exchange());
+        EXPECT_FALSE(backend_b_->getLease4(low->addr_));
+    }
+
+    // The deletion of the lease of the other client is ignored.
+    ASSERT_TRUE(lmptr_->addLease(low));
+    ASSERT_TRUE(lease_mgr_b_->addLease(high));
+    ASSERT_TRUE(lease_mgr_b_->deleteLease(high->addr_));
+    EXPECT_EQ(2, exchangeBack());
+    Lease4Ptr lease = backend_a_->getLease4(low->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(low, lease);
+    EXPECT_EQ(1, exchange());
+    lease = backend_b_->getLease4(low->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(low, lease);
+
+    // An expired lease of another client is replaced.
+    EXPECT_TRUE(lmptr_->deleteLease(low->addr_));
+    EXPECT_EQ(1, exchange());
+    const Lease4Ptr expired(new Lease4(*low));
+    expired->cltt_ = time(NULL) - expired->valid_lft_ - 10;
+    ASSERT_TRUE(backend_a_->addLease(expired));
+    ASSERT_TRUE(lease_mgr_b_->addLease(high));
+    EXPECT_EQ(1, exchangeBack());
+    lease = backend_a_->getLease4(high->addr_);
+    ASSERT_TRUE(lease);
+    detailCompareLease(high, lease);
+}
+
+// Checks that an IPv4 address deleted by the peer is made available for
+// allocation.
+TEST_F(ReplicatingLeaseMgrTest, releaseAddress4) {
+    const Subnet4Ptr subnet(new Subnet4(IOAddress("192.0.2.0"), 24, 1000,
+                                        2000, 3000));
+    const Pool4Ptr pool(new Pool4(IOAddress("192.0.2.0"), 24));
+    subnet->addPool(pool);
+    CfgMgr::instance().addSubnet4(subnet);
+    const FreeAddressMapPtr free_addresses(
+        new FreeAddressMap(pool->getFirstAddress(), pool->getLastAddress()));
+    pool->setFreeAddresses(free_addresses);
+
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    lease->subnet_id_ = subnet->getID();
+    ASSERT_TRUE(lease_mgr_b_->addLease(lease));
+    EXPECT_EQ(1, exchangeBack());
+    free_addresses->markUsed(lease->addr_);
+
+    ASSERT_TRUE(lease_mgr_b_->deleteLease(lease->addr_));
+    EXPECT_EQ(1, exchangeBack());
+    EXPECT_FALSE(backend_a_->getLease4(lease->addr_));
+    EXPECT_TRUE(free_addresses->isFree(lease->addr_));
+}
+
+// Checks that the changes are sent in batches.
+TEST_F(ReplicatingLeaseMgrTest, batches) {
+    EXPECT_EQ(0, exchange());
+
+    // Add enough leases for several batches: the full batches are sent
+    // at once.
+    const size_t count = 1000;
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    for (size_t i = 0; i < count; ++i) {
+        lease->addr_ = IOAddress(0x0a000001 + i);
+        lease->subnet_id_ = i + 1;
+        ASSERT_TRUE(lmptr_->addLease(lease));
+        EXPECT_GE(1, replicator_a_->getQueuedBatches());
+    }
+    EXPECT_EQ(count, exchange());
+    EXPECT_EQ(count, backend_b_->getLeases4(IOAddress("10.0.0.0"),
+                                            IOAddress("10.255.255.255"))
+              .size());
+}
+
+// Checks that the changes are not queued while the peer is down.
+TEST_F(ReplicatingLeaseMgrTest, peerDown) {
+    lease_mgr_b_.reset();
+    replicator_b_.reset();
+
+    replicator_a_->flush();
+    EXPECT_FALSE(replicator_a_->isPeerUp());
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_EQ(0, replicator_a_->getQueuedBatches());
+
+    // The socket of the peer is closed with it, so a peer can be restarted
+    // and its socket removed by the destructor of the previous one.
+    replicator_b_.reset(new LeaseReplicator(socketName("b"),
+                                            socketName("a"), -1));
+    LeaseReplicatorPtr replicator(new LeaseReplicator(socketName("b"),
+                                                      socketName("a"), -1));
+    replicator_b_.reset();
+    EXPECT_EQ(0, access(socketName("b").c_str(), F_OK));
+    replicator.reset();
+    EXPECT_NE(0, access(socketName("b").c_str(), F_OK));
+}
+
+// Checks that the servers share the clients while both run.
+TEST_F(ReplicatingLeaseMgrTest, loadBalancing) {
+    createLeaseMgrs(0);
+    EXPECT_EQ(0, replicator_a_->getNode());
+    EXPECT_EQ(1, replicator_b_->getNode());
+
+    // The peer is not known to run, so all the clients are answered.
+    uint8_t id[6] = { 0, 1, 2, 3, 4, 5 };
+    size_t count_a = 0;
+    for (int i = 0; i < 256; ++i) {
+        id[5] = i;
+        EXPECT_TRUE(replicator_a_->inScope(id, sizeof(id)));
+    }
+
+    // Each client is answered by one of the servers.
+    replicator_a_->flush();
+    replicator_b_->flush();
+    ASSERT_TRUE(replicator_a_->isPeerUp());
+    ASSERT_TRUE(replicator_b_->isPeerUp());
+    for (int i = 0; i < 256; ++i) {
+        id[5] = i;
+        const bool in_a = replicator_a_->inScope(id, sizeof(id));
+        EXPECT_NE(in_a, replicator_b_->inScope(id, sizeof(id)));
+        if (in_a) {
+            ++count_a;
+        }
+    }
+    EXPECT_LT(64, count_a);
+    EXPECT_GT(192, count_a);
+
+    // A client without identifier is answered by both.
+    EXPECT_TRUE(replicator_a_->inScope(NULL, 0));
+    EXPECT_TRUE(replicator_b_->inScope(NULL, 0));
+}
+
+// Checks that the datagrams which are not valid are discarded.
+TEST_F(ReplicatingLeaseMgrTest, invalidDatagram) {
+    const int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    ASSERT_LE(0, fd);
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    const std::string name = socketName("b");
+    std::strcpy(addr.sun_path, name.c_str());
+
+    // Not a batch.
+    const char garbage[] = "not a batch of leases";
+    ASSERT_LT(0, sendto(fd, garbage, sizeof(garbage), 0,
+                        reinterpret_cast<const struct sockaddr*>(&addr),
+                        sizeof(addr)));
+    // A batch with a truncated record.
+    const uint8_t truncated[] = { 'B', 'D', 'L', 'R', 0, 0, 0, 1,
+                                  0, 0, 0, 100, 4 };
+    ASSERT_LT(0, sendto(fd, truncated, sizeof(truncated), 0,
+                        reinterpret_cast<const struct sockaddr*>(&addr),
+                        sizeof(addr)));
+    close(fd);
+    EXPECT_EQ(0, lease_mgr_b_->receive());
+
+    // Valid batches are still received.
+    const Lease4Ptr lease = initializeLease4(straddress4_[1]);
+    ASSERT_TRUE(lmptr_->addLease(lease));
+    EXPECT_EQ(1, exchange());
+}
+
+// Checks that the parameters of a replicator are checked.
+TEST(LeaseReplicatorTest, invalidParameters) {
+    EXPECT_THROW(LeaseReplicator("", socketName("b"), -1), BadValue);
+    EXPECT_THROW(LeaseReplicator(socketName("a"), "", -1), BadValue);
+    EXPECT_THROW(LeaseReplicator(socketName("a"), socketName("a"), -1),
+                 BadValue);
+    EXPECT_THROW(LeaseReplicator(socketName("a"), std::string(200, 'x'), -1),
+                 BadValue);
+    EXPECT_THROW(LeaseReplicator(socketName("a"), socketName("b"), 2),
+                 BadValue);
+    EXPECT_THROW(LeaseReplicator("/nonexistent-dir/socket", socketName("b"),
+                                 -1), DbOperationError);
+}
+
+}; // end of anonymous namespace
@@ -0,0 +1,312 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <asiolink/io_address.h>
+#include <dhcp/dhcp6.h>
+#include <dhcp/option.h>
+#include <dhcpsrv/subnet.h>
+#include <dhcpsrv/subnet_index.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace bundy;
+using namespace bundy::dhcp;
+using namespace bundy::asiolink;
+
+namespace {
+
+class SubnetIndexTest : public ::testing::Test {
+public:
+    // Adds an IPv4 subnet to the index and to the list of subnets
+    Subnet4Ptr addSubnet4(const std::string& prefix, uint8_t len) {
+        Subnet4Ptr subnet(new Subnet4(IOAddress(prefix), len, 1, 2, 3));
+        subnets4_.push_back(subnet);
+        index_.add(*subnet);
+        return (subnet);
+    }
+
+    // Adds an IPv6 subnet to the index and to the list of subnets
+    Subnet6Ptr addSubnet6(const std::string& prefix, uint8_t len,
+                          const OptionPtr& interface_id = OptionPtr()) {
+        Subnet6Ptr subnet(new Subnet6(IOAddress(prefix), len, 1, 2, 3, 4));
+        subnet->setInterfaceId(interface_id);
+        subnets6_.push_back(subnet);
+        index_.add(*subnet, interface_id);
+        return (subnet);
+    }
+
+    // Rebuilds the index of the IPv4 subnets, after their classes changed
+    void reindex4() {
+        index_.clear();
+        for (size_t i = 0; i < subnets4_.size(); ++i) {
+            index_.add(*subnets4_[i]);
+        }
+    }
+
+    // Finds the position of the first subnet in range by the linear search
+    size_t findLinear4(const IOAddress& addr) const {
+        for (size_t i = 0; i < subnets4_.size(); ++i) {
+            if (subnets4_[i]->clientSupported(classes_) &&
+                subnets4_[i]->inRange(addr)) {
+                return (i);
+            }
+        }
+        return (SubnetIndex::NOT_FOUND);
+    }
+
+    SubnetIndex index_;
+    Subnet4Collection subnets4_;
+    Subnet6Collection subnets6_;
+    ClientClasses classes_;
+};
+
+// Checks that the subnets are found by the address in them.
+TEST_F(SubnetIndexTest, address4) {
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByAddress(IOAddress("192.0.2.1"), classes_, false));
+
+    addSubnet4("192.0.2.0", 24);
+    addSubnet4("192.0.3.0", 24);
+    addSubnet4("10.0.0.0", 8);
+    EXPECT_EQ(3, index_.size());
+
+    EXPECT_EQ(0, index_.findByAddress(IOAddress("192.0.2.1"), classes_,
+                                      false));
+    EXPECT_EQ(0, index_.findByAddress(IOAddress("192.0.2.255"), classes_,
+                                      false));
+    EXPECT_EQ(1, index_.findByAddress(IOAddress("192.0.3.0"), classes_,
+                                      false));
+    EXPECT_EQ(2, index_.findByAddress(IOAddress("10.20.30.40"), classes_,
+                                      false));
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByAddress(IOAddress("192.0.4.1"), classes_, false));
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByAddress(IOAddress("11.0.0.1"), classes_, false));
+
+    // IPv4 subnets never contain IPv6 addresses.
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByAddress(IOAddress("::"), classes_, false));
+
+    index_.clear();
+    EXPECT_EQ(0, index_.size());
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByAddress(IOAddress("192.0.2.1"), classes_, false));
+}
+
+// Checks that of the overlapping subnets the first added one is found,
+// as it would be by the linear search.
+TEST_F(SubnetIndexTest, overlapping) {
+    addSubnet4("192.0.2.0", 24);
+    addSubnet4("192.0.0.0", 16);
+    addSubnet4("192.0.2.128", 25);
+    addSubnet4("0.0.0.0", 0);
+
+    EXPECT_EQ(0, index_.findByAddress(IOAddress("192.0.2.200"), classes_,
+                                      false));
+    EXPECT_EQ(1, index_.findByAddress(IOAddress("192.0.3.1"), classes_,
+                                      false));
+    EXPECT_EQ(3, index_.findByAddress(IOAddress("10.0.0.1"), classes_,
+                                      false));
+
+    // The client is not supported in the first subnets, so the other
+    // subnets containing the address are used.
+    subnets4_[0]->allowClientClass("foo");
+    reindex4();
+    EXPECT_EQ(1, index_.findByAddress(IOAddress("192.0.2.200"), classes_,
+                                      false));
+    subnets4_[1]->allowClientClass("foo");
+    reindex4();
+    EXPECT_EQ(2, index_.findByAddress(IOAddress("192.0.2.200"), classes_,
+                                      false));
+    EXPECT_EQ(3, index_.findByAddress(IOAddress("192.0.2.1"), classes_,
+                                      false));
+    classes_.insert("foo");
+    EXPECT_EQ(0, index_.findByAddress(IOAddress("192.0.2.200"), classes_,
+                                      false));
+}
+
+// Checks that the subnets are selected by the classes they support, with
+// more classes than the bits of a word.
+TEST_F(SubnetIndexTest, classes) {
+    for (int i = 0; i < 100; ++i) {
+        Subnet4Ptr subnet = addSubnet4("192.0.2.0", 24);
+        subnet->allowClientClass("class-" +
+                                 boost::lexical_cast<std::string>(i));
+        if (i % 2 == 1) {
+            subnet->allowClientClass("odd");
+        }
+    }
+    addSubnet4("0.0.0.0", 0);
+    reindex4();
+    const IOAddress addr("192.0.2.1");
+
+    // The client is in no class, so only the last subnet supports it.
+    EXPECT_EQ(100, index_.findByAddress(addr, classes_, false));
+    EXPECT_EQ(findLinear4(addr), index_.findByAddress(addr, classes_, false));
+
+    // A class no subnet is restricted to is ignored.
+    classes_.insert("unknown");
+    EXPECT_EQ(100, index_.findByAddress(addr, classes_, false));
+
+    classes_.insert("class-70");
+    EXPECT_EQ(70, index_.findByAddress(addr, classes_, false));
+    classes_.insert("class-99");
+    EXPECT_EQ(70, index_.findByAddress(addr, classes_, false));
+    classes_.insert("odd");
+    EXPECT_EQ(1, index_.findByAddress(addr, classes_, false));
+    EXPECT_EQ(findLinear4(addr), index_.findByAddress(addr, classes_, false));
+    classes_.insert("class-0");
+    EXPECT_EQ(0, index_.findByAddress(addr, classes_, false));
+
+    // The classes are forgotten when the index is cleared.
+    index_.clear();
+    index_.add(*subnets4_[100]);
+    EXPECT_EQ(0, index_.findByAddress(addr, classes_, false));
+}
+
+// Compares the results of the index with the linear search for many
+// random subnets and addresses.
+TEST_F(SubnetIndexTest, randomSubnets) {
+    srandom(1);
+    for (int i = 0; i < 1000; ++i) {
+        const uint8_t len = 8 + random() % 25;
+        const uint32_t prefix = static_cast<uint32_t>(random()) &
+            ~((1ULL << (32 - len)) - 1) & 0xffffffff;
+        Subnet4Ptr subnet(new Subnet4(IOAddress(prefix), len, 1, 2, 3));
+        subnets4_.push_back(subnet);
+        index_.add(*subnet);
+    }
+    for (int i = 0; i < 10000; ++i) {
+        // Take addresses near the subnets, so most of them are in some.
+        const Subnet4Ptr& subnet = subnets4_[random() % subnets4_.size()];
+        const uint32_t addr = static_cast<uint32_t>(subnet->get().first) +
+            random() % 1024;
+        EXPECT_EQ(findLinear4(IOAddress(addr)),
+                  index_.findByAddress(IOAddress(addr), classes_, false))
+            << IOAddress(addr);
+    }
+}
+
+// Checks the address and relay address selection of IPv6 subnets.
+TEST_F(SubnetIndexTest, address6Relay) {
+    addSubnet6("2001:db8:1::", 48);
+    addSubnet6("2001:db8:2::", 48);
+    addSubnet6("2001:db8::", 32);
+    // The index has to be rebuilt when a subnet is modified.
+    subnets6_[1]->setRelayInfo(IOAddress("2001:db8:1::1"));
+    index_.clear();
+    for (size_t i = 0; i < subnets6_.size(); ++i) {
+        index_.add(*subnets6_[i]);
+    }
+
+    EXPECT_EQ(0, index_.findByAddress(IOAddress("2001:db8:1::1"), classes_,
+                                      false));
+    EXPECT_EQ(2, index_.findByAddress(IOAddress("2001:db8:3::1"), classes_,
+                                      false));
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByAddress(IOAddress("2001:db9::1"), classes_, false));
+
+    // The relay address matches the second subnet, but the first one
+    // contains it and comes first.
+    EXPECT_EQ(0, index_.findByAddress(IOAddress("2001:db8:1::1"), classes_,
+                                      true));
+    subnets6_[0]->allowClientClass("foo");
+    index_.clear();
+    for (size_t i = 0; i < subnets6_.size(); ++i) {
+        index_.add(*subnets6_[i]);
+    }
+    EXPECT_EQ(1, index_.findByAddress(IOAddress("2001:db8:1::1"), classes_,
+                                      true));
+    EXPECT_EQ(2, index_.findByAddress(IOAddress("2001:db8:1::1"), classes_,
+                                      false));
+}
+
+// Checks the selection by interface name and interface-id.
+TEST_F(SubnetIndexTest, ifaceInterfaceId) {
+    const OptionBuffer data1(4, 1);
+    const OptionBuffer data2(4, 2);
+    OptionPtr ifaceid1(new Option(Option::V6, D6O_INTERFACE_ID, data1));
+    OptionPtr ifaceid2(new Option(Option::V6, D6O_INTERFACE_ID, data2));
+
+    Subnet6Ptr subnet(new Subnet6(IOAddress("2001:db8:1::"), 48, 1, 2, 3, 4));
+    subnet->setIface("eth0");
+    index_.add(*subnet, ifaceid1);
+    Subnet6Ptr subnet2(new Subnet6(IOAddress("2001:db8:2::"), 48, 1, 2, 3, 4));
+    subnet2->setIface("eth1");
+    subnet2->allowClientClass("foo");
+    index_.add(*subnet2, ifaceid2);
+    Subnet6Ptr subnet3(new Subnet6(IOAddress("2001:db8:3::"), 48, 1, 2, 3, 4));
+    subnet3->setIface("eth1");
+    index_.add(*subnet3, ifaceid2);
+
+    EXPECT_EQ(0, index_.findByIface("eth0", classes_));
+    EXPECT_EQ(2, index_.findByIface("eth1", classes_));
+    EXPECT_EQ(SubnetIndex::NOT_FOUND, index_.findByIface("eth2", classes_));
+    EXPECT_EQ(SubnetIndex::NOT_FOUND, index_.findByIface("", classes_));
+
+    EXPECT_EQ(0, index_.findByInterfaceId(*ifaceid1, classes_));
+    EXPECT_EQ(2, index_.findByInterfaceId(*ifaceid2, classes_));
+    const Option other(Option::V6, D6O_INTERFACE_ID, OptionBuffer(3, 1));
+    EXPECT_EQ(SubnetIndex::NOT_FOUND,
+              index_.findByInterfaceId(other, classes_));
+
+    classes_.insert("foo");
+    EXPECT_EQ(1, index_.findByIface("eth1", classes_));
+    EXPECT_EQ(1, index_.findByInterfaceId(*ifaceid2, classes_));
+}
+
+// Counts the changes of an indexed subnet.
+void
+countChange(int* changes) {
+    ++*changes;
+}
+
+// Checks that the index callback is called when the selection parameters
+// of an indexed subnet are changed, and only then.
+TEST_F(SubnetIndexTest, indexCallback) {
+    Subnet4Ptr subnet(new Subnet4(IOAddress("192.0.2.0"), 24, 1, 2, 3));
+    int changes = 0;
+    subnet->setRelayInfo(IOAddress("10.0.0.1"));
+    subnet->setIface("eth0");
+
+    subnet->setIndexed(boost::bind(countChange, &changes));
+    subnet->setRelayInfo(IOAddress("10.0.0.2"));
+    EXPECT_EQ(1, changes);
+    subnet->setIface("eth1");
+    EXPECT_EQ(2, changes);
+    subnet->allowClientClass("foo");
+    EXPECT_EQ(3, changes);
+    subnet->setSiaddr(IOAddress("192.0.2.254"));
+    EXPECT_EQ(3, changes);
+
+    subnet->setIndexed(Subnet::IndexCallback());
+    subnet->setRelayInfo(IOAddress("10.0.0.3"));
+    EXPECT_EQ(3, changes);
+
+    Subnet6Ptr subnet6(new Subnet6(IOAddress("2001:db8::"), 64, 1, 2, 3, 4));
+    subnet6->setIndexed(boost::bind(countChange, &changes));
+    subnet6->setInterfaceId(OptionPtr(new Option(Option::V6,
+                                                 D6O_INTERFACE_ID,
+                                                 OptionBuffer(2, 1))));
+    EXPECT_EQ(4, changes);
+}
+
+}
@@ -259,6 +259,45 @@ TEST(Subnet4Test, addInvalidOption) {
                  bundy::BadValue);
 }
 
+// This test verifies that the packed options are stored by key and dropped
+// when the options of the subnet change.
+TEST(Subnet4Test, packedOptions) {
+    Subnet4Ptr subnet(new Subnet4(IOAddress("192.0.2.0"), 24, 1, 2, 3));
+    OptionPtr option(new Option(Option::V4, 3, OptionBuffer(4, 1)));
+    subnet->addOption(option, false, "dhcp4");
+
+    OptionCollection options;
+    options.insert(std::make_pair(3, option));
+    ConstPackedOptionsPtr packed(new PackedOptions(options));
+    const std::vector<uint8_t> key(1, 3);
+    EXPECT_FALSE(subnet->getPackedOptions(key));
+    subnet->setPackedOptions(key, packed);
+    EXPECT_EQ(packed, subnet->getPackedOptions(key));
+    EXPECT_FALSE(subnet->getPackedOptions(std::vector<uint8_t>(1, 4)));
+
+    // Adding or deleting options drops the packed options.
+    subnet->addOption(OptionPtr(new Option(Option::V4, 6)), false, "dhcp4");
+    EXPECT_FALSE(subnet->getPackedOptions(key));
+    subnet->setPackedOptions(key, packed);
+    subnet->addVendorOption(OptionPtr(new Option(Option::V4, 1)), false,
+                            4491);
+    EXPECT_FALSE(subnet->getPackedOptions(key));
+    subnet->setPackedOptions(key, packed);
+    subnet->delOptions();
+    EXPECT_FALSE(subnet->getPackedOptions(key));
+    subnet->setPackedOptions(key, packed);
+    subnet->delVendorOptions();
+    EXPECT_FALSE(subnet->getPackedOptions(key));
+
+    // The number of stored sets of options is bounded.
+    for (unsigned int i = 0; i < 1000; ++i) {
+        const std::vector<uint8_t> other_key(i / 256 + 1, i % 256);
+        subnet->setPackedOptions(other_key, packed);
+        EXPECT_EQ(packed, subnet->getPackedOptions(other_key));
+    }
+    EXPECT_FALSE(subnet->getPackedOptions(std::vector<uint8_t>(1, 0)));
+}
+
 // This test verifies that inRange() and inPool() methods work properly.
 TEST(Subnet4Test, inRangeinPool) {
     Subnet4Ptr subnet(new Subnet4(IOAddress("192.0.0.0"), 8, 1, 2, 3));
@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -14,9 +14,11 @@
 
 #include <hooks/callout_handle.h>
 #include <hooks/callout_manager.h>
+#include <hooks/hooks_manager.h>
 #include <hooks/library_handle.h>
 #include <hooks/server_hooks.h>
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -31,7 +33,10 @@ CalloutHandle::CalloutHandle(const boost::shared_ptr<CalloutManager>& manager,
                     const boost::shared_ptr<LibraryManagerCollection>& lmcoll)
     : lm_collection_(lmcoll), arguments_(), context_collection_(),
       manager_(manager), server_hooks_(ServerHooks::getServerHooks()),
-      skip_(false) {
+      skip_(false), park_(false) {
+
+    // Make room for all the arguments known so far.
+    arguments_.resize(server_hooks_.getArgumentCount());
 
     // Call the "context_create" hook.  We should be OK doing this - although
     // the constructor has not finished running, all the member variables
@@ -72,14 +77,28 @@ vector<string>
 CalloutHandle::getArgumentNames() const {
 
     vector<string> names;
-    for (ElementCollection::const_iterator i = arguments_.begin();
-         i != arguments_.end(); ++i) {
-        names.push_back(i->first);
+    for (size_t i = 0; i < arguments_.size(); ++i) {
+        if (!arguments_[i].empty()) {
+            names.push_back(server_hooks_.getArgumentName(i));
+        }
     }
 
+    // Return them in the same order as when the arguments were kept by name.
+    sort(names.begin(), names.end());
     return (names);
 }
 
+// Extend the argument array so that the argument of the index fits in.
+
+void
+CalloutHandle::extendArguments(int index) {
+    if (index < 0) {
+        bundy_throw(NoSuchArgument, "argument index " << index <<
+                  " is not valid");
+    }
+    arguments_.resize(max(index + 1, server_hooks_.getArgumentCount()));
+}
+
 // Return the library handle allowing the callout to access the CalloutManager
 // registration/deregistration functions.
 
@@ -88,6 +107,13 @@ CalloutHandle::getLibraryHandle() const {
     return (manager_->getLibraryHandle());
 }
 
+// Return the parking lot of the hook being called.
+
+ParkingLotPtr
+CalloutHandle::getParkingLot() const {
+    return (HooksManager::getParkingLot(manager_->getHookIndex()));
+}
+
 // Return the context for the currently pointed-to library.  This version is
 // used by the "setContext()" method and creates a context for the current
 // library if it does not exist.
@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -17,6 +17,8 @@
 
 #include <exceptions/exceptions.h>
 #include <hooks/library_handle.h>
+#include <hooks/parking_lot.h>
+#include <hooks/server_hooks.h>
 
 #include <boost/any.hpp>
 #include <boost/shared_ptr.hpp>
@@ -28,8 +30,6 @@
 namespace bundy {
 namespace hooks {
 
-class ServerHooks;
-
 /// @brief No such argument
 ///
 /// Thrown if an attempt is made access an argument that does not exist.
@@ -69,7 +69,10 @@ class LibraryManagerCollection;
 /// - Arguments.  When the callouts associated with a hook are called, they
 ///   are passed information by the server (and can return information to it)
 ///   through name/value pairs.  Each of these pairs is an argument and the
-///   information is accessed through the {get,set}Argument() methods.
+///   information is accessed through the {get,set}Argument() methods.  The
+///   arguments are held in an array indexed by the number assigned to each
+///   argument name by ServerHooks::registerArgument(); the server uses
+///   these numbers instead of the names.
 ///
 /// - Per-packet context.  Each packet has a context associated with it, this
 ///   context being  on a per-library basis.  In other words, As a packet passes
@@ -92,8 +95,8 @@ class CalloutHandle {
 public:
 
     /// Typedef to allow abbreviation of iterator specification in methods.
-    /// The std::string is the argument name and the "boost::any" is the
-    /// corresponding value associated with it.
+    /// The std::string is the name of a context item and the "boost::any"
+    /// is the corresponding value associated with it.
     typedef std::map<std::string, boost::any> ElementCollection;
 
     /// Typedef to allow abbreviations in specifications when accessing
@@ -108,6 +111,12 @@ public:
     /// need to be set when the CalloutHandle is constructed.
     typedef std::map<int, ElementCollection> ContextCollection;
 
+    /// Typedef of the array of arguments passed to the callouts.  The
+    /// argument of each name is at the index assigned to the name by
+    /// ServerHooks::registerArgument() (an empty value meaning that the
+    /// argument is not present).
+    typedef std::vector<boost::any> ArgumentCollection;
+
     /// @brief Constructor
     ///
     /// Creates the object and calls the callouts on the "context_create"
@@ -145,7 +154,22 @@ public:
     /// @param value Value to set.  That can be of any data type.
     template <typename T>
     void setArgument(const std::string& name, T value) {
-        arguments_[name] = value;
+        getArgumentSlot(server_hooks_.registerArgument(name)) = value;
+    }
+
+    /// @brief Set argument by index
+    ///
+    /// Sets the value of the argument with the given index (as returned by
+    /// ServerHooks::registerArgument()).  This is what the server uses to
+    /// pass the arguments, as no name has to be looked up.
+    ///
+    /// @param index Index of the argument.
+    /// @param value Value to set.  That can be of any data type.
+    ///
+    /// @throw NoSuchArgument The index is invalid.
+    template <typename T>
+    void setArgument(int index, T value) {
+        getArgumentSlot(index) = value;
     }
 
     /// @brief Get argument
@@ -162,13 +186,34 @@ public:
     ///        the variable provided to receive the value.
     template <typename T>
     void getArgument(const std::string& name, T& value) const {
-        ElementCollection::const_iterator element_ptr = arguments_.find(name);
-        if (element_ptr == arguments_.end()) {
+        const int index = server_hooks_.getArgumentIndex(name);
+        if (!hasArgument(index)) {
             bundy_throw(NoSuchArgument, "unable to find argument with name " <<
                       name);
         }
 
-        value = boost::any_cast<T>(element_ptr->second);
+        value = boost::any_cast<T>(arguments_[index]);
+    }
+
+    /// @brief Get argument by index
+    ///
+    /// Gets the value of the argument with the given index.
+    ///
+    /// @param index Index of the argument.
+    /// @param value [out] Value to set.  The type of "value" is important:
+    ///        it must match the type of the value set.
+    ///
+    /// @throw NoSuchArgument No argument with the given index is present.
+    /// @throw boost::bad_any_cast The data type of the value is not the same
+    ///        as the type of the variable provided to receive the value.
+    template <typename T>
+    void getArgument(int index, T& value) const {
+        if (!hasArgument(index)) {
+            bundy_throw(NoSuchArgument, "unable to find argument with index " <<
+                      index);
+        }
+
+        value = boost::any_cast<T>(arguments_[index]);
     }
 
     /// @brief Get argument names
@@ -189,17 +234,34 @@ public:
     ///
     /// @param name Name of the element in the argument list to set.
     void deleteArgument(const std::string& name) {
-        static_cast<void>(arguments_.erase(name));
+        deleteArgument(server_hooks_.getArgumentIndex(name));
+    }
+
+    /// @brief Delete argument by index
+    ///
+    /// Deletes the argument with the given index.  If that argument does
+    /// not exist, the method is a no-op.
+    ///
+    /// @param index Index of the argument.
+    void deleteArgument(int index) {
+        if (hasArgument(index)) {
+            boost::any().swap(arguments_[index]);
+        }
     }
 
     /// @brief Delete all arguments
     ///
-    /// Deletes all arguments associated with this context.
+    /// Deletes all arguments associated with this context.  The array
+    /// holding them is kept, so setting the arguments again doesn't
+    /// allocate it again.
     ///
     /// N.B. If any elements are raw pointers, the pointed-to data is NOT
     /// deleted by this method.
     void deleteAllArguments() {
-        arguments_.clear();
+        for (ArgumentCollection::iterator i = arguments_.begin();
+             i != arguments_.end(); ++i) {
+            boost::any().swap(*i);
+        }
     }
 
     /// @brief Set skip flag
@@ -222,6 +284,40 @@ public:
         return (skip_);
     }
 
+    /// @brief Set park flag
+    ///
+    /// Sets the "park" variable in the callout handle.  A callout sets it
+    /// to tell the server that it has kept the packet in the parking lot
+    /// of the hook (see getParkingLot()): the server suspends the
+    /// processing of the packet, which is resumed when the callout unparks
+    /// it.  Only the hooks documented as such support parking.
+    ///
+    /// @param park New value of the "park" flag.
+    void setPark(bool park) {
+        park_ = park;
+    }
+
+    /// @brief Get park flag
+    ///
+    /// Gets the current value of the "park" flag.
+    ///
+    /// @return Current value of the park flag.
+    bool getPark() const {
+        return (park_);
+    }
+
+    /// @brief Access the parking lot of the current hook
+    ///
+    /// Returns the parking lot holding the packets whose processing is
+    /// suspended by the callouts of the hook being called.  Like
+    /// getLibraryHandle(), this is only available when called by a callout.
+    ///
+    /// @return Pointer to the parking lot.
+    ///
+    /// @throw NoSuchHook thrown if this method is called outside of a
+    ///        callout.
+    ParkingLotPtr getParkingLot() const;
+
     /// @brief Access current library handle
     ///
     /// Returns a reference to the current library handle.  This function is
@@ -319,6 +415,40 @@ public:
     std::string getHookName() const;
 
 private:
+    /// @brief Check whether an argument is present
+    ///
+    /// @param index Index of the argument (can be invalid).
+    ///
+    /// @return true if the argument of the index has a value.
+    bool hasArgument(int index) const {
+        return ((index >= 0) &&
+                (static_cast<size_t>(index) < arguments_.size()) &&
+                !arguments_[index].empty());
+    }
+
+    /// @brief Return the slot of an argument
+    ///
+    /// The array of arguments is extended if needed (this can happen if
+    /// an argument was registered after the handle was created).
+    ///
+    /// @param index Index of the argument.
+    ///
+    /// @return Reference to the value of the argument.
+    ///
+    /// @throw NoSuchArgument The index is negative.
+    boost::any& getArgumentSlot(int index) {
+        if ((index < 0) ||
+            (static_cast<size_t>(index) >= arguments_.size())) {
+            extendArguments(index);
+        }
+        return (arguments_[index]);
+    }
+
+    /// @brief Extend the array of arguments to hold the given index
+    ///
+    /// @throw NoSuchArgument The index is negative.
+    void extendArguments(int index);
+
     /// @brief Check index
     ///
     /// Gets the current library index, throwing an exception if it is not set
@@ -363,7 +493,7 @@ private:
     boost::shared_ptr<LibraryManagerCollection> lm_collection_;
 
     /// Collection of arguments passed to the callouts
-    ElementCollection arguments_;
+    ArgumentCollection arguments_;
 
     /// Context collection - there is one entry per library context.
     ContextCollection context_collection_;
@@ -378,6 +508,10 @@ private:
 
     /// "Skip" flag, indicating if the caller should bypass remaining callouts.
     bool skip_;
+
+    /// "Park" flag, indicating if the callouts suspended the processing of
+    /// the packet.
+    bool park_;
 };
 
 /// A shared pointer to a CalloutHandle object.
@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -34,6 +34,7 @@ CalloutManager::CalloutManager(int num_libraries)
     : server_hooks_(ServerHooks::getServerHooks()),
       current_hook_(-1), current_library_(-1),
       hook_vector_(ServerHooks::getServerHooks().getCount()),
+      callouts_present_(hook_vector_.size(), 0),
       library_handle_(this), pre_library_handle_(this, 0),
       post_library_handle_(this, INT_MAX), num_libraries_(num_libraries)
 {
@@ -85,6 +86,7 @@ CalloutManager::registerCallout(const std::string& name, CalloutPtr callout) {
             // current index, so insert the new element ahead of this one.
             hook_vector_[hook_index].insert(i, make_pair(current_library_,
                                                          callout));
+            updatePresence(hook_index);
             return;
         }
     }
@@ -93,6 +95,7 @@ CalloutManager::registerCallout(const std::string& name, CalloutPtr callout) {
     // empty) set of callouts with a library index greater than the current
     // library index.  Inset the callout at the end of the list.
     hook_vector_[hook_index].push_back(make_pair(current_library_, callout));
+    updatePresence(hook_index);
 }
 
 // Check if callouts are present for a given hook index.
@@ -105,8 +108,10 @@ CalloutManager::calloutsPresent(int hook_index) const {
                   " is not valid for the list of registered hooks");
     }
 
-    // Valid, so are there any callouts associated with that hook?
-    return (!hook_vector_[hook_index].empty());
+    // Valid, so are there any callouts associated with that hook?  (The flag
+    // is read as it is now, not as the compiler may have cached it.)
+    return (static_cast<const volatile char&>(callouts_present_[hook_index])
+            != 0);
 }
 
 // Call all the callouts for a given hook.
@@ -114,10 +119,11 @@ CalloutManager::calloutsPresent(int hook_index) const {
 void
 CalloutManager::callCallouts(int hook_index, CalloutHandle& callout_handle) {
 
-    // Clear the "skip" flag so we don't carry state from a previous call.
-    // This is done regardless of whether callouts are present to avoid passing
-    // any state from the previous call of callCallouts().
+    // Clear the "skip" and "park" flags so we don't carry state from a
+    // previous call.  This is done regardless of whether callouts are present
+    // to avoid passing any state from the previous call of callCallouts().
     callout_handle.setSkip(false);
+    callout_handle.setPark(false);
 
     // Only initialize and iterate if there are callouts present.  This check
     // also catches the case of an invalid index.
@@ -209,6 +215,8 @@ CalloutManager::deregisterCallout(const std::string& name, CalloutPtr callout) {
                                                      target)),
                                    hook_vector_[hook_index].end());
 
+    updatePresence(hook_index);
+
     // Return an indication of whether anything was removed.
     bool removed = initial_size != hook_vector_[hook_index].size();
     if (removed) {
@@ -244,6 +252,8 @@ CalloutManager::deregisterAllCallouts(const std::string& name) {
                                                      target)),
                                    hook_vector_[hook_index].end());
 
+    updatePresence(hook_index);
+
     // Return an indication of whether anything was removed.
     bool removed = initial_size != hook_vector_[hook_index].size();
     if (removed) {
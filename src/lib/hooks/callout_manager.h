@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -189,6 +189,10 @@ public:
     ///
     /// @return true if callouts are present, false if not.
     ///
+    /// The check takes no lock: it reads a flag maintained for each hook
+    /// when callouts are registered and deregistered, so it can be done by
+    /// any thread while a callout (dynamically) modifies the callouts.
+    ///
     /// @throw NoSuchHook Given index does not correspond to a valid hook.
     bool calloutsPresent(int hook_index) const;
 
@@ -307,6 +311,16 @@ public:
     //@}
 
 private:
+    /// @brief Update the presence flag of a hook
+    ///
+    /// Called after the callouts on the hook have been modified.
+    ///
+    /// @param hook_index Index of the hook.
+    void updatePresence(int hook_index) {
+        static_cast<volatile char&>(callouts_present_[hook_index]) =
+            !hook_vector_[hook_index].empty();
+    }
+
     /// @brief Check library index
     ///
     /// Ensures that the current library index is valid.  This is called by
@@ -360,6 +374,12 @@ private:
     /// callout registered for that hook.
     std::vector<CalloutVector> hook_vector_;
 
+    /// Flags telling whether callouts are present on each hook (one element
+    /// per hook, non-zero if the CalloutVector of the hook is not empty).
+    /// Unlike the callout vectors, these can be read by other threads while
+    /// the callouts are modified.
+    std::vector<char> callouts_present_;
+
     /// LibraryHandle object user by the callout to access the callout
     /// registration methods on this CalloutManager object.  The object is set
     /// such that the index of the library associated with any operation is
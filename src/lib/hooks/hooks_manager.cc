@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -32,7 +32,7 @@ namespace hooks {
 
 // Constructor
 
-HooksManager::HooksManager() {
+HooksManager::HooksManager() : initialized_(false) {
 }
 
 // Return reference to singleton hooks manager.
@@ -43,7 +43,8 @@ HooksManager::getHooksManager() {
     return (manager);
 }
 
-// Are callouts present?
+// Are callouts present?  Once initialized, this only reads the presence flag
+// of the hook, without taking any lock.
 
 bool
 HooksManager::calloutsPresentInternal(int index) {
@@ -60,6 +61,7 @@ HooksManager::calloutsPresent(int index) {
 
 void
 HooksManager::callCalloutsInternal(int index, CalloutHandle& handle) {
+    bundy::util::thread::Mutex::Locker locker(callout_mutex_);
     conditionallyInitialize();
     return (callout_manager_->callCallouts(index, handle));
 }
@@ -84,6 +86,8 @@ HooksManager::loadLibrariesInternal(const std::vector<std::string>& libraries) {
     if (status) {
         // ... and obtain the callout manager for them if successful.
         callout_manager_ = lm_collection_->getCalloutManager();
+        __sync_synchronize();
+        initialized_ = true;
     } else {
         // Unable to load libraries, reset to state before this function was
         // called.
@@ -104,11 +108,17 @@ HooksManager::loadLibraries(const std::vector<std::string>& libraries) {
 
 void
 HooksManager::unloadLibrariesInternal() {
+    // The callouts which would have unparked the parked objects are going
+    // away.
+    clearParkingLotsInternal();
+
     // The order of deletion does not matter here, as each library manager
     // holds its own pointer to the callout manager.  However, we may as
     // well delete the library managers first: if there are no other references
     // to the callout manager, the second statement will delete it, which may
     // ease debugging.
+    initialized_ = false;
+    __sync_synchronize();
     lm_collection_.reset();
     callout_manager_.reset();
 }
@@ -144,10 +154,63 @@ HooksManager::getLibraryNames() {
     return (getHooksManager().getLibraryNamesInternal());
 }
 
+// Return the parking lot of a hook, creating it if needed.
+
+ParkingLotPtr
+HooksManager::getParkingLotInternal(int index) {
+    if ((index < 0) ||
+        (index >= ServerHooks::getServerHooks().getCount())) {
+        bundy_throw(NoSuchHook, "hook index " << index <<
+                    " is not valid for the parking lots");
+    }
+
+    bundy::util::thread::Mutex::Locker locker(parking_mutex_);
+    if (index >= static_cast<int>(parking_lots_.size())) {
+        parking_lots_.resize(index + 1);
+    }
+    if (!parking_lots_[index]) {
+        parking_lots_[index].reset(new ParkingLot());
+    }
+    return (parking_lots_[index]);
+}
+
+ParkingLotPtr
+HooksManager::getParkingLot(int index) {
+    return (getHooksManager().getParkingLotInternal(index));
+}
+
+// Drop the parked objects.  The lots themselves are kept, as callouts or
+// the server may hold pointers to them.
+
+void
+HooksManager::clearParkingLotsInternal() {
+    std::vector<ParkingLotPtr> lots;
+    {
+        bundy::util::thread::Mutex::Locker locker(parking_mutex_);
+        lots = parking_lots_;
+    }
+    for (size_t i = 0; i < lots.size(); ++i) {
+        if (lots[i]) {
+            lots[i]->clear();
+        }
+    }
+}
+
+void
+HooksManager::clearParkingLots() {
+    getHooksManager().clearParkingLotsInternal();
+}
+
 // Perform conditional initialization if nothing is loaded.
 
 void
 HooksManager::performConditionalInitialization() {
+    bundy::util::thread::Mutex::Locker locker(init_mutex_);
+
+    // Another thread may have done it while we were waiting.
+    if (initialized_) {
+        return;
+    }
 
     // Nothing present, so create the collection with any empty set of
     // libraries, and get the CalloutManager.
@@ -156,6 +219,10 @@ HooksManager::performConditionalInitialization() {
     lm_collection_->loadLibraries();
 
     callout_manager_ = lm_collection_->getCalloutManager();
+
+    // Publish them only once they are complete.
+    __sync_synchronize();
+    initialized_ = true;
 }
 
 // Shell around ServerHooks::registerHook()
@@ -165,6 +232,13 @@ HooksManager::registerHook(const std::string& name) {
     return (ServerHooks::getServerHooks().registerHook(name));
 }
 
+// Shell around ServerHooks::registerArgument()
+
+int
+HooksManager::registerArgument(const std::string& name) {
+    return (ServerHooks::getServerHooks().registerArgument(name));
+}
+
 // Return pre- and post- library handles.
 
 bundy::hooks::LibraryHandle&
@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -15,7 +15,9 @@
 #ifndef HOOKS_MANAGER_H
 #define HOOKS_MANAGER_H
 
+#include <hooks/parking_lot.h>
 #include <hooks/server_hooks.h>
+#include <util/threads/sync.h>
 
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
@@ -91,6 +93,10 @@ public:
     /// Checks loaded libraries and returns true if at lease one callout
     /// has been registered by them for the given hook.
     ///
+    /// This is called for every hook of every packet, so it takes no lock
+    /// (it may be called by several threads processing packets at once).
+    /// The libraries must not be loaded or unloaded at the same time.
+    ///
     /// @param index Hooks index for which callouts are checked.
     ///
     /// @return true if callouts are present, false if not.
@@ -171,6 +177,42 @@ public:
     ///         registered.
     static int registerHook(const std::string& name);
 
+    /// @brief Register callout argument
+    ///
+    /// This is a convenience shell around the
+    /// ServerHooks::registerArgument() method.  The server registers the
+    /// names of the arguments it passes to the callouts along with the
+    /// hooks, then sets and gets the arguments in the CalloutHandle by
+    /// the returned indexes.
+    ///
+    /// @param name Name of the argument
+    ///
+    /// @return Index of the argument.  The same index is returned if the
+    ///         argument is registered more than once.
+    static int registerArgument(const std::string& name);
+
+    /// @brief Return the parking lot of a hook
+    ///
+    /// Returns the lot holding the objects (packets) whose processing was
+    /// suspended by the callouts of the given hook (see @c ParkingLot).
+    /// The lot is created when first requested.
+    ///
+    /// The parked objects are dropped when libraries are loaded or
+    /// unloaded, as the callouts which would have unparked them are gone.
+    ///
+    /// @param index Index of the hook.
+    ///
+    /// @return Pointer to the parking lot of the hook.
+    /// @throw NoSuchHook Given index does not correspond to a valid hook.
+    static ParkingLotPtr getParkingLot(int index);
+
+    /// @brief Drop all parked objects
+    ///
+    /// Clears the parking lots of all hooks, without resuming the
+    /// processing of the objects.  A server calls this when it is
+    /// destroyed, as the functions resuming the processing refer to it.
+    static void clearParkingLots();
+
     /// @brief Return list of loaded libraries
     ///
     /// Returns the names of the loaded libraries.
@@ -274,6 +316,16 @@ private:
     /// @return List of loaded library names.
     std::vector<std::string> getLibraryNamesInternal() const;
 
+    /// @brief Return the parking lot of a hook
+    ///
+    /// @param index Index of the hook.
+    ///
+    /// @return Pointer to the parking lot of the hook.
+    ParkingLotPtr getParkingLotInternal(int index);
+
+    /// @brief Drop all parked objects
+    void clearParkingLotsInternal();
+
     //@}
 
     /// @brief Initialization to No Libraries
@@ -293,10 +345,11 @@ private:
     /// is unitialised, it will initialize it with an "empty set" of libraries.
     ///
     /// For speed, the test of whether initialization is required is done
-    /// in-line here.  The actual initialization is performed in
-    /// performConditionalInitialization().
+    /// in-line here, without a lock.  The actual initialization is performed
+    /// in performConditionalInitialization(), which serializes the threads
+    /// that find the manager uninitialized.
     void conditionallyInitialize() {
-        if (!lm_collection_) {
+        if (!initialized_) {
             performConditionalInitialization();
         }
     }
@@ -308,6 +361,27 @@ private:
 
     /// Callout manager for the set of library managers.
     boost::shared_ptr<CalloutManager> callout_manager_;
+
+    /// Are lm_collection_ and callout_manager_ set?  This is set only after
+    /// they are, so a thread seeing it set can use them without a lock.
+    volatile bool initialized_;
+
+    /// Serializes the conditional initialization.
+    bundy::util::thread::Mutex init_mutex_;
+
+    /// Parking lots of the hooks, by hook index (empty if not created
+    /// yet).
+    std::vector<ParkingLotPtr> parking_lots_;
+
+    /// Protects parking_lots_.
+    bundy::util::thread::Mutex parking_mutex_;
+
+    /// Serializes the calls of the callouts.
+    ///
+    /// The callout manager keeps the hook and library being called in its
+    /// state, so the callouts of a server processing packets in several
+    /// threads are called one thread at a time.
+    bundy::util::thread::Mutex callout_mutex_;
 };
 
 } // namespace util
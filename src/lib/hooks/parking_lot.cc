@@ -0,0 +1,108 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <hooks/parking_lot.h>
+
+using bundy::util::thread::Mutex;
+
+namespace bundy {
+namespace hooks {
+
+bool
+ParkingLot::parkInternal(const void* key, const boost::any& object,
+                         const UnparkCallback& unpark, size_t limit) {
+    Mutex::Locker locker(mutex_);
+    if ((entries_.size() >= limit) || (entries_.count(key) > 0)) {
+        return (false);
+    }
+    Entry& entry = entries_[key];
+    entry.object = object;
+    entry.unpark = unpark;
+    return (true);
+}
+
+bool
+ParkingLot::referenceInternal(const void* key) {
+    Mutex::Locker locker(mutex_);
+    EntryCollection::iterator i = entries_.find(key);
+    if (i == entries_.end()) {
+        return (false);
+    }
+    ++i->second.refcount;
+    return (true);
+}
+
+bool
+ParkingLot::unparkInternal(const void* key) {
+    // The object is held until the unpark function returns, as that
+    // function may not hold it itself.
+    boost::any object;
+    UnparkCallback unpark;
+    {
+        Mutex::Locker locker(mutex_);
+        EntryCollection::iterator i = entries_.find(key);
+        if ((i == entries_.end()) || (i->second.refcount == 0)) {
+            return (false);
+        }
+        if (--i->second.refcount > 0) {
+            return (true);
+        }
+        object.swap(i->second.object);
+        unpark.swap(i->second.unpark);
+        entries_.erase(i);
+    }
+
+    // Resume the processing out of the lock, as it may park other objects.
+    if (unpark) {
+        unpark();
+    }
+    return (true);
+}
+
+bool
+ParkingLot::dropInternal(const void* key) {
+    Entry entry;
+    {
+        Mutex::Locker locker(mutex_);
+        EntryCollection::iterator i = entries_.find(key);
+        if (i == entries_.end()) {
+            return (false);
+        }
+        // The entry is destroyed out of the lock, as the destruction of
+        // the unpark function may release the last reference to objects
+        // using the lot.
+        entry.object.swap(i->second.object);
+        entry.unpark.swap(i->second.unpark);
+        entries_.erase(i);
+    }
+    return (true);
+}
+
+size_t
+ParkingLot::size() const {
+    Mutex::Locker locker(mutex_);
+    return (entries_.size());
+}
+
+void
+ParkingLot::clear() {
+    EntryCollection entries;
+    {
+        Mutex::Locker locker(mutex_);
+        entries.swap(entries_);
+    }
+}
+
+} // namespace hooks
+} // namespace bundy
@@ -0,0 +1,168 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef PARKING_LOT_H
+#define PARKING_LOT_H
+
+#include <util/threads/sync.h>
+
+#include <boost/any.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+
+namespace bundy {
+namespace hooks {
+
+/// @brief Objects whose processing is suspended by the callouts
+///
+/// A callout which can't complete its work at once (it waits for the answer
+/// of an external server, for instance) may ask the server to suspend the
+/// processing of the object it was called for - the packet - instead of
+/// blocking the server until it can.  The suspended ("parked") objects are
+/// held in the parking lot of the hook, and their processing is resumed
+/// when the callout lets them go ("unparks" them).
+///
+/// The server parks the object with the function resuming its processing
+/// before calling the callouts, so a callout may unpark it before it
+/// returns.  A callout which keeps the object parked takes a reference on
+/// it with reference(), sets the "park" flag of the CalloutHandle and
+/// calls unpark() once it is done with it.  When the last reference is
+/// released, the object is removed from the lot and its processing
+/// resumed by the function given by the server.  If the callouts don't
+/// set the "park" flag, the server removes the object from the lot with
+/// drop() and goes on with its processing at once.
+///
+/// The objects are identified by their address, so they are passed as
+/// shared pointers (the lot holds a copy of the pointer while the object is
+/// parked).  The lot may be used by several threads at once.
+class ParkingLot : public boost::noncopyable {
+public:
+    /// @brief Function resuming the processing of an unparked object
+    typedef boost::function<void()> UnparkCallback;
+
+    /// @brief Constructor
+    ParkingLot() {}
+
+    /// @brief Parks an object
+    ///
+    /// Called by the server before it calls the callouts which may suspend
+    /// the processing of the object.
+    ///
+    /// @param object Object to park.
+    /// @param unpark Function called when the object is unparked.  It is
+    ///        called by the thread calling unpark(), out of any lock of the
+    ///        lot.
+    /// @param limit Maximum number of objects in the lot.
+    ///
+    /// @return false if the object could not be parked because the lot
+    ///         already holds limit objects or the object is already parked,
+    ///         true otherwise.
+    template <typename T>
+    bool park(const boost::shared_ptr<T>& object, const UnparkCallback& unpark,
+              size_t limit) {
+        return (parkInternal(object.get(), boost::any(object), unpark, limit));
+    }
+
+    /// @brief Takes a reference on a parked object
+    ///
+    /// Called by a callout keeping the object parked until it calls
+    /// unpark().
+    ///
+    /// @param object Parked object.
+    ///
+    /// @return false if the object is not parked (so the callout can't keep
+    ///         it), true otherwise.
+    template <typename T>
+    bool reference(const boost::shared_ptr<T>& object) {
+        return (referenceInternal(object.get()));
+    }
+
+    /// @brief Releases a reference on a parked object
+    ///
+    /// Once the last reference is released, the object is removed from the
+    /// lot and the unpark function given to park() is called.
+    ///
+    /// @param object Parked object.
+    ///
+    /// @return false if the object is not parked or has no reference (its
+    ///         processing was not suspended), true otherwise.
+    template <typename T>
+    bool unpark(const boost::shared_ptr<T>& object) {
+        return (unparkInternal(object.get()));
+    }
+
+    /// @brief Removes an object from the lot
+    ///
+    /// The object is removed whatever its references and the unpark
+    /// function is not called: its processing is either going on (if the
+    /// callouts didn't keep it parked) or abandoned.
+    ///
+    /// @param object Parked object.
+    ///
+    /// @return false if the object was not parked, true otherwise.
+    template <typename T>
+    bool drop(const boost::shared_ptr<T>& object) {
+        return (dropInternal(object.get()));
+    }
+
+    /// @brief Returns the number of parked objects
+    size_t size() const;
+
+    /// @brief Removes all the objects from the lot
+    ///
+    /// Their unpark functions are not called.
+    void clear();
+
+private:
+    /// @brief Parked object
+    struct Entry {
+        Entry() : refcount(0) {}
+        /// Copy of the pointer to the object, keeping it in existence.
+        boost::any object;
+        /// Function resuming the processing of the object.
+        UnparkCallback unpark;
+        /// References taken by the callouts.
+        int refcount;
+    };
+
+    /// Map of the parked objects, by their addresses.
+    typedef std::map<const void*, Entry> EntryCollection;
+
+    //@{
+    /// The following methods do the work of the above templates, the
+    /// object being identified by its address.
+    bool parkInternal(const void* key, const boost::any& object,
+                      const UnparkCallback& unpark, size_t limit);
+    bool referenceInternal(const void* key);
+    bool unparkInternal(const void* key);
+    bool dropInternal(const void* key);
+    //@}
+
+    /// Parked objects.
+    EntryCollection entries_;
+
+    /// Protects entries_.
+    mutable bundy::util::thread::Mutex mutex_;
+};
+
+/// A shared pointer to a ParkingLot object.
+typedef boost::shared_ptr<ParkingLot> ParkingLotPtr;
+
+} // namespace hooks
+} // namespace bundy
+
+#endif // PARKING_LOT_H
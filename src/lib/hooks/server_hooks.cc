@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -16,6 +16,7 @@
 #include <hooks/hooks_log.h>
 #include <hooks/server_hooks.h>
 
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -37,7 +38,7 @@ namespace hooks {
 // point, the logging system is not initialized, so messages are unable to
 // be output.
 
-ServerHooks::ServerHooks() {
+ServerHooks::ServerHooks() : argument_count_(0) {
     initialize();
 }
 
@@ -146,6 +147,52 @@ ServerHooks::getHookNames() const {
     return (names);
 }
 
+// Register a callout argument.  As with the hooks, the index is the number of
+// arguments registered before; an argument already registered keeps its index.
+
+int
+ServerHooks::registerArgument(const string& name) {
+    bundy::util::thread::Mutex::Locker locker(argument_mutex_);
+
+    const int index = argument_names_.size();
+    pair<map<string, int>::iterator, bool> result =
+        arguments_.insert(make_pair(name, index));
+    if (!result.second) {
+        return (result.first->second);
+    }
+    argument_names_.push_back(name);
+
+    // Make the argument visible to the readers of the count only now.
+    __sync_synchronize();
+    argument_count_ = argument_names_.size();
+
+    return (index);
+}
+
+// Find the index associated with an argument name.
+
+int
+ServerHooks::getArgumentIndex(const string& name) const {
+    bundy::util::thread::Mutex::Locker locker(argument_mutex_);
+
+    map<string, int>::const_iterator i = arguments_.find(name);
+    return (i == arguments_.end() ? -1 : i->second);
+}
+
+// Find the name associated with an argument index.
+
+string
+ServerHooks::getArgumentName(int index) const {
+    bundy::util::thread::Mutex::Locker locker(argument_mutex_);
+
+    if ((index < 0) ||
+        (static_cast<size_t>(index) >= argument_names_.size())) {
+        bundy_throw(OutOfRange, "argument index " << index <<
+                  " is not recognised");
+    }
+    return (argument_names_[index]);
+}
+
 // Return global ServerHooks object
 
 ServerHooks&
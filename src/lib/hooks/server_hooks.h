@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -16,6 +16,7 @@
 #define SERVER_HOOKS_H
 
 #include <exceptions/exceptions.h>
+#include <util/threads/sync.h>
 
 #include <boost/noncopyable.hpp>
 
@@ -134,6 +135,62 @@ public:
     /// @return Vector of strings holding hook names.
     std::vector<std::string> getHookNames() const;
 
+    /// @brief Register a callout argument
+    ///
+    /// Callout arguments are held by the CalloutHandle in an array, the
+    /// slot of each argument being given by the index assigned to its name
+    /// here.  The server-side code registers the names of the arguments it
+    /// passes (in the same way as the hooks, using static initialization)
+    /// and uses the indexes to set and get the arguments, so no name has
+    /// to be looked up while a packet is processed.
+    ///
+    /// Unlike a hook, an argument can be registered more than once, as the
+    /// same argument is usually passed to several hooks: the index assigned
+    /// on the first registration is returned.  Arguments accessed by name
+    /// (e.g. by the callouts) are registered on the first access.
+    ///
+    /// The argument registrations are not affected by reset(), as the
+    /// indexes may be held by the server-side code.  This method may be
+    /// called by several threads at once.
+    ///
+    /// @param name Name of the argument
+    ///
+    /// @return Index of the argument (greater than or equal to zero).
+    int registerArgument(const std::string& name);
+
+    /// @brief Get argument index
+    ///
+    /// Returns the index of a callout argument.  This may be called by
+    /// several threads at once.
+    ///
+    /// @param name Name of the argument
+    ///
+    /// @return Index of the argument, or -1 if no argument of that name
+    ///         has been registered.
+    int getArgumentIndex(const std::string& name) const;
+
+    /// @brief Get argument name
+    ///
+    /// Returns the name of a callout argument given the index.  This may be
+    /// called by several threads at once.
+    ///
+    /// @param index Index of the argument
+    ///
+    /// @return Name of the argument.
+    ///
+    /// @throw bundy::OutOfRange if the argument index is invalid.
+    std::string getArgumentName(int index) const;
+
+    /// @brief Return number of callout arguments
+    ///
+    /// Returns the total number of callout arguments registered, which is
+    /// the size of the array of arguments a CalloutHandle needs.
+    ///
+    /// @return Number of arguments registered.
+    int getArgumentCount() const {
+        return (argument_count_);
+    }
+
     /// @brief Return ServerHooks object
     ///
     /// Returns the global ServerHooks object.
@@ -175,6 +232,19 @@ private:
     /// simpler than using a multi-indexed container.)
     HookCollection  hooks_;                 ///< Hook name/index collection
     InverseHookCollection inverse_hooks_;   ///< Hook index/name collection
+
+    /// Argument name/index collection.
+    std::map<std::string, int> arguments_;
+
+    /// Argument names, by index.
+    std::vector<std::string> argument_names_;
+
+    /// Number of registered arguments.  This is read without the mutex, so
+    /// it is updated only after the argument has been registered.
+    volatile int argument_count_;
+
+    /// Protects the argument collections.
+    mutable bundy::util::thread::Mutex argument_mutex_;
 };
 
 } // namespace util
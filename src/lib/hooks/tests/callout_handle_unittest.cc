@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -307,6 +307,56 @@ TEST_F(CalloutHandleTest, DeleteAllArguments) {
     EXPECT_THROW(handle.getArgument("four", value), NoSuchArgument);
 }
 
+// Test that the arguments can be accessed by index as well as by name.
+
+TEST_F(CalloutHandleTest, ArgumentIndexes) {
+    const int alpha = ServerHooks::getServerHooks().
+        registerArgument("test_index_alpha");
+
+    CalloutHandle handle(getCalloutManager());
+
+    int value = 0;
+    EXPECT_THROW(handle.getArgument(alpha, value), NoSuchArgument);
+
+    // What is set by index is got by name and vice versa.
+    handle.setArgument(alpha, 42);
+    handle.getArgument("test_index_alpha", value);
+    EXPECT_EQ(42, value);
+
+    handle.setArgument("test_index_alpha", 43);
+    handle.getArgument(alpha, value);
+    EXPECT_EQ(43, value);
+
+    // An argument first set by name (so registered after the handle was
+    // created) can be accessed by its index too.
+    handle.setArgument("test_index_beta", 44);
+    const int beta = ServerHooks::getServerHooks().
+        getArgumentIndex("test_index_beta");
+    ASSERT_LE(0, beta);
+    handle.getArgument(beta, value);
+    EXPECT_EQ(44, value);
+
+    vector<string> expected_names;
+    expected_names.push_back("test_index_alpha");
+    expected_names.push_back("test_index_beta");
+    EXPECT_TRUE(expected_names == handle.getArgumentNames());
+
+    // Deleting by index.
+    handle.deleteArgument(alpha);
+    EXPECT_THROW(handle.getArgument(alpha, value), NoSuchArgument);
+    EXPECT_THROW(handle.getArgument("test_index_alpha", value),
+                 NoSuchArgument);
+    handle.deleteAllArguments();
+    EXPECT_THROW(handle.getArgument(beta, value), NoSuchArgument);
+    EXPECT_TRUE(handle.getArgumentNames().empty());
+
+    // Invalid indexes.
+    EXPECT_THROW(handle.setArgument(-1, value), NoSuchArgument);
+    EXPECT_THROW(handle.getArgument(-1, value), NoSuchArgument);
+    EXPECT_THROW(handle.getArgument(beta + 1000, value), NoSuchArgument);
+    EXPECT_NO_THROW(handle.deleteArgument(beta + 1000));
+}
+
 // Test the "skip" flag.
 
 TEST_F(CalloutHandleTest, SkipFlag) {
@@ -19,6 +19,7 @@
 #include <hooks/tests/common_test_class.h>
 #include <hooks/tests/test_libraries.h>
 
+#include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <gtest/gtest.h>
 
@@ -374,6 +375,70 @@ TEST_F(HooksManagerTest, PrePostCalloutTest) {
     EXPECT_EQ(-15, result);
 }
 
+namespace {
+
+// Callout keeping the "object" argument parked.
+int
+testParkCallout(CalloutHandle& handle) {
+    boost::shared_ptr<int> object;
+    handle.getArgument("object", object);
+    if (handle.getParkingLot()->reference(object)) {
+        handle.setPark(true);
+    }
+    return (0);
+}
+
+// Unpark function counting its calls.
+void
+countUnpark(int* count) {
+    ++*count;
+}
+
+}
+
+// Checks the parking lots of the hooks and the "park" flag.
+
+TEST_F(HooksManagerTest, ParkingLot) {
+    ParkingLotPtr lot = HooksManager::getParkingLot(hookpt_one_index_);
+    ASSERT_TRUE(lot);
+    EXPECT_EQ(lot, HooksManager::getParkingLot(hookpt_one_index_));
+    EXPECT_NE(lot, HooksManager::getParkingLot(hookpt_two_index_));
+    EXPECT_THROW(HooksManager::getParkingLot(-1), NoSuchHook);
+    EXPECT_THROW(HooksManager::getParkingLot(
+                     ServerHooks::getServerHooks().getCount()), NoSuchHook);
+
+    HooksManager::preCalloutsLibraryHandle().registerCallout("hookpt_one",
+                                                             testParkCallout);
+
+    // The object is parked before the callouts are called; the callout
+    // keeps it parked.
+    int count = 0;
+    boost::shared_ptr<int> object(new int(42));
+    ASSERT_TRUE(lot->park(object, boost::bind(countUnpark, &count), 10));
+    CalloutHandlePtr handle = HooksManager::createCalloutHandle();
+    handle->setArgument("object", object);
+    HooksManager::callCallouts(hookpt_one_index_, *handle);
+    EXPECT_TRUE(handle->getPark());
+    EXPECT_EQ(1, lot->size());
+    EXPECT_EQ(0, count);
+
+    // The flag is not carried to the next call.
+    HooksManager::callCallouts(hookpt_two_index_, *handle);
+    EXPECT_FALSE(handle->getPark());
+
+    // Unparking the object resumes its processing.
+    EXPECT_TRUE(lot->unpark(object));
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(0, lot->size());
+
+    // Loading libraries drops the parked objects.
+    ASSERT_TRUE(lot->park(object, boost::bind(countUnpark, &count), 10));
+    EXPECT_TRUE(HooksManager::loadLibraries(vector<string>()));
+    EXPECT_EQ(0, lot->size());
+    EXPECT_FALSE(lot->unpark(object));
+    EXPECT_EQ(1, count);
+}
+
 // Check that everything works even with no libraries loaded.  First that
 // calloutsPresent() always returns false.
 
@@ -0,0 +1,141 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <hooks/parking_lot.h>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace bundy::hooks;
+using namespace std;
+
+namespace {
+
+typedef boost::shared_ptr<string> StringPtr;
+
+// Unpark function counting its calls.
+void
+countUnpark(int* count) {
+    ++*count;
+}
+
+// Unpark function parking another object in the same lot.
+void
+parkAnother(ParkingLot* lot, StringPtr another, int* count) {
+    ++*count;
+    EXPECT_TRUE(lot->park(another, ParkingLot::UnparkCallback(), 10));
+}
+
+// Checks that an object is parked once and only within the limit.
+
+TEST(ParkingLotTest, Park) {
+    ParkingLot lot;
+    EXPECT_EQ(0, lot.size());
+
+    StringPtr first(new string("first"));
+    StringPtr second(new string("second"));
+    StringPtr third(new string("third"));
+    int count = 0;
+    EXPECT_TRUE(lot.park(first, boost::bind(countUnpark, &count), 2));
+    EXPECT_FALSE(lot.park(first, boost::bind(countUnpark, &count), 2));
+    EXPECT_TRUE(lot.park(second, boost::bind(countUnpark, &count), 2));
+    EXPECT_FALSE(lot.park(third, boost::bind(countUnpark, &count), 2));
+    EXPECT_EQ(2, lot.size());
+
+    // The lot holds the objects.
+    EXPECT_EQ(2, first.use_count());
+
+    // Only parked objects can be referenced or unparked.
+    EXPECT_FALSE(lot.reference(third));
+    EXPECT_FALSE(lot.unpark(third));
+    EXPECT_FALSE(lot.drop(third));
+    EXPECT_EQ(0, count);
+}
+
+// Checks that the unpark function is called when the last reference is
+// released.
+
+TEST(ParkingLotTest, Unpark) {
+    ParkingLot lot;
+    StringPtr object(new string("object"));
+    int count = 0;
+    ASSERT_TRUE(lot.park(object, boost::bind(countUnpark, &count), 10));
+
+    // Two callouts keep the object parked.
+    EXPECT_TRUE(lot.reference(object));
+    EXPECT_TRUE(lot.reference(object));
+
+    EXPECT_TRUE(lot.unpark(object));
+    EXPECT_EQ(0, count);
+    EXPECT_EQ(1, lot.size());
+
+    EXPECT_TRUE(lot.unpark(object));
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(0, lot.size());
+    EXPECT_EQ(1, object.use_count());
+
+    // It is gone.
+    EXPECT_FALSE(lot.unpark(object));
+    EXPECT_EQ(1, count);
+
+    // An object without reference can't be unparked.
+    ASSERT_TRUE(lot.park(object, boost::bind(countUnpark, &count), 10));
+    EXPECT_FALSE(lot.unpark(object));
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(1, lot.size());
+}
+
+// Checks that the unpark function may use the lot.
+
+TEST(ParkingLotTest, UnparkPark) {
+    ParkingLot lot;
+    StringPtr object(new string("object"));
+    StringPtr another(new string("another"));
+    int count = 0;
+    ASSERT_TRUE(lot.park(object, boost::bind(parkAnother, &lot, another,
+                                             &count), 10));
+    ASSERT_TRUE(lot.reference(object));
+    EXPECT_TRUE(lot.unpark(object));
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(1, lot.size());
+    EXPECT_TRUE(lot.drop(another));
+}
+
+// Checks that dropped objects are not unparked.
+
+TEST(ParkingLotTest, Drop) {
+    ParkingLot lot;
+    StringPtr first(new string("first"));
+    StringPtr second(new string("second"));
+    int count = 0;
+    ASSERT_TRUE(lot.park(first, boost::bind(countUnpark, &count), 10));
+    ASSERT_TRUE(lot.park(second, boost::bind(countUnpark, &count), 10));
+    EXPECT_TRUE(lot.reference(first));
+
+    EXPECT_TRUE(lot.drop(first));
+    EXPECT_EQ(1, lot.size());
+    EXPECT_EQ(1, first.use_count());
+    EXPECT_FALSE(lot.unpark(first));
+
+    lot.clear();
+    EXPECT_EQ(0, lot.size());
+    EXPECT_EQ(1, second.use_count());
+    EXPECT_FALSE(lot.unpark(second));
+    EXPECT_EQ(0, count);
+}
+
+}
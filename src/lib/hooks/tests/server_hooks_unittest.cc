@@ -1,4 +1,4 @@
-// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2013-2014  Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -175,4 +175,38 @@ TEST(ServerHooksTest, HookCount) {
     EXPECT_EQ(6, hooks.getCount());
 }
 
+// Check the registration of callout arguments.
+
+TEST(ServerHooksTest, RegisterArguments) {
+    ServerHooks& hooks = ServerHooks::getServerHooks();
+
+    // Arguments are registered once for the process (and other tests may
+    // have registered some), so only the relations between the indexes
+    // are checked.
+    const int count = hooks.getArgumentCount();
+    EXPECT_EQ(-1, hooks.getArgumentIndex("test_argument_alpha"));
+
+    const int alpha = hooks.registerArgument("test_argument_alpha");
+    EXPECT_EQ(count, alpha);
+    EXPECT_EQ(alpha, hooks.getArgumentIndex("test_argument_alpha"));
+    EXPECT_EQ("test_argument_alpha", hooks.getArgumentName(alpha));
+
+    const int beta = hooks.registerArgument("test_argument_beta");
+    EXPECT_EQ(count + 1, beta);
+    EXPECT_EQ(count + 2, hooks.getArgumentCount());
+
+    // Registering an argument again returns the same index.
+    EXPECT_EQ(alpha, hooks.registerArgument("test_argument_alpha"));
+    EXPECT_EQ(count + 2, hooks.getArgumentCount());
+
+    // Invalid indexes have no name.
+    EXPECT_THROW(hooks.getArgumentName(-1), bundy::OutOfRange);
+    EXPECT_THROW(hooks.getArgumentName(count + 2), bundy::OutOfRange);
+
+    // The arguments are kept on reset, as the server holds the indexes.
+    hooks.reset();
+    EXPECT_EQ(beta, hooks.getArgumentIndex("test_argument_beta"));
+    EXPECT_EQ(count + 2, hooks.getArgumentCount());
+}
+
 } // Anonymous namespace
@@ -0,0 +1,244 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "config.h"
+
+#include "epoch.h"
+#include "sync.h"
+
+#include <exceptions/exceptions.h>
+
+#include <new>
+#include <cstring>
+#include <cassert>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace bundy {
+namespace util {
+namespace thread {
+
+namespace {
+
+// State of a reader thread.  The epoch is written by the owner thread only
+// and read by the writer; the other fields are private to the owner thread
+// (in_use is also set by the registering thread while holding the mutex).
+struct ReaderSlot {
+    ReaderSlot() : epoch(0), depth(0), locker(NULL), in_use(1), next(NULL) {}
+
+    // The global epoch when the outermost read section was entered, or 0
+    // if the thread is not in a read section.  The global epoch is always
+    // odd, so it can't be confused with 0.
+    volatile unsigned long epoch;
+    // Nesting level of the read sections.
+    unsigned int depth;
+    // Held while the (outermost) read section had to wait for an exclusive
+    // section, to keep off the next one until the read section is left.
+    Mutex::Locker* locker;
+    // 0 if the owner thread has exited and the slot can be reused.
+    volatile int in_use;
+    ReaderSlot* next;
+    // Keep the slots of different threads in separate cache lines.
+    char padding_[64];
+};
+
+// Wait a bit for readers to make progress
+inline void
+yieldToReaders() {
+    sched_yield();
+}
+
+}
+
+class EpochManager::Impl {
+public:
+    Impl() : slots(NULL), epoch(1), excluding(0) {
+        const int result = pthread_key_create(&key, &Impl::releaseSlot);
+        if (result != 0) {
+            bundy_throw(bundy::InvalidOperation, std::strerror(result));
+        }
+    }
+
+    ~Impl() {
+        const int result = pthread_key_delete(key);
+        assert(result == 0);
+        while (slots != NULL) {
+            ReaderSlot* slot = slots;
+            slots = slot->next;
+            assert(slot->depth == 0);
+            delete slot;
+        }
+    }
+
+    // Called on the exit of a thread that used the manager
+    static void releaseSlot(void* slot) {
+        __sync_synchronize();
+        static_cast<ReaderSlot*>(slot)->in_use = 0;
+    }
+
+    // Returns the slot of the calling thread, NULL if it has none yet.
+    ReaderSlot* getSlot() const {
+        return (static_cast<ReaderSlot*>(pthread_getspecific(key)));
+    }
+
+    // Find or create the slot of the calling thread.
+    ReaderSlot* registerSlot() {
+        ReaderSlot* slot = getSlot();
+        if (slot != NULL) {
+            return (slot);
+        }
+
+        Mutex::Locker locker(mutex);
+        for (slot = slots; slot != NULL; slot = slot->next) {
+            if (slot->in_use == 0) {
+                slot->in_use = 1;
+                break;
+            }
+        }
+        if (slot == NULL) {
+            slot = new ReaderSlot;
+            slot->next = slots;
+            // The slots are traversed without the lock, so the new one must
+            // be complete before it's linked.
+            EpochManager::publish(slots, slot);
+        }
+        const int result = pthread_setspecific(key, slot);
+        if (result != 0) {
+            slot->in_use = 0;
+            throw std::bad_alloc();
+        }
+        return (slot);
+    }
+
+    // Throw if the calling thread would wait for itself
+    void checkNotReading(const char* what) const {
+        const ReaderSlot* slot = getSlot();
+        if (slot != NULL && slot->depth > 0) {
+            bundy_throw(bundy::InvalidOperation,
+                        what << " within a read section");
+        }
+    }
+
+    pthread_key_t key;
+    // Slots of all threads that used the manager, linked from the newest.
+    // Slots are only added while the manager exists.
+    ReaderSlot* volatile slots;
+    // Protects the registration of the slots and exclusive sections.
+    Mutex mutex;
+    volatile unsigned long epoch;
+    // Non 0 while an exclusive section is in progress.
+    volatile int excluding;
+    // The lock of the current exclusive section.
+    boost::scoped_ptr<Mutex::Locker> exclusive_locker;
+};
+
+EpochManager::EpochManager() :
+    impl_(new Impl)
+{}
+
+EpochManager::~EpochManager() {}
+
+void
+EpochManager::enter() {
+    ReaderSlot* slot = impl_->registerSlot();
+    if (slot->depth++ > 0) {
+        return;
+    }
+
+    // Announce the reader first, then check for a writer; the writer does
+    // it the other way around, so at least one of them sees the other.
+    slot->epoch = impl_->epoch;
+    __sync_synchronize();
+    if (impl_->excluding == 0) {
+        return;
+    }
+
+    // An exclusive section is in progress.  Step back so it can proceed,
+    // wait for it to finish and keep off the next one while reading.
+    slot->epoch = 0;
+    __sync_synchronize();
+    try {
+        slot->locker = new Mutex::Locker(impl_->mutex);
+    } catch (...) {
+        --slot->depth;
+        throw;
+    }
+    slot->epoch = impl_->epoch;
+    __sync_synchronize();
+}
+
+void
+EpochManager::leave() {
+    ReaderSlot* slot = impl_->getSlot();
+    assert(slot != NULL && slot->depth > 0);
+    if (--slot->depth > 0) {
+        return;
+    }
+
+    // Complete all reads of the shared data before announcing the exit.
+    __sync_synchronize();
+    slot->epoch = 0;
+    if (slot->locker != NULL) {
+        delete slot->locker;
+        slot->locker = NULL;
+    }
+}
+
+void
+EpochManager::exclude() {
+    impl_->checkNotReading("Exclusive section");
+
+    impl_->exclusive_locker.reset(new Mutex::Locker(impl_->mutex));
+    impl_->excluding = 1;
+    __sync_synchronize();
+    for (const ReaderSlot* slot = impl_->slots; slot != NULL;
+         slot = slot->next) {
+        while (slot->epoch != 0) {
+            yieldToReaders();
+        }
+    }
+}
+
+void
+EpochManager::unexclude() {
+    __sync_synchronize();
+    impl_->excluding = 0;
+    impl_->exclusive_locker.reset();
+}
+
+void
+EpochManager::synchronize() {
+    impl_->checkNotReading("Grace period");
+
+    // Readers that entered their section before the increment have an older
+    // epoch; those entering after it already see everything written
+    // before the call.
+    const unsigned long target = __sync_add_and_fetch(&impl_->epoch, 2);
+    for (const ReaderSlot* slot = impl_->slots; slot != NULL;
+         slot = slot->next) {
+        while (true) {
+            const unsigned long epoch = slot->epoch;
+            // (the difference handles the wraparound of the counter)
+            if (epoch == 0 || static_cast<long>(epoch - target) >= 0) {
+                break;
+            }
+            yieldToReaders();
+        }
+    }
+}
+
+} // namespace thread
+} // namespace util
+} // namespace bundy
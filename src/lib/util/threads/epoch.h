@@ -0,0 +1,161 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef BUNDY_THREAD_EPOCH_H
+#define BUNDY_THREAD_EPOCH_H
+
+#include <exceptions/exceptions.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace bundy {
+namespace util {
+namespace thread {
+
+/// \brief Epoch based protection of data shared with lock-free readers
+///
+/// This is a simple read-copy-update (RCU) mechanism.  Readers enter a
+/// "read section" by creating a \c ReadLocker; within the section they
+/// can use the shared data without taking any lock, as long as the writer
+/// modifies it only in one of the following two ways:
+///
+/// - Replace it: make a new version, publish a pointer to it (with
+///   \c publish()), then call \c synchronize() and only after that release
+///   the old version.  \c synchronize() waits until all read sections that
+///   might still see the old version have been left (a "grace period"),
+///   while new readers already see the new version and are not blocked.
+/// - Modify it in place within an exclusive section (\c WriteLocker).
+///   This makes new readers wait and waits for the current ones to leave,
+///   so it should be used only for short modifications.
+///
+/// Entering and leaving a read section only updates a per-thread slot of
+/// the reader and a memory barrier, so read sections of different threads
+/// don't share any cache lines that are written by the readers.  The slots
+/// are allocated on the first use by each thread and are recycled when the
+/// thread exits.
+///
+/// Read sections can be nested within the same thread.  Neither
+/// \c synchronize() nor \c WriteLocker may be used by a thread within
+/// a read section of the same manager, as they would wait for the thread
+/// itself; they throw \c bundy::InvalidOperation in that case.  Likewise,
+/// a thread must not enter a read section within its own exclusive section.
+///
+/// The writer side is not protected against concurrent writers; if there
+/// can be more than one, they have to be serialized by the caller.
+class EpochManager : boost::noncopyable {
+public:
+    /// \brief Constructor
+    ///
+    /// \throw std::bad_alloc memory allocation failed.
+    /// \throw bundy::InvalidOperation thread specific storage can't be
+    ///     created.
+    EpochManager();
+
+    /// \brief Destructor
+    ///
+    /// No thread may be in a read section of the manager at this point.
+    ~EpochManager();
+
+    /// \brief A read section
+    ///
+    /// The section is entered on construction and left on destruction.
+    class ReadLocker : boost::noncopyable {
+    public:
+        /// \brief Enter the read section
+        ///
+        /// This normally doesn't block; it only does if an exclusive
+        /// section is in progress, until the section is finished.
+        ///
+        /// \throw std::bad_alloc allocation of a reader slot failed (this
+        ///     can only happen for the first read section of a thread).
+        ReadLocker(EpochManager& manager) : manager_(manager) {
+            manager_.enter();
+        }
+
+        /// \brief Leave the read section
+        ~ReadLocker() {
+            manager_.leave();
+        }
+    private:
+        EpochManager& manager_;
+    };
+
+    /// \brief An exclusive section
+    ///
+    /// While the object exists, no reader is in a read section of the
+    /// manager.
+    class WriteLocker : boost::noncopyable {
+    public:
+        /// \brief Enter the exclusive section
+        ///
+        /// This waits for all current readers to leave their sections.
+        ///
+        /// \throw bundy::InvalidOperation the calling thread is in a read
+        ///     section of the manager.
+        WriteLocker(EpochManager& manager) : manager_(manager) {
+            manager_.exclude();
+        }
+
+        /// \brief Leave the exclusive section
+        ~WriteLocker() {
+            manager_.unexclude();
+        }
+    private:
+        EpochManager& manager_;
+    };
+
+    /// \brief Wait for a grace period
+    ///
+    /// This waits until every read section that was entered before the call
+    /// has been left.  Read sections entered during the call don't make it
+    /// wait longer.
+    ///
+    /// \throw bundy::InvalidOperation the calling thread is in a read
+    ///     section of the manager.
+    void synchronize();
+
+    /// \brief Make a new version of a pointer visible to readers
+    ///
+    /// Anything written to the pointed object before the call is visible
+    /// to readers that see the new value of the pointer.
+    ///
+    /// \param target The pointer readers read within read sections.
+    /// \param value The new value of the pointer.
+    template <typename T>
+    static void publish(T* volatile& target, T* value) {
+        __sync_synchronize();
+        target = value;
+        __sync_synchronize();
+    }
+
+private:
+    void enter();
+    void leave();
+    void exclude();
+    void unexclude();
+
+    class Impl;
+    boost::scoped_ptr<Impl> impl_;
+};
+
+} // namespace thread
+} // namespace util
+} // namespace bundy
+
+#endif // BUNDY_THREAD_EPOCH_H
+
+// Local Variables:
+// mode: c++
+// End:
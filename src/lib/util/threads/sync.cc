@@ -24,6 +24,7 @@
 #include <cassert>
 
 #include <pthread.h>
+#include <sys/time.h>
 
 using std::auto_ptr;
 
@@ -246,6 +247,36 @@ CondVar::wait(Mutex& mutex) {
     }
 }
 
+bool
+CondVar::timedWait(Mutex& mutex, size_t msec) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec abstime;
+    abstime.tv_sec = now.tv_sec + msec / 1000;
+    abstime.tv_nsec = now.tv_usec * 1000 + (msec % 1000) * 1000000;
+    if (abstime.tv_nsec >= 1000000000) {
+        ++abstime.tv_sec;
+        abstime.tv_nsec -= 1000000000;
+    }
+#ifdef ENABLE_DEBUG
+    mutex.preUnlockAction(true);    // Only in debug mode
+    const int result = pthread_cond_timedwait(&impl_->cond_,
+                                              &mutex.impl_->mutex, &abstime);
+    mutex.postLockAction();     // Only in debug mode
+#else
+    const int result = pthread_cond_timedwait(&impl_->cond_,
+                                              &mutex.impl_->mutex, &abstime);
+#endif
+    if (result == ETIMEDOUT) {
+        return (false);
+    }
+    if (result != 0) {
+        bundy_throw(bundy::BadValue, "pthread_cond_timedwait failed "
+                    "unexpectedly: " << std::strerror(result));
+    }
+    return (true);
+}
+
 void
 CondVar::signal() {
     const int result = pthread_cond_signal(&impl_->cond_);
@@ -255,6 +286,14 @@ CondVar::signal() {
     assert(result == 0);
 }
 
+void
+CondVar::broadcast() {
+    const int result = pthread_cond_broadcast(&impl_->cond_);
+
+    // Like pthread_cond_signal(), this can only fail if cond_ is invalid.
+    assert(result == 0);
+}
+
 }
 }
 }
@@ -28,6 +28,7 @@
 #include <cstring>
 
 #include <unistd.h>
+#include <sys/time.h>
 #include <signal.h>
 
 using namespace bundy::util::thread;
@@ -173,6 +174,40 @@ TEST_F(CondVarTest, badWait) {
 TEST_F(CondVarTest, emptySignal) {
     // It's okay to call signal when no one waits.
     EXPECT_NO_THROW(condvar_.signal());
+    EXPECT_NO_THROW(condvar_.broadcast());
+}
+
+// Like multiWaits, but a single broadcast wakes up both threads.
+TEST_F(CondVarTest, broadcast) {
+    boost::scoped_ptr<Mutex::Locker> locker(new Mutex::Locker(mutex_));
+    CondVar condvar2;
+    int shared_var = 0;
+    Thread t1(boost::bind(&signalAndWait, &condvar_, &condvar2, &mutex_,
+                          &shared_var));
+    Thread t2(boost::bind(&signalAndWait, &condvar_, &condvar2, &mutex_,
+                          &shared_var));
+    while (shared_var < 2 && !do_exit) {
+        condvar2.wait(mutex_);
+    }
+    ASSERT_FALSE(do_exit);
+    ASSERT_EQ(2, shared_var);
+
+    locker.reset();
+    condvar_.broadcast();
+    t1.wait();
+    t2.wait();
+    EXPECT_EQ(4, shared_var);
+}
+
+TEST_F(CondVarTest, timedWait) {
+    // Nobody signals, so the wait times out.
+    Mutex::Locker locker(mutex_);
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    EXPECT_FALSE(condvar_.timedWait(mutex_, 50));
+    gettimeofday(&end, NULL);
+    EXPECT_LE(40, (end.tv_sec - start.tv_sec) * 1000 +
+              (end.tv_usec - start.tv_usec) / 1000);
 }
 
 }
@@ -0,0 +1,202 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <util/threads/epoch.h>
+#include <util/threads/thread.h>
+#include <util/unittests/check_valgrind.h>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <unistd.h>
+
+using namespace bundy::util::thread;
+
+namespace {
+
+// Time to give another thread to (not) make progress, in microseconds
+const useconds_t wait_time = 100000;
+
+TEST(EpochTest, nested) {
+    EpochManager manager;
+
+    // Without readers there's nothing to wait for
+    manager.synchronize();
+    {
+        EpochManager::WriteLocker writer(manager);
+    }
+
+    {
+        EpochManager::ReadLocker reader1(manager);
+        {
+            EpochManager::ReadLocker reader2(manager);
+            // We would wait for ourselves
+            EXPECT_THROW(manager.synchronize(), bundy::InvalidOperation);
+        }
+        // Still within the outer section
+        EXPECT_THROW(manager.synchronize(), bundy::InvalidOperation);
+        EXPECT_THROW(EpochManager::WriteLocker writer(manager),
+                     bundy::InvalidOperation);
+    }
+
+    // Left the sections, so it's possible again
+    manager.synchronize();
+    EpochManager::WriteLocker writer(manager);
+}
+
+// Enter a read section, and stay there until told to leave
+void
+holdReadSection(EpochManager* manager, volatile bool* entered,
+                volatile bool* release)
+{
+    EpochManager::ReadLocker reader(*manager);
+    *entered = true;
+    while (!*release) {
+        usleep(1000);
+    }
+}
+
+void
+waitGracePeriod(EpochManager* manager, volatile bool* done) {
+    manager->synchronize();
+    *done = true;
+}
+
+// synchronize() waits for a read section that is already in progress.
+TEST(EpochTest, gracePeriod) {
+    EpochManager manager;
+    volatile bool entered = false;
+    volatile bool release = false;
+    volatile bool done = false;
+
+    Thread reader(boost::bind(holdReadSection, &manager, &entered, &release));
+    while (!entered) {
+        usleep(1000);
+    }
+    Thread writer(boost::bind(waitGracePeriod, &manager, &done));
+    usleep(wait_time);
+    EXPECT_FALSE(done);
+
+    // A new read section doesn't block, nor prolongs the grace period
+    {
+        EpochManager::ReadLocker other_reader(manager);
+    }
+
+    release = true;
+    reader.wait();
+    writer.wait();
+    EXPECT_TRUE(done);
+}
+
+void
+enterReadSection(EpochManager* manager, volatile bool* entered) {
+    EpochManager::ReadLocker reader(*manager);
+    *entered = true;
+}
+
+// An exclusive section keeps new readers off until it's finished.
+TEST(EpochTest, exclusive) {
+    EpochManager manager;
+    volatile bool entered = false;
+    boost::shared_ptr<Thread> reader;
+    {
+        EpochManager::WriteLocker writer(manager);
+        reader.reset(new Thread(boost::bind(enterReadSection, &manager,
+                                            &entered)));
+        usleep(wait_time);
+        EXPECT_FALSE(entered);
+    }
+    reader->wait();
+    EXPECT_TRUE(entered);
+}
+
+// The data replaced and released by the writer in the stress test.
+struct Data {
+    Data(int value) : value(value), valid(true) {}
+    ~Data() {
+        valid = false;
+    }
+    int value;
+    volatile bool valid;
+};
+
+void
+readData(EpochManager* manager, Data* volatile* data,
+         volatile bool* started, volatile bool* stop, bool* failed)
+{
+    int last = -1;
+    *started = true;
+    while (!*stop) {
+        EpochManager::ReadLocker reader(*manager);
+        const Data* current = *data;
+        // The data must not be released while we use it, and we must never
+        // see an older version than before.
+        usleep(10);
+        if (!current->valid || current->value < last) {
+            *failed = true;
+        }
+        last = current->value;
+    }
+}
+
+// Replace the data continuously while readers keep using it.
+TEST(EpochTest, stress) {
+    if (bundy::util::unittests::runningOnValgrind()) {
+        return;
+    }
+
+    EpochManager manager;
+    Data* volatile data = new Data(0);
+    volatile bool stop = false;
+    const size_t reader_count = 4;
+    volatile bool started[reader_count] = { false, false, false, false };
+    bool failed[reader_count] = { false, false, false, false };
+
+    std::vector<boost::shared_ptr<Thread> > readers;
+    for (size_t i = 0; i < reader_count; ++i) {
+        readers.push_back(boost::shared_ptr<Thread>(
+            new Thread(boost::bind(readData, &manager, &data, &started[i],
+                                   &stop, &failed[i]))));
+    }
+    for (size_t i = 0; i < reader_count; ++i) {
+        while (!started[i]) {
+            usleep(1000);
+        }
+    }
+    for (int i = 1; i <= 2000; ++i) {
+        Data* old_data = data;
+        EpochManager::publish(data, new Data(i));
+        manager.synchronize();
+        delete old_data;
+        if (i % 100 == 0) {
+            // Modify in place once in a while
+            EpochManager::WriteLocker writer(manager);
+            data->value = ++i;
+        }
+    }
+    stop = true;
+    for (size_t i = 0; i < reader_count; ++i) {
+        readers[i]->wait();
+        EXPECT_FALSE(failed[i]);
+    }
+    delete data;
+}
+
+}
@@ -26,6 +26,7 @@
 /// it. Currently there are at least 3 benchmarks implemented that
 /// take advantage of it:
 /// - MySQL (MySQL_uBenchmark)
+/// - PostgreSQL (PgSQL_uBenchmark)
 /// - SQLite (SQLite_uBenchmark)
 /// - memfile (memfile_uBenchmark)
 class uBenchmark {
@@ -1,4 +1,4 @@
-// Copyright (C) 2012 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012, 2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -15,6 +15,7 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unistd.h>
 #include "memfile_ubench.h"
 
 using namespace std;
@@ -29,6 +30,11 @@ using namespace std;
 /// fflush() and fsync() does.
 ///
 /// IPv4 address is used as a key in the hash.
+///
+/// In the binary format, the records are queued and written (and synced)
+/// by groups of BATCH_SIZE records, as a server writes the records of the
+/// threads changing leases at the same time at once. The benchmark itself
+/// is single-threaded.
 class memfile_LeaseMgr {
 public:
 
@@ -38,11 +44,16 @@ public:
     /// An iterator for Lease4 hash table.
     typedef std::map<uint32_t, Lease4Ptr>::iterator leaseIt;
 
+    /// Number of binary records written at once.
+    static const size_t BATCH_SIZE = 32;
+
     /// @brief The sole memfile lease manager constructor
     ///
     /// @param filename name of the lease file (will be overwritten)
     /// @param sync should operations be
-    memfile_LeaseMgr(const std::string& filename, bool sync);
+    /// @param format format of the lease file
+    memfile_LeaseMgr(const std::string& filename, bool sync,
+                     memfile_uBenchmark::Format format);
 
     /// @brief Destructor (closes file)
     ~memfile_LeaseMgr();
@@ -85,12 +96,33 @@ protected:
     /// @param lease lease to be written
     void writeLease(Lease4Ptr lease);
 
+    /// @brief Writes a lease in the ISC DHCP format.
+    void writeDhcpdLease(Lease4Ptr lease);
+
+    /// @brief Writes a lease as a CSV line.
+    void writeCSVLease(Lease4Ptr lease);
+
+    /// @brief Queues a lease as a binary record.
+    void writeBinaryLease(Lease4Ptr lease);
+
+    /// @brief Writes the queued binary records.
+    void flushRecords();
+
     /// Name of the lease file.
     std::string filename_;
 
     /// should we do flush after each operation?
     bool sync_;
 
+    /// Format of the lease file.
+    memfile_uBenchmark::Format format_;
+
+    /// Binary records queued.
+    std::vector<uint8_t> records_;
+
+    /// Number of binary records queued.
+    size_t record_count_;
+
     /// File handle to the open lease file.
     FILE * file_;
 
@@ -98,8 +130,9 @@ protected:
     IPv4Hash ip4Hash_;
 };
 
-memfile_LeaseMgr::memfile_LeaseMgr(const std::string& filename, bool sync)
-    : filename_(filename), sync_(sync) {
+memfile_LeaseMgr::memfile_LeaseMgr(const std::string& filename, bool sync,
+                                   memfile_uBenchmark::Format format)
+    : filename_(filename), sync_(sync), format_(format), record_count_(0) {
     file_ = fopen(filename.c_str(), "w");
     if (!file_) {
         throw "Failed to create file " + filename;
@@ -108,10 +141,30 @@ memfile_LeaseMgr::memfile_LeaseMgr(const std::string& filename, bool sync)
 }
 
 memfile_LeaseMgr::~memfile_LeaseMgr() {
+    flushRecords();
     fclose(file_);
 }
 
 void memfile_LeaseMgr::writeLease(Lease4Ptr lease) {
+    switch (format_) {
+    case memfile_uBenchmark::FORMAT_CSV:
+        writeCSVLease(lease);
+        break;
+    case memfile_uBenchmark::FORMAT_BINARY:
+        // The records are synced by flushRecords().
+        writeBinaryLease(lease);
+        return;
+    default:
+        writeDhcpdLease(lease);
+    }
+
+    if (sync_) {
+        fflush(file_);
+        fsync(fileno(file_));
+    }
+}
+
+void memfile_LeaseMgr::writeDhcpdLease(Lease4Ptr lease) {
     fprintf(file_, "lease %d {\n  hw-addr ", lease->addr);
     for (std::vector<uint8_t>::const_iterator it = lease->hwaddr.begin();
          it != lease->hwaddr.end(); ++it) {
@@ -129,11 +182,85 @@ void memfile_LeaseMgr::writeLease(Lease4Ptr lease) {
             lease->pool_id, lease->fixed?"true":"false",
             lease->hostname.c_str(), lease->fqdn_fwd?"true":"false",
             lease->fqdn_rev?"true":"false");
+}
+
+void memfile_LeaseMgr::writeCSVLease(Lease4Ptr lease) {
+    // The columns of the CSV lease file of the memfile backend.
+    fprintf(file_, "%d.%d.%d.%d,", lease->addr >> 24,
+            (lease->addr >> 16) & 0xff, (lease->addr >> 8) & 0xff,
+            lease->addr & 0xff);
+    for (std::vector<uint8_t>::const_iterator it = lease->hwaddr.begin();
+         it != lease->hwaddr.end(); ++it) {
+        fprintf(file_, it == lease->hwaddr.begin() ? "%02x" : ":%02x", *it);
+    }
+    fprintf(file_, ",");
+    for (std::vector<uint8_t>::const_iterator it = lease->client_id.begin();
+         it != lease->client_id.end(); ++it) {
+        fprintf(file_, it == lease->client_id.begin() ? "%02x" : ":%02x", *it);
+    }
+    fprintf(file_, ",%d,%d,%d,%d,%d,%s\n", lease->valid_lft,
+            (int)lease->cltt + lease->valid_lft, lease->pool_id,
+            lease->fqdn_fwd ? 1 : 0, lease->fqdn_rev ? 1 : 0,
+            lease->hostname.c_str());
+}
+
+namespace {
+
+// Appends an integer to a record in network byte order.
+void appendUint32(std::vector<uint8_t>& record, uint32_t value) {
+    record.push_back(value >> 24);
+    record.push_back((value >> 16) & 0xff);
+    record.push_back((value >> 8) & 0xff);
+    record.push_back(value & 0xff);
+}
 
+}
+
+void memfile_LeaseMgr::writeBinaryLease(Lease4Ptr lease) {
+    // A record is the length of the lease data, the data and a checksum
+    // (32-bit FNV-1a) of the data.
+    std::vector<uint8_t> data;
+    data.push_back(4);
+    appendUint32(data, lease->addr);
+    data.push_back(lease->hwaddr.size());
+    data.insert(data.end(), lease->hwaddr.begin(), lease->hwaddr.end());
+    data.push_back(lease->client_id.size());
+    data.insert(data.end(), lease->client_id.begin(), lease->client_id.end());
+    appendUint32(data, lease->valid_lft);
+    appendUint32(data, 0);
+    appendUint32(data, lease->cltt);
+    appendUint32(data, lease->pool_id);
+    data.push_back((lease->fqdn_fwd ? 1 : 0) | (lease->fqdn_rev ? 2 : 0));
+    data.push_back(lease->hostname.size() >> 8);
+    data.push_back(lease->hostname.size() & 0xff);
+    data.insert(data.end(), lease->hostname.begin(), lease->hostname.end());
+
+    uint32_t checksum = 2166136261U;
+    for (size_t i = 0; i < data.size(); ++i) {
+        checksum = (checksum ^ data[i]) * 16777619U;
+    }
+    appendUint32(records_, data.size());
+    records_.insert(records_.end(), data.begin(), data.end());
+    appendUint32(records_, checksum);
+
+    if (++record_count_ == BATCH_SIZE) {
+        flushRecords();
+    }
+}
+
+void memfile_LeaseMgr::flushRecords() {
+    if (records_.empty()) {
+        return;
+    }
+    if (write(fileno(file_), &records_[0], records_.size()) !=
+        static_cast<ssize_t>(records_.size())) {
+        throw "Failed to write file " + filename_;
+    }
     if (sync_) {
-        fflush(file_);
-        fsync(fileno(file_));
+        fdatasync(fileno(file_));
     }
+    records_.clear();
+    record_count_ = 0;
 }
 
 bool memfile_LeaseMgr::addLease(Lease4Ptr lease) {
@@ -182,13 +309,21 @@ bool memfile_LeaseMgr::deleteLease(uint32_t addr) {
 memfile_uBenchmark::memfile_uBenchmark(const string& filename,
                                        uint32_t num_iterations,
                                        bool sync,
-                                       bool verbose)
-    :uBenchmark(num_iterations, filename, sync, verbose) {
+                                       bool verbose,
+                                       Format format)
+    :uBenchmark(num_iterations, filename, sync, verbose), format_(format) {
 }
 
 void memfile_uBenchmark::connect() {
+    // Each format has its own file.
+    string filename = dbname_;
+    if (format_ == FORMAT_CSV) {
+        filename += ".csv";
+    } else if (format_ == FORMAT_BINARY) {
+        filename += ".bin";
+    }
     try {
-        leaseMgr_ = new memfile_LeaseMgr(dbname_, sync_);
+        leaseMgr_ = new memfile_LeaseMgr(filename, sync_, format_);
     } catch (const std::string& e) {
         failure(e.c_str());
     }
@@ -335,7 +470,18 @@ void memfile_uBenchmark::deleteLease4Test() {
 }
 
 void memfile_uBenchmark::printInfo() {
-    cout << "Memory db (using std::map) + write-only file." << endl;
+    cout << "Memory db (using std::map) + write-only file";
+    switch (format_) {
+    case FORMAT_CSV:
+        cout << " (CSV)." << endl;
+        break;
+    case FORMAT_BINARY:
+        cout << " (binary records written by groups of "
+             << memfile_LeaseMgr::BATCH_SIZE << ")." << endl;
+        break;
+    default:
+        cout << " (ISC DHCP format)." << endl;
+    }
 }
 
 
@@ -346,11 +492,24 @@ int main(int argc, char * const argv[]) {
     bool sync = true;
     bool verbose = false;
 
-    memfile_uBenchmark bench(filename, num, sync, verbose);
-
-    bench.parseCmdline(argc, argv);
-
-    int result = bench.run();
+    // Run the benchmark for each format of the lease file, with the same
+    // command line parameters.
+    const memfile_uBenchmark::Format formats[] = {
+        memfile_uBenchmark::FORMAT_DHCPD, memfile_uBenchmark::FORMAT_CSV,
+        memfile_uBenchmark::FORMAT_BINARY
+    };
+    int result = 0;
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        memfile_uBenchmark bench(filename, num, sync, verbose, formats[i]);
+
+        optind = 1;
+        bench.parseCmdline(argc, argv);
+
+        result = bench.run();
+        if (result != 0) {
+            break;
+        }
+    }
 
     return (result);
 }
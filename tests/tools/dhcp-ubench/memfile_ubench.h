@@ -54,17 +54,31 @@ class memfile_LeaseMgr;
 /// shared_ptr from boost library. The "database" is implemented in the Lease
 /// Manager (see \ref LeaseMgr in memfile_ubench.cc). All lease changes are
 /// appended to the end of the file, speeding up the process.
+///
+/// The leases can be written in the ISC DHCP format, in CSV lines (as the
+/// memfile backend of the DHCP servers does by default) or in binary
+/// records written by groups (as the binary journal of the backend does
+/// when several threads change leases at the same time).
 class memfile_uBenchmark: public uBenchmark {
 public:
 
+    /// @brief Format of the lease file.
+    enum Format {
+        FORMAT_DHCPD,  /// ISC DHCP lease file
+        FORMAT_CSV,    /// CSV lease file
+        FORMAT_BINARY  /// binary journal, written by groups of records
+    };
+
     /// @brief The sole memfile benchmark constructor.
     ///
     /// @param filename name of the write-only lease file
     /// @param num_iterations number of iterations
     /// @param sync should fsync() be called after every file write?
     /// @param verbose would you like extra logging?
+    /// @param format format of the lease file
     memfile_uBenchmark(const std::string& filename,
-                       uint32_t num_iterations, bool sync, bool verbose);
+                       uint32_t num_iterations, bool sync, bool verbose,
+                       Format format = FORMAT_DHCPD);
 
     /// @brief Prints backend info.
     virtual void printInfo();
@@ -100,4 +114,7 @@ protected:
 
     /// Lease Manager (concrete backend implementation, based on STL maps)
     memfile_LeaseMgr * leaseMgr_;
+
+    /// Format of the lease file
+    Format format_;
 };
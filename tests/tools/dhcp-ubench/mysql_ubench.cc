@@ -1,4 +1,4 @@
-// Copyright (C) 2012 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012, 2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -18,7 +18,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 #include <mysql.h>
+#include <algorithm>
+#include <vector>
 
 #include "benchmark.h"
 #include "mysql_ubench.h"
@@ -28,9 +31,9 @@ using namespace std;
 MySQL_uBenchmark::MySQL_uBenchmark(const string& hostname, const string& user,
                                    const string& pass, const string& db,
                                    uint32_t num_iterations, bool sync,
-                                   bool verbose)
+                                   bool verbose, uint32_t batch_size)
     :uBenchmark(num_iterations, db, sync, verbose, hostname, user, pass),
-     conn_(NULL) {
+     conn_(NULL), batch_size_(batch_size) {
 
 }
 
@@ -92,6 +95,10 @@ void MySQL_uBenchmark::disconnect() {
 }
 
 void MySQL_uBenchmark::createLease4Test() {
+    if (batch_size_ > 1) {
+        createLease4BatchTest();
+        return;
+    }
     if (!conn_) {
         throw "Not connected to MySQL server.";
     }
@@ -501,6 +508,10 @@ void MySQL_uBenchmark::searchLease4Test() {
 }
 
 void MySQL_uBenchmark::updateLease4Test() {
+    if (batch_size_ > 1) {
+        updateLease4BatchTest();
+        return;
+    }
     if (!conn_) {
         throw "Not connected to MySQL server.";
     }
@@ -579,6 +590,10 @@ void MySQL_uBenchmark::updateLease4Test() {
 }
 
 void MySQL_uBenchmark::deleteLease4Test() {
+    if (batch_size_ > 1) {
+        deleteLease4BatchTest();
+        return;
+    }
     if (!conn_) {
         throw "Not connected to MySQL server.";
     }
@@ -649,8 +664,236 @@ void MySQL_uBenchmark::deleteLease4Test() {
     cout << endl;
 }
 
+MYSQL_STMT* MySQL_uBenchmark::batchStatement(MYSQL_STMT* stmt,
+                                             uint32_t& stmt_rows,
+                                             uint32_t rows, const char* head,
+                                             const char* row,
+                                             const char* tail) {
+    if (stmt && (stmt_rows == rows)) {
+        return (stmt);
+    }
+    if (stmt && mysql_stmt_close(stmt)) {
+        failure("Failed to close compiled statement, mysql_stmt_close returned non-zero");
+    }
+
+    string statement = head;
+    for (uint32_t i = 0; i < rows; i++) {
+        if (i > 0) {
+            statement += ",";
+        }
+        statement += row;
+    }
+    statement += tail;
+
+    stmt = mysql_stmt_init(conn_);
+    if (!stmt) {
+        failure("Unable to create compiled statement, mysql_stmt_init() failed");
+    }
+    if (mysql_stmt_prepare(stmt, statement.c_str(), statement.size())) {
+        stmt_failure(stmt, "preparing batch statement (mysql_stmt_prepare())");
+    }
+    stmt_rows = rows;
+    return (stmt);
+}
+
+void MySQL_uBenchmark::executeBatch(MYSQL_STMT* stmt, MYSQL_BIND* bind) {
+    // The statement is a transaction of its own (autocommit is enabled).
+    if (mysql_stmt_bind_param(stmt, bind)) {
+        stmt_failure(stmt, "binding batch parameters (mysql_stmt_bind_param())");
+    }
+    if (mysql_stmt_execute(stmt)) {
+        stmt_failure(stmt, "executing batch statement (mysql_stmt_execute())");
+    }
+    if (verbose_) {
+        cout << ".";
+    }
+}
+
+void MySQL_uBenchmark::createLease4BatchTest() {
+    if (!conn_) {
+        throw "Not connected to MySQL server.";
+    }
+
+    // The same leases as in createLease4Test(), with the same cltt.
+    char hwaddr[20];
+    unsigned long hwaddr_len = 20;
+    char client_id[128];
+    unsigned long client_id_len = 128;
+    uint32_t valid_lft = 1000;
+    uint32_t recycle_time = 7;
+    char cltt[] = "2012-07-11 15:43:00";
+    unsigned long cltt_len = strlen(cltt);
+    uint32_t pool_id = 1000;
+    bool fixed = false;
+    char hostname[] = "foo";
+    unsigned long hostname_len = strlen(hostname);
+    bool fqdn_fwd = true;
+    bool fqdn_rev = true;
+
+    cout << "CREATE:   ";
+
+    for (uint8_t i = 0; i < hwaddr_len; i++) {
+        hwaddr[i] = 'A' + i;
+    }
+    hwaddr[19] = 0;
+    for (uint8_t i = 0; i < client_id_len; i++) {
+        client_id[i] = 33 + i;
+    }
+    client_id[127] = 0;
+
+    // 11 parameters for each lease, only the address changes.
+    vector<uint32_t> addr(batch_size_);
+    vector<MYSQL_BIND> bind(batch_size_ * 11);
+    for (uint32_t row = 0; row < batch_size_; row++) {
+        MYSQL_BIND* lease_bind = &bind[row * 11];
+
+        lease_bind[0].buffer_type = MYSQL_TYPE_LONG;
+        lease_bind[0].buffer = &addr[row];
+
+        lease_bind[1].buffer_type = MYSQL_TYPE_STRING;
+        lease_bind[1].buffer = hwaddr;
+        lease_bind[1].buffer_length = hwaddr_len;
+        lease_bind[1].length = &hwaddr_len;
+
+        lease_bind[2].buffer_type = MYSQL_TYPE_STRING;
+        lease_bind[2].buffer = client_id;
+        lease_bind[2].buffer_length = client_id_len;
+        lease_bind[2].length = &client_id_len;
+
+        lease_bind[3].buffer_type = MYSQL_TYPE_LONG;
+        lease_bind[3].buffer = &valid_lft;
+
+        lease_bind[4].buffer_type = MYSQL_TYPE_LONG;
+        lease_bind[4].buffer = &recycle_time;
+
+        lease_bind[5].buffer_type = MYSQL_TYPE_STRING;
+        lease_bind[5].buffer = cltt;
+        lease_bind[5].buffer_length = cltt_len;
+        lease_bind[5].length = &cltt_len;
+
+        lease_bind[6].buffer_type = MYSQL_TYPE_LONG;
+        lease_bind[6].buffer = &pool_id;
+
+        lease_bind[7].buffer_type = MYSQL_TYPE_TINY;
+        lease_bind[7].buffer = &fixed;
+
+        lease_bind[8].buffer_type = MYSQL_TYPE_STRING;
+        lease_bind[8].buffer = hostname;
+        lease_bind[8].buffer_length = hostname_len;
+        lease_bind[8].length = &hostname_len;
+
+        lease_bind[9].buffer_type = MYSQL_TYPE_TINY;
+        lease_bind[9].buffer = &fqdn_fwd;
+
+        lease_bind[10].buffer_type = MYSQL_TYPE_TINY;
+        lease_bind[10].buffer = &fqdn_rev;
+    }
+
+    MYSQL_STMT* stmt = NULL;
+    uint32_t stmt_rows = 0;
+    uint32_t next = BASE_ADDR4;
+    for (uint32_t i = 0; i < num_; i += batch_size_) {
+        const uint32_t rows = min(batch_size_, num_ - i);
+        for (uint32_t row = 0; row < rows; row++) {
+            addr[row] = ++next;
+        }
+        stmt = batchStatement(stmt, stmt_rows, rows,
+                              "INSERT INTO lease4(addr,hwaddr,client_id,"
+                              "valid_lft,recycle_time,cltt,pool_id,fixed,"
+                              "hostname,fqdn_fwd,fqdn_rev) VALUES",
+                              "(?,?,?,?,?,?,?,?,?,?,?)", "");
+        executeBatch(stmt, &bind[0]);
+    }
+
+    if (stmt && mysql_stmt_close(stmt)) {
+        failure("Failed to close compiled statement, mysql_stmt_close returned non-zero");
+    }
+
+    cout << endl;
+}
+
+void MySQL_uBenchmark::updateLease4BatchTest() {
+    if (!conn_) {
+        throw "Not connected to MySQL server.";
+    }
+
+    cout << "UPDATE:   ";
+
+    // The leases are updated by inserting them again: the existing rows are
+    // updated instead.
+    uint32_t valid_lft = 1002;
+    vector<uint32_t> addr(batch_size_);
+    vector<MYSQL_BIND> bind(batch_size_ * 2);
+    for (uint32_t row = 0; row < batch_size_; row++) {
+        bind[row * 2].buffer_type = MYSQL_TYPE_LONG;
+        bind[row * 2].buffer = &addr[row];
+        bind[row * 2 + 1].buffer_type = MYSQL_TYPE_LONG;
+        bind[row * 2 + 1].buffer = &valid_lft;
+    }
+
+    MYSQL_STMT* stmt = NULL;
+    uint32_t stmt_rows = 0;
+    for (uint32_t i = 0; i < num_; i += batch_size_) {
+        const uint32_t rows = min(batch_size_, num_ - i);
+        for (uint32_t row = 0; row < rows; row++) {
+            addr[row] = BASE_ADDR4 + random() % num_;
+        }
+        stmt = batchStatement(stmt, stmt_rows, rows,
+                              "INSERT INTO lease4(addr,valid_lft,cltt) VALUES",
+                              "(?,?,now())",
+                              " ON DUPLICATE KEY UPDATE "
+                              "valid_lft=VALUES(valid_lft),"
+                              "cltt=VALUES(cltt)");
+        executeBatch(stmt, &bind[0]);
+    }
+
+    if (stmt && mysql_stmt_close(stmt)) {
+        failure("Failed to close compiled statement, mysql_stmt_close returned non-zero");
+    }
+
+    cout << endl;
+}
+
+void MySQL_uBenchmark::deleteLease4BatchTest() {
+    if (!conn_) {
+        throw "Not connected to MySQL server.";
+    }
+
+    cout << "DELETE:   ";
+
+    vector<uint32_t> addr(batch_size_);
+    vector<MYSQL_BIND> bind(batch_size_);
+    for (uint32_t row = 0; row < batch_size_; row++) {
+        bind[row].buffer_type = MYSQL_TYPE_LONG;
+        bind[row].buffer = &addr[row];
+    }
+
+    MYSQL_STMT* stmt = NULL;
+    uint32_t stmt_rows = 0;
+    for (uint32_t i = 0; i < num_; i += batch_size_) {
+        const uint32_t rows = min(batch_size_, num_ - i);
+        for (uint32_t row = 0; row < rows; row++) {
+            addr[row] = BASE_ADDR4 + i + row;
+        }
+        stmt = batchStatement(stmt, stmt_rows, rows,
+                              "DELETE FROM lease4 WHERE addr IN (", "?", ")");
+        executeBatch(stmt, &bind[0]);
+    }
+
+    if (stmt && mysql_stmt_close(stmt)) {
+        failure("Failed to close compiled statement, mysql_stmt_close returned non-zero");
+    }
+
+    cout << endl;
+}
+
 void MySQL_uBenchmark::printInfo() {
     cout << "MySQL client version is " << mysql_get_client_info() << endl;
+    if (batch_size_ > 1) {
+        cout << "Leases written by batches of " << batch_size_ << endl;
+    } else {
+        cout << "Leases written one by one" << endl;
+    }
 }
 
 
@@ -664,11 +907,22 @@ int main(int argc, char * const argv[]) {
     bool sync = true;                   // -s
     bool verbose = true;                // -v
 
-    MySQL_uBenchmark bench(hostname, user, passwd, dbname, num, sync, verbose);
+    // Run the benchmark writing the leases one by one, then by batches, with
+    // the same command line parameters.
+    const uint32_t batch_sizes[] = { 1, 64 };
+    int result = 0;
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); ++i) {
+        MySQL_uBenchmark bench(hostname, user, passwd, dbname, num, sync,
+                               verbose, batch_sizes[i]);
 
-    bench.parseCmdline(argc, argv);
+        optind = 1;
+        bench.parseCmdline(argc, argv);
 
-    int result = bench.run();
+        result = bench.run();
+        if (result != 0) {
+            break;
+        }
+    }
 
     return (result);
 }
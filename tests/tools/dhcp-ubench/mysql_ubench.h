@@ -1,4 +1,4 @@
-// Copyright (C) 2012 Internet Systems Consortium, Inc. ("ISC")
+// Copyright (C) 2012, 2014 Internet Systems Consortium, Inc. ("ISC")
 //
 // Permission to use, copy, modify, and/or distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -20,6 +20,11 @@
 /// That is a specific backend implementation. See \ref uBenchmark class for
 /// detailed explanation of its operations. This class uses MySQL as database
 /// backend.
+///
+/// The leases can be created, updated and deleted one by one or by batches,
+/// each batch being written by a single multi-row statement (as the MySQL
+/// backend of the DHCP servers does in the write-behind mode).  The leases
+/// are always searched one by one.
 class MySQL_uBenchmark: public uBenchmark {
 public:
 
@@ -40,10 +45,11 @@ public:
     /// @param num_iterations number of iterations for basic operations
     /// @param sync synchronous or asynchronous database writes
     /// @param verbose should extra information be logged?
+    /// @param batch_size number of leases written by a statement
     MySQL_uBenchmark(const std::string& hostname, const std::string& user,
                      const std::string& pass, const std::string& db,
                      uint32_t num_iterations, bool sync,
-                     bool verbose);
+                     bool verbose, uint32_t batch_size = 1);
 
     /// @brief Prints MySQL version info.
     virtual void printInfo();
@@ -98,7 +104,41 @@ protected:
     /// @sa failure()
     void stmt_failure(MYSQL_STMT * stmt, const char* operation);
 
+    /// @brief Creates new leases by batches.
+    void createLease4BatchTest();
+
+    /// @brief Updates existing leases by batches.
+    void updateLease4BatchTest();
+
+    /// @brief Deletes existing leases by batches.
+    void deleteLease4BatchTest();
+
+    /// @brief Returns a compiled statement for a batch of leases.
+    ///
+    /// The statement is made of a head, the text for each lease (separated
+    /// by commas) and a tail. If the given statement is not for the number
+    /// of leases, it is closed and a new one is compiled.
+    ///
+    /// @param stmt compiled statement (or NULL)
+    /// @param stmt_rows number of leases of the compiled statement
+    /// @param rows number of leases of the batch
+    /// @param head beginning of the statement
+    /// @param row text for each lease
+    /// @param tail end of the statement
+    MYSQL_STMT* batchStatement(MYSQL_STMT* stmt, uint32_t& stmt_rows,
+                               uint32_t rows, const char* head,
+                               const char* row, const char* tail);
+
+    /// @brief Executes a compiled statement for a batch of leases.
+    ///
+    /// @param stmt compiled statement
+    /// @param bind parameters of the statement
+    void executeBatch(MYSQL_STMT* stmt, MYSQL_BIND* bind);
+
 
     /// Handle to MySQL database connection.
     MYSQL* conn_;
+
+    /// Number of leases written by a statement.
+    uint32_t batch_size_;
 };
@@ -0,0 +1,470 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <libpq-fe.h>
+#include <vector>
+
+#include "benchmark.h"
+#include "pgsql_ubench.h"
+
+using namespace std;
+
+void PgSQL_uBenchmark::Params::addInteger(int64_t value) {
+    if (binary_) {
+        // The binary format of the integers is big endian.
+        char data[sizeof(value)];
+        uint64_t bits = value;
+        for (int i = sizeof(data) - 1; i >= 0; i--) {
+            data[i] = static_cast<char>(bits & 0xff);
+            bits >>= 8;
+        }
+        values_.push_back(string(data, sizeof(data)));
+    } else {
+        ostringstream tmp;
+        tmp << value;
+        values_.push_back(tmp.str());
+    }
+    lengths_.push_back(values_.back().size());
+    formats_.push_back(binary_ ? 1 : 0);
+}
+
+void PgSQL_uBenchmark::Params::addBool(bool value) {
+    if (binary_) {
+        values_.push_back(string(1, value ? 1 : 0));
+    } else {
+        values_.push_back(value ? "t" : "f");
+    }
+    lengths_.push_back(values_.back().size());
+    formats_.push_back(binary_ ? 1 : 0);
+}
+
+void PgSQL_uBenchmark::Params::addBytes(const char* data, size_t len) {
+    if (binary_) {
+        values_.push_back(string(data, len));
+    } else {
+        // The text format of BYTEA is the hexadecimal one.
+        static const char digits[] = "0123456789abcdef";
+        string text = "\\x";
+        for (size_t i = 0; i < len; i++) {
+            text += digits[(data[i] >> 4) & 0xf];
+            text += digits[data[i] & 0xf];
+        }
+        values_.push_back(text);
+    }
+    lengths_.push_back(values_.back().size());
+    formats_.push_back(binary_ ? 1 : 0);
+}
+
+void PgSQL_uBenchmark::Params::addText(const string& value) {
+    // The binary format of the text is the text itself.
+    values_.push_back(value);
+    lengths_.push_back(value.size());
+    formats_.push_back(0);
+}
+
+vector<const char*> PgSQL_uBenchmark::Params::values() const {
+    vector<const char*> values;
+    for (size_t i = 0; i < values_.size(); i++) {
+        values.push_back(values_[i].c_str());
+    }
+    return (values);
+}
+
+PgSQL_uBenchmark::PgSQL_uBenchmark(const string& hostname, const string& user,
+                                   const string& pass, const string& db,
+                                   uint32_t num_iterations, bool sync,
+                                   bool verbose, bool binary,
+                                   uint32_t pipeline_depth)
+    :uBenchmark(num_iterations, db, sync, verbose, hostname, user, pass),
+     conn_(NULL), binary_(binary), pipeline_depth_(pipeline_depth) {
+#ifndef LIBPQ_HAS_PIPELINING
+    // The pipeline mode needs libpq 14 or later.
+    pipeline_depth_ = 1;
+#endif
+    if (pipeline_depth_ == 0) {
+        pipeline_depth_ = 1;
+    }
+}
+
+void PgSQL_uBenchmark::failure(const char* operation) {
+    stringstream tmp;
+    tmp << "Error during " << operation << ": ";
+    if (conn_) {
+        tmp << PQerrorMessage(conn_);
+    }
+    throw tmp.str();
+}
+
+void PgSQL_uBenchmark::connect() {
+    string params = "host='" + hostname_ + "' dbname='" + dbname_ + "'";
+    if (!user_.empty()) {
+        params += " user='" + user_ + "'";
+    }
+    if (!passwd_.empty()) {
+        params += " password='" + passwd_ + "'";
+    }
+
+    conn_ = PQconnectdb(params.c_str());
+    if (!conn_) {
+        failure("initializing PostgreSQL library");
+    }
+    if (PQstatus(conn_) != CONNECTION_OK) {
+        failure("connecting to PostgreSQL server");
+    } else {
+        cout << "PostgreSQL connection established." << endl;
+    }
+
+    const char* queries[] = {
+        "DELETE FROM lease4",
+        sync_ ? "SET synchronous_commit TO on" :
+        "SET synchronous_commit TO off"
+    };
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        PGresult* r = PQexec(conn_, queries[i]);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+            PQclear(r);
+            string q = string("Failed to run query:") + queries[i];
+            failure(q.c_str());
+        }
+        PQclear(r);
+    }
+}
+
+void PgSQL_uBenchmark::disconnect() {
+    if (!conn_) {
+        throw "NULL PostgreSQL connection pointer.";
+    }
+    PQfinish(conn_);
+    conn_ = NULL;
+}
+
+void PgSQL_uBenchmark::prepare(const char* name, const char* statement) {
+    // The server deduces the types of the parameters from the statement.
+    PGresult* r = PQprepare(conn_, name, statement, 0, NULL);
+    if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+        PQclear(r);
+        failure("Failed to prepare statement, PQprepare()");
+    }
+    PQclear(r);
+}
+
+void PgSQL_uBenchmark::send(const char* name, const char* statement,
+                            const Params& params, uint32_t addr) {
+    const vector<const char*> values = params.values();
+    const int result_format = binary_ ? 1 : 0;
+
+    if (pipeline_depth_ == 1) {
+        PGresult* r;
+        if (compiled_stmt_) {
+            r = PQexecPrepared(conn_, name, params.size(), &values[0],
+                               params.lengths(), params.formats(),
+                               result_format);
+        } else {
+            r = PQexecParams(conn_, statement, params.size(), NULL,
+                             &values[0], params.lengths(), params.formats(),
+                             result_format);
+        }
+        checkResult(r, addr);
+        return;
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (pending_.empty() && !PQenterPipelineMode(conn_)) {
+        failure("entering pipeline mode, PQenterPipelineMode()");
+    }
+    int sent;
+    if (compiled_stmt_) {
+        sent = PQsendQueryPrepared(conn_, name, params.size(), &values[0],
+                                   params.lengths(), params.formats(),
+                                   result_format);
+    } else {
+        sent = PQsendQueryParams(conn_, statement, params.size(), NULL,
+                                 &values[0], params.lengths(),
+                                 params.formats(), result_format);
+    }
+    // Each statement is a transaction of its own.
+    if (!sent || !PQpipelineSync(conn_)) {
+        failure("sending statement in pipeline mode");
+    }
+    pending_.push_back(addr);
+    if (pending_.size() >= pipeline_depth_) {
+        flush();
+    }
+#endif
+}
+
+void PgSQL_uBenchmark::flush() {
+#ifdef LIBPQ_HAS_PIPELINING
+    if (pending_.empty()) {
+        return;
+    }
+
+    // A statement has its result, followed by NULL, then the result of
+    // its synchronization point.
+    for (size_t i = 0; i < pending_.size(); i++) {
+        checkResult(PQgetResult(conn_), pending_[i]);
+        if (PQgetResult(conn_) != NULL) {
+            failure("reading pipeline results: more than one result");
+        }
+        PGresult* r = PQgetResult(conn_);
+        if (PQresultStatus(r) != PGRES_PIPELINE_SYNC) {
+            PQclear(r);
+            failure("reading pipeline results: no synchronization point");
+        }
+        PQclear(r);
+    }
+    pending_.clear();
+
+    if (!PQexitPipelineMode(conn_)) {
+        failure("exiting pipeline mode, PQexitPipelineMode()");
+    }
+#endif
+}
+
+void PgSQL_uBenchmark::checkResult(PGresult* r, uint32_t addr) {
+    const ExecStatusType status = PQresultStatus(r);
+    if ((status != PGRES_COMMAND_OK) && (status != PGRES_TUPLES_OK)) {
+        stringstream tmp;
+        tmp << "executing statement: "
+            << (r ? PQresultErrorMessage(r) : "no result");
+        PQclear(r);
+        throw tmp.str();
+    }
+
+    int num_rows = 0;
+    if (addr) {
+        num_rows = PQntuples(r);
+        if (num_rows > 1) {
+            stringstream tmp;
+            tmp << "Search: DB returned " << num_rows
+                << " leases for address " << hex << addr << dec;
+            PQclear(r);
+            throw tmp.str();
+        }
+        if (num_rows) {
+            // The address is the second column.
+            uint64_t lease_addr = 0;
+            if (binary_) {
+                const unsigned char* data =
+                    reinterpret_cast<unsigned char*>(PQgetvalue(r, 0, 1));
+                for (int i = 0; i < PQgetlength(r, 0, 1); i++) {
+                    lease_addr = (lease_addr << 8) | data[i];
+                }
+            } else {
+                lease_addr = strtoull(PQgetvalue(r, 0, 1), NULL, 10);
+            }
+            if (lease_addr != addr) {
+                PQclear(r);
+                throw string("Returned data is bogus!");
+            }
+        }
+    }
+    PQclear(r);
+
+    if (verbose_) {
+        cout << ((addr && !num_rows) ? "x" : ".");
+    }
+}
+
+void PgSQL_uBenchmark::createLease4Test() {
+    if (!conn_) {
+        throw "Not connected to PostgreSQL server.";
+    }
+
+    uint32_t addr = BASE_ADDR4; // Let's start with 1.0.0.0 address
+    char hwaddr[20];
+    size_t hwaddr_len = 20;    // Not a real field
+    char client_id[128];
+    size_t client_id_len = 128;
+    uint32_t valid_lft = 1000;  // We can use the same value for all leases
+    uint32_t recycle_time = 7;  //    not supported in any foresable future,
+    time_t cltt = 1342021380;   // 2012-07-11 15:43:00 UTC
+    uint32_t pool_id = 1000;    // Let's use pool-ids greater than zero
+    bool fixed = false;
+    string hostname = "foo";    // Will generate it dynamically
+    bool fqdn_fwd = true;       // Let's pretend to do AAAA update
+    bool fqdn_rev = true;       // Let's pretend to do PTR update
+
+    cout << "CREATE:   ";
+
+    for (uint8_t i = 0; i < hwaddr_len; i++) {
+        hwaddr[i] = 'A' + i; // let's make hwaddr consisting of letters
+    }
+    for (uint8_t i = 0; i < client_id_len; i++) {
+        client_id[i] = 33 + i; // 33 is being the first, non whitespace
+                               // printable ASCII character
+    }
+
+    // The time stamps are sent as seconds since the epoch.
+    const char* statement = "INSERT INTO lease4(addr,hwaddr,client_id,"
+        "valid_lft,recycle_time,cltt,pool_id,fixed,hostname,"
+        "fqdn_fwd,fqdn_rev) "
+        "VALUES($1::bigint,$2::bytea,$3::bytea,$4::bigint,$5::bigint,"
+        "to_timestamp($6::bigint),$7::bigint,$8::bool,$9::varchar,$10::bool,"
+        "$11::bool)";
+    if (compiled_stmt_) {
+        prepare("insert", statement);
+    }
+
+    for (uint32_t i = 0; i < num_; i++) {
+        addr++;
+
+        Params params(binary_);
+        params.addInteger(addr);
+        params.addBytes(hwaddr, hwaddr_len);
+        params.addBytes(client_id, client_id_len);
+        params.addInteger(valid_lft);
+        params.addInteger(recycle_time);
+        params.addInteger(cltt + i % 60);
+        params.addInteger(pool_id);
+        params.addBool(fixed);
+        params.addText(hostname);
+        params.addBool(fqdn_fwd);
+        params.addBool(fqdn_rev);
+        send("insert", statement, params);
+    }
+    flush();
+
+    cout << endl;
+}
+
+void PgSQL_uBenchmark::searchLease4Test() {
+    if (!conn_) {
+        throw "Not connected to PostgreSQL server.";
+    }
+
+    cout << "RETRIEVE: ";
+
+    const char* statement = "SELECT lease_id,addr,hwaddr,client_id,"
+        "valid_lft,cltt,pool_id,fixed,hostname,fqdn_fwd,fqdn_rev "
+        "FROM lease4 where addr=$1::bigint";
+    if (compiled_stmt_) {
+        prepare("search", statement);
+    }
+
+    for (uint32_t i = 0; i < num_; i++) {
+        uint32_t addr = BASE_ADDR4 + random() % int(num_ / hitratio_);
+
+        Params params(binary_);
+        params.addInteger(addr);
+        send("search", statement, params, addr);
+    }
+    flush();
+
+    cout << endl;
+}
+
+void PgSQL_uBenchmark::updateLease4Test() {
+    if (!conn_) {
+        throw "Not connected to PostgreSQL server.";
+    }
+
+    cout << "UPDATE:   ";
+
+    uint32_t valid_lft = 1002; // just some dummy value
+
+    const char* statement = "UPDATE lease4 SET valid_lft=$1::bigint, "
+        "cltt=now() WHERE addr=$2::bigint";
+    if (compiled_stmt_) {
+        prepare("update", statement);
+    }
+
+    for (uint32_t i = 0; i < num_; i++) {
+        uint32_t addr = BASE_ADDR4 + random() % num_;
+
+        Params params(binary_);
+        params.addInteger(valid_lft);
+        params.addInteger(addr);
+        send("update", statement, params);
+    }
+    flush();
+
+    cout << endl;
+}
+
+void PgSQL_uBenchmark::deleteLease4Test() {
+    if (!conn_) {
+        throw "Not connected to PostgreSQL server.";
+    }
+
+    cout << "DELETE:   ";
+
+    const char* statement = "DELETE FROM lease4 WHERE addr=$1::bigint";
+    if (compiled_stmt_) {
+        prepare("delete", statement);
+    }
+
+    for (uint32_t i = 0; i < num_; i++) {
+        Params params(binary_);
+        params.addInteger(BASE_ADDR4 + i);
+        send("delete", statement, params);
+    }
+    flush();
+
+    cout << endl;
+}
+
+void PgSQL_uBenchmark::printInfo() {
+    cout << "PostgreSQL client version is " << PQlibVersion() << endl;
+    cout << "Values exchanged " << (binary_ ? "in binary format" : "as text")
+         << endl;
+    if (pipeline_depth_ > 1) {
+        cout << "Statements pipelined by " << pipeline_depth_ << endl;
+    } else {
+        cout << "Statements sent one by one" << endl;
+    }
+}
+
+
+int main(int argc, char * const argv[]) {
+
+    const char* hostname ="localhost";  // -m (PostgreSQL server)
+    const char* user = "kea";           // -u
+    const char* passwd = "secret";      // -p
+    const char* dbname = "kea";         // -f
+    uint32_t num = 100;                 // -n
+    bool sync = true;                   // -s
+    bool verbose = true;                // -v
+
+    // Run the benchmark exchanging the values as text, then in the binary
+    // format, then in the binary format with pipelines of 64 statements,
+    // with the same command line parameters.
+    const struct {
+        bool binary;
+        uint32_t pipeline_depth;
+    } modes[] = { { false, 1 }, { true, 1 }, { true, 64 } };
+    int result = 0;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        PgSQL_uBenchmark bench(hostname, user, passwd, dbname, num, sync,
+                               verbose, modes[i].binary,
+                               modes[i].pipeline_depth);
+
+        optind = 1;
+        bench.parseCmdline(argc, argv);
+
+        result = bench.run();
+        if (result != 0) {
+            break;
+        }
+    }
+
+    return (result);
+}
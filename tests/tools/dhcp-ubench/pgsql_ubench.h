@@ -0,0 +1,200 @@
+// Copyright (C) 2014 Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include "benchmark.h"
+
+/// @brief PostgreSQL micro-benchmark.
+///
+/// That is a specific backend implementation. See \ref uBenchmark class for
+/// detailed explanation of its operations. This class uses PostgreSQL as
+/// database backend.
+///
+/// The parameters of the statements and their results are exchanged either
+/// as text or in the binary format (as the PostgreSQL backend of the DHCP
+/// servers does).  The statements can be sent one by one, each waiting for
+/// the result of the previous one, or in the pipeline mode of libpq, the
+/// results being read once a number of statements were sent.  As in the
+/// backend, each statement is followed by a synchronization point so it is
+/// a transaction of its own.
+class PgSQL_uBenchmark: public uBenchmark {
+public:
+
+    /// @brief The sole PostgreSQL micro-benchmark constructor
+    ///
+    /// To avoid influence of network performance, it is highly recommended
+    /// to run PostgreSQL server on the same host as benchmark (but the
+    /// pipeline mode is intended to save the network round trips).  Make
+    /// sure that the selected database is already created and that it
+    /// follows expected schema. See pgsql.schema and bundy-dhcp-perf-guide.html
+    /// for details.
+    ///
+    /// Synchronous operation means synchronous_commit is on.
+    ///
+    /// @param hostname Name of the host to connect to
+    /// @param user usename used during PostgreSQL connection
+    /// @param pass password used during PostgreSQL connection
+    /// @param db name of the database to connect to
+    /// @param num_iterations number of iterations for basic operations
+    /// @param sync synchronous or asynchronous database writes
+    /// @param verbose should extra information be logged?
+    /// @param binary exchange the values in the binary format?
+    /// @param pipeline_depth number of statements sent before reading their
+    ///        results (1 for no pipeline)
+    PgSQL_uBenchmark(const std::string& hostname, const std::string& user,
+                     const std::string& pass, const std::string& db,
+                     uint32_t num_iterations, bool sync, bool verbose,
+                     bool binary = false, uint32_t pipeline_depth = 1);
+
+    /// @brief Prints PostgreSQL version info.
+    virtual void printInfo();
+
+    /// @brief Opens connection to the PostgreSQL database.
+    virtual void connect();
+
+    /// @brief Closes connection to the PostgreSQL database.
+    virtual void disconnect();
+
+    /// @brief Creates new leases.
+    ///
+    /// See uBenchmark::createLease4Test() for detailed explanation.
+    virtual void createLease4Test();
+
+    /// @brief Searches for existing leases.
+    ///
+    /// See uBenchmark::searchLease4Test() for detailed explanation.
+    virtual void searchLease4Test();
+
+    /// @brief Updates existing leases.
+    ///
+    /// See uBenchmark::updateLease4Test() for detailed explanation.
+    virtual void updateLease4Test();
+
+    /// @brief Deletes existing leases.
+    ///
+    /// See uBenchmark::deleteLease4Test() for detailed explanation.
+    virtual void deleteLease4Test();
+
+protected:
+    /// @brief Parameters of a statement
+    ///
+    /// The values are held as text or in the binary format, depending on
+    /// the mode of the benchmark.
+    class Params {
+    public:
+        /// @brief Constructor
+        ///
+        /// @param binary should the values be in the binary format?
+        Params(bool binary) : binary_(binary) {}
+
+        /// @brief Adds an integer parameter (of a BIGINT column)
+        void addInteger(int64_t value);
+
+        /// @brief Adds a boolean parameter
+        void addBool(bool value);
+
+        /// @brief Adds a binary parameter (of a BYTEA column)
+        void addBytes(const char* data, size_t len);
+
+        /// @brief Adds a text parameter
+        void addText(const std::string& value);
+
+        /// @brief Returns the number of parameters
+        int size() const {
+            return (values_.size());
+        }
+
+        /// @brief Returns the values of the parameters for libpq
+        ///
+        /// The pointers are valid until a parameter is added.
+        std::vector<const char*> values() const;
+
+        /// @brief Returns the lengths of the values
+        const int* lengths() const {
+            return (&lengths_[0]);
+        }
+
+        /// @brief Returns the formats of the values
+        const int* formats() const {
+            return (&formats_[0]);
+        }
+
+    private:
+        /// Should the values be in the binary format?
+        bool binary_;
+
+        /// Values of the parameters
+        std::vector<std::string> values_;
+
+        /// Lengths of the values
+        std::vector<int> lengths_;
+
+        /// Formats of the values (0 for text, 1 for binary)
+        std::vector<int> formats_;
+    };
+
+    /// @brief Used to report any database failures.
+    ///
+    /// Compared to its base version in uBenchmark class, this one logs
+    /// additional PostgreSQL specific information using PQerrorMessage().
+    /// The outcome is the same: exception is thrown.
+    ///
+    /// @param operation brief description of the operation that caused error
+    void failure(const char* operation);
+
+    /// @brief Prepares a statement (in compiled statements mode)
+    ///
+    /// @param name name of the statement
+    /// @param statement text of the statement
+    void prepare(const char* name, const char* statement);
+
+    /// @brief Sends a statement
+    ///
+    /// Without a pipeline the statement is executed and its result
+    /// checked.  In the pipeline mode the statement is queued, and the
+    /// results of the queued statements are read once there are
+    /// pipeline_depth_ of them.
+    ///
+    /// @param name name of the prepared statement
+    /// @param statement text of the statement (without compiled statements)
+    /// @param params parameters of the statement
+    /// @param addr address expected in the result of a search (0 for
+    ///        the other statements)
+    void send(const char* name, const char* statement, const Params& params,
+              uint32_t addr = 0);
+
+    /// @brief Reads the results of the queued statements
+    void flush();
+
+    /// @brief Checks the result of a statement
+    ///
+    /// @param r result of the statement
+    /// @param addr address expected in the result of a search (0 for
+    ///        the other statements)
+    void checkResult(PGresult* r, uint32_t addr);
+
+    /// Handle to PostgreSQL database connection.
+    PGconn* conn_;
+
+    /// Should the values be exchanged in the binary format?
+    bool binary_;
+
+    /// Number of statements sent before reading their results.
+    uint32_t pipeline_depth_;
+
+    /// Addresses expected by the queued statements (0 if not a search).
+    std::vector<uint32_t> pending_;
+};